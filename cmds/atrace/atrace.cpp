@@ -31,7 +31,9 @@
 #include <zlib.h>
 
 #include <fstream>
+#include <map>
 #include <memory>
+#include <string>
 
 #include <binder/IBinder.h>
 #include <binder/IServiceManager.h>
@@ -50,6 +52,7 @@
 #include <android-base/macros.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 
 using namespace android;
 using pdx::default_transport::ServiceUtility;
@@ -631,21 +634,47 @@ static bool setAppCmdlineProperty(char* cmdline)
     return true;
 }
 
-// Disable all /sys/ enable files.
-static bool disableKernelTraceEvents() {
+// Set the /sys/ enable files of all the categories in one pass: the files of
+// the enabled categories are enabled, and all the others are disabled.  Each
+// file is written at most once, even if it belongs to several categories, and
+// only if it doesn't already have the right value, since every change of an
+// event's state makes the kernel update its tracepoints.
+static bool setKernelTraceEvents(bool withEnabledCategories) {
     bool ok = true;
+    std::map<std::string, bool> enables;
     for (size_t i = 0; i < arraysize(k_categories); i++) {
         const TracingCategory &c = k_categories[i];
+        const bool enable = withEnabledCategories && g_categoryEnables[i];
         for (int j = 0; j < MAX_SYS_FILES; j++) {
             const char* path = c.sysfiles[j].path;
-            if (path != nullptr && fileIsWritable(path)) {
-                ok &= setKernelOptionEnable(path, false);
+            if (path == nullptr) {
+                continue;
+            }
+            if (fileIsWritable(path)) {
+                enables[path] |= enable;
+            } else if (enable && c.sysfiles[j].required == REQ) {
+                fprintf(stderr, "error writing file %s\n", path);
+                ok = false;
             }
         }
     }
+
+    for (const auto& [path, enable] : enables) {
+        std::string current;
+        if (android::base::ReadFileToString(g_traceFolder + path, &current) &&
+                android::base::Trim(current) == (enable ? "1" : "0")) {
+            continue;
+        }
+        ok &= setKernelOptionEnable(path.c_str(), enable);
+    }
     return ok;
 }
 
+// Disable all /sys/ enable files.
+static bool disableKernelTraceEvents() {
+    return setKernelTraceEvents(/* withEnabledCategories = */ false);
+}
+
 // Verify that the comma separated list of functions are being traced by the
 // kernel.
 static bool verifyKernelTraceFuncs(const char* funcs)
@@ -845,28 +874,9 @@ static bool setUpKernelTracing()
     ok &= setPrintTgidEnableIfPresent(true);
     ok &= setKernelTraceFuncs(g_kernelTraceFuncs);
 
-    // Disable all the sysfs enables.  This is done as a separate loop from
-    // the enables to allow the same enable to exist in multiple categories.
-    ok &= disableKernelTraceEvents();
-
-    // Enable all the sysfs enables that are in an enabled category.
-    for (size_t i = 0; i < arraysize(k_categories); i++) {
-        if (g_categoryEnables[i]) {
-            const TracingCategory &c = k_categories[i];
-            for (int j = 0; j < MAX_SYS_FILES; j++) {
-                const char* path = c.sysfiles[j].path;
-                bool required = c.sysfiles[j].required == REQ;
-                if (path != nullptr) {
-                    if (fileIsWritable(path)) {
-                        ok &= setKernelOptionEnable(path, true);
-                    } else if (required) {
-                        fprintf(stderr, "error writing file %s\n", path);
-                        ok = false;
-                    }
-                }
-            }
-        }
-    }
+    // Enable all the sysfs enables that are in an enabled category, and
+    // disable the rest.
+    ok &= setKernelTraceEvents(/* withEnabledCategories = */ true);
 
     return ok;
 }
@@ -1078,6 +1088,9 @@ static void showHelp(const char *cmd)
                     "  --async_dump    dump the current contents of circular trace buffer\n"
                     "  --async_stop    stop tracing and dump the current contents of circular\n"
                     "                    trace buffer\n"
+                    "  --async_snapshot\n"
+                    "                  dump the current contents of circular trace buffer\n"
+                    "                    without stopping or clearing it\n"
                     "  --stream        stream trace to stdout as it enters the trace buffer\n"
                     "                    Note: this can take significant CPU time, and is best\n"
                     "                    used for measuring things that are not affected by\n"
@@ -1191,6 +1204,7 @@ int main(int argc, char **argv)
     bool traceStart = true;
     bool traceStop = true;
     bool traceDump = true;
+    bool traceClear = true;
     bool traceStream = false;
     bool onlyUserspace = false;
 
@@ -1213,6 +1227,7 @@ int main(int argc, char **argv)
             {"async_start",       no_argument, nullptr,  0 },
             {"async_stop",        no_argument, nullptr,  0 },
             {"async_dump",        no_argument, nullptr,  0 },
+            {"async_snapshot",    no_argument, nullptr,  0 },
             {"only_userspace",    no_argument, nullptr,  0 },
             {"list_categories",   no_argument, nullptr,  0 },
             {"stream",            no_argument, nullptr,  0 },
@@ -1286,6 +1301,11 @@ int main(int argc, char **argv)
                     async = true;
                     traceStart = false;
                     traceStop = false;
+                } else if (!strcmp(long_options[option_index].name, "async_snapshot")) {
+                    async = true;
+                    traceStart = false;
+                    traceStop = false;
+                    traceClear = false;
                 } else if (!strcmp(long_options[option_index].name, "only_userspace")) {
                     onlyUserspace = true;
                 } else if (!strcmp(long_options[option_index].name, "stream")) {
@@ -1389,7 +1409,9 @@ int main(int argc, char **argv)
             printf("\ntrace aborted.\n");
             fflush(stdout);
         }
-        clearTrace();
+        if (traceClear) {
+            clearTrace();
+        }
     } else if (!ok) {
         fprintf(stderr, "unable to start tracing\n");
     }
@@ -18,6 +18,9 @@
 
 #include "DumpPool.h"
 
+#include <sys/mman.h>
+#include <sys/resource.h>
+
 #include <array>
 #include <thread>
 
@@ -65,7 +68,9 @@ void DumpPool::shutdown() {
         return;
     }
     futures_map_.clear();
-    while (!tasks_.empty()) tasks_.pop();
+    for (auto& tasks : tasks_) {
+        while (!tasks.empty()) tasks.pop();
+    }
 
     shutdown_ = true;
     condition_variable_.notify_all();
@@ -90,13 +95,19 @@ void DumpPool::waitForTask(const std::string& task_name, const std::string& titl
     Future future = iterator->second;
     futures_map_.erase(iterator);
 
-    std::string result = future.get();
-    if (result.empty()) {
+    std::shared_ptr<TmpFile> result = future.get();
+    if (!result) {
+        return;
+    }
+    if (result->path[0] == '\0') {
+        // The output was kept in memory, so copy it from the start of the memfd.
+        lseek(result->fd.get(), 0, SEEK_SET);
+        DumpFileFromFdToFd(title, "", result->fd.get(), out_fd, PropertiesHelper::IsDryRun());
         return;
     }
-    DumpFileToFd(out_fd, title, result);
-    if (unlink(result.c_str())) {
-        MYLOGE("Failed to unlink (%s): %s\n", result.c_str(), strerror(errno));
+    DumpFileToFd(out_fd, title, result->path);
+    if (unlink(result->path)) {
+        MYLOGE("Failed to unlink (%s): %s\n", result->path, strerror(errno));
     }
 }
 
@@ -108,9 +119,53 @@ void DumpPool::setLogDuration(bool log_duration) {
     log_duration_ = log_duration;
 }
 
+/*
+ * Reports the CPU time and block I/O of the calling thread over its lifetime,
+ * after the task's duration. Work done by child processes that the task runs,
+ * like dumpsys, is not included.
+ */
+class TaskUsageReporter {
+  public:
+    TaskUsageReporter(const std::string& title, bool logcat_only, int out_fd)
+        : title_(title), logcat_only_(logcat_only), out_fd_(out_fd) {
+        getrusage(RUSAGE_THREAD, &started_);
+    }
+
+    ~TaskUsageReporter() {
+        struct rusage finished;
+        if (getrusage(RUSAGE_THREAD, &finished) != 0) {
+            return;
+        }
+        const float user = toSeconds(finished.ru_utime) - toSeconds(started_.ru_utime);
+        const float system = toSeconds(finished.ru_stime) - toSeconds(started_.ru_stime);
+        const long blocks_in = finished.ru_inblock - started_.ru_inblock;
+        const long blocks_out = finished.ru_oublock - started_.ru_oublock;
+        MYLOGD("Usage of '%s': %.2fs user, %.2fs system, %ld blocks in, %ld blocks out\n",
+               title_.c_str(), user, system, blocks_in, blocks_out);
+        if (!logcat_only_) {
+            dprintf(out_fd_, "------ %.3fs user, %.3fs system, %ld blocks in, %ld blocks out "
+                    "was the usage of '%s' ------\n",
+                    user, system, blocks_in, blocks_out, title_.c_str());
+        }
+    }
+
+  private:
+    static float toSeconds(const struct timeval& time) {
+        return time.tv_sec + time.tv_usec / 1000000.f;
+    }
+
+    std::string title_;
+    bool logcat_only_;
+    int out_fd_;
+    struct rusage started_;
+
+    DISALLOW_COPY_AND_ASSIGN(TaskUsageReporter);
+};
+
 template <>
 void DumpPool::invokeTask<std::function<void()>>(std::function<void()> dump_func,
         const std::string& duration_title, int out_fd) {
+    TaskUsageReporter usage_reporter(duration_title, /*logcat_only =*/!log_duration_, out_fd);
     DurationReporter duration_reporter(duration_title, /*logcat_only =*/!log_duration_,
             /*verbose =*/false, out_fd);
     std::invoke(dump_func);
@@ -119,6 +174,7 @@ void DumpPool::invokeTask<std::function<void()>>(std::function<void()> dump_func
 template <>
 void DumpPool::invokeTask<std::function<void(int)>>(std::function<void(int)> dump_func,
         const std::string& duration_title, int out_fd) {
+    TaskUsageReporter usage_reporter(duration_title, /*logcat_only =*/!log_duration_, out_fd);
     DurationReporter duration_reporter(duration_title, /*logcat_only =*/!log_duration_,
             /*verbose =*/false, out_fd);
     std::invoke(dump_func, out_fd);
@@ -126,6 +182,15 @@ void DumpPool::invokeTask<std::function<void(int)>>(std::function<void(int)> dum
 
 std::unique_ptr<DumpPool::TmpFile> DumpPool::createTempFile() {
     auto tmp_file_ptr = std::make_unique<TmpFile>();
+    // Keep the output in memory, so that it doesn't have to be written to and
+    // read back from the storage before it goes into the bugreport.
+    tmp_file_ptr->fd.reset(memfd_create(PREFIX_TMPFILE_NAME.c_str(), MFD_CLOEXEC));
+    if (tmp_file_ptr->fd.get() != -1) {
+        tmp_file_ptr->path[0] = '\0';
+        return tmp_file_ptr;
+    }
+    MYLOGW("memfd_create: %s, using a temporary file\n", strerror(errno));
+
     std::string file_name_format = "%s/" + PREFIX_TMPFILE_NAME + "XXXXXX";
     snprintf(tmp_file_ptr->path, sizeof(tmp_file_ptr->path), file_name_format.c_str(),
              tmp_root_.c_str());
@@ -175,15 +240,34 @@ void DumpPool::setThreadName(const pthread_t thread, int id) {
     pthread_setname_np(thread, name.data());
 }
 
+bool DumpPool::hasTasksLocked() const {
+    for (const auto& tasks : tasks_) {
+        if (!tasks.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+DumpPool::Task DumpPool::popTaskLocked() {
+    for (auto it = tasks_.rbegin(); it != tasks_.rend(); it++) {
+        if (!it->empty()) {
+            Task task = std::move(it->front());
+            it->pop();
+            return task;
+        }
+    }
+    return Task();
+}
+
 void DumpPool::loop() {
     std::unique_lock lock(lock_);
     while (!shutdown_) {
-        if (tasks_.empty()) {
+        if (!hasTasksLocked()) {
             condition_variable_.wait(lock);
             continue;
         } else {
-            std::packaged_task<std::string()> task = std::move(tasks_.front());
-            tasks_.pop();
+            std::packaged_task<std::string()> task = popTaskLocked();
             lock.unlock();
             std::invoke(task);
             lock.lock();
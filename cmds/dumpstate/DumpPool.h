@@ -17,6 +17,7 @@
 #ifndef FRAMEWORK_NATIVE_CMD_DUMPPOOL_H_
 #define FRAMEWORK_NATIVE_CMD_DUMPPOOL_H_
 
+#include <array>
 #include <future>
 #include <map>
 #include <queue>
@@ -51,11 +52,22 @@ class DumpPoolTest;
  * DumpFoo is a callable function included a out_fd parameter. Using the
  * enqueueTaskWithFd method in DumpPool to enqueue the task to the pool. The
  * std::placeholders::_1 is a placeholder for DumpPool to pass a fd argument.
+ *
+ * Tasks run by priority, and in the order they were enqueued within the same
+ * priority. Long running tasks should be enqueued with Priority::HIGH so that
+ * they don't end up waiting behind short ones while the main thread blocks on
+ * them.
  */
 class DumpPool {
   friend class android::os::dumpstate::DumpPoolTest;
 
   public:
+    enum class Priority {
+        LOW,
+        NORMAL,
+        HIGH,
+    };
+
     /*
      * Creates a thread pool.
      *
@@ -89,9 +101,17 @@ class DumpPool {
      */
     template<class F, class... Args> void enqueueTask(const std::string& task_name, F&& f,
             Args&&... args) {
+        enqueueTask(Priority::NORMAL, task_name, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    /*
+     * Same as above, with the given |priority| instead of Priority::NORMAL.
+     */
+    template<class F, class... Args> void enqueueTask(Priority priority,
+            const std::string& task_name, F&& f, Args&&... args) {
         std::function<void(void)> func = std::bind(std::forward<F>(f),
                 std::forward<Args>(args)...);
-        futures_map_[task_name] = post(task_name, func);
+        futures_map_[task_name] = post(priority, task_name, func);
         if (threads_.empty()) {
             start();
         }
@@ -109,9 +129,18 @@ class DumpPool {
      */
     template<class F, class... Args> void enqueueTaskWithFd(const std::string& task_name, F&& f,
             Args&&... args) {
+        enqueueTaskWithFd(Priority::NORMAL, task_name, std::forward<F>(f),
+                std::forward<Args>(args)...);
+    }
+
+    /*
+     * Same as above, with the given |priority| instead of Priority::NORMAL.
+     */
+    template<class F, class... Args> void enqueueTaskWithFd(Priority priority,
+            const std::string& task_name, F&& f, Args&&... args) {
         std::function<void(int)> func = std::bind(std::forward<F>(f),
                 std::forward<Args>(args)...);
-        futures_map_[task_name] = post(task_name, func);
+        futures_map_[task_name] = post(priority, task_name, func);
         if (threads_.empty()) {
             start();
         }
@@ -142,34 +171,43 @@ class DumpPool {
     static const std::string PREFIX_TMPFILE_NAME;
 
   private:
-    using Task = std::packaged_task<std::string()>;
-    using Future = std::shared_future<std::string>;
+    /*
+     * The output of a task. It's kept in memory when possible, and otherwise
+     * in a file under |tmp_root_|, in which case |path| is not empty.
+     */
+    typedef struct {
+      android::base::unique_fd fd;
+      char path[1024];
+    } TmpFile;
+
+    using Task = std::packaged_task<std::shared_ptr<TmpFile>()>;
+    using Future = std::shared_future<std::shared_ptr<TmpFile>>;
 
     template<class T> void invokeTask(T dump_func, const std::string& duration_title, int out_fd);
 
-    template<class T> Future post(const std::string& task_name, T dump_func) {
+    template<class T> Future post(Priority priority, const std::string& task_name,
+            T dump_func) {
         Task packaged_task([=]() {
-            std::unique_ptr<TmpFile> tmp_file_ptr = createTempFile();
+            std::shared_ptr<TmpFile> tmp_file_ptr = createTempFile();
             if (!tmp_file_ptr) {
-                return std::string("");
+                return tmp_file_ptr;
             }
             invokeTask(dump_func, task_name, tmp_file_ptr->fd.get());
-            fsync(tmp_file_ptr->fd.get());
-            return std::string(tmp_file_ptr->path);
+            if (tmp_file_ptr->path[0] != '\0') {
+                fsync(tmp_file_ptr->fd.get());
+            }
+            return tmp_file_ptr;
         });
         std::unique_lock lock(lock_);
         auto future = packaged_task.get_future().share();
-        tasks_.push(std::move(packaged_task));
+        tasks_[static_cast<size_t>(priority)].push(std::move(packaged_task));
         condition_variable_.notify_one();
         return future;
     }
 
-    typedef struct {
-      android::base::unique_fd fd;
-      char path[1024];
-    } TmpFile;
-
     std::unique_ptr<TmpFile> createTempFile();
+    bool hasTasksLocked() const;
+    Task popTaskLocked();
     void deleteTempFiles(const std::string& folder);
     void setThreadName(const pthread_t thread, int id);
     void loop();
@@ -184,6 +222,7 @@ class DumpPool {
 
   private:
     static const int MAX_THREAD_COUNT = 4;
+    static const size_t NUM_PRIORITIES = static_cast<size_t>(Priority::HIGH) + 1;
 
     /* A path to a temporary folder for threads to create temporary files. */
     std::string tmp_root_;
@@ -193,7 +232,7 @@ class DumpPool {
     std::condition_variable condition_variable_;
 
     std::vector<std::thread> threads_;
-    std::queue<Task> tasks_;
+    std::array<std::queue<Task>, NUM_PRIORITIES> tasks_;  // Indexed by Priority.
     std::map<std::string, Future> futures_map_;
 
     DISALLOW_COPY_AND_ASSIGN(DumpPool);
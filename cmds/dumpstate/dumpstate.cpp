@@ -44,16 +44,19 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <fstream>
 #include <functional>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <numeric>
 #include <regex>
 #include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -1599,9 +1602,13 @@ static Dumpstate::RunStatus dumpstate() {
         // drop root user. Restarts it with two threads for the parallel run.
         ds.dump_pool_->start(/* thread_counts = */2);
 
-        ds.dump_pool_->enqueueTaskWithFd(DUMP_HALS_TASK, &DumpHals, _1);
-        ds.dump_pool_->enqueueTask(DUMP_INCIDENT_REPORT_TASK, &DumpIncidentReport);
-        ds.dump_pool_->enqueueTaskWithFd(DUMP_BOARD_TASK, &Dumpstate::DumpstateBoard, &ds, _1);
+        // The HALs are waited for first, and the board can take up to its timeout, so start
+        // them before the others. The incident report is waited for last.
+        ds.dump_pool_->enqueueTaskWithFd(DumpPool::Priority::HIGH, DUMP_HALS_TASK, &DumpHals, _1);
+        ds.dump_pool_->enqueueTask(DumpPool::Priority::LOW, DUMP_INCIDENT_REPORT_TASK,
+                                   &DumpIncidentReport);
+        ds.dump_pool_->enqueueTaskWithFd(DumpPool::Priority::HIGH, DUMP_BOARD_TASK,
+                                         &Dumpstate::DumpstateBoard, &ds, _1);
         ds.dump_pool_->enqueueTaskWithFd(DUMP_CHECKINS_TASK, &DumpCheckins, _1);
     }
 
@@ -2082,6 +2089,56 @@ static void DumpstateWifiOnly() {
     printf("========================================================\n");
 }
 
+// Upper bound on the number of processes whose stacks are collected at the same time, on top of
+// the number of cores.
+static const unsigned int MAX_CONCURRENT_STACK_DUMPS = 8;
+
+// A process whose stacks DumpTraces collects, and the result of collecting them.
+struct StackDump {
+    int pid;
+    bool is_java_process;
+
+    // Set once a worker has picked the process up. Workers pick processes in order, so the
+    // processes that were started always come before those that were not.
+    bool started = false;
+    android::base::unique_fd fd;
+    int ret = -1;
+    uint64_t elapsed = 0;
+};
+
+// Creates an unlinked temporary file for debuggerd to write the stacks of a single process to.
+static android::base::unique_fd CreateStackDumpFile(const std::string& dir) {
+    std::string name = dir + "/dumptrace_XXXXXX";
+    android::base::unique_fd fd(mkostemp(name.data(), O_CLOEXEC));
+    if (fd < 0) {
+        MYLOGE("mkostemp on pattern %s: %s\n", name.c_str(), strerror(errno));
+        return {};
+    }
+    unlink(name.c_str());
+
+    // See DumpTraces for why 'others' are granted 'read'.
+    if (fchmod(fd, 0666) < 0) {
+        MYLOGE("fchmod on %s failed: %s\n", name.c_str(), strerror(errno));
+        return {};
+    }
+    return fd;
+}
+
+static void AppendStackDump(int dump_fd, int out_fd) {
+    if (lseek(dump_fd, 0, SEEK_SET) < 0) {
+        MYLOGE("lseek on stack dump failed: %s\n", strerror(errno));
+        return;
+    }
+    char buffer[65536];
+    ssize_t bytes_read;
+    while ((bytes_read = TEMP_FAILURE_RETRY(read(dump_fd, buffer, sizeof(buffer)))) > 0) {
+        android::base::WriteFully(out_fd, buffer, bytes_read);
+    }
+    if (bytes_read < 0) {
+        MYLOGE("read on stack dump failed: %s\n", strerror(errno));
+    }
+}
+
 Dumpstate::RunStatus Dumpstate::DumpTraces(const char** path) {
     const std::string temp_file_pattern = ds.bugreport_internal_dir_ + "/dumptrace_XXXXXX";
     const size_t buf_size = temp_file_pattern.length() + 1;
@@ -2115,13 +2172,12 @@ Dumpstate::RunStatus Dumpstate::DumpTraces(const char** path) {
         return RunStatus::OK;
     }
 
-    // Number of times process dumping has timed out. If we encounter too many
-    // failures, we'll give up.
-    int timeout_failures = 0;
     bool dalvik_found = false;
 
     const std::set<int> hal_pids = get_interesting_hal_pids();
 
+    std::vector<StackDump> dumps;
+
     struct dirent* d;
     while ((d = readdir(proc.get()))) {
         RETURN_IF_USER_DENIED_CONSENT();
@@ -2152,34 +2208,88 @@ Dumpstate::RunStatus Dumpstate::DumpTraces(const char** path) {
             continue;
         }
 
-        // If 3 backtrace dumps fail in a row, consider debuggerd dead.
-        if (timeout_failures == 3) {
-            dprintf(fd, "ERROR: Too many stack dump failures, exiting.\n");
-            break;
+        dumps.push_back({.pid = pid, .is_java_process = is_java_process});
+    }
+
+    // Unwinding mostly waits on debuggerd and the target process, so collect the stacks of
+    // several processes at once, each into its own file, and keep the per-process timeouts from
+    // adding up. The results are then written out in the order the processes were found.
+    std::atomic<size_t> next_dump = 0;
+    std::atomic<bool> give_up = false;
+    std::mutex failures_lock;
+    // Number of times in a row process dumping has timed out. If we encounter too many
+    // failures, we'll give up.
+    int timeout_failures = 0;
+
+    auto collect_stacks = [&]() {
+        while (!give_up && !ds.IsUserConsentDenied()) {
+            const size_t i = next_dump++;
+            if (i >= dumps.size()) {
+                return;
+            }
+
+            StackDump& dump = dumps[i];
+            dump.started = true;
+            dump.fd = CreateStackDumpFile(ds.bugreport_internal_dir_);
+            if (dump.fd < 0) {
+                continue;
+            }
+
+            const uint64_t start = Nanotime();
+            dump.ret = dump_backtrace_to_file_timeout(
+                dump.pid,
+                dump.is_java_process ? kDebuggerdJavaBacktrace : kDebuggerdNativeBacktrace,
+                dump.is_java_process ? 5 : 20, dump.fd);
+            dump.elapsed = Nanotime() - start;
+
+            std::lock_guard<std::mutex> lock(failures_lock);
+            if (dump.ret == -1) {
+                // If 3 backtrace dumps fail in a row, consider debuggerd dead.
+                if (++timeout_failures == 3) {
+                    give_up = true;
+                }
+            } else {
+                timeout_failures = 0;
+            }
         }
+    };
+
+    const unsigned int thread_count =
+        std::max(1u, std::min({std::thread::hardware_concurrency(), MAX_CONCURRENT_STACK_DUMPS,
+                               static_cast<unsigned int>(dumps.size())}));
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < thread_count; i++) {
+        threads.emplace_back(collect_stacks);
+    }
+    collect_stacks();
+    for (auto& thread : threads) {
+        thread.join();
+    }
 
-        const uint64_t start = Nanotime();
-        const int ret = dump_backtrace_to_file_timeout(
-            pid, is_java_process ? kDebuggerdJavaBacktrace : kDebuggerdNativeBacktrace,
-            is_java_process ? 5 : 20, fd);
+    RETURN_IF_USER_DENIED_CONSENT();
 
-        if (ret == -1) {
+    for (const StackDump& dump : dumps) {
+        if (!dump.started) {
+            if (give_up) {
+                dprintf(fd, "ERROR: Too many stack dump failures, exiting.\n");
+            }
+            break;
+        }
+
+        if (dump.ret == -1) {
             // For consistency, the header and footer to this message match those
             // dumped by debuggerd in the success case.
-            dprintf(fd, "\n---- pid %d at [unknown] ----\n", pid);
+            dprintf(fd, "\n---- pid %d at [unknown] ----\n", dump.pid);
             dprintf(fd, "Dump failed, likely due to a timeout.\n");
-            dprintf(fd, "---- end %d ----", pid);
-            timeout_failures++;
+            dprintf(fd, "---- end %d ----", dump.pid);
             continue;
         }
 
-        // We've successfully dumped stack traces, reset the failure count
-        // and write a summary of the elapsed time to the file and continue with the
-        // next process.
-        timeout_failures = 0;
-
-        dprintf(fd, "[dump %s stack %d: %.3fs elapsed]\n", is_java_process ? "dalvik" : "native",
-                pid, (float)(Nanotime() - start) / NANOS_PER_SEC);
+        // Write the stacks and a summary of the elapsed time to the file.
+        AppendStackDump(dump.fd, fd);
+        dprintf(fd, "[dump %s stack %d: %.3fs elapsed]\n",
+                dump.is_java_process ? "dalvik" : "native", dump.pid,
+                (float)dump.elapsed / NANOS_PER_SEC);
     }
 
     if (!dalvik_found) {
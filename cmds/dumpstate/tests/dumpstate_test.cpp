@@ -48,6 +48,7 @@ namespace os {
 namespace dumpstate {
 
 using ::android::hardware::dumpstate::V1_1::DumpstateMode;
+using ::testing::ElementsAre;
 using ::testing::EndsWith;
 using ::testing::Eq;
 using ::testing::HasSubstr;
@@ -1758,7 +1759,35 @@ TEST_F(DumpPoolTest, EnqueueTask_withDurationLog) {
     std::string result;
     ReadFileToString(out_path_, &result);
     EXPECT_TRUE(run_1);
-    EXPECT_THAT(result, StrEq("------ 0.000s was the duration of '1' ------\n"));
+    EXPECT_THAT(result, StartsWith("------ 0.000s was the duration of '1' ------\n"));
+    EXPECT_THAT(result, HasSubstr("was the usage of '1' ------\n"));
+    EXPECT_THAT(getTempFileCounts(kTestDataPath), Eq(0));
+}
+
+TEST_F(DumpPoolTest, EnqueueTask_runsHigherPriorityFirst) {
+    std::mutex lock;
+    std::vector<std::string> order;
+    auto dump_func = [&](const std::string& name) {
+        std::lock_guard<std::mutex> guard(lock);
+        order.push_back(name);
+    };
+    auto blocking_func = []() {
+        sleep(1);
+    };
+
+    setLogDuration(/* log_duration = */false);
+    dump_pool_->start(/* thread_counts = */1);
+    dump_pool_->enqueueTask(/* task_name = */"blocking", blocking_func);
+    dump_pool_->enqueueTask(DumpPool::Priority::LOW, /* task_name = */"low", dump_func, "low");
+    dump_pool_->enqueueTask(/* task_name = */"normal", dump_func, "normal");
+    dump_pool_->enqueueTask(DumpPool::Priority::HIGH, /* task_name = */"high", dump_func, "high");
+    dump_pool_->waitForTask("blocking", "", out_fd_.get());
+    dump_pool_->waitForTask("low", "", out_fd_.get());
+    dump_pool_->waitForTask("normal", "", out_fd_.get());
+    dump_pool_->waitForTask("high", "", out_fd_.get());
+    dump_pool_->shutdown();
+
+    EXPECT_THAT(order, ElementsAre("high", "normal", "low"));
     EXPECT_THAT(getTempFileCounts(kTestDataPath), Eq(0));
 }
 
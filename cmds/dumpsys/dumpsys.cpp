@@ -16,8 +16,11 @@
 
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
 #include <iomanip>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
@@ -36,6 +39,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -61,19 +65,22 @@ static void usage() {
             "usage: dumpsys\n"
             "         To dump all services.\n"
             "or:\n"
-            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--pid] [--thread] [--help | -l | "
-            "--skip SERVICES "
-            "| SERVICE [ARGS]]\n"
+            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--parallel N] [--pid] [--thread] "
+            "[--binder-stats] [--help | -l | --skip SERVICES | SERVICE [ARGS]]\n"
             "         --help: shows this help\n"
             "         -l: only list services, do not dump them\n"
             "         -t TIMEOUT_SEC: TIMEOUT to use in seconds instead of default 10 seconds\n"
             "         -T TIMEOUT_MS: TIMEOUT to use in milliseconds instead of default 10 seconds\n"
             "         --pid: dump PID instead of usual dump\n"
             "         --thread: dump thread usage instead of usual dump\n"
+            "         --binder-stats: dump per-method binder latency of the process hosting\n"
+            "               SERVICE instead of usual dump. ARGS may be enable, disable or reset.\n"
             "         --proto: filter services that support dumping data in proto format. Dumps\n"
             "               will be in proto format.\n"
             "         --priority LEVEL: filter services based on specified priority\n"
             "               LEVEL must be one of CRITICAL | HIGH | NORMAL\n"
+            "         --parallel N: when dumping several services, dump up to N of them at once.\n"
+            "               The output is still in the same order.\n"
             "         --skip SERVICES: dumps all services but SERVICES (comma-separated list)\n"
             "         SERVICE [ARGS]: dumps only service SERVICE, optionally passing ARGS to it\n");
 }
@@ -127,10 +134,13 @@ int Dumpsys::main(int argc, char* const argv[]) {
     bool asProto = false;
     Type type = Type::DUMP;
     int timeoutArgMs = 10000;
+    int parallelDumps = 1;
     int priorityFlags = IServiceManager::DUMP_FLAG_PRIORITY_ALL;
     static struct option longOptions[] = {{"thread", no_argument, 0, 0},
                                           {"pid", no_argument, 0, 0},
+                                          {"binder-stats", no_argument, 0, 0},
                                           {"priority", required_argument, 0, 0},
+                                          {"parallel", required_argument, 0, 0},
                                           {"proto", no_argument, 0, 0},
                                           {"skip", no_argument, 0, 0},
                                           {"help", no_argument, 0, 0},
@@ -165,10 +175,19 @@ int Dumpsys::main(int argc, char* const argv[]) {
                     usage();
                     return -1;
                 }
+            } else if (!strcmp(longOptions[optionIndex].name, "parallel")) {
+                char* endptr;
+                parallelDumps = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || parallelDumps <= 0) {
+                    fprintf(stderr, "Error: invalid number of parallel dumps: '%s'\n", optarg);
+                    return -1;
+                }
             } else if (!strcmp(longOptions[optionIndex].name, "pid")) {
                 type = Type::PID;
             } else if (!strcmp(longOptions[optionIndex].name, "thread")) {
                 type = Type::THREAD;
+            } else if (!strcmp(longOptions[optionIndex].name, "binder-stats")) {
+                type = Type::BINDER_STATS;
             }
             break;
 
@@ -254,37 +273,134 @@ int Dumpsys::main(int argc, char* const argv[]) {
         return 0;
     }
 
+    const std::chrono::milliseconds timeout(timeoutArgMs);
+    if (N > 1 && parallelDumps > 1) {
+        Vector<String16> dumpedServices;
+        for (const String16& serviceName : services) {
+            if (!IsSkipped(skippedServices, serviceName)) {
+                dumpedServices.add(serviceName);
+            }
+        }
+        dumpServicesInParallel(dumpedServices, type, args, priorityFlags, asProto, timeout,
+                               parallelDumps);
+        return 0;
+    }
+
     for (size_t i = 0; i < N; i++) {
         const String16& serviceName = services[i];
         if (IsSkipped(skippedServices, serviceName)) continue;
 
-        if (startDumpThread(type, serviceName, args) == OK) {
-            bool addSeparator = (N > 1);
-            if (addSeparator) {
-                writeDumpHeader(STDOUT_FILENO, serviceName, priorityFlags);
+        dumpService(STDOUT_FILENO, type, serviceName, args, priorityFlags, asProto, timeout,
+                    /* addSeparator = */ N > 1);
+    }
+
+    return 0;
+}
+
+void Dumpsys::dumpService(int fd, Type type, const String16& serviceName,
+                          const Vector<String16>& args, int priorityFlags, bool asProto,
+                          std::chrono::milliseconds timeout, bool addSeparator) {
+    if (startDumpThread(type, serviceName, args) != OK) {
+        return;
+    }
+    if (addSeparator) {
+        writeDumpHeader(fd, serviceName, priorityFlags);
+    }
+    std::chrono::duration<double> elapsedDuration;
+    size_t bytesWritten = 0;
+    status_t status = writeDump(fd, serviceName, timeout, asProto, elapsedDuration, bytesWritten);
+
+    if (status == TIMED_OUT) {
+        std::string msg = StringPrintf("\n*** SERVICE '%s' DUMP TIMEOUT (%llums) EXPIRED ***\n\n",
+                                       String8(serviceName).string(), timeout.count());
+        WriteStringToFd(msg, fd);
+    }
+
+    if (addSeparator) {
+        writeDumpFooter(fd, serviceName, elapsedDuration);
+    }
+    bool dumpComplete = (status == OK);
+    stopDumpThread(dumpComplete);
+}
+
+void Dumpsys::dumpServicesInParallel(const Vector<String16>& services, Type type,
+                                     const Vector<String16>& args, int priorityFlags,
+                                     bool asProto, std::chrono::milliseconds timeout,
+                                     size_t numThreads) {
+    const size_t N = services.size();
+    // Services that were dumped but not written out yet are buffered in memory, so only let the
+    // workers get a few services ahead of the oldest one still being dumped.
+    const size_t maxPending = numThreads * 2;
+
+    std::mutex lock;
+    std::condition_variable condition;
+    std::vector<unique_fd> buffers(N);
+    std::vector<bool> dumped(N, false);
+    size_t nextService = 0;
+    size_t nextOutput = 0;
+
+    auto dumpServices = [&]() {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            condition.wait(guard, [&]() {
+                return nextService >= N || nextService < nextOutput + maxPending;
+            });
+            if (nextService >= N) {
+                return;
             }
-            std::chrono::duration<double> elapsedDuration;
-            size_t bytesWritten = 0;
-            status_t status =
-                writeDump(STDOUT_FILENO, serviceName, std::chrono::milliseconds(timeoutArgMs),
-                          asProto, elapsedDuration, bytesWritten);
-
-            if (status == TIMED_OUT) {
-                std::cout << std::endl
-                     << "*** SERVICE '" << serviceName << "' DUMP TIMEOUT (" << timeoutArgMs
-                     << "ms) EXPIRED ***" << std::endl
-                     << std::endl;
+            const size_t i = nextService++;
+            guard.unlock();
+
+            unique_fd buffer(memfd_create("dumpsys", MFD_CLOEXEC));
+            if (buffer.get() == -1) {
+                std::cerr << "Failed to create buffer to dump service " << services[i] << ": "
+                          << strerror(errno) << std::endl;
+            } else {
+                Dumpsys worker(sm_);
+                worker.dumpService(buffer.get(), type, services[i], args, priorityFlags, asProto,
+                                   timeout, /* addSeparator = */ true);
             }
 
-            if (addSeparator) {
-                writeDumpFooter(STDOUT_FILENO, serviceName, elapsedDuration);
+            guard.lock();
+            buffers[i] = std::move(buffer);
+            dumped[i] = true;
+            condition.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::min(numThreads, N); i++) {
+        threads.emplace_back(dumpServices);
+    }
+
+    // Write the dumps out in the order of the services, as soon as each one is done.
+    for (size_t i = 0; i < N; i++) {
+        unique_fd buffer;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            condition.wait(guard, [&]() { return dumped[i]; });
+            buffer = std::move(buffers[i]);
+        }
+        if (buffer.get() != -1) {
+            lseek(buffer.get(), 0, SEEK_SET);
+            char buf[4096];
+            ssize_t rc;
+            while ((rc = TEMP_FAILURE_RETRY(read(buffer.get(), buf, sizeof(buf)))) > 0) {
+                if (!WriteFully(STDOUT_FILENO, buf, rc)) {
+                    break;
+                }
             }
-            bool dumpComplete = (status == OK);
-            stopDumpThread(dumpComplete);
         }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            nextOutput = i + 1;
+        }
+        condition.notify_all();
     }
 
-    return 0;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
 }
 
 Vector<String16> Dumpsys::listServices(int priorityFilterFlags, bool filterByProto) const {
@@ -352,6 +468,21 @@ static status_t dumpThreadsToFd(const sp<IBinder>& service, const unique_fd& fd)
     return OK;
 }
 
+static status_t binderStatsToFd(const sp<IBinder>& service, const Vector<String16>& args,
+                                const unique_fd& fd) {
+    IBinder::BinderStatsCommand command = IBinder::BinderStatsCommand::DUMP;
+    if (!args.empty()) {
+        if (args[0] == String16("enable")) {
+            command = IBinder::BinderStatsCommand::ENABLE;
+        } else if (args[0] == String16("disable")) {
+            command = IBinder::BinderStatsCommand::DISABLE;
+        } else if (args[0] == String16("reset")) {
+            command = IBinder::BinderStatsCommand::RESET;
+        }
+    }
+    return service->binderStatsCommand(command, fd.get());
+}
+
 status_t Dumpsys::startDumpThread(Type type, const String16& serviceName,
                                   const Vector<String16>& args) {
     sp<IBinder> service = sm_->checkService(serviceName);
@@ -385,6 +516,9 @@ status_t Dumpsys::startDumpThread(Type type, const String16& serviceName,
         case Type::THREAD:
             err = dumpThreadsToFd(service, remote_end);
             break;
+        case Type::BINDER_STATS:
+            err = binderStatsToFd(service, args, remote_end);
+            break;
         default:
             std::cerr << "Unknown dump type" << static_cast<int>(type) << std::endl;
             return;
@@ -17,6 +17,7 @@
 #ifndef FRAMEWORK_NATIVE_CMD_DUMPSYS_H_
 #define FRAMEWORK_NATIVE_CMD_DUMPSYS_H_
 
+#include <chrono>
 #include <thread>
 
 #include <android-base/unique_fd.h>
@@ -55,6 +56,7 @@ class Dumpsys {
         DUMP,    // dump using `dump` function
         PID,     // dump pid of server only
         THREAD,  // dump thread usage of server only
+        BINDER_STATS,  // dump or control per-method binder latency stats of server only
     };
 
     /**
@@ -123,6 +125,21 @@ class Dumpsys {
     }
 
   private:
+    /**
+     * Dumps a service to a file descriptor, with a header and footer if {@code addSeparator}.
+     */
+    void dumpService(int fd, Type type, const String16& serviceName, const Vector<String16>& args,
+                     int priorityFlags, bool asProto, std::chrono::milliseconds timeout,
+                     bool addSeparator);
+
+    /**
+     * Dumps services on up to {@code numThreads} threads at once, buffering each dump, and
+     * writes them to stdout in the order of {@code services}.
+     */
+    void dumpServicesInParallel(const Vector<String16>& services, Type type,
+                                const Vector<String16>& args, int priorityFlags, bool asProto,
+                                std::chrono::milliseconds timeout, size_t numThreads);
+
     android::IServiceManager* sm_;
     std::thread activeThread_;
     mutable android::base::unique_fd redirectFd_;
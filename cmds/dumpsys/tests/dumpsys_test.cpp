@@ -447,6 +447,30 @@ TEST_F(DumpsysTest, DumpMultipleServices) {
     AssertDumped("running3", "dump3");
 }
 
+// Tests 'dumpsys -T 500 --parallel 2' with a service that times out after 1s
+TEST_F(DumpsysTest, DumpMultipleServicesInParallel) {
+    ExpectListServices({"running1", "hanging2", "stopped3", "running4"});
+    ExpectDump("running1", "dump1");
+    sp<BinderMock> binder_mock = ExpectDumpAndHang("hanging2", 1, "dump2");
+    ExpectCheckService("stopped3", false);
+    ExpectDump("running4", "dump4");
+
+    CallMain({"-T", "500", "--parallel", "2"});
+
+    AssertRunningServices({"running1", "hanging2", "running4"});
+    AssertDumped("running1", "dump1");
+    AssertOutputContains("SERVICE 'hanging2' DUMP TIMEOUT (500ms) EXPIRED");
+    AssertNotDumped("dump2");
+    AssertStopped("stopped3");
+    AssertDumped("running4", "dump4");
+    // The dumps are written in the order of the services, whichever finishes first
+    AssertOutputFormat("(.|\n)*DUMP OF SERVICE running1:(.|\n)*DUMP OF SERVICE hanging2:(.|\n)*"
+                       "DUMP OF SERVICE running4:(.|\n)*");
+
+    // TODO(b/65056227): BinderMock is not destructed because thread is detached on dumpsys.cpp
+    Mock::AllowLeak(binder_mock.get());
+}
+
 // Tests 'dumpsys --skip skipped3 skipped5', which should skip these services
 TEST_F(DumpsysTest, DumpWithSkip) {
     ExpectListServices({"running1", "stopped2", "skipped3", "running4", "skipped5"});
@@ -606,6 +630,15 @@ TEST_F(DumpsysTest, ListServiceWithThread) {
     AssertOutputFormat(format);
 }
 
+// Tests 'dumpsys --binder-stats service_name'
+TEST_F(DumpsysTest, BinderStatsForService) {
+    ExpectCheckService("Locksmith");
+
+    CallMain({"--binder-stats", "Locksmith"});
+
+    AssertOutputContains("Binder stats for pid " + std::to_string(getpid()));
+}
+
 TEST_F(DumpsysTest, GetBytesWritten) {
     const char* serviceName = "service2";
     const char* dumpContents = "dump1";
@@ -18,6 +18,8 @@
 
 #include "CacheTracker.h"
 
+#include <algorithm>
+
 #include <fts.h>
 #include <sys/xattr.h>
 #include <utils/Trace.h>
@@ -171,22 +173,33 @@ void CacheTracker::loadItems() {
     }
     ATRACE_END();
 
-    ATRACE_BEGIN("sortItems");
-    auto cmp = [](std::shared_ptr<CacheItem> left, std::shared_ptr<CacheItem> right) {
-        // TODO: sort dotfiles last
-        // TODO: sort code_cache last
-        if (left->modified != right->modified) {
-            return (left->modified > right->modified);
-        }
-        if (left->level != right->level) {
-            return (left->level < right->level);
-        }
-        return left->directory;
-    };
-    std::stable_sort(items.begin(), items.end(), cmp);
+    // Only a fraction of the items is usually purged before enough space is free, so keep them in
+    // a heap instead of fully sorting them.
+    ATRACE_BEGIN("heapifyItems");
+    std::make_heap(items.begin(), items.end(), compareItems);
     ATRACE_END();
 }
 
+bool CacheTracker::compareItems(const std::shared_ptr<CacheItem>& left,
+                                const std::shared_ptr<CacheItem>& right) {
+    // TODO: sort dotfiles last
+    // TODO: sort code_cache last
+    if (left->modified != right->modified) {
+        return (left->modified > right->modified);
+    }
+    if (left->level != right->level) {
+        return (left->level < right->level);
+    }
+    return left->directory && !right->directory;
+}
+
+std::shared_ptr<CacheItem> CacheTracker::popItem() {
+    std::pop_heap(items.begin(), items.end(), compareItems);
+    auto item = items.back();
+    items.pop_back();
+    return item;
+}
+
 void CacheTracker::ensureItems() {
     if (mItemsLoaded) {
         return;
@@ -53,9 +53,13 @@ public:
 
     int getCacheRatio();
 
+    // Removes and returns the item that should be purged next. items must not be empty.
+    std::shared_ptr<CacheItem> popItem();
+
     int64_t cacheUsed;
     int64_t cacheQuota;
 
+    // Loaded items, kept as a heap that has the next item to purge at its front.
     std::vector<std::shared_ptr<CacheItem>> items;
 
 private:
@@ -69,6 +73,10 @@ private:
     bool loadQuotaStats();
     void loadItemsFrom(const std::string& path);
 
+    // Orders newer items first, so that the oldest ones are purged first.
+    static bool compareItems(const std::shared_ptr<CacheItem>& left,
+                             const std::shared_ptr<CacheItem>& right);
+
     DISALLOW_COPY_AND_ASSIGN(CacheTracker);
 };
 
@@ -19,6 +19,7 @@
 #define ATRACE_TAG ATRACE_TAG_PACKAGE_MANAGER
 
 #include <algorithm>
+#include <atomic>
 #include <errno.h>
 #include <fstream>
 #include <fts.h>
@@ -38,6 +39,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
+#include <thread>
 #include <unistd.h>
 
 #include <android-base/file.h>
@@ -428,9 +430,17 @@ binder::Status InstalldNativeService::createAppData(const std::optional<std::str
         const std::string& packageName, int32_t userId, int32_t flags, int32_t appId,
         const std::string& seInfo, int32_t targetSdkVersion, int64_t* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    return createAppDataLocked(uuid, packageName, userId, flags, appId, seInfo, targetSdkVersion,
+                               _aidl_return);
+}
+
+binder::Status InstalldNativeService::createAppDataLocked(const std::optional<std::string>& uuid,
+        const std::string& packageName, int32_t userId, int32_t flags, int32_t appId,
+        const std::string& seInfo, int32_t targetSdkVersion, int64_t* _aidl_return) {
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -521,19 +531,44 @@ binder::Status InstalldNativeService::createAppData(
     return ok();
 }
 
+// Creating the data of a new user touches every installed package; a few threads are enough to
+// overlap the filesystem and SELinux work without contending on the same directories.
+static constexpr size_t MAX_CREATE_APP_DATA_THREADS = 4;
+
 binder::Status InstalldNativeService::createAppDataBatched(
         const std::vector<android::os::CreateAppDataArgs>& args,
         std::vector<android::os::CreateAppDataResult>* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
     std::lock_guard<std::recursive_mutex> lock(mLock);
 
-    std::vector<android::os::CreateAppDataResult> results;
-    for (auto arg : args) {
-        android::os::CreateAppDataResult result;
-        createAppData(arg, &result);
-        results.push_back(result);
+    // Preparing the directories of each package is independent of the others, and mostly waits
+    // on the filesystem and on restorecon, so spread the packages over a few threads. mLock is
+    // held by this thread for the whole batch, so the workers call the unlocked variant.
+    std::vector<android::os::CreateAppDataResult> results(args.size());
+    std::atomic<size_t> nextArg = 0;
+    auto create = [this, &args, &results, &nextArg]() {
+        for (size_t i = nextArg++; i < args.size(); i = nextArg++) {
+            const android::os::CreateAppDataArgs& arg = args[i];
+            int64_t ceDataInode = -1;
+            auto status = createAppDataLocked(arg.uuid, arg.packageName, arg.userId, arg.flags,
+                                              arg.appId, arg.seInfo, arg.targetSdkVersion,
+                                              &ceDataInode);
+            results[i].ceDataInode = ceDataInode;
+            results[i].exceptionCode = status.exceptionCode();
+            results[i].exceptionMessage = status.exceptionMessage();
+        }
+    };
+    const size_t numThreads = std::min({args.size(), MAX_CREATE_APP_DATA_THREADS,
+            static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency()))});
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; i++) {
+        threads.emplace_back(create);
+    }
+    create();
+    for (std::thread& thread : threads) {
+        thread.join();
     }
-    *_aidl_return = results;
+    *_aidl_return = std::move(results);
     return ok();
 }
 
@@ -968,7 +1003,7 @@ binder::Status InstalldNativeService::snapshotAppData(
 
         // Check if we have data to copy.
         if (access(from.c_str(), F_OK) == 0) {
-          rc = copy_directory_recursive(from.c_str(), to.c_str());
+          rc = copy_directory_tree(from, to);
         }
         if (rc != 0) {
             res = error(rc, "Failed copying " + from + " to " + to);
@@ -1018,7 +1053,7 @@ binder::Status InstalldNativeService::snapshotAppData(
             return error(rc, "Failed clearing existing snapshot " + rollback_package_path);
         }
 
-        rc = copy_directory_recursive(from.c_str(), to.c_str());
+        rc = copy_directory_tree(from, to);
         if (rc != 0) {
             res = error(rc, "Failed copying " + from + " to " + to);
             clear_ce_on_exit = true;
@@ -1082,7 +1117,7 @@ binder::Status InstalldNativeService::restoreAppDataSnapshot(
 
     if (needs_ce_rollback) {
         auto to_ce = create_data_user_ce_path(volume_uuid, user);
-        int rc = copy_directory_recursive(from_ce.c_str(), to_ce.c_str());
+        int rc = copy_directory_tree(from_ce, to_ce);
         if (rc != 0) {
             res = error(rc, "Failed copying " + from_ce + " to " + to_ce);
             return res;
@@ -1092,7 +1127,7 @@ binder::Status InstalldNativeService::restoreAppDataSnapshot(
 
     if (needs_de_rollback) {
         auto to_de = create_data_user_de_path(volume_uuid, user);
-        int rc = copy_directory_recursive(from_de.c_str(), to_de.c_str());
+        int rc = copy_directory_tree(from_de, to_de);
         if (rc != 0) {
             if (needs_ce_rollback) {
                 auto ce_data = create_data_user_ce_package_path(volume_uuid, user, package_name);
@@ -1424,7 +1459,8 @@ binder::Status InstalldNativeService::freeCache(const std::optional<std::string>
         // 2. Populate tracker stats and insert into priority queue
         ATRACE_BEGIN("populate");
         int64_t cacheTotal = 0;
-        auto cmp = [](std::shared_ptr<CacheTracker> left, std::shared_ptr<CacheTracker> right) {
+        auto cmp = [](const std::shared_ptr<CacheTracker>& left,
+                const std::shared_ptr<CacheTracker>& right) {
             return (left->getCacheRatio() < right->getCacheRatio());
         };
         std::priority_queue<std::shared_ptr<CacheTracker>,
@@ -1475,8 +1511,7 @@ binder::Status InstalldNativeService::freeCache(const std::optional<std::string>
                 active = nullptr;
                 continue;
             } else {
-                auto item = active->items.back();
-                active->items.pop_back();
+                auto item = active->popItem();
 
                 LOG(DEBUG) << "Purging " << item->toString() << " from " << active->toString();
                 if (!noop) {
@@ -1644,30 +1679,24 @@ static void collectManualStats(const std::string& path, struct stats* stats) {
         }
         return;
     }
+    // Subdirectories are measured together at the end, so that they can be walked in parallel
+    std::vector<std::string> subdirPaths;
+    std::vector<bool> subdirIsCache;
     dfd = dirfd(d);
     while ((de = readdir(d))) {
         const char *name = de->d_name;
 
-        int64_t size = 0;
-        if (fstatat(dfd, name, &s, AT_SYMLINK_NOFOLLOW) == 0) {
-            size = s.st_blocks * 512;
-        }
-
         if (de->d_type == DT_DIR) {
-            if (!strcmp(name, ".")) {
-                // Don't recurse, but still count node size
-            } else if (!strcmp(name, "..")) {
+            if (!strcmp(name, "..")) {
                 // Don't recurse or count node size
                 continue;
-            } else {
+            } else if (strcmp(name, ".")) {
                 // Measure all children nodes
-                size = 0;
-                calculate_tree_size(StringPrintf("%s/%s", path.c_str(), name), &size);
-            }
-
-            if (!strcmp(name, "cache") || !strcmp(name, "code_cache")) {
-                stats->cacheSize += size;
+                subdirPaths.push_back(StringPrintf("%s/%s", path.c_str(), name));
+                subdirIsCache.push_back(!strcmp(name, "cache") || !strcmp(name, "code_cache"));
+                continue;
             }
+            // Don't recurse, but still count node size
         }
 
         // Legacy symlink isn't owned by app
@@ -1676,9 +1705,20 @@ static void collectManualStats(const std::string& path, struct stats* stats) {
         }
 
         // Everything found inside is considered data
-        stats->dataSize += size;
+        if (fstatat(dfd, name, &s, AT_SYMLINK_NOFOLLOW) == 0) {
+            stats->dataSize += s.st_blocks * 512;
+        }
     }
     closedir(d);
+
+    std::vector<int64_t> subdirSizes;
+    calculate_tree_sizes(subdirPaths, &subdirSizes);
+    for (size_t i = 0; i < subdirPaths.size(); i++) {
+        if (subdirIsCache[i]) {
+            stats->cacheSize += subdirSizes[i];
+        }
+        stats->dataSize += subdirSizes[i];
+    }
 }
 
 static void collectManualStatsForUser(const std::string& path, struct stats* stats,
@@ -2004,6 +2044,8 @@ binder::Status InstalldNativeService::getUserSize(const std::optional<std::strin
     }
 
     if (flags & FLAG_USE_QUOTA) {
+        ScopedQuotaSnapshot quotaSnapshot(uuidString);
+
         ATRACE_BEGIN("code");
         calculate_tree_size(create_data_app_path(uuid_), &stats.codeSize, -1, -1, true);
         ATRACE_END();
@@ -2138,6 +2180,8 @@ binder::Status InstalldNativeService::getExternalSize(const std::optional<std::s
     }
 
     if (flags & FLAG_USE_QUOTA) {
+        ScopedQuotaSnapshot quotaSnapshot(uuidString);
+
         ATRACE_BEGIN("quota");
         auto sizes = getExternalSizesForUserWithQuota(uuidString, userId, appIds);
         totalSize = sizes.totalSize;
@@ -2365,6 +2409,41 @@ binder::Status InstalldNativeService::mergeProfiles(int32_t uid, const std::stri
     return ok();
 }
 
+// Each merge forks a single-threaded profman, so run a few at once to overlap their startup and
+// I/O without competing with the foreground for the CPUs.
+static constexpr size_t MAX_MERGE_PROFILES_THREADS = 4;
+
+binder::Status InstalldNativeService::mergeProfilesBatched(
+        const std::vector<android::os::MergeProfilesArgs>& args,
+        std::vector<int32_t>* _aidl_return) {
+    ENFORCE_UID(AID_SYSTEM);
+    for (const auto& arg : args) {
+        CHECK_ARGUMENT_PACKAGE_NAME(arg.packageName);
+    }
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    std::vector<int32_t> results(args.size());
+    std::atomic<size_t> nextArg = 0;
+    auto merge = [&args, &results, &nextArg]() {
+        for (size_t i = nextArg++; i < args.size(); i = nextArg++) {
+            results[i] = analyze_primary_profiles(args[i].uid, args[i].packageName,
+                                                  args[i].profileName);
+        }
+    };
+    const size_t numThreads = std::min({args.size(), MAX_MERGE_PROFILES_THREADS,
+            static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency()))});
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; i++) {
+        threads.emplace_back(merge);
+    }
+    merge();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    *_aidl_return = std::move(results);
+    return ok();
+}
+
 binder::Status InstalldNativeService::createProfileSnapshot(int32_t appId,
         const std::string& packageName, const std::string& profileName,
         const std::string& classpath, bool* _aidl_return) {
@@ -2393,6 +2472,31 @@ static const char* getCStr(const std::optional<std::string>& data,
         const char* default_value = nullptr) {
     return data ? data->c_str() : default_value;
 }
+static size_t getMaxParallelDexopts() {
+    // Each dex2oat already uses several threads (dalvik.vm.dex2oat-threads), so only run a few
+    // at once by default.
+    const size_t numCpus = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    return android::base::GetUintProperty<size_t>("dalvik.vm.dexopt-max-parallel-jobs",
+                                                  std::max<size_t>(1, numCpus / 4));
+}
+
+void InstalldNativeService::acquireDexoptSlot(const std::string& key) {
+    static const size_t sMaxParallelDexopts = getMaxParallelDexopts();
+    std::unique_lock<std::mutex> lock(mDexoptLock);
+    mDexoptCondition.wait(lock, [this, &key] {
+        return mRunningDexopts.size() < sMaxParallelDexopts && mRunningDexopts.count(key) == 0;
+    });
+    mRunningDexopts.insert(key);
+}
+
+void InstalldNativeService::releaseDexoptSlot(const std::string& key) {
+    {
+        std::lock_guard<std::mutex> lock(mDexoptLock);
+        mRunningDexopts.erase(key);
+    }
+    mDexoptCondition.notify_all();
+}
+
 binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t uid,
         const std::optional<std::string>& packageName, const std::string& instructionSet,
         int32_t dexoptNeeded, const std::optional<std::string>& outputPath, int32_t dexFlags,
@@ -2410,10 +2514,17 @@ binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t
     }
     CHECK_ARGUMENT_PATH(outputPath);
     CHECK_ARGUMENT_PATH(dexMetadataPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    // dex2oat can run for a long time, so it runs outside of mLock. Concurrent dexopt calls are
+    // limited by the dexopt slots instead, which also keep two calls from writing the same output.
+    const std::string dexoptKey = apkPath + ":" + instructionSet;
+    acquireDexoptSlot(dexoptKey);
+    auto releaseSlot =
+            android::base::make_scope_guard([this, &dexoptKey] { releaseDexoptSlot(dexoptKey); });
 
     const char* oat_dir = getCStr(outputPath);
     const char* instruction_set = instructionSet.c_str();
+    // createOatDir takes mLock.
     if (oat_dir != nullptr && !createOatDir(oat_dir, instruction_set).isOk()) {
         // Can't create oat dir - let dexopt use cache dir.
         oat_dir = nullptr;
@@ -2704,6 +2815,9 @@ binder::Status InstalldNativeService::installApkVerity(const std::string& filePa
 #endif
     // TODO: also check fsverity support in the current file system if compiled with DEBUG.
     // TODO: change ashmem to some temporary file to support huge apk.
+    // The Merkle tree is built by the caller, which already has the apk open to verify its
+    // signature; installd only appends the tree and enables verity. Work on building the tree
+    // faster belongs on that side.
     if (!ashmem_valid(verityInputAshmem.get())) {
         return error("FD is not an ashmem");
     }
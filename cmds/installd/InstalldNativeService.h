@@ -21,8 +21,11 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include <condition_variable>
+#include <mutex>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <android-base/macros.h>
 #include <binder/BinderService.h>
@@ -126,6 +129,8 @@ public:
 
     binder::Status mergeProfiles(int32_t uid, const std::string& packageName,
             const std::string& profileName, int* _aidl_return);
+    binder::Status mergeProfilesBatched(const std::vector<android::os::MergeProfilesArgs>& args,
+            std::vector<int32_t>* _aidl_return);
     binder::Status dumpProfiles(int32_t uid, const std::string& packageName,
             const std::string& profileName, const std::string& codePath, bool* _aidl_return);
     binder::Status copySystemProfile(const std::string& systemProfile,
@@ -187,6 +192,21 @@ private:
     /* Map from UID to cache quota size */
     std::unordered_map<uid_t, int64_t> mCacheQuotas;
 
+    /* Running dexopt calls, keyed by apk path and instruction set */
+    std::mutex mDexoptLock;
+    std::condition_variable mDexoptCondition;
+    std::unordered_set<std::string> mRunningDexopts;
+
+    // Block until fewer than the maximum number of dexopt calls are running, and none for key.
+    void acquireDexoptSlot(const std::string& key);
+    void releaseDexoptSlot(const std::string& key);
+
+    // Same as createAppData(), for callers that already hold mLock or run on behalf of one that
+    // does. Doesn't check the calling uid.
+    binder::Status createAppDataLocked(const std::optional<std::string>& uuid,
+            const std::string& packageName, int32_t userId, int32_t flags, int32_t appId,
+            const std::string& seInfo, int32_t targetSdkVersion, int64_t* _aidl_return);
+
     std::string findDataMediaPath(const std::optional<std::string>& uuid, userid_t userid);
 };
 
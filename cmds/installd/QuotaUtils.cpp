@@ -16,7 +16,9 @@
 
 #include "QuotaUtils.h"
 
+#include <chrono>
 #include <fstream>
+#include <mutex>
 #include <unordered_map>
 
 #include <sys/quota.h>
@@ -28,25 +30,134 @@
 namespace android {
 namespace installd {
 
+struct ScopedQuotaSnapshot::Snapshot {
+    std::string device;
+    std::chrono::steady_clock::time_point time;
+    std::unordered_map<uint32_t, int64_t> spaceByUid;
+    std::unordered_map<uint32_t, int64_t> spaceByGid;
+    std::unordered_map<uint32_t, int64_t> spaceByProjectId;
+};
+
 namespace {
 
+using Snapshot = ScopedQuotaSnapshot::Snapshot;
+
+/* How long a snapshot is reused for by later measurements */
+constexpr std::chrono::seconds kSnapshotMaxAge(1);
+
 std::recursive_mutex mMountsLock;
 
 /* Map of all quota mounts from target to source */
 std::unordered_map<std::string, std::string> mQuotaReverseMounts;
 
+std::mutex mSnapshotLock;
+
+/* The last snapshot taken, for reuse by other measurements */
+std::shared_ptr<const Snapshot> mLastSnapshot;
+
+/* Set once Q_GETNEXTQUOTA turns out not to be supported */
+bool mNextQuotaUnsupported = false;
+
+/* The snapshot of the ScopedQuotaSnapshot this thread is in */
+thread_local std::shared_ptr<const Snapshot> tCurrentSnapshot;
+
 std::string FindQuotaDeviceForUuid(const std::string& uuid) {
     std::lock_guard<std::recursive_mutex> lock(mMountsLock);
     auto path = create_data_path(uuid.empty() ? nullptr : uuid.c_str());
     return mQuotaReverseMounts[path];
 }
 
+/* Reads the occupied space of every id that has a quota of the given type */
+bool ReadAllQuotas(const std::string& device, int type,
+        std::unordered_map<uint32_t, int64_t>* spaceById) {
+    uint32_t id = 0;
+    while (true) {
+        struct if_nextdqblk dq;
+        if (quotactl(QCMD(Q_GETNEXTQUOTA, type), device.c_str(), static_cast<int>(id),
+                reinterpret_cast<char*>(&dq)) != 0) {
+            if (errno == ESRCH) {
+                // No more ids.
+                return true;
+            }
+            if (errno == EINVAL || errno == ENOSYS) {
+                mNextQuotaUnsupported = true;
+            } else {
+                PLOG(ERROR) << "Failed to quotactl " << device << " for all ids of type " << type;
+            }
+            return false;
+        }
+        (*spaceById)[dq.dqb_id] = dq.dqb_curspace;
+        if (dq.dqb_id == UINT32_MAX) {
+            return true;
+        }
+        id = dq.dqb_id + 1;
+    }
+}
+
+std::shared_ptr<const Snapshot> GetSnapshot(const std::string& device) {
+    std::lock_guard<std::mutex> lock(mSnapshotLock);
+    const auto now = std::chrono::steady_clock::now();
+    if (mLastSnapshot != nullptr && mLastSnapshot->device == device &&
+            now - mLastSnapshot->time < kSnapshotMaxAge) {
+        return mLastSnapshot;
+    }
+    if (mNextQuotaUnsupported) {
+        return nullptr;
+    }
+
+    // Taking the snapshot under the lock makes concurrent measurements wait for it and share it.
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->device = device;
+    snapshot->time = now;
+    if (!ReadAllQuotas(device, USRQUOTA, &snapshot->spaceByUid) ||
+            !ReadAllQuotas(device, GRPQUOTA, &snapshot->spaceByGid) ||
+            !ReadAllQuotas(device, PRJQUOTA, &snapshot->spaceByProjectId)) {
+        return nullptr;
+    }
+    mLastSnapshot = snapshot;
+    return snapshot;
+}
+
+/*
+ * Looks up an id in this thread's snapshot of the device. Returns false if there is no such
+ * snapshot. Ids without a quota are reported as occupying no space, as quotactl does.
+ */
+bool FindInSnapshot(const std::string& device,
+        std::unordered_map<uint32_t, int64_t> Snapshot::*spaceById, uint32_t id,
+        int64_t* space) {
+    const Snapshot* snapshot = tCurrentSnapshot.get();
+    if (snapshot == nullptr || snapshot->device != device) {
+        return false;
+    }
+    const auto& spaces = snapshot->*spaceById;
+    auto it = spaces.find(id);
+    *space = it == spaces.end() ? 0 : it->second;
+    return true;
+}
+
 } // namespace
 
+ScopedQuotaSnapshot::ScopedQuotaSnapshot(const std::string& uuid)
+        : mPrevious(tCurrentSnapshot) {
+    const std::string device = FindQuotaDeviceForUuid(uuid);
+    if (device != "") {
+        tCurrentSnapshot = GetSnapshot(device);
+    }
+}
+
+ScopedQuotaSnapshot::~ScopedQuotaSnapshot() {
+    tCurrentSnapshot = mPrevious;
+}
+
 bool InvalidateQuotaMounts() {
     std::lock_guard<std::recursive_mutex> lock(mMountsLock);
 
     mQuotaReverseMounts.clear();
+    {
+        std::lock_guard<std::mutex> snapshotLock(mSnapshotLock);
+        mLastSnapshot.reset();
+        mNextQuotaUnsupported = false;
+    }
 
     std::ifstream in("/proc/mounts");
     if (!in.is_open()) {
@@ -86,6 +197,10 @@ int64_t GetOccupiedSpaceForUid(const std::string& uuid, uid_t uid) {
     if (device == "") {
         return -1;
     }
+    int64_t space;
+    if (FindInSnapshot(device, &Snapshot::spaceByUid, uid, &space)) {
+        return space;
+    }
     struct dqblk dq;
     if (quotactl(QCMD(Q_GETQUOTA, USRQUOTA), device.c_str(), uid,
             reinterpret_cast<char*>(&dq)) != 0) {
@@ -106,6 +221,10 @@ int64_t GetOccupiedSpaceForProjectId(const std::string& uuid, int projectId) {
     if (device == "") {
         return -1;
     }
+    int64_t space;
+    if (FindInSnapshot(device, &Snapshot::spaceByProjectId, projectId, &space)) {
+        return space;
+    }
     struct dqblk dq;
     if (quotactl(QCMD(Q_GETQUOTA, PRJQUOTA), device.c_str(), projectId,
             reinterpret_cast<char*>(&dq)) != 0) {
@@ -126,6 +245,10 @@ int64_t GetOccupiedSpaceForGid(const std::string& uuid, gid_t gid) {
     if (device == "") {
         return -1;
     }
+    int64_t space;
+    if (FindInSnapshot(device, &Snapshot::spaceByGid, gid, &space)) {
+        return space;
+    }
     struct dqblk dq;
     if (quotactl(QCMD(Q_GETQUOTA, GRPQUOTA), device.c_str(), gid,
             reinterpret_cast<char*>(&dq)) != 0) {
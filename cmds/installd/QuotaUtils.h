@@ -37,6 +37,30 @@ int64_t GetOccupiedSpaceForGid(const std::string& uuid, gid_t gid);
 
 /* Get the current occupied space in bytes for a project id or -1 if fails */
 int64_t GetOccupiedSpaceForProjectId(const std::string& uuid, int projectId);
+
+/*
+ * While in scope, answers the GetOccupiedSpaceFor* calls of this thread for the device with the
+ * given uuid from a snapshot of all its quotas, read in one pass per quota type. Callers that
+ * measure many apps at once use this instead of issuing quotactl for every id.
+ *
+ * Snapshots are shared with the other threads and reused for up to a second, so concurrent and
+ * back-to-back measurements only read the quotas once. Without Q_GETNEXTQUOTA support, the
+ * calls are answered by quotactl as usual.
+ */
+class ScopedQuotaSnapshot {
+public:
+    explicit ScopedQuotaSnapshot(const std::string& uuid);
+    ~ScopedQuotaSnapshot();
+
+    ScopedQuotaSnapshot(const ScopedQuotaSnapshot&) = delete;
+    ScopedQuotaSnapshot& operator=(const ScopedQuotaSnapshot&) = delete;
+
+    struct Snapshot;
+
+private:
+    std::shared_ptr<const Snapshot> mPrevious;
+};
+
 }  // namespace installd
 }  // namespace android
 
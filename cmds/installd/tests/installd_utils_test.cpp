@@ -16,7 +16,9 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/scopeguard.h>
 #include <gtest/gtest.h>
@@ -638,5 +640,68 @@ TEST_F(UtilsTest, TestCreateDirIfNeeded) {
     ASSERT_NE(0, create_dir_if_needed("/data/local/tmp/user/0/bar/baz", 0700));
 }
 
+TEST_F(UtilsTest, TestCalculateTreeSizes) {
+    system("mkdir -p /data/local/tmp/user/0/a/b /data/local/tmp/user/0/c");
+    system("dd if=/dev/zero of=/data/local/tmp/user/0/a/b/file bs=4096 count=4 2>/dev/null");
+    system("dd if=/dev/zero of=/data/local/tmp/user/0/c/file bs=4096 count=2 2>/dev/null");
+
+    auto deleter = [&]() {
+        delete_dir_contents_and_dir("/data/local/tmp/user/0", true /* ignore_if_missing */);
+    };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+
+    const std::vector<std::string> paths = {"/data/local/tmp/user/0/a",
+                                            "/data/local/tmp/user/0/missing",
+                                            "/data/local/tmp/user/0/c"};
+    std::vector<int64_t> sizes;
+    calculate_tree_sizes(paths, &sizes);
+    ASSERT_EQ(paths.size(), sizes.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        int64_t expected = 0;
+        calculate_tree_size(paths[i], &expected);
+        EXPECT_EQ(expected, sizes[i]) << paths[i];
+    }
+    EXPECT_EQ(0, sizes[1]);
+    EXPECT_GT(sizes[0], sizes[2]);
+}
+
+TEST_F(UtilsTest, TestCopyDirectoryTree) {
+    system("mkdir -p /data/local/tmp/user/0/from/pkg/a /data/local/tmp/user/0/to/pkg");
+    system("echo hello > /data/local/tmp/user/0/from/pkg/a/file");
+    system("dd if=/dev/zero of=/data/local/tmp/user/0/from/pkg/big bs=4096 count=64 2>/dev/null");
+    system("ln -s a/file /data/local/tmp/user/0/from/pkg/link");
+    system("chmod 0751 /data/local/tmp/user/0/from/pkg/a");
+    system("echo stale > /data/local/tmp/user/0/to/pkg/big");
+
+    auto deleter = [&]() {
+        delete_dir_contents_and_dir("/data/local/tmp/user/0", true /* ignore_if_missing */);
+    };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+
+    CopyTreeStats stats;
+    ASSERT_EQ(0, copy_directory_tree("/data/local/tmp/user/0/from/pkg",
+                                     "/data/local/tmp/user/0/to", &stats));
+    EXPECT_EQ(2, stats.files);
+    EXPECT_EQ(6 + 4096 * 64, stats.bytes_cloned + stats.bytes_copied);
+
+    std::string contents;
+    ASSERT_TRUE(android::base::ReadFileToString("/data/local/tmp/user/0/to/pkg/a/file",
+                                                &contents));
+    EXPECT_EQ("hello\n", contents);
+    struct stat from_st, to_st;
+    ASSERT_EQ(0, stat("/data/local/tmp/user/0/to/pkg/big", &to_st));
+    EXPECT_EQ(4096 * 64, to_st.st_size);
+
+    ASSERT_EQ(0, stat("/data/local/tmp/user/0/from/pkg/a", &from_st));
+    ASSERT_EQ(0, stat("/data/local/tmp/user/0/to/pkg/a", &to_st));
+    EXPECT_EQ(from_st.st_mode, to_st.st_mode);
+    EXPECT_EQ(from_st.st_mtim.tv_sec, to_st.st_mtim.tv_sec);
+    EXPECT_EQ(from_st.st_mtim.tv_nsec, to_st.st_mtim.tv_nsec);
+
+    std::string target;
+    ASSERT_TRUE(android::base::Readlink("/data/local/tmp/user/0/to/pkg/link", &target));
+    EXPECT_EQ("a/file", target);
+}
+
 }  // namespace installd
 }  // namespace android
@@ -19,13 +19,21 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <fts.h>
+#include <linux/fs.h>
 #include <stdlib.h>
 #include <sys/capability.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
 #include <sys/statvfs.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
@@ -429,6 +437,31 @@ int calculate_tree_size(const std::string& path, int64_t* size,
     return 0;
 }
 
+// Walking trees is mostly bound by metadata reads, so a few threads are enough to keep the
+// storage busy without thrashing it.
+static constexpr size_t MAX_TREE_SIZE_THREADS = 4;
+
+void calculate_tree_sizes(const std::vector<std::string>& paths, std::vector<int64_t>* sizes) {
+    sizes->assign(paths.size(), 0);
+    std::atomic<size_t> nextPath = 0;
+    // Each thread takes the next unmeasured path, so a large tree doesn't hold up the others.
+    auto measure = [&paths, sizes, &nextPath]() {
+        for (size_t i = nextPath++; i < paths.size(); i = nextPath++) {
+            calculate_tree_size(paths[i], &(*sizes)[i]);
+        }
+    };
+    const size_t numThreads = std::min({paths.size(), MAX_TREE_SIZE_THREADS,
+            static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency()))});
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; i++) {
+        threads.emplace_back(measure);
+    }
+    measure();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
 /**
  * Checks whether the package name is valid. Returns -1 on error and
  * 0 on success.
@@ -714,6 +747,229 @@ int copy_dir_files(const char *srcname,
     return res;
 }
 
+struct CopyTreeFile {
+    std::string from;
+    std::string to;
+    struct stat st;
+};
+
+// Applies the ownership, mode and timestamps of st to path, like "cp -p".
+static int copy_tree_metadata(const std::string& path, const struct stat& st) {
+    if (lchown(path.c_str(), st.st_uid, st.st_gid) != 0) {
+        PLOG(ERROR) << "Failed to chown " << path;
+        return -1;
+    }
+    if (!S_ISLNK(st.st_mode) && chmod(path.c_str(), st.st_mode & 07777) != 0) {
+        PLOG(ERROR) << "Failed to chmod " << path;
+        return -1;
+    }
+    const struct timespec times[2] = {st.st_atim, st.st_mtim};
+    if (utimensat(AT_FDCWD, path.c_str(), times, AT_SYMLINK_NOFOLLOW) != 0) {
+        PLOG(ERROR) << "Failed to set timestamps of " << path;
+        return -1;
+    }
+    return 0;
+}
+
+// Copies the contents of from_fd into to_fd with copy_file_range, falling back to read and write
+// when the kernel can't copy between the two files.
+static int copy_file_contents(int from_fd, int to_fd, int64_t size) {
+    int64_t remaining = size;
+    while (remaining > 0) {
+        ssize_t copied = syscall(__NR_copy_file_range, from_fd, nullptr, to_fd, nullptr,
+                static_cast<size_t>(remaining), 0);
+        if (copied < 0 && remaining == size &&
+                (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+            break;
+        }
+        if (copied <= 0) {
+            return copied == 0 ? 0 : -1;
+        }
+        remaining -= copied;
+    }
+    if (remaining == 0) {
+        return 0;
+    }
+
+    char buf[64 * 1024];
+    ssize_t read_size;
+    while ((read_size = TEMP_FAILURE_RETRY(read(from_fd, buf, sizeof(buf)))) > 0) {
+        if (!android::base::WriteFully(to_fd, buf, read_size)) {
+            return -1;
+        }
+    }
+    return read_size == 0 ? 0 : -1;
+}
+
+// Copies a regular file, replacing any existing destination. cloned is set if the file was copied
+// as a reflink, sharing the blocks of the source.
+static int copy_tree_file(const CopyTreeFile& file, bool* cloned) {
+    unique_fd from_fd(open(file.from.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW));
+    if (from_fd == -1) {
+        PLOG(ERROR) << "Failed to open " << file.from;
+        return -1;
+    }
+    if (unlink(file.to.c_str()) != 0 && errno != ENOENT) {
+        PLOG(ERROR) << "Failed to remove existing " << file.to;
+        return -1;
+    }
+    unique_fd to_fd(open(file.to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC | O_NOFOLLOW,
+            0600));
+    if (to_fd == -1) {
+        PLOG(ERROR) << "Failed to create " << file.to;
+        return -1;
+    }
+
+    *cloned = ioctl(to_fd.get(), FICLONE, from_fd.get()) == 0;
+    if (!*cloned && copy_file_contents(from_fd.get(), to_fd.get(), file.st.st_size) != 0) {
+        PLOG(ERROR) << "Failed to copy " << file.from << " to " << file.to;
+        return -1;
+    }
+
+    // Change the owner first, since chown clears the setuid and setgid bits.
+    if (fchown(to_fd.get(), file.st.st_uid, file.st.st_gid) != 0 ||
+            fchmod(to_fd.get(), file.st.st_mode & 07777) != 0) {
+        PLOG(ERROR) << "Failed to set owner and mode of " << file.to;
+        return -1;
+    }
+    const struct timespec times[2] = {file.st.st_atim, file.st.st_mtim};
+    if (futimens(to_fd.get(), times) != 0) {
+        PLOG(ERROR) << "Failed to set timestamps of " << file.to;
+        return -1;
+    }
+    return 0;
+}
+
+// Copying files is mostly bound by I/O, which a few threads are enough to keep busy.
+static constexpr size_t MAX_COPY_TREE_THREADS = 4;
+
+int copy_directory_tree(const std::string& from, const std::string& to_parent,
+        CopyTreeStats* stats) {
+    const auto start = std::chrono::steady_clock::now();
+    std::string source = from;
+    while (source.size() > 1 && EndsWith(source, "/")) {
+        source.pop_back();
+    }
+    const std::string destination = to_parent + "/" + android::base::Basename(source);
+
+    char* argv[] = {const_cast<char*>(source.c_str()), nullptr};
+    FTS* fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, nullptr);
+    if (fts == nullptr) {
+        PLOG(ERROR) << "Failed to fts_open " << source;
+        return -1;
+    }
+
+    // Create the directories and symlinks while walking the tree, and collect the regular files
+    // to be copied afterwards on several threads.
+    std::vector<CopyTreeFile> dirs;
+    std::vector<CopyTreeFile> files;
+    int res = 0;
+    FTSENT* p;
+    while (res == 0 && (p = fts_read(fts)) != nullptr) {
+        const std::string to = destination + (p->fts_path + source.size());
+        switch (p->fts_info) {
+        case FTS_D:
+            if (mkdir(to.c_str(), 0700) != 0 && errno != EEXIST) {
+                PLOG(ERROR) << "Failed to mkdir " << to;
+                res = -1;
+                break;
+            }
+            dirs.push_back({p->fts_path, to, *p->fts_statp});
+            break;
+        case FTS_F:
+            files.push_back({p->fts_path, to, *p->fts_statp});
+            break;
+        case FTS_SL:
+        case FTS_SLNONE: {
+            std::string target;
+            if (!android::base::Readlink(p->fts_path, &target)) {
+                PLOG(ERROR) << "Failed to readlink " << p->fts_path;
+                res = -1;
+                break;
+            }
+            if ((unlink(to.c_str()) != 0 && errno != ENOENT) ||
+                    symlink(target.c_str(), to.c_str()) != 0) {
+                PLOG(ERROR) << "Failed to create symlink " << to;
+                res = -1;
+                break;
+            }
+            res = copy_tree_metadata(to, *p->fts_statp);
+            break;
+        }
+        case FTS_DP:
+            break;
+        case FTS_DEFAULT:
+            if (S_ISFIFO(p->fts_statp->st_mode)) {
+                if ((unlink(to.c_str()) != 0 && errno != ENOENT) || mkfifo(to.c_str(), 0600) != 0) {
+                    PLOG(ERROR) << "Failed to create fifo " << to;
+                    res = -1;
+                    break;
+                }
+                res = copy_tree_metadata(to, *p->fts_statp);
+            } else {
+                LOG(WARNING) << "Skipping special file " << p->fts_path;
+            }
+            break;
+        default:
+            LOG(ERROR) << "Failed to read " << p->fts_path << ": " << strerror(p->fts_errno);
+            res = -1;
+            break;
+        }
+    }
+    fts_close(fts);
+    if (res != 0) {
+        return res;
+    }
+
+    std::atomic<size_t> next_file = 0;
+    std::atomic<int64_t> bytes_cloned = 0;
+    std::atomic<int64_t> bytes_copied = 0;
+    std::atomic_bool failed = false;
+    auto copy = [&]() {
+        for (size_t i = next_file++; i < files.size() && !failed; i = next_file++) {
+            bool cloned = false;
+            if (copy_tree_file(files[i], &cloned) != 0) {
+                failed = true;
+                return;
+            }
+            (cloned ? bytes_cloned : bytes_copied) += files[i].st.st_size;
+        }
+    };
+    const size_t num_threads = std::min({files.size(), MAX_COPY_TREE_THREADS,
+            static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency()))});
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_threads; i++) {
+        threads.emplace_back(copy);
+    }
+    copy();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (failed) {
+        return -1;
+    }
+
+    // Directories get their metadata last, since creating their contents updated their mtime.
+    for (auto it = dirs.rbegin(); it != dirs.rend(); it++) {
+        if (copy_tree_metadata(it->to, it->st) != 0) {
+            return -1;
+        }
+    }
+
+    const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+    LOG(INFO) << "Copied " << source << " to " << to_parent << ": " << files.size() << " files, "
+            << bytes_cloned << " bytes cloned, " << bytes_copied << " bytes copied in "
+            << duration.count() << "ms";
+    if (stats != nullptr) {
+        stats->files = files.size();
+        stats->bytes_cloned = bytes_cloned;
+        stats->bytes_copied = bytes_copied;
+        stats->duration_ms = duration.count();
+    }
+    return 0;
+}
+
 int64_t data_disk_free(const std::string& data_path) {
     struct statvfs sfs;
     if (statvfs(data_path.c_str(), &sfs) == 0) {
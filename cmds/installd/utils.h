@@ -109,6 +109,9 @@ std::vector<userid_t> get_known_users(const char* volume_uuid);
 
 int calculate_tree_size(const std::string& path, int64_t* size,
         int32_t include_gid = -1, int32_t exclude_gid = -1, bool exclude_apps = false);
+// Same as calculate_tree_size with the default filters, but measures several trees, using a few
+// threads when there is more than one. sizes receives the size of each path, in order.
+void calculate_tree_sizes(const std::vector<std::string>& paths, std::vector<int64_t>* sizes);
 
 int create_user_config_path(char path[PKG_PATH_MAX], userid_t userid);
 
@@ -131,6 +134,22 @@ int rm_package_dir(const std::string& package_dir);
 
 int copy_dir_files(const char *srcname, const char *dstname, uid_t owner, gid_t group);
 
+struct CopyTreeStats {
+    int64_t files = 0;
+    // Bytes of regular files shared with the source through reflinks
+    int64_t bytes_cloned = 0;
+    // Bytes of regular files that had to be copied
+    int64_t bytes_copied = 0;
+    int64_t duration_ms = 0;
+};
+
+// Copies the directory from into the directory to_parent, like "cp -F -p -R -P -d" would,
+// preserving ownership, modes and timestamps and replacing existing files. Regular files are
+// cloned on filesystems that support reflinks, and otherwise copied in process on a few threads.
+// Returns 0 on success and -1 on failure, in which case the copy may be partial.
+int copy_directory_tree(const std::string& from, const std::string& to_parent,
+        CopyTreeStats* stats = nullptr);
+
 int64_t data_disk_free(const std::string& data_path);
 
 int get_path_inode(const std::string& path, ino_t *inode);
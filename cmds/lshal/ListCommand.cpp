@@ -19,6 +19,7 @@
 #include <getopt.h>
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <functional>
 #include <iomanip>
@@ -26,6 +27,7 @@
 #include <map>
 #include <regex>
 #include <sstream>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -52,6 +54,10 @@ using ::android::hidl::manager::V1_0::IServiceManager;
 namespace android {
 namespace lshal {
 
+// Max number of binderized HALs fetched at once. Fetching is spent waiting for each HAL to
+// answer, so this does not depend on the number of CPUs.
+static constexpr size_t kMaxFetchThreads = 8;
+
 vintf::SchemaType toSchemaType(Partition p) {
     return (p == Partition::SYSTEM) ? vintf::SchemaType::FRAMEWORK : vintf::SchemaType::DEVICE;
 }
@@ -209,13 +215,16 @@ bool ListCommand::getPidInfo(
 }
 
 const BinderPidInfo* ListCommand::getPidInfoCached(pid_t serverPid) {
-    auto pair = mCachedPidInfos.insert({serverPid, BinderPidInfo{}});
-    if (pair.second /* did insertion take place? */) {
-        if (!getPidInfo(serverPid, &pair.first->second)) {
-            return nullptr;
-        }
+    CachedPidInfo* cached;
+    {
+        std::lock_guard<std::mutex> lock(mCachedPidInfosMutex);
+        cached = &mCachedPidInfos[serverPid];
     }
-    return &pair.first->second;
+    // Parse outside of the lock, so that different PIDs are parsed concurrently.
+    std::call_once(cached->fetched, [&] {
+        cached->valid = getPidInfo(serverPid, &cached->info);
+    });
+    return cached->valid ? &cached->info : nullptr;
 }
 
 bool ListCommand::shouldFetchHalType(const HalType &type) const {
@@ -585,16 +594,39 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
         return DUMP_BINDERIZED_ERROR;
     }
 
+    // Each entry needs several IPCs, each of which may time out, so entries are fetched on
+    // several threads. Warnings are buffered per entry and emitted in order afterwards.
+    const size_t count = fqInstanceNames.size();
+    std::vector<TableEntry> entries(count);
+    std::vector<Status> statuses(count, OK);
+    std::vector<std::stringstream> warnings(count);
+    std::atomic<size_t> next{0};
+    const auto fetchEntries = [&] {
+        for (size_t i = next++; i < count; i = next++) {
+            // create entry and default assign all fields.
+            TableEntry& entry = entries[i];
+            entry.interfaceName = fqInstanceNames[i];
+            entry.transport = mode;
+            entry.serviceStatus = ServiceStatus::NON_RESPONSIVE;
+
+            statuses[i] = fetchBinderizedEntry(manager, &entry, warnings[i]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(count, kMaxFetchThreads); ++i) {
+        threads.emplace_back(fetchEntries);
+    }
+    fetchEntries();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
     Status status = OK;
     std::map<std::string, TableEntry> allTableEntries;
-    for (const auto &fqInstanceName : fqInstanceNames) {
-        // create entry and default assign all fields.
-        TableEntry& entry = allTableEntries[fqInstanceName];
-        entry.interfaceName = fqInstanceName;
-        entry.transport = mode;
-        entry.serviceStatus = ServiceStatus::NON_RESPONSIVE;
-
-        status |= fetchBinderizedEntry(manager, &entry);
+    for (size_t i = 0; i < count; ++i) {
+        err() << warnings[i].str();
+        status |= statuses[i];
+        allTableEntries[fqInstanceNames[i]] = std::move(entries[i]);
     }
 
     for (auto& pair : allTableEntries) {
@@ -604,10 +636,11 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
 }
 
 Status ListCommand::fetchBinderizedEntry(const sp<IServiceManager> &manager,
-                                         TableEntry *entry) {
+                                         TableEntry *entry, std::ostream &warnings) {
     Status status = OK;
     const auto handleError = [&](Status additionalError, const std::string& msg) {
-        err() << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg << std::endl;
+        warnings << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg
+                 << std::endl;
         status |= DUMP_BINDERIZED_ERROR | additionalError;
     };
 
@@ -435,6 +435,50 @@ TEST_F(ListTest, GetPidInfoCached) {
     EXPECT_NE(nullptr, mockList->getPidInfoCached(5));
 }
 
+TEST_F(ListTest, FetchManyInstancesOfOneProcess) {
+    // Instances are fetched concurrently, but share the PID info of their process.
+    constexpr int kInstanceCount = 32;
+    EXPECT_CALL(*serviceManager, list(_)).WillRepeatedly(Invoke([](IServiceManager::list_cb cb) {
+        std::vector<hidl_string> ret;
+        for (int i = 0; i < kInstanceCount; ++i) {
+            ret.push_back(getInterfaceName(1) + "/" + std::to_string(i));
+        }
+        cb(ret);
+        return hardware::Void();
+    }));
+    EXPECT_CALL(*serviceManager, get(_, _))
+            .WillRepeatedly(Invoke([](const hidl_string&, const hidl_string& instance) {
+                // Every tenth instance is missing.
+                int id = getIdFromInstanceName(instance);
+                return id % 10 == 9 ? sp<IBase>(nullptr) : sp<IBase>(new TestService(1));
+            }));
+    EXPECT_CALL(*mockList, getPidInfo(1, _)).Times(1);
+
+    optind = 1; // mimic Lshal::parseArg()
+    ASSERT_EQ(0u, mockList->parseArgs(createArg({"lshal", "--types=b"})));
+    EXPECT_NE(0u, mockList->fetch());
+
+    int count = 0;
+    mockList->forEachTable([&](const Table& table) {
+        for (const auto& entry : table) {
+            int id = getIdFromInstanceName(splitFirst(entry.interfaceName, '/').second);
+            EXPECT_EQ(id % 10 == 9 ? ServiceStatus::NON_RESPONSIVE : ServiceStatus::ALIVE,
+                      entry.serviceStatus)
+                    << entry.to_string();
+            ++count;
+        }
+    });
+    EXPECT_EQ(kInstanceCount, count);
+
+    // Warnings are not interleaved, and keep the order of the list.
+    std::string expectedErr;
+    for (int id : {9, 19, 29}) {
+        expectedErr += "Warning: Skipping \"" + getInterfaceName(1) + "/" + std::to_string(id) +
+                "\": cannot be fetched from service manager (null)\n";
+    }
+    EXPECT_EQ(expectedErr, err.str());
+}
+
 TEST_F(ListTest, Fetch) {
     optind = 1; // mimic Lshal::parseArg()
     ASSERT_EQ(0u, mockList->parseArgs(createArg({"lshal"})));
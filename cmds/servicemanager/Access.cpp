@@ -17,7 +17,9 @@
 #include "Access.h"
 
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
 #include <binder/IPCThreadState.h>
+#include <inttypes.h>
 #include <log/log_safetynet.h>
 #include <selinux/android.h>
 #include <selinux/avc.h>
@@ -30,6 +32,10 @@ constexpr bool kIsVendor = true;
 constexpr bool kIsVendor = false;
 #endif
 
+// Every caller SID tracks the app's categories, so app-start storms bring many new ones. Bound the
+// cache rather than let it grow with every app ever started.
+constexpr size_t kMaxAllowedDecisions = 4096;
+
 static std::string getPidcon(pid_t pid) {
     android_errorWriteLog(0x534e4554, "121035042");
 
@@ -43,14 +49,16 @@ static std::string getPidcon(pid_t pid) {
     return result;
 }
 
-static struct selabel_handle* getSehandle() {
-    static struct selabel_handle* gSehandle = nullptr;
+static struct selabel_handle* gSehandle = nullptr;
 
-    if (gSehandle != nullptr && selinux_status_updated()) {
+static void closeSehandle() {
+    if (gSehandle != nullptr) {
         selabel_close(gSehandle);
         gSehandle = nullptr;
     }
+}
 
+static struct selabel_handle* getSehandle() {
     if (gSehandle == nullptr) {
         gSehandle = kIsVendor
             ? selinux_android_vendor_service_context_handle()
@@ -119,7 +127,56 @@ bool Access::canAdd(const CallingContext& ctx, const std::string& name) {
 }
 
 bool Access::canList(const CallingContext& ctx) {
-    return actionAllowed(ctx, mThisProcessContext, "list", "service_manager");
+    static const std::string kTname = "service_manager";
+    if (isCachedAllowed(ctx, kTname, "list")) {
+        return true;
+    }
+
+    bool allowed = actionAllowed(ctx, mThisProcessContext, "list", kTname);
+    if (allowed) {
+        cacheAllowed(ctx, kTname, "list");
+    }
+    return allowed;
+}
+
+std::string Access::dumpDecisionCache() const {
+    return base::StringPrintf("SELinux decision cache: %zu allowed decisions, %" PRIu64
+                              " hits, %" PRIu64 " misses, %" PRIu64 " policy updates\n",
+                              mAllowedDecisions.size(), mCacheHits, mCacheMisses, mPolicyUpdates);
+}
+
+void Access::checkPolicyUpdated() {
+    if (selinux_status_updated() == 0) {
+        return;
+    }
+
+    closeSehandle();
+    mAllowedDecisions.clear();
+    mPolicyUpdates++;
+}
+
+bool Access::isCachedAllowed(const CallingContext& sctx, const std::string& tname,
+        const char* perm) {
+    checkPolicyUpdated();
+
+    if (mAllowedDecisions.count(DecisionKey(sctx.sid, tname, perm)) != 0) {
+        mCacheHits++;
+        return true;
+    }
+    mCacheMisses++;
+    return false;
+}
+
+void Access::cacheAllowed(const CallingContext& sctx, const std::string& tname,
+        const char* perm) {
+    // An empty SID means the caller's context could not be retrieved.
+    if (sctx.sid.empty()) {
+        return;
+    }
+    if (mAllowedDecisions.size() >= kMaxAllowedDecisions) {
+        mAllowedDecisions.clear();
+    }
+    mAllowedDecisions.emplace(sctx.sid, tname, perm);
 }
 
 bool Access::actionAllowed(const CallingContext& sctx, const char* tctx, const char* perm,
@@ -136,6 +193,10 @@ bool Access::actionAllowed(const CallingContext& sctx, const char* tctx, const c
 }
 
 bool Access::actionAllowedFromLookup(const CallingContext& sctx, const std::string& name, const char *perm) {
+    if (isCachedAllowed(sctx, name, perm)) {
+        return true;
+    }
+
     char *tctx = nullptr;
     if (selabel_lookup(getSehandle(), &tctx, name.c_str(), SELABEL_CTX_ANDROID_SERVICE) != 0) {
         LOG(ERROR) << "SELinux: No match for " << name << " in service_contexts.\n";
@@ -144,6 +205,9 @@ bool Access::actionAllowedFromLookup(const CallingContext& sctx, const std::stri
 
     bool allowed = actionAllowed(sctx, tctx, perm, name);
     freecon(tctx);
+    if (allowed) {
+        cacheAllowed(sctx, name, perm);
+    }
     return allowed;
 }
 
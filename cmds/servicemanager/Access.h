@@ -16,8 +16,10 @@
 
 #pragma once
 
+#include <set>
 #include <string>
 #include <sys/types.h>
+#include <tuple>
 
 namespace android {
 
@@ -44,13 +46,30 @@ public:
     virtual bool canAdd(const CallingContext& ctx, const std::string& name);
     virtual bool canList(const CallingContext& ctx);
 
+    // Describes the decision cache, for servicemanager's dump.
+    std::string dumpDecisionCache() const;
+
 private:
     bool actionAllowed(const CallingContext& sctx, const char* tctx, const char* perm,
             const std::string& tname);
     bool actionAllowedFromLookup(const CallingContext& sctx, const std::string& name,
             const char *perm);
 
+    // Drops the service contexts and the cached decisions if the policy was reloaded or the
+    // enforcing mode changed since the last call.
+    void checkPolicyUpdated();
+    bool isCachedAllowed(const CallingContext& sctx, const std::string& tname, const char* perm);
+    void cacheAllowed(const CallingContext& sctx, const std::string& tname, const char* perm);
+
     char* mThisProcessContext = nullptr;
+
+    // Allowed decisions, keyed by caller SID, target name and permission. Denials are not cached
+    // so that every one of them still goes through selinux_check_access and is audited.
+    using DecisionKey = std::tuple<std::string, std::string, std::string>;
+    std::set<DecisionKey> mAllowedDecisions;
+    uint64_t mCacheHits = 0;
+    uint64_t mCacheMisses = 0;
+    uint64_t mPolicyUpdates = 0;
 };
 
 };
@@ -16,6 +16,7 @@
 
 #include "ServiceManager.h"
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
 #include <binder/BpBinder.h>
@@ -192,9 +193,26 @@ Status ServiceManager::checkService(const std::string& name, sp<IBinder>* outBin
     return Status::ok();
 }
 
-sp<IBinder> ServiceManager::tryGetService(const std::string& name, bool startIfNotFound) {
+Status ServiceManager::checkServices(const std::vector<std::string>& names,
+                                     std::vector<sp<IBinder>>* outBinders) {
+    // only look up the calling context once for all of the names
     auto ctx = mAccess->getCallingContext();
 
+    outBinders->clear();
+    outBinders->reserve(names.size());
+    for (const std::string& name : names) {
+        outBinders->push_back(tryGetService(ctx, name, false));
+    }
+    // returns ok regardless of result, like checkService
+    return Status::ok();
+}
+
+sp<IBinder> ServiceManager::tryGetService(const std::string& name, bool startIfNotFound) {
+    return tryGetService(mAccess->getCallingContext(), name, startIfNotFound);
+}
+
+sp<IBinder> ServiceManager::tryGetService(const Access::CallingContext& ctx,
+                                          const std::string& name, bool startIfNotFound) {
     sp<IBinder> out;
     Service* service = nullptr;
     if (auto it = mNameToService.find(name); it != mNameToService.end()) {
@@ -698,4 +716,17 @@ Status ServiceManager::getServiceDebugInfo(std::vector<ServiceDebugInfo>* outRet
     return Status::ok();
 }
 
+status_t ServiceManager::dump(int fd, const Vector<String16>& /*args*/) {
+    if (!mAccess->canList(mAccess->getCallingContext())) {
+        return PERMISSION_DENIED;
+    }
+
+    std::string out = "Registered services: " + std::to_string(mNameToService.size()) + "\n";
+    out += mAccess->dumpDecisionCache();
+    if (!base::WriteStringToFd(out, fd)) {
+        return UNKNOWN_ERROR;
+    }
+    return OK;
+}
+
 }  // namespace android
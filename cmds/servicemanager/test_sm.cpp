@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <android-base/file.h>
 #include <android/os/BnServiceCallback.h>
 #include <binder/Binder.h>
 #include <binder/ProcessState.h>
@@ -35,6 +36,7 @@ using android::os::BnServiceCallback;
 using android::os::IServiceManager;
 using testing::_;
 using testing::ElementsAre;
+using testing::HasSubstr;
 using testing::NiceMock;
 using testing::Return;
 
@@ -255,6 +257,49 @@ TEST(GetService, NotAllowedFromIsolated) {
     EXPECT_EQ(nullptr, out.get());
 }
 
+TEST(CheckServices, HappyHappy) {
+    auto sm = getPermissiveServiceManager();
+    sp<IBinder> serviceA = getBinder();
+    sp<IBinder> serviceB = getBinder();
+
+    EXPECT_TRUE(sm->addService("a", serviceA, false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+    EXPECT_TRUE(sm->addService("b", serviceB, false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+
+    std::vector<sp<IBinder>> out;
+    EXPECT_TRUE(sm->checkServices({"b", "missing", "a"}, &out).isOk());
+    ASSERT_EQ(3u, out.size());
+    EXPECT_EQ(serviceB, out[0]);
+    EXPECT_EQ(nullptr, out[1]);
+    EXPECT_EQ(serviceA, out[2]);
+}
+
+TEST(CheckServices, CallingContextLookedUpOnce) {
+    std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
+
+    EXPECT_CALL(*access, getCallingContext())
+        // something adds it
+        .WillOnce(Return(Access::CallingContext{}))
+        // a single lookup for all names
+        .WillOnce(Return(Access::CallingContext{}));
+    EXPECT_CALL(*access, canAdd(_, _)).WillOnce(Return(true));
+    EXPECT_CALL(*access, canFind(_, _)).WillOnce(Return(true)).WillOnce(Return(false));
+
+    sp<ServiceManager> sm = sp<NiceMock<MockServiceManager>>::make(std::move(access));
+
+    sp<IBinder> service = getBinder();
+    EXPECT_TRUE(sm->addService("foo", service, false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+
+    std::vector<sp<IBinder>> out;
+    // returns nullptr entries but has OK status, like checkService
+    EXPECT_TRUE(sm->checkServices({"foo", "foo"}, &out).isOk());
+    ASSERT_EQ(2u, out.size());
+    EXPECT_EQ(service, out[0]);
+    EXPECT_EQ(nullptr, out[1]);
+}
+
 TEST(ListServices, NoPermissions) {
     std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
 
@@ -306,6 +351,37 @@ TEST(ListServices, CriticalServices) {
     EXPECT_THAT(out, ElementsAre("sa"));
 }
 
+TEST(Dump, NoPermissions) {
+    std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
+
+    EXPECT_CALL(*access, getCallingContext()).WillOnce(Return(Access::CallingContext{}));
+    EXPECT_CALL(*access, canList(_)).WillOnce(Return(false));
+
+    sp<ServiceManager> sm = sp<NiceMock<MockServiceManager>>::make(std::move(access));
+
+    TemporaryFile file;
+    EXPECT_EQ(android::PERMISSION_DENIED, sm->dump(file.fd, {}));
+
+    std::string out;
+    ASSERT_TRUE(android::base::ReadFileToString(file.path, &out));
+    EXPECT_TRUE(out.empty());
+}
+
+TEST(Dump, ServicesAndDecisionCache) {
+    auto sm = getPermissiveServiceManager();
+
+    EXPECT_TRUE(sm->addService("foo", getBinder(), false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+
+    TemporaryFile file;
+    EXPECT_EQ(android::OK, sm->dump(file.fd, {}));
+
+    std::string out;
+    ASSERT_TRUE(android::base::ReadFileToString(file.path, &out));
+    EXPECT_THAT(out, HasSubstr("Registered services: 1\n"));
+    EXPECT_THAT(out, HasSubstr("SELinux decision cache: "));
+}
+
 class CallbackHistorian : public BnServiceCallback {
     Status onRegistration(const std::string& name, const sp<IBinder>& binder) override {
         registrations.push_back(name);
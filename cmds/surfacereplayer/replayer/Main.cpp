@@ -51,6 +51,11 @@ void printHelpMenu() {
 
     std::cout << "  -l  Indefinitely loop the replayer\n";
 
+    std::cout << "  -v  Replay frame by frame on vsync with buffers allocated up front, and report "
+                 "latency and jank statistics\n";
+
+    std::cout << "\n  -o [File]  Write per frame statistics of a vsync replay to a CSV file\n";
+
     std::cout << "  -h  Display help menu\n";
 
     std::cout << std::endl;
@@ -63,9 +68,11 @@ int main(int argc, char** argv) {
     bool pauseBeginning = false;
     int numThreads = DEFAULT_THREADS;
     long stopHere = -1;
+    bool replayOnVsync = false;
+    std::string statsFile;
 
     int opt = 0;
-    while ((opt = getopt(argc, argv, "mt:s:nlh?")) != -1) {
+    while ((opt = getopt(argc, argv, "mt:s:nlvo:h?")) != -1) {
         switch (opt) {
             case 'm':
                 pauseBeginning = true;
@@ -82,6 +89,12 @@ int main(int argc, char** argv) {
             case 'l':
                 loop = true;
                 break;
+            case 'v':
+                replayOnVsync = true;
+                break;
+            case 'o':
+                statsFile = optarg;
+                break;
             case 'h':
             case '?':
                 printHelpMenu();
@@ -102,7 +115,8 @@ int main(int argc, char** argv) {
 
     status_t status = NO_ERROR;
     do {
-        android::Replayer r(filename, pauseBeginning, numThreads, wait, stopHere);
+        android::Replayer r(filename, pauseBeginning, numThreads, wait, stopHere, replayOnVsync,
+                            statsFile);
         status = r.replay();
     } while(loop);
 
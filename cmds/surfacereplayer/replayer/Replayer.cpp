@@ -32,13 +32,18 @@
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
+#include <poll.h>
+
+#include <algorithm>
 #include <chrono>
+#include <cinttypes>
 #include <cmath>
 #include <condition_variable>
 #include <cstdlib>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <iterator>
 #include <mutex>
 #include <sstream>
 #include <string>
@@ -50,14 +55,16 @@ using namespace android;
 std::atomic_bool Replayer::sReplayingManually(false);
 
 Replayer::Replayer(const std::string& filename, bool replayManually, int numThreads, bool wait,
-        nsecs_t stopHere)
+        nsecs_t stopHere, bool replayOnVsync, const std::string& statsFile)
       : mTrace(),
         mLoaded(false),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mReplayOnVsync(replayOnVsync),
+        mStatsFile(statsFile) {
     srand(RAND_COLOR_SEED);
 
     std::string input;
@@ -81,14 +88,17 @@ Replayer::Replayer(const std::string& filename, bool replayManually, int numThre
     }
 }
 
-Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere)
+Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere,
+        bool replayOnVsync, const std::string& statsFile)
       : mTrace(t),
         mLoaded(true),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mReplayOnVsync(replayOnVsync),
+        mStatsFile(statsFile) {
     srand(RAND_COLOR_SEED);
     mCurrentTime = mTrace.increment(0).time_stamp();
 
@@ -111,6 +121,10 @@ status_t Replayer::replay() {
         return status;
     }
 
+    if (mReplayOnVsync) {
+        return replayOnVsync();
+    }
+
     SurfaceComposerClient::enableVSyncInjections(true);
 
     initReplay();
@@ -706,3 +720,335 @@ void Replayer::setBlurRegionsChange(SurfaceComposerClient::Transaction& t,
     }
     t.setBlurRegions(mLayers[id], regions);
 }
+
+status_t Replayer::replayOnVsync() {
+    DisplayEventReceiver receiver;
+    status_t status = receiver.initCheck();
+    if (status != NO_ERROR) {
+        ALOGE("Couldn't create DisplayEventReceiver (%d)", status);
+        return status;
+    }
+    receiver.setVsyncRate(1);
+
+    // Frames are laid out on the vsync grid of the display, so measure it first.
+    DisplayEventReceiver::Event::VSync vsync;
+    status = waitForVsync(receiver, &vsync);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    const nsecs_t previousVsync = vsync.expectedVSyncTimestamp;
+    status = waitForVsync(receiver, &vsync);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    const nsecs_t vsyncPeriod = vsync.frameInterval > 0
+            ? vsync.frameInterval
+            : vsync.expectedVSyncTimestamp - previousVsync;
+    if (vsyncPeriod <= 0) {
+        ALOGE("Couldn't measure the vsync period");
+        return BAD_VALUE;
+    }
+
+    status = prepareVsyncReplay(vsyncPeriod);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    std::cout << "Prepared " << mReplayFrames.size() << " frames, replaying on vsync every "
+              << vsyncPeriod / 1e6 << " ms" << std::endl;
+
+    auto frame = mReplayFrames.begin();
+    nsecs_t startTime = -1;
+    while (frame != mReplayFrames.end()) {
+        status = waitForVsync(receiver, &vsync);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        if (startTime < 0) {
+            startTime = vsync.expectedVSyncTimestamp;
+        }
+
+        // Frames of vsyncs that the replayer woke up too late for are applied on this one.
+        const int64_t vsyncIndex = static_cast<int64_t>(
+                std::llround(static_cast<double>(vsync.expectedVSyncTimestamp - startTime) /
+                             vsyncPeriod));
+        for (; frame != mReplayFrames.end() && frame->vsyncIndex <= vsyncIndex; ++frame) {
+            frame->appliedLate = frame->vsyncIndex < vsyncIndex;
+            frame->expectedPresentTime = vsync.expectedVSyncTimestamp;
+            frame->applyTime = systemTime();
+            frame->transaction.apply();
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mReplayStatsLock);
+        const bool completed = mReplayStatsCond.wait_for(lock, std::chrono::seconds(5), [&] {
+            return mCompletedReplayFrames == mReplayFrames.size();
+        });
+        ALOGE_IF(!completed, "Timed out waiting for %zu frames to complete",
+                 mReplayFrames.size() - mCompletedReplayFrames);
+    }
+
+    reportVsyncReplayStats(vsyncPeriod);
+    return NO_ERROR;
+}
+
+status_t Replayer::prepareVsyncReplay(nsecs_t vsyncPeriod) {
+    // Surfaces and displays are created ahead of the first frame, so that creating them does not
+    // delay any frame. Deleted surfaces are reparented off screen at the time of their deletion.
+    for (const Increment& increment : mTrace.increment()) {
+        if (increment.has_surface_creation()) {
+            const SurfaceCreation& create = increment.surface_creation();
+            if (!createReplaySurface(create.id(), create.name(), create.w(), create.h())) {
+                return BAD_VALUE;
+            }
+        } else if (increment.has_display_creation()) {
+            const DisplayCreation& create = increment.display_creation();
+            mDisplays[create.id()] = SurfaceComposerClient::createDisplay(
+                    String8(create.name().c_str()), create.is_secure());
+        }
+    }
+
+    const int64_t startTime = mTrace.increment(0).time_stamp();
+    for (const Increment& increment : mTrace.increment()) {
+        const int64_t vsyncIndex = (increment.time_stamp() - startTime) / vsyncPeriod;
+
+        switch (increment.increment_case()) {
+            case increment.kTransaction: {
+                const Transaction& t = increment.transaction();
+                for (const SurfaceChange& change : t.surface_change()) {
+                    if (!createReplaySurface(change.id(), "Replayed layer", 0, 0)) {
+                        return BAD_VALUE;
+                    }
+                }
+                DisplayChanges displayChanges;
+                for (const DisplayChange& change : t.display_change()) {
+                    if (mDisplays.count(change.id()) != 0) {
+                        *displayChanges.Add() = change;
+                    }
+                }
+
+                SurfaceComposerClient::Transaction transaction;
+                if (doSurfaceTransaction(transaction, t.surface_change()) != NO_ERROR) {
+                    ALOGW("Transaction %" PRIu64 " is replayed partially", t.id());
+                }
+                doDisplayTransaction(transaction, displayChanges);
+                if (t.animation()) {
+                    transaction.setAnimationTransaction();
+                }
+
+                ReplayFrame& frame = getReplayFrame(vsyncIndex);
+                frame.transaction.merge(std::move(transaction));
+                frame.transactionCount++;
+            } break;
+            case increment.kBufferUpdate: {
+                const BufferUpdate& update = increment.buffer_update();
+                if (!createReplaySurface(update.id(), "Replayed layer", 0, 0)) {
+                    return BAD_VALUE;
+                }
+                const sp<GraphicBuffer> buffer =
+                        getReplayBuffer(update.id(), update.w(), update.h());
+                if (buffer == nullptr) {
+                    break;
+                }
+
+                ReplayFrame& frame = getReplayFrame(vsyncIndex);
+                frame.transaction.setBuffer(mLayers[update.id()], buffer);
+                frame.bufferCount++;
+            } break;
+            case increment.kSurfaceDeletion: {
+                const auto layer = mLayers.find(increment.surface_deletion().id());
+                if (layer != mLayers.end()) {
+                    getReplayFrame(vsyncIndex).transaction.reparent(layer->second, nullptr);
+                }
+            } break;
+            default:
+                // The display drives vsync, and display power is left as it is.
+                break;
+        }
+    }
+
+    for (ReplayFrame& frame : mReplayFrames) {
+        frame.transaction.addTransactionCompletedCallback(
+                [this, &frame](void* /*context*/, nsecs_t latchTime, const sp<Fence>& presentFence,
+                               const std::vector<SurfaceControlStats>& /*stats*/) {
+                    onReplayFrameCompleted(&frame, latchTime, presentFence);
+                },
+                nullptr);
+    }
+
+    return NO_ERROR;
+}
+
+status_t Replayer::waitForVsync(DisplayEventReceiver& receiver,
+        DisplayEventReceiver::Event::VSync* outVsync) {
+    DisplayEventReceiver::Event events[8];
+    while (true) {
+        struct pollfd fd = {receiver.getFd(), POLLIN, 0};
+        if (poll(&fd, 1, 1000) <= 0) {
+            ALOGE("Timed out waiting for vsync");
+            return TIMED_OUT;
+        }
+
+        bool gotVsync = false;
+        ssize_t n;
+        while ((n = receiver.getEvents(events, std::size(events))) > 0) {
+            for (ssize_t i = 0; i < n; i++) {
+                if (events[i].header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
+                    *outVsync = events[i].vsync;
+                    gotVsync = true;
+                }
+            }
+        }
+        if (gotVsync) {
+            return NO_ERROR;
+        }
+    }
+}
+
+Replayer::ReplayFrame& Replayer::getReplayFrame(int64_t vsyncIndex) {
+    if (mReplayFrames.empty() || mReplayFrames.back().vsyncIndex != vsyncIndex) {
+        mReplayFrames.emplace_back().vsyncIndex = vsyncIndex;
+    }
+    return mReplayFrames.back();
+}
+
+bool Replayer::createReplaySurface(layer_id id, const std::string& name, uint32_t w, uint32_t h) {
+    if (mLayers[id] != nullptr) {
+        return true;
+    }
+
+    ALOGV("Creating Surface Control: ID: %d", id);
+    sp<SurfaceControl> surfaceControl =
+            mComposerClient->createSurface(String8(name.c_str()), w, h, PIXEL_FORMAT_RGBA_8888,
+                                           ISurfaceComposerClient::eFXSurfaceBufferState);
+    if (surfaceControl == nullptr) {
+        ALOGE("CreateSurfaceControl: unable to create surface control");
+        return false;
+    }
+
+    mLayers[id] = surfaceControl;
+    mColors[id] = HSV(rand() % 360, 1, 1);
+    return true;
+}
+
+sp<GraphicBuffer> Replayer::getReplayBuffer(layer_id id, uint32_t w, uint32_t h) {
+    if (w == 0 || h == 0) {
+        return nullptr;
+    }
+
+    ReplayBuffers& replayBuffers = mReplayBuffers[{id, {w, h}}];
+    if (replayBuffers.buffers.empty()) {
+        HSV& color = mColors[id];
+        for (int i = 0; i < BUFFERS_PER_SIZE; i++) {
+            sp<GraphicBuffer> buffer =
+                    new GraphicBuffer(w, h, PIXEL_FORMAT_RGBA_8888, 1,
+                                      GRALLOC_USAGE_SW_WRITE_OFTEN | GRALLOC_USAGE_HW_COMPOSER |
+                                              GRALLOC_USAGE_HW_TEXTURE,
+                                      "SurfaceReplayer");
+            if (buffer->initCheck() != NO_ERROR) {
+                ALOGE("getReplayBuffer: failed to allocate %ux%u buffer", w, h);
+                return nullptr;
+            }
+
+            uint8_t* img = nullptr;
+            status_t status = buffer->lock(GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                           reinterpret_cast<void**>(&img));
+            if (status != NO_ERROR) {
+                ALOGE("getReplayBuffer: failed to lock buffer, (%d)", status);
+                return nullptr;
+            }
+            const auto rgb = color.getRGB();
+            for (uint32_t y = 0; y < h; y++) {
+                for (uint32_t x = 0; x < w; x++) {
+                    uint8_t* pixel = img + (4 * (y * buffer->getStride() + x));
+                    pixel[0] = rgb.r;
+                    pixel[1] = rgb.g;
+                    pixel[2] = rgb.b;
+                    pixel[3] = LAYER_ALPHA;
+                }
+            }
+            buffer->unlock();
+            color.modulate();
+
+            replayBuffers.buffers.push_back(buffer);
+        }
+    }
+
+    return replayBuffers.buffers[replayBuffers.next++ % replayBuffers.buffers.size()];
+}
+
+void Replayer::onReplayFrameCompleted(ReplayFrame* frame, nsecs_t latchTime,
+        const sp<Fence>& presentFence) {
+    std::lock_guard<std::mutex> lock(mReplayStatsLock);
+    frame->latchTime = latchTime;
+    frame->presentFence = presentFence;
+    mCompletedReplayFrames++;
+    mReplayStatsCond.notify_one();
+}
+
+nsecs_t percentile(std::vector<nsecs_t>& values, size_t percent) {
+    if (values.empty()) {
+        return 0;
+    }
+    auto nth = values.begin() + (values.size() - 1) * percent / 100;
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+void Replayer::reportVsyncReplayStats(nsecs_t vsyncPeriod) {
+    std::ofstream statsFile;
+    if (!mStatsFile.empty()) {
+        statsFile.open(mStatsFile);
+        if (!statsFile) {
+            std::cerr << "Couldn't open " << mStatsFile << std::endl;
+        } else {
+            statsFile << "vsync,transactions,buffers,apply_time,latch_time,present_time,"
+                         "expected_present_time,applied_late,janky\n";
+        }
+    }
+
+    std::vector<nsecs_t> latchLatencies;
+    std::vector<nsecs_t> presentLatencies;
+    size_t lateFrames = 0;
+    size_t jankyFrames = 0;
+    size_t incompleteFrames = 0;
+
+    std::lock_guard<std::mutex> lock(mReplayStatsLock);
+    for (const ReplayFrame& frame : mReplayFrames) {
+        nsecs_t presentTime = -1;
+        if (frame.presentFence != nullptr && frame.presentFence->wait(100) == NO_ERROR) {
+            presentTime = frame.presentFence->getSignalTime();
+        }
+
+        const bool complete = frame.latchTime >= 0 && presentTime >= 0;
+        const bool janky = complete && presentTime > frame.expectedPresentTime + vsyncPeriod / 2;
+        if (complete) {
+            latchLatencies.push_back(frame.latchTime - frame.applyTime);
+            presentLatencies.push_back(presentTime - frame.applyTime);
+        } else {
+            incompleteFrames++;
+        }
+        lateFrames += frame.appliedLate;
+        jankyFrames += janky;
+
+        if (statsFile) {
+            statsFile << frame.vsyncIndex << ',' << frame.transactionCount << ','
+                      << frame.bufferCount << ',' << frame.applyTime << ',' << frame.latchTime
+                      << ',' << presentTime << ',' << frame.expectedPresentTime << ','
+                      << frame.appliedLate << ',' << janky << '\n';
+        }
+    }
+
+    const auto printLatency = [](const char* name, std::vector<nsecs_t>& latencies) {
+        std::cout << "  " << name << " latency (ms): p50 " << percentile(latencies, 50) / 1e6
+                  << ", p90 " << percentile(latencies, 90) / 1e6 << ", p99 "
+                  << percentile(latencies, 99) / 1e6 << "\n";
+    };
+
+    std::cout << "Replayed " << mReplayFrames.size() << " frames\n";
+    printLatency("Latch", latchLatencies);
+    printLatency("Present", presentLatencies);
+    std::cout << "  Janky frames: " << jankyFrames << "\n";
+    std::cout << "  Frames applied late by the replayer: " << lateFrames << "\n";
+    std::cout << "  Frames without present time: " << incompleteFrames << std::endl;
+}
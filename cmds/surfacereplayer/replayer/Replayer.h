@@ -23,14 +23,20 @@
 
 #include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
 
+#include <gui/DisplayEventReceiver.h>
 #include <gui/SurfaceComposerClient.h>
 #include <gui/SurfaceControl.h>
 
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+
 #include <utils/Errors.h>
 #include <utils/StrongPointer.h>
 
 #include <stdatomic.h>
 #include <condition_variable>
+#include <deque>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
@@ -45,6 +51,8 @@ namespace android {
 const auto DEFAULT_PATH = "/data/local/tmp/SurfaceTrace.dat";
 const auto RAND_COLOR_SEED = 700;
 const auto DEFAULT_THREADS = 3;
+// Buffers allocated per layer and size when replaying on vsync, which are cycled through.
+const auto BUFFERS_PER_SIZE = 3;
 
 typedef int32_t layer_id;
 typedef int32_t display_id;
@@ -54,10 +62,15 @@ typedef google::protobuf::RepeatedPtrField<DisplayChange> DisplayChanges;
 
 class Replayer {
   public:
+    // If replayOnVsync is set, the trace is replayed frame by frame on the vsync of the display
+    // instead, with every surface and buffer created up front, and the latency and jank of each
+    // frame are reported. Per frame statistics are also written to statsFile, if given.
     Replayer(const std::string& filename, bool replayManually = false,
-            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1);
+            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1,
+            bool replayOnVsync = false, const std::string& statsFile = "");
     Replayer(const Trace& trace, bool replayManually = false, int numThreads = DEFAULT_THREADS,
-            bool wait = true, nsecs_t stopHere = -1);
+            bool wait = true, nsecs_t stopHere = -1, bool replayOnVsync = false,
+            const std::string& statsFile = "");
 
     status_t replay();
 
@@ -131,6 +144,31 @@ class Replayer {
     void waitUntilTimestamp(int64_t timestamp);
     status_t loadSurfaceComposerClient();
 
+    // The changes of the trace that are applied on one vsync of the replay.
+    struct ReplayFrame {
+        int64_t vsyncIndex = 0;
+        SurfaceComposerClient::Transaction transaction;
+        int transactionCount = 0;
+        int bufferCount = 0;
+
+        bool appliedLate = false;
+        nsecs_t applyTime = -1;
+        nsecs_t expectedPresentTime = -1;
+        nsecs_t latchTime = -1;
+        sp<Fence> presentFence;
+    };
+
+    status_t replayOnVsync();
+    status_t prepareVsyncReplay(nsecs_t vsyncPeriod);
+    status_t waitForVsync(DisplayEventReceiver& receiver,
+            DisplayEventReceiver::Event::VSync* outVsync);
+    ReplayFrame& getReplayFrame(int64_t vsyncIndex);
+    bool createReplaySurface(layer_id id, const std::string& name, uint32_t w, uint32_t h);
+    sp<GraphicBuffer> getReplayBuffer(layer_id id, uint32_t w, uint32_t h);
+    void onReplayFrameCompleted(ReplayFrame* frame, nsecs_t latchTime,
+            const sp<Fence>& presentFence);
+    void reportVsyncReplayStats(nsecs_t vsyncPeriod);
+
     Trace mTrace;
     bool mLoaded = false;
     int32_t mIncrementIndex = 0;
@@ -164,6 +202,23 @@ class Replayer {
 
     sp<SurfaceComposerClient> mComposerClient;
     std::queue<std::shared_ptr<Event>> mPendingIncrements;
+
+    bool mReplayOnVsync = false;
+    std::string mStatsFile;
+
+    // Frames are only added while preparing, so that completion callbacks can point to them.
+    std::deque<ReplayFrame> mReplayFrames;
+
+    struct ReplayBuffers {
+        std::vector<sp<GraphicBuffer>> buffers;
+        size_t next = 0;
+    };
+    // Keyed by layer, then width and height.
+    std::map<std::pair<layer_id, std::pair<uint32_t, uint32_t>>, ReplayBuffers> mReplayBuffers;
+
+    std::mutex mReplayStatsLock;
+    std::condition_variable mReplayStatsCond;
+    size_t mCompletedReplayFrames = 0;
 };
 
 }  // namespace android
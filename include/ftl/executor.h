@@ -0,0 +1,113 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace android::ftl {
+
+// Interface for running tasks submitted from any thread, e.g. a thread pool or the looper of a
+// thread. An executor must outlive the tasks it was given, including continuations attached to an
+// ftl::Future that is still pending.
+class Executor {
+ public:
+  using Task = std::function<void()>;
+
+  virtual ~Executor() = default;
+
+  // Runs the task, either before returning or later on another thread.
+  virtual void execute(Task) = 0;
+};
+
+// Runs tasks on the calling thread before returning.
+//
+//   ftl::InlineExecutor executor;
+//   int x = 0;
+//   executor.execute([&x] { x = 42; });
+//   assert(x == 42);
+//
+class InlineExecutor final : public Executor {
+ public:
+  void execute(Task task) override { task(); }
+};
+
+// Runs tasks in submission order on a dedicated thread. Destruction waits for pending tasks.
+//
+//   std::atomic<int> x = 0;
+//   {
+//     ftl::SerialExecutor executor;
+//     executor.execute([&x] { x = 42; });
+//   }
+//   assert(x == 42);
+//
+class SerialExecutor final : public Executor {
+ public:
+  SerialExecutor() : thread_(&SerialExecutor::loop, this) {}
+
+  ~SerialExecutor() override {
+    {
+      std::lock_guard lock(mutex_);
+      done_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+  }
+
+  SerialExecutor(const SerialExecutor&) = delete;
+  SerialExecutor& operator=(const SerialExecutor&) = delete;
+
+  void execute(Task task) override {
+    // Notify under the lock, as the task may cause another thread to destroy the executor.
+    std::lock_guard lock(mutex_);
+    tasks_.push_back(std::move(task));
+    condition_.notify_one();
+  }
+
+  // Returns whether the calling thread is the thread of this executor.
+  bool is_current() const { return std::this_thread::get_id() == thread_.get_id(); }
+
+ private:
+  void loop() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+      condition_.wait(lock, [this] { return done_ || !tasks_.empty(); });
+      if (tasks_.empty()) return;
+
+      Task task = std::move(tasks_.front());
+      tasks_.pop_front();
+
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<Task> tasks_;
+  bool done_ = false;
+
+  // Declared last, so that the loop starts after the other members are initialized.
+  std::thread thread_;
+};
+
+}  // namespace android::ftl
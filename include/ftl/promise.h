@@ -0,0 +1,251 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <ftl/executor.h>
+#include <ftl/future.h>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace android::ftl {
+
+template <typename T>
+class Future;
+
+template <typename T>
+class Promise;
+
+namespace details {
+
+template <typename T>
+struct future_result<Future<T>> {
+  using type = T;
+};
+
+// Stand-in for the value of Future<void>.
+struct Unit {};
+
+template <typename T>
+using future_value_t = std::conditional_t<std::is_void_v<T>, Unit, T>;
+
+template <typename F, typename T>
+struct continuation_result : std::invoke_result<F, T> {};
+
+template <typename F>
+struct continuation_result<F, void> : std::invoke_result<F> {};
+
+template <typename F, typename T>
+using continuation_result_t = typename continuation_result<F, T>::type;
+
+// State shared by a promise and its future.
+template <typename T>
+class FutureState final : public std::enable_shared_from_this<FutureState<T>> {
+ public:
+  using Value = future_value_t<T>;
+  using Continuation = std::function<void(std::shared_ptr<FutureState>)>;
+
+  template <typename... Args>
+  void set(Args&&... args) {
+    Continuation continuation;
+    {
+      std::lock_guard lock(mutex_);
+      value_.emplace(std::forward<Args>(args)...);
+      continuation = std::move(continuation_);
+    }
+
+    if (continuation) {
+      continuation(this->shared_from_this());
+    } else {
+      condition_.notify_all();
+    }
+  }
+
+  // Calls the continuation once the value is set: on the calling thread if it is already set, else
+  // on the thread that sets it. The continuation is passed the state rather than capturing it, so
+  // that the state is released if the promise is broken.
+  void on_ready(Continuation continuation) {
+    {
+      std::lock_guard lock(mutex_);
+      if (!value_) {
+        continuation_ = std::move(continuation);
+        return;
+      }
+    }
+    continuation(this->shared_from_this());
+  }
+
+  bool ready() const {
+    std::lock_guard lock(mutex_);
+    return value_.has_value();
+  }
+
+  // Waits until the value is set, and moves it out.
+  Value take() {
+    std::unique_lock lock(mutex_);
+    condition_.wait(lock, [this] { return value_.has_value(); });
+    return std::move(*value_);
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::optional<Value> value_;
+  Continuation continuation_;
+};
+
+template <typename F, typename T>
+decltype(auto) invoke_continuation(F& f, FutureState<T>& state) {
+  if constexpr (std::is_void_v<T>) {
+    state.take();
+    return f();
+  } else {
+    return f(state.take());
+  }
+}
+
+inline Executor& inline_executor() {
+  static InlineExecutor executor;
+  return executor;
+}
+
+}  // namespace details
+
+// Producer of the value of an ftl::Future. Copies of a promise share the same future.
+//
+//   ftl::Promise<int> promise;
+//   ftl::Future<int> future = promise.get_future();
+//   std::thread thread([promise]() mutable { promise.set_value(42); });
+//
+//   assert(std::move(future).get() == 42);
+//   thread.join();
+//
+template <typename T>
+class Promise {
+ public:
+  Promise() : state_(std::make_shared<details::FutureState<T>>()) {}
+
+  // Returns the future of this promise. Must be called at most once.
+  Future<T> get_future() const { return Future<T>(state_); }
+
+  // Constructs the value of the future in place, and runs its continuation if any has been
+  // attached. Must be called once.
+  template <typename... Args>
+  void set_value(Args&&... args) const {
+    state_->set(std::forward<Args>(args)...);
+  }
+
+ private:
+  std::shared_ptr<details::FutureState<T>> state_;
+};
+
+// Future whose value can be consumed by a continuation without blocking a thread, as opposed to
+// std::future. The continuation runs on an ftl::Executor once the value is set. It maps T to either
+// R or ftl::Future<R>, and the chain yields ftl::Future<R> in both cases.
+//
+//   ftl::SerialExecutor executor;
+//
+//   ftl::Promise<int> promise;
+//   ftl::Future<std::string> future =
+//       promise.get_future()
+//           .then(executor, [](int x) { return x * 2; })
+//           .then(executor, [](int x) { return std::to_string(x); });
+//
+//   promise.set_value(21);
+//   assert(std::move(future).get() == "42");
+//
+// Like Executor::Task, continuations must be copyable. Values need only be movable.
+//
+template <typename T>
+class Future {
+ public:
+  using value_type = T;
+
+  // Creates an invalid future.
+  Future() = default;
+
+  Future(Future&&) = default;
+  Future& operator=(Future&&) = default;
+
+  Future(const Future&) = delete;
+  Future& operator=(const Future&) = delete;
+
+  // Returns whether the future has a value or continuation to come, i.e. it has not been consumed.
+  bool valid() const { return state_ != nullptr; }
+
+  // Returns whether the value has been set.
+  bool ready() const { return state_->ready(); }
+
+  // Blocks until the value is set, and returns it. Prefer then() on threads that must not block.
+  T get() && {
+    const auto state = std::move(state_);
+    if constexpr (std::is_void_v<T>) {
+      state->take();
+    } else {
+      return state->take();
+    }
+  }
+
+  // Attaches a continuation that the executor runs with the value, once it is set.
+  template <typename F, typename R = details::continuation_result_t<F, T>>
+  auto then(Executor& executor, F&& f) && -> Future<details::future_result_t<R>> {
+    using U = details::future_result_t<R>;
+
+    Promise<U> promise;
+    Future<U> future = promise.get_future();
+
+    const auto state = std::move(state_);
+    state->on_ready([&executor, promise, f = std::forward<F>(f)](
+                            std::shared_ptr<details::FutureState<T>> state) mutable {
+      executor.execute([state = std::move(state), promise, f]() mutable {
+        if constexpr (!std::is_same_v<R, U>) {
+          details::invoke_continuation(f, *state).then([promise](auto&&... value) {
+            promise.set_value(std::forward<decltype(value)>(value)...);
+          });
+        } else if constexpr (std::is_void_v<R>) {
+          details::invoke_continuation(f, *state);
+          promise.set_value();
+        } else {
+          promise.set_value(details::invoke_continuation(f, *state));
+        }
+      });
+    });
+
+    return future;
+  }
+
+  // Attaches a continuation that runs on the thread that sets the value, or on the calling thread
+  // if the value is already set. The continuation should not block.
+  template <typename F>
+  auto then(F&& f) && {
+    return std::move(*this).then(details::inline_executor(), std::forward<F>(f));
+  }
+
+ private:
+  friend Promise<T>;
+
+  explicit Future(std::shared_ptr<details::FutureState<T>> state) : state_(std::move(state)) {}
+
+  std::shared_ptr<details::FutureState<T>> state_;
+};
+
+}  // namespace android::ftl
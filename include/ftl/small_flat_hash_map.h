@@ -0,0 +1,362 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <ftl/initializer_list.h>
+#include <ftl/small_vector.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace android::ftl {
+namespace details {
+
+// Group of control bytes of an open-addressed hash table, probed in parallel within a 64-bit word.
+// A control byte is either kEmpty, kDeleted, or the top 7 bits of the hash of the key in its slot.
+class HashGroup {
+ public:
+  static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__);
+
+  static constexpr std::size_t kSize = 8;
+
+  static constexpr std::uint8_t kEmpty = 0x80;
+  static constexpr std::uint8_t kDeleted = 0xfe;
+
+  explicit HashGroup(const std::uint8_t* controls) { std::memcpy(&controls_, controls, kSize); }
+
+  // Returns a mask of the slots whose control byte may be the given hash. There are false positives
+  // after a true positive, so keys must still be compared.
+  std::uint64_t match(std::uint8_t hash) const {
+    const std::uint64_t bytes = controls_ ^ (kLsbs * hash);
+    return (bytes - kLsbs) & ~bytes & kMsbs;
+  }
+
+  std::uint64_t match_empty() const { return controls_ & (~controls_ << 6) & kMsbs; }
+
+  std::uint64_t match_empty_or_deleted() const { return controls_ & ~(controls_ << 7) & kMsbs; }
+
+  // Returns the lowest slot of a non-empty mask, and removes it from the mask.
+  static std::size_t next(std::uint64_t& mask) {
+    const auto slot = static_cast<std::size_t>(__builtin_ctzll(mask)) / 8;
+    mask &= mask - 1;
+    return slot;
+  }
+
+ private:
+  static constexpr std::uint64_t kLsbs = 0x0101010101010101;
+  static constexpr std::uint64_t kMsbs = 0x8080808080808080;
+
+  std::uint64_t controls_;
+};
+
+}  // namespace details
+
+// Associative container with unique, unordered keys, and the API of ftl::SmallMap, for maps whose
+// size may grow past N. Key-value pairs are stored in contiguous storage, which is allocated
+// statically until the size exceeds N, and looked up by linear search as long as they fit. Past N
+// mappings, they are indexed by an open-addressed hash table whose slots are probed in groups.
+//
+// Insertion and erasure invalidate iterators and references. Erasure does not preserve order, as
+// the last mapping is moved to the position of the erased one.
+//
+// Example usage:
+//
+//   ftl::SmallFlatHashMap<int, char, 2> map = ftl::init::map(1, 'a')(2, 'b');
+//   assert(map.size() == 2u);
+//   assert(!map.dynamic());
+//
+//   const auto [it, ok] = map.try_emplace(3, 'c');
+//   assert(ok && it->second == 'c');
+//   assert(map.dynamic());
+//
+//   assert(!map.try_emplace(2, 'z').second);
+//   assert(map.find(2) == 'b');
+//
+//   assert(map.erase(1));
+//   assert(!map.contains(1));
+//   assert(map == SmallFlatHashMap(ftl::init::map(2, 'b')(3, 'c')));
+//
+template <typename K, typename V, std::size_t N, typename Hash = std::hash<K>>
+class SmallFlatHashMap final {
+  using Map = SmallVector<std::pair<const K, V>, N>;
+  using Group = details::HashGroup;
+
+ public:
+  using key_type = K;
+  using mapped_type = V;
+  using hasher = Hash;
+
+  using value_type = typename Map::value_type;
+  using size_type = typename Map::size_type;
+  using difference_type = typename Map::difference_type;
+
+  using reference = typename Map::reference;
+  using iterator = typename Map::iterator;
+
+  using const_reference = typename Map::const_reference;
+  using const_iterator = typename Map::const_iterator;
+
+  // Creates an empty map.
+  SmallFlatHashMap() = default;
+
+  // Constructs at most N key-value pairs in place. See SmallMap for the syntax.
+  template <typename U, std::size_t... Sizes, typename... Types>
+  SmallFlatHashMap(InitializerList<U, std::index_sequence<Sizes...>, Types...>&& list)
+      : map_(std::move(list)) {
+    // TODO: Enforce unique keys.
+  }
+
+  size_type max_size() const { return map_.max_size(); }
+  size_type size() const { return map_.size(); }
+  bool empty() const { return map_.empty(); }
+
+  // Returns whether the map is backed by static or dynamic storage.
+  bool dynamic() const { return map_.dynamic(); }
+
+  iterator begin() { return map_.begin(); }
+  const_iterator begin() const { return cbegin(); }
+  const_iterator cbegin() const { return map_.cbegin(); }
+
+  iterator end() { return map_.end(); }
+  const_iterator end() const { return cend(); }
+  const_iterator cend() const { return map_.cend(); }
+
+  // Returns whether a mapping exists for the given key.
+  bool contains(const key_type& key) const {
+    return find(key, [](const mapped_type&) {});
+  }
+
+  // Returns a reference to the value for the given key, or std::nullopt if the key was not found.
+  auto find(const key_type& key) const -> std::optional<std::reference_wrapper<const mapped_type>> {
+    return find(key, [](const mapped_type& v) { return std::cref(v); });
+  }
+
+  auto find(const key_type& key) -> std::optional<std::reference_wrapper<mapped_type>> {
+    return find(key, [](mapped_type& v) { return std::ref(v); });
+  }
+
+  // Returns the result R of a unary operation F on (a constant or mutable reference to) the value
+  // for the given key, or std::nullopt if the key was not found. If F has a return type of void,
+  // then the Boolean result indicates whether the key was found.
+  template <typename F, typename R = std::invoke_result_t<F, const mapped_type&>>
+  auto find(const key_type& key, F f) const
+      -> std::conditional_t<std::is_void_v<R>, bool, std::optional<R>> {
+    const value_type* const pair = find_pair(key);
+    if (!pair) return {};
+
+    const mapped_type& v = pair->second;
+    if constexpr (std::is_void_v<R>) {
+      f(v);
+      return true;
+    } else {
+      return f(v);
+    }
+  }
+
+  template <typename F>
+  auto find(const key_type& key, F f) {
+    return std::as_const(*this).find(
+        key, [&f](const mapped_type& v) { return f(const_cast<mapped_type&>(v)); });
+  }
+
+  // Constructs the value for the given key in place by forwarding the arguments, unless the key is
+  // already mapped. Returns an iterator to the mapping for the key, and whether it was inserted.
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args) {
+    if (const size_type position = position_of(key); position != size()) {
+      return {begin() + position, false};
+    }
+
+    map_.emplace_back(std::piecewise_construct, std::forward_as_tuple(key),
+                      std::forward_as_tuple(std::forward<Args>(args)...));
+
+    const size_type position = size() - 1;
+    if (!controls_.empty() || size() > N) {
+      // Rehash if at most 1/8 of the slots would remain empty, so that probing terminates early.
+      if ((size() + deleted_) * 8 > controls_.size() * 7) {
+        rehash();
+      } else {
+        insert_slot(hash_of(begin()[position].first), position);
+      }
+    }
+
+    return {begin() + position, true};
+  }
+
+  // Erases the mapping for the given key. Returns whether the key was found.
+  bool erase(const key_type& key) {
+    const size_type position = position_of(key);
+    if (position == size()) return false;
+
+    const size_type last = size() - 1;
+    if (!controls_.empty()) {
+      controls_[find_slot(hash_of(key), position)] = Group::kDeleted;
+      deleted_++;
+
+      if (position != last) {
+        positions_[find_slot(hash_of(begin()[last].first), last)] = position;
+      }
+    }
+
+    if (position != last) {
+      map_.replace(begin() + position, std::move(begin()[last]));
+    }
+    map_.pop_back();
+    return true;
+  }
+
+ private:
+  static constexpr size_type kMinCapacity = 2 * Group::kSize;
+
+  std::uint64_t hash_of(const key_type& key) const {
+    // Multiplicative hashing spreads the bits of std::hash, which is the identity for integers.
+    const std::uint64_t hash = static_cast<std::uint64_t>(hasher_(key)) * 0x9e3779b97f4a7c15u;
+    return hash ^ (hash >> 32);
+  }
+
+  static std::uint8_t control_of(std::uint64_t hash) { return static_cast<std::uint8_t>(hash >> 57); }
+
+  // Calls f on the slots matching the hash in probing order, until f returns true or an empty
+  // slot ends the probe sequence. Returns the matching slot, or the number of slots if not found.
+  template <typename F>
+  size_type probe(std::uint64_t hash, F f) const {
+    const size_type mask = controls_.size() / Group::kSize - 1;
+    const std::uint8_t control = control_of(hash);
+
+    // Triangular probing visits every group, since the number of groups is a power of two.
+    size_type group = hash & mask;
+    for (size_type step = 1;; step++) {
+      const Group probed(controls_.data() + group * Group::kSize);
+      for (std::uint64_t matches = probed.match(control); matches;) {
+        const size_type slot = group * Group::kSize + Group::next(matches);
+        if (f(positions_[slot])) return slot;
+      }
+
+      if (probed.match_empty()) return controls_.size();
+      group = (group + step) & mask;
+    }
+  }
+
+  // Returns the mapping for the key, or nullptr if not found.
+  const value_type* find_pair(const key_type& key) const {
+    // Fetch the storage once, since SmallVector dispatches on its variant for every access.
+    const value_type* const pairs = begin();
+    if (controls_.empty()) {
+      const value_type* const last = pairs + size();
+      const value_type* const pair =
+          std::find_if(pairs, last, [&key](const value_type& pair) { return pair.first == key; });
+      return pair == last ? nullptr : pair;
+    }
+
+    const size_type slot =
+        probe(hash_of(key), [&](std::uint32_t position) { return pairs[position].first == key; });
+    return slot == controls_.size() ? nullptr : pairs + positions_[slot];
+  }
+
+  // Returns the position of the mapping for the key, or size() if not found.
+  size_type position_of(const key_type& key) const {
+    const value_type* const pair = find_pair(key);
+    return pair ? static_cast<size_type>(pair - begin()) : size();
+  }
+
+  // Returns the slot of the mapping at the given position, which must be indexed.
+  size_type find_slot(std::uint64_t hash, size_type position) const {
+    return probe(hash, [position](std::uint32_t p) { return p == position; });
+  }
+
+  void insert_slot(std::uint64_t hash, size_type position) {
+    const size_type mask = controls_.size() / Group::kSize - 1;
+
+    size_type group = hash & mask;
+    for (size_type step = 1;; step++) {
+      if (std::uint64_t matches =
+                  Group(controls_.data() + group * Group::kSize).match_empty_or_deleted()) {
+        const size_type slot = group * Group::kSize + Group::next(matches);
+        if (controls_[slot] == Group::kDeleted) deleted_--;
+
+        controls_[slot] = control_of(hash);
+        positions_[slot] = static_cast<std::uint32_t>(position);
+        return;
+      }
+      group = (group + step) & mask;
+    }
+  }
+
+  // Rebuilds the table with no deleted slots, and at most half of the slots full.
+  void rehash() {
+    size_type capacity = kMinCapacity;
+    while (capacity < size() * 2) capacity *= 2;
+
+    controls_.assign(capacity, Group::kEmpty);
+    positions_.resize(capacity);
+    deleted_ = 0;
+
+    const const_iterator pairs = begin();
+    for (size_type position = 0; position < size(); position++) {
+      insert_slot(hash_of(pairs[position].first), position);
+    }
+  }
+
+  Map map_;
+
+  // Hash table indexing map_, empty until the size first exceeds N. A slot is full if its control
+  // byte is neither kEmpty nor kDeleted, in which case the corresponding element of positions_ is
+  // the position of the mapping in map_.
+  std::vector<std::uint8_t> controls_;
+  std::vector<std::uint32_t> positions_;
+  size_type deleted_ = 0;
+
+  Hash hasher_;
+};
+
+// Deduction guide for in-place constructor.
+template <typename K, typename V, std::size_t... Sizes, typename... Types>
+SmallFlatHashMap(InitializerList<KeyValue<K, V>, std::index_sequence<Sizes...>, Types...>&&)
+    -> SmallFlatHashMap<K, V, sizeof...(Sizes)>;
+
+// Returns whether the key-value pairs of two maps are equal.
+template <typename K, typename V, std::size_t N, typename H, typename Q, typename W, std::size_t M,
+          typename I>
+bool operator==(const SmallFlatHashMap<K, V, N, H>& lhs, const SmallFlatHashMap<Q, W, M, I>& rhs) {
+  if (lhs.size() != rhs.size()) return false;
+
+  for (const auto& [k, v] : lhs) {
+    const auto& lv = v;
+    if (!rhs.find(k, [&lv](const auto& rv) { return lv == rv; }).value_or(false)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// TODO: Remove in C++20.
+template <typename K, typename V, std::size_t N, typename H, typename Q, typename W, std::size_t M,
+          typename I>
+inline bool operator!=(const SmallFlatHashMap<K, V, N, H>& lhs,
+                       const SmallFlatHashMap<Q, W, M, I>& rhs) {
+  return !(lhs == rhs);
+}
+
+}  // namespace android::ftl
@@ -29,6 +29,8 @@
  * The InputConsumer is used by the application to receive events from the input dispatcher.
  */
 
+#include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
 
@@ -39,6 +41,7 @@
 #include <binder/IBinder.h>
 #include <binder/Parcelable.h>
 #include <input/Input.h>
+#include <input/VelocityTracker.h>
 #include <sys/stat.h>
 #include <ui/Transform.h>
 #include <utils/BitSet.h>
@@ -144,7 +147,8 @@ struct InputMessage {
              * The "pointers" field must be the last field of the struct InputMessage.
              * When we send the struct InputMessage across the socket, we are not
              * writing the entire "pointers" array, but only the pointerCount portion
-             * of it as an optimization. Adding a field after "pointers" would break this.
+             * of it, and only the values of the axes set in each pointer, as an
+             * optimization. Adding a field after "pointers" would break this.
              */
             struct Pointer {
                 PointerProperties properties;
@@ -227,7 +231,12 @@ public:
                                                 android::base::unique_fd fd, sp<IBinder> token);
     InputChannel() = default;
     InputChannel(const InputChannel& other)
-          : mName(other.mName), mFd(::dup(other.mFd)), mToken(other.mToken){};
+          : mName(other.mName),
+            mFd(::dup(other.mFd)),
+            mToken(other.mToken),
+            mSharedMemoryFd(other.mSharedMemoryFd.ok() ? ::dup(other.mSharedMemoryFd) : -1),
+            mSharedMemory(other.mSharedMemory),
+            mIsServer(other.mIsServer){};
     InputChannel(const std::string name, android::base::unique_fd fd, sp<IBinder> token);
     ~InputChannel() override;
     /**
@@ -241,9 +250,22 @@ public:
                                          std::unique_ptr<InputChannel>& outServerChannel,
                                          std::unique_ptr<InputChannel>& outClientChannel);
 
+    /**
+     * Same as above, but if useSharedMemory is true the channels exchange messages through rings
+     * in shared memory instead of writing them to the socket. The socket then only wakes up the
+     * receiving end, once for all the messages sent before it started receiving them.
+     *
+     * The two-argument version uses shared memory if ro.input.shared_memory_transport is set.
+     */
+    static status_t openInputChannelPair(const std::string& name,
+                                         std::unique_ptr<InputChannel>& outServerChannel,
+                                         std::unique_ptr<InputChannel>& outClientChannel,
+                                         bool useSharedMemory);
+
     inline std::string getName() const { return mName; }
     inline const android::base::unique_fd& getFd() const { return mFd; }
     inline sp<IBinder> getToken() const { return mToken; }
+    inline bool usesSharedMemory() const { return mSharedMemory != nullptr; }
 
     /* Send a message to the other endpoint.
      *
@@ -306,12 +328,25 @@ public:
     }
 
 private:
+    struct SharedMemory;
+
     base::unique_fd dupFd() const;
+    void copySharedMemoryTo(InputChannel& outChannel) const;
+
+    // Maps the rings in sharedMemoryFd, as seen from the server end if isServer is true.
+    status_t attachSharedMemory(android::base::unique_fd sharedMemoryFd, bool isServer);
+    status_t sendSharedMemoryMessage(const InputMessage& msg, size_t msgLength);
+    status_t receiveSharedMemoryMessage(InputMessage* msg);
 
     std::string mName;
     android::base::unique_fd mFd;
 
     sp<IBinder> mToken;
+
+    // Only set for channels that exchange messages through shared memory.
+    android::base::unique_fd mSharedMemoryFd;
+    std::shared_ptr<SharedMemory> mSharedMemory;
+    bool mIsServer = false;
 };
 
 /*
@@ -504,6 +539,16 @@ public:
      */
     bool hasPendingBatch() const;
 
+    /* Makes touch resampling predict where pointers are going with a velocity model fit to their
+     * recent movement, rather than along the line through their last two samples.
+     *
+     * The model can extrapolate further ahead with less error, so resampled touches may be
+     * predicted up to maxPrediction past the latest sample (bounded by a frame at 60Hz). Apps
+     * that render ahead of the display, e.g. drawing apps, can use this to hide a frame of touch
+     * latency. Takes effect from the next touch down, and only if touch resampling is enabled.
+     */
+    void setTouchPredictor(VelocityTracker::Strategy strategy, nsecs_t maxPrediction);
+
     /* Returns the source of first pending batch if exist.
      *
      * Should be called after calling consume() with consumeBatches == false to determine
@@ -519,6 +564,11 @@ private:
     // True if touch resampling is enabled.
     const bool mResampleTouch;
 
+    // The velocity model used to extrapolate resampled touches, if any, and how far ahead of the
+    // latest sample it may predict.
+    std::optional<VelocityTracker::Strategy> mTouchPredictorStrategy;
+    nsecs_t mMaxTouchPrediction = 0;
+
     std::shared_ptr<InputChannel> mChannel;
 
     // The current input message.
@@ -579,14 +629,20 @@ private:
         size_t historySize;
         History history[2];
         History lastResample;
+        // Fit to every sample of the gesture when touches are predicted, null otherwise.
+        std::unique_ptr<VelocityTracker> predictor;
+        std::vector<VelocityTracker::Position> predictorPositions;
 
-        void initialize(int32_t deviceId, int32_t source) {
+        void initialize(int32_t deviceId, int32_t source,
+                        std::optional<VelocityTracker::Strategy> predictorStrategy) {
             this->deviceId = deviceId;
             this->source = source;
             historyCurrent = 0;
             historySize = 0;
             lastResample.eventTime = 0;
             lastResample.idBits.clear();
+            predictor = predictorStrategy ? std::make_unique<VelocityTracker>(*predictorStrategy)
+                                          : nullptr;
         }
 
         void addHistory(const InputMessage& msg) {
@@ -594,7 +650,18 @@ private:
             if (historySize < 2) {
                 historySize += 1;
             }
-            history[historyCurrent].initializeFrom(msg);
+            History& current = history[historyCurrent];
+            current.initializeFrom(msg);
+            if (predictor) {
+                // The tracker takes the positions in order of increasing pointer id.
+                predictorPositions.clear();
+                for (BitSet32 idBits(current.idBits); !idBits.isEmpty();) {
+                    const uint32_t id = idBits.clearFirstMarkedBit();
+                    const PointerCoords& coords = current.getPointerById(id);
+                    predictorPositions.push_back({coords.getX(), coords.getY()});
+                }
+                predictor->addMovement(current.eventTime, current.idBits, predictorPositions);
+            }
         }
 
         const History* getHistory(size_t index) const {
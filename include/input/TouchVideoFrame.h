@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include <sys/time.h>
+#include <memory>
 #include <vector>
 
 namespace android {
@@ -27,6 +28,8 @@ namespace android {
  * Represents data from a single scan of the touchscreen device.
  * Similar in concept to a video frame, but the touch strength is used as
  * the values instead.
+ * Copies of a frame share its data, so frames are cheap to pass along with the motion events
+ * they belong to.
  */
 class TouchVideoFrame {
 public:
@@ -58,13 +61,14 @@ public:
     /**
      * Rotate the video frame.
      * The rotation value is an enum from ui/Rotation.h
+     * Frames sharing data with this one are not affected.
      */
     void rotate(int32_t orientation);
 
 private:
     uint32_t mHeight;
     uint32_t mWidth;
-    std::vector<int16_t> mData;
+    std::shared_ptr<const std::vector<int16_t>> mData;
     struct timeval mTimestamp;
 
     /**
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *                        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_POWERHALASYNCCONTROLLER_H
+#define ANDROID_POWERHALASYNCCONTROLLER_H
+
+#include <android-base/thread_annotations.h>
+#include <android/hardware/power/Boost.h>
+#include <android/hardware/power/IPowerHintSession.h>
+#include <android/hardware/power/Mode.h>
+#include <powermanager/PowerHalController.h>
+#include <powermanager/PowerHalWrapper.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace android {
+
+namespace power {
+
+// -------------------------------------------------------------------------------------------------
+
+// Controller that sends boosts and modes to the Power HAL from a dedicated thread, so that callers
+// on the input and display paths never wait for the HAL. A boost is dropped if the same boost was
+// sent with the same duration within the coalescing window, and a mode is dropped if it was last
+// set to the same state. Boosts and modes return ok once queued or dropped, and failures of the HAL
+// are only logged. Hint session calls are forwarded synchronously.
+class PowerHalAsyncController : public HalWrapper {
+public:
+    static constexpr std::chrono::milliseconds DEFAULT_BOOST_COALESCING_WINDOW{50};
+
+    PowerHalAsyncController()
+          : PowerHalAsyncController(std::make_unique<PowerHalController>(),
+                                    DEFAULT_BOOST_COALESCING_WINDOW) {}
+    PowerHalAsyncController(std::unique_ptr<HalWrapper> hal,
+                            std::chrono::nanoseconds boostCoalescingWindow);
+    virtual ~PowerHalAsyncController();
+
+    PowerHalAsyncController(const PowerHalAsyncController&) = delete;
+    PowerHalAsyncController& operator=(const PowerHalAsyncController&) = delete;
+
+    virtual HalResult<void> setBoost(hardware::power::Boost boost, int32_t durationMs) override;
+    virtual HalResult<void> setMode(hardware::power::Mode mode, bool enabled) override;
+    virtual HalResult<sp<hardware::power::IPowerHintSession>> createHintSession(
+            int32_t tgid, int32_t uid, const std::vector<int32_t>& threadIds,
+            int64_t durationNanos) override;
+    virtual HalResult<int64_t> getHintSessionPreferredRate() override;
+
+    // Blocks until every boost and mode queued so far has been sent to the HAL.
+    void flush();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct SentBoost {
+        int32_t durationMs;
+        Clock::time_point time;
+    };
+
+    void enqueue(std::function<void()> request) REQUIRES(mMutex);
+    void loop();
+
+    const std::unique_ptr<HalWrapper> mHal;
+    const std::chrono::nanoseconds mBoostCoalescingWindow;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<std::function<void()>> mRequests GUARDED_BY(mMutex);
+    bool mSending GUARDED_BY(mMutex) = false;
+    bool mDone GUARDED_BY(mMutex) = false;
+
+    // Last boosts queued and last modes requested, forgotten when the HAL fails to apply them.
+    std::unordered_map<hardware::power::Boost, SentBoost> mSentBoosts GUARDED_BY(mMutex);
+    std::unordered_map<hardware::power::Mode, bool> mModes GUARDED_BY(mMutex);
+
+    // Declared last, so that the loop starts after the other members are initialized.
+    std::thread mThread;
+};
+
+// -------------------------------------------------------------------------------------------------
+
+}; // namespace power
+
+}; // namespace android
+
+#endif // ANDROID_POWERHALASYNCCONTROLLER_H
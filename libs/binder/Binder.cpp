@@ -23,10 +23,13 @@
 #include <binder/IResultReceiver.h>
 #include <binder/IShellCallback.h>
 #include <binder/Parcel.h>
+#include <cutils/compiler.h>
 
 #include <linux/sched.h>
 #include <stdio.h>
 
+#include "BinderStats.h"
+
 namespace android {
 
 // Service implementations inherit from BBinder and IBinder, and this is frozen
@@ -136,6 +139,18 @@ status_t IBinder::getDebugPid(pid_t* out) {
     return OK;
 }
 
+status_t IBinder::binderStatsCommand(BinderStatsCommand command, int fd) {
+    Parcel data;
+    Parcel reply;
+    status_t status = data.writeInt32(static_cast<int32_t>(command));
+    if (status != OK) return status;
+    if (command == BinderStatsCommand::DUMP) {
+        status = data.writeFileDescriptor(fd);
+        if (status != OK) return status;
+    }
+    return transact(BINDER_STATS_TRANSACTION, data, &reply);
+}
+
 // ---------------------------------------------------------------------------
 
 class BBinder::Extras
@@ -188,6 +203,8 @@ status_t BBinder::transact(
         reply->markSensitive();
     }
 
+    nsecs_t startNs = CC_UNLIKELY(BinderStats::isEnabled()) ? BinderStats::now() : 0;
+
     status_t err = NO_ERROR;
     switch (code) {
         case PING_TRANSACTION:
@@ -199,11 +216,19 @@ status_t BBinder::transact(
         case DEBUG_PID_TRANSACTION:
             err = reply->writeInt32(getDebugPid());
             break;
+        case BINDER_STATS_TRANSACTION:
+            err = BinderStats::onTransact(data);
+            break;
         default:
             err = onTransact(code, data, reply, flags);
             break;
     }
 
+    if (CC_UNLIKELY(startNs != 0)) {
+        BinderStats::record(BinderStats::Side::SERVER, &getInterfaceDescriptor(), -1, code,
+                            BinderStats::now() - startNs);
+    }
+
     // In case this is being transacted on in the same process.
     if (reply != nullptr) {
         reply->setDataPosition(0);
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BinderStats"
+
+#include "BinderStats.h"
+
+#include <binder/IBinder.h>
+#include <binder/IPCThreadState.h>
+#include <private/android_filesystem_config.h>
+#include <utils/Log.h>
+#include <utils/String8.h>
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace android {
+
+std::atomic<bool> BinderStats::sEnabled = false;
+
+namespace {
+
+// Bucket 0 counts durations below 1us, bucket i counts [2^(i-1), 2^i) us.
+constexpr size_t kNumBuckets = 32;
+// Must be a power of two. Methods beyond this are counted in 'dropped'.
+constexpr size_t kNumSlots = 512;
+
+struct Entry {
+    // Hash of side, descriptor (or handle) and code, 0 while the slot is free.
+    std::atomic<uint64_t> key = 0;
+    // Set once the fields below have been written by the thread claiming the slot.
+    std::atomic<bool> ready = false;
+    BinderStats::Side side = BinderStats::Side::SERVER;
+    std::string name;
+    uint32_t code = 0;
+
+    std::atomic<uint64_t> count = 0;
+    std::atomic<uint64_t> totalNs = 0;
+    std::atomic<uint64_t> maxNs = 0;
+    std::atomic<uint64_t> buckets[kNumBuckets] = {};
+};
+
+struct Table {
+    Entry entries[kNumSlots];
+    std::atomic<uint64_t> dropped = 0;
+};
+
+// Only allocated once stats are first enabled, and never freed, so that
+// threads still recording after a disable never see it go away.
+std::atomic<Table*> gTable = nullptr;
+std::mutex gTableMutex;
+
+__attribute__((no_sanitize("unsigned-integer-overflow")))
+uint64_t hashKey(BinderStats::Side side, const String16* descriptor, int32_t handle,
+                 uint32_t code) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&](uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ULL;
+    };
+    mix(static_cast<uint64_t>(side));
+    if (descriptor != nullptr) {
+        for (size_t i = 0; i < descriptor->size(); i++) mix(descriptor->string()[i]);
+    } else {
+        mix(0xffff);
+        mix(static_cast<uint32_t>(handle));
+    }
+    mix(code);
+    return hash == 0 ? 1 : hash;
+}
+
+size_t bucketFor(nsecs_t durationNs) {
+    uint64_t us = static_cast<uint64_t>(durationNs) / 1000;
+    if (us == 0) return 0;
+    size_t bucket = 64 - __builtin_clzll(us);
+    return std::min(bucket, kNumBuckets - 1);
+}
+
+// Upper bound of the bucket which holds the given quantile.
+uint64_t quantileUs(const uint64_t (&buckets)[kNumBuckets], uint64_t count, double quantile) {
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(count * quantile + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        seen += buckets[i];
+        if (seen >= target) return 1ULL << i;
+    }
+    return 1ULL << (kNumBuckets - 1);
+}
+
+Entry* findOrClaim(Table* table, uint64_t key, BinderStats::Side side,
+                   const String16* descriptor, int32_t handle, uint32_t code) {
+    for (size_t probe = 0; probe < kNumSlots; probe++) {
+        Entry& entry = table->entries[((key & (kNumSlots - 1)) + probe) & (kNumSlots - 1)];
+        uint64_t existing = entry.key.load(std::memory_order_acquire);
+        if (existing == 0) {
+            if (entry.key.compare_exchange_strong(existing, key, std::memory_order_acq_rel)) {
+                entry.side = side;
+                entry.name = descriptor != nullptr
+                        ? std::string(String8(*descriptor).c_str())
+                        : std::string(String8::format("<handle %d>", handle).c_str());
+                entry.code = code;
+                entry.ready.store(true, std::memory_order_release);
+                return &entry;
+            }
+            // lost the race, 'existing' now holds the winner's key
+        }
+        if (existing == key) return &entry;
+    }
+    return nullptr;
+}
+
+void writeAll(int fd, const String8& text) {
+    const char* data = text.c_str();
+    size_t remaining = text.size();
+    while (remaining > 0) {
+        ssize_t written = TEMP_FAILURE_RETRY(write(fd, data, remaining));
+        if (written <= 0) {
+            ALOGE("Failed to write binder stats: %s", strerror(errno));
+            return;
+        }
+        data += written;
+        remaining -= written;
+    }
+}
+
+bool isStatsCallerAllowed() {
+    IPCThreadState* self = IPCThreadState::selfOrNull();
+    uid_t uid = self != nullptr ? self->getCallingUid() : getuid();
+    return uid == AID_ROOT || uid == AID_SHELL || uid == AID_SYSTEM || uid == getuid();
+}
+
+} // namespace
+
+void BinderStats::setEnabled(bool enabled) {
+    if (enabled && gTable.load(std::memory_order_acquire) == nullptr) {
+        std::lock_guard<std::mutex> _l(gTableMutex);
+        if (gTable.load(std::memory_order_relaxed) == nullptr) {
+            gTable.store(new Table, std::memory_order_release);
+        }
+    }
+    sEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void BinderStats::reset() {
+    Table* table = gTable.load(std::memory_order_acquire);
+    if (table == nullptr) return;
+
+    for (Entry& entry : table->entries) {
+        entry.count.store(0, std::memory_order_relaxed);
+        entry.totalNs.store(0, std::memory_order_relaxed);
+        entry.maxNs.store(0, std::memory_order_relaxed);
+        for (auto& bucket : entry.buckets) bucket.store(0, std::memory_order_relaxed);
+    }
+    table->dropped.store(0, std::memory_order_relaxed);
+}
+
+void BinderStats::record(Side side, const String16* descriptor, int32_t handle, uint32_t code,
+                         nsecs_t durationNs) {
+    Table* table = gTable.load(std::memory_order_acquire);
+    if (table == nullptr) return;
+
+    uint64_t key = hashKey(side, descriptor, handle, code);
+    Entry* entry = findOrClaim(table, key, side, descriptor, handle, code);
+    if (entry == nullptr) {
+        table->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t ns = static_cast<uint64_t>(std::max<nsecs_t>(durationNs, 0));
+    entry->count.fetch_add(1, std::memory_order_relaxed);
+    entry->totalNs.fetch_add(ns, std::memory_order_relaxed);
+    entry->buckets[bucketFor(durationNs)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = entry->maxNs.load(std::memory_order_relaxed);
+    while (ns > max &&
+           !entry->maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void BinderStats::dump(int fd) {
+    String8 out;
+    out.appendFormat("Binder stats for pid %d (%s)\n", getpid(),
+                  isEnabled() ? "enabled" : "disabled");
+
+    Table* table = gTable.load(std::memory_order_acquire);
+    if (table == nullptr) {
+        writeAll(fd, out);
+        return;
+    }
+
+    struct Row {
+        const Entry* entry;
+        uint64_t count;
+        uint64_t totalNs;
+        uint64_t maxNs;
+        uint64_t buckets[kNumBuckets];
+    };
+    std::vector<Row> rows;
+    for (const Entry& entry : table->entries) {
+        if (!entry.ready.load(std::memory_order_acquire)) continue;
+        Row row{.entry = &entry,
+                .count = entry.count.load(std::memory_order_relaxed),
+                .totalNs = entry.totalNs.load(std::memory_order_relaxed),
+                .maxNs = entry.maxNs.load(std::memory_order_relaxed)};
+        if (row.count == 0) continue;
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            row.buckets[i] = entry.buckets[i].load(std::memory_order_relaxed);
+        }
+        rows.push_back(row);
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        if (a.entry->side != b.entry->side) return a.entry->side < b.entry->side;
+        if (a.entry->name != b.entry->name) return a.entry->name < b.entry->name;
+        return a.entry->code < b.entry->code;
+    });
+
+    for (const Row& row : rows) {
+        uint64_t maxUs = row.maxNs / 1000;
+        out.appendFormat("  %s %s code=%u count=%" PRIu64 " mean=%" PRIu64 "us p50<=%" PRIu64
+                         "us p99<=%" PRIu64 "us max=%" PRIu64 "us\n",
+                         row.entry->side == Side::SERVER ? "server" : "client",
+                         row.entry->name.c_str(), row.entry->code, row.count,
+                         row.totalNs / row.count / 1000,
+                         std::min(quantileUs(row.buckets, row.count, 0.5), maxUs + 1),
+                         std::min(quantileUs(row.buckets, row.count, 0.99), maxUs + 1), maxUs);
+    }
+    if (uint64_t dropped = table->dropped.load(std::memory_order_relaxed); dropped > 0) {
+        out.appendFormat("  %" PRIu64 " transactions dropped, table full\n", dropped);
+    }
+    writeAll(fd, out);
+}
+
+status_t BinderStats::onTransact(const Parcel& data) {
+    if (!isStatsCallerAllowed()) {
+        return PERMISSION_DENIED;
+    }
+
+    int32_t command;
+    if (status_t status = data.readInt32(&command); status != OK) return status;
+
+    switch (static_cast<IBinder::BinderStatsCommand>(command)) {
+        case IBinder::BinderStatsCommand::DUMP: {
+            int fd = data.readFileDescriptor();
+            if (fd < 0) return BAD_VALUE;
+            dump(fd);
+            return OK;
+        }
+        case IBinder::BinderStatsCommand::ENABLE:
+            setEnabled(true);
+            return OK;
+        case IBinder::BinderStatsCommand::DISABLE:
+            setEnabled(false);
+            return OK;
+        case IBinder::BinderStatsCommand::RESET:
+            reset();
+            return OK;
+    }
+    ALOGE("Unknown binder stats command %d", command);
+    return BAD_VALUE;
+}
+
+} // namespace android
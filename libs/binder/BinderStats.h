@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <binder/Parcel.h>
+#include <utils/String16.h>
+#include <utils/Timers.h>
+
+#include <atomic>
+
+namespace android {
+
+/**
+ * Process-wide latency histograms, one per (interface descriptor, transaction
+ * code) pair, for transactions served by BBinder::transact and sent by
+ * BpBinder::transact. Recording is lock-free and costs a single relaxed load
+ * while disabled. See IBinder::binderStatsCommand.
+ */
+class BinderStats {
+public:
+    enum class Side : uint32_t {
+        SERVER = 0,
+        CLIENT = 1,
+    };
+
+    static inline bool isEnabled() { return sEnabled.load(std::memory_order_relaxed); }
+    static inline nsecs_t now() { return systemTime(SYSTEM_TIME_MONOTONIC); }
+
+    static void setEnabled(bool enabled);
+    static void reset();
+
+    // If descriptor is null (e.g. a proxy which hasn't cached its descriptor
+    // yet), the entry is keyed by handle instead.
+    static void record(Side side, const String16* descriptor, int32_t handle, uint32_t code,
+                       nsecs_t durationNs);
+
+    static void dump(int fd);
+
+    // Handles IBinder::BINDER_STATS_TRANSACTION.
+    static status_t onTransact(const Parcel& data);
+
+private:
+    static std::atomic<bool> sEnabled;
+};
+
+} // namespace android
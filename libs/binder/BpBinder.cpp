@@ -28,6 +28,8 @@
 
 #include <stdio.h>
 
+#include "BinderStats.h"
+
 //#undef ALOGV
 //#define ALOGV(...) fprintf(stderr, __VA_ARGS__)
 
@@ -250,27 +252,12 @@ status_t BpBinder::transact(
 {
     // Once a binder has died, it will never come back to life.
     if (mAlive) {
-        bool privateVendor = flags & FLAG_PRIVATE_VENDOR;
-        // don't send userspace flags to the kernel
-        flags = flags & ~FLAG_PRIVATE_VENDOR;
-
-        // user transactions require a given stability level
-        if (code >= FIRST_CALL_TRANSACTION && code <= LAST_CALL_TRANSACTION) {
-            using android::internal::Stability;
-
-            auto category = Stability::getCategory(this);
-            Stability::Level required = privateVendor ? Stability::VENDOR
-                : Stability::getLocalLevel();
-
-            if (CC_UNLIKELY(!Stability::check(category, required))) {
-                ALOGE("Cannot do a user transaction on a %s binder (%s) in a %s context.",
-                    category.debugString().c_str(),
-                    String8(getInterfaceDescriptor()).c_str(),
-                    Stability::levelString(required).c_str());
-                return BAD_TYPE;
-            }
+        if (status_t status = checkTransactStability(code, &flags); status != OK) {
+            return status;
         }
 
+        nsecs_t startNs = CC_UNLIKELY(BinderStats::isEnabled()) ? BinderStats::now() : 0;
+
         status_t status;
         if (CC_UNLIKELY(isRpcBinder())) {
             status = rpcSession()->transact(rpcAddress(), code, data, reply, flags);
@@ -278,6 +265,15 @@ status_t BpBinder::transact(
             status = IPCThreadState::self()->transact(binderHandle(), code, data, reply, flags);
         }
 
+        if (CC_UNLIKELY(startNs != 0)) {
+            // Don't issue an INTERFACE_TRANSACTION just to label the sample.
+            bool cached = isDescriptorCached();
+            BinderStats::record(BinderStats::Side::CLIENT,
+                                cached ? &getInterfaceDescriptor() : nullptr,
+                                isRpcBinder() ? -1 : binderHandle(), code,
+                                BinderStats::now() - startNs);
+        }
+
         if (status == DEAD_OBJECT) mAlive = 0;
 
         return status;
@@ -286,6 +282,61 @@ status_t BpBinder::transact(
     return DEAD_OBJECT;
 }
 
+status_t BpBinder::transactAsync(uint32_t code, const Parcel& data,
+                                 std::function<void(status_t, const Parcel&)> callback,
+                                 uint32_t flags)
+{
+    if (!isRpcBinder()) {
+        ALOGE("Asynchronous transactions are only supported on RPC binders.");
+        return INVALID_OPERATION;
+    }
+
+    // Once a binder has died, it will never come back to life.
+    if (!mAlive) return DEAD_OBJECT;
+
+    if (status_t status = checkTransactStability(code, &flags); status != OK) {
+        return status;
+    }
+
+    sp<BpBinder> self = sp<BpBinder>::fromExisting(this);
+    status_t status = rpcSession()->transactAsync(
+            rpcAddress(), code, data, flags,
+            [self, callback = std::move(callback)](status_t result, const Parcel& reply) {
+                if (result == DEAD_OBJECT) self->mAlive = 0;
+                callback(result, reply);
+            });
+
+    if (status == DEAD_OBJECT) mAlive = 0;
+
+    return status;
+}
+
+status_t BpBinder::checkTransactStability(uint32_t code, uint32_t* flags)
+{
+    bool privateVendor = *flags & FLAG_PRIVATE_VENDOR;
+    // don't send userspace flags to the kernel
+    *flags = *flags & ~FLAG_PRIVATE_VENDOR;
+
+    // user transactions require a given stability level
+    if (code >= FIRST_CALL_TRANSACTION && code <= LAST_CALL_TRANSACTION) {
+        using android::internal::Stability;
+
+        auto category = Stability::getCategory(this);
+        Stability::Level required = privateVendor ? Stability::VENDOR
+            : Stability::getLocalLevel();
+
+        if (CC_UNLIKELY(!Stability::check(category, required))) {
+            ALOGE("Cannot do a user transaction on a %s binder (%s) in a %s context.",
+                category.debugString().c_str(),
+                String8(getInterfaceDescriptor()).c_str(),
+                Stability::levelString(required).c_str());
+            return BAD_TYPE;
+        }
+    }
+
+    return OK;
+}
+
 // NOLINTNEXTLINE(google-default-arguments)
 status_t BpBinder::linkToDeath(
     const sp<DeathRecipient>& recipient, void* cookie, uint32_t flags)
@@ -116,6 +116,9 @@ static const char *kCommandStrings[] = {
 
 static const int64_t kWorkSourcePropagatedBitIndex = 32;
 
+// Upper bound on oneway transactions queued by a ScopedOnewayBatch before they are sent.
+static constexpr size_t kMaxBatchedOneways = 64;
+
 static const char* getReturnString(uint32_t cmd)
 {
     size_t idx = cmd & _IOC_NRMASK;
@@ -475,6 +478,7 @@ void IPCThreadState::flushCommands()
 {
     if (mProcess->mDriverFD < 0)
         return;
+    flushOnewayBatch();
     talkWithDriver(false);
     // The flush could have caused post-write refcount decrements to have
     // been executed, which in turn could result in BC_RELEASE/BC_DECREFS
@@ -532,7 +536,9 @@ status_t IPCThreadState::getAndExecuteCommand()
         }
 
         pthread_mutex_lock(&mProcess->mThreadCountLock);
+        mProcess->onExecutingThreadsChangingLocked();
         mProcess->mExecutingThreadsCount++;
+        mProcess->onExecutingThreadsChangedLocked();
         if (mProcess->mExecutingThreadsCount >= mProcess->mMaxThreads &&
                 mProcess->mStarvationStartTimeMs == 0) {
             mProcess->mStarvationStartTimeMs = uptimeMillis();
@@ -542,6 +548,7 @@ status_t IPCThreadState::getAndExecuteCommand()
         result = executeCommand(cmd);
 
         pthread_mutex_lock(&mProcess->mThreadCountLock);
+        mProcess->onExecutingThreadsChangingLocked();
         mProcess->mExecutingThreadsCount--;
         if (mProcess->mExecutingThreadsCount < mProcess->mMaxThreads &&
                 mProcess->mStarvationStartTimeMs != 0) {
@@ -621,7 +628,12 @@ void IPCThreadState::joinThreadPool(bool isMain)
     mOut.writeInt32(isMain ? BC_ENTER_LOOPER : BC_REGISTER_LOOPER);
 
     mIsLooper = true;
+    pthread_mutex_lock(&mProcess->mThreadCountLock);
+    mProcess->mPoolThreadsCount++;
+    pthread_mutex_unlock(&mProcess->mThreadCountLock);
+
     status_t result;
+    bool reclaimed = false;
     do {
         processPendingDerefs();
         // now get the next command to be processed, waiting if necessary
@@ -637,8 +649,18 @@ void IPCThreadState::joinThreadPool(bool isMain)
         if(result == TIMED_OUT && !isMain) {
             break;
         }
+        if (!isMain && mProcess->shouldReclaimPooledThread()) {
+            reclaimed = true;
+            break;
+        }
     } while (result != -ECONNREFUSED && result != -EBADF);
 
+    if (!reclaimed) {
+        pthread_mutex_lock(&mProcess->mThreadCountLock);
+        mProcess->mPoolThreadsCount--;
+        pthread_mutex_unlock(&mProcess->mThreadCountLock);
+    }
+
     LOG_THREADPOOL("**** THREAD %p (PID %d) IS LEAVING THE THREAD POOL err=%d\n",
         (void*)pthread_self(), getpid(), result);
 
@@ -692,6 +714,12 @@ status_t IPCThreadState::transact(int32_t handle,
 
     flags |= TF_ACCEPT_FDS;
 
+    if ((flags & TF_ONE_WAY) != 0 && mOnewayBatchDepth > 0 && !mIsFlushingOnewayBatch) {
+        return queueOnewayTransaction(handle, code, data, flags);
+    }
+    // Queued oneway transactions must reach the driver before anything sent after them.
+    flushOnewayBatch();
+
     IF_LOG_TRANSACTIONS() {
         TextOutput::Bundle _b(alog);
         alog << "BC_TRANSACTION thr " << (void*)pthread_self() << " / hand "
@@ -754,6 +782,63 @@ status_t IPCThreadState::transact(int32_t handle,
     return err;
 }
 
+status_t IPCThreadState::queueOnewayTransaction(int32_t handle, uint32_t code,
+                                                const Parcel& data, uint32_t flags)
+{
+    // The BC_TRANSACTION written to mOut only points at the parcel data, so
+    // keep a copy (holding its own object references and fds) until it is sent.
+    Parcel& copy = mBatchedOneways.emplace_back();
+    if (data.mDeallocZero) copy.markSensitive();
+    status_t err = copy.appendFrom(&data, 0, data.dataSize());
+    if (err == NO_ERROR) {
+        LOG_ONEWAY(">>>> QUEUE from pid %d uid %d ONE WAY", getpid(), getuid());
+        err = writeTransactionData(BC_TRANSACTION, flags, handle, code, copy, nullptr);
+    }
+    if (err != NO_ERROR) {
+        mBatchedOneways.pop_back();
+        return (mLastError = err);
+    }
+
+    if (mBatchedOneways.size() >= kMaxBatchedOneways) {
+        return flushOnewayBatch();
+    }
+    return NO_ERROR;
+}
+
+status_t IPCThreadState::flushOnewayBatch()
+{
+    if (mBatchedOneways.empty() || mIsFlushingOnewayBatch) {
+        return NO_ERROR;
+    }
+    mIsFlushingOnewayBatch = true;
+
+    // The first call writes every queued command; each call then consumes the
+    // BR_TRANSACTION_COMPLETE (or failure) of one queued transaction.
+    status_t result = NO_ERROR;
+    for (size_t i = 0; i < mBatchedOneways.size(); i++) {
+        status_t err = waitForResponse(nullptr, nullptr);
+        if (err != NO_ERROR && result == NO_ERROR) {
+            result = err;
+        }
+    }
+    mBatchedOneways.clear();
+
+    mIsFlushingOnewayBatch = false;
+    if (result != NO_ERROR) mLastError = result;
+    return result;
+}
+
+IPCThreadState::ScopedOnewayBatch::ScopedOnewayBatch() : mSelf(IPCThreadState::self()) {
+    mSelf->mOnewayBatchDepth++;
+}
+
+IPCThreadState::ScopedOnewayBatch::~ScopedOnewayBatch() {
+    LOG_ALWAYS_FATAL_IF(mSelf->mOnewayBatchDepth == 0, "Unbalanced ScopedOnewayBatch");
+    if (--mSelf->mOnewayBatchDepth == 0) {
+        mSelf->flushOnewayBatch();
+    }
+}
+
 void IPCThreadState::incStrongHandle(int32_t handle, BpBinder *proxy)
 {
     LOG_REMOTEREFS("IPCThreadState::incStrongHandle(%d)\n", handle);
@@ -849,6 +934,8 @@ IPCThreadState::IPCThreadState()
         mPropagateWorkSource(false),
         mIsLooper(false),
         mIsFlushing(false),
+        mOnewayBatchDepth(0),
+        mIsFlushingOnewayBatch(false),
         mStrictModePolicy(0),
         mLastTransactionBinderFlags(0),
         mCallRestriction(mProcess->mCallRestriction) {
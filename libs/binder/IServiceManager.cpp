@@ -21,6 +21,11 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include <android/os/BnServiceCallback.h>
 #include <android/os/IServiceManager.h>
 #include <binder/IPCThreadState.h>
@@ -61,6 +66,15 @@ const String16& IServiceManager::getInterfaceDescriptor() const {
 IServiceManager::IServiceManager() {}
 IServiceManager::~IServiceManager() {}
 
+Vector<sp<IBinder>> IServiceManager::checkServices(const Vector<String16>& names) {
+    Vector<sp<IBinder>> res;
+    res.setCapacity(names.size());
+    for (const String16& name : names) {
+        res.push(checkService(name));
+    }
+    return res;
+}
+
 // From the old libbinder IServiceManager interface to IServiceManager.
 class ServiceManagerShim : public IServiceManager
 {
@@ -76,6 +90,7 @@ public:
     bool isDeclared(const String16& name) override;
     Vector<String16> getDeclaredInstances(const String16& interface) override;
     std::optional<String16> updatableViaApex(const String16& name) override;
+    Vector<sp<IBinder>> checkServices(const Vector<String16>& names) override;
 
     // for legacy ABI
     const String16& getInterfaceDescriptor() const override {
@@ -85,7 +100,40 @@ public:
         return IInterface::asBinder(mTheRealServiceManager).get();
     }
 private:
+    class CacheCallback;
+
+    sp<IBinder> getCachedService(const std::string& name) const;
+    void cacheService(const std::string& name, const sp<IBinder>& binder) const;
+    void onServiceRegistered(const std::string& name, const sp<IBinder>& binder);
+
     sp<AidlServiceManager> mTheRealServiceManager;
+
+    // Services this process has looked up, so that looking up a service again
+    // while this process still holds it doesn't need a call to the service
+    // manager. These are weak references, so that the cache doesn't keep
+    // services running (e.g. lazy services). Entries are skipped once the
+    // service is known to be dead, and replaced when the service manager
+    // notifies that the service has been registered again.
+    mutable std::mutex mCacheMutex;
+    mutable std::map<std::string, wp<IBinder>> mServiceCache;
+    // whether notifications were requested successfully, by service name
+    mutable std::map<std::string, bool> mCacheNotifications;
+    mutable sp<CacheCallback> mCacheCallback;
+};
+
+class ServiceManagerShim::CacheCallback : public android::os::BnServiceCallback {
+public:
+    explicit CacheCallback(const wp<ServiceManagerShim>& shim) : mShim(shim) {}
+
+    Status onRegistration(const std::string& name, const sp<IBinder>& binder) override {
+        if (sp<ServiceManagerShim> shim = mShim.promote(); shim != nullptr) {
+            shim->onServiceRegistered(name, binder);
+        }
+        return Status::ok();
+    }
+
+private:
+    wp<ServiceManagerShim> mShim;
 };
 
 [[clang::no_destroy]] static std::once_flag gSmOnce;
@@ -259,13 +307,109 @@ sp<IBinder> ServiceManagerShim::getService(const String16& name) const
 
 sp<IBinder> ServiceManagerShim::checkService(const String16& name) const
 {
+    const std::string name8 = String8(name).c_str();
+    if (sp<IBinder> cached = getCachedService(name8); cached != nullptr) return cached;
+
     sp<IBinder> ret;
-    if (!mTheRealServiceManager->checkService(String8(name).c_str(), &ret).isOk()) {
+    if (!mTheRealServiceManager->checkService(name8, &ret).isOk()) {
         return nullptr;
     }
+    cacheService(name8, ret);
     return ret;
 }
 
+Vector<sp<IBinder>> ServiceManagerShim::checkServices(const Vector<String16>& names) {
+    Vector<sp<IBinder>> res;
+    res.setCapacity(names.size());
+
+    std::vector<std::string> uncached;
+    std::vector<size_t> uncachedIndices;
+    for (size_t i = 0; i < names.size(); i++) {
+        std::string name = String8(names[i]).c_str();
+        res.push(getCachedService(name));
+        if (res[i] == nullptr) {
+            uncached.push_back(std::move(name));
+            uncachedIndices.push_back(i);
+        }
+    }
+    if (uncached.empty()) return res;
+
+    std::vector<sp<IBinder>> out;
+    Status status = mTheRealServiceManager->checkServices(uncached, &out);
+    if (status.exceptionCode() == Status::EX_TRANSACTION_FAILED &&
+        status.transactionError() == UNKNOWN_TRANSACTION) {
+        // older service manager
+        for (size_t i = 0; i < uncached.size(); i++) {
+            res.editItemAt(uncachedIndices[i]) = checkService(names[uncachedIndices[i]]);
+        }
+        return res;
+    }
+    if (!status.isOk() || out.size() != uncached.size()) {
+        ALOGE("Failed to check %zu services: %s", uncached.size(), status.toString8().c_str());
+        return res;
+    }
+
+    for (size_t i = 0; i < uncached.size(); i++) {
+        cacheService(uncached[i], out[i]);
+        res.editItemAt(uncachedIndices[i]) = out[i];
+    }
+    return res;
+}
+
+sp<IBinder> ServiceManagerShim::getCachedService(const std::string& name) const {
+    std::lock_guard<std::mutex> _l(mCacheMutex);
+
+    auto it = mServiceCache.find(name);
+    if (it == mServiceCache.end()) return nullptr;
+
+    // Only proxies are cached. BpBinder has a weak lifetime, so the object is
+    // valid while the weak reference is held, but promoting it once it has no
+    // strong references would try (and fail) to acquire its handle again.
+    sp<IBinder> binder;
+    if (it->second.unsafe_get()->getStrongCount() > 0) binder = it->second.promote();
+    if (binder == nullptr || !binder->isBinderAlive()) {
+        mServiceCache.erase(it);
+        return nullptr;
+    }
+    return binder;
+}
+
+void ServiceManagerShim::cacheService(const std::string& name, const sp<IBinder>& binder) const {
+    if (binder == nullptr || binder->remoteBinder() == nullptr) return;
+
+    std::unique_lock<std::mutex> _l(mCacheMutex);
+    if (auto it = mCacheNotifications.find(name); it != mCacheNotifications.end()) {
+        if (it->second) mServiceCache[name] = binder;
+        return;
+    }
+
+    // Without a way to know that the service was registered again, don't
+    // cache it at all.
+    mCacheNotifications[name] = false;
+    if (mCacheCallback == nullptr) {
+        mCacheCallback = sp<CacheCallback>::make(
+                sp<ServiceManagerShim>::fromExisting(const_cast<ServiceManagerShim*>(this)));
+    }
+    sp<CacheCallback> callback = mCacheCallback;
+    _l.unlock();
+
+    // not holding mCacheMutex, since the callback may be delivered right away
+    if (!mTheRealServiceManager->registerForNotifications(name, callback).isOk()) return;
+
+    _l.lock();
+    mCacheNotifications[name] = true;
+    mServiceCache.try_emplace(name, binder);
+}
+
+void ServiceManagerShim::onServiceRegistered(const std::string& name, const sp<IBinder>& binder) {
+    std::lock_guard<std::mutex> _l(mCacheMutex);
+    if (binder == nullptr || binder->remoteBinder() == nullptr) {
+        mServiceCache.erase(name);
+    } else {
+        mServiceCache[name] = binder;
+    }
+}
+
 status_t ServiceManagerShim::addService(const String16& name, const sp<IBinder>& service,
                                         bool allowIsolated, int dumpsysPriority)
 {
@@ -319,11 +463,16 @@ sp<IBinder> ServiceManagerShim::waitForService(const String16& name16)
 
     const std::string name = String8(name16).c_str();
 
+    if (sp<IBinder> cached = getCachedService(name); cached != nullptr) return cached;
+
     sp<IBinder> out;
     if (!mTheRealServiceManager->getService(name, &out).isOk()) {
         return nullptr;
     }
-    if (out != nullptr) return out;
+    if (out != nullptr) {
+        cacheService(name, out);
+        return out;
+    }
 
     sp<Waiter> waiter = sp<Waiter>::make();
     if (!mTheRealServiceManager->registerForNotifications(
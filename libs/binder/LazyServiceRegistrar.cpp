@@ -24,11 +24,16 @@
 #include <android/os/IServiceManager.h>
 #include <utils/Log.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <thread>
+
 namespace android {
 namespace binder {
 namespace internal {
 
 using AidlServiceManager = android::os::IServiceManager;
+using std::chrono::milliseconds;
 
 class ClientCounterCallbackImpl : public ::android::os::BnClientCallback {
 public:
@@ -40,6 +45,10 @@ public:
 
     void setActiveServicesCallback(const std::function<bool(bool)>& activeServicesCallback);
 
+    void setLingerPeriod(milliseconds linger, milliseconds maxLinger);
+
+    size_t getRestartsAvoided();
+
     bool tryUnregisterLocked();
 
     void reRegisterLocked();
@@ -81,6 +90,17 @@ private:
      */
     void maybeTryShutdownLocked();
 
+    /**
+     * Shuts down once the linger period passes without a client coming back.
+     */
+    void startLingeringLocked();
+
+    /**
+     * Called when a client comes back while lingering. Doubles the linger period if the client
+     * came back late in it, as the next gap is likely to be as long.
+     */
+    void stopLingeringLocked();
+
     // for below
     std::mutex mMutex;
 
@@ -97,6 +117,21 @@ private:
 
     // Callback used to report if there are services with clients
     std::function<bool(bool)> mActiveServicesCallback;
+
+    // How long to wait for a client to come back before shutting down, and how far that wait
+    // may grow. A zero linger period shuts down as soon as there are no clients.
+    milliseconds mLinger{0};
+    milliseconds mMaxLinger{0};
+
+    // Set while waiting for a client to come back. Bumping the generation cancels the wait.
+    bool mLingering = false;
+    uint64_t mLingerGeneration = 0;
+    std::chrono::steady_clock::time_point mLingerStart;
+    std::condition_variable mLingerCondition;
+
+    // Number of times a client came back while lingering, each of which would otherwise have
+    // restarted the process.
+    size_t mRestartsAvoided = 0;
 };
 
 class ClientCounterCallback {
@@ -113,6 +148,10 @@ public:
 
     void setActiveServicesCallback(const std::function<bool(bool)>& activeServicesCallback);
 
+    void setLingerPeriod(milliseconds linger, milliseconds maxLinger);
+
+    size_t getRestartsAvoided();
+
     bool tryUnregister();
 
     void reRegister();
@@ -236,8 +275,63 @@ void ClientCounterCallbackImpl::maybeTryShutdownLocked() {
     // client count change event, try to shutdown the process if its services
     // have no clients.
     if (!handledInCallback && mNumConnectedServices == 0) {
-        tryShutdownLocked();
+        if (mLinger > milliseconds::zero()) {
+            startLingeringLocked();
+        } else {
+            tryShutdownLocked();
+        }
+    }
+}
+
+void ClientCounterCallbackImpl::startLingeringLocked() {
+    if (mLingering) {
+        return;
     }
+
+    ALOGI("No clients in use, waiting %lld ms for a client to come back before shutting down.",
+          static_cast<long long>(mLinger.count()));
+
+    mLingering = true;
+    mLingerStart = std::chrono::steady_clock::now();
+    const uint64_t generation = ++mLingerGeneration;
+    const auto deadline = mLingerStart + mLinger;
+    std::thread([self = sp<ClientCounterCallbackImpl>::fromExisting(this), generation, deadline] {
+        std::unique_lock<std::mutex> lock(self->mMutex);
+        self->mLingerCondition.wait_until(lock, deadline, [&] {
+            return self->mLingerGeneration != generation;
+        });
+        if (self->mLingerGeneration != generation) {
+            return;
+        }
+
+        self->mLingering = false;
+        if (self->mForcePersist || self->mNumConnectedServices != 0) {
+            return;
+        }
+        self->tryShutdownLocked();
+    }).detach();
+}
+
+void ClientCounterCallbackImpl::stopLingeringLocked() {
+    if (!mLingering) {
+        return;
+    }
+
+    mLingering = false;
+    mLingerGeneration++;
+    mLingerCondition.notify_all();
+
+    mRestartsAvoided++;
+    const auto gap = std::chrono::duration_cast<milliseconds>(std::chrono::steady_clock::now() -
+                                                              mLingerStart);
+    if (gap * 2 > mLinger && mLinger < mMaxLinger) {
+        mLinger = std::min(mLinger * 2, mMaxLinger);
+    }
+
+    ALOGI("A client came back after %lld ms, avoiding a restart (%zu so far). Linger period is "
+          "now %lld ms.",
+          static_cast<long long>(gap.count()), mRestartsAvoided,
+          static_cast<long long>(mLinger.count()));
 }
 
 Status ClientCounterCallbackImpl::onClients(const sp<IBinder>& service, bool clients) {
@@ -262,6 +356,10 @@ Status ClientCounterCallbackImpl::onClients(const sp<IBinder>& service, bool cli
     ALOGI("Process has %zu (of %zu available) client(s) in use after notification %s has clients: %d",
           mNumConnectedServices, mRegisteredServices.size(), name.c_str(), clients);
 
+    if (mNumConnectedServices != 0) {
+        stopLingeringLocked();
+    }
+
     maybeTryShutdownLocked();
     return Status::ok();
 }
@@ -283,6 +381,17 @@ void ClientCounterCallbackImpl::setActiveServicesCallback(const std::function<bo
     mActiveServicesCallback = activeServicesCallback;
 }
 
+void ClientCounterCallbackImpl::setLingerPeriod(milliseconds linger, milliseconds maxLinger) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLinger = std::max(linger, milliseconds::zero());
+    mMaxLinger = std::max(maxLinger, mLinger);
+}
+
+size_t ClientCounterCallbackImpl::getRestartsAvoided() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mRestartsAvoided;
+}
+
 ClientCounterCallback::ClientCounterCallback() {
       mImpl = sp<ClientCounterCallbackImpl>::make();
 }
@@ -301,6 +410,14 @@ void ClientCounterCallback::setActiveServicesCallback(const std::function<bool(b
     mImpl->setActiveServicesCallback(activeServicesCallback);
 }
 
+void ClientCounterCallback::setLingerPeriod(milliseconds linger, milliseconds maxLinger) {
+    mImpl->setLingerPeriod(linger, maxLinger);
+}
+
+size_t ClientCounterCallback::getRestartsAvoided() {
+    return mImpl->getRestartsAvoided();
+}
+
 bool ClientCounterCallback::tryUnregister() {
     // see comments in header, this should only be called from the active
     // services callback, see also b/191781736
@@ -341,6 +458,15 @@ void LazyServiceRegistrar::setActiveServicesCallback(const std::function<bool(bo
     mClientCC->setActiveServicesCallback(activeServicesCallback);
 }
 
+void LazyServiceRegistrar::setLingerPeriod(std::chrono::milliseconds linger,
+                                           std::chrono::milliseconds maxLinger) {
+    mClientCC->setLingerPeriod(linger, maxLinger);
+}
+
+size_t LazyServiceRegistrar::getRestartsAvoided() {
+    return mClientCC->getRestartsAvoided();
+}
+
 bool LazyServiceRegistrar::tryUnregister() {
     return mClientCC->tryUnregister();
 }
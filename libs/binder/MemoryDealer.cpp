@@ -25,6 +25,9 @@
 #include <utils/String8.h>
 #include <utils/threads.h>
 
+#include <algorithm>
+#include <unordered_map>
+
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -120,14 +123,23 @@ private:
 
 // ----------------------------------------------------------------------------
 
-class SimpleBestFitAllocator
+/*
+ * A segregated-fit allocator.
+ *
+ * Chunks are kept in address order so freed chunks can be merged with their
+ * neighbors. Free chunks are also kept in one list per power-of-two size class,
+ * so an allocation only looks at the free chunks of its own size class, or
+ * takes the first chunk of a larger one. Allocated chunks are looked up by
+ * offset when they're freed.
+ */
+class SegregatedFitAllocator
 {
     enum {
         PAGE_ALIGNED = 0x00000001
     };
 public:
-    explicit SimpleBestFitAllocator(size_t size);
-    ~SimpleBestFitAllocator();
+    explicit SegregatedFitAllocator(size_t size);
+    ~SegregatedFitAllocator();
 
     size_t      allocate(size_t size, uint32_t flags = 0);
     status_t    deallocate(size_t offset);
@@ -141,15 +153,29 @@ private:
 
     struct chunk_t {
         chunk_t(size_t start, size_t size)
-        : start(start), size(size), free(1), prev(nullptr), next(nullptr) {
+        : start(start), size(size), free(true), prev(nullptr), next(nullptr),
+          freePrev(nullptr), freeNext(nullptr) {
         }
         size_t              start;
-        size_t              size : 28;
-        int                 free : 4;
+        size_t              size;
+        bool                free;
+        // Neighbors in address order.
         mutable chunk_t*    prev;
         mutable chunk_t*    next;
+        // Neighbors in the free list of the chunk's size class.
+        chunk_t*            freePrev;
+        chunk_t*            freeNext;
     };
 
+    // Chunks of [2^i, 2^(i+1)) units are in mFreeLists[i].
+    static constexpr size_t kSizeClassCount = sizeof(size_t) * 8;
+
+    static size_t sizeClass(size_t size);
+    size_t   alignmentPadding(const chunk_t* chunk, uint32_t flags) const;
+    void     insertFree(chunk_t* chunk);
+    void     removeFree(chunk_t* chunk);
+    chunk_t* findFree(size_t size, uint32_t flags) const;
+
     ssize_t  alloc(size_t size, uint32_t flags);
     chunk_t* dealloc(size_t start);
     void     dump_l(const char* what) const;
@@ -158,7 +184,12 @@ private:
     static const int    kMemoryAlign;
     mutable Mutex       mLock;
     LinkedList<chunk_t> mList;
+    chunk_t*            mFreeLists[kSizeClassCount] = {};
+    // Bit i is set when mFreeLists[i] isn't empty.
+    size_t              mFreeListMask = 0;
+    std::unordered_map<size_t, chunk_t*> mAllocated;
     size_t              mHeapSize;
+    size_t              mPageUnits;
 };
 
 // ----------------------------------------------------------------------------
@@ -229,7 +260,7 @@ Allocation::~Allocation()
 
 MemoryDealer::MemoryDealer(size_t size, const char* name, uint32_t flags)
       : mHeap(sp<MemoryHeapBase>::make(size, flags, name)),
-        mAllocator(new SimpleBestFitAllocator(size)) {}
+        mAllocator(new SegregatedFitAllocator(size)) {}
 
 MemoryDealer::~MemoryDealer()
 {
@@ -260,31 +291,35 @@ const sp<IMemoryHeap>& MemoryDealer::heap() const {
     return mHeap;
 }
 
-SimpleBestFitAllocator* MemoryDealer::allocator() const {
+SegregatedFitAllocator* MemoryDealer::allocator() const {
     return mAllocator;
 }
 
 // static
 size_t MemoryDealer::getAllocationAlignment()
 {
-    return SimpleBestFitAllocator::getAllocationAlignment();
+    return SegregatedFitAllocator::getAllocationAlignment();
 }
 
 // ----------------------------------------------------------------------------
 
 // align all the memory blocks on a cache-line boundary
-const int SimpleBestFitAllocator::kMemoryAlign = 32;
+const int SegregatedFitAllocator::kMemoryAlign = 32;
 
-SimpleBestFitAllocator::SimpleBestFitAllocator(size_t size)
+SegregatedFitAllocator::SegregatedFitAllocator(size_t size)
 {
     size_t pagesize = getpagesize();
     mHeapSize = ((size + pagesize-1) & ~(pagesize-1));
+    mPageUnits = pagesize / kMemoryAlign;
 
     chunk_t* node = new chunk_t(0, mHeapSize / kMemoryAlign);
     mList.insertHead(node);
+    if (node->size) {
+        insertFree(node);
+    }
 }
 
-SimpleBestFitAllocator::~SimpleBestFitAllocator()
+SegregatedFitAllocator::~SegregatedFitAllocator()
 {
     while(!mList.isEmpty()) {
         chunk_t* removed = mList.remove(mList.head());
@@ -299,19 +334,19 @@ SimpleBestFitAllocator::~SimpleBestFitAllocator()
     }
 }
 
-size_t SimpleBestFitAllocator::size() const
+size_t SegregatedFitAllocator::size() const
 {
     return mHeapSize;
 }
 
-size_t SimpleBestFitAllocator::allocate(size_t size, uint32_t flags)
+size_t SegregatedFitAllocator::allocate(size_t size, uint32_t flags)
 {
     Mutex::Autolock _l(mLock);
     ssize_t offset = alloc(size, flags);
     return offset;
 }
 
-status_t SimpleBestFitAllocator::deallocate(size_t offset)
+status_t SegregatedFitAllocator::deallocate(size_t offset)
 {
     Mutex::Autolock _l(mLock);
     chunk_t const * const freed = dealloc(offset);
@@ -321,128 +356,180 @@ status_t SimpleBestFitAllocator::deallocate(size_t offset)
     return NAME_NOT_FOUND;
 }
 
-ssize_t SimpleBestFitAllocator::alloc(size_t size, uint32_t flags)
+// static
+size_t SegregatedFitAllocator::sizeClass(size_t size)
+{
+    return sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(size);
+}
+
+size_t SegregatedFitAllocator::alignmentPadding(const chunk_t* chunk, uint32_t flags) const
 {
-    if (size == 0) {
+    if (!(flags & PAGE_ALIGNED)) {
         return 0;
     }
-    size = (size + kMemoryAlign-1) / kMemoryAlign;
-    chunk_t* free_chunk = nullptr;
-    chunk_t* cur = mList.head();
+    return -chunk->start & (mPageUnits - 1);
+}
 
-    size_t pagesize = getpagesize();
-    while (cur) {
-        int extra = 0;
-        if (flags & PAGE_ALIGNED)
-            extra = ( -cur->start & ((pagesize/kMemoryAlign)-1) ) ;
-
-        // best fit
-        if (cur->free && (cur->size >= (size+extra))) {
-            if ((!free_chunk) || (cur->size < free_chunk->size)) {
-                free_chunk = cur;
+void SegregatedFitAllocator::insertFree(chunk_t* chunk)
+{
+    const size_t sc = sizeClass(chunk->size);
+    chunk->freePrev = nullptr;
+    chunk->freeNext = mFreeLists[sc];
+    if (mFreeLists[sc]) {
+        mFreeLists[sc]->freePrev = chunk;
+    }
+    mFreeLists[sc] = chunk;
+    mFreeListMask |= size_t(1) << sc;
+}
+
+void SegregatedFitAllocator::removeFree(chunk_t* chunk)
+{
+    const size_t sc = sizeClass(chunk->size);
+    if (chunk->freePrev) {
+        chunk->freePrev->freeNext = chunk->freeNext;
+    } else {
+        mFreeLists[sc] = chunk->freeNext;
+    }
+    if (chunk->freeNext) {
+        chunk->freeNext->freePrev = chunk->freePrev;
+    }
+    chunk->freePrev = chunk->freeNext = nullptr;
+    if (!mFreeLists[sc]) {
+        mFreeListMask &= ~(size_t(1) << sc);
+    }
+}
+
+SegregatedFitAllocator::chunk_t* SegregatedFitAllocator::findFree(size_t size,
+        uint32_t flags) const
+{
+    // The request's own size class holds chunks both smaller and larger than
+    // it, so pick the best fit there.
+    const size_t first = sizeClass(size);
+    chunk_t* best = nullptr;
+    for (chunk_t* cur = mFreeLists[first]; cur; cur = cur->freeNext) {
+        if (cur->size >= size + alignmentPadding(cur, flags)) {
+            if (!best || cur->size < best->size) {
+                best = cur;
             }
             if (cur->size == size) {
                 break;
             }
         }
-        cur = cur->next;
+    }
+    if (best) {
+        return best;
     }
 
-    if (free_chunk) {
-        const size_t free_size = free_chunk->size;
-        free_chunk->free = 0;
-        free_chunk->size = size;
-        if (free_size > size) {
-            int extra = 0;
-            if (flags & PAGE_ALIGNED)
-                extra = ( -free_chunk->start & ((pagesize/kMemoryAlign)-1) ) ;
-            if (extra) {
-                chunk_t* split = new chunk_t(free_chunk->start, extra);
-                free_chunk->start += extra;
-                mList.insertBefore(free_chunk, split);
+    // Every chunk of a larger size class is big enough, unless it has to be
+    // page aligned.
+    size_t mask = first + 1 < kSizeClassCount ? mFreeListMask >> (first + 1) : 0;
+    while (mask) {
+        const size_t sc = first + 1 + __builtin_ctzll(mask);
+        for (chunk_t* cur = mFreeLists[sc]; cur; cur = cur->freeNext) {
+            if (cur->size >= size + alignmentPadding(cur, flags)) {
+                return cur;
             }
+        }
+        mask &= mask - 1;
+    }
+    return nullptr;
+}
 
-            ALOGE_IF((flags&PAGE_ALIGNED) && 
-                    ((free_chunk->start*kMemoryAlign)&(pagesize-1)),
-                    "PAGE_ALIGNED requested, but page is not aligned!!!");
+ssize_t SegregatedFitAllocator::alloc(size_t size, uint32_t flags)
+{
+    if (size == 0) {
+        return 0;
+    }
+    size = (size + kMemoryAlign-1) / kMemoryAlign;
 
-            const ssize_t tail_free = free_size - (size+extra);
-            if (tail_free > 0) {
-                chunk_t* split = new chunk_t(
-                        free_chunk->start + free_chunk->size, tail_free);
-                mList.insertAfter(free_chunk, split);
-            }
-        }
-        return (free_chunk->start)*kMemoryAlign;
+    chunk_t* free_chunk = findFree(size, flags);
+    if (!free_chunk) {
+        return NO_MEMORY;
+    }
+
+    removeFree(free_chunk);
+    const size_t extra = alignmentPadding(free_chunk, flags);
+    if (extra) {
+        chunk_t* split = new chunk_t(free_chunk->start, extra);
+        free_chunk->start += extra;
+        free_chunk->size -= extra;
+        mList.insertBefore(free_chunk, split);
+        insertFree(split);
     }
-    return NO_MEMORY;
+
+    ALOGE_IF((flags&PAGE_ALIGNED) &&
+            ((free_chunk->start*kMemoryAlign)&(mPageUnits*kMemoryAlign-1)),
+            "PAGE_ALIGNED requested, but page is not aligned!!!");
+
+    const size_t tail_free = free_chunk->size - size;
+    if (tail_free > 0) {
+        chunk_t* split = new chunk_t(free_chunk->start + size, tail_free);
+        mList.insertAfter(free_chunk, split);
+        insertFree(split);
+    }
+    free_chunk->size = size;
+    free_chunk->free = false;
+    mAllocated.emplace(free_chunk->start, free_chunk);
+    return (free_chunk->start)*kMemoryAlign;
 }
 
-SimpleBestFitAllocator::chunk_t* SimpleBestFitAllocator::dealloc(size_t start)
+SegregatedFitAllocator::chunk_t* SegregatedFitAllocator::dealloc(size_t start)
 {
-    start = start / kMemoryAlign;
-    chunk_t* cur = mList.head();
-    while (cur) {
-        if (cur->start == start) {
-            LOG_FATAL_IF(cur->free,
-                "block at offset 0x%08lX of size 0x%08X already freed",
-                cur->start*kMemoryAlign, cur->size*kMemoryAlign);
-
-            // merge freed blocks together
-            chunk_t* freed = cur;
-            cur->free = 1;
-            do {
-                chunk_t* const p = cur->prev;
-                chunk_t* const n = cur->next;
-                if (p && (p->free || !cur->size)) {
-                    freed = p;
-                    p->size += cur->size;
-                    mList.remove(cur);
-                    delete cur;
-                }
-                cur = n;
-            } while (cur && cur->free);
-
-            #ifndef NDEBUG
-                if (!freed->free) {
-                    dump_l("dealloc (!freed->free)");
-                }
-            #endif
-            LOG_FATAL_IF(!freed->free,
-                "freed block at offset 0x%08lX of size 0x%08X is not free!",
-                freed->start * kMemoryAlign, freed->size * kMemoryAlign);
-
-            return freed;
-        }
-        cur = cur->next;
+    auto it = mAllocated.find(start / kMemoryAlign);
+    if (it == mAllocated.end()) {
+        return nullptr;
     }
-    return nullptr;
+    chunk_t* freed = it->second;
+    mAllocated.erase(it);
+    freed->free = true;
+
+    // merge freed blocks together
+    chunk_t* const p = freed->prev;
+    if (p && p->free) {
+        removeFree(p);
+        p->size += freed->size;
+        mList.remove(freed);
+        delete freed;
+        freed = p;
+    }
+    chunk_t* const n = freed->next;
+    if (n && n->free) {
+        removeFree(n);
+        freed->size += n->size;
+        mList.remove(n);
+        delete n;
+    }
+    insertFree(freed);
+    return freed;
 }
 
-void SimpleBestFitAllocator::dump(const char* what) const
+void SegregatedFitAllocator::dump(const char* what) const
 {
     Mutex::Autolock _l(mLock);
     dump_l(what);
 }
 
-void SimpleBestFitAllocator::dump_l(const char* what) const
+void SegregatedFitAllocator::dump_l(const char* what) const
 {
     String8 result;
     dump_l(result, what);
     ALOGD("%s", result.string());
 }
 
-void SimpleBestFitAllocator::dump(String8& result,
+void SegregatedFitAllocator::dump(String8& result,
         const char* what) const
 {
     Mutex::Autolock _l(mLock);
     dump_l(result, what);
 }
 
-void SimpleBestFitAllocator::dump_l(String8& result,
+void SegregatedFitAllocator::dump_l(String8& result,
         const char* what) const
 {
     size_t size = 0;
+    size_t freeSize = 0;
+    size_t largestFree = 0;
+    size_t freeCount = 0;
     int32_t i = 0;
     chunk_t const* cur = mList.head();
     
@@ -467,8 +554,13 @@ void SimpleBestFitAllocator::dump_l(String8& result,
         
         result.append(buffer);
 
-        if (!cur->free)
+        if (!cur->free) {
             size += cur->size*kMemoryAlign;
+        } else {
+            freeSize += cur->size*kMemoryAlign;
+            largestFree = std::max(largestFree, cur->size*kMemoryAlign);
+            freeCount++;
+        }
 
         i++;
         cur = cur->next;
@@ -476,6 +568,31 @@ void SimpleBestFitAllocator::dump_l(String8& result,
     snprintf(buffer, SIZE,
             "  size allocated: %u (%u KB)\n", int(size), int(size/1024));
     result.append(buffer);
+
+    // How much of the free space can't be used by a single allocation.
+    const int fragmentation =
+            freeSize ? int(100 - (largestFree * 100) / freeSize) : 0;
+    snprintf(buffer, SIZE,
+            "  allocations: %zu, free: %u KB in %zu chunks, largest free: %u KB, "
+            "fragmentation: %d%%\n",
+            mAllocated.size(), int(freeSize/1024), freeCount, int(largestFree/1024),
+            fragmentation);
+    result.append(buffer);
+
+    snprintf(buffer, SIZE, "  free chunks per size class:");
+    result.append(buffer);
+    for (size_t sc = 0; sc < kSizeClassCount; sc++) {
+        size_t count = 0;
+        for (chunk_t const* c = mFreeLists[sc]; c; c = c->freeNext) {
+            count++;
+        }
+        if (count) {
+            snprintf(buffer, SIZE, " %zu+:%zu",
+                    (size_t(1) << sc) * kMemoryAlign, count);
+            result.append(buffer);
+        }
+    }
+    result.append("\n");
 }
 
 
@@ -89,6 +89,62 @@ static std::atomic<size_t> gParcelGlobalAllocSize;
 
 static size_t gMaxFds = 0;
 
+// Most parcels are small and short-lived, so instead of going back to malloc
+// for every transaction, buffers of small parcels are kept for reuse by the
+// thread which frees them. sizeof(Parcel) can't change (see above), so this
+// can't be done with storage inside of Parcel.
+namespace {
+struct ParcelBufferPool {
+    static constexpr size_t kBufferCapacity = 256;
+    static constexpr size_t kMaxBuffers = 4;
+
+    uint8_t* buffers[kMaxBuffers];
+    size_t count;
+    bool disabled; // the thread is exiting
+};
+
+// trivially destructible, so that it is still usable by parcels destroyed
+// during thread exit
+thread_local ParcelBufferPool tParcelBufferPool;
+
+struct ParcelBufferPoolCleanup {
+    ~ParcelBufferPoolCleanup() {
+        tParcelBufferPool.disabled = true;
+        while (tParcelBufferPool.count > 0) {
+            free(tParcelBufferPool.buffers[--tParcelBufferPool.count]);
+        }
+    }
+};
+} // namespace
+
+// Allocates at least 'desired' bytes of parcel data, setting the actual
+// capacity of the buffer returned.
+static uint8_t* allocParcelData(size_t desired, size_t* capacity) {
+    if (desired > ParcelBufferPool::kBufferCapacity) {
+        *capacity = desired;
+        return (uint8_t*)malloc(desired);
+    }
+
+    ParcelBufferPool& pool = tParcelBufferPool;
+    *capacity = ParcelBufferPool::kBufferCapacity;
+    if (pool.count > 0) {
+        return pool.buffers[--pool.count];
+    }
+    return (uint8_t*)malloc(ParcelBufferPool::kBufferCapacity);
+}
+
+static void freeParcelData(uint8_t* data, size_t capacity) {
+    ParcelBufferPool& pool = tParcelBufferPool;
+    if (capacity == ParcelBufferPool::kBufferCapacity && !pool.disabled &&
+        pool.count < ParcelBufferPool::kMaxBuffers) {
+        thread_local ParcelBufferPoolCleanup cleanup;
+        (void)cleanup;
+        pool.buffers[pool.count++] = data;
+        return;
+    }
+    free(data);
+}
+
 // Maximum size of a blob to transfer in-place.
 static const size_t BLOB_INPLACE_LIMIT = 16 * 1024;
 
@@ -2237,7 +2293,7 @@ void Parcel::freeDataNoInit()
             if (mDeallocZero) {
                 zeroMemory(mData, mDataSize);
             }
-            free(mData);
+            freeParcelData(mData, mDataCapacity);
         }
         if (mObjects) free(mObjects);
     }
@@ -2358,7 +2414,8 @@ status_t Parcel::continueWrite(size_t desired)
 
         // If there is a different owner, we need to take
         // posession.
-        uint8_t* data = (uint8_t*)malloc(desired);
+        size_t capacity;
+        uint8_t* data = allocParcelData(desired, &capacity);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -2368,7 +2425,7 @@ status_t Parcel::continueWrite(size_t desired)
         if (objectsSize) {
             objects = (binder_size_t*)calloc(objectsSize, sizeof(binder_size_t));
             if (!objects) {
-                free(data);
+                freeParcelData(data, capacity);
 
                 mError = NO_MEMORY;
                 return NO_MEMORY;
@@ -2392,15 +2449,15 @@ status_t Parcel::continueWrite(size_t desired)
         mOwner(this, mData, mDataSize, mObjects, mObjectsSize);
         mOwner = nullptr;
 
-        LOG_ALLOC("Parcel %p: taking ownership of %zu capacity", this, desired);
-        gParcelGlobalAllocSize += desired;
+        LOG_ALLOC("Parcel %p: taking ownership of %zu capacity", this, capacity);
+        gParcelGlobalAllocSize += capacity;
         gParcelGlobalAllocCount++;
 
         mData = data;
         mObjects = objects;
         mDataSize = (mDataSize < desired) ? mDataSize : desired;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
-        mDataCapacity = desired;
+        mDataCapacity = capacity;
         mObjectsSize = mObjectsCapacity = objectsSize;
         mNextObjectHint = 0;
         mObjectsSorted = false;
@@ -2463,7 +2520,8 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
+        size_t capacity;
+        uint8_t* data = allocParcelData(desired, &capacity);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -2474,15 +2532,15 @@ status_t Parcel::continueWrite(size_t desired)
             ALOGE("continueWrite: %zu/%p/%zu/%zu", mDataCapacity, mObjects, mObjectsCapacity, desired);
         }
 
-        LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, desired);
-        gParcelGlobalAllocSize += desired;
+        LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, capacity);
+        gParcelGlobalAllocSize += capacity;
         gParcelGlobalAllocCount++;
 
         mData = data;
         mDataSize = mDataPos = 0;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
         ALOGV("continueWrite Setting data pos of %p to %zu", this, mDataPos);
-        mDataCapacity = desired;
+        mDataCapacity = capacity;
     }
 
     return NO_ERROR;
@@ -25,11 +25,13 @@
 #include <cutils/atomic.h>
 #include <utils/Log.h>
 #include <utils/String8.h>
+#include <utils/Timers.h>
 #include <utils/threads.h>
 
 #include "Static.h"
 #include "binder_module.h"
 
+#include <algorithm>
 #include <errno.h>
 #include <fcntl.h>
 #include <mutex>
@@ -350,15 +352,95 @@ status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
     LOG_ALWAYS_FATAL_IF(mThreadPoolStarted && maxThreads < mMaxThreads,
            "Binder threadpool cannot be shrunk after starting");
     status_t result = NO_ERROR;
-    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &maxThreads) != -1) {
+    pthread_mutex_lock(&mThreadCountLock);
+    // The driver still counts the threads that left the pool, so they have to be added for
+    // it to spawn replacements.
+    size_t driverMaxThreads = maxThreads + mReclaimedThreadsCount;
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &driverMaxThreads) != -1) {
         mMaxThreads = maxThreads;
     } else {
         result = -errno;
         ALOGE("Binder ioctl to set max threads failed: %s", strerror(-result));
     }
+    pthread_mutex_unlock(&mThreadCountLock);
     return result;
 }
 
+status_t ProcessState::setThreadPoolIdleTimeout(int64_t timeoutMs, size_t minThreads) {
+    if (timeoutMs < 0) {
+        return BAD_VALUE;
+    }
+    pthread_mutex_lock(&mThreadCountLock);
+    mIdleTimeoutMs = timeoutMs;
+    mMinThreads = minThreads;
+    mDemandWindowStartMs = ns2ms(systemTime(SYSTEM_TIME_MONOTONIC));
+    mDemandWindowPeak = mExecutingThreadsCount;
+    mPreviousDemandWindowPeak = mExecutingThreadsCount;
+    pthread_mutex_unlock(&mThreadCountLock);
+    return NO_ERROR;
+}
+
+ProcessState::ThreadPoolStats ProcessState::getThreadPoolStats() {
+    ThreadPoolStats stats;
+    pthread_mutex_lock(&mThreadCountLock);
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    const int64_t executingTimeNs = mExecutingThreadsTimeNs +
+            static_cast<int64_t>(mExecutingThreadsCount) * (now - mExecutingThreadsChangeTimeNs);
+    stats.threadCount = mPoolThreadsCount;
+    stats.reclaimedThreadCount = mReclaimedThreadsCount;
+    stats.peakExecutingThreadCount = mPeakExecutingThreadsCount;
+    stats.averageExecutingThreadCount = now > mCreationTimeNs
+            ? static_cast<double>(executingTimeNs) / (now - mCreationTimeNs)
+            : 0.0;
+    pthread_mutex_unlock(&mThreadCountLock);
+    return stats;
+}
+
+void ProcessState::onExecutingThreadsChangingLocked() {
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    mExecutingThreadsTimeNs +=
+            static_cast<int64_t>(mExecutingThreadsCount) * (now - mExecutingThreadsChangeTimeNs);
+    mExecutingThreadsChangeTimeNs = now;
+}
+
+void ProcessState::onExecutingThreadsChangedLocked() {
+    mPeakExecutingThreadsCount = std::max(mPeakExecutingThreadsCount, mExecutingThreadsCount);
+    mDemandWindowPeak = std::max(mDemandWindowPeak, mExecutingThreadsCount);
+}
+
+bool ProcessState::shouldReclaimPooledThread() {
+    bool reclaim = false;
+    pthread_mutex_lock(&mThreadCountLock);
+    if (mIdleTimeoutMs > 0) {
+        const int64_t nowMs = ns2ms(systemTime(SYSTEM_TIME_MONOTONIC));
+        if (nowMs - mDemandWindowStartMs >= mIdleTimeoutMs) {
+            // Nothing was recorded for the windows skipped while every thread was idle.
+            mPreviousDemandWindowPeak = nowMs - mDemandWindowStartMs < 2 * mIdleTimeoutMs
+                    ? mDemandWindowPeak
+                    : mExecutingThreadsCount;
+            mDemandWindowPeak = mExecutingThreadsCount;
+            mDemandWindowStartMs = nowMs;
+        }
+        // Keep one thread on top of the recent demand so that the next command doesn't have
+        // to wait for the driver to spawn a thread.
+        const size_t neededThreads =
+                std::max(mMinThreads, std::max(mDemandWindowPeak, mPreviousDemandWindowPeak) + 1);
+        if (mPoolThreadsCount > neededThreads) {
+            mPoolThreadsCount--;
+            mReclaimedThreadsCount++;
+            size_t driverMaxThreads = mMaxThreads + mReclaimedThreadsCount;
+            if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &driverMaxThreads) == -1) {
+                ALOGE("Binder ioctl to set max threads failed: %s", strerror(errno));
+            }
+            ALOGV("Reclaiming pooled thread, %zu threads needed, %zu left", neededThreads,
+                  mPoolThreadsCount);
+            reclaim = true;
+        }
+    }
+    pthread_mutex_unlock(&mThreadCountLock);
+    return reclaim;
+}
+
 status_t ProcessState::enableOnewaySpamDetection(bool enable) {
     uint32_t enableDetection = enable ? 1 : 0;
     if (ioctl(mDriverFD, BINDER_ENABLE_ONEWAY_SPAM_DETECTION, &enableDetection) == -1) {
@@ -419,6 +501,17 @@ ProcessState::ProcessState(const char *driver)
     , mWaitingForThreads(0)
     , mMaxThreads(DEFAULT_MAX_BINDER_THREADS)
     , mStarvationStartTimeMs(0)
+    , mPoolThreadsCount(0)
+    , mReclaimedThreadsCount(0)
+    , mIdleTimeoutMs(0)
+    , mMinThreads(0)
+    , mDemandWindowStartMs(0)
+    , mDemandWindowPeak(0)
+    , mPreviousDemandWindowPeak(0)
+    , mPeakExecutingThreadsCount(0)
+    , mExecutingThreadsTimeNs(0)
+    , mExecutingThreadsChangeTimeNs(systemTime(SYSTEM_TIME_MONOTONIC))
+    , mCreationTimeNs(mExecutingThreadsChangeTimeNs)
     , mThreadPoolStarted(false)
     , mThreadPoolSeq(1)
     , mCallRestriction(CallRestriction::NONE)
@@ -16,17 +16,22 @@
 
 #define LOG_TAG "RpcServer"
 
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
+#include <algorithm>
+#include <chrono>
 #include <thread>
 #include <vector>
 
+#include <android-base/macros.h>
 #include <android-base/scopeguard.h>
 #include <binder/Parcel.h>
 #include <binder/RpcServer.h>
 #include <log/log.h>
 #include "RpcState.h"
+#include "RpcTransport.h"
 
 #include "RpcSocketAddress.h"
 #include "RpcWireFormat.h"
@@ -36,6 +41,17 @@ namespace android {
 using base::ScopeGuard;
 using base::unique_fd;
 
+// Connections which don't send their header in time are dropped by join().
+static constexpr std::chrono::seconds kConnectionHeaderTimeout(10);
+
+struct RpcServer::PendingConnection {
+    unique_fd fd;
+    RpcConnectionHeader header{};
+    size_t headerReceived = 0;
+    std::vector<unique_fd> fds;
+    std::chrono::steady_clock::time_point acceptTime = std::chrono::steady_clock::now();
+};
+
 RpcServer::RpcServer() {}
 RpcServer::~RpcServer() {}
 
@@ -127,8 +143,122 @@ sp<IBinder> RpcServer::getRootObject() {
 }
 
 void RpcServer::join() {
+    LOG_ALWAYS_FATAL_IF(!mAgreedExperimental, "no!");
+    LOG_ALWAYS_FATAL_IF(!hasServer(), "RpcServer must be setup to join.");
+
+    unique_fd epollFd(epoll_create1(EPOLL_CLOEXEC));
+    if (!epollFd.ok()) {
+        ALOGE("Could not create epoll fd, reading connection headers on their own threads: %s",
+              strerror(errno));
+        while (true) {
+            (void)acceptOne();
+        }
+    }
+
+    // The server socket is added with a null pointer, connections with their
+    // PendingConnection.
+    auto setAccepting = [&](bool accepting) {
+        epoll_event event{.events = EPOLLIN, .data = {.ptr = nullptr}};
+        LOG_ALWAYS_FATAL_IF(0 !=
+                                    epoll_ctl(epollFd.get(),
+                                              accepting ? EPOLL_CTL_ADD : EPOLL_CTL_DEL,
+                                              mServer.get(), &event),
+                            "Could not update server socket in epoll: %s", strerror(errno));
+    };
+    setAccepting(true);
+    bool accepting = true;
+
+    std::map<PendingConnection*, std::unique_ptr<PendingConnection>> pending;
+    auto drop = [&](PendingConnection* connection) {
+        (void)epoll_ctl(epollFd.get(), EPOLL_CTL_DEL, connection->fd.get(), nullptr);
+        pending.erase(connection);
+    };
+
     while (true) {
-        (void)acceptOne();
+        int timeoutMs = -1;
+        if (!pending.empty()) {
+            auto oldest = std::min_element(pending.begin(), pending.end(),
+                                           [](const auto& a, const auto& b) {
+                                               return a.second->acceptTime < b.second->acceptTime;
+                                           });
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+                    oldest->second->acceptTime + kConnectionHeaderTimeout -
+                    std::chrono::steady_clock::now());
+            timeoutMs = std::max<int>(0, remaining.count());
+        }
+
+        epoll_event events[16];
+        int numEvents = TEMP_FAILURE_RETRY(
+                epoll_wait(epollFd.get(), events, arraysize(events), timeoutMs));
+        LOG_ALWAYS_FATAL_IF(numEvents < 0, "epoll_wait failed on server: %s", strerror(errno));
+
+        for (int i = 0; i < numEvents; i++) {
+            auto* connection = static_cast<PendingConnection*>(events[i].data.ptr);
+            if (connection == nullptr) {
+                // Not SOCK_NONBLOCK, so that the header can be read in one
+                // call. It is read with MSG_DONTWAIT until it is complete.
+                unique_fd clientFd(TEMP_FAILURE_RETRY(
+                        accept4(mServer.get(), nullptr, nullptr /*length*/, SOCK_CLOEXEC)));
+                if (clientFd < 0) {
+                    ALOGE("Could not accept4 socket: %s", strerror(errno));
+                    continue;
+                }
+                LOG_RPC_DETAIL("accept4 on fd %d yields fd %d", mServer.get(), clientFd.get());
+
+                auto newConnection = std::make_unique<PendingConnection>();
+                newConnection->fd = std::move(clientFd);
+                epoll_event event{.events = EPOLLIN | EPOLLRDHUP,
+                                  .data = {.ptr = newConnection.get()}};
+                if (0 !=
+                    epoll_ctl(epollFd.get(), EPOLL_CTL_ADD, newConnection->fd.get(), &event)) {
+                    ALOGE("Could not add connection to epoll: %s", strerror(errno));
+                    onConnectionRejected();
+                    continue;
+                }
+                pending[newConnection.get()] = std::move(newConnection);
+                continue;
+            }
+
+            status_t status = readConnectionHeader(connection->fd, &connection->header,
+                                                   &connection->headerReceived,
+                                                   &connection->fds, MSG_DONTWAIT);
+            if (status == -EAGAIN) continue;
+
+            auto it = pending.find(connection);
+            std::unique_ptr<PendingConnection> ready = std::move(it->second);
+            drop(connection);
+            if (status != OK) {
+                onConnectionRejected();
+                continue;
+            }
+
+            std::lock_guard<std::mutex> _l(mLock);
+            std::thread thread =
+                    std::thread(&RpcServer::establishConnection, this,
+                                sp<RpcServer>::fromExisting(this), std::move(ready));
+            mConnectingThreads[thread.get_id()] = std::move(thread);
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        for (auto it = pending.begin(); it != pending.end();) {
+            PendingConnection* connection = (it++)->first;
+            if (now - connection->acceptTime >= kConnectionHeaderTimeout) {
+                ALOGE("Dropping connection on fd %d, no connection header received",
+                      connection->fd.get());
+                drop(connection);
+                onConnectionRejected();
+            }
+        }
+
+        // Stop accepting while too many connections are waiting for their
+        // header, so a connection storm is limited by the listen backlog.
+        if (accepting != (pending.size() < kMaxPendingConnections)) {
+            accepting = !accepting;
+            setAccepting(accepting);
+        }
+
+        std::lock_guard<std::mutex> _l(mLock);
+        mPendingConnectionsCount = pending.size();
     }
 }
 
@@ -145,11 +275,13 @@ bool RpcServer::acceptOne() {
     }
     LOG_RPC_DETAIL("accept4 on fd %d yields fd %d", mServer.get(), clientFd.get());
 
+    auto connection = std::make_unique<PendingConnection>();
+    connection->fd = std::move(clientFd);
     {
         std::lock_guard<std::mutex> _l(mLock);
         std::thread thread =
                 std::thread(&RpcServer::establishConnection, this,
-                            std::move(sp<RpcServer>::fromExisting(this)), std::move(clientFd));
+                            std::move(sp<RpcServer>::fromExisting(this)), std::move(connection));
         mConnectingThreads[thread.get_id()] = std::move(thread);
     }
 
@@ -168,20 +300,98 @@ std::vector<sp<RpcSession>> RpcServer::listSessions() {
 
 size_t RpcServer::numUninitializedSessions() {
     std::lock_guard<std::mutex> _l(mLock);
-    return mConnectingThreads.size();
+    return mConnectingThreads.size() + mPendingConnectionsCount;
+}
+
+RpcServer::ConnectionStats RpcServer::getConnectionStats() {
+    std::lock_guard<std::mutex> _l(mLock);
+    return mConnectionStats;
+}
+
+void RpcServer::onConnectionRejected() {
+    std::lock_guard<std::mutex> _l(mLock);
+    mConnectionStats.rejected++;
+}
+
+// Reads the rest of the connection header. With MSG_DONTWAIT, returns -EAGAIN
+// until all of it has been received.
+static status_t readConnectionHeader(const unique_fd& fd, RpcConnectionHeader* header,
+                                     size_t* received, std::vector<unique_fd>* fds, int flags) {
+    iovec iov{reinterpret_cast<uint8_t*>(header) + *received, sizeof(*header) - *received};
+    char control[CMSG_SPACE(sizeof(int) * RpcTransport::kSharedMemoryFdCount)];
+    msghdr msg{
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = control,
+            .msg_controllen = sizeof(control),
+    };
+    ssize_t recd = TEMP_FAILURE_RETRY(recvmsg(fd.get(), &msg, flags | MSG_CMSG_CLOEXEC));
+    if (recd < 0 && (flags & MSG_DONTWAIT) && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return -EAGAIN;
+    }
+
+    // take ownership of any fds we were sent, even if the header is bad
+    if (recd > 0) {
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+             cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const int* received = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+            for (size_t i = 0; i < count; i++) fds->emplace_back(received[i]);
+        }
+    }
+
+    if (recd <= 0) {
+        ALOGE("Could not read connection header from fd %d", fd.get());
+        return DEAD_OBJECT;
+    }
+    if (msg.msg_flags & MSG_CTRUNC) {
+        ALOGE("Too many fds sent with connection header on fd %d", fd.get());
+        return BAD_VALUE;
+    }
+    // fds may only be sent with the first part of the header
+    if (*received > 0 && msg.msg_controllen > 0) {
+        ALOGE("Fds sent after the start of the connection header on fd %d", fd.get());
+        return BAD_VALUE;
+    }
+    *received += recd;
+    if (*received < sizeof(*header)) {
+        if (flags & MSG_DONTWAIT) return -EAGAIN;
+        ALOGE("Could not read connection header from fd %d", fd.get());
+        return DEAD_OBJECT;
+    }
+    return OK;
 }
 
-void RpcServer::establishConnection(sp<RpcServer>&& server, base::unique_fd clientFd) {
+void RpcServer::establishConnection(sp<RpcServer>&& server,
+                                    std::unique_ptr<PendingConnection> connection) {
     LOG_ALWAYS_FATAL_IF(this != server.get(), "Must pass same ownership object");
 
     // TODO(b/183988761): cannot trust this simple ID
     LOG_ALWAYS_FATAL_IF(!mAgreedExperimental, "no!");
     bool idValid = true;
-    int32_t id;
-    if (sizeof(id) != read(clientFd.get(), &id, sizeof(id))) {
-        ALOGE("Could not read ID from fd %d", clientFd.get());
+    // join() has already read the header
+    if (connection->headerReceived < sizeof(connection->header) &&
+        readConnectionHeader(connection->fd, &connection->header, &connection->headerReceived,
+                             &connection->fds, MSG_WAITALL) != OK) {
         idValid = false;
     }
+    unique_fd clientFd = std::move(connection->fd);
+    const RpcConnectionHeader& header = connection->header;
+    std::vector<unique_fd>& fds = connection->fds;
+    int32_t id = header.sessionId;
+
+    std::unique_ptr<RpcTransport> transport;
+    if (idValid) {
+        if (header.options == RPC_CONNECTION_OPTION_SHARED_MEMORY) {
+            transport = RpcTransport::makeSharedMemoryServer(std::move(clientFd), std::move(fds));
+        } else if (header.options == 0 && fds.empty()) {
+            transport = RpcTransport::makeSocket(std::move(clientFd));
+        } else {
+            ALOGE("Unsupported connection options 0x%x with %zu fds", header.options, fds.size());
+        }
+        idValid = transport != nullptr;
+    }
 
     std::thread thisThread;
     sp<RpcSession> session;
@@ -196,6 +406,7 @@ void RpcServer::establishConnection(sp<RpcServer>&& server, base::unique_fd clie
         mConnectingThreads.erase(threadId);
 
         if (!idValid) {
+            mConnectionStats.rejected++;
             return;
         }
 
@@ -211,11 +422,19 @@ void RpcServer::establishConnection(sp<RpcServer>&& server, base::unique_fd clie
             auto it = mSessions.find(id);
             if (it == mSessions.end()) {
                 ALOGE("Cannot add thread, no record of session with ID %d", id);
+                mConnectionStats.rejected++;
                 return;
             }
             session = it->second;
         }
 
+        const int64_t setupNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        std::chrono::steady_clock::now() - connection->acceptTime)
+                                        .count();
+        mConnectionStats.established++;
+        mConnectionStats.totalSetupNs += setupNs;
+        mConnectionStats.maxSetupNs = std::max(mConnectionStats.maxSetupNs, setupNs);
+
         detachGuard.Disable();
         session->preJoin(std::move(thisThread));
     }
@@ -227,7 +446,7 @@ void RpcServer::establishConnection(sp<RpcServer>&& server, base::unique_fd clie
     // DO NOT ACCESS MEMBER VARIABLES BELOW
     //
 
-    session->join(std::move(clientFd));
+    session->join(std::move(transport));
 }
 
 bool RpcServer::setupSocketServer(const RpcSocketAddress& addr) {
@@ -19,10 +19,14 @@
 #include <binder/RpcSession.h>
 
 #include <inttypes.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 
 #include <string_view>
 
+#include <android-base/macros.h>
 #include <binder/Parcel.h>
 #include <binder/RpcServer.h>
 #include <binder/Stability.h>
@@ -30,6 +34,7 @@
 
 #include "RpcSocketAddress.h"
 #include "RpcState.h"
+#include "RpcTransport.h"
 #include "RpcWireFormat.h"
 
 #ifdef __GLIBC__
@@ -48,21 +53,57 @@ RpcSession::RpcSession() {
 RpcSession::~RpcSession() {
     LOG_RPC_DETAIL("RpcSession destroyed %p", this);
 
-    std::lock_guard<std::mutex> _l(mMutex);
-    LOG_ALWAYS_FATAL_IF(mServerConnections.size() != 0,
-                        "Should not be able to destroy a session with servers in use.");
+    std::vector<PendingReply*> abandoned;
+    {
+        std::lock_guard<std::mutex> _l(mMutex);
+        LOG_ALWAYS_FATAL_IF(mServerConnections.size() != 0,
+                            "Should not be able to destroy a session with servers in use.");
+
+        if (mReactor != nullptr) {
+            mReactor->shutdown = true;
+            uint64_t one = 1;
+            (void)TEMP_FAILURE_RETRY(write(mReactor->eventFd.get(), &one, sizeof(one)));
+        }
+
+        // only asynchronous calls can outlive the session
+        for (auto& connection : mClientConnections) {
+            for (auto& [asyncId, pending] : connection->pendingReplies) {
+                (void)asyncId;
+                LOG_ALWAYS_FATAL_IF(!pending->callback, "Thread waiting on destroyed session");
+                abandoned.push_back(pending);
+            }
+            connection->pendingReplies.clear();
+        }
+    }
+
+    for (PendingReply* pending : abandoned) {
+        pending->callback(DEAD_OBJECT, *pending->reply);
+        delete pending->reply;
+        delete pending;
+    }
 }
 
+RpcSession::RpcConnection::~RpcConnection() {}
+
 sp<RpcSession> RpcSession::make() {
     return sp<RpcSession>::make();
 }
 
+void RpcSession::setMaxMultiplexedConnections(size_t connections) {
+    std::lock_guard<std::mutex> _l(mMutex);
+    LOG_ALWAYS_FATAL_IF(mClientConnections.size() != 0,
+                        "Must be called before setting up the session, but already has %zu "
+                        "clients",
+                        mClientConnections.size());
+    mMaxMultiplexedConnections = connections;
+}
+
 bool RpcSession::setupUnixDomainClient(const char* path) {
-    return setupSocketClient(UnixSocketAddress(path));
+    return setupSocketClient(UnixSocketAddress(path), false /*sharedMemory*/);
 }
 
 bool RpcSession::setupVsockClient(unsigned int cid, unsigned int port) {
-    return setupSocketClient(VsockSocketAddress(cid, port));
+    return setupSocketClient(VsockSocketAddress(cid, port), false /*sharedMemory*/);
 }
 
 bool RpcSession::setupInetClient(const char* addr, unsigned int port) {
@@ -70,12 +111,16 @@ bool RpcSession::setupInetClient(const char* addr, unsigned int port) {
     if (aiStart == nullptr) return false;
     for (auto ai = aiStart.get(); ai != nullptr; ai = ai->ai_next) {
         InetSocketAddress socketAddress(ai->ai_addr, ai->ai_addrlen, addr, port);
-        if (setupSocketClient(socketAddress)) return true;
+        if (setupSocketClient(socketAddress, false /*sharedMemory*/)) return true;
     }
     ALOGE("None of the socket address resolved for %s:%u can be added as inet client.", addr, port);
     return false;
 }
 
+bool RpcSession::setupSharedMemoryClient(const char* path) {
+    return setupSocketClient(UnixSocketAddress(path), true /*sharedMemory*/);
+}
+
 bool RpcSession::addNullDebuggingClient() {
     unique_fd serverFd(TEMP_FAILURE_RETRY(open("/dev/null", O_WRONLY | O_CLOEXEC)));
 
@@ -84,33 +129,123 @@ bool RpcSession::addNullDebuggingClient() {
         return false;
     }
 
-    addClientConnection(std::move(serverFd));
+    addClientConnection(RpcTransport::makeSocket(std::move(serverFd)));
     return true;
 }
 
 sp<IBinder> RpcSession::getRootObject() {
+    if (mMultiplexed) {
+        Parcel data;
+        data.markForRpc(sp<RpcSession>::fromExisting(this));
+        Parcel reply;
+
+        status_t status = transactMultiplexed(RpcAddress::zero(), RPC_SPECIAL_TRANSACT_GET_ROOT,
+                                              data, &reply, 0);
+        if (status != OK) {
+            ALOGE("Error getting root object: %s", statusToString(status).c_str());
+            return nullptr;
+        }
+        return reply.readStrongBinder();
+    }
+
     ExclusiveConnection connection(sp<RpcSession>::fromExisting(this), ConnectionUse::CLIENT);
-    return state()->getRootObject(connection.fd(), sp<RpcSession>::fromExisting(this));
+    return state()->getRootObject(connection.transport(), sp<RpcSession>::fromExisting(this));
 }
 
 status_t RpcSession::getRemoteMaxThreads(size_t* maxThreads) {
+    if (mMultiplexed) {
+        Parcel data;
+        data.markForRpc(sp<RpcSession>::fromExisting(this));
+        Parcel reply;
+
+        status_t status = transactMultiplexed(RpcAddress::zero(),
+                                              RPC_SPECIAL_TRANSACT_GET_MAX_THREADS, data, &reply,
+                                              0);
+        if (status != OK) return status;
+
+        int32_t remoteMaxThreads;
+        if (status = reply.readInt32(&remoteMaxThreads); status != OK) return status;
+        if (remoteMaxThreads <= 0) return BAD_VALUE;
+        *maxThreads = remoteMaxThreads;
+        return OK;
+    }
+
     ExclusiveConnection connection(sp<RpcSession>::fromExisting(this), ConnectionUse::CLIENT);
-    return state()->getMaxThreads(connection.fd(), sp<RpcSession>::fromExisting(this), maxThreads);
+    return state()->getMaxThreads(connection.transport(), sp<RpcSession>::fromExisting(this),
+                                  maxThreads);
 }
 
 status_t RpcSession::transact(const RpcAddress& address, uint32_t code, const Parcel& data,
                               Parcel* reply, uint32_t flags) {
+    if (mMultiplexed) {
+        return transactMultiplexed(address, code, data, reply, flags);
+    }
+
     ExclusiveConnection connection(sp<RpcSession>::fromExisting(this),
                                    (flags & IBinder::FLAG_ONEWAY) ? ConnectionUse::CLIENT_ASYNC
                                                                   : ConnectionUse::CLIENT);
-    return state()->transact(connection.fd(), address, code, data,
+    return state()->transact(connection.transport(), address, code, data,
                              sp<RpcSession>::fromExisting(this), reply, flags);
 }
 
+status_t RpcSession::transactAsync(const RpcAddress& address, uint32_t code, const Parcel& data,
+                                   uint32_t flags, TransactCallback callback) {
+    if (!mMultiplexed) {
+        ALOGE("Asynchronous transactions require a multiplexed session.");
+        return INVALID_OPERATION;
+    }
+    if (flags & IBinder::FLAG_ONEWAY) {
+        ALOGE("Oneway transactions have no reply for transactAsync.");
+        return BAD_VALUE;
+    }
+
+    if (status_t status = startReactor(); status != OK) return status;
+
+    PendingReply* pending = new PendingReply{
+            .reply = new Parcel,
+            .callback = std::move(callback),
+    };
+    sp<RpcConnection> connection;
+    uint64_t asyncId;
+    {
+        std::lock_guard<std::mutex> _l(mMutex);
+        connection = mClientConnections[mClientConnectionsOffset];
+        mClientConnectionsOffset = (mClientConnectionsOffset + 1) % mClientConnections.size();
+
+        asyncId = mNextAsyncId++;
+        connection->pendingReplies[asyncId] = pending;
+    }
+
+    status_t status;
+    {
+        std::lock_guard<std::mutex> _l(connection->sendMutex);
+        status = state()->sendMultiplexedTransaction(*connection->transport, address, code, data,
+                                                     flags, asyncId);
+    }
+    if (status != OK) {
+        {
+            std::lock_guard<std::mutex> _l(mMutex);
+            // may have already been failed by the thread reading this
+            // connection, in which case it also called the callback
+            if (connection->pendingReplies.erase(asyncId) == 0) return OK;
+        }
+        delete pending->reply;
+        delete pending;
+        return status;
+    }
+
+    return OK;
+}
+
 status_t RpcSession::sendDecStrong(const RpcAddress& address) {
+    if (sp<RpcConnection> connection = findMultiplexedConnection(); connection != nullptr) {
+        std::lock_guard<std::mutex> _l(connection->sendMutex);
+        return state()->sendDecStrong(*connection->transport, address);
+    }
+
     ExclusiveConnection connection(sp<RpcSession>::fromExisting(this),
                                    ConnectionUse::CLIENT_REFCOUNT);
-    return state()->sendDecStrong(connection.fd(), address);
+    return state()->sendDecStrong(connection.transport(), address);
 }
 
 status_t RpcSession::readId() {
@@ -123,7 +258,7 @@ status_t RpcSession::readId() {
 
     ExclusiveConnection connection(sp<RpcSession>::fromExisting(this), ConnectionUse::CLIENT);
     status_t status =
-            state()->getSessionId(connection.fd(), sp<RpcSession>::fromExisting(this), &id);
+            state()->getSessionId(connection.transport(), sp<RpcSession>::fromExisting(this), &id);
     if (status != OK) return status;
 
     LOG_RPC_DETAIL("RpcSession %p has id %d", this, id);
@@ -140,14 +275,15 @@ void RpcSession::preJoin(std::thread thread) {
     }
 }
 
-void RpcSession::join(unique_fd client) {
+void RpcSession::join(std::unique_ptr<RpcTransport> client) {
     // must be registered to allow arbitrary client code executing commands to
     // be able to do nested calls (we can't only read from it)
     sp<RpcConnection> connection = assignServerToThisThread(std::move(client));
 
     while (true) {
         status_t error =
-                state()->getAndExecuteCommand(connection->fd, sp<RpcSession>::fromExisting(this));
+                state()->getAndExecuteCommand(*connection->transport,
+                                              sp<RpcSession>::fromExisting(this));
 
         if (error != OK) {
             ALOGI("Binder connection thread closing w/ status %s", statusToString(error).c_str());
@@ -187,7 +323,7 @@ wp<RpcServer> RpcSession::server() {
     return mForServer;
 }
 
-bool RpcSession::setupSocketClient(const RpcSocketAddress& addr) {
+bool RpcSession::setupSocketClient(const RpcSocketAddress& addr, bool sharedMemory) {
     {
         std::lock_guard<std::mutex> _l(mMutex);
         LOG_ALWAYS_FATAL_IF(mClientConnections.size() != 0,
@@ -195,7 +331,7 @@ bool RpcSession::setupSocketClient(const RpcSocketAddress& addr) {
                             mClientConnections.size());
     }
 
-    if (!setupOneSocketClient(addr, RPC_SESSION_ID_NEW)) return false;
+    if (!setupOneSocketClient(addr, RPC_SESSION_ID_NEW, sharedMemory)) return false;
 
     // TODO(b/185167543): we should add additional sessions dynamically
     // instead of all at once.
@@ -213,16 +349,37 @@ bool RpcSession::setupSocketClient(const RpcSocketAddress& addr) {
         return false;
     }
 
+    size_t numConnections = numThreadsAvailable;
+    size_t maxMultiplexedConnections;
+    {
+        std::lock_guard<std::mutex> _l(mMutex);
+        maxMultiplexedConnections = mMaxMultiplexedConnections;
+    }
+    if (maxMultiplexedConnections > 0) {
+        // the server processes multiplexed calls on its own threads, so the
+        // number of connections doesn't need to match them
+        numConnections = maxMultiplexedConnections;
+    }
+
     // we've already setup one client
-    for (size_t i = 0; i + 1 < numThreadsAvailable; i++) {
+    for (size_t i = 0; i + 1 < numConnections; i++) {
         // TODO(b/185167543): shutdown existing connections?
-        if (!setupOneSocketClient(addr, mId.value())) return false;
+        if (!setupOneSocketClient(addr, mId.value(), sharedMemory)) return false;
+    }
+
+    if (maxMultiplexedConnections > 0) {
+        std::lock_guard<std::mutex> _l(mMutex);
+        for (auto& connection : mClientConnections) {
+            connection->multiplexed = true;
+        }
+        mMultiplexed = true;
     }
 
     return true;
 }
 
-bool RpcSession::setupOneSocketClient(const RpcSocketAddress& addr, int32_t id) {
+bool RpcSession::setupOneSocketClient(const RpcSocketAddress& addr, int32_t id,
+                                      bool sharedMemory) {
     for (size_t tries = 0; tries < 5; tries++) {
         if (tries > 0) usleep(10000);
 
@@ -246,16 +403,50 @@ bool RpcSession::setupOneSocketClient(const RpcSocketAddress& addr, int32_t id)
             return false;
         }
 
-        if (sizeof(id) != TEMP_FAILURE_RETRY(write(serverFd.get(), &id, sizeof(id)))) {
+        RpcConnectionHeader header{
+                .sessionId = id,
+                .options = sharedMemory ? RPC_CONNECTION_OPTION_SHARED_MEMORY : 0u,
+        };
+        iovec iov{&header, sizeof(header)};
+        msghdr msg{
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+        };
+        // must outlive sendmsg, which reads the fds from it
+        char control[CMSG_SPACE(sizeof(int) * RpcTransport::kSharedMemoryFdCount)] = {};
+
+        int socketFd = serverFd.get();
+        std::unique_ptr<RpcTransport> transport;
+        std::vector<unique_fd> fdsForServer;
+        if (sharedMemory) {
+            // the socket stays open (but unused) for the lifetime of the
+            // transport, so the server notices when we go away
+            transport = RpcTransport::makeSharedMemoryClient(std::move(serverFd), &fdsForServer);
+            if (transport == nullptr) return false;
+
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fdsForServer.size());
+            int* fds = reinterpret_cast<int*>(CMSG_DATA(cmsg));
+            for (size_t i = 0; i < fdsForServer.size(); i++) fds[i] = fdsForServer[i].get();
+        } else {
+            transport = RpcTransport::makeSocket(std::move(serverFd));
+        }
+
+        if (sizeof(header) != TEMP_FAILURE_RETRY(sendmsg(socketFd, &msg, MSG_NOSIGNAL))) {
             int savedErrno = errno;
-            ALOGE("Could not write id to socket at %s: %s", addr.toString().c_str(),
-                  strerror(savedErrno));
+            ALOGE("Could not write connection header to socket at %s: %s",
+                  addr.toString().c_str(), strerror(savedErrno));
             return false;
         }
 
-        LOG_RPC_DETAIL("Socket at %s client with fd %d", addr.toString().c_str(), serverFd.get());
+        LOG_RPC_DETAIL("Socket at %s client with fd %d%s", addr.toString().c_str(), socketFd,
+                       sharedMemory ? " (shared memory)" : "");
 
-        addClientConnection(std::move(serverFd));
+        addClientConnection(std::move(transport));
         return true;
     }
 
@@ -263,10 +454,10 @@ bool RpcSession::setupOneSocketClient(const RpcSocketAddress& addr, int32_t id)
     return false;
 }
 
-void RpcSession::addClientConnection(unique_fd fd) {
+void RpcSession::addClientConnection(std::unique_ptr<RpcTransport> transport) {
     std::lock_guard<std::mutex> _l(mMutex);
     sp<RpcConnection> session = sp<RpcConnection>::make();
-    session->fd = std::move(fd);
+    session->transport = std::move(transport);
     mClientConnections.push_back(session);
 }
 
@@ -275,10 +466,11 @@ void RpcSession::setForServer(const wp<RpcServer>& server, int32_t sessionId) {
     mForServer = server;
 }
 
-sp<RpcSession::RpcConnection> RpcSession::assignServerToThisThread(unique_fd fd) {
+sp<RpcSession::RpcConnection> RpcSession::assignServerToThisThread(
+        std::unique_ptr<RpcTransport> transport) {
     std::lock_guard<std::mutex> _l(mMutex);
     sp<RpcConnection> session = sp<RpcConnection>::make();
-    session->fd = std::move(fd);
+    session->transport = std::move(transport);
     session->exclusiveTid = gettid();
     mServerConnections.push_back(session);
 
@@ -292,12 +484,289 @@ bool RpcSession::removeServerConnection(const sp<RpcConnection>& connection) {
         mServerConnections.erase(it);
         if (mServerConnections.size() == 0) {
             terminateLocked();
+            mMultiplexedWorkCv.notify_all();
         }
         return true;
     }
     return false;
 }
 
+status_t RpcSession::transactMultiplexed(const RpcAddress& address, uint32_t code,
+                                         const Parcel& data, Parcel* reply, uint32_t flags) {
+    bool oneway = flags & IBinder::FLAG_ONEWAY;
+    LOG_ALWAYS_FATAL_IF(!oneway && reply == nullptr,
+                        "Reply parcel must be used for synchronous transaction.");
+
+    PendingReply pending{.reply = reply};
+    sp<RpcConnection> connection;
+    uint64_t asyncId;
+    {
+        std::lock_guard<std::mutex> _l(mMutex);
+        LOG_ALWAYS_FATAL_IF(mClientConnections.size() == 0, "Multiplexed session not setup");
+
+        connection = mClientConnections[mClientConnectionsOffset];
+        mClientConnectionsOffset = (mClientConnectionsOffset + 1) % mClientConnections.size();
+
+        // TODO(b/183140903): support > 2**64 multiplexed transactions
+        asyncId = mNextAsyncId++;
+        if (!oneway) connection->pendingReplies[asyncId] = &pending;
+    }
+
+    status_t status;
+    {
+        std::lock_guard<std::mutex> _l(connection->sendMutex);
+        status = state()->sendMultiplexedTransaction(*connection->transport, address, code, data,
+                                                     flags, asyncId);
+    }
+    if (status != OK) {
+        std::lock_guard<std::mutex> _l(mMutex);
+        connection->pendingReplies.erase(asyncId);
+        return status;
+    }
+
+    if (oneway) return OK;
+
+    return waitForMultiplexedReply(connection, &pending);
+}
+
+status_t RpcSession::waitForMultiplexedReply(const sp<RpcConnection>& connection,
+                                             PendingReply* pending) {
+    std::unique_lock<std::mutex> _l(mMutex);
+    while (!pending->done) {
+        if (connection->replyReaderActive) {
+            mMultiplexedReplyCv.wait(_l);
+            continue;
+        }
+
+        // Nobody else is reading this connection, so read replies on behalf
+        // of every thread waiting on it, until ours arrives.
+        connection->replyReaderActive = true;
+        _l.unlock();
+
+        (void)processMultiplexedReply(connection);
+
+        _l.lock();
+        connection->replyReaderActive = false;
+        mMultiplexedReplyCv.notify_all();
+    }
+    return pending->status;
+}
+
+status_t RpcSession::processMultiplexedReply(const sp<RpcConnection>& connection) {
+    uint64_t asyncId;
+    status_t replyStatus;
+    status_t status = state()->readMultiplexedReply(
+            *connection->transport, sp<RpcSession>::fromExisting(this),
+            [&](uint64_t id) -> Parcel* {
+                std::lock_guard<std::mutex> _l(mMutex);
+                auto it = connection->pendingReplies.find(id);
+                return it == connection->pendingReplies.end() ? nullptr : it->second->reply;
+            },
+            &asyncId, &replyStatus);
+
+    std::vector<PendingReply*> completedAsync;
+    {
+        std::lock_guard<std::mutex> _l(mMutex);
+        auto complete = [&](PendingReply* pending, status_t result) {
+            pending->status = result;
+            pending->done = true;
+            if (pending->callback) completedAsync.push_back(pending);
+        };
+
+        if (status == OK) {
+            auto it = connection->pendingReplies.find(asyncId);
+            LOG_ALWAYS_FATAL_IF(it == connection->pendingReplies.end(),
+                                "Reply %" PRIu64 " delivered to a call which isn't waiting",
+                                asyncId);
+            complete(it->second, replyStatus);
+            connection->pendingReplies.erase(it);
+        } else {
+            // the connection can't be read anymore, so fail every call on it
+            for (auto& [id, other] : connection->pendingReplies) {
+                (void)id;
+                complete(other, status);
+            }
+            connection->pendingReplies.clear();
+        }
+        mMultiplexedReplyCv.notify_all();
+    }
+
+    for (PendingReply* pending : completedAsync) {
+        pending->callback(pending->status, *pending->reply);
+        delete pending->reply;
+        delete pending;
+    }
+
+    return status;
+}
+
+status_t RpcSession::startReactor() {
+    std::unique_lock<std::mutex> _l(mMutex);
+    if (mReactor != nullptr) return OK;
+
+    for (auto& connection : mClientConnections) {
+        if (!connection->transport->isPollable()) {
+            ALOGE("Asynchronous transactions are not supported on this transport.");
+            return INVALID_OPERATION;
+        }
+    }
+
+    auto reactor = std::make_shared<Reactor>();
+    reactor->epollFd.reset(epoll_create1(EPOLL_CLOEXEC));
+    if (!reactor->epollFd.ok()) {
+        int savedErrno = errno;
+        ALOGE("Could not create epoll fd: %s", strerror(savedErrno));
+        return -savedErrno;
+    }
+    reactor->eventFd.reset(eventfd(0, EFD_CLOEXEC));
+    if (!reactor->eventFd.ok()) {
+        int savedErrno = errno;
+        ALOGE("Could not create eventfd: %s", strerror(savedErrno));
+        return -savedErrno;
+    }
+    epoll_event shutdownEvent{.events = EPOLLIN, .data = {.ptr = nullptr}};
+    if (0 !=
+        epoll_ctl(reactor->epollFd.get(), EPOLL_CTL_ADD, reactor->eventFd.get(), &shutdownEvent)) {
+        int savedErrno = errno;
+        ALOGE("Could not add eventfd to epoll: %s", strerror(savedErrno));
+        return -savedErrno;
+    }
+
+    // Set first, so that transactions sent while this is waiting for other
+    // threads to stop reading are also handed to their callbacks.
+    mReactor = reactor;
+
+    for (auto& connection : mClientConnections) {
+        mMultiplexedReplyCv.wait(_l, [&] { return !connection->replyReaderActive; });
+        connection->replyReaderActive = true;
+
+        epoll_event event{.events = EPOLLIN, .data = {.ptr = connection.get()}};
+        LOG_ALWAYS_FATAL_IF(0 !=
+                                    epoll_ctl(reactor->epollFd.get(), EPOLL_CTL_ADD,
+                                              connection->transport->socket().get(), &event),
+                            "Could not add connection to epoll: %s", strerror(errno));
+    }
+
+    // Only holds a weak reference to the session, so that it can be destroyed
+    // with asynchronous calls in flight.
+    std::thread(&RpcSession::reactorLoop, wp<RpcSession>::fromExisting(this), reactor).detach();
+    return OK;
+}
+
+void RpcSession::reactorLoop(const wp<RpcSession>& weakSession,
+                             const std::shared_ptr<Reactor>& reactor) {
+    while (!reactor->shutdown) {
+        epoll_event events[8];
+        int numEvents = TEMP_FAILURE_RETRY(
+                epoll_wait(reactor->epollFd.get(), events, arraysize(events), -1 /*timeout*/));
+        if (numEvents < 0) {
+            ALOGE("epoll_wait failed, no more asynchronous replies: %s", strerror(errno));
+            return;
+        }
+
+        if (reactor->shutdown) return;
+        sp<RpcSession> session = weakSession.promote();
+        if (session == nullptr) return;
+
+        for (int i = 0; i < numEvents; i++) {
+            if (events[i].data.ptr == nullptr) continue; // eventfd
+
+            sp<RpcConnection> connection =
+                    sp<RpcConnection>::fromExisting(static_cast<RpcConnection*>(events[i].data.ptr));
+            if (session->processMultiplexedReply(connection) != OK) {
+                // Stop watching this connection, and let threads calling
+                // synchronously find out that it is unusable.
+                (void)epoll_ctl(reactor->epollFd.get(), EPOLL_CTL_DEL,
+                                connection->transport->socket().get(), nullptr);
+                std::lock_guard<std::mutex> _l(session->mMutex);
+                connection->replyReaderActive = false;
+                session->mMultiplexedReplyCv.notify_all();
+            }
+        }
+        // if this is the last reference to the session, it is destroyed here,
+        // which sets 'shutdown'
+    }
+}
+
+sp<RpcSession::RpcConnection> RpcSession::findMultiplexedConnection() {
+    std::lock_guard<std::mutex> _l(mMutex);
+    if (mMultiplexed) {
+        return mClientConnections[mClientConnectionsOffset];
+    }
+    for (const auto& connection : mServerConnections) {
+        if (connection->multiplexed) return connection;
+    }
+    return nullptr;
+}
+
+void RpcSession::postMultiplexedTransaction(RpcTransport& transport,
+                                            MultiplexedTransaction transaction) {
+    std::lock_guard<std::mutex> _l(mMutex);
+    auto it = std::find_if(mServerConnections.begin(), mServerConnections.end(),
+                           [&](const sp<RpcConnection>& connection) {
+                               return connection->transport.get() == &transport;
+                           });
+    LOG_ALWAYS_FATAL_IF(it == mServerConnections.end(),
+                        "Multiplexed transaction received on unknown fd %d",
+                        transport.socket().get());
+
+    (*it)->multiplexed = true;
+    mMultiplexedWork.push_back(MultiplexedWork{
+            .connection = *it,
+            .transaction = std::move(transaction),
+    });
+
+    if (mIdleMultiplexedWorkers >= mMultiplexedWork.size()) {
+        mMultiplexedWorkCv.notify_one();
+        return;
+    }
+
+    size_t maxWorkers = 1;
+    if (sp<RpcServer> server = mForServer.promote(); server != nullptr) {
+        maxWorkers = server->getMaxThreads();
+    }
+    // otherwise, picked up by the next worker to finish a transaction
+    if (mMultiplexedWorkers >= maxWorkers) return;
+
+    mMultiplexedWorkers++;
+    std::thread thread(&RpcSession::multiplexedWorkerLoop, sp<RpcSession>::fromExisting(this));
+    mThreads[thread.get_id()] = std::move(thread);
+}
+
+void RpcSession::multiplexedWorkerLoop() {
+    std::unique_lock<std::mutex> _l(mMutex);
+    while (true) {
+        mIdleMultiplexedWorkers++;
+        mMultiplexedWorkCv.wait(_l, [&] {
+            return mMultiplexedWork.size() != 0 || mServerConnections.size() == 0;
+        });
+        mIdleMultiplexedWorkers--;
+
+        if (mMultiplexedWork.size() == 0) break; // session is terminating
+
+        {
+            MultiplexedWork work = std::move(mMultiplexedWork.front());
+            mMultiplexedWork.pop_front();
+            _l.unlock();
+
+            status_t status =
+                    work.transaction(*work.connection->transport, work.connection->sendMutex);
+            if (status != OK) {
+                ALOGI("Multiplexed transaction failed w/ status %s",
+                      statusToString(status).c_str());
+            }
+            // destructors of work may make binder calls on this session
+        }
+        _l.lock();
+    }
+
+    mMultiplexedWorkers--;
+    auto it = mThreads.find(std::this_thread::get_id());
+    LOG_ALWAYS_FATAL_IF(it == mThreads.end());
+    it->second.detach();
+    mThreads.erase(it);
+}
+
 RpcSession::ExclusiveConnection::ExclusiveConnection(const sp<RpcSession>& session,
                                                      ConnectionUse use)
       : mSession(session) {
@@ -24,7 +24,10 @@
 #include "Debug.h"
 #include "RpcWireFormat.h"
 
+#include <android-base/macros.h>
+
 #include <inttypes.h>
+#include <sys/uio.h>
 
 namespace android {
 
@@ -56,34 +59,45 @@ status_t RpcState::onBinderLeaving(const sp<RpcSession>& session, const sp<IBind
         return INVALID_OPERATION;
     }
 
-    std::lock_guard<std::mutex> _l(mNodeMutex);
+    if (isRpc) {
+        const RpcAddress& addr = binder->remoteBinder()->getPrivateAccessorForId().rpcAddress();
+        NodeShard& shard = shardFor(addr);
+        std::lock_guard<std::mutex> _l(shard.mutex);
+
+        auto it = shard.nodeForAddress.find(addr);
+        LOG_ALWAYS_FATAL_IF(it == shard.nodeForAddress.end(),
+                            "RPC binder must have known address at this point");
+        // TODO(b/182939933): this is only checking integrity of data structure
+        LOG_ALWAYS_FATAL_IF(!(binder == it->second.binder), "Address mismatch");
+        it->second.timesSent++;
+        it->second.sentRef = binder; // might already be set
+        *outAddress = addr;
+        return OK;
+    }
 
-    // TODO(b/182939933): maybe move address out of BpBinder, and keep binder->address map
-    // in RpcState
-    for (auto& [addr, node] : mNodeForAddress) {
+    NodeShard& shard = shardFor(binder);
+    std::lock_guard<std::mutex> _l(shard.mutex);
+
+    // TODO(b/182939933): maybe keep binder->address map in RpcState
+    for (auto& [addr, node] : shard.nodeForAddress) {
         if (binder == node.binder) {
-            if (isRpc) {
-                const RpcAddress& actualAddr =
-                        binder->remoteBinder()->getPrivateAccessorForId().rpcAddress();
-                // TODO(b/182939933): this is only checking integrity of data structure
-                // a different data structure doesn't need this
-                LOG_ALWAYS_FATAL_IF(addr < actualAddr, "Address mismatch");
-                LOG_ALWAYS_FATAL_IF(actualAddr < addr, "Address mismatch");
-            }
             node.timesSent++;
             node.sentRef = binder; // might already be set
             *outAddress = addr;
             return OK;
         }
     }
-    LOG_ALWAYS_FATAL_IF(isRpc, "RPC binder must have known address at this point");
 
-    auto&& [it, inserted] = mNodeForAddress.insert({RpcAddress::unique(),
-                                                    BinderNode{
-                                                            .binder = binder,
-                                                            .timesSent = 1,
-                                                            .sentRef = binder,
-                                                    }});
+    // the rest of the address is still random, and so unique
+    RpcWireAddress rawAddress = RpcAddress::unique().viewRawEmbedded();
+    rawAddress.address[0] = static_cast<uint8_t>(&shard - mNodeShards);
+    auto&& [it, inserted] =
+            shard.nodeForAddress.insert({RpcAddress::fromRawEmbedded(&rawAddress),
+                                         BinderNode{
+                                                 .binder = binder,
+                                                 .timesSent = 1,
+                                                 .sentRef = binder,
+                                         }});
     // TODO(b/182939933): better organization could avoid needing this log
     LOG_ALWAYS_FATAL_IF(!inserted);
 
@@ -92,9 +106,10 @@ status_t RpcState::onBinderLeaving(const sp<RpcSession>& session, const sp<IBind
 }
 
 sp<IBinder> RpcState::onBinderEntering(const sp<RpcSession>& session, const RpcAddress& address) {
-    std::unique_lock<std::mutex> _l(mNodeMutex);
+    NodeShard& shard = shardFor(address);
+    std::unique_lock<std::mutex> _l(shard.mutex);
 
-    if (auto it = mNodeForAddress.find(address); it != mNodeForAddress.end()) {
+    if (auto it = shard.nodeForAddress.find(address); it != shard.nodeForAddress.end()) {
         sp<IBinder> binder = it->second.binder.promote();
 
         // implicitly have strong RPC refcount, since we received this binder
@@ -110,7 +125,7 @@ sp<IBinder> RpcState::onBinderEntering(const sp<RpcSession>& session, const RpcA
         return binder;
     }
 
-    auto&& [it, inserted] = mNodeForAddress.insert({address, BinderNode{}});
+    auto&& [it, inserted] = shard.nodeForAddress.insert({address, BinderNode{}});
     LOG_ALWAYS_FATAL_IF(!inserted, "Failed to insert binder when creating proxy");
 
     // Currently, all binders are assumed to be part of the same session (no
@@ -121,36 +136,52 @@ sp<IBinder> RpcState::onBinderEntering(const sp<RpcSession>& session, const RpcA
     return binder;
 }
 
+RpcState::NodeShard& RpcState::shardFor(const RpcAddress& address) {
+    return mNodeShards[address.viewRawEmbedded().address[0] % kNumNodeShards];
+}
+
+RpcState::NodeShard& RpcState::shardFor(const sp<IBinder>& localBinder) {
+    // skip bits which are the same due to allocation alignment
+    return mNodeShards[(reinterpret_cast<uintptr_t>(localBinder.get()) >> 4) % kNumNodeShards];
+}
+
 size_t RpcState::countBinders() {
-    std::lock_guard<std::mutex> _l(mNodeMutex);
-    return mNodeForAddress.size();
+    size_t count = 0;
+    for (NodeShard& shard : mNodeShards) {
+        std::lock_guard<std::mutex> _l(shard.mutex);
+        count += shard.nodeForAddress.size();
+    }
+    return count;
 }
 
 void RpcState::dump() {
-    std::lock_guard<std::mutex> _l(mNodeMutex);
     ALOGE("DUMP OF RpcState %p", this);
-    ALOGE("DUMP OF RpcState (%zu nodes)", mNodeForAddress.size());
-    for (const auto& [address, node] : mNodeForAddress) {
-        sp<IBinder> binder = node.binder.promote();
-
-        const char* desc;
-        if (binder) {
-            if (binder->remoteBinder()) {
-                if (binder->remoteBinder()->isRpcBinder()) {
-                    desc = "(rpc binder proxy)";
+    for (NodeShard& shard : mNodeShards) {
+        std::lock_guard<std::mutex> _l(shard.mutex);
+        ALOGE("DUMP OF RpcState shard %zu (%zu nodes)", static_cast<size_t>(&shard - mNodeShards),
+              shard.nodeForAddress.size());
+        for (const auto& [address, node] : shard.nodeForAddress) {
+            sp<IBinder> binder = node.binder.promote();
+
+            const char* desc;
+            if (binder) {
+                if (binder->remoteBinder()) {
+                    if (binder->remoteBinder()->isRpcBinder()) {
+                        desc = "(rpc binder proxy)";
+                    } else {
+                        desc = "(binder proxy)";
+                    }
                 } else {
-                    desc = "(binder proxy)";
+                    desc = "(local binder)";
                 }
             } else {
-                desc = "(local binder)";
+                desc = "(null)";
             }
-        } else {
-            desc = "(null)";
-        }
 
-        ALOGE("- BINDER NODE: %p times sent:%zu times recd: %zu a:%s type:%s",
-              node.binder.unsafe_get(), node.timesSent, node.timesRecd, address.toString().c_str(),
-              desc);
+            ALOGE("- BINDER NODE: %p times sent:%zu times recd: %zu a:%s type:%s",
+                  node.binder.unsafe_get(), node.timesSent, node.timesRecd,
+                  address.toString().c_str(), desc);
+        }
     }
     ALOGE("END DUMP OF RpcState");
 }
@@ -163,13 +194,13 @@ void RpcState::terminate() {
 
     // if the destructor of a binder object makes another RPC call, then calling
     // decStrong could deadlock. So, we must hold onto these binders until
-    // mNodeMutex is no longer taken.
+    // no shard mutex is taken.
     std::vector<sp<IBinder>> tempHoldBinder;
 
-    {
-        std::lock_guard<std::mutex> _l(mNodeMutex);
-        mTerminated = true;
-        for (auto& [address, node] : mNodeForAddress) {
+    mTerminated = true;
+    for (NodeShard& shard : mNodeShards) {
+        std::lock_guard<std::mutex> _l(shard.mutex);
+        for (auto& [address, node] : shard.nodeForAddress) {
             sp<IBinder> binder = node.binder.promote();
             LOG_ALWAYS_FATAL_IF(binder == nullptr, "Binder %p expected to be owned.", binder.get());
 
@@ -178,7 +209,7 @@ void RpcState::terminate() {
             }
         }
 
-        mNodeForAddress.clear();
+        shard.nodeForAddress.clear();
     }
 }
 
@@ -203,62 +234,29 @@ RpcState::CommandData::CommandData(size_t size) : mSize(size) {
     mData.reset(new (std::nothrow) uint8_t[size]);
 }
 
-bool RpcState::rpcSend(const base::unique_fd& fd, const char* what, const void* data, size_t size) {
-    LOG_RPC_DETAIL("Sending %s on fd %d: %s", what, fd.get(), hexString(data, size).c_str());
-
-    if (size > std::numeric_limits<ssize_t>::max()) {
-        ALOGE("Cannot send %s at size %zu (too big)", what, size);
-        terminate();
-        return false;
-    }
-
-    ssize_t sent = TEMP_FAILURE_RETRY(send(fd.get(), data, size, MSG_NOSIGNAL));
-
-    if (sent < 0 || sent != static_cast<ssize_t>(size)) {
-        ALOGE("Failed to send %s (sent %zd of %zu bytes) on fd %d, error: %s", what, sent, size,
-              fd.get(), strerror(errno));
-
+bool RpcState::rpcSend(RpcTransport& transport, const char* what, iovec* iovs, size_t niovs) {
+    if (!transport.send(what, iovs, niovs)) {
         terminate();
         return false;
     }
-
     return true;
 }
 
-bool RpcState::rpcRec(const base::unique_fd& fd, const char* what, void* data, size_t size) {
-    if (size > std::numeric_limits<ssize_t>::max()) {
-        ALOGE("Cannot rec %s at size %zu (too big)", what, size);
+bool RpcState::rpcRec(RpcTransport& transport, const char* what, void* data, size_t size) {
+    if (!transport.recv(what, data, size)) {
         terminate();
         return false;
     }
-
-    ssize_t recd = TEMP_FAILURE_RETRY(recv(fd.get(), data, size, MSG_WAITALL | MSG_NOSIGNAL));
-
-    if (recd < 0 || recd != static_cast<ssize_t>(size)) {
-        terminate();
-
-        if (recd == 0 && errno == 0) {
-            LOG_RPC_DETAIL("No more data when trying to read %s on fd %d", what, fd.get());
-            return false;
-        }
-
-        ALOGE("Failed to read %s (received %zd of %zu bytes) on fd %d, error: %s", what, recd, size,
-              fd.get(), strerror(errno));
-        return false;
-    } else {
-        LOG_RPC_DETAIL("Received %s on fd %d: %s", what, fd.get(), hexString(data, size).c_str());
-    }
-
     return true;
 }
 
-sp<IBinder> RpcState::getRootObject(const base::unique_fd& fd, const sp<RpcSession>& session) {
+sp<IBinder> RpcState::getRootObject(RpcTransport& transport, const sp<RpcSession>& session) {
     Parcel data;
     data.markForRpc(session);
     Parcel reply;
 
-    status_t status = transact(fd, RpcAddress::zero(), RPC_SPECIAL_TRANSACT_GET_ROOT, data, session,
-                               &reply, 0);
+    status_t status = transact(transport, RpcAddress::zero(), RPC_SPECIAL_TRANSACT_GET_ROOT, data,
+                               session, &reply, 0);
     if (status != OK) {
         ALOGE("Error getting root object: %s", statusToString(status).c_str());
         return nullptr;
@@ -267,14 +265,14 @@ sp<IBinder> RpcState::getRootObject(const base::unique_fd& fd, const sp<RpcSessi
     return reply.readStrongBinder();
 }
 
-status_t RpcState::getMaxThreads(const base::unique_fd& fd, const sp<RpcSession>& session,
+status_t RpcState::getMaxThreads(RpcTransport& transport, const sp<RpcSession>& session,
                                  size_t* maxThreadsOut) {
     Parcel data;
     data.markForRpc(session);
     Parcel reply;
 
-    status_t status = transact(fd, RpcAddress::zero(), RPC_SPECIAL_TRANSACT_GET_MAX_THREADS, data,
-                               session, &reply, 0);
+    status_t status = transact(transport, RpcAddress::zero(), RPC_SPECIAL_TRANSACT_GET_MAX_THREADS,
+                               data, session, &reply, 0);
     if (status != OK) {
         ALOGE("Error getting max threads: %s", statusToString(status).c_str());
         return status;
@@ -292,14 +290,14 @@ status_t RpcState::getMaxThreads(const base::unique_fd& fd, const sp<RpcSession>
     return OK;
 }
 
-status_t RpcState::getSessionId(const base::unique_fd& fd, const sp<RpcSession>& session,
+status_t RpcState::getSessionId(RpcTransport& transport, const sp<RpcSession>& session,
                                 int32_t* sessionIdOut) {
     Parcel data;
     data.markForRpc(session);
     Parcel reply;
 
-    status_t status = transact(fd, RpcAddress::zero(), RPC_SPECIAL_TRANSACT_GET_SESSION_ID, data,
-                               session, &reply, 0);
+    status_t status = transact(transport, RpcAddress::zero(), RPC_SPECIAL_TRANSACT_GET_SESSION_ID,
+                               data, session, &reply, 0);
     if (status != OK) {
         ALOGE("Error getting session ID: %s", statusToString(status).c_str());
         return status;
@@ -313,16 +311,42 @@ status_t RpcState::getSessionId(const base::unique_fd& fd, const sp<RpcSession>&
     return OK;
 }
 
-status_t RpcState::transact(const base::unique_fd& fd, const RpcAddress& address, uint32_t code,
+status_t RpcState::transact(RpcTransport& transport, const RpcAddress& address, uint32_t code,
                             const Parcel& data, const sp<RpcSession>& session, Parcel* reply,
                             uint32_t flags) {
+    if (status_t status = sendTransaction(transport, address, code, data, flags, 0 /*asyncId*/);
+        status != OK) {
+        return status;
+    }
+
+    if (flags & IBinder::FLAG_ONEWAY) {
+        return OK; // do not wait for result
+    }
+
+    LOG_ALWAYS_FATAL_IF(reply == nullptr, "Reply parcel must be used for synchronous transaction.");
+
+    return waitForReply(transport, session, reply);
+}
+
+status_t RpcState::sendMultiplexedTransaction(RpcTransport& transport, const RpcAddress& address,
+                                              uint32_t code, const Parcel& data, uint32_t flags,
+                                              uint64_t asyncId) {
+    LOG_ALWAYS_FATAL_IF(asyncId == 0, "Multiplexed transactions must have an asyncId");
+    return sendTransaction(transport, address, code, data, flags, asyncId);
+}
+
+status_t RpcState::sendTransaction(RpcTransport& transport, const RpcAddress& address,
+                                   uint32_t code, const Parcel& data, uint32_t flags,
+                                   uint64_t asyncId) {
     uint64_t asyncNumber = 0;
 
     if (!address.isZero()) {
-        std::lock_guard<std::mutex> _l(mNodeMutex);
+        NodeShard& shard = shardFor(address);
+        std::lock_guard<std::mutex> _l(shard.mutex);
         if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
-        auto it = mNodeForAddress.find(address);
-        LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(), "Sending transact on unknown address %s",
+        auto it = shard.nodeForAddress.find(address);
+        LOG_ALWAYS_FATAL_IF(it == shard.nodeForAddress.end(),
+                            "Sending transact on unknown address %s",
                             address.toString().c_str());
 
         if (flags & IBinder::FLAG_ONEWAY) {
@@ -347,38 +371,28 @@ status_t RpcState::transact(const base::unique_fd& fd, const RpcAddress& address
             .asyncNumber = asyncNumber,
     };
 
-    CommandData transactionData(sizeof(RpcWireTransaction) + data.dataSize());
-    if (!transactionData.valid()) {
-        return NO_MEMORY;
-    }
-
-    memcpy(transactionData.data() + 0, &transaction, sizeof(RpcWireTransaction));
-    memcpy(transactionData.data() + sizeof(RpcWireTransaction), data.data(), data.dataSize());
-
-    if (transactionData.size() > std::numeric_limits<uint32_t>::max()) {
-        ALOGE("Transaction size too big %zu", transactionData.size());
+    size_t bodySize = sizeof(RpcWireTransaction) + data.dataSize();
+    if (bodySize > std::numeric_limits<uint32_t>::max()) {
+        ALOGE("Transaction size too big %zu", bodySize);
         return BAD_VALUE;
     }
 
     RpcWireHeader command{
             .command = RPC_COMMAND_TRANSACT,
-            .bodySize = static_cast<uint32_t>(transactionData.size()),
+            .bodySize = static_cast<uint32_t>(bodySize),
+            .asyncId = asyncId,
     };
 
-    if (!rpcSend(fd, "transact header", &command, sizeof(command))) {
-        return DEAD_OBJECT;
-    }
-    if (!rpcSend(fd, "command body", transactionData.data(), transactionData.size())) {
+    iovec iovs[]{
+            {&command, sizeof(command)},
+            {&transaction, sizeof(RpcWireTransaction)},
+            {const_cast<uint8_t*>(data.data()), data.dataSize()},
+    };
+    if (!rpcSend(transport, "transaction", iovs, arraysize(iovs))) {
         return DEAD_OBJECT;
     }
 
-    if (flags & IBinder::FLAG_ONEWAY) {
-        return OK; // do not wait for result
-    }
-
-    LOG_ALWAYS_FATAL_IF(reply == nullptr, "Reply parcel must be used for synchronous transaction.");
-
-    return waitForReply(fd, session, reply);
+    return OK;
 }
 
 static void cleanup_reply_data(Parcel* p, const uint8_t* data, size_t dataSize,
@@ -390,26 +404,81 @@ static void cleanup_reply_data(Parcel* p, const uint8_t* data, size_t dataSize,
     LOG_ALWAYS_FATAL_IF(objectsCount, 0);
 }
 
-status_t RpcState::waitForReply(const base::unique_fd& fd, const sp<RpcSession>& session,
+status_t RpcState::waitForReply(RpcTransport& transport, const sp<RpcSession>& session,
                                 Parcel* reply) {
     RpcWireHeader command;
     while (true) {
-        if (!rpcRec(fd, "command header", &command, sizeof(command))) {
+        if (!rpcRec(transport, "command header", &command, sizeof(command))) {
             return DEAD_OBJECT;
         }
 
         if (command.command == RPC_COMMAND_REPLY) break;
 
-        status_t status = processServerCommand(fd, session, command);
+        status_t status = processServerCommand(transport, session, command);
+        if (status != OK) return status;
+    }
+
+    status_t replyStatus;
+    if (status_t status = readReply(transport, session, command, reply, &replyStatus);
+        status != OK) {
+        return status;
+    }
+    return replyStatus;
+}
+
+status_t RpcState::readMultiplexedReply(RpcTransport& transport, const sp<RpcSession>& session,
+                                        const std::function<Parcel*(uint64_t)>& replyFor,
+                                        uint64_t* asyncId, status_t* replyStatus) {
+    RpcWireHeader command;
+    while (true) {
+        if (!rpcRec(transport, "command header", &command, sizeof(command))) {
+            return DEAD_OBJECT;
+        }
+
+        if (command.command == RPC_COMMAND_REPLY) break;
+
+        // Nested transactions aren't supported over multiplexed connections,
+        // since there is no thread on the other side waiting on this one.
+        if (command.command != RPC_COMMAND_DEC_STRONG) {
+            ALOGE("Unexpected command %d on multiplexed connection - terminating session",
+                  command.command);
+            terminate();
+            return DEAD_OBJECT;
+        }
+
+        status_t status = processDecStrong(transport, command);
         if (status != OK) return status;
     }
 
+    Parcel* reply = replyFor(command.asyncId);
+    if (reply == nullptr) {
+        ALOGE("Reply for unknown transaction %" PRIu64 ". Terminating!", command.asyncId);
+        terminate();
+        return BAD_VALUE;
+    }
+
+    if (status_t status = readReply(transport, session, command, reply, replyStatus);
+        status != OK) {
+        // other calls are still waiting for replies on this connection, but
+        // we can't find where the next one starts
+        terminate();
+        return status;
+    }
+
+    *asyncId = command.asyncId;
+    return OK;
+}
+
+status_t RpcState::readReply(RpcTransport& transport, const sp<RpcSession>& session,
+                             const RpcWireHeader& command, Parcel* reply, status_t* replyStatus) {
+    LOG_ALWAYS_FATAL_IF(command.command != RPC_COMMAND_REPLY, "command: %d", command.command);
+
     CommandData data(command.bodySize);
     if (!data.valid()) {
         return NO_MEMORY;
     }
 
-    if (!rpcRec(fd, "reply body", data.data(), command.bodySize)) {
+    if (!rpcRec(transport, "reply body", data.data(), command.bodySize)) {
         return DEAD_OBJECT;
     }
 
@@ -420,7 +489,8 @@ status_t RpcState::waitForReply(const base::unique_fd& fd, const sp<RpcSession>&
         return BAD_VALUE;
     }
     RpcWireReply* rpcReply = reinterpret_cast<RpcWireReply*>(data.data());
-    if (rpcReply->status != OK) return rpcReply->status;
+    *replyStatus = rpcReply->status;
+    if (rpcReply->status != OK) return OK;
 
     data.release();
     reply->ipcSetDataReference(rpcReply->data, command.bodySize - offsetof(RpcWireReply, data),
@@ -431,19 +501,20 @@ status_t RpcState::waitForReply(const base::unique_fd& fd, const sp<RpcSession>&
     return OK;
 }
 
-status_t RpcState::sendDecStrong(const base::unique_fd& fd, const RpcAddress& addr) {
+status_t RpcState::sendDecStrong(RpcTransport& transport, const RpcAddress& addr) {
     {
-        std::lock_guard<std::mutex> _l(mNodeMutex);
+        NodeShard& shard = shardFor(addr);
+        std::lock_guard<std::mutex> _l(shard.mutex);
         if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
-        auto it = mNodeForAddress.find(addr);
-        LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(), "Sending dec strong on unknown address %s",
-                            addr.toString().c_str());
+        auto it = shard.nodeForAddress.find(addr);
+        LOG_ALWAYS_FATAL_IF(it == shard.nodeForAddress.end(),
+                            "Sending dec strong on unknown address %s", addr.toString().c_str());
         LOG_ALWAYS_FATAL_IF(it->second.timesRecd <= 0, "Bad dec strong %s",
                             addr.toString().c_str());
 
         it->second.timesRecd--;
         if (it->second.timesRecd == 0 && it->second.timesSent == 0) {
-            mNodeForAddress.erase(it);
+            shard.nodeForAddress.erase(it);
         }
     }
 
@@ -451,30 +522,32 @@ status_t RpcState::sendDecStrong(const base::unique_fd& fd, const RpcAddress& ad
             .command = RPC_COMMAND_DEC_STRONG,
             .bodySize = sizeof(RpcWireAddress),
     };
-    if (!rpcSend(fd, "dec ref header", &cmd, sizeof(cmd))) return DEAD_OBJECT;
-    if (!rpcSend(fd, "dec ref body", &addr.viewRawEmbedded(), sizeof(RpcWireAddress)))
-        return DEAD_OBJECT;
+    iovec iovs[]{
+            {&cmd, sizeof(cmd)},
+            {const_cast<RpcWireAddress*>(&addr.viewRawEmbedded()), sizeof(RpcWireAddress)},
+    };
+    if (!rpcSend(transport, "dec ref", iovs, arraysize(iovs))) return DEAD_OBJECT;
     return OK;
 }
 
-status_t RpcState::getAndExecuteCommand(const base::unique_fd& fd, const sp<RpcSession>& session) {
-    LOG_RPC_DETAIL("getAndExecuteCommand on fd %d", fd.get());
+status_t RpcState::getAndExecuteCommand(RpcTransport& transport, const sp<RpcSession>& session) {
+    LOG_RPC_DETAIL("getAndExecuteCommand on fd %d", transport.socket().get());
 
     RpcWireHeader command;
-    if (!rpcRec(fd, "command header", &command, sizeof(command))) {
+    if (!rpcRec(transport, "command header", &command, sizeof(command))) {
         return DEAD_OBJECT;
     }
 
-    return processServerCommand(fd, session, command);
+    return processServerCommand(transport, session, command);
 }
 
-status_t RpcState::processServerCommand(const base::unique_fd& fd, const sp<RpcSession>& session,
+status_t RpcState::processServerCommand(RpcTransport& transport, const sp<RpcSession>& session,
                                         const RpcWireHeader& command) {
     switch (command.command) {
         case RPC_COMMAND_TRANSACT:
-            return processTransact(fd, session, command);
+            return processTransact(transport, session, command);
         case RPC_COMMAND_DEC_STRONG:
-            return processDecStrong(fd, command);
+            return processDecStrong(transport, command);
     }
 
     // We should always know the version of the opposing side, and since the
@@ -486,7 +559,7 @@ status_t RpcState::processServerCommand(const base::unique_fd& fd, const sp<RpcS
     terminate();
     return DEAD_OBJECT;
 }
-status_t RpcState::processTransact(const base::unique_fd& fd, const sp<RpcSession>& session,
+status_t RpcState::processTransact(RpcTransport& transport, const sp<RpcSession>& session,
                                    const RpcWireHeader& command) {
     LOG_ALWAYS_FATAL_IF(command.command != RPC_COMMAND_TRANSACT, "command: %d", command.command);
 
@@ -494,11 +567,28 @@ status_t RpcState::processTransact(const base::unique_fd& fd, const sp<RpcSessio
     if (!transactionData.valid()) {
         return NO_MEMORY;
     }
-    if (!rpcRec(fd, "transaction body", transactionData.data(), transactionData.size())) {
+    if (!rpcRec(transport, "transaction body", transactionData.data(), transactionData.size())) {
         return DEAD_OBJECT;
     }
 
-    return processTransactInternal(fd, session, std::move(transactionData));
+    if (command.asyncId != 0) {
+        // Processed on another thread, so that a slow call doesn't hold up
+        // other calls sharing this connection.
+        auto data = std::make_shared<CommandData>(std::move(transactionData));
+        uint64_t asyncId = command.asyncId;
+        session->postMultiplexedTransaction(transport,
+                                            [this, session, data,
+                                             asyncId](RpcTransport& transport,
+                                                      std::mutex& sendMutex) -> status_t {
+                                                return processTransactInternal(transport, session,
+                                                                               std::move(*data),
+                                                                               asyncId, &sendMutex);
+                                            });
+        return OK;
+    }
+
+    return processTransactInternal(transport, session, std::move(transactionData), 0 /*asyncId*/,
+                                   nullptr /*sendMutex*/);
 }
 
 static void do_nothing_to_transact_data(Parcel* p, const uint8_t* data, size_t dataSize,
@@ -510,8 +600,9 @@ static void do_nothing_to_transact_data(Parcel* p, const uint8_t* data, size_t d
     (void)objectsCount;
 }
 
-status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<RpcSession>& session,
-                                           CommandData transactionData) {
+status_t RpcState::processTransactInternal(RpcTransport& transport, const sp<RpcSession>& session,
+                                           CommandData transactionData, uint64_t asyncId,
+                                           std::mutex* sendMutex) {
     if (transactionData.size() < sizeof(RpcWireTransaction)) {
         ALOGE("Expecting %zu but got %zu bytes for RpcWireTransaction. Terminating!",
               sizeof(RpcWireTransaction), transactionData.size());
@@ -520,17 +611,18 @@ status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<R
     }
     RpcWireTransaction* transaction = reinterpret_cast<RpcWireTransaction*>(transactionData.data());
 
-    // TODO(b/182939933): heap allocation just for lookup in mNodeForAddress,
+    // TODO(b/182939933): heap allocation just for lookup in nodeForAddress,
     // maybe add an RpcAddress 'view' if the type remains 'heavy'
     auto addr = RpcAddress::fromRawEmbedded(&transaction->address);
 
     status_t replyStatus = OK;
     sp<IBinder> target;
     if (!addr.isZero()) {
-        std::lock_guard<std::mutex> _l(mNodeMutex);
+        NodeShard& shard = shardFor(addr);
+        std::lock_guard<std::mutex> _l(shard.mutex);
 
-        auto it = mNodeForAddress.find(addr);
-        if (it == mNodeForAddress.end()) {
+        auto it = shard.nodeForAddress.find(addr);
+        if (it == shard.nodeForAddress.end()) {
             ALOGE("Unknown binder address %s.", addr.toString().c_str());
             replyStatus = BAD_VALUE;
         } else {
@@ -640,10 +732,11 @@ status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<R
         // downside: asynchronous transactions may drown out synchronous
         // transactions.
         {
-            std::unique_lock<std::mutex> _l(mNodeMutex);
-            auto it = mNodeForAddress.find(addr);
+            NodeShard& shard = shardFor(addr);
+            std::unique_lock<std::mutex> _l(shard.mutex);
+            auto it = shard.nodeForAddress.find(addr);
             // last refcount dropped after this transaction happened
-            if (it == mNodeForAddress.end()) return OK;
+            if (it == shard.nodeForAddress.end()) return OK;
 
             // note - only updated now, instead of later, so that other threads
             // will queue any later transactions
@@ -665,7 +758,8 @@ status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<R
                         const_cast<BinderNode::AsyncTodo&>(it->second.asyncTodo.top()).data);
                 it->second.asyncTodo.pop();
                 _l.unlock();
-                return processTransactInternal(fd, session, std::move(data));
+                return processTransactInternal(transport, session, std::move(data), asyncId,
+                                               sendMutex);
             }
         }
         return OK;
@@ -675,41 +769,42 @@ status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<R
             .status = replyStatus,
     };
 
-    CommandData replyData(sizeof(RpcWireReply) + reply.dataSize());
-    if (!replyData.valid()) {
-        return NO_MEMORY;
-    }
-    memcpy(replyData.data() + 0, &rpcReply, sizeof(RpcWireReply));
-    memcpy(replyData.data() + sizeof(RpcWireReply), reply.data(), reply.dataSize());
-
-    if (replyData.size() > std::numeric_limits<uint32_t>::max()) {
-        ALOGE("Reply size too big %zu", transactionData.size());
+    size_t bodySize = sizeof(RpcWireReply) + reply.dataSize();
+    if (bodySize > std::numeric_limits<uint32_t>::max()) {
+        ALOGE("Reply size too big %zu", bodySize);
         terminate();
         return BAD_VALUE;
     }
 
     RpcWireHeader cmdReply{
             .command = RPC_COMMAND_REPLY,
-            .bodySize = static_cast<uint32_t>(replyData.size()),
+            .bodySize = static_cast<uint32_t>(bodySize),
+            .asyncId = asyncId,
     };
 
-    if (!rpcSend(fd, "reply header", &cmdReply, sizeof(RpcWireHeader))) {
-        return DEAD_OBJECT;
-    }
-    if (!rpcSend(fd, "reply body", replyData.data(), replyData.size())) {
+    iovec iovs[]{
+            {&cmdReply, sizeof(RpcWireHeader)},
+            {&rpcReply, sizeof(RpcWireReply)},
+            {const_cast<uint8_t*>(reply.data()), reply.dataSize()},
+    };
+
+    std::unique_lock<std::mutex> _l;
+    if (sendMutex != nullptr) _l = std::unique_lock<std::mutex>(*sendMutex);
+
+    if (!rpcSend(transport, "reply", iovs, arraysize(iovs))) {
         return DEAD_OBJECT;
     }
     return OK;
 }
 
-status_t RpcState::processDecStrong(const base::unique_fd& fd, const RpcWireHeader& command) {
+status_t RpcState::processDecStrong(RpcTransport& transport, const RpcWireHeader& command) {
     LOG_ALWAYS_FATAL_IF(command.command != RPC_COMMAND_DEC_STRONG, "command: %d", command.command);
 
     CommandData commandData(command.bodySize);
     if (!commandData.valid()) {
         return NO_MEMORY;
     }
-    if (!rpcRec(fd, "dec ref body", commandData.data(), commandData.size())) {
+    if (!rpcRec(transport, "dec ref body", commandData.data(), commandData.size())) {
         return DEAD_OBJECT;
     }
 
@@ -723,9 +818,10 @@ status_t RpcState::processDecStrong(const base::unique_fd& fd, const RpcWireHead
 
     // TODO(b/182939933): heap allocation just for lookup
     auto addr = RpcAddress::fromRawEmbedded(address);
-    std::unique_lock<std::mutex> _l(mNodeMutex);
-    auto it = mNodeForAddress.find(addr);
-    if (it == mNodeForAddress.end()) {
+    NodeShard& shard = shardFor(addr);
+    std::unique_lock<std::mutex> _l(shard.mutex);
+    auto it = shard.nodeForAddress.find(addr);
+    if (it == shard.nodeForAddress.end()) {
         ALOGE("Unknown binder address %s for dec strong.", addr.toString().c_str());
         return OK;
     }
@@ -754,7 +850,7 @@ status_t RpcState::processDecStrong(const base::unique_fd& fd, const RpcWireHead
         it->second.sentRef = nullptr;
 
         if (it->second.timesRecd == 0) {
-            mNodeForAddress.erase(it);
+            shard.nodeForAddress.erase(it);
         }
     }
 
@@ -20,7 +20,14 @@
 #include <binder/Parcel.h>
 #include <binder/RpcSession.h>
 
+#include "RpcTransport.h"
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <optional>
 #include <queue>
 
@@ -52,17 +59,37 @@ public:
     ~RpcState();
 
     // TODO(b/182940634): combine some special transactions into one "getServerInfo" call?
-    sp<IBinder> getRootObject(const base::unique_fd& fd, const sp<RpcSession>& session);
-    status_t getMaxThreads(const base::unique_fd& fd, const sp<RpcSession>& session,
+    sp<IBinder> getRootObject(RpcTransport& transport, const sp<RpcSession>& session);
+    status_t getMaxThreads(RpcTransport& transport, const sp<RpcSession>& session,
                            size_t* maxThreadsOut);
-    status_t getSessionId(const base::unique_fd& fd, const sp<RpcSession>& session,
+    status_t getSessionId(RpcTransport& transport, const sp<RpcSession>& session,
                           int32_t* sessionIdOut);
 
-    [[nodiscard]] status_t transact(const base::unique_fd& fd, const RpcAddress& address,
+    [[nodiscard]] status_t transact(RpcTransport& transport, const RpcAddress& address,
                                     uint32_t code, const Parcel& data,
                                     const sp<RpcSession>& session, Parcel* reply, uint32_t flags);
-    [[nodiscard]] status_t sendDecStrong(const base::unique_fd& fd, const RpcAddress& address);
-    [[nodiscard]] status_t getAndExecuteCommand(const base::unique_fd& fd,
+    [[nodiscard]] status_t sendDecStrong(RpcTransport& transport, const RpcAddress& address);
+
+    /**
+     * Multiplexed transactions (see RpcWireHeader::asyncId) share a connection
+     * between threads. Callers must serialize sending commands on such a
+     * connection, and only one thread at a time may read replies from it.
+     */
+    [[nodiscard]] status_t sendMultiplexedTransaction(RpcTransport& transport,
+                                                      const RpcAddress& address, uint32_t code,
+                                                      const Parcel& data, uint32_t flags,
+                                                      uint64_t asyncId);
+    /**
+     * Reads the next reply on a multiplexed connection into the parcel
+     * 'replyFor' returns for its asyncId. Returns an error if the connection
+     * can no longer be used, otherwise 'replyStatus' is the result of the
+     * transaction which 'asyncId' was sent with.
+     */
+    [[nodiscard]] status_t readMultiplexedReply(RpcTransport& transport,
+                                                const sp<RpcSession>& session,
+                                                const std::function<Parcel*(uint64_t)>& replyFor,
+                                                uint64_t* asyncId, status_t* replyStatus);
+    [[nodiscard]] status_t getAndExecuteCommand(RpcTransport& transport,
                                                 const sp<RpcSession>& session);
 
     /**
@@ -115,21 +142,32 @@ private:
         size_t mSize;
     };
 
-    [[nodiscard]] bool rpcSend(const base::unique_fd& fd, const char* what, const void* data,
-                               size_t size);
-    [[nodiscard]] bool rpcRec(const base::unique_fd& fd, const char* what, void* data, size_t size);
+    // Sends all of 'iovs' as one message. 'iovs' is used as scratch space to
+    // track progress over partial writes, so callers must not reuse it.
+    [[nodiscard]] bool rpcSend(RpcTransport& transport, const char* what, iovec* iovs,
+                               size_t niovs);
+    [[nodiscard]] bool rpcRec(RpcTransport& transport, const char* what, void* data, size_t size);
 
-    [[nodiscard]] status_t waitForReply(const base::unique_fd& fd, const sp<RpcSession>& session,
+    [[nodiscard]] status_t sendTransaction(RpcTransport& transport, const RpcAddress& address,
+                                           uint32_t code, const Parcel& data, uint32_t flags,
+                                           uint64_t asyncId);
+    [[nodiscard]] status_t waitForReply(RpcTransport& transport, const sp<RpcSession>& session,
                                         Parcel* reply);
-    [[nodiscard]] status_t processServerCommand(const base::unique_fd& fd,
+    [[nodiscard]] status_t readReply(RpcTransport& transport, const sp<RpcSession>& session,
+                                     const RpcWireHeader& command, Parcel* reply,
+                                     status_t* replyStatus);
+    [[nodiscard]] status_t processServerCommand(RpcTransport& transport,
                                                 const sp<RpcSession>& session,
                                                 const RpcWireHeader& command);
-    [[nodiscard]] status_t processTransact(const base::unique_fd& fd, const sp<RpcSession>& session,
+    [[nodiscard]] status_t processTransact(RpcTransport& transport, const sp<RpcSession>& session,
                                            const RpcWireHeader& command);
-    [[nodiscard]] status_t processTransactInternal(const base::unique_fd& fd,
+    // For multiplexed transactions, the reply is tagged with 'asyncId' and
+    // sent holding 'sendMutex'.
+    [[nodiscard]] status_t processTransactInternal(RpcTransport& transport,
                                                    const sp<RpcSession>& session,
-                                                   CommandData transactionData);
-    [[nodiscard]] status_t processDecStrong(const base::unique_fd& fd,
+                                                   CommandData transactionData, uint64_t asyncId,
+                                                   std::mutex* sendMutex);
+    [[nodiscard]] status_t processDecStrong(RpcTransport& transport,
                                             const RpcWireHeader& command);
 
     struct BinderNode {
@@ -179,10 +217,21 @@ private:
         // (no additional data specific to remote binders)
     };
 
-    std::mutex mNodeMutex;
-    bool mTerminated = false;
-    // binders known by both sides of a session
-    std::map<RpcAddress, BinderNode> mNodeForAddress;
+    // Binders known by both sides of a session, sharded by address so that
+    // transactions on different binders don't all contend on one lock. Local
+    // binders are given an address in the shard picked by their pointer, so
+    // finding the address of a local binder which was already sent only needs
+    // to search that one shard.
+    static constexpr size_t kNumNodeShards = 16;
+    struct NodeShard {
+        std::mutex mutex;
+        std::map<RpcAddress, BinderNode> nodeForAddress;
+    };
+    NodeShard& shardFor(const RpcAddress& address);
+    NodeShard& shardFor(const sp<IBinder>& localBinder);
+
+    std::atomic<bool> mTerminated = false;
+    NodeShard mNodeShards[kNumNodeShards];
 };
 
 } // namespace android
@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RpcTransport"
+
+#include "RpcTransport.h"
+
+#include <log/log.h>
+
+#include "Debug.h"
+#include "RpcState.h"
+
+#include <android-base/macros.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace android {
+
+using base::unique_fd;
+
+RpcTransport::~RpcTransport() {}
+
+namespace {
+
+class SocketTransport : public RpcTransport {
+public:
+    explicit SocketTransport(unique_fd socket) : RpcTransport(std::move(socket)) {}
+
+    bool isPollable() const override { return true; }
+
+    bool send(const char* what, iovec* iovs, size_t niovs) override {
+        if (SHOULD_LOG_RPC_DETAIL) {
+            for (size_t i = 0; i < niovs; i++) {
+                LOG_RPC_DETAIL("Sending %s on fd %d (part %zu): %s", what, mSocket.get(), i,
+                               hexString(iovs[i].iov_base, iovs[i].iov_len).c_str());
+            }
+        }
+
+        size_t size = 0;
+        for (size_t i = 0; i < niovs; i++) {
+            if (__builtin_add_overflow(size, iovs[i].iov_len, &size) ||
+                size > std::numeric_limits<ssize_t>::max()) {
+                ALOGE("Cannot send %s (too big)", what);
+                return false;
+            }
+        }
+
+        // Header and body are sent straight out of their owners' memory (e.g. the
+        // Parcel being transacted), so the payload is never copied into a
+        // temporary buffer before hitting the socket.
+        size_t sentTotal = 0;
+        while (niovs > 0) {
+            msghdr msg{
+                    .msg_iov = iovs,
+                    .msg_iovlen = niovs,
+            };
+            ssize_t sent = TEMP_FAILURE_RETRY(sendmsg(mSocket.get(), &msg, MSG_NOSIGNAL));
+            if (sent < 0 && errno == ENOTSOCK) {
+                // e.g. RpcSession::addNullDebuggingClient
+                sent = TEMP_FAILURE_RETRY(writev(mSocket.get(), iovs, niovs));
+            }
+
+            if (sent <= 0) {
+                ALOGE("Failed to send %s (sent %zu of %zu bytes) on fd %d, error: %s", what,
+                      sentTotal, size, mSocket.get(), strerror(errno));
+                return false;
+            }
+            sentTotal += sent;
+
+            // a stream socket may accept part of the data, so skip over what was
+            // already written and resume from there
+            size_t remaining = static_cast<size_t>(sent);
+            while (niovs > 0 && remaining >= iovs->iov_len) {
+                remaining -= iovs->iov_len;
+                iovs++;
+                niovs--;
+            }
+            if (niovs > 0) {
+                iovs->iov_base = static_cast<uint8_t*>(iovs->iov_base) + remaining;
+                iovs->iov_len -= remaining;
+            }
+        }
+
+        return true;
+    }
+
+    bool recv(const char* what, void* data, size_t size) override {
+        if (size > std::numeric_limits<ssize_t>::max()) {
+            ALOGE("Cannot rec %s at size %zu (too big)", what, size);
+            return false;
+        }
+
+        ssize_t recd =
+                TEMP_FAILURE_RETRY(::recv(mSocket.get(), data, size, MSG_WAITALL | MSG_NOSIGNAL));
+
+        if (recd < 0 || recd != static_cast<ssize_t>(size)) {
+            if (recd == 0 && errno == 0) {
+                LOG_RPC_DETAIL("No more data when trying to read %s on fd %d", what,
+                               mSocket.get());
+                return false;
+            }
+
+            ALOGE("Failed to read %s (received %zd of %zu bytes) on fd %d, error: %s", what, recd,
+                  size, mSocket.get(), strerror(errno));
+            return false;
+        }
+
+        LOG_RPC_DETAIL("Received %s on fd %d: %s", what, mSocket.get(),
+                       hexString(data, size).c_str());
+        return true;
+    }
+};
+
+// Layout of the memfd: a page of RingControl, then the data of each ring.
+// Ring 0 carries data from the client to the server, ring 1 the other way.
+constexpr size_t kRingSize = 256 * 1024; // must be a power of two
+constexpr size_t kControlSize = 4096;
+constexpr size_t kRegionSize = kControlSize + 2 * kRingSize;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "needed to share across processes");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "needed to share across processes");
+
+struct alignas(64) RingControl {
+    // Total bytes ever written/read. Each is only written by one side, but
+    // the other side may be hostile, so both are validated on every use.
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+    // set while the reader/writer is about to wait on its eventfd
+    std::atomic<uint32_t> readerWaiting;
+    std::atomic<uint32_t> writerWaiting;
+};
+static_assert(2 * sizeof(RingControl) <= kControlSize);
+
+// fds, in the order they are exchanged
+enum {
+    FD_MEMORY = 0,
+    FD_RING0_DATA, // ring 0 has data, waited on by the server
+    FD_RING0_SPACE, // ring 0 has space, waited on by the client
+    FD_RING1_DATA,
+    FD_RING1_SPACE,
+};
+
+class SharedMemoryTransport : public RpcTransport {
+public:
+    struct Ring {
+        RingControl* control;
+        uint8_t* data;
+        int dataEvent;
+        int spaceEvent;
+        // our own copy of head (when writing) or tail (when reading)
+        uint64_t position;
+    };
+
+    SharedMemoryTransport(unique_fd socket, std::vector<unique_fd> fds, void* mapping,
+                          bool isClient)
+          : RpcTransport(std::move(socket)), mFds(std::move(fds)), mMapping(mapping) {
+        uint8_t* base = static_cast<uint8_t*>(mapping);
+        RingControl* controls = reinterpret_cast<RingControl*>(base);
+        Ring ring0{.control = &controls[0],
+                   .data = base + kControlSize,
+                   .dataEvent = mFds[FD_RING0_DATA].get(),
+                   .spaceEvent = mFds[FD_RING0_SPACE].get()};
+        Ring ring1{.control = &controls[1],
+                   .data = base + kControlSize + kRingSize,
+                   .dataEvent = mFds[FD_RING1_DATA].get(),
+                   .spaceEvent = mFds[FD_RING1_SPACE].get()};
+        mTx = isClient ? ring0 : ring1;
+        mRx = isClient ? ring1 : ring0;
+        mTx.position = mTx.control->head.load(std::memory_order_relaxed);
+        mRx.position = mRx.control->tail.load(std::memory_order_relaxed);
+    }
+
+    ~SharedMemoryTransport() { munmap(mMapping, kRegionSize); }
+
+    bool isPollable() const override { return false; }
+
+    bool send(const char* what, iovec* iovs, size_t niovs) override {
+        for (size_t i = 0; i < niovs; i++) {
+            LOG_RPC_DETAIL("Sending %s on shm fd %d (part %zu): %s", what, mSocket.get(), i,
+                           hexString(iovs[i].iov_base, iovs[i].iov_len).c_str());
+            if (!write(static_cast<const uint8_t*>(iovs[i].iov_base), iovs[i].iov_len)) {
+                ALOGE("Failed to send %s on shm fd %d", what, mSocket.get());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool recv(const char* what, void* data, size_t size) override {
+        if (!read(static_cast<uint8_t*>(data), size)) {
+            LOG_RPC_DETAIL("Failed to read %s on shm fd %d", what, mSocket.get());
+            return false;
+        }
+        LOG_RPC_DETAIL("Received %s on shm fd %d: %s", what, mSocket.get(),
+                       hexString(data, size).c_str());
+        return true;
+    }
+
+private:
+    bool write(const uint8_t* data, size_t size) {
+        RingControl* control = mTx.control;
+        while (size > 0) {
+            uint64_t used = mTx.position - control->tail.load(std::memory_order_acquire);
+            if (used > kRingSize) {
+                ALOGE("Shared memory ring corrupted by peer");
+                return false;
+            }
+            if (used == kRingSize) {
+                control->writerWaiting.store(1);
+                bool ok = true;
+                if (mTx.position - control->tail.load() == kRingSize) {
+                    ok = waitFor(mTx.spaceEvent);
+                }
+                control->writerWaiting.store(0, std::memory_order_relaxed);
+                if (!ok) return false;
+                continue;
+            }
+
+            size_t n = std::min(size, static_cast<size_t>(kRingSize - used));
+            size_t offset = mTx.position & (kRingSize - 1);
+            size_t first = std::min(n, kRingSize - offset);
+            memcpy(mTx.data + offset, data, first);
+            memcpy(mTx.data, data + first, n - first);
+
+            mTx.position += n;
+            data += n;
+            size -= n;
+            control->head.store(mTx.position);
+            if (control->readerWaiting.load()) signal(mTx.dataEvent);
+        }
+        return true;
+    }
+
+    bool read(uint8_t* data, size_t size) {
+        RingControl* control = mRx.control;
+        while (size > 0) {
+            uint64_t available = control->head.load(std::memory_order_acquire) - mRx.position;
+            if (available > kRingSize) {
+                ALOGE("Shared memory ring corrupted by peer");
+                return false;
+            }
+            if (available == 0) {
+                control->readerWaiting.store(1);
+                bool ok = true;
+                if (control->head.load() == mRx.position) {
+                    ok = waitFor(mRx.dataEvent);
+                }
+                control->readerWaiting.store(0, std::memory_order_relaxed);
+                if (!ok) return false;
+                continue;
+            }
+
+            size_t n = std::min(size, static_cast<size_t>(available));
+            size_t offset = mRx.position & (kRingSize - 1);
+            size_t first = std::min(n, kRingSize - offset);
+            memcpy(data, mRx.data + offset, first);
+            memcpy(data + first, mRx.data, n - first);
+
+            mRx.position += n;
+            data += n;
+            size -= n;
+            control->tail.store(mRx.position);
+            if (control->writerWaiting.load()) signal(mRx.spaceEvent);
+        }
+        return true;
+    }
+
+    // Waits for 'eventFd' to be signaled. Returns false if the other side has
+    // gone away (or sent anything on the socket, which it never should).
+    bool waitFor(int eventFd) {
+        pollfd pfd[2]{
+                {.fd = eventFd, .events = POLLIN},
+                {.fd = mSocket.get(), .events = POLLIN | POLLRDHUP},
+        };
+        if (TEMP_FAILURE_RETRY(poll(pfd, arraysize(pfd), -1)) < 0) {
+            int savedErrno = errno;
+            ALOGE("Failed to poll shm fd %d: %s", mSocket.get(), strerror(savedErrno));
+            return false;
+        }
+        if (pfd[1].revents != 0) {
+            LOG_RPC_DETAIL("Peer of shm fd %d went away", mSocket.get());
+            return false;
+        }
+        uint64_t count;
+        (void)TEMP_FAILURE_RETRY(::read(eventFd, &count, sizeof(count)));
+        return true;
+    }
+
+    static void signal(int eventFd) {
+        uint64_t one = 1;
+        (void)TEMP_FAILURE_RETRY(::write(eventFd, &one, sizeof(one)));
+    }
+
+    std::vector<unique_fd> mFds;
+    void* mMapping;
+    Ring mTx;
+    Ring mRx;
+};
+
+} // namespace
+
+std::unique_ptr<RpcTransport> RpcTransport::makeSocket(unique_fd socket) {
+    return std::make_unique<SocketTransport>(std::move(socket));
+}
+
+std::unique_ptr<RpcTransport> RpcTransport::makeSharedMemoryClient(
+        unique_fd socket, std::vector<unique_fd>* outFds) {
+    std::vector<unique_fd> fds(kSharedMemoryFdCount);
+
+    fds[FD_MEMORY].reset(memfd_create("binder_rpc", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (!fds[FD_MEMORY].ok()) {
+        int savedErrno = errno;
+        ALOGE("Could not create memfd: %s", strerror(savedErrno));
+        return nullptr;
+    }
+    // the server must be able to rely on the size of the mapping
+    if (0 != ftruncate(fds[FD_MEMORY].get(), kRegionSize) ||
+        0 != fcntl(fds[FD_MEMORY].get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+        int savedErrno = errno;
+        ALOGE("Could not size memfd: %s", strerror(savedErrno));
+        return nullptr;
+    }
+    for (size_t i = FD_RING0_DATA; i < kSharedMemoryFdCount; i++) {
+        fds[i].reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+        if (!fds[i].ok()) {
+            int savedErrno = errno;
+            ALOGE("Could not create eventfd: %s", strerror(savedErrno));
+            return nullptr;
+        }
+    }
+
+    void* mapping =
+            mmap(nullptr, kRegionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fds[FD_MEMORY].get(), 0);
+    if (mapping == MAP_FAILED) {
+        int savedErrno = errno;
+        ALOGE("Could not map memfd: %s", strerror(savedErrno));
+        return nullptr;
+    }
+
+    outFds->clear();
+    for (const unique_fd& fd : fds) {
+        outFds->emplace_back(fcntl(fd.get(), F_DUPFD_CLOEXEC, 0));
+        if (!outFds->back().ok()) {
+            int savedErrno = errno;
+            ALOGE("Could not dup shared memory fd: %s", strerror(savedErrno));
+            munmap(mapping, kRegionSize);
+            return nullptr;
+        }
+    }
+
+    return std::make_unique<SharedMemoryTransport>(std::move(socket), std::move(fds), mapping,
+                                                   true /*isClient*/);
+}
+
+std::unique_ptr<RpcTransport> RpcTransport::makeSharedMemoryServer(unique_fd socket,
+                                                                   std::vector<unique_fd> fds) {
+    if (fds.size() != kSharedMemoryFdCount) {
+        ALOGE("Expecting %zu fds for shared memory transport, but got %zu", kSharedMemoryFdCount,
+              fds.size());
+        return nullptr;
+    }
+
+    // Without these seals, the client could truncate the memfd and crash us
+    // with SIGBUS.
+    int seals = fcntl(fds[FD_MEMORY].get(), F_GET_SEALS);
+    struct stat st;
+    if (seals < 0 || (seals & (F_SEAL_SHRINK | F_SEAL_SEAL)) != (F_SEAL_SHRINK | F_SEAL_SEAL) ||
+        0 != fstat(fds[FD_MEMORY].get(), &st) || st.st_size < static_cast<off_t>(kRegionSize)) {
+        ALOGE("Shared memory for transport is not a sealed memfd of %zu bytes", kRegionSize);
+        return nullptr;
+    }
+    for (size_t i = FD_RING0_DATA; i < kSharedMemoryFdCount; i++) {
+        uint64_t count;
+        // eventfds are always readable as 8 bytes, and nonblocking as created by the client
+        if (TEMP_FAILURE_RETRY(::read(fds[i].get(), &count, sizeof(count))) != sizeof(count) &&
+            errno != EAGAIN) {
+            ALOGE("Shared memory transport fd %zu is not an eventfd", i);
+            return nullptr;
+        }
+        // don't rely on the client for the file status flags
+        if (0 != fcntl(fds[i].get(), F_SETFL, O_NONBLOCK)) {
+            int savedErrno = errno;
+            ALOGE("Could not set eventfd nonblocking: %s", strerror(savedErrno));
+            return nullptr;
+        }
+    }
+
+    void* mapping =
+            mmap(nullptr, kRegionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fds[FD_MEMORY].get(), 0);
+    if (mapping == MAP_FAILED) {
+        int savedErrno = errno;
+        ALOGE("Could not map memfd: %s", strerror(savedErrno));
+        return nullptr;
+    }
+
+    return std::make_unique<SharedMemoryTransport>(std::move(socket), std::move(fds), mapping,
+                                                   false /*isClient*/);
+}
+
+} // namespace android
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android-base/unique_fd.h>
+
+#include <sys/uio.h>
+
+#include <memory>
+#include <vector>
+
+namespace android {
+
+/**
+ * Moves the bytes of the RpcState wire protocol for one connection. Each
+ * connection is established over a socket, which is kept for its lifetime to
+ * identify it and to notice when the other side goes away, even if the
+ * transport doesn't send data over it.
+ *
+ * Only one thread may send and only one thread may receive at a time.
+ */
+class RpcTransport {
+public:
+    virtual ~RpcTransport();
+
+    const base::unique_fd& socket() const { return mSocket; }
+
+    // Whether data arriving on this transport can be waited for by polling
+    // socket(), e.g. with epoll.
+    virtual bool isPollable() const = 0;
+
+    // Sends all of 'iovs' (which may be modified), or logs and returns false.
+    [[nodiscard]] virtual bool send(const char* what, iovec* iovs, size_t niovs) = 0;
+    // Receives exactly 'size' bytes, or returns false on error or if the other
+    // side has gone away.
+    [[nodiscard]] virtual bool recv(const char* what, void* data, size_t size) = 0;
+
+    static std::unique_ptr<RpcTransport> makeSocket(base::unique_fd socket);
+
+    /**
+     * Data is exchanged through ring buffers in a memfd shared by both
+     * processes, so it is copied once on each side and doesn't go through the
+     * kernel. eventfds are only signaled when the other side is waiting.
+     *
+     * The client creates the shared state, and 'outFds' must be sent to the
+     * server over 'socket' (see RpcConnectionHeader).
+     */
+    static std::unique_ptr<RpcTransport> makeSharedMemoryClient(
+            base::unique_fd socket, std::vector<base::unique_fd>* outFds);
+    // Takes the fds received from makeSharedMemoryClient.
+    static std::unique_ptr<RpcTransport> makeSharedMemoryServer(base::unique_fd socket,
+                                                                std::vector<base::unique_fd> fds);
+
+    // number of fds exchanged for a shared memory transport
+    static constexpr size_t kSharedMemoryFdCount = 5;
+
+protected:
+    explicit RpcTransport(base::unique_fd socket) : mSocket(std::move(socket)) {}
+
+    base::unique_fd mSocket;
+};
+
+} // namespace android
@@ -53,6 +53,23 @@ enum : uint32_t {
 
 constexpr int32_t RPC_SESSION_ID_NEW = -1;
 
+enum : uint32_t {
+    /**
+     * The connection header carries the fds for
+     * RpcTransport::makeSharedMemoryServer, and all other data is exchanged
+     * through them instead of the socket.
+     */
+    RPC_CONNECTION_OPTION_SHARED_MEMORY = 0x1,
+};
+
+/**
+ * Sent by the client once, when a connection is opened.
+ */
+struct RpcConnectionHeader {
+    int32_t sessionId; // or RPC_SESSION_ID_NEW
+    uint32_t options;  // RPC_CONNECTION_OPTION_*
+};
+
 // serialization is like:
 // |RpcWireHeader|struct desginated by 'command'| (over and over again)
 
@@ -60,7 +77,17 @@ struct RpcWireHeader {
     uint32_t command; // RPC_COMMAND_*
     uint32_t bodySize;
 
-    uint32_t reserved[2];
+    /**
+     * Zero for regular commands, which are processed in order by the thread
+     * reading a connection.
+     *
+     * Otherwise, this is a multiplexed RPC_COMMAND_TRANSACT, or the
+     * RPC_COMMAND_REPLY to one. Multiplexed transactions from many threads
+     * share a connection, so the receiver may process them concurrently, and
+     * it tags the reply with the same asyncId so that it can be matched to its
+     * caller.
+     */
+    uint64_t asyncId;
 };
 
 struct RpcWireAddress {
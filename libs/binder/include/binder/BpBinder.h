@@ -22,6 +22,7 @@
 #include <utils/Mutex.h>
 #include <utils/threads.h>
 
+#include <functional>
 #include <unordered_map>
 #include <variant>
 
@@ -61,6 +62,17 @@ public:
                                     Parcel* reply,
                                     uint32_t flags = 0) final;
 
+    /**
+     * Only for RPC binders on multiplexed sessions. Sends the transaction and
+     * returns without waiting for the reply, which is passed to 'callback'
+     * instead. See RpcSession::transactAsync.
+     */
+    // NOLINTNEXTLINE(google-default-arguments)
+            status_t    transactAsync(uint32_t code,
+                                      const Parcel& data,
+                                      std::function<void(status_t, const Parcel&)> callback,
+                                      uint32_t flags = 0);
+
     // NOLINTNEXTLINE(google-default-arguments)
     virtual status_t    linkToDeath(const sp<DeathRecipient>& recipient,
                                     void* cookie = nullptr,
@@ -164,6 +176,8 @@ private:
 
     virtual             ~BpBinder();
     virtual void        onFirstRef();
+    // strips userspace flags from 'flags' before they are sent
+            status_t    checkTransactStability(uint32_t code, uint32_t* flags);
     virtual void        onLastStrongRef(const void* id);
     virtual bool        onIncStrongAttempted(uint32_t flags, const void* id);
 
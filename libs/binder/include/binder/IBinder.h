@@ -60,6 +60,7 @@ public:
         SYSPROPS_TRANSACTION = B_PACK_CHARS('_', 'S', 'P', 'R'),
         EXTENSION_TRANSACTION = B_PACK_CHARS('_', 'E', 'X', 'T'),
         DEBUG_PID_TRANSACTION = B_PACK_CHARS('_', 'P', 'I', 'D'),
+        BINDER_STATS_TRANSACTION = B_PACK_CHARS('_', 'S', 'T', 'S'),
 
         // See android.os.IBinder.TWEET_TRANSACTION
         // Most importantly, messages can be anything not exceeding 130 UTF-8
@@ -152,6 +153,21 @@ public:
      */
     status_t                getDebugPid(pid_t* outPid);
 
+    enum class BinderStatsCommand : int32_t {
+        DUMP = 0,
+        ENABLE = 1,
+        DISABLE = 2,
+        RESET = 3,
+    };
+
+    /**
+     * Controls the per-interface, per-code latency histograms kept by the
+     * process hosting this binder. Collection is off until ENABLE is sent.
+     * DUMP writes p50/p99 server and client times of every method to fd.
+     * Only root, shell and system may send these commands.
+     */
+    status_t                binderStatsCommand(BinderStatsCommand command, int fd = -1);
+
     // NOLINTNEXTLINE(google-default-arguments)
     virtual status_t        transact(   uint32_t code,
                                         const Parcel& data,
@@ -21,6 +21,8 @@
 #include <binder/ProcessState.h>
 #include <utils/Vector.h>
 
+#include <deque>
+
 #if defined(_WIN32)
 typedef  int  uid_t;
 #endif
@@ -121,6 +123,30 @@ public:
                                          uint32_t code, const Parcel& data,
                                          Parcel* reply, uint32_t flags);
 
+            // While at least one ScopedOnewayBatch is alive on this thread, oneway
+            // transactions are queued instead of being written to the driver one
+            // ioctl at a time. The queue is sent in a single BINDER_WRITE_READ when the
+            // outermost batch goes out of scope, before any synchronous transaction
+            // made on this thread, or when flushOnewayBatch() is called.
+            //
+            // The data of each queued transaction is copied, so callers may destroy
+            // their Parcel as soon as transact() returns. Errors of individual queued
+            // transactions (e.g. DEAD_OBJECT) are not reported to their callers;
+            // flushOnewayBatch() returns the first one instead.
+            class ScopedOnewayBatch {
+            public:
+                ScopedOnewayBatch();
+                ~ScopedOnewayBatch();
+                ScopedOnewayBatch(const ScopedOnewayBatch&) = delete;
+                ScopedOnewayBatch& operator=(const ScopedOnewayBatch&) = delete;
+
+            private:
+                IPCThreadState* mSelf;
+            };
+
+            // Sends all oneway transactions queued by ScopedOnewayBatch.
+            status_t            flushOnewayBatch();
+
             void                incStrongHandle(int32_t handle, BpBinder *proxy);
             void                decStrongHandle(int32_t handle);
             void                incWeakHandle(int32_t handle, BpBinder *proxy);
@@ -176,6 +202,8 @@ private:
                                                      uint32_t code,
                                                      const Parcel& data,
                                                      status_t* statusBuffer);
+            status_t            queueOnewayTransaction(int32_t handle, uint32_t code,
+                                                   const Parcel& data, uint32_t flags);
             status_t            getAndExecuteCommand();
             status_t            executeCommand(int32_t command);
             void                processPendingDerefs();
@@ -207,6 +235,10 @@ private:
             bool                mPropagateWorkSource;
             bool                mIsLooper;
             bool mIsFlushing;
+            size_t              mOnewayBatchDepth;
+            bool                mIsFlushingOnewayBatch;
+            // Owns the data referenced by queued BC_TRANSACTION commands in mOut.
+            std::deque<Parcel>  mBatchedOneways;
             int32_t             mStrictModePolicy;
             int32_t             mLastTransactionBinderFlags;
             CallRestriction     mCallRestriction;
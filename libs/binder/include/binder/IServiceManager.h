@@ -107,6 +107,13 @@ public:
      * this can be updated.
      */
     virtual std::optional<String16> updatableViaApex(const String16& name) = 0;
+
+    /**
+     * Same as checkService for each of 'names', but with a single call to the
+     * service manager. Returns one entry per name, null for services which
+     * don't exist.
+     */
+    virtual Vector<sp<IBinder>> checkServices(const Vector<String16>& names);
 };
 
 sp<IServiceManager> defaultServiceManager();
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <functional>
 
 #include <binder/IServiceManager.h>
@@ -79,6 +80,28 @@ class LazyServiceRegistrar {
       */
      void setActiveServicesCallback(const std::function<bool(bool)>& activeServicesCallback);
 
+     /**
+      * Keep the process running for a while after its services lose their last client, so that
+      * services used in bursts are not restarted for every burst.
+      *
+      * After the last client goes away, the process waits 'linger' for one to come back before
+      * shutting down. Every time a client comes back in the second half of that wait, the wait
+      * doubles, up to 'maxLinger'. A 'linger' of zero, the default, shuts down as soon as there
+      * are no clients.
+      *
+      * The wait only starts if the active services callback did not handle the event, and
+      * forcePersist still prevents the shutdown.
+      *
+      * This method should be called before 'registerService' to avoid races.
+      */
+     void setLingerPeriod(std::chrono::milliseconds linger, std::chrono::milliseconds maxLinger);
+
+     /**
+      * Returns how many times a client came back while the process was lingering, each of which
+      * would otherwise have restarted it.
+      */
+     size_t getRestartsAvoided();
+
      /**
       * Try to unregister all services previously registered with 'registerService'.
       * Returns 'true' if successful. This should only be called within the callback registered by
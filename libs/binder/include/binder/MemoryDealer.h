@@ -25,7 +25,7 @@
 namespace android {
 // ----------------------------------------------------------------------------
 
-class SimpleBestFitAllocator;
+class SegregatedFitAllocator;
 
 // ----------------------------------------------------------------------------
 
@@ -49,10 +49,10 @@ protected:
 
 private:
     const sp<IMemoryHeap>&      heap() const;
-    SimpleBestFitAllocator*     allocator() const;
+    SegregatedFitAllocator*     allocator() const;
 
     sp<IMemoryHeap>             mHeap;
-    SimpleBestFitAllocator*     mAllocator;
+    SegregatedFitAllocator*     mAllocator;
 };
 
 
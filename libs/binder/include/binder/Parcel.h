@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <cstring>
 #include <map> // for legacy reasons
 #include <string>
 #include <type_traits>
@@ -900,27 +901,36 @@ private:
         using T = first_template_type_t<CT>;  // The T in CT == C<T, ...>
         if (c.size() >  std::numeric_limits<int32_t>::max()) return BAD_VALUE;
         const auto size = static_cast<int32_t>(c.size());
-        writeData(size);
         if constexpr (is_pointer_equivalent_array_v<T>) {
-            constexpr size_t limit = std::numeric_limits<size_t>::max() / sizeof(T);
+            constexpr size_t limit =
+                    (std::numeric_limits<size_t>::max() - sizeof(int32_t)) / sizeof(T);
             if (c.size() > limit) return BAD_VALUE;
             // is_pointer_equivalent types do not have gaps which could leak info,
             // which is only a concern when writing through binder.
 
-            // TODO: Padding of the write is suboptimal when the length of the
-            // data is not a multiple of 4.  Consider improving the write() method.
-            return write(c.data(), c.size() * sizeof(T));
+            // The size and the elements are written through a single reservation, so
+            // the Parcel only checks its capacity once for the whole vector.
+            auto data = reinterpret_cast<uint8_t*>(
+                    writeInplace(sizeof(int32_t) + c.size() * sizeof(T)));
+            if (data == nullptr) return BAD_VALUE;
+            *reinterpret_cast<int32_t*>(data) = size;
+            if (!c.empty()) memcpy(data + sizeof(int32_t), c.data(), c.size() * sizeof(T));
+            return OK;
         } else if constexpr (std::is_same_v<T, bool>
                 || std::is_same_v<T, char16_t>) {
             // reserve data space to write to
-            auto data = reinterpret_cast<int32_t*>(writeInplace(c.size() * sizeof(int32_t)));
+            auto data = reinterpret_cast<int32_t*>(
+                    writeInplace(sizeof(int32_t) + c.size() * sizeof(int32_t)));
             if (data == nullptr) return BAD_VALUE;
+            *data++ = size;
             for (const auto t: c) {
                 *data++ = static_cast<int32_t>(t);
             }
         } else /* constexpr */ {
+            status_t status = writeData(size);
+            if (status != OK) return status;
             for (const auto &t : c) {
-                const status_t status = writeData(t);
+                status = writeData(t);
                 if (status != OK) return status;
             }
         }
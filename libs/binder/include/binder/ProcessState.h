@@ -58,6 +58,24 @@ public:
             void                spawnPooledThread(bool isMain);
             
             status_t            setThreadPoolMaxThreadCount(size_t maxThreads);
+            // Lets threads spawned by the driver leave the thread pool when fewer of them
+            // were busy during the last timeoutMs than there are in the pool. At least
+            // minThreads threads are kept. An idle thread only leaves once it wakes up for a
+            // command, and the driver spawns a new one when the pool runs out again.
+            // A timeout of 0, the default, keeps every thread.
+            status_t            setThreadPoolIdleTimeout(int64_t timeoutMs, size_t minThreads);
+
+            struct ThreadPoolStats {
+                // Threads currently in the thread pool.
+                size_t threadCount;
+                // Threads that left the thread pool because they were not needed.
+                size_t reclaimedThreadCount;
+                // Most threads executing a command at the same time.
+                size_t peakExecutingThreadCount;
+                // Threads executing a command, averaged over the life of the process.
+                double averageExecutingThreadCount;
+            };
+            ThreadPoolStats     getThreadPoolStats();
             status_t            enableOnewaySpamDetection(bool enable);
             void                giveThreadPoolName();
 
@@ -105,6 +123,12 @@ private:
 
             handle_entry*       lookupHandleLocked(int32_t handle);
 
+            // Called with mThreadCountLock held, before and after a thread executes a command.
+            void                onExecutingThreadsChangingLocked();
+            void                onExecutingThreadsChangedLocked();
+            // Returns true if the calling pooled thread should leave the thread pool.
+            bool                shouldReclaimPooledThread();
+
             String8             mDriverName;
             int                 mDriverFD;
             void*               mVMStart;
@@ -121,6 +145,24 @@ private:
             size_t              mMaxThreads;
             // Time when thread pool was emptied
             int64_t             mStarvationStartTimeMs;
+            // Number of threads in IPCThreadState::joinThreadPool()
+            size_t              mPoolThreadsCount;
+            // Number of threads that left the thread pool after being idle.
+            size_t              mReclaimedThreadsCount;
+            // See setThreadPoolIdleTimeout().
+            int64_t             mIdleTimeoutMs;
+            size_t              mMinThreads;
+            // Most threads executing at once in the current and the previous idle timeout
+            // window, which started at mDemandWindowStartMs.
+            int64_t             mDemandWindowStartMs;
+            size_t              mDemandWindowPeak;
+            size_t              mPreviousDemandWindowPeak;
+            // Lifetime stats of mExecutingThreadsCount.
+            size_t              mPeakExecutingThreadsCount;
+            // Sum of mExecutingThreadsCount over time, in thread nanoseconds.
+            int64_t             mExecutingThreadsTimeNs;
+            int64_t             mExecutingThreadsChangeTimeNs;
+            int64_t             mCreationTimeNs;
 
     mutable Mutex               mLock;  // protects everything below.
 
@@ -21,6 +21,7 @@
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 
+#include <memory>
 #include <mutex>
 #include <thread>
 
@@ -119,9 +120,14 @@ public:
     /**
      * You must have at least one client session before calling this.
      *
+     * Connection headers are read on the calling thread, with at most
+     * kMaxPendingConnections connections waiting for their header at once.
+     * A thread is only started once a connection has sent a valid header.
+     *
      * TODO(b/185167543): way to shut down?
      */
     void join();
+    static constexpr size_t kMaxPendingConnections = 64;
 
     /**
      * Accept one connection on this server. You must have at least one client
@@ -135,6 +141,17 @@ public:
     std::vector<sp<RpcSession>> listSessions();
     size_t numUninitializedSessions();
 
+    struct ConnectionStats {
+        // Connections that were added to a session.
+        size_t established = 0;
+        // Connections dropped because of a bad or missing connection header.
+        size_t rejected = 0;
+        // Time from accepting a connection to adding it to a session.
+        int64_t totalSetupNs = 0;
+        int64_t maxSetupNs = 0;
+    };
+    ConnectionStats getConnectionStats();
+
     ~RpcServer();
 
     // internal use only
@@ -145,7 +162,10 @@ private:
     friend sp<RpcServer>;
     RpcServer();
 
-    void establishConnection(sp<RpcServer>&& session, base::unique_fd clientFd);
+    struct PendingConnection;
+    void establishConnection(sp<RpcServer>&& session,
+                             std::unique_ptr<PendingConnection> connection);
+    void onConnectionRejected();
     bool setupSocketServer(const RpcSocketAddress& address);
 
     bool mAgreedExperimental = false;
@@ -155,6 +175,8 @@ private:
 
     std::mutex mLock; // for below
     std::map<std::thread::id, std::thread> mConnectingThreads;
+    size_t mPendingConnectionsCount = 0; // waiting for a connection header in join()
+    ConnectionStats mConnectionStats;
     sp<IBinder> mRootObject;
     wp<IBinder> mRootObjectWeak;
     std::map<int32_t, sp<RpcSession>> mSessions;
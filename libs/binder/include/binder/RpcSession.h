@@ -21,7 +21,13 @@
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <thread>
 #include <vector>
@@ -36,6 +42,7 @@ class Parcel;
 class RpcServer;
 class RpcSocketAddress;
 class RpcState;
+class RpcTransport;
 
 /**
  * This represents a session (group of connections) between a client
@@ -46,6 +53,22 @@ class RpcSession final : public virtual RefBase {
 public:
     static sp<RpcSession> make();
 
+    /**
+     * Share this many connections to the server between all threads making
+     * calls, instead of opening one connection per server thread and having
+     * each call wait for an idle one. Calls from different threads are
+     * interleaved on the connections, and the server processes them on its
+     * thread pool (see RpcServer::setMaxThreads), so a thread never waits
+     * behind another thread's call.
+     *
+     * The server cannot call back into binders hosted by this process while
+     * processing a multiplexed call (nested transactions are not supported).
+     *
+     * This must be called before setting up the session. By default (0),
+     * connections are not multiplexed.
+     */
+    void setMaxMultiplexedConnections(size_t connections);
+
     /**
      * This should be called once per thread, matching 'join' in the remote
      * process.
@@ -62,6 +85,15 @@ public:
      */
     [[nodiscard]] bool setupInetClient(const char* addr, unsigned int port);
 
+    /**
+     * Like setupUnixDomainClient, but once connected, data is exchanged with
+     * the server through memory shared between the two processes instead of
+     * through the socket. The server only needs to be a unix domain server.
+     *
+     * transactAsync is not supported on these sessions.
+     */
+    [[nodiscard]] bool setupSharedMemoryClient(const char* path);
+
     /**
      * For debugging!
      *
@@ -87,6 +119,29 @@ public:
                                     Parcel* reply, uint32_t flags);
     [[nodiscard]] status_t sendDecStrong(const RpcAddress& address);
 
+    /**
+     * Called once with the result of transactAsync, and the reply (only
+     * valid for the duration of the call) if the result is OK.
+     */
+    using TransactCallback = std::function<void(status_t status, const Parcel& reply)>;
+
+    /**
+     * Like transact, but it returns once the transaction is sent, without
+     * waiting for the reply. Replies are read by a single thread per session
+     * (started by the first call to this), which calls 'callback' for each of
+     * them, so callbacks must not block. Any number of calls may be in flight
+     * without a thread waiting on each of them.
+     *
+     * If this doesn't return OK, 'callback' is never called.
+     *
+     * Only multiplexed sessions are supported (see
+     * setMaxMultiplexedConnections), and 'flags' cannot be FLAG_ONEWAY.
+     * Sessions using shared memory are not supported.
+     */
+    [[nodiscard]] status_t transactAsync(const RpcAddress& address, uint32_t code,
+                                         const Parcel& data, uint32_t flags,
+                                         TransactCallback callback);
+
     ~RpcSession();
 
     wp<RpcServer> server();
@@ -94,10 +149,17 @@ public:
     // internal only
     const std::unique_ptr<RpcState>& state() { return mState; }
 
+    // internal only - called on the thread reading 'transport' when it
+    // receives a multiplexed transaction, to have it processed by another thread
+    using MultiplexedTransaction =
+            std::function<status_t(RpcTransport& transport, std::mutex& sendMutex)>;
+    void postMultiplexedTransaction(RpcTransport& transport, MultiplexedTransaction transaction);
+
     class PrivateAccessorForId {
     private:
         friend class RpcSession;
         friend class RpcState;
+class RpcTransport;
         explicit PrivateAccessorForId(const RpcSession* session) : mSession(session) {}
 
         const std::optional<int32_t> get() { return mSession->mId; }
@@ -117,24 +179,72 @@ private:
     // transfer ownership of thread
     void preJoin(std::thread thread);
     // join on thread passed to preJoin
-    void join(base::unique_fd client);
+    void join(std::unique_ptr<RpcTransport> client);
     void terminateLocked();
 
+    // reply to a multiplexed transaction, filled in by whichever thread is
+    // reading from the connection
+    struct PendingReply {
+        Parcel* reply;
+        status_t status = OK;
+        bool done = false;
+
+        // for transactAsync - called instead of waking up a waiting thread,
+        // after which the reply parcel and this object are deleted
+        TransactCallback callback;
+    };
+
     struct RpcConnection : public RefBase {
-        base::unique_fd fd;
+        ~RpcConnection();
+
+        std::unique_ptr<RpcTransport> transport;
 
-        // whether this or another thread is currently using this fd to make
-        // or receive transactions.
+        // whether this or another thread is currently using this connection to
+        // make or receive transactions.
         std::optional<pid_t> exclusiveTid;
+
+        // whether this connection is shared between threads (see
+        // setMaxMultiplexedConnections), in which case everything written to
+        // it must be sent while holding sendMutex.
+        bool multiplexed = false;
+        std::mutex sendMutex;
+
+        // CLIENT - multiplexed connections only, guarded by RpcSession::mMutex
+
+        // whether a thread waiting for a reply is reading from this connection
+        bool replyReaderActive = false;
+        std::map<uint64_t, PendingReply*> pendingReplies;
     };
 
-    bool setupSocketClient(const RpcSocketAddress& address);
-    bool setupOneSocketClient(const RpcSocketAddress& address, int32_t sessionId);
-    void addClientConnection(base::unique_fd fd);
+    bool setupSocketClient(const RpcSocketAddress& address, bool sharedMemory);
+    bool setupOneSocketClient(const RpcSocketAddress& address, int32_t sessionId,
+                              bool sharedMemory);
+    void addClientConnection(std::unique_ptr<RpcTransport> transport);
     void setForServer(const wp<RpcServer>& server, int32_t sessionId);
-    sp<RpcConnection> assignServerToThisThread(base::unique_fd fd);
+    sp<RpcConnection> assignServerToThisThread(std::unique_ptr<RpcTransport> transport);
     bool removeServerConnection(const sp<RpcConnection>& connection);
 
+    status_t transactMultiplexed(const RpcAddress& address, uint32_t code, const Parcel& data,
+                                 Parcel* reply, uint32_t flags);
+    status_t waitForMultiplexedReply(const sp<RpcConnection>& connection, PendingReply* pending);
+    // Reads a reply and hands it to its caller. The calling thread must have
+    // set 'replyReaderActive' on the connection.
+    status_t processMultiplexedReply(const sp<RpcConnection>& connection);
+    // a connection which may be written to by any thread, if there are any
+    sp<RpcConnection> findMultiplexedConnection();
+    void multiplexedWorkerLoop();
+
+    // CLIENT - thread reading every multiplexed connection once transactAsync
+    // is used, instead of threads waiting for replies taking turns
+    struct Reactor {
+        base::unique_fd epollFd;
+        base::unique_fd eventFd; // signaled when the session is destroyed
+        std::atomic<bool> shutdown = false;
+    };
+    status_t startReactor();
+    static void reactorLoop(const wp<RpcSession>& weakSession,
+                            const std::shared_ptr<Reactor>& reactor);
+
     enum class ConnectionUse {
         CLIENT,
         CLIENT_ASYNC,
@@ -146,7 +256,7 @@ private:
     public:
         explicit ExclusiveConnection(const sp<RpcSession>& session, ConnectionUse use);
         ~ExclusiveConnection();
-        const base::unique_fd& fd() { return mConnection->fd; }
+        RpcTransport& transport() { return *mConnection->transport; }
 
     private:
         static void findConnection(pid_t tid, sp<RpcConnection>* exclusive,
@@ -193,6 +303,24 @@ private:
     std::vector<sp<RpcConnection>> mClientConnections;
     std::vector<sp<RpcConnection>> mServerConnections;
 
+    // CLIENT - multiplexed connections
+    size_t mMaxMultiplexedConnections = 0;
+    // set once all client connections are setup to be multiplexed
+    bool mMultiplexed = false;
+    uint64_t mNextAsyncId = 1;
+    std::condition_variable mMultiplexedReplyCv; // for PendingReply::done
+    std::shared_ptr<Reactor> mReactor;
+
+    // SERVER - multiplexed transactions waiting for a worker thread
+    struct MultiplexedWork {
+        sp<RpcConnection> connection;
+        MultiplexedTransaction transaction;
+    };
+    std::deque<MultiplexedWork> mMultiplexedWork;
+    std::condition_variable mMultiplexedWorkCv;
+    size_t mMultiplexedWorkers = 0;
+    size_t mIdleMultiplexedWorkers = 0;
+
     // TODO(b/185167543): use for reverse sessions (allow client to also
     // serve calls on a session).
     // TODO(b/185167543): allow sharing between different sessions in a
@@ -165,14 +165,30 @@ TEST(BinderAllocation, SmallTransaction) {
     sp<IServiceManager> manager = defaultServiceManager();
 
     size_t mallocs = 0;
-    const auto on_malloc = OnMalloc([&](size_t bytes) {
-        mallocs++;
-        // Parcel should allocate a small amount by default
-        EXPECT_EQ(bytes, 128);
-    });
+    {
+        const auto on_malloc = OnMalloc([&](size_t bytes) {
+            mallocs++;
+            // Parcel should allocate a small amount by default
+            EXPECT_EQ(bytes, 256);
+        });
+        manager->checkService(empty_descriptor);
+    }
+    EXPECT_LE(mallocs, 1);
+
+    // the buffer is recycled for the next transaction on this thread
+    const auto m = ScopeDisallowMalloc();
     manager->checkService(empty_descriptor);
+}
 
-    EXPECT_EQ(mallocs, 1);
+TEST(BinderAllocation, ParcelBufferReused) {
+    {
+        Parcel p;
+        p.writeInt32(42); // first write may allocate
+    }
+    const auto m = ScopeDisallowMalloc();
+    Parcel p;
+    p.writeInt32(42);
+    imaginary_use = p.data();
 }
 
 int main(int argc, char** argv) {
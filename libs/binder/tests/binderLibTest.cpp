@@ -416,6 +416,37 @@ TEST_F(BinderLibTest, NopTransactionOneway) {
                 StatusEq(NO_ERROR));
 }
 
+TEST_F(BinderLibTest, NopTransactionOnewayBatch) {
+    {
+        IPCThreadState::ScopedOnewayBatch batch;
+        for (int i = 0; i < 10; i++) {
+            Parcel data;
+            // the queued copy must keep the binder alive after data is gone
+            EXPECT_THAT(data.writeStrongBinder(sp<BBinder>::make()), StatusEq(NO_ERROR));
+            EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, nullptr,
+                                           TF_ONE_WAY),
+                        StatusEq(NO_ERROR));
+        }
+
+        // a synchronous call sends the queued transactions first
+        Parcel data, reply;
+        EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply),
+                    StatusEq(NO_ERROR));
+
+        for (int i = 0; i < 100; i++) {
+            Parcel onewayData;
+            EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, onewayData, nullptr,
+                                           TF_ONE_WAY),
+                        StatusEq(NO_ERROR));
+        }
+    }
+    EXPECT_THAT(IPCThreadState::self()->flushOnewayBatch(), StatusEq(NO_ERROR));
+
+    Parcel data, reply;
+    EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply),
+                StatusEq(NO_ERROR));
+}
+
 TEST_F(BinderLibTest, NopTransactionClear) {
     Parcel data, reply;
     // make sure it accepts the transaction flag
@@ -805,6 +836,57 @@ TEST_F(BinderLibTest, PassParcelFileDescriptor) {
     EXPECT_EQ(0, read(read_end.get(), readbuf.data(), datasize));
 }
 
+TEST_F(BinderLibTest, BinderStats) {
+    EXPECT_THAT(m_server->binderStatsCommand(IBinder::BinderStatsCommand::ENABLE),
+                StatusEq(NO_ERROR));
+    EXPECT_THAT(m_server->binderStatsCommand(IBinder::BinderStatsCommand::RESET),
+                StatusEq(NO_ERROR));
+    for (int i = 0; i < 10; i++) {
+        Parcel data, reply;
+        EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply),
+                    StatusEq(NO_ERROR));
+    }
+
+    android::base::unique_fd read_end, write_end;
+    {
+        int pipefd[2];
+        ASSERT_EQ(0, pipe(pipefd));
+        read_end.reset(pipefd[0]);
+        write_end.reset(pipefd[1]);
+    }
+    EXPECT_THAT(m_server->binderStatsCommand(IBinder::BinderStatsCommand::DUMP, write_end.get()),
+                StatusEq(NO_ERROR));
+    write_end.reset();
+
+    std::string output;
+    char buf[256];
+    ssize_t n;
+    while ((n = read(read_end.get(), buf, sizeof(buf))) > 0) output.append(buf, n);
+
+    EXPECT_THAT(output, testing::HasSubstr("(enabled)"));
+    EXPECT_THAT(output,
+                testing::HasSubstr("code=" + std::to_string(BINDER_LIB_TEST_NOP_TRANSACTION) +
+                                   " count=10 "));
+
+    EXPECT_THAT(m_server->binderStatsCommand(IBinder::BinderStatsCommand::DISABLE),
+                StatusEq(NO_ERROR));
+}
+
+TEST_F(BinderLibTest, CheckServices) {
+    sp<IServiceManager> sm = defaultServiceManager();
+
+    // cached while this process holds the service
+    EXPECT_EQ(m_server, sm->checkService(binderLibTestServiceName));
+
+    Vector<String16> names;
+    names.push(String16("test.binderLib.doesNotExist"));
+    names.push(binderLibTestServiceName);
+    Vector<sp<IBinder>> services = sm->checkServices(names);
+    ASSERT_EQ(2u, services.size());
+    EXPECT_EQ(nullptr, services[0]);
+    EXPECT_EQ(m_server, services[1]);
+}
+
 TEST_F(BinderLibTest, PromoteLocal) {
     sp<IBinder> strong = new BBinder();
     wp<IBinder> weak = strong;
@@ -1134,6 +1216,16 @@ TEST_F(BinderLibTest, GotSid) {
     EXPECT_THAT(server->transact(BINDER_LIB_TEST_CAN_GET_SID, data, nullptr), StatusEq(OK));
 }
 
+TEST_F(BinderLibTest, ThreadPoolIdleTimeout) {
+    EXPECT_THAT(ProcessState::self()->setThreadPoolIdleTimeout(-1, 0), StatusEq(BAD_VALUE));
+    EXPECT_THAT(ProcessState::self()->setThreadPoolIdleTimeout(0, 0), StatusEq(NO_ERROR));
+
+    ProcessState::ThreadPoolStats stats = ProcessState::self()->getThreadPoolStats();
+    EXPECT_EQ(0u, stats.reclaimedThreadCount);
+    EXPECT_GE(static_cast<double>(stats.peakExecutingThreadCount),
+              stats.averageExecutingThreadCount);
+}
+
 class BinderLibTestService : public BBinder
 {
     public:
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <binder/IMemory.h>
+#include <binder/MemoryDealer.h>
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+// Usage: atest binderMemoryDealerBenchmark
+
+using android::IMemory;
+using android::MemoryDealer;
+using android::sp;
+
+static constexpr size_t kHeapSize = 16 * 1024 * 1024;
+
+// Allocates and frees one region while state.range(0) other regions of mixed
+// sizes are live, as when audio or media clients carve many small buffers out
+// of one heap.
+static void BM_AllocateWithLiveRegions(benchmark::State& state) {
+    sp<MemoryDealer> dealer = sp<MemoryDealer>::make(kHeapSize, "BM_AllocateWithLiveRegions");
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<size_t> sizes(16, 4096);
+
+    std::vector<sp<IMemory>> live;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        live.push_back(dealer->allocate(sizes(rng)));
+    }
+    // Free every other region so the heap has holes of many sizes in it.
+    for (size_t i = 0; i < live.size(); i += 2) {
+        live[i].clear();
+    }
+
+    size_t next = 0;
+    while (state.KeepRunning()) {
+        sp<IMemory> memory = dealer->allocate(sizes(rng));
+        benchmark::DoNotOptimize(memory);
+        // Replace a live region too, so the free chunks keep changing.
+        if (!live.empty()) {
+            live[next] = dealer->allocate(sizes(rng));
+            next = (next + 1) % live.size();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_AllocateWithLiveRegions)->RangeMultiplier(4)->Range(16, 4096);
+
+BENCHMARK_MAIN();
@@ -146,3 +146,24 @@ TEST_READ_WRITE_INVERSE(char16_t, Char, {u'a', u'\0'});
 TEST_READ_WRITE_INVERSE(int8_t, Byte, {-1, 0, 1});
 TEST_READ_WRITE_INVERSE(String8, String8, {String8(), String8("a"), String8("asdf")});
 TEST_READ_WRITE_INVERSE(String16, String16, {String16(), String16("a"), String16("asdf")});
+TEST_READ_WRITE_INVERSE(std::vector<int32_t>, Int32Vector, {{}, {-2, -1, 0, 1, 2}});
+TEST_READ_WRITE_INVERSE(std::vector<int64_t>, Int64Vector, {{}, {-2, -1, 0, 1, 2}});
+TEST_READ_WRITE_INVERSE(std::vector<float>, FloatVector, {{}, {-1.0f, 0.0f, 3.14f}});
+TEST_READ_WRITE_INVERSE(std::vector<bool>, BoolVector, {{}, {true, false, true}});
+TEST_READ_WRITE_INVERSE(std::vector<char16_t>, CharVector, {{}, {u'a', u'\0', u'b'}});
+
+// Vectors are written in bulk, but must keep the layout of a size followed by each element.
+TEST(Parcel, Int32VectorMatchesElementWrites) {
+    const std::vector<int32_t> values = {-2, -1, 0, 1, 2};
+    Parcel vectorParcel;
+    EXPECT_EQ(OK, vectorParcel.writeInt32Vector(values));
+
+    Parcel elementParcel;
+    elementParcel.writeInt32(static_cast<int32_t>(values.size()));
+    for (int32_t value : values) {
+        elementParcel.writeInt32(value);
+    }
+
+    ASSERT_EQ(elementParcel.dataSize(), vectorParcel.dataSize());
+    EXPECT_EQ(0, memcmp(elementParcel.data(), vectorParcel.data(), vectorParcel.dataSize()));
+}
@@ -14,27 +14,126 @@
  * limitations under the License.
  */
 
+// Compares binder transports. Every benchmark is registered once per
+// transport (kernel binder on device, and RPC binder over each socket type and
+// shared memory), against a server in a separate process.
+//
+// BM_transaction sweeps payload size, oneway vs twoway and the number of
+// client threads, and reports p50/p99/p999 latency and allocations per call
+// in addition to throughput. For machine-readable results, run with
+// --benchmark_format=json or --benchmark_out=<file> --benchmark_out_format=json.
+
 #include <BnBinderRpcBenchmark.h>
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/unique_fd.h>
 #include <benchmark/benchmark.h>
 #include <binder/Binder.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
 #include <binder/RpcServer.h>
 #include <binder/RpcSession.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <new>
+#include <string>
 #include <thread>
+#include <vector>
 
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include "../vm_sockets.h" // for VMADDR_*
+
 using android::BBinder;
+using android::defaultServiceManager;
 using android::IBinder;
 using android::interface_cast;
 using android::OK;
+using android::ProcessState;
 using android::RpcServer;
 using android::RpcSession;
 using android::sp;
+using android::String16;
 using android::binder::Status;
 
+// Allocations made through operator new by the current thread. Parcel buffers
+// come from malloc directly and aren't counted.
+static thread_local uint64_t tAllocations = 0;
+
+void* operator new(size_t size) {
+    tAllocations++;
+    void* ptr = malloc(size == 0 ? 1 : size);
+    CHECK(ptr != nullptr) << "Out of memory allocating " << size << " bytes";
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+enum class Transport {
+    KERNEL,
+    RPC_UNIX,
+    RPC_VSOCK,
+    RPC_INET,
+    RPC_SHARED_MEMORY,
+};
+
+static const char* transportName(Transport transport) {
+    switch (transport) {
+        case Transport::KERNEL:
+            return "kernel";
+        case Transport::RPC_UNIX:
+            return "rpc_unix";
+        case Transport::RPC_VSOCK:
+            return "rpc_vsock";
+        case Transport::RPC_INET:
+            return "rpc_inet";
+        case Transport::RPC_SHARED_MEMORY:
+            return "rpc_shared_memory";
+    }
+    LOG(FATAL) << "Unknown transport";
+    return "";
+}
+
+static std::vector<Transport> supportedTransports() {
+    return {
+#ifdef __BIONIC__
+            Transport::KERNEL,
+#endif
+            Transport::RPC_UNIX,
+// TODO(b/185269356): working on host
+#ifdef __BIONIC__
+            Transport::RPC_VSOCK,
+#endif
+            Transport::RPC_INET,
+            Transport::RPC_SHARED_MEMORY,
+    };
+}
+
+static constexpr size_t kMaxThreads = 8;
+static constexpr unsigned int kVsockPort = 3556;
+static const char* kKernelServiceName = "binderRpcBenchmark";
+
+// Oneway calls are only queued by the server, so keep the client from getting
+// too far ahead of it (for kernel binder, it would run out of async space).
+static constexpr size_t kOnewayWindowBytes = 32 * 1024;
+
+static std::string socketAddress(Transport transport) {
+    return std::string(getenv("TMPDIR") ?: "/tmp") + "/binderRpcBenchmark_" +
+            transportName(transport);
+}
+
 class MyBinderRpcBenchmark : public BnBinderRpcBenchmark {
     Status repeatString(const std::string& str, std::string* out) override {
         *out = str;
@@ -44,32 +143,134 @@ class MyBinderRpcBenchmark : public BnBinderRpcBenchmark {
         *out = str;
         return Status::ok();
     }
+    Status repeatBytes(const std::vector<uint8_t>& bytes, std::vector<uint8_t>* out) override {
+        *out = bytes;
+        return Status::ok();
+    }
+    Status sendBytesOneway(const std::vector<uint8_t>& /*bytes*/) override {
+        mOnewayCount++;
+        return Status::ok();
+    }
+    Status getOnewayCount(int32_t* out) override {
+        *out = mOnewayCount;
+        return Status::ok();
+    }
+
+    std::atomic<int32_t> mOnewayCount = 0;
+};
+
+// Serves one MyBinderRpcBenchmark per transport, and writes the port of the
+// inet server to 'writeEnd' once all of them can be connected to.
+[[noreturn]] static void runServers(android::base::unique_fd writeEnd) {
+    unsigned int inetPort = 0;
+
+    for (Transport transport : supportedTransports()) {
+        if (transport == Transport::KERNEL) {
+            ProcessState::self()->setThreadPoolMaxThreadCount(kMaxThreads);
+            CHECK_EQ(OK,
+                     defaultServiceManager()->addService(String16(kKernelServiceName),
+                                                         sp<MyBinderRpcBenchmark>::make()));
+            ProcessState::self()->startThreadPool();
+            continue;
+        }
+
+        sp<RpcServer> server = RpcServer::make();
+        server->iUnderstandThisCodeIsExperimentalAndIWillNotUseItInProduction();
+        server->setMaxThreads(kMaxThreads);
+        server->setRootObject(sp<MyBinderRpcBenchmark>::make());
+
+        switch (transport) {
+            case Transport::RPC_UNIX:
+            case Transport::RPC_SHARED_MEMORY: {
+                std::string addr = socketAddress(transport);
+                (void)unlink(addr.c_str());
+                CHECK(server->setupUnixDomainServer(addr.c_str())) << addr;
+                break;
+            }
+            case Transport::RPC_VSOCK:
+                CHECK(server->setupVsockServer(kVsockPort));
+                break;
+            case Transport::RPC_INET:
+                CHECK(server->setupInetServer(0, &inetPort));
+                CHECK_NE(0, inetPort);
+                break;
+            default:
+                LOG(FATAL) << "Unknown transport";
+        }
+
+        std::thread([server]() { server->join(); }).detach();
+    }
+
+    CHECK(android::base::WriteFully(writeEnd.get(), &inetPort, sizeof(inetPort)));
+    while (true) pause();
+}
+
+struct Connection {
+    // null for kernel binder
+    sp<RpcSession> session;
+    sp<IBinder> binder;
+    sp<IBinderRpcBenchmark> iface;
+
+    // across all client threads
+    std::atomic<int32_t> onewaysSent = 0;
 };
 
-static sp<RpcSession> gSession = RpcSession::make();
+static std::map<Transport, Connection> gConnections;
+
+static void connect(Transport transport, unsigned int inetPort) {
+    Connection& connection = gConnections[transport];
+
+    if (transport == Transport::KERNEL) {
+        connection.binder = defaultServiceManager()->checkService(String16(kKernelServiceName));
+    } else {
+        connection.session = RpcSession::make();
+        bool connected = false;
+        switch (transport) {
+            case Transport::RPC_UNIX:
+                connected = connection.session->setupUnixDomainClient(
+                        socketAddress(transport).c_str());
+                break;
+            case Transport::RPC_VSOCK:
+                connected = connection.session->setupVsockClient(VMADDR_CID_LOCAL, kVsockPort);
+                break;
+            case Transport::RPC_INET:
+                connected = connection.session->setupInetClient("127.0.0.1", inetPort);
+                break;
+            case Transport::RPC_SHARED_MEMORY:
+                connected = connection.session->setupSharedMemoryClient(
+                        socketAddress(transport).c_str());
+                break;
+            default:
+                LOG(FATAL) << "Unknown transport";
+        }
+        CHECK(connected) << "Could not connect over " << transportName(transport);
+        connection.binder = connection.session->getRootObject();
+    }
+
+    CHECK(connection.binder != nullptr) << transportName(transport);
+    connection.iface = interface_cast<IBinderRpcBenchmark>(connection.binder);
+    CHECK(connection.iface != nullptr) << transportName(transport);
+}
+
+void BM_getRootObject(benchmark::State& state, Transport transport) {
+    sp<RpcSession> session = gConnections.at(transport).session;
+    CHECK(session != nullptr);
 
-void BM_getRootObject(benchmark::State& state) {
     while (state.KeepRunning()) {
-        CHECK(gSession->getRootObject() != nullptr);
+        CHECK(session->getRootObject() != nullptr);
     }
 }
-BENCHMARK(BM_getRootObject);
 
-void BM_pingTransaction(benchmark::State& state) {
-    sp<IBinder> binder = gSession->getRootObject();
-    CHECK(binder != nullptr);
+void BM_pingTransaction(benchmark::State& state, Transport transport) {
+    sp<IBinder> binder = gConnections.at(transport).binder;
 
     while (state.KeepRunning()) {
         CHECK_EQ(OK, binder->pingBinder());
     }
 }
-BENCHMARK(BM_pingTransaction);
 
-void BM_repeatString(benchmark::State& state) {
-    sp<IBinder> binder = gSession->getRootObject();
-    CHECK(binder != nullptr);
-    sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
-    CHECK(iface != nullptr);
+void BM_repeatString(benchmark::State& state, Transport transport) {
+    sp<IBinderRpcBenchmark> iface = gConnections.at(transport).iface;
 
     // Googlers might see go/another-look-at-aidl-hidl-perf
     //
@@ -92,13 +293,9 @@ void BM_repeatString(benchmark::State& state) {
         CHECK(ret.isOk()) << ret;
     }
 }
-BENCHMARK(BM_repeatString);
 
-void BM_repeatBinder(benchmark::State& state) {
-    sp<IBinder> binder = gSession->getRootObject();
-    CHECK(binder != nullptr);
-    sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
-    CHECK(iface != nullptr);
+void BM_repeatBinder(benchmark::State& state, Transport transport) {
+    sp<IBinderRpcBenchmark> iface = gConnections.at(transport).iface;
 
     while (state.KeepRunning()) {
         // force creation of a new address
@@ -109,30 +306,137 @@ void BM_repeatBinder(benchmark::State& state) {
         CHECK(ret.isOk()) << ret;
     }
 }
-BENCHMARK(BM_repeatBinder);
+
+static void waitForOneways(Connection& connection, int32_t count) {
+    while (true) {
+        int32_t processed;
+        Status ret = connection.iface->getOnewayCount(&processed);
+        CHECK(ret.isOk()) << ret;
+        if (processed >= count) return;
+    }
+}
+
+// state.range(0) is the payload size in bytes, and state.range(1) is whether
+// calls are oneway. For oneway calls, the time spent waiting for the server to
+// catch up is included in the latency of the call which waited.
+void BM_transaction(benchmark::State& state, Transport transport) {
+    Connection& connection = gConnections.at(transport);
+    const size_t size = state.range(0);
+    const bool oneway = state.range(1) != 0;
+
+    std::vector<uint8_t> payload(size, 'a');
+    std::vector<int64_t> latenciesNs;
+    latenciesNs.reserve(state.max_iterations);
+    size_t unackedBytes = 0;
+
+    const uint64_t allocationsBefore = tAllocations;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        if (oneway) {
+            Status ret = connection.iface->sendBytesOneway(payload);
+            CHECK(ret.isOk()) << ret;
+            int32_t sent = ++connection.onewaysSent;
+            unackedBytes += size;
+            if (unackedBytes >= kOnewayWindowBytes) {
+                waitForOneways(connection, sent);
+                unackedBytes = 0;
+            }
+        } else {
+            std::vector<uint8_t> out;
+            Status ret = connection.iface->repeatBytes(payload, &out);
+            CHECK(ret.isOk()) << ret;
+        }
+        latenciesNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count());
+    }
+    const uint64_t allocations = tAllocations - allocationsBefore;
+
+    // don't leave work queued up for the next benchmark
+    if (oneway) waitForOneways(connection, connection.onewaysSent);
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * size);
+    if (latenciesNs.empty()) return;
+
+    // Percentiles are computed per thread, and averaged across threads.
+    std::sort(latenciesNs.begin(), latenciesNs.end());
+    auto percentile = [&](double p) {
+        size_t index = std::min(latenciesNs.size() - 1,
+                                static_cast<size_t>(p * latenciesNs.size()));
+        return benchmark::Counter(latenciesNs[index], benchmark::Counter::kAvgThreads);
+    };
+    state.counters["p50_ns"] = percentile(0.5);
+    state.counters["p99_ns"] = percentile(0.99);
+    state.counters["p999_ns"] = percentile(0.999);
+    state.counters["allocs_per_call"] =
+            benchmark::Counter(static_cast<double>(allocations) / latenciesNs.size(),
+                               benchmark::Counter::kAvgThreads);
+}
+
+static void registerBenchmarks(Transport transport) {
+    const std::string suffix = std::string("/") + transportName(transport);
+
+    if (transport != Transport::KERNEL) {
+        benchmark::RegisterBenchmark(("BM_getRootObject" + suffix).c_str(),
+                                     [=](benchmark::State& state) {
+                                         BM_getRootObject(state, transport);
+                                     });
+    }
+    benchmark::RegisterBenchmark(("BM_pingTransaction" + suffix).c_str(),
+                                 [=](benchmark::State& state) {
+                                     BM_pingTransaction(state, transport);
+                                 });
+    benchmark::RegisterBenchmark(("BM_repeatString" + suffix).c_str(),
+                                 [=](benchmark::State& state) {
+                                     BM_repeatString(state, transport);
+                                 });
+    benchmark::RegisterBenchmark(("BM_repeatBinder" + suffix).c_str(),
+                                 [=](benchmark::State& state) {
+                                     BM_repeatBinder(state, transport);
+                                 });
+
+    auto* transaction = benchmark::RegisterBenchmark(("BM_transaction" + suffix).c_str(),
+                                                     [=](benchmark::State& state) {
+                                                         BM_transaction(state, transport);
+                                                     });
+    transaction->ArgNames({"bytes", "oneway"});
+    for (int64_t size : {64, 1024, 4096, 16384, 65536}) {
+        for (int64_t oneway : {0, 1}) {
+            transaction->Args({size, oneway});
+        }
+    }
+    transaction->ThreadRange(1, kMaxThreads)->UseRealTime();
+}
 
 int main(int argc, char** argv) {
     ::benchmark::Initialize(&argc, argv);
     if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
 
-    std::string addr = std::string(getenv("TMPDIR") ?: "/tmp") + "/binderRpcBenchmark";
-    (void)unlink(addr.c_str());
+    // The server must be forked before this process touches binder.
+    android::base::unique_fd readEnd, writeEnd;
+    CHECK(android::base::Pipe(&readEnd, &writeEnd));
+    pid_t serverPid = fork();
+    CHECK_GE(serverPid, 0) << strerror(errno);
+    if (serverPid == 0) {
+        readEnd.reset();
+        CHECK_EQ(0, prctl(PR_SET_PDEATHSIG, SIGKILL));
+        runServers(std::move(writeEnd));
+    }
+    writeEnd.reset();
 
-    std::thread([addr]() {
-        sp<RpcServer> server = RpcServer::make();
-        server->setRootObject(sp<MyBinderRpcBenchmark>::make());
-        server->iUnderstandThisCodeIsExperimentalAndIWillNotUseItInProduction();
-        CHECK(server->setupUnixDomainServer(addr.c_str()));
-        server->join();
-    }).detach();
+    unsigned int inetPort = 0;
+    CHECK(android::base::ReadFully(readEnd.get(), &inetPort, sizeof(inetPort)))
+            << "Server failed to start";
 
-    for (size_t tries = 0; tries < 5; tries++) {
-        usleep(10000);
-        if (gSession->setupUnixDomainClient(addr.c_str())) goto success;
+    for (Transport transport : supportedTransports()) {
+        connect(transport, inetPort);
+        registerBenchmarks(transport);
     }
-    LOG(FATAL) << "Could not connect.";
-success:
 
     ::benchmark::RunSpecifiedBenchmarks();
+
+    (void)kill(serverPid, SIGKILL);
+    (void)waitpid(serverPid, nullptr, 0);
     return 0;
 }
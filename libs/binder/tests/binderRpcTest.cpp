@@ -30,8 +30,10 @@
 #include <gtest/gtest.h>
 
 #include <chrono>
+#include <condition_variable>
 #include <cstdlib>
 #include <iostream>
+#include <mutex>
 #include <thread>
 
 #include <sys/prctl.h>
@@ -303,6 +305,7 @@ enum class SocketType {
     UNIX,
     VSOCK,
     INET,
+    SHARED_MEMORY,
 };
 static inline std::string PrintSocketType(const testing::TestParamInfo<SocketType>& info) {
     switch (info.param) {
@@ -312,6 +315,8 @@ static inline std::string PrintSocketType(const testing::TestParamInfo<SocketTyp
             return "vm_socket";
         case SocketType::INET:
             return "inet_socket";
+        case SocketType::SHARED_MEMORY:
+            return "shared_memory";
         default:
             LOG_ALWAYS_FATAL("Unknown socket type");
             return "";
@@ -323,7 +328,8 @@ public:
     // threads.
     ProcessSession createRpcTestSocketServerProcess(
             size_t numThreads, size_t numSessions,
-            const std::function<void(const sp<RpcServer>&)>& configure) {
+            const std::function<void(const sp<RpcServer>&)>& configure,
+            size_t numMultiplexedConnections = 0) {
         CHECK_GE(numSessions, 1) << "Must have at least one session to a server";
 
         SocketType socketType = GetParam();
@@ -344,6 +350,7 @@ public:
 
                     switch (socketType) {
                         case SocketType::UNIX:
+                        case SocketType::SHARED_MEMORY:
                             CHECK(server->setupUnixDomainServer(addr.c_str())) << addr;
                             break;
                         case SocketType::VSOCK:
@@ -375,6 +382,7 @@ public:
 
         for (size_t i = 0; i < numSessions; i++) {
             sp<RpcSession> session = RpcSession::make();
+            session->setMaxMultiplexedConnections(numMultiplexedConnections);
             switch (socketType) {
                 case SocketType::UNIX:
                     if (session->setupUnixDomainClient(addr.c_str())) goto success;
@@ -385,6 +393,9 @@ public:
                 case SocketType::INET:
                     if (session->setupInetClient("127.0.0.1", outPort)) goto success;
                     break;
+                case SocketType::SHARED_MEMORY:
+                    if (session->setupSharedMemoryClient(addr.c_str())) goto success;
+                    break;
                 default:
                     LOG_ALWAYS_FATAL("Unknown socket type");
             }
@@ -395,8 +406,8 @@ public:
         return ret;
     }
 
-    BinderRpcTestProcessSession createRpcTestSocketServerProcess(size_t numThreads,
-                                                                 size_t numSessions = 1) {
+    BinderRpcTestProcessSession createRpcTestSocketServerProcess(
+            size_t numThreads, size_t numSessions = 1, size_t numMultiplexedConnections = 0) {
         BinderRpcTestProcessSession ret{
                 .proc = createRpcTestSocketServerProcess(numThreads, numSessions,
                                                          [&](const sp<RpcServer>& server) {
@@ -404,7 +415,8 @@ public:
                                                                      new MyBinderRpcTest;
                                                              server->setRootObject(service);
                                                              service->server = server;
-                                                         }),
+                                                         },
+                                                         numMultiplexedConnections),
         };
 
         ret.rootBinder = ret.proc.sessions.at(0).root;
@@ -868,6 +880,104 @@ TEST_P(BinderRpc, OnewayCallQueueing) {
     EXPECT_GT(epochMsAfter, epochMsBefore + kSleepMs * kNumSleeps);
 }
 
+TEST_P(BinderRpc, MultiplexedCallsDoNotWaitForEachOther) {
+    constexpr size_t kNumThreads = 10;
+    constexpr size_t kSleepMs = 500;
+
+    // every call shares a single connection
+    auto proc = createRpcTestSocketServerProcess(kNumThreads, 1 /*sessions*/,
+                                                 1 /*multiplexed connections*/);
+
+    size_t epochMsBefore = epochMillis();
+
+    std::vector<std::thread> ts;
+    for (size_t i = 0; i < kNumThreads; i++) {
+        ts.push_back(std::thread([&] { EXPECT_OK(proc.rootIface->sleepMs(kSleepMs)); }));
+    }
+
+    for (auto& t : ts) t.join();
+
+    size_t epochMsAfter = epochMillis();
+
+    EXPECT_GE(epochMsAfter, epochMsBefore + kSleepMs);
+
+    // Potential flake, but make sure calls are handled in parallel.
+    EXPECT_LE(epochMsAfter, epochMsBefore + 2 * kSleepMs);
+}
+
+TEST_P(BinderRpc, MultiplexedThreadingStressTest) {
+    constexpr size_t kNumClientThreads = 10;
+    constexpr size_t kNumServerThreads = 4;
+    constexpr size_t kNumCalls = 100;
+
+    auto proc = createRpcTestSocketServerProcess(kNumServerThreads, 1 /*sessions*/,
+                                                 2 /*multiplexed connections*/);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kNumClientThreads; i++) {
+        threads.push_back(std::thread([&] {
+            for (size_t j = 0; j < kNumCalls; j++) {
+                sp<IBinder> out;
+                EXPECT_OK(proc.rootIface->repeatBinder(proc.rootBinder, &out));
+                EXPECT_EQ(proc.rootBinder, out);
+
+                EXPECT_OK(proc.rootIface->sendString("a"));
+            }
+        }));
+    }
+
+    for (auto& t : threads) t.join();
+}
+
+TEST_P(BinderRpc, TransactAsyncRequiresMultiplexedSession) {
+    auto proc = createRpcTestSocketServerProcess(1);
+
+    Parcel data;
+    data.markForBinder(proc.rootBinder);
+    EXPECT_EQ(INVALID_OPERATION,
+              proc.rootBinder->remoteBinder()->transactAsync(IBinder::PING_TRANSACTION, data,
+                                                             [](status_t, const Parcel&) {
+                                                                 ADD_FAILURE();
+                                                             }));
+}
+
+TEST_P(BinderRpc, MultiplexedTransactAsync) {
+    if (GetParam() == SocketType::SHARED_MEMORY) {
+        GTEST_SKIP() << "transactAsync needs a pollable transport";
+    }
+
+    constexpr size_t kNumCalls = 100;
+
+    auto proc = createRpcTestSocketServerProcess(4 /*threads*/, 1 /*sessions*/,
+                                                 1 /*multiplexed connections*/);
+
+    std::mutex m;
+    std::condition_variable cv;
+    size_t numReplies = 0;
+
+    for (size_t i = 0; i < kNumCalls; i++) {
+        Parcel data;
+        data.markForBinder(proc.rootBinder);
+        EXPECT_EQ(OK,
+                  proc.rootBinder->remoteBinder()
+                          ->transactAsync(IBinder::PING_TRANSACTION, data,
+                                          [&](status_t status, const Parcel&) {
+                                              EXPECT_EQ(OK, status);
+                                              std::lock_guard<std::mutex> lock(m);
+                                              numReplies++;
+                                              cv.notify_all();
+                                          }));
+    }
+
+    // synchronous calls still work while asynchronous ones are in flight
+    EXPECT_EQ(OK, proc.rootBinder->pingBinder());
+
+    std::unique_lock<std::mutex> lock(m);
+    EXPECT_TRUE(cv.wait_for(lock, std::chrono::seconds(10),
+                            [&] { return numReplies == kNumCalls; }))
+            << numReplies << " of " << kNumCalls;
+}
+
 TEST_P(BinderRpc, Die) {
     for (bool doDeathCleanup : {true, false}) {
         auto proc = createRpcTestSocketServerProcess(1);
@@ -939,6 +1049,7 @@ INSTANTIATE_TEST_CASE_P(PerSocket, BinderRpc,
                                 SocketType::VSOCK,
 #endif
                                 SocketType::INET,
+                                SocketType::SHARED_MEMORY,
                         }),
                         PrintSocketType);
 
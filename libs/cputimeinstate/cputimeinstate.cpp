@@ -22,7 +22,12 @@
 #include <dirent.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <linux/bpf.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
+#include <unistd.h>
+
+#include <atomic>
 
 #include <mutex>
 #include <numeric>
@@ -521,6 +526,235 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsUpdatedCon
     return ret;
 }
 
+static std::atomic<bool> gBatchLookupUnsupported = false;
+
+// Reads up to *count entries of a map with a single BPF_MAP_LOOKUP_BATCH, continuing from the
+// position in batch unless first is set. Returns the number of entries read in *count, and fails
+// with ENOENT once the end of the map is reached.
+static int lookupMapBatch(int mapFd, bool first, uint64_t *batch, void *keys, void *values,
+                          uint32_t *count) {
+    union bpf_attr attr = {};
+    uint64_t nextBatch = 0;
+    attr.batch.in_batch = first ? 0 : reinterpret_cast<uintptr_t>(batch);
+    attr.batch.out_batch = reinterpret_cast<uintptr_t>(&nextBatch);
+    attr.batch.keys = reinterpret_cast<uintptr_t>(keys);
+    attr.batch.values = reinterpret_cast<uintptr_t>(values);
+    attr.batch.count = *count;
+    attr.batch.map_fd = mapFd;
+    int ret = syscall(__NR_bpf, BPF_MAP_LOOKUP_BATCH, &attr, sizeof(attr));
+    *count = attr.batch.count;
+    *batch = nextBatch;
+    return ret;
+}
+
+// Collects the uids that have run since lastUpdate, with the same margin as uidUpdatedSince, and
+// advances *newLastUpdate to the latest update seen. The last update map is read in batches where
+// the kernel supports it, rather than with a lookup and a key iteration per uid.
+static bool getUidsUpdatedSince(uint64_t lastUpdate, std::vector<uint32_t> *uids,
+                                uint64_t *newLastUpdate) {
+    constexpr uint64_t NSEC_PER_SEC = 1000000000;
+    const auto addUid = [&](uint32_t uid, uint64_t uidLastUpdate) {
+        if (uidLastUpdate + NSEC_PER_SEC < lastUpdate) return;
+        if (uidLastUpdate > *newLastUpdate) *newLastUpdate = uidLastUpdate;
+        uids->push_back(uid);
+    };
+    uids->clear();
+
+    if (!gBatchLookupUnsupported) {
+        constexpr uint32_t BATCH_SIZE = 256;
+        uint32_t keys[BATCH_SIZE];
+        uint64_t values[BATCH_SIZE];
+        uint64_t batch = 0;
+        for (bool first = true;; first = false) {
+            uint32_t count = BATCH_SIZE;
+            int ret = lookupMapBatch(gUidLastUpdateMapFd, first, &batch, keys, values, &count);
+            if (ret && errno != ENOENT) {
+                if (!first) return false;
+                // Kernels before 5.6 have no batch operations, so fall back to iterating.
+                gBatchLookupUnsupported = true;
+                break;
+            }
+            for (uint32_t i = 0; i < count; ++i) addUid(keys[i], values[i]);
+            if (ret) return true;
+        }
+    }
+
+    uint32_t uid, prevUid;
+    if (getFirstMapKey(gUidLastUpdateMapFd, &uid)) return errno == ENOENT;
+    do {
+        uint64_t uidLastUpdate;
+        if (findMapEntry(gUidLastUpdateMapFd, &uid, &uidLastUpdate)) {
+            if (errno == ENOENT) continue;
+            return false;
+        }
+        addUid(uid, uidLastUpdate);
+    } while (prevUid = uid, !getNextMapKey(gUidLastUpdateMapFd, &prevUid, &uid));
+    return errno == ENOENT;
+}
+
+// Retrieve the times in ns that each uid spent running at each CPU freq, for the uids that have
+// run since *lastUpdate, and advance *lastUpdate. Pass 0 to retrieve every uid.
+// Returns false on error, otherwise out holds the uids and their times laid out as
+// uids = [uid0, uid1, ...], times = [t0_0_0, t0_0_1, ..., t0_1_0, ..., t1_0_0, ...]
+// where ti_j_k is the ns uids[i] spent running on the jth cluster at the cluster's kth lowest freq.
+// Only the uids that ran are looked up, and the storage of out is reused across calls.
+bool getUidsUpdatedCpuFreqTimes(uint64_t *lastUpdate, uid_cpu_freq_times_t *out) {
+    if (!gInitialized && !initGlobals()) return false;
+
+    static thread_local std::vector<uint32_t> uids;
+    uint64_t newLastUpdate = *lastUpdate;
+    if (!getUidsUpdatedSince(*lastUpdate, &uids, &newLastUpdate)) return false;
+
+    uint32_t maxFreqCount = 0;
+    uint32_t freqCount = 0;
+    std::vector<uint32_t> policyOffsets;
+    for (const auto &freqList : gPolicyFreqs) {
+        if (freqList.size() > maxFreqCount) maxFreqCount = freqList.size();
+        policyOffsets.push_back(freqCount);
+        freqCount += freqList.size();
+    }
+
+    out->uids.clear();
+    out->times.clear();
+    std::vector<tis_val_t> vals(gNCpus);
+    for (uint32_t uid : uids) {
+        const size_t base = out->times.size();
+        out->times.resize(base + freqCount, 0);
+
+        bool found = false;
+        time_key_t key = {.uid = uid};
+        for (key.bucket = 0; key.bucket <= (maxFreqCount - 1) / FREQS_PER_ENTRY; ++key.bucket) {
+            if (findMapEntry(gTisMapFd, &key, vals.data())) {
+                if (errno != ENOENT) return false;
+                continue;
+            }
+            found = true;
+
+            auto offset = key.bucket * FREQS_PER_ENTRY;
+            for (uint32_t j = 0; j < gNPolicies; ++j) {
+                if (offset >= gPolicyFreqs[j].size()) continue;
+                auto begin = out->times.begin() + base + policyOffsets[j] + offset;
+                auto end = begin +
+                        std::min<size_t>(FREQS_PER_ENTRY, gPolicyFreqs[j].size() - offset);
+                for (const auto &cpu : gPolicyCpus[j]) {
+                    std::transform(begin, end, std::begin(vals[cpu].ar), begin,
+                                   std::plus<uint64_t>());
+                }
+            }
+        }
+
+        if (found) {
+            out->uids.push_back(uid);
+        } else {
+            out->times.resize(base);
+        }
+    }
+
+    if (newLastUpdate > *lastUpdate) *lastUpdate = newLastUpdate;
+    return true;
+}
+
+// Reads the concurrent times of uid into active and policy, which hold gNCpus entries each.
+// Returns false on error, and sets *found to whether the uid has any entry.
+static bool readUidConcurrentTimes(uint32_t uid, std::vector<concurrent_val_t> &vals,
+                                   const std::vector<uint32_t> &policyOffsets,
+                                   std::vector<uint64_t>::iterator active,
+                                   std::vector<uint64_t>::iterator policy, bool *found) {
+    *found = false;
+    time_key_t key = {.uid = uid};
+    for (key.bucket = 0; key.bucket <= (gNCpus - 1) / CPUS_PER_ENTRY; ++key.bucket) {
+        if (findMapEntry(gConcurrentMapFd, &key, vals.data())) {
+            if (errno != ENOENT) return false;
+            continue;
+        }
+        *found = true;
+
+        auto offset = key.bucket * CPUS_PER_ENTRY;
+        auto activeBegin = active + offset;
+        auto activeEnd = activeBegin + std::min<size_t>(CPUS_PER_ENTRY, gNCpus - offset);
+        for (uint32_t cpu = 0; cpu < gNCpus; ++cpu) {
+            std::transform(activeBegin, activeEnd, std::begin(vals[cpu].active), activeBegin,
+                           std::plus<uint64_t>());
+        }
+
+        for (uint32_t j = 0; j < gNPolicies; ++j) {
+            if (offset >= gPolicyCpus[j].size()) continue;
+            auto policyBegin = policy + policyOffsets[j] + offset;
+            auto policyEnd =
+                    policyBegin + std::min<size_t>(CPUS_PER_ENTRY, gPolicyCpus[j].size() - offset);
+            for (const auto &cpu : gPolicyCpus[j]) {
+                std::transform(policyBegin, policyEnd, std::begin(vals[cpu].policy), policyBegin,
+                               std::plus<uint64_t>());
+            }
+        }
+    }
+    return true;
+}
+
+// Retrieve the times in ns that each uid spent running concurrently with each possible number of
+// other tasks on each cluster (policy times) and overall (active times), for the uids that have
+// run since *lastUpdate, and advance *lastUpdate. Pass 0 to retrieve every uid.
+// Returns false on error, otherwise out holds the uids and their times laid out as
+// uids = [uid0, uid1, ...], active = [a0_0, a0_1, ..., a1_0, ...],
+// policy = [p0_0_0, p0_0_1, ..., p0_1_0, ..., p1_0_0, ...]
+// with the same meaning as in getUidConcurrentTimes for uids[i]. The storage of out is reused
+// across calls.
+bool getUidsUpdatedConcurrentTimes(uint64_t *lastUpdate, uid_concurrent_times_t *out) {
+    if (!gInitialized && !initGlobals()) return false;
+
+    static thread_local std::vector<uint32_t> uids;
+    uint64_t newLastUpdate = *lastUpdate;
+    if (!getUidsUpdatedSince(*lastUpdate, &uids, &newLastUpdate)) return false;
+
+    uint32_t cpuCount = 0;
+    std::vector<uint32_t> policyOffsets;
+    for (const auto &cpuList : gPolicyCpus) {
+        policyOffsets.push_back(cpuCount);
+        cpuCount += cpuList.size();
+    }
+
+    out->uids.clear();
+    out->active.clear();
+    out->policy.clear();
+    std::vector<concurrent_val_t> vals(gNCpus);
+    for (uint32_t uid : uids) {
+        const size_t activeBase = out->active.size();
+        const size_t policyBase = out->policy.size();
+        out->active.resize(activeBase + gNCpus, 0);
+        out->policy.resize(policyBase + cpuCount, 0);
+
+        bool found;
+        if (!readUidConcurrentTimes(uid, vals, policyOffsets, out->active.begin() + activeBase,
+                                    out->policy.begin() + policyBase, &found)) {
+            return false;
+        }
+
+        // As in getUidConcurrentTimes, reread once if an entry was read in the middle of an update.
+        const auto activeBegin = out->active.begin() + activeBase;
+        const auto policyBegin = out->policy.begin() + policyBase;
+        if (found &&
+            std::accumulate(activeBegin, out->active.end(), (uint64_t)0) !=
+                    std::accumulate(policyBegin, out->policy.end(), (uint64_t)0)) {
+            std::fill(activeBegin, out->active.end(), 0);
+            std::fill(policyBegin, out->policy.end(), 0);
+            if (!readUidConcurrentTimes(uid, vals, policyOffsets, activeBegin, policyBegin,
+                                        &found)) {
+                return false;
+            }
+        }
+
+        if (found) {
+            out->uids.push_back(uid);
+        } else {
+            out->active.resize(activeBase);
+            out->policy.resize(policyBase);
+        }
+    }
+
+    if (newLastUpdate > *lastUpdate) *lastUpdate = newLastUpdate;
+    return true;
+}
+
 // Clear all time in state data for a given uid. Returns false on error, true otherwise.
 // This is only suitable for clearing data when an app is uninstalled; if called on a UID with
 // running tasks it will cause time in state vs. concurrent time totals to be inconsistent for that
@@ -43,6 +43,23 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>>
     getUidsUpdatedConcurrentTimes(uint64_t *lastUpdate);
 bool clearUidTimes(unsigned int uid);
 
+// Times of several uids laid out contiguously, uid by uid, in the order of uids. The times of each
+// uid span every policy in turn, so a uid has as many entries in times as there are frequencies
+// across policies, and as many entries in active and policy as there are cpus.
+struct uid_cpu_freq_times_t {
+    std::vector<uint32_t> uids;
+    std::vector<uint64_t> times;
+};
+
+struct uid_concurrent_times_t {
+    std::vector<uint32_t> uids;
+    std::vector<uint64_t> active;
+    std::vector<uint64_t> policy;
+};
+
+bool getUidsUpdatedCpuFreqTimes(uint64_t *lastUpdate, uid_cpu_freq_times_t *out);
+bool getUidsUpdatedConcurrentTimes(uint64_t *lastUpdate, uid_concurrent_times_t *out);
+
 bool startTrackingProcessCpuTimes(pid_t pid);
 bool startAggregatingTaskCpuTimes(pid_t pid, uint16_t aggregationKey);
 std::optional<std::unordered_map<uint16_t, std::vector<std::vector<uint64_t>>>>
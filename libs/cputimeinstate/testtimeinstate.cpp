@@ -299,6 +299,66 @@ TEST(TimeInStateTest, AllUidUpdatedConcurrentTimes) {
     }
 }
 
+TEST(TimeInStateTest, AllUidUpdatedTimeInStateFlat) {
+    auto freqs = getCpuFreqs();
+    ASSERT_TRUE(freqs.has_value());
+    size_t freqCount = 0;
+    for (const auto &policyFreqs : *freqs) freqCount += policyFreqs.size();
+
+    uint64_t lastUpdate = 0;
+    uid_cpu_freq_times_t times1;
+    ASSERT_TRUE(getUidsUpdatedCpuFreqTimes(&lastUpdate, &times1));
+    ASSERT_FALSE(times1.uids.empty());
+    ASSERT_EQ(times1.uids.size() * freqCount, times1.times.size());
+    ASSERT_NE(lastUpdate, (uint64_t)0);
+
+    auto map = getUidsCpuFreqTimes();
+    ASSERT_TRUE(map.has_value());
+    for (size_t i = 0; i < times1.uids.size(); ++i) {
+        auto it = map->find(times1.uids[i]);
+        ASSERT_NE(it, map->end());
+        size_t j = i * freqCount;
+        for (const auto &policyTimes : it->second) {
+            for (const auto &time : policyTimes) ASSERT_LE(times1.times[j++], time);
+        }
+    }
+
+    // Sleep briefly to trigger a context switch, ensuring we see at least one update.
+    struct timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = 1000000;
+    nanosleep (&ts, NULL);
+
+    uint64_t oldLastUpdate = lastUpdate;
+    uid_cpu_freq_times_t times2;
+    ASSERT_TRUE(getUidsUpdatedCpuFreqTimes(&lastUpdate, &times2));
+    ASSERT_FALSE(times2.uids.empty());
+    ASSERT_LT(times2.uids.size(), times1.uids.size());
+    ASSERT_EQ(times2.uids.size() * freqCount, times2.times.size());
+    ASSERT_NE(lastUpdate, oldLastUpdate);
+}
+
+TEST(TimeInStateTest, AllUidUpdatedConcurrentTimesFlat) {
+    const uint32_t nCpus = get_nprocs_conf();
+    uint64_t lastUpdate = 0;
+    uid_concurrent_times_t times;
+    ASSERT_TRUE(getUidsUpdatedConcurrentTimes(&lastUpdate, &times));
+    ASSERT_FALSE(times.uids.empty());
+    ASSERT_EQ(times.uids.size() * nCpus, times.active.size());
+    ASSERT_EQ(times.uids.size() * nCpus, times.policy.size());
+    ASSERT_NE(lastUpdate, (uint64_t)0);
+
+    auto map = getUidsConcurrentTimes();
+    ASSERT_TRUE(map.has_value());
+    for (size_t i = 0; i < times.uids.size(); ++i) {
+        auto it = map->find(times.uids[i]);
+        ASSERT_NE(it, map->end());
+        for (uint32_t j = 0; j < it->second.active.size(); ++j) {
+            ASSERT_LE(times.active[i * nCpus + j], it->second.active[j]);
+        }
+    }
+}
+
 TEST(TimeInStateTest, SingleAndAllUidConcurrentTimesConsistent) {
     uint64_t zero = 0;
     auto maps = {getUidsConcurrentTimes(), getUidsUpdatedConcurrentTimes(&zero)};
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ftl/executor.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+namespace android::test {
+
+// Keep in sync with example usage in header file.
+TEST(Executor, Example) {
+  {
+    ftl::InlineExecutor executor;
+    int x = 0;
+    executor.execute([&x] { x = 42; });
+    EXPECT_EQ(x, 42);
+  }
+  {
+    std::atomic<int> x = 0;
+    {
+      ftl::SerialExecutor executor;
+      executor.execute([&x] { x = 42; });
+    }
+    EXPECT_EQ(x, 42);
+  }
+}
+
+TEST(Executor, Serial) {
+  std::vector<int> order;
+  std::atomic<bool> current = true;
+  {
+    ftl::SerialExecutor executor;
+    EXPECT_FALSE(executor.is_current());
+
+    for (int i = 0; i < 100; i++) {
+      executor.execute([&, i] {
+        order.push_back(i);
+        if (!executor.is_current()) current = false;
+      });
+    }
+  }
+
+  EXPECT_TRUE(current);
+  ASSERT_EQ(order.size(), 100u);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+}  // namespace android::test
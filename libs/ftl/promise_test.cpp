@@ -0,0 +1,133 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ftl/promise.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace android::test {
+
+// Keep in sync with example usage in header file.
+TEST(Promise, Example) {
+  {
+    ftl::Promise<int> promise;
+    ftl::Future<int> future = promise.get_future();
+    std::thread thread([promise]() mutable { promise.set_value(42); });
+
+    EXPECT_EQ(std::move(future).get(), 42);
+    thread.join();
+  }
+  {
+    ftl::SerialExecutor executor;
+
+    ftl::Promise<int> promise;
+    ftl::Future<std::string> future =
+        promise.get_future()
+            .then(executor, [](int x) { return x * 2; })
+            .then(executor, [](int x) { return std::to_string(x); });
+
+    promise.set_value(21);
+    EXPECT_EQ(std::move(future).get(), "42");
+  }
+}
+
+TEST(Promise, Ready) {
+  ftl::Promise<char> promise;
+  ftl::Future<char> future = promise.get_future();
+  EXPECT_TRUE(future.valid());
+  EXPECT_FALSE(future.ready());
+
+  promise.set_value('!');
+  EXPECT_TRUE(future.ready());
+
+  // A continuation attached to a ready future runs inline.
+  bool called = false;
+  auto chain = std::move(future).then([&called](char c) {
+    called = true;
+    return c;
+  });
+  EXPECT_FALSE(future.valid());
+  EXPECT_TRUE(called);
+  EXPECT_TRUE(chain.ready());
+  EXPECT_EQ(std::move(chain).get(), '!');
+}
+
+TEST(Promise, Void) {
+  ftl::InlineExecutor executor;
+
+  ftl::Promise<void> promise;
+  int x = 0;
+  ftl::Future<int> future = promise.get_future()
+                                .then(executor, [&x] { x = 1; })
+                                .then(executor, [&x] { return x + 1; });
+
+  EXPECT_EQ(x, 0);
+  promise.set_value();
+  EXPECT_EQ(x, 1);
+  EXPECT_EQ(std::move(future).get(), 2);
+}
+
+TEST(Promise, MoveOnly) {
+  ftl::Promise<std::unique_ptr<int>> promise;
+  auto future = promise.get_future().then([](std::unique_ptr<int> ptr) { return *ptr + 1; });
+
+  promise.set_value(std::make_unique<int>(41));
+  EXPECT_EQ(std::move(future).get(), 42);
+}
+
+TEST(Promise, Flatten) {
+  ftl::SerialExecutor first;
+  ftl::SerialExecutor second;
+
+  ftl::Promise<int> promise;
+  ftl::Promise<std::string> inner;
+  std::thread thread;
+
+  ftl::Future<std::size_t> future =
+      promise.get_future()
+          .then(first,
+                [inner, &thread](int x) {
+                  // The outer future is set once the inner future is.
+                  thread = std::thread([inner, x] { inner.set_value(std::string(x, '?')); });
+                  return inner.get_future();
+                })
+          .then(second, [&second](const std::string& str) {
+            EXPECT_TRUE(second.is_current());
+            return str.size();
+          });
+
+  promise.set_value(5);
+  EXPECT_EQ(std::move(future).get(), 5u);
+  thread.join();
+}
+
+TEST(Promise, Broken) {
+  std::weak_ptr<int> weak;
+  {
+    ftl::Promise<int> promise;
+    const auto ptr = std::make_shared<int>(0);
+    weak = ptr;
+
+    // The continuation is released along with the promise, although it was never set.
+    auto future = promise.get_future().then([ptr](int x) { return *ptr + x; });
+  }
+  EXPECT_TRUE(weak.expired());
+}
+
+}  // namespace android::test
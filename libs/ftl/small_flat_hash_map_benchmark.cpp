@@ -0,0 +1,96 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <ftl/small_flat_hash_map.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace android::test {
+namespace {
+
+// Keys spread like display IDs or layer handles, rather than consecutive integers.
+std::vector<std::uint64_t> make_keys(std::size_t count) {
+  std::vector<std::uint64_t> keys;
+  for (std::size_t i = 0; i < count; i++) {
+    keys.push_back((i + 1) * 0x1000193 + 0x4d00000000);
+  }
+  return keys;
+}
+
+template <typename Map>
+Map make_map(const std::vector<std::uint64_t>& keys) {
+  Map map;
+  for (const auto key : keys) {
+    map.try_emplace(key, static_cast<int>(key));
+  }
+  return map;
+}
+
+int find(const ftl::SmallFlatHashMap<std::uint64_t, int, 4>& map, std::uint64_t key) {
+  return map.find(key, [](int v) { return v; }).value_or(0);
+}
+
+int find(const std::unordered_map<std::uint64_t, int>& map, std::uint64_t key) {
+  const auto it = map.find(key);
+  return it == map.end() ? 0 : it->second;
+}
+
+// Looks up every key of a map of state.range(0) mappings, and as many missing keys.
+template <typename Map>
+void benchmark_find(benchmark::State& state) {
+  const auto keys = make_keys(static_cast<std::size_t>(state.range(0)) * 2);
+  const auto map = make_map<Map>({keys.begin(), keys.begin() + state.range(0)});
+
+  for (auto _ : state) {
+    for (const auto key : keys) {
+      benchmark::DoNotOptimize(find(map, key));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(keys.size()));
+}
+
+// Builds a map of state.range(0) mappings, then erases them.
+template <typename Map>
+void benchmark_insert_erase(benchmark::State& state) {
+  const auto keys = make_keys(static_cast<std::size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    auto map = make_map<Map>(keys);
+    for (const auto key : keys) {
+      map.erase(key);
+    }
+    benchmark::DoNotOptimize(map);
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(keys.size()));
+}
+
+using SmallFlatHashMap = ftl::SmallFlatHashMap<std::uint64_t, int, 4>;
+using UnorderedMap = std::unordered_map<std::uint64_t, int>;
+
+// Sizes from the number of displays to the number of layers.
+BENCHMARK_TEMPLATE(benchmark_find, SmallFlatHashMap)->RangeMultiplier(4)->Range(1, 256);
+BENCHMARK_TEMPLATE(benchmark_find, UnorderedMap)->RangeMultiplier(4)->Range(1, 256);
+
+BENCHMARK_TEMPLATE(benchmark_insert_erase, SmallFlatHashMap)->RangeMultiplier(4)->Range(1, 256);
+BENCHMARK_TEMPLATE(benchmark_insert_erase, UnorderedMap)->RangeMultiplier(4)->Range(1, 256);
+
+}  // namespace
+}  // namespace android::test
+
+BENCHMARK_MAIN();
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ftl/small_flat_hash_map.h>
+#include <gtest/gtest.h>
+
+#include <cctype>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+namespace android::test {
+
+using ftl::SmallFlatHashMap;
+
+// Keep in sync with example usage in header file.
+TEST(SmallFlatHashMap, Example) {
+  ftl::SmallFlatHashMap<int, char, 2> map = ftl::init::map(1, 'a')(2, 'b');
+  EXPECT_EQ(map.size(), 2u);
+  EXPECT_FALSE(map.dynamic());
+
+  const auto [it, ok] = map.try_emplace(3, 'c');
+  EXPECT_TRUE(ok);
+  EXPECT_EQ(it->second, 'c');
+  EXPECT_TRUE(map.dynamic());
+
+  EXPECT_FALSE(map.try_emplace(2, 'z').second);
+  EXPECT_EQ(map.find(2), 'b');
+
+  EXPECT_TRUE(map.erase(1));
+  EXPECT_FALSE(map.contains(1));
+  EXPECT_EQ(map, SmallFlatHashMap(ftl::init::map(2, 'b')(3, 'c')));
+}
+
+TEST(SmallFlatHashMap, Construct) {
+  {
+    // Default constructor.
+    SmallFlatHashMap<int, std::string, 2> map;
+
+    EXPECT_TRUE(map.empty());
+    EXPECT_FALSE(map.dynamic());
+  }
+  {
+    // In-place constructor with different types.
+    SmallFlatHashMap<int, std::string, 5> map =
+        ftl::init::map<int, std::string>(123, "abc")(-1)(42, 3u, '?');
+
+    EXPECT_EQ(map.size(), 3u);
+    EXPECT_EQ(map.max_size(), 5u);
+    EXPECT_FALSE(map.dynamic());
+
+    EXPECT_EQ(map, SmallFlatHashMap(ftl::init::map(42, "???")(123, "abc")(-1, "\0\0\0")));
+  }
+  {
+    // In-place constructor with implicit size.
+    SmallFlatHashMap map = ftl::init::map<int, std::string>(123, "abc")(-1)(42, 3u, '?');
+
+    static_assert(std::is_same_v<decltype(map), SmallFlatHashMap<int, std::string, 3>>);
+    EXPECT_EQ(map.size(), 3u);
+    EXPECT_EQ(map.max_size(), 3u);
+    EXPECT_FALSE(map.dynamic());
+  }
+}
+
+TEST(SmallFlatHashMap, Find) {
+  {
+    // Constant reference.
+    const ftl::SmallFlatHashMap map = ftl::init::map('a', 'A')('b', 'B')('c', 'C');
+
+    const auto opt = map.find('b');
+    EXPECT_EQ(opt, 'B');
+
+    const char d = 'D';
+    const auto ref = map.find('d').value_or(std::cref(d));
+    EXPECT_EQ(ref.get(), 'D');
+  }
+  {
+    // Mutable unary operation.
+    ftl::SmallFlatHashMap map = ftl::init::map('a', 'x')('b', 'y')('c', 'z');
+    EXPECT_TRUE(map.find('c', [](char& c) { c = std::toupper(c); }));
+
+    EXPECT_EQ(map, SmallFlatHashMap(ftl::init::map('c', 'Z')('b', 'y')('a', 'x')));
+  }
+}
+
+TEST(SmallFlatHashMap, TryEmplace) {
+  SmallFlatHashMap<int, std::string, 2> map;
+
+  for (int i = 0; i < 100; i++) {
+    const auto [it, ok] = map.try_emplace(i, 3u, static_cast<char>('a' + i % 26));
+    EXPECT_TRUE(ok);
+    EXPECT_EQ(it->first, i);
+  }
+  EXPECT_EQ(map.size(), 100u);
+  EXPECT_TRUE(map.dynamic());
+
+  // Existing values are not replaced.
+  const auto [it, ok] = map.try_emplace(27, "xyz");
+  EXPECT_FALSE(ok);
+  EXPECT_EQ(it->second, "bbb");
+
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(map.find(i, [](const std::string& s) { return s[0]; }), 'a' + i % 26);
+  }
+  EXPECT_FALSE(map.contains(100));
+  EXPECT_FALSE(map.contains(-1));
+}
+
+TEST(SmallFlatHashMap, Erase) {
+  {
+    // Static storage.
+    SmallFlatHashMap map = ftl::init::map(1, '1')(2, '2')(3, '3');
+
+    EXPECT_TRUE(map.erase(1));
+    EXPECT_FALSE(map.erase(1));
+    EXPECT_FALSE(map.dynamic());
+
+    EXPECT_EQ(map, SmallFlatHashMap(ftl::init::map(2, '2')(3, '3')));
+  }
+  {
+    // Dynamic storage.
+    SmallFlatHashMap<int, int, 4> map;
+    for (int i = 0; i < 64; i++) {
+      map.try_emplace(i, -i);
+    }
+
+    for (int i = 0; i < 64; i += 2) {
+      EXPECT_TRUE(map.erase(i));
+    }
+    EXPECT_EQ(map.size(), 32u);
+
+    for (int i = 0; i < 64; i++) {
+      EXPECT_EQ(map.contains(i), i % 2 == 1);
+    }
+    for (const auto& [k, v] : map) {
+      EXPECT_EQ(map.find(k), v);
+    }
+  }
+}
+
+TEST(SmallFlatHashMap, Random) {
+  // Churn through insertions and erasures, so that the table has deleted slots and is rehashed.
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> distribution(0, 300);
+
+  SmallFlatHashMap<int, int, 8> map;
+  std::unordered_map<int, int> reference;
+
+  for (int i = 0; i < 20000; i++) {
+    const int key = distribution(generator);
+    if (i % 3 == 0) {
+      EXPECT_EQ(map.erase(key), reference.erase(key) == 1);
+    } else {
+      EXPECT_EQ(map.try_emplace(key, i).second, reference.try_emplace(key, i).second);
+    }
+    ASSERT_EQ(map.size(), reference.size());
+  }
+
+  for (int key = 0; key <= 300; key++) {
+    const auto it = reference.find(key);
+    if (it == reference.end()) {
+      EXPECT_FALSE(map.contains(key));
+    } else {
+      EXPECT_EQ(map.find(key), it->second);
+    }
+  }
+}
+
+}  // namespace android::test
@@ -164,6 +164,7 @@ void GraphicsEnv::hintActivityLaunch() {
             mGpuStats.vkDriverToSend = false;
             sendGpuStatsLocked(GpuStatsInfo::Api::API_VK, true, mGpuStats.vkDriverLoadingTime);
         }
+        sendTargetStatsLocked();
     });
     trySendGpuStatsThread.detach();
 }
@@ -266,13 +267,24 @@ void GraphicsEnv::setTargetStats(const GpuStatsInfo::Stats stats, const uint64_t
     ATRACE_CALL();
 
     std::lock_guard<std::mutex> lock(mStatsLock);
-    if (!readyToSendGpuStatsLocked()) return;
+    const uint32_t statsBit = 1u << static_cast<uint32_t>(stats);
+    if (mTargetStatsSet & statsBit) return;
+    mTargetStatsSet |= statsBit;
+
+    // Until an activity is launched, keep the stats to send them along with the driver stats.
+    mPendingTargetStats.emplace_back(stats, value);
+    sendTargetStatsLocked();
+}
+
+void GraphicsEnv::sendTargetStatsLocked() {
+    if (mPendingTargetStats.empty() || !readyToSendGpuStatsLocked()) return;
 
     const sp<IGpuService> gpuService = getGpuService();
     if (gpuService) {
-        gpuService->setTargetStats(mGpuStats.appPackageName, mGpuStats.driverVersionCode, stats,
-                                   value);
+        gpuService->setTargetStatsArray(mGpuStats.appPackageName, mGpuStats.driverVersionCode,
+                                        mPendingTargetStats);
     }
+    mPendingTargetStats.clear();
 }
 
 void GraphicsEnv::sendGpuStatsLocked(GpuStatsInfo::Api api, bool isDriverLoaded,
@@ -547,6 +559,22 @@ void GraphicsEnv::setDebugLayersGLES(const std::string layers) {
     mDebugLayersGLES = layers;
 }
 
+void GraphicsEnv::setLayerCachePath(const std::string path) {
+    mLayerCachePath = path;
+}
+
+const std::string& GraphicsEnv::getLayerCachePath() {
+    return mLayerCachePath;
+}
+
+void GraphicsEnv::setSharedShaderCachePath(const std::string path) {
+    mSharedShaderCachePath = path;
+}
+
+const std::string& GraphicsEnv::getSharedShaderCachePath() {
+    return mSharedShaderCachePath;
+}
+
 // Return true if all the required libraries from vndk and sphal namespace are
 // linked to the updatable gfx driver namespace correctly.
 bool GraphicsEnv::linkDriverNamespaceLocked(android_namespace_t* vndkNamespace) {
@@ -61,6 +61,24 @@ public:
         remote()->transact(BnGpuService::SET_TARGET_STATS, data, &reply, IBinder::FLAG_ONEWAY);
     }
 
+    void setTargetStatsArray(
+            const std::string& appPackageName, const uint64_t driverVersionCode,
+            const std::vector<std::pair<GpuStatsInfo::Stats, uint64_t>>& stats) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGpuService::getInterfaceDescriptor());
+
+        data.writeUtf8AsUtf16(appPackageName);
+        data.writeUint64(driverVersionCode);
+        data.writeUint32(static_cast<uint32_t>(stats.size()));
+        for (const auto& [stat, value] : stats) {
+            data.writeInt32(static_cast<int32_t>(stat));
+            data.writeUint64(value);
+        }
+
+        remote()->transact(BnGpuService::SET_TARGET_STATS_ARRAY, data, &reply,
+                           IBinder::FLAG_ONEWAY);
+    }
+
     void setUpdatableDriverPath(const std::string& driverPath) override {
         Parcel data, reply;
         data.writeInterfaceToken(IGpuService::getInterfaceDescriptor());
@@ -147,6 +165,36 @@ status_t BnGpuService::onTransact(uint32_t code, const Parcel& data, Parcel* rep
 
             return OK;
         }
+        case SET_TARGET_STATS_ARRAY: {
+            CHECK_INTERFACE(IGpuService, data, reply);
+
+            std::string appPackageName;
+            if ((status = data.readUtf8FromUtf16(&appPackageName)) != OK) return status;
+
+            uint64_t driverVersionCode;
+            if ((status = data.readUint64(&driverVersionCode)) != OK) return status;
+
+            uint32_t count;
+            if ((status = data.readUint32(&count)) != OK) return status;
+            // Each entry takes at least 12 bytes of the parcel.
+            if (count > data.dataAvail() / 12) return BAD_VALUE;
+
+            std::vector<std::pair<GpuStatsInfo::Stats, uint64_t>> stats;
+            stats.reserve(count);
+            for (uint32_t i = 0; i < count; i++) {
+                int32_t stat;
+                if ((status = data.readInt32(&stat)) != OK) return status;
+
+                uint64_t value;
+                if ((status = data.readUint64(&value)) != OK) return status;
+
+                stats.emplace_back(static_cast<GpuStatsInfo::Stats>(stat), value);
+            }
+
+            setTargetStatsArray(appPackageName, driverVersionCode, stats);
+
+            return OK;
+        }
         case SET_UPDATABLE_DRIVER_PATH: {
             CHECK_INTERFACE(IGpuService, data, reply);
 
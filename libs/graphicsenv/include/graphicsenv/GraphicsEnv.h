@@ -123,6 +123,23 @@ public:
     const std::string& getDebugLayers();
     // Get the debug layers to load.
     const std::string& getDebugLayersGLES();
+    // Set the file where the Vulkan loader keeps the layers found in each
+    // layer library, so that unchanged libraries don't need to be loaded to
+    // enumerate their layers again.
+    void setLayerCachePath(const std::string path);
+    // Get the Vulkan layer cache file, empty if there is none.
+    const std::string& getLayerCachePath();
+
+    /*
+     * Apis for the shared shader cache
+     */
+    // Set the path of the read-only shader cache shared by all processes. It
+    // is populated by processes which use the same path as their own EGL
+    // cache file, e.g. RenderEngine and hwui prewarm runs, and then looked up
+    // by every process before its private cache.
+    void setSharedShaderCachePath(const std::string path);
+    // Get the path of the shared shader cache, empty if there is none.
+    const std::string& getSharedShaderCachePath();
 
 private:
     enum UseAngle { UNKNOWN, YES, NO };
@@ -139,6 +156,8 @@ private:
     bool readyToSendGpuStatsLocked();
     // Send the initial complete GpuStats to GpuService.
     void sendGpuStatsLocked(GpuStatsInfo::Api api, bool isDriverLoaded, int64_t driverLoadingTime);
+    // Send the pending target stats to GpuService in one call.
+    void sendTargetStatsLocked();
 
     GraphicsEnv() = default;
     // Path to updatable driver libs.
@@ -151,6 +170,11 @@ private:
     bool mActivityLaunched = false;
     // Information bookkept for GpuStats.
     GpuStatsInfo mGpuStats;
+    // Bitmask of the GpuStatsInfo::Stats already set. Target stats only flag the app, so each of
+    // them is sent at most once.
+    uint32_t mTargetStatsSet = 0;
+    // Target stats waiting to be sent, until this process is ready to send stats.
+    std::vector<std::pair<GpuStatsInfo::Stats, uint64_t>> mPendingTargetStats;
     // Path to ANGLE libs.
     std::string mAnglePath;
     // This App's name.
@@ -169,6 +193,10 @@ private:
     std::string mDebugLayersGLES;
     // Additional debug layers search path.
     std::string mLayerPaths;
+    // Vulkan layer cache file.
+    std::string mLayerCachePath;
+    // Path to the shared shader cache.
+    std::string mSharedShaderCachePath;
     // This mutex protects the namespace creation.
     std::mutex mNamespaceMutex;
     // Updatable driver namespace.
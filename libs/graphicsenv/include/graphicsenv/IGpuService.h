@@ -43,6 +43,11 @@ public:
     virtual void setTargetStats(const std::string& appPackageName, const uint64_t driverVersionCode,
                                 const GpuStatsInfo::Stats stats, const uint64_t value = 0) = 0;
 
+    // set several target stats at once.
+    virtual void setTargetStatsArray(
+            const std::string& appPackageName, const uint64_t driverVersionCode,
+            const std::vector<std::pair<GpuStatsInfo::Stats, uint64_t>>& stats) = 0;
+
     // setter and getter for updatable driver path.
     virtual void setUpdatableDriverPath(const std::string& driverPath) = 0;
     virtual std::string getUpdatableDriverPath() = 0;
@@ -55,6 +60,7 @@ public:
         SET_TARGET_STATS,
         SET_UPDATABLE_DRIVER_PATH,
         GET_UPDATABLE_DRIVER_PATH,
+        SET_TARGET_STATS_ARRAY,
         // Always append new enum to the end.
     };
 
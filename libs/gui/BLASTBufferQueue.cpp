@@ -27,6 +27,7 @@
 #include <gui/BufferQueueProducer.h>
 #include <gui/GLConsumer.h>
 #include <gui/IProducerListener.h>
+#include <gui/JankInfo.h>
 #include <gui/Surface.h>
 #include <utils/Singleton.h>
 #include <string.h>
@@ -87,6 +88,19 @@ void BLASTBufferItemConsumer::addAndGetFrameTimestamps(const NewFrameEventsEntry
     }
 }
 
+status_t BLASTBufferItemConsumer::getFrameTimestampRing(base::unique_fd* outFd) {
+    Mutex::Autolock lock(mMutex);
+    // Like a request for deltas, this turns event processing on.
+    mPreviouslyConnected = mCurrentlyConnected;
+    mCurrentlyConnected = true;
+    std::shared_ptr<FrameTimestampRing> ring = mFrameEventHistory.getTimestampRing();
+    if (ring == nullptr) {
+        return NO_MEMORY;
+    }
+    *outFd = ring->getFd();
+    return outFd->ok() ? NO_ERROR : NO_MEMORY;
+}
+
 void BLASTBufferItemConsumer::updateFrameTimestamps(uint64_t frameNumber, nsecs_t refreshStartTime,
                                                     const sp<Fence>& glDoneFence,
                                                     const sp<Fence>& presentFence,
@@ -277,6 +291,7 @@ void BLASTBufferQueue::transactionCallback(nsecs_t /*latchTime*/, const sp<Fence
                                            const std::vector<SurfaceControlStats>& stats) {
     std::function<void(int64_t)> transactionCompleteCallback = nullptr;
     uint64_t currFrameNumber = 0;
+    int32_t newMaxDequeuedBufferCount = 0;
 
     {
         std::unique_lock _lock{mMutex};
@@ -308,6 +323,7 @@ void BLASTBufferQueue::transactionCallback(nsecs_t /*latchTime*/, const sp<Fence
                                                     stat.frameEventStats.dequeueReadyTime);
                 }
                 currFrameNumber = stat.frameEventStats.frameNumber;
+                newMaxDequeuedBufferCount = updateAdaptiveBufferCountLocked(stat.jankData);
 
                 if (mTransactionCompleteCallback &&
                     currFrameNumber >= mTransactionCompleteFrameNumber) {
@@ -335,6 +351,10 @@ void BLASTBufferQueue::transactionCallback(nsecs_t /*latchTime*/, const sp<Fence
         decStrong((void*)transactionCallbackThunk);
     }
 
+    if (newMaxDequeuedBufferCount > 0) {
+        applyMaxDequeuedBufferCount(newMaxDequeuedBufferCount);
+    }
+
     if (transactionCompleteCallback) {
         transactionCompleteCallback(currFrameNumber);
     }
@@ -650,6 +670,73 @@ bool BLASTBufferQueue::maxBuffersAcquired(bool includeExtraAcquire) const {
     return mNumAcquired == maxAcquiredBuffers;
 }
 
+void BLASTBufferQueue::setAdaptiveBufferCountEnabled(bool enabled) {
+    {
+        std::unique_lock _lock{mMutex};
+        mAdaptiveBufferCount = enabled;
+        mJankWindowFrames = 0;
+        mJankWindowMisses = 0;
+        mCleanJankWindows = 0;
+    }
+    // Start with headroom, and only shrink once the app has shown it keeps up
+    if (enabled) {
+        applyMaxDequeuedBufferCount(kAdaptiveMaxDequeuedBuffers);
+    }
+}
+
+int32_t BLASTBufferQueue::updateAdaptiveBufferCountLocked(const std::vector<JankData>& jankData) {
+    if (!mAdaptiveBufferCount) {
+        return 0;
+    }
+
+    for (const auto& data : jankData) {
+        mJankWindowFrames++;
+        if (data.jankType & JankType::AppDeadlineMissed) {
+            mJankWindowMisses++;
+        }
+    }
+
+    if (mJankWindowMisses >= kAdaptiveGrowMisses) {
+        mJankWindowFrames = 0;
+        mJankWindowMisses = 0;
+        mCleanJankWindows = 0;
+        return mMaxDequeuedBufferCount < kAdaptiveMaxDequeuedBuffers ? kAdaptiveMaxDequeuedBuffers
+                                                                      : 0;
+    }
+    if (mJankWindowFrames < kAdaptiveWindowFrames) {
+        return 0;
+    }
+
+    mCleanJankWindows = mJankWindowMisses == 0 ? mCleanJankWindows + 1 : 0;
+    mJankWindowFrames = 0;
+    mJankWindowMisses = 0;
+    if (mCleanJankWindows >= kAdaptiveShrinkWindows &&
+        mMaxDequeuedBufferCount > kAdaptiveMinDequeuedBuffers) {
+        mCleanJankWindows = 0;
+        return kAdaptiveMinDequeuedBuffers;
+    }
+    return 0;
+}
+
+void BLASTBufferQueue::applyMaxDequeuedBufferCount(int32_t count) {
+    ATRACE_CALL();
+    // This can't be called with mMutex held, the producer may call back into the consumer.
+    status_t err = mProducer->setMaxDequeuedBufferCount(count);
+
+    std::unique_lock _lock{mMutex};
+    if (err != OK) {
+        BQA_LOGV("setMaxDequeuedBufferCount(%d) failed: %d", count, err);
+        if (count < mMaxDequeuedBufferCount) {
+            // Most likely more buffers are dequeued than we want to shrink to. Try again after
+            // the next clean window.
+            mCleanJankWindows = kAdaptiveShrinkWindows - 1;
+        }
+        return;
+    }
+    BQA_LOGV("max dequeued buffer count %d -> %d", mMaxDequeuedBufferCount, count);
+    mMaxDequeuedBufferCount = count;
+}
+
 class BBQSurface : public Surface {
 private:
     sp<BLASTBufferQueue> mBbq;
@@ -21,8 +21,11 @@
 #include <sys/types.h>
 
 #include <fcntl.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <utils/Errors.h>
 
 #include <binder/Parcel.h>
@@ -114,6 +117,37 @@ ssize_t BitTube::read(void* vaddr, size_t size) {
     return err == 0 ? len : -err;
 }
 
+ssize_t BitTube::readMessages(void* vaddr, size_t messageSize, size_t messageCount,
+                              size_t* outSizes) {
+    messageCount = std::min(messageCount, MAX_MESSAGES_PER_READ);
+
+    iovec iovs[MAX_MESSAGES_PER_READ];
+    mmsghdr messages[MAX_MESSAGES_PER_READ] = {};
+    for (size_t i = 0; i < messageCount; i++) {
+        iovs[i].iov_base = static_cast<char*>(vaddr) + i * messageSize;
+        iovs[i].iov_len = messageSize;
+        messages[i].msg_hdr.msg_iov = &iovs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int err, count;
+    do {
+        count = ::recvmmsg(mReceiveFd, messages, messageCount, MSG_DONTWAIT, nullptr);
+        err = count < 0 ? errno : 0;
+    } while (err == EINTR);
+    if (err == EAGAIN || err == EWOULDBLOCK) {
+        return 0;
+    }
+    if (err != 0) {
+        return -err;
+    }
+
+    for (int i = 0; i < count; i++) {
+        outSizes[i] = messages[i].msg_len;
+    }
+    return count;
+}
+
 status_t BitTube::writeToParcel(Parcel* reply) const {
     if (mReceiveFd < 0) return -EINVAL;
 
@@ -173,5 +207,20 @@ ssize_t BitTube::recvObjects(BitTube* tube, void* events, size_t count, size_t o
     return size < 0 ? size : size / static_cast<ssize_t>(objSize);
 }
 
+ssize_t BitTube::recvObjectMessages(BitTube* tube, void* events, size_t objectsPerMessage,
+                                    size_t messageCount, size_t* outCounts, size_t objSize) {
+    ssize_t count = tube->readMessages(events, objectsPerMessage * objSize, messageCount, outCounts);
+
+    for (ssize_t i = 0; i < count; i++) {
+        // should never happen because of SOCK_SEQPACKET
+        LOG_ALWAYS_FATAL_IF(outCounts[i] % objSize,
+                            "BitTube::recvObjectMessages(size=%zu), message size=%zu (partial "
+                            "events were received!)",
+                            objSize, outCounts[i]);
+        outCounts[i] /= objSize;
+    }
+    return count;
+}
+
 } // namespace gui
 } // namespace android
@@ -103,6 +103,14 @@ void BufferQueue::ProxyConsumerListener::addAndGetFrameTimestamps(
     }
 }
 
+status_t BufferQueue::ProxyConsumerListener::getFrameTimestampRing(base::unique_fd* outFd) {
+    sp<ConsumerListener> listener(mConsumerListener.promote());
+    if (listener != nullptr) {
+        return listener->getFrameTimestampRing(outFd);
+    }
+    return NO_INIT;
+}
+
 void BufferQueue::createBufferQueue(sp<IGraphicBufferProducer>* outProducer,
         sp<IGraphicBufferConsumer>* outConsumer,
         bool consumerIsSurfaceFlinger) {
@@ -31,6 +31,7 @@
 #include <gui/BufferItem.h>
 #include <gui/BufferQueueConsumer.h>
 #include <gui/BufferQueueCore.h>
+#include <gui/BufferQueueProducer.h>
 #include <gui/IConsumerListener.h>
 #include <gui/IProducerListener.h>
 
@@ -282,6 +283,15 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
                 mSlots[slot].mBufferState.acquire();
             }
             mSlots[slot].mFence = Fence::NO_FENCE;
+
+            mSlots[slot].mAcquireTime = systemTime();
+#ifndef NO_BINDER
+            if (outBuffer->mQueuedBuffer) {
+                mCore->mOccupancyTracker.registerLatency(
+                        OccupancyTracker::Latency::QueueToAcquire,
+                        mSlots[slot].mAcquireTime - mSlots[slot].mQueueTime);
+            }
+#endif
         }
 
         // If the buffer has previously been acquired by the consumer, set
@@ -417,6 +427,7 @@ status_t BufferQueueConsumer::attachBuffer(int* outSlot,
     mSlots[*outSlot].mNeedsReallocation = true;
     mSlots[*outSlot].mFence = Fence::NO_FENCE;
     mSlots[*outSlot].mFrameNumber = 0;
+    mSlots[*outSlot].mAcquireTime = systemTime();
 
     // mAcquireCalled tells BufferQueue that it doesn't need to send a valid
     // GraphicBuffer pointer on the next acquireBuffer call, which decreases
@@ -478,6 +489,10 @@ status_t BufferQueueConsumer::releaseBuffer(int slot, uint64_t frameNumber,
         mSlots[slot].mEglFence = eglFence;
         mSlots[slot].mFence = releaseFence;
         mSlots[slot].mBufferState.release();
+#ifndef NO_BINDER
+        mCore->mOccupancyTracker.registerLatency(OccupancyTracker::Latency::AcquireToRelease,
+                                                 systemTime() - mSlots[slot].mAcquireTime);
+#endif
 
         // After leaving shared buffer mode, the shared buffer will
         // still be around. Mark it as no longer shared if this
@@ -604,9 +619,18 @@ status_t BufferQueueConsumer::setDefaultBufferSize(uint32_t width,
 
     BQ_LOGV("setDefaultBufferSize: width=%u height=%u", width, height);
 
-    std::lock_guard<std::mutex> lock(mCore->mMutex);
-    mCore->mDefaultWidth = width;
-    mCore->mDefaultHeight = height;
+    sp<BufferQueueProducer> preallocatingProducer;
+    {
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        if (mCore->mDefaultWidth != width || mCore->mDefaultHeight != height) {
+            preallocatingProducer = mCore->schedulePreallocationLocked();
+        }
+        mCore->mDefaultWidth = width;
+        mCore->mDefaultHeight = height;
+    }
+    if (preallocatingProducer != nullptr) {
+        preallocatingProducer->preallocateBuffersAsync();
+    }
     return NO_ERROR;
 }
 
@@ -728,8 +752,17 @@ status_t BufferQueueConsumer::setConsumerName(const String8& name) {
 status_t BufferQueueConsumer::setDefaultBufferFormat(PixelFormat defaultFormat) {
     ATRACE_CALL();
     BQ_LOGV("setDefaultBufferFormat: %u", defaultFormat);
-    std::lock_guard<std::mutex> lock(mCore->mMutex);
-    mCore->mDefaultBufferFormat = defaultFormat;
+    sp<BufferQueueProducer> preallocatingProducer;
+    {
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        if (mCore->mDefaultBufferFormat != defaultFormat) {
+            preallocatingProducer = mCore->schedulePreallocationLocked();
+        }
+        mCore->mDefaultBufferFormat = defaultFormat;
+    }
+    if (preallocatingProducer != nullptr) {
+        preallocatingProducer->preallocateBuffersAsync();
+    }
     return NO_ERROR;
 }
 
@@ -745,8 +778,17 @@ status_t BufferQueueConsumer::setDefaultBufferDataSpace(
 status_t BufferQueueConsumer::setConsumerUsageBits(uint64_t usage) {
     ATRACE_CALL();
     BQ_LOGV("setConsumerUsageBits: %#" PRIx64, usage);
-    std::lock_guard<std::mutex> lock(mCore->mMutex);
-    mCore->mConsumerUsageBits = usage;
+    sp<BufferQueueProducer> preallocatingProducer;
+    {
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        if (mCore->mConsumerUsageBits != usage) {
+            preallocatingProducer = mCore->schedulePreallocationLocked();
+        }
+        mCore->mConsumerUsageBits = usage;
+    }
+    if (preallocatingProducer != nullptr) {
+        preallocatingProducer->preallocateBuffersAsync();
+    }
     return NO_ERROR;
 }
 
@@ -32,6 +32,7 @@
 
 #include <gui/BufferItem.h>
 #include <gui/BufferQueueCore.h>
+#include <gui/BufferQueueProducer.h>
 #include <gui/IConsumerListener.h>
 #include <gui/IProducerListener.h>
 #include <gui/ISurfaceComposer.h>
@@ -220,6 +221,10 @@ void BufferQueueCore::dumpState(const String8& prefix, String8* outResult) const
         outResult->appendFormat("%s  [%02d:%p] state=%-8s\n", prefix.string(), s, buffer.get(),
                                 mSlots[s].mBufferState.string());
     }
+
+#ifndef NO_BINDER
+    mOccupancyTracker.dumpLatencies(prefix, outResult);
+#endif
 }
 
 int BufferQueueCore::getMinUndequeuedBufferCountLocked() const {
@@ -277,6 +282,20 @@ void BufferQueueCore::clearBufferSlotLocked(int slot) {
     }
 }
 
+sp<BufferQueueProducer> BufferQueueCore::schedulePreallocationLocked() {
+    if (!mPreallocationEnabled || mIsAbandoned) {
+        return nullptr;
+    }
+    mPreallocationGeneration++;
+    if (mPreallocationPending) {
+        // The running pass will notice the new generation and go around again
+        return nullptr;
+    }
+    sp<BufferQueueProducer> producer = mPreallocatingProducer.promote();
+    mPreallocationPending = producer != nullptr;
+    return producer;
+}
+
 void BufferQueueCore::freeAllBuffersLocked() {
     for (int s : mFreeSlots) {
         clearBufferSlotLocked(s);
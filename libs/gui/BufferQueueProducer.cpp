@@ -42,6 +42,9 @@
 
 #include <system/window.h>
 
+#include <optional>
+#include <thread>
+
 namespace android {
 
 // Macros for include BufferQueueCore information in log messages
@@ -409,8 +412,16 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
     EGLSyncKHR eglFence = EGL_NO_SYNC_KHR;
     bool attachedByConsumer = false;
 
+    sp<IConsumerListener> dequeuedListener;
+    uint64_t dequeuedBufferId = 0;
+    int callbackTicket = 0;
+    uint64_t hotPathAllocationCount = 0;
+
     { // Autolock scope
         std::unique_lock<std::mutex> lock(mCore->mMutex);
+#ifndef NO_BINDER
+        const nsecs_t dequeueStartTime = systemTime();
+#endif
 
         // If we don't have a free buffer, but we are currently allocating, we wait until allocation
         // is finished such that we don't allocate in parallel.
@@ -470,6 +481,10 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
                 }
             }
         }
+#ifndef NO_BINDER
+        mCore->mOccupancyTracker.registerLatency(OccupancyTracker::Latency::DequeueWait,
+                                                 systemTime() - dequeueStartTime);
+#endif
 
         const sp<GraphicBuffer>& buffer(mSlots[found].mGraphicBuffer);
         if (mCore->mSharedBufferSlot == found &&
@@ -539,7 +554,9 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
 
         if (!(returnFlags & BUFFER_NEEDS_REALLOCATION)) {
             if (mCore->mConsumerListener != nullptr) {
-                mCore->mConsumerListener->onFrameDequeued(mSlots[*outSlot].mGraphicBuffer->getId());
+                dequeuedListener = mCore->mConsumerListener;
+                dequeuedBufferId = mSlots[*outSlot].mGraphicBuffer->getId();
+                callbackTicket = mNextCallbackTicket++;
             }
         }
     } // Autolock scope
@@ -559,11 +576,16 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
                 graphicBuffer->setGenerationNumber(mCore->mGenerationNumber);
                 mSlots[*outSlot].mGraphicBuffer = graphicBuffer;
                 if (mCore->mConsumerListener != nullptr) {
-                    mCore->mConsumerListener->onFrameDequeued(
-                            mSlots[*outSlot].mGraphicBuffer->getId());
+                    dequeuedListener = mCore->mConsumerListener;
+                    dequeuedBufferId = graphicBuffer->getId();
+                    callbackTicket = mNextCallbackTicket++;
                 }
             }
 
+            if (error == NO_ERROR) {
+                hotPathAllocationCount = ++mCore->mHotPathAllocationCount;
+            }
+
             mCore->mIsAllocating = false;
             mCore->mIsAllocatingCondition.notify_all();
 
@@ -583,6 +605,16 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
 
             VALIDATE_CONSISTENCY();
         } // Autolock scope
+
+        if (ATRACE_ENABLED()) {
+            ATRACE_INT(String8::format("%s hot-path allocations", mConsumerName.string()).string(),
+                       static_cast<int32_t>(hotPathAllocationCount));
+        }
+    }
+
+    if (dequeuedListener != nullptr) {
+        callbackInOrder(callbackTicket,
+                        [&] { dequeuedListener->onFrameDequeued(dequeuedBufferId); });
     }
 
     if (attachedByConsumer) {
@@ -623,6 +655,8 @@ status_t BufferQueueProducer::detachBuffer(int slot) {
     BQ_LOGV("detachBuffer: slot %d", slot);
 
     sp<IConsumerListener> listener;
+    std::optional<uint64_t> detachedBufferId;
+    int callbackTicket = 0;
     {
         std::lock_guard<std::mutex> lock(mCore->mMutex);
 
@@ -658,7 +692,8 @@ status_t BufferQueueProducer::detachBuffer(int slot) {
         listener = mCore->mConsumerListener;
         auto gb = mSlots[slot].mGraphicBuffer;
         if (listener != nullptr && gb != nullptr) {
-            listener->onFrameDetached(gb->getId());
+            detachedBufferId = gb->getId();
+            callbackTicket = mNextCallbackTicket++;
         }
         mSlots[slot].mBufferState.detachProducer();
         mCore->mActiveBuffers.erase(slot);
@@ -668,6 +703,9 @@ status_t BufferQueueProducer::detachBuffer(int slot) {
         VALIDATE_CONSISTENCY();
     }
 
+    if (detachedBufferId) {
+        callbackInOrder(callbackTicket, [&] { listener->onFrameDetached(*detachedBufferId); });
+    }
     if (listener != nullptr) {
         listener->onBuffersReleased();
     }
@@ -904,6 +942,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
 
         mSlots[slot].mFence = acquireFence;
         mSlots[slot].mBufferState.queue();
+        mSlots[slot].mQueueTime = systemTime();
 
         // Increment the frame counter and store a local version of it
         // for use outside the lock on mCore->mMutex.
@@ -1005,6 +1044,8 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         output->transformHint = mCore->mTransformHintInUse = mCore->mTransformHint;
         output->numPendingBuffers = static_cast<uint32_t>(mCore->mQueue.size());
         output->nextFrameNumber = mCore->mFrameCounter + 1;
+        output->consumerUsageBits = mCore->mConsumerUsageBits;
+        output->hasConsumerUsageBits = true;
 
         ATRACE_INT(mCore->mConsumerName.string(),
                 static_cast<int32_t>(mCore->mQueue.size()));
@@ -1075,60 +1116,85 @@ status_t BufferQueueProducer::queueBuffer(int slot,
     return NO_ERROR;
 }
 
+void BufferQueueProducer::callbackInOrder(int callbackTicket,
+                                          const std::function<void()>& callback) {
+    std::unique_lock<std::mutex> lock(mCallbackMutex);
+    while (callbackTicket != mCurrentCallbackTicket) {
+        mCallbackCondition.wait(lock);
+    }
+
+    callback();
+
+    ++mCurrentCallbackTicket;
+    mCallbackCondition.notify_all();
+}
+
 status_t BufferQueueProducer::cancelBuffer(int slot, const sp<Fence>& fence) {
     ATRACE_CALL();
     BQ_LOGV("cancelBuffer: slot %d", slot);
-    std::lock_guard<std::mutex> lock(mCore->mMutex);
 
-    if (mCore->mIsAbandoned) {
-        BQ_LOGE("cancelBuffer: BufferQueue has been abandoned");
-        return NO_INIT;
-    }
+    sp<IConsumerListener> listener;
+    uint64_t bufferId = 0;
+    int callbackTicket = 0;
+    { // Autolock scope
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
 
-    if (mCore->mConnectedApi == BufferQueueCore::NO_CONNECTED_API) {
-        BQ_LOGE("cancelBuffer: BufferQueue has no connected producer");
-        return NO_INIT;
-    }
+        if (mCore->mIsAbandoned) {
+            BQ_LOGE("cancelBuffer: BufferQueue has been abandoned");
+            return NO_INIT;
+        }
 
-    if (mCore->mSharedBufferMode) {
-        BQ_LOGE("cancelBuffer: cannot cancel a buffer in shared buffer mode");
-        return BAD_VALUE;
-    }
+        if (mCore->mConnectedApi == BufferQueueCore::NO_CONNECTED_API) {
+            BQ_LOGE("cancelBuffer: BufferQueue has no connected producer");
+            return NO_INIT;
+        }
 
-    if (slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS) {
-        BQ_LOGE("cancelBuffer: slot index %d out of range [0, %d)",
-                slot, BufferQueueDefs::NUM_BUFFER_SLOTS);
-        return BAD_VALUE;
-    } else if (!mSlots[slot].mBufferState.isDequeued()) {
-        BQ_LOGE("cancelBuffer: slot %d is not owned by the producer "
-                "(state = %s)", slot, mSlots[slot].mBufferState.string());
-        return BAD_VALUE;
-    } else if (fence == nullptr) {
-        BQ_LOGE("cancelBuffer: fence is NULL");
-        return BAD_VALUE;
-    }
+        if (mCore->mSharedBufferMode) {
+            BQ_LOGE("cancelBuffer: cannot cancel a buffer in shared buffer mode");
+            return BAD_VALUE;
+        }
 
-    mSlots[slot].mBufferState.cancel();
+        if (slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS) {
+            BQ_LOGE("cancelBuffer: slot index %d out of range [0, %d)",
+                    slot, BufferQueueDefs::NUM_BUFFER_SLOTS);
+            return BAD_VALUE;
+        } else if (!mSlots[slot].mBufferState.isDequeued()) {
+            BQ_LOGE("cancelBuffer: slot %d is not owned by the producer "
+                    "(state = %s)", slot, mSlots[slot].mBufferState.string());
+            return BAD_VALUE;
+        } else if (fence == nullptr) {
+            BQ_LOGE("cancelBuffer: fence is NULL");
+            return BAD_VALUE;
+        }
 
-    // After leaving shared buffer mode, the shared buffer will still be around.
-    // Mark it as no longer shared if this operation causes it to be free.
-    if (!mCore->mSharedBufferMode && mSlots[slot].mBufferState.isFree()) {
-        mSlots[slot].mBufferState.mShared = false;
-    }
+        mSlots[slot].mBufferState.cancel();
 
-    // Don't put the shared buffer on the free list.
-    if (!mSlots[slot].mBufferState.isShared()) {
-        mCore->mActiveBuffers.erase(slot);
-        mCore->mFreeBuffers.push_back(slot);
-    }
+        // After leaving shared buffer mode, the shared buffer will still be around.
+        // Mark it as no longer shared if this operation causes it to be free.
+        if (!mCore->mSharedBufferMode && mSlots[slot].mBufferState.isFree()) {
+            mSlots[slot].mBufferState.mShared = false;
+        }
+
+        // Don't put the shared buffer on the free list.
+        if (!mSlots[slot].mBufferState.isShared()) {
+            mCore->mActiveBuffers.erase(slot);
+            mCore->mFreeBuffers.push_back(slot);
+        }
 
-    auto gb = mSlots[slot].mGraphicBuffer;
-    if (mCore->mConsumerListener != nullptr && gb != nullptr) {
-        mCore->mConsumerListener->onFrameCancelled(gb->getId());
+        auto gb = mSlots[slot].mGraphicBuffer;
+        if (mCore->mConsumerListener != nullptr && gb != nullptr) {
+            listener = mCore->mConsumerListener;
+            bufferId = gb->getId();
+            callbackTicket = mNextCallbackTicket++;
+        }
+        mSlots[slot].mFence = fence;
+        mCore->mDequeueCondition.notify_all();
+        VALIDATE_CONSISTENCY();
+    } // Autolock scope
+
+    if (listener != nullptr) {
+        callbackInOrder(callbackTicket, [&] { listener->onFrameCancelled(bufferId); });
     }
-    mSlots[slot].mFence = fence;
-    mCore->mDequeueCondition.notify_all();
-    VALIDATE_CONSISTENCY();
 
     return NO_ERROR;
 }
@@ -1253,6 +1319,8 @@ status_t BufferQueueProducer::connect(const sp<IProducerListener>& listener,
             output->nextFrameNumber = mCore->mFrameCounter + 1;
             output->bufferReplaced = false;
             output->maxBufferCount = mCore->mMaxBufferCount;
+            output->consumerUsageBits = mCore->mConsumerUsageBits;
+            output->hasConsumerUsageBits = true;
 
             if (listener != nullptr) {
                 // Set up a death notification so that we can disconnect
@@ -1356,6 +1424,7 @@ status_t BufferQueueProducer::disconnect(int api, DisconnectMode mode) {
                     mCore->mSidebandStream.clear();
                     mCore->mDequeueCondition.notify_all();
                     mCore->mAutoPrerotation = false;
+                    mCore->mPreallocationEnabled = false;
                     listener = mCore->mConsumerListener;
                 } else if (mCore->mConnectedApi == BufferQueueCore::NO_CONNECTED_API) {
                     BQ_LOGE("disconnect: not connected (req=%d)", api);
@@ -1418,6 +1487,13 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 return;
             }
 
+            mCore->mPreallocationEnabled = true;
+            mCore->mPreallocWidth = width;
+            mCore->mPreallocHeight = height;
+            mCore->mPreallocFormat = format;
+            mCore->mPreallocUsage = usage;
+            mCore->mPreallocatingProducer = this;
+
             // Only allocate one buffer at a time to reduce risks of overlapping an allocation from
             // both allocateBuffers and dequeueBuffer.
             newBufferCount = mCore->mFreeSlots.empty() ? 0 : 1;
@@ -1515,6 +1591,76 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
     }
 }
 
+void BufferQueueProducer::preallocateBuffersAsync() {
+    sp<BufferQueueProducer> self = this;
+    std::thread([self] { self->preallocateBuffers(); }).detach();
+}
+
+void BufferQueueProducer::preallocateBuffers() {
+    ATRACE_CALL();
+
+    while (true) {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        PixelFormat format = PIXEL_FORMAT_UNKNOWN;
+        uint64_t usage = 0;
+        uint64_t generation = 0;
+        { // Autolock scope
+            std::unique_lock<std::mutex> lock(mCore->mMutex);
+            mCore->waitWhileAllocatingLocked(lock);
+
+            if (!mCore->mPreallocationEnabled || mCore->mIsAbandoned ||
+                !mCore->mAllowAllocation || mCore->mSharedBufferMode) {
+                mCore->mPreallocationPending = false;
+                return;
+            }
+            generation = mCore->mPreallocationGeneration;
+
+            width = mCore->mPreallocWidth;
+            height = mCore->mPreallocHeight;
+            format = mCore->mPreallocFormat;
+            usage = mCore->mPreallocUsage;
+
+            // Mirror the parameters allocateBuffers and dequeueBuffer use
+            uint32_t allocWidth = width > 0 ? width : mCore->mDefaultWidth;
+            uint32_t allocHeight = height > 0 ? height : mCore->mDefaultHeight;
+            if (!width && !height && mCore->mAutoPrerotation &&
+                (mCore->mTransformHintInUse & NATIVE_WINDOW_TRANSFORM_ROT_90)) {
+                std::swap(allocWidth, allocHeight);
+            }
+            PixelFormat allocFormat = format != 0 ? format : mCore->mDefaultBufferFormat;
+            uint64_t allocUsage = usage | mCore->mConsumerUsageBits;
+
+            // Free buffers which no longer match would be reallocated by the
+            // next dequeueBuffer that picks them, so release them now and let
+            // allocateBuffers fill their slots instead.
+            for (auto slot = mCore->mFreeBuffers.begin(); slot != mCore->mFreeBuffers.end();) {
+                const sp<GraphicBuffer>& buffer(mSlots[*slot].mGraphicBuffer);
+                if (buffer != nullptr &&
+                    buffer->needsReallocation(allocWidth, allocHeight, allocFormat,
+                                              BQ_LAYER_COUNT, allocUsage)) {
+                    BQ_LOGV("preallocateBuffers: releasing stale buffer in slot %d", *slot);
+                    mCore->clearBufferSlotLocked(*slot);
+                    mCore->mFreeSlots.insert(*slot);
+                    slot = mCore->mFreeBuffers.erase(slot);
+                } else {
+                    ++slot;
+                }
+            }
+            VALIDATE_CONSISTENCY();
+        } // Autolock scope
+
+        allocateBuffers(width, height, format, usage);
+
+        // Go around again if the defaults changed while this pass ran
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        if (mCore->mPreallocationGeneration == generation) {
+            mCore->mPreallocationPending = false;
+            return;
+        }
+    }
+}
+
 status_t BufferQueueProducer::allowAllocation(bool allow) {
     ATRACE_CALL();
     BQ_LOGV("allowAllocation: %s", allow ? "true" : "false");
@@ -1646,6 +1792,29 @@ void BufferQueueProducer::getFrameTimestamps(FrameEventHistoryDelta* outDelta) {
     addAndGetFrameTimestamps(nullptr, outDelta);
 }
 
+status_t BufferQueueProducer::getFrameTimestampRing(base::unique_fd* outFd) {
+    ATRACE_CALL();
+    BQ_LOGV("getFrameTimestampRing");
+    if (outFd == nullptr) {
+        BQ_LOGE("getFrameTimestampRing: outFd must not be NULL");
+        return BAD_VALUE;
+    }
+
+    sp<IConsumerListener> listener;
+    {
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        if (mCore->mIsAbandoned) {
+            BQ_LOGE("getFrameTimestampRing: BufferQueue has been abandoned");
+            return NO_INIT;
+        }
+        listener = mCore->mConsumerListener;
+    }
+    if (listener == nullptr) {
+        return NO_INIT;
+    }
+    return listener->getFrameTimestampRing(outFd);
+}
+
 void BufferQueueProducer::addAndGetFrameTimestamps(
         const NewFrameEventsEntry* newTimestamps,
         FrameEventHistoryDelta* outDelta) {
@@ -21,6 +21,7 @@
 #include <gui/CpuConsumer.h>
 
 #include <gui/BufferItem.h>
+#include <ui/GraphicBufferMapper.h>
 #include <utils/Log.h>
 
 #define CC_LOGV(x, ...) ALOGV("[%s] " x, mName.string(), ##__VA_ARGS__)
@@ -55,6 +56,15 @@ size_t CpuConsumer::findAcquiredBufferLocked(uintptr_t id) const {
     return mMaxLockedBuffers; // an invalid index
 }
 
+bool CpuConsumer::isBufferAcquiredLocked(const sp<GraphicBuffer>& buffer) const {
+    for (size_t i = 0; i < mMaxLockedBuffers; i++) {
+        if (mAcquiredBuffers[i].mGraphicBuffer == buffer) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static uintptr_t getLockedBufferId(const CpuConsumer::LockedBuffer& buffer) {
     return reinterpret_cast<uintptr_t>(buffer.data);
 }
@@ -87,7 +97,21 @@ static bool isPossiblyYUV(PixelFormat format) {
     }
 }
 
-status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) const {
+static void setBufferItemInfo(const BufferItem& item, CpuConsumer::LockedBuffer* outBuffer) {
+    outBuffer->width = item.mGraphicBuffer->getWidth();
+    outBuffer->height = item.mGraphicBuffer->getHeight();
+    outBuffer->format = item.mGraphicBuffer->getPixelFormat();
+
+    outBuffer->crop = item.mCrop;
+    outBuffer->transform = item.mTransform;
+    outBuffer->scalingMode = item.mScalingMode;
+    outBuffer->timestamp = item.mTimestamp;
+    outBuffer->dataSpace = item.mDataSpace;
+    outBuffer->frameNumber = item.mFrameNumber;
+}
+
+status_t CpuConsumer::lockBufferItem(const BufferItem& item, const Rect& bounds,
+                                     LockedBuffer* outBuffer) const {
     android_ycbcr ycbcr = android_ycbcr();
 
     PixelFormat format = item.mGraphicBuffer->getPixelFormat();
@@ -95,7 +119,7 @@ status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBu
     if (isPossiblyYUV(format)) {
         int fenceFd = item.mFence.get() ? item.mFence->dup() : -1;
         status_t err = item.mGraphicBuffer->lockAsyncYCbCr(GraphicBuffer::USAGE_SW_READ_OFTEN,
-                                                           item.mCrop, &ycbcr, fenceFd);
+                                                           bounds, &ycbcr, fenceFd);
         if (err == OK) {
             flexFormat = HAL_PIXEL_FORMAT_YCbCr_420_888;
             if (format != HAL_PIXEL_FORMAT_YCbCr_420_888) {
@@ -119,7 +143,7 @@ status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBu
         void* bufferPointer = nullptr;
         int fenceFd = item.mFence.get() ? item.mFence->dup() : -1;
         status_t err = item.mGraphicBuffer->lockAsync(GraphicBuffer::USAGE_SW_READ_OFTEN,
-                                                      item.mCrop, &bufferPointer, fenceFd);
+                                                      bounds, &bufferPointer, fenceFd);
         if (err != OK) {
             CC_LOGE("Unable to lock buffer for CPU reading: %s (%d)", strerror(-err), err);
             return err;
@@ -133,21 +157,95 @@ status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBu
         outBuffer->chromaStep = 0;
     }
 
-    outBuffer->width = item.mGraphicBuffer->getWidth();
-    outBuffer->height = item.mGraphicBuffer->getHeight();
-    outBuffer->format = format;
     outBuffer->flexFormat = flexFormat;
+    setBufferItemInfo(item, outBuffer);
 
-    outBuffer->crop = item.mCrop;
-    outBuffer->transform = item.mTransform;
-    outBuffer->scalingMode = item.mScalingMode;
-    outBuffer->timestamp = item.mTimestamp;
-    outBuffer->dataSpace = item.mDataSpace;
-    outBuffer->frameNumber = item.mFrameNumber;
+    return OK;
+}
+
+status_t CpuConsumer::lockBufferItemPersistentLocked(const BufferItem& item,
+                                                     LockedBuffer* outBuffer) {
+    const sp<GraphicBuffer>& buffer = item.mGraphicBuffer;
+    auto it = mPersistentMappings.find(buffer->getId());
+    if (it == mPersistentMappings.end()) {
+        // Lock all of the buffer, so that the mapping can be reused whatever
+        // crop it is queued with next time.
+        status_t err = lockBufferItem(item, buffer->getBounds(), outBuffer);
+        if (err != OK) {
+            return err;
+        }
+        mPersistentMappings[buffer->getId()] = PersistentMapping{buffer, *outBuffer};
+        return OK;
+    }
+
+    // The buffer is still locked from a previous acquisition, so nothing
+    // waited for the producer to finish with it.
+    if (item.mFence != nullptr && item.mFence->isValid()) {
+        status_t err = item.mFence->waitForever("CpuConsumer::lockNextBuffer");
+        if (err != OK) {
+            CC_LOGE("Failed to wait for buffer fence: %s (%d)", strerror(-err), err);
+            return err;
+        }
+    }
+
+    status_t err = GraphicBufferMapper::get().rereadLockedBuffer(buffer->handle);
+    if (err != OK) {
+        CC_LOGW("Buffers can't stay locked (%d), locking them on each acquisition", err);
+        mPersistentMappingEnabled = false;
+        releasePersistentMappingsLocked();
+        return lockBufferItem(item, item.mCrop, outBuffer);
+    }
+
+    const LockedBuffer& layout = it->second.mLayout;
+    outBuffer->data = layout.data;
+    outBuffer->stride = layout.stride;
+    outBuffer->flexFormat = layout.flexFormat;
+    outBuffer->dataCb = layout.dataCb;
+    outBuffer->dataCr = layout.dataCr;
+    outBuffer->chromaStride = layout.chromaStride;
+    outBuffer->chromaStep = layout.chromaStep;
+    setBufferItemInfo(item, outBuffer);
 
     return OK;
 }
 
+void CpuConsumer::releasePersistentMappingsLocked() {
+    for (auto it = mPersistentMappings.begin(); it != mPersistentMappings.end();) {
+        if (isBufferAcquiredLocked(it->second.mGraphicBuffer)) {
+            // unlockBuffer takes care of it
+            it->second.mStale = true;
+            ++it;
+        } else {
+            it->second.mGraphicBuffer->unlock();
+            it = mPersistentMappings.erase(it);
+        }
+    }
+}
+
+void CpuConsumer::setPersistentMappingEnabled(bool enabled) {
+    Mutex::Autolock _l(mMutex);
+    mPersistentMappingEnabled = enabled;
+    if (!enabled) {
+        releasePersistentMappingsLocked();
+    }
+}
+
+void CpuConsumer::freeBufferLocked(int slotIndex) {
+    const sp<GraphicBuffer>& buffer = mSlots[slotIndex].mGraphicBuffer;
+    if (buffer != nullptr) {
+        auto it = mPersistentMappings.find(buffer->getId());
+        if (it != mPersistentMappings.end()) {
+            if (isBufferAcquiredLocked(buffer)) {
+                it->second.mStale = true;
+            } else {
+                buffer->unlock();
+                mPersistentMappings.erase(it);
+            }
+        }
+    }
+    ConsumerBase::freeBufferLocked(slotIndex);
+}
+
 status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
     status_t err;
 
@@ -176,7 +274,8 @@ status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
         b.mGraphicBuffer = mSlots[b.mSlot].mGraphicBuffer;
     }
 
-    err = lockBufferItem(b, nativeBuffer);
+    err = mPersistentMappingEnabled ? lockBufferItemPersistentLocked(b, nativeBuffer)
+                                    : lockBufferItem(b, b.mCrop, nativeBuffer);
     if (err != OK) {
         return err;
     }
@@ -208,15 +307,25 @@ status_t CpuConsumer::unlockBuffer(const LockedBuffer &nativeBuffer) {
 
     AcquiredBuffer& ab = mAcquiredBuffers.editItemAt(lockedIdx);
 
-    int fenceFd = -1;
-    status_t err = ab.mGraphicBuffer->unlockAsync(&fenceFd);
-    if (err != OK) {
-        CC_LOGE("%s: Unable to unlock graphic buffer %zd", __FUNCTION__,
-                lockedIdx);
-        return err;
+    sp<Fence> fence = Fence::NO_FENCE;
+    auto mapping = mPersistentMappings.find(ab.mGraphicBuffer->getId());
+    if (mapping != mPersistentMappings.end() && !mapping->second.mStale) {
+        // Stays locked for the next acquisition. The user is done reading from
+        // it, so there is nothing for the producer to wait for.
+    } else {
+        int fenceFd = -1;
+        status_t err = ab.mGraphicBuffer->unlockAsync(&fenceFd);
+        if (err != OK) {
+            CC_LOGE("%s: Unable to unlock graphic buffer %zd", __FUNCTION__,
+                    lockedIdx);
+            return err;
+        }
+        if (mapping != mPersistentMappings.end()) {
+            mPersistentMappings.erase(mapping);
+        }
+        fence = fenceFd >= 0 ? new Fence(fenceFd) : Fence::NO_FENCE;
     }
 
-    sp<Fence> fence(fenceFd >= 0 ? new Fence(fenceFd) : Fence::NO_FENCE);
     addReleaseFenceLocked(ab.mSlot, ab.mGraphicBuffer, fence);
     releaseBufferLocked(ab.mSlot, ab.mGraphicBuffer);
 
@@ -33,10 +33,20 @@ namespace android {
 // using just a few large reads.
 static const size_t EVENT_BUFFER_SIZE = 100;
 
+// Number of messages to read at a time, each of up to EVENT_BUFFER_SIZE events. Every send from
+// SurfaceFlinger is a separate message, so this lets a single read drain the vsync, mode change and
+// hotplug events that queued up while the looper was busy. Reading fewer messages than this also
+// means that the pipe is drained, which saves the read that would find it empty.
+static const size_t MESSAGE_BUFFER_COUNT = 4;
+
 DisplayEventDispatcher::DisplayEventDispatcher(
         const sp<Looper>& looper, ISurfaceComposer::VsyncSource vsyncSource,
         ISurfaceComposer::EventRegistrationFlags eventRegistration)
-      : mLooper(looper), mReceiver(vsyncSource, eventRegistration), mWaitingForVsync(false) {
+      : mLooper(looper),
+        mReceiver(vsyncSource, eventRegistration),
+        mWaitingForVsync(false),
+        // Default initialized, so that only the pages that events are read into are touched.
+        mEventBuffer(new DisplayEventReceiver::Event[EVENT_BUFFER_SIZE * MESSAGE_BUFFER_COUNT]) {
     ALOGV("dispatcher %p ~ Initializing display event dispatcher.", this);
 }
 
@@ -135,52 +145,75 @@ bool DisplayEventDispatcher::processPendingEvents(nsecs_t* outTimestamp,
                                                   uint32_t* outCount,
                                                   VsyncEventData* outVsyncEventData) {
     bool gotVsync = false;
-    DisplayEventReceiver::Event buf[EVENT_BUFFER_SIZE];
+    size_t counts[MESSAGE_BUFFER_COUNT];
     ssize_t n;
-    while ((n = mReceiver.getEvents(buf, EVENT_BUFFER_SIZE)) > 0) {
-        ALOGV("dispatcher %p ~ Read %d events.", this, int(n));
-        mFrameRateOverrides.reserve(n);
-        for (ssize_t i = 0; i < n; i++) {
-            const DisplayEventReceiver::Event& ev = buf[i];
-            switch (ev.header.type) {
-                case DisplayEventReceiver::DISPLAY_EVENT_VSYNC:
-                    // Later vsync events will just overwrite the info from earlier
-                    // ones. That's fine, we only care about the most recent.
-                    gotVsync = true;
-                    *outTimestamp = ev.header.timestamp;
-                    *outDisplayId = ev.header.displayId;
-                    *outCount = ev.vsync.count;
-                    outVsyncEventData->id = ev.vsync.vsyncId;
-                    outVsyncEventData->deadlineTimestamp = ev.vsync.deadlineTimestamp;
-                    outVsyncEventData->frameInterval = ev.vsync.frameInterval;
-                    break;
-                case DisplayEventReceiver::DISPLAY_EVENT_HOTPLUG:
-                    dispatchHotplug(ev.header.timestamp, ev.header.displayId, ev.hotplug.connected);
-                    break;
-                case DisplayEventReceiver::DISPLAY_EVENT_MODE_CHANGE:
-                    dispatchModeChanged(ev.header.timestamp, ev.header.displayId,
-                                        ev.modeChange.modeId, ev.modeChange.vsyncPeriod);
-                    break;
-                case DisplayEventReceiver::DISPLAY_EVENT_NULL:
-                    dispatchNullEvent(ev.header.timestamp, ev.header.displayId);
-                    break;
-                case DisplayEventReceiver::DISPLAY_EVENT_FRAME_RATE_OVERRIDE:
-                    mFrameRateOverrides.emplace_back(ev.frameRateOverride);
-                    break;
-                case DisplayEventReceiver::DISPLAY_EVENT_FRAME_RATE_OVERRIDE_FLUSH:
-                    dispatchFrameRateOverrides(ev.header.timestamp, ev.header.displayId,
-                                               std::move(mFrameRateOverrides));
-                    break;
-                default:
-                    ALOGW("dispatcher %p ~ ignoring unknown event type %#x", this, ev.header.type);
-                    break;
+    do {
+        n = mReceiver.getEventMessages(mEventBuffer.get(), EVENT_BUFFER_SIZE, MESSAGE_BUFFER_COUNT,
+                                       counts);
+        ALOGV("dispatcher %p ~ Read %d messages.", this, int(n));
+
+        // Later vsync events will just overwrite the info from earlier ones. That's fine, we only
+        // care about the most recent, so it is copied out once per read.
+        const DisplayEventReceiver::Event* vsync = nullptr;
+        for (ssize_t m = 0; m < n; m++) {
+            const DisplayEventReceiver::Event* events = &mEventBuffer[m * EVENT_BUFFER_SIZE];
+            for (size_t i = 0; i < counts[m]; i++) {
+                const DisplayEventReceiver::Event& ev = events[i];
+                if (ev.header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
+                    vsync = &ev;
+                    continue;
+                }
+                processEvent(ev, events + counts[m]);
             }
         }
-    }
+
+        if (vsync) {
+            gotVsync = true;
+            *outTimestamp = vsync->header.timestamp;
+            *outDisplayId = vsync->header.displayId;
+            *outCount = vsync->vsync.count;
+            outVsyncEventData->id = vsync->vsync.vsyncId;
+            outVsyncEventData->deadlineTimestamp = vsync->vsync.deadlineTimestamp;
+            outVsyncEventData->frameInterval = vsync->vsync.frameInterval;
+        }
+    } while (n == MESSAGE_BUFFER_COUNT);
+
     if (n < 0) {
         ALOGW("Failed to get events from display event dispatcher, status=%d", status_t(n));
     }
     return gotVsync;
 }
 
+void DisplayEventDispatcher::processEvent(const DisplayEventReceiver::Event& ev,
+                                          const DisplayEventReceiver::Event* messageEnd) {
+    switch (ev.header.type) {
+        case DisplayEventReceiver::DISPLAY_EVENT_HOTPLUG:
+            dispatchHotplug(ev.header.timestamp, ev.header.displayId, ev.hotplug.connected);
+            break;
+        case DisplayEventReceiver::DISPLAY_EVENT_MODE_CHANGE:
+            dispatchModeChanged(ev.header.timestamp, ev.header.displayId, ev.modeChange.modeId,
+                                ev.modeChange.vsyncPeriod);
+            break;
+        case DisplayEventReceiver::DISPLAY_EVENT_NULL:
+            dispatchNullEvent(ev.header.timestamp, ev.header.displayId);
+            break;
+        case DisplayEventReceiver::DISPLAY_EVENT_FRAME_RATE_OVERRIDE:
+            if (mFrameRateOverrides.empty()) {
+                // The overrides are sent in one message that ends with the flush, so reserve for
+                // the rest of the message rather than growing per override.
+                mFrameRateOverrides.reserve(static_cast<size_t>(messageEnd - &ev));
+            }
+            mFrameRateOverrides.emplace_back(ev.frameRateOverride);
+            break;
+        case DisplayEventReceiver::DISPLAY_EVENT_FRAME_RATE_OVERRIDE_FLUSH:
+            dispatchFrameRateOverrides(ev.header.timestamp, ev.header.displayId,
+                                       std::move(mFrameRateOverrides));
+            mFrameRateOverrides.clear();
+            break;
+        default:
+            ALOGW("dispatcher %p ~ ignoring unknown event type %#x", this, ev.header.type);
+            break;
+    }
+}
+
 } // namespace android
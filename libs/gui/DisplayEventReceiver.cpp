@@ -21,6 +21,7 @@
 #include <gui/DisplayEventReceiver.h>
 #include <gui/IDisplayEventConnection.h>
 #include <gui/ISurfaceComposer.h>
+#include <gui/VsyncTimeline.h>
 
 #include <private/gui/ComposerService.h>
 
@@ -80,6 +81,16 @@ status_t DisplayEventReceiver::requestNextVsync() {
     return NO_INIT;
 }
 
+std::shared_ptr<VsyncTimeline> DisplayEventReceiver::getVsyncTimeline() {
+    if (mVsyncTimeline == nullptr && mEventConnection != nullptr) {
+        base::unique_fd fd;
+        if (mEventConnection->getVsyncTimeline(&fd) == NO_ERROR) {
+            mVsyncTimeline = VsyncTimeline::createFromFd(std::move(fd));
+        }
+    }
+    return mVsyncTimeline;
+}
+
 ssize_t DisplayEventReceiver::getEvents(DisplayEventReceiver::Event* events,
         size_t count) {
     return DisplayEventReceiver::getEvents(mDataChannel.get(), events, count);
@@ -91,6 +102,12 @@ ssize_t DisplayEventReceiver::getEvents(gui::BitTube* dataChannel,
     return gui::BitTube::recvObjects(dataChannel, events, count);
 }
 
+ssize_t DisplayEventReceiver::getEventMessages(Event* events, size_t eventsPerMessage,
+                                               size_t messageCount, size_t* outCounts) {
+    return gui::BitTube::recvObjectMessages(mDataChannel.get(), events, eventsPerMessage,
+                                            messageCount, outCounts);
+}
+
 ssize_t DisplayEventReceiver::sendEvents(Event const* events, size_t count) {
     return DisplayEventReceiver::sendEvents(mDataChannel.get(), events, count);
 }
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FrameTimestampRing"
+
+#include <gui/FrameTimestampRing.h>
+
+#include <gui/FrameTimestamps.h>
+#include <system/window.h>
+#include <utils/Log.h>
+
+#include <atomic>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace android {
+
+using base::unique_fd;
+
+namespace {
+
+constexpr uint32_t kMagic = 0x46545352; // 'FTSR'
+
+// A slot is only rewritten a few times per frame, so a reader that keeps
+// racing with the writer for this long has most likely lost it mid-write.
+constexpr int kMaxReadAttempts = 16;
+
+enum Time : size_t {
+    POSTED,
+    REQUESTED_PRESENT,
+    ACQUIRE,
+    LATCH,
+    DISPLAY_PRESENT,
+    DEQUEUE_READY,
+    TIME_COUNT,
+};
+
+struct Slot {
+    // Odd while the slot is being written.
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint64_t> frameNumber;
+    std::atomic<int64_t> times[TIME_COUNT];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                      std::atomic<int64_t>::is_always_lock_free,
+              "The ring is shared between processes, its atomics must not need a lock");
+
+nsecs_t fenceTime(const std::shared_ptr<FenceTime>& fence, bool fenceShouldBeKnown) {
+    if (!fenceShouldBeKnown) {
+        return NATIVE_WINDOW_TIMESTAMP_PENDING;
+    }
+    nsecs_t signalTime = fence->getSignalTime();
+    return (signalTime == Fence::SIGNAL_TIME_PENDING) ? NATIVE_WINDOW_TIMESTAMP_PENDING
+            : (signalTime == Fence::SIGNAL_TIME_INVALID) ? NATIVE_WINDOW_TIMESTAMP_INVALID
+                                                         : signalTime;
+}
+
+nsecs_t eventTime(nsecs_t time) {
+    return (time == FrameEvents::TIMESTAMP_PENDING) ? NATIVE_WINDOW_TIMESTAMP_PENDING : time;
+}
+
+} // namespace
+
+struct FrameTimestampRing::Layout {
+    uint32_t magic;
+    uint32_t capacity;
+    std::atomic<uint64_t> latestFrameNumber;
+    Slot slots[kCapacity];
+};
+
+FrameTimestampRing::FrameTimestampRing(unique_fd fd, Layout* layout, bool writable)
+      : mFd(std::move(fd)), mLayout(layout), mWritable(writable) {}
+
+FrameTimestampRing::~FrameTimestampRing() {
+    munmap(mLayout, sizeof(Layout));
+}
+
+std::shared_ptr<FrameTimestampRing> FrameTimestampRing::create() {
+    unique_fd fd(memfd_create("frame_timestamps", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (!fd.ok()) {
+        ALOGE("Could not create memfd: %s", strerror(errno));
+        return nullptr;
+    }
+    // The producer must be able to rely on the size of the mapping.
+    if (ftruncate(fd.get(), sizeof(Layout)) != 0 ||
+        fcntl(fd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) != 0) {
+        ALOGE("Could not size memfd: %s", strerror(errno));
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        ALOGE("Could not map memfd: %s", strerror(errno));
+        return nullptr;
+    }
+#ifdef F_SEAL_FUTURE_WRITE
+    // Nobody else gets to map it writable. Not all kernels support this, and
+    // the ring doesn't depend on it.
+    fcntl(fd.get(), F_ADD_SEALS, F_SEAL_FUTURE_WRITE | F_SEAL_SEAL);
+#endif
+
+    // memfds are zero-filled, which is a valid empty ring.
+    Layout* layout = static_cast<Layout*>(addr);
+    layout->magic = kMagic;
+    layout->capacity = kCapacity;
+    return std::shared_ptr<FrameTimestampRing>(
+            new FrameTimestampRing(std::move(fd), layout, true /* writable */));
+}
+
+std::shared_ptr<FrameTimestampRing> FrameTimestampRing::createFromFd(unique_fd fd) {
+    struct stat st;
+    if (!fd.ok() || fstat(fd.get(), &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Layout))) {
+        ALOGE("Frame timestamp ring is not a memfd of %zu bytes", sizeof(Layout));
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, sizeof(Layout), PROT_READ, MAP_SHARED, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        ALOGE("Could not map frame timestamp ring: %s", strerror(errno));
+        return nullptr;
+    }
+    Layout* layout = static_cast<Layout*>(addr);
+    if (layout->magic != kMagic || layout->capacity != kCapacity) {
+        ALOGE("Frame timestamp ring has an unexpected layout");
+        munmap(addr, sizeof(Layout));
+        return nullptr;
+    }
+    return std::shared_ptr<FrameTimestampRing>(
+            new FrameTimestampRing(std::move(fd), layout, false /* writable */));
+}
+
+unique_fd FrameTimestampRing::getFd() const {
+    return unique_fd(fcntl(mFd.get(), F_DUPFD_CLOEXEC, 0));
+}
+
+bool FrameTimestampRing::publish(const FrameEvents& frame) {
+    LOG_ALWAYS_FATAL_IF(!mWritable, "publish called on a read-only frame timestamp ring");
+    if (!frame.valid) {
+        return false;
+    }
+
+    nsecs_t times[TIME_COUNT];
+    times[POSTED] = eventTime(frame.postedTime);
+    times[REQUESTED_PRESENT] = eventTime(frame.requestedPresentTime);
+    times[ACQUIRE] = fenceTime(frame.acquireFence, true);
+    times[LATCH] = eventTime(frame.latchTime);
+    times[DISPLAY_PRESENT] = fenceTime(frame.displayPresentFence, frame.addPostCompositeCalled);
+    times[DEQUEUE_READY] = eventTime(frame.dequeueReadyTime);
+
+    Slot& slot = mLayout->slots[frame.frameNumber % kCapacity];
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.frameNumber.store(frame.frameNumber, std::memory_order_relaxed);
+    for (size_t i = 0; i < TIME_COUNT; i++) {
+        slot.times[i].store(times[i], std::memory_order_relaxed);
+    }
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+
+    uint64_t latest = mLayout->latestFrameNumber.load(std::memory_order_relaxed);
+    if (frame.frameNumber > latest) {
+        mLayout->latestFrameNumber.store(frame.frameNumber, std::memory_order_release);
+    }
+
+    return times[ACQUIRE] == NATIVE_WINDOW_TIMESTAMP_PENDING ||
+            (frame.addPostCompositeCalled &&
+             times[DISPLAY_PRESENT] == NATIVE_WINDOW_TIMESTAMP_PENDING);
+}
+
+status_t FrameTimestampRing::getFrame(uint64_t frameNumber,
+                                      FrameTimestampRingEntry* outEntry) const {
+    const Slot& slot = mLayout->slots[frameNumber % kCapacity];
+    nsecs_t times[TIME_COUNT];
+    uint64_t slotFrameNumber;
+    uint32_t sequence;
+    int attempts = 0;
+    while (true) {
+        if (attempts++ == kMaxReadAttempts) {
+            return WOULD_BLOCK;
+        }
+        sequence = slot.sequence.load(std::memory_order_acquire);
+        if ((sequence & 1) != 0) {
+            continue;
+        }
+        slotFrameNumber = slot.frameNumber.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < TIME_COUNT; i++) {
+            times[i] = slot.times[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence == slot.sequence.load(std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (sequence == 0 || slotFrameNumber != frameNumber) {
+        return NAME_NOT_FOUND;
+    }
+
+    outEntry->frameNumber = slotFrameNumber;
+    outEntry->postedTime = times[POSTED];
+    outEntry->requestedPresentTime = times[REQUESTED_PRESENT];
+    outEntry->acquireTime = times[ACQUIRE];
+    outEntry->latchTime = times[LATCH];
+    outEntry->displayPresentTime = times[DISPLAY_PRESENT];
+    outEntry->dequeueReadyTime = times[DEQUEUE_READY];
+    return NO_ERROR;
+}
+
+uint64_t FrameTimestampRing::getLatestFrameNumber() const {
+    return mLayout->latestFrameNumber.load(std::memory_order_acquire);
+}
+
+} // namespace android
@@ -392,6 +392,7 @@ void ConsumerFrameEventHistory::addQueue(const NewFrameEventsEntry& newEntry) {
     // they have the original one already, so there is no need to set the
     // acquire dirty bit.
     mFramesDirty[mQueueOffset].setDirty<FrameEvent::POSTED>();
+    publishToRing(mQueueOffset);
 
     mQueueOffset = (mQueueOffset + 1) % mFrames.size();
 }
@@ -405,6 +406,7 @@ void ConsumerFrameEventHistory::addLatch(
     }
     frame->latchTime = latchTime;
     mFramesDirty[mCompositionOffset].setDirty<FrameEvent::LATCH>();
+    publishToRing(mCompositionOffset);
 }
 
 void ConsumerFrameEventHistory::addPreComposition(
@@ -444,7 +446,9 @@ void ConsumerFrameEventHistory::addPostComposition(uint64_t frameNumber,
             frame->displayPresentFence = displayPresent;
             mFramesDirty[mCompositionOffset].setDirty<FrameEvent::DISPLAY_PRESENT>();
         }
+        publishToRing(mCompositionOffset);
     }
+    publishPendingFencesToRing();
 }
 
 void ConsumerFrameEventHistory::addRelease(uint64_t frameNumber,
@@ -458,6 +462,38 @@ void ConsumerFrameEventHistory::addRelease(uint64_t frameNumber,
     frame->dequeueReadyTime = dequeueReadyTime;
     frame->releaseFence = std::move(release);
     mFramesDirty[mReleaseOffset].setDirty<FrameEvent::RELEASE>();
+    publishToRing(mReleaseOffset);
+}
+
+std::shared_ptr<FrameTimestampRing> ConsumerFrameEventHistory::getTimestampRing() {
+    if (mTimestampRing == nullptr) {
+        mTimestampRing = FrameTimestampRing::create();
+        if (mTimestampRing == nullptr) {
+            return nullptr;
+        }
+        mRingFencesPending.assign(mFrames.size(), false);
+        for (size_t i = 0; i < mFrames.size(); i++) {
+            publishToRing(i);
+        }
+    }
+    return mTimestampRing;
+}
+
+void ConsumerFrameEventHistory::publishToRing(size_t index) {
+    if (mTimestampRing != nullptr) {
+        mRingFencesPending[index] = mTimestampRing->publish(mFrames[index]);
+    }
+}
+
+void ConsumerFrameEventHistory::publishPendingFencesToRing() {
+    if (mTimestampRing == nullptr) {
+        return;
+    }
+    for (size_t i = 0; i < mFrames.size(); i++) {
+        if (mRingFencesPending[i]) {
+            publishToRing(i);
+        }
+    }
 }
 
 void ConsumerFrameEventHistory::getFrameDelta(FrameEventHistoryDelta* delta,
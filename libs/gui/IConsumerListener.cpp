@@ -85,6 +85,11 @@ public:
                                   FrameEventHistoryDelta* /*outDelta*/) override {
         LOG_ALWAYS_FATAL("IConsumerListener::addAndGetFrameTimestamps cannot be proxied");
     }
+
+    status_t getFrameTimestampRing(base::unique_fd* /*outFd*/) override {
+        // The ring is only shared by consumers in the BufferQueue's process.
+        return INVALID_OPERATION;
+    }
 };
 
 // Out-of-line virtual method definitions to trigger vtable emission in this translation unit (see
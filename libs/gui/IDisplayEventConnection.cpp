@@ -26,7 +26,8 @@ enum class Tag : uint32_t {
     STEAL_RECEIVE_CHANNEL = IBinder::FIRST_CALL_TRANSACTION,
     SET_VSYNC_RATE,
     REQUEST_NEXT_VSYNC,
-    LAST = REQUEST_NEXT_VSYNC,
+    GET_VSYNC_TIMELINE,
+    LAST = GET_VSYNC_TIMELINE,
 };
 
 } // Anonymous namespace
@@ -53,6 +54,25 @@ public:
         callRemoteAsync<decltype(&IDisplayEventConnection::requestNextVsync)>(
                 Tag::REQUEST_NEXT_VSYNC);
     }
+
+    status_t getVsyncTimeline(base::unique_fd* outFd) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IDisplayEventConnection::getInterfaceDescriptor());
+        status_t result =
+                remote()->transact(static_cast<uint32_t>(Tag::GET_VSYNC_TIMELINE), data, &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        status_t remoteError = NO_ERROR;
+        result = reply.readInt32(&remoteError);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        if (remoteError != NO_ERROR) {
+            return remoteError;
+        }
+        return reply.readUniqueFileDescriptor(outFd);
+    }
 };
 
 // Out-of-line virtual method definition to trigger vtable emission in this translation unit (see
@@ -74,6 +94,16 @@ status_t BnDisplayEventConnection::onTransact(uint32_t code, const Parcel& data,
             return callLocal(data, reply, &IDisplayEventConnection::setVsyncRate);
         case Tag::REQUEST_NEXT_VSYNC:
             return callLocalAsync(data, reply, &IDisplayEventConnection::requestNextVsync);
+        case Tag::GET_VSYNC_TIMELINE: {
+            CHECK_INTERFACE(IDisplayEventConnection, data, reply);
+            base::unique_fd fd;
+            status_t actualResult = getVsyncTimeline(&fd);
+            status_t result = reply->writeInt32(actualResult);
+            if (result != NO_ERROR || actualResult != NO_ERROR) {
+                return result;
+            }
+            return reply->writeUniqueFileDescriptor(fd);
+        }
     }
 }
 
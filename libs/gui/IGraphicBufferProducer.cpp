@@ -82,6 +82,7 @@ enum {
     CANCEL_BUFFERS,
     QUERY_MULTIPLE,
     GET_LAST_QUEUED_BUFFER2,
+    GET_FRAME_TIMESTAMP_RING,
 };
 
 class BpGraphicBufferProducer : public BpInterface<IGraphicBufferProducer>
@@ -717,6 +718,25 @@ public:
         }
     }
 
+    status_t getFrameTimestampRing(base::unique_fd* outFd) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        status_t result = remote()->transact(GET_FRAME_TIMESTAMP_RING, data, &reply);
+        if (result != NO_ERROR) {
+            ALOGE("getFrameTimestampRing failed to transact: %d", result);
+            return result;
+        }
+        status_t remoteError = NO_ERROR;
+        result = reply.readInt32(&remoteError);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        if (remoteError != NO_ERROR) {
+            return remoteError;
+        }
+        return reply.readUniqueFileDescriptor(outFd);
+    }
+
     virtual status_t getUniqueId(uint64_t* outId) const {
         Parcel data, reply;
         data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
@@ -930,6 +950,10 @@ public:
         return mBase->getFrameTimestamps(outDelta);
     }
 
+    status_t getFrameTimestampRing(base::unique_fd* outFd) override {
+        return mBase->getFrameTimestampRing(outFd);
+    }
+
     status_t getUniqueId(uint64_t* outId) const override {
         return mBase->getUniqueId(outId);
     }
@@ -960,6 +984,12 @@ status_t IGraphicBufferProducer::setAutoPrerotation(bool autoPrerotation) {
     return INVALID_OPERATION;
 }
 
+status_t IGraphicBufferProducer::getFrameTimestampRing(base::unique_fd* outFd) {
+    // No-op for IGBP other than BufferQueue.
+    (void)outFd;
+    return INVALID_OPERATION;
+}
+
 status_t IGraphicBufferProducer::exportToParcel(Parcel* parcel) {
     status_t res = OK;
     res = parcel->writeUint32(USE_BUFFER_QUEUE);
@@ -1469,7 +1499,16 @@ status_t BnGraphicBufferProducer::onTransact(
             }
             return NO_ERROR;
         }
-        case GET_UNIQUE_ID: {
+        case GET_FRAME_TIMESTAMP_RING: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            base::unique_fd fd;
+            status_t actualResult = getFrameTimestampRing(&fd);
+            status_t result = reply->writeInt32(actualResult);
+            if (result != NO_ERROR || actualResult != NO_ERROR) {
+                return result;
+            }
+            return reply->writeUniqueFileDescriptor(fd);
+        }        case GET_UNIQUE_ID: {
             CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
             uint64_t outId = 0;
             status_t actualResult = getUniqueId(&outId);
@@ -19,6 +19,33 @@
 
 namespace android {
 
+namespace {
+
+// Most frames are queued with damage covering the whole surface and without
+// HDR metadata. Those are only described by a bit, and unflattened without
+// building and validating a Region.
+enum QueueBufferInputFlags : uint32_t {
+    FULL_SURFACE_DAMAGE = 1 << 0,
+    NO_HDR_METADATA = 1 << 1,
+};
+
+bool isFullSurfaceDamage(const Region& damage) {
+    return damage.isRect() && damage.bounds() == Rect::INVALID_RECT;
+}
+
+uint32_t getFlags(const Region& damage, const HdrMetadata& hdrMetadata) {
+    uint32_t flags = 0;
+    if (isFullSurfaceDamage(damage)) {
+        flags |= FULL_SURFACE_DAMAGE;
+    }
+    if (hdrMetadata.validTypes == 0) {
+        flags |= NO_HDR_METADATA;
+    }
+    return flags;
+}
+
+} // namespace
+
 constexpr size_t IGraphicBufferProducer::QueueBufferInput::minFlattenedSize() {
     return sizeof(timestamp) +
             sizeof(isAutoTimestamp) +
@@ -28,14 +55,16 @@ constexpr size_t IGraphicBufferProducer::QueueBufferInput::minFlattenedSize() {
             sizeof(transform) +
             sizeof(stickyTransform) +
             sizeof(getFrameTimestamps) +
+            sizeof(uint32_t) + // flags
             sizeof(slot);
 }
 
 size_t IGraphicBufferProducer::QueueBufferInput::getFlattenedSize() const {
+    const uint32_t flags = getFlags(surfaceDamage, hdrMetadata);
     return minFlattenedSize() +
             fence->getFlattenedSize() +
-            surfaceDamage.getFlattenedSize() +
-            hdrMetadata.getFlattenedSize();
+            ((flags & FULL_SURFACE_DAMAGE) ? 0 : surfaceDamage.getFlattenedSize()) +
+            ((flags & NO_HDR_METADATA) ? 0 : hdrMetadata.getFlattenedSize());
 }
 
 size_t IGraphicBufferProducer::QueueBufferInput::getFdCount() const {
@@ -57,21 +86,30 @@ status_t IGraphicBufferProducer::QueueBufferInput::flatten(
     FlattenableUtils::write(buffer, size, transform);
     FlattenableUtils::write(buffer, size, stickyTransform);
     FlattenableUtils::write(buffer, size, getFrameTimestamps);
+    const uint32_t flags = getFlags(surfaceDamage, hdrMetadata);
+    FlattenableUtils::write(buffer, size, flags);
 
     status_t result = fence->flatten(buffer, size, fds, count);
     if (result != NO_ERROR) {
         return result;
     }
-    result = surfaceDamage.flatten(buffer, size);
-    if (result != NO_ERROR) {
-        return result;
+    if (!(flags & FULL_SURFACE_DAMAGE)) {
+        result = surfaceDamage.flatten(buffer, size);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        FlattenableUtils::advance(buffer, size, surfaceDamage.getFlattenedSize());
     }
-    FlattenableUtils::advance(buffer, size, surfaceDamage.getFlattenedSize());
-    result = hdrMetadata.flatten(buffer, size);
-    if (result != NO_ERROR) {
-        return result;
+    if (!(flags & NO_HDR_METADATA)) {
+        result = hdrMetadata.flatten(buffer, size);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        FlattenableUtils::advance(buffer, size, hdrMetadata.getFlattenedSize());
+    }
+    if (size < sizeof(slot)) {
+        return NO_MEMORY;
     }
-    FlattenableUtils::advance(buffer, size, hdrMetadata.getFlattenedSize());
     FlattenableUtils::write(buffer, size, slot);
     return NO_ERROR;
 }
@@ -91,22 +129,35 @@ status_t IGraphicBufferProducer::QueueBufferInput::unflatten(
     FlattenableUtils::read(buffer, size, transform);
     FlattenableUtils::read(buffer, size, stickyTransform);
     FlattenableUtils::read(buffer, size, getFrameTimestamps);
+    uint32_t flags = 0;
+    FlattenableUtils::read(buffer, size, flags);
 
     fence = new Fence();
     status_t result = fence->unflatten(buffer, size, fds, count);
     if (result != NO_ERROR) {
         return result;
     }
-    result = surfaceDamage.unflatten(buffer, size);
-    if (result != NO_ERROR) {
-        return result;
+    if (flags & FULL_SURFACE_DAMAGE) {
+        surfaceDamage = Region::INVALID_REGION;
+    } else {
+        result = surfaceDamage.unflatten(buffer, size);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        FlattenableUtils::advance(buffer, size, surfaceDamage.getFlattenedSize());
     }
-    FlattenableUtils::advance(buffer, size, surfaceDamage.getFlattenedSize());
-    result =  hdrMetadata.unflatten(buffer, size);
-    if (result != NO_ERROR) {
-        return result;
+    if (flags & NO_HDR_METADATA) {
+        hdrMetadata = HdrMetadata();
+    } else {
+        result = hdrMetadata.unflatten(buffer, size);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        FlattenableUtils::advance(buffer, size, hdrMetadata.getFlattenedSize());
+    }
+    if (size < sizeof(slot)) {
+        return NO_MEMORY;
     }
-    FlattenableUtils::advance(buffer, size, hdrMetadata.getFlattenedSize());
     FlattenableUtils::read(buffer, size, slot);
     return NO_ERROR;
 }
@@ -115,7 +166,7 @@ status_t IGraphicBufferProducer::QueueBufferInput::unflatten(
 constexpr size_t IGraphicBufferProducer::QueueBufferOutput::minFlattenedSize() {
     return sizeof(width) + sizeof(height) + sizeof(transformHint) + sizeof(numPendingBuffers) +
             sizeof(nextFrameNumber) + sizeof(bufferReplaced) + sizeof(maxBufferCount) +
-            sizeof(result);
+            sizeof(consumerUsageBits) + sizeof(hasConsumerUsageBits) + sizeof(result);
 }
 size_t IGraphicBufferProducer::QueueBufferOutput::getFlattenedSize() const {
     return minFlattenedSize() + frameTimestamps.getFlattenedSize();
@@ -139,6 +190,8 @@ status_t IGraphicBufferProducer::QueueBufferOutput::flatten(
     FlattenableUtils::write(buffer, size, nextFrameNumber);
     FlattenableUtils::write(buffer, size, bufferReplaced);
     FlattenableUtils::write(buffer, size, maxBufferCount);
+    FlattenableUtils::write(buffer, size, consumerUsageBits);
+    FlattenableUtils::write(buffer, size, hasConsumerUsageBits);
 
     status_t result = frameTimestamps.flatten(buffer, size, fds, count);
     if (result != NO_ERROR) {
@@ -162,6 +215,8 @@ status_t IGraphicBufferProducer::QueueBufferOutput::unflatten(
     FlattenableUtils::read(buffer, size, nextFrameNumber);
     FlattenableUtils::read(buffer, size, bufferReplaced);
     FlattenableUtils::read(buffer, size, maxBufferCount);
+    FlattenableUtils::read(buffer, size, consumerUsageBits);
+    FlattenableUtils::read(buffer, size, hasConsumerUsageBits);
 
     status_t result = frameTimestamps.unflatten(buffer, size, fds, count);
     if (result != NO_ERROR) {
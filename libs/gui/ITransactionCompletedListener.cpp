@@ -29,7 +29,8 @@ namespace { // Anonymous
 enum class Tag : uint32_t {
     ON_TRANSACTION_COMPLETED = IBinder::FIRST_CALL_TRANSACTION,
     ON_RELEASE_BUFFER,
-    LAST = ON_RELEASE_BUFFER,
+    ON_BUFFER_EVICTED,
+    LAST = ON_BUFFER_EVICTED,
 };
 
 } // Anonymous namespace
@@ -201,6 +202,23 @@ status_t TransactionStats::readFromParcel(const Parcel* input) {
     return input->readParcelableVector(&surfaceStats);
 }
 
+status_t ReleaseBufferStats::writeToParcel(Parcel* output) const {
+    SAFE_PARCEL(output->writeParcelable, callbackId);
+    SAFE_PARCEL(output->write, releaseFence ? *releaseFence : *Fence::NO_FENCE);
+    SAFE_PARCEL(output->writeUint32, transformHint);
+    SAFE_PARCEL(output->writeUint32, currentMaxAcquiredBufferCount);
+    return NO_ERROR;
+}
+
+status_t ReleaseBufferStats::readFromParcel(const Parcel* input) {
+    SAFE_PARCEL(input->readParcelable, &callbackId);
+    releaseFence = new Fence();
+    SAFE_PARCEL(input->read, *releaseFence);
+    SAFE_PARCEL(input->readUint32, &transformHint);
+    SAFE_PARCEL(input->readUint32, &currentMaxAcquiredBufferCount);
+    return NO_ERROR;
+}
+
 status_t ListenerStats::writeToParcel(Parcel* output) const {
     status_t err = output->writeInt32(static_cast<int32_t>(transactionStats.size()));
     if (err != NO_ERROR) {
@@ -212,6 +230,10 @@ status_t ListenerStats::writeToParcel(Parcel* output) const {
             return err;
         }
     }
+    SAFE_PARCEL(output->writeInt32, static_cast<int32_t>(releaseBufferStats.size()));
+    for (const auto& stats : releaseBufferStats) {
+        SAFE_PARCEL(output->writeParcelable, stats);
+    }
     return NO_ERROR;
 }
 
@@ -226,6 +248,14 @@ status_t ListenerStats::readFromParcel(const Parcel* input) {
         }
         transactionStats.push_back(stats);
     }
+
+    int32_t releaseBufferStats_size = 0;
+    SAFE_PARCEL_READ_SIZE(input->readInt32, &releaseBufferStats_size, input->dataSize());
+    for (int i = 0; i < releaseBufferStats_size; i++) {
+        ReleaseBufferStats stats;
+        SAFE_PARCEL(input->readParcelable, &stats);
+        releaseBufferStats.push_back(stats);
+    }
     return NO_ERROR;
 }
 
@@ -261,6 +291,11 @@ public:
                                                                   transformHint,
                                                                   currentMaxAcquiredBufferCount);
     }
+
+    void onBufferEvicted(uint64_t cacheId) override {
+        callRemoteAsync<decltype(
+                &ITransactionCompletedListener::onBufferEvicted)>(Tag::ON_BUFFER_EVICTED, cacheId);
+    }
 };
 
 // Out-of-line virtual method definitions to trigger vtable emission in this translation unit (see
@@ -281,6 +316,8 @@ status_t BnTransactionCompletedListener::onTransact(uint32_t code, const Parcel&
                                   &ITransactionCompletedListener::onTransactionCompleted);
         case Tag::ON_RELEASE_BUFFER:
             return callLocalAsync(data, reply, &ITransactionCompletedListener::onReleaseBuffer);
+        case Tag::ON_BUFFER_EVICTED:
+            return callLocalAsync(data, reply, &ITransactionCompletedListener::onBufferEvicted);
     }
 }
 
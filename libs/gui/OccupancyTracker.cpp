@@ -24,6 +24,9 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+#include <iterator>
+
 namespace android {
 
 status_t OccupancyTracker::Segment::writeToParcel(Parcel* parcel) const {
@@ -92,6 +95,45 @@ std::vector<OccupancyTracker::Segment> OccupancyTracker::getSegmentHistory(
     return segments;
 }
 
+void OccupancyTracker::registerLatency(Latency which, nsecs_t latency) {
+    if (latency < 0) {
+        return;
+    }
+    LatencyHistogram& histogram = mLatencies[static_cast<size_t>(which)];
+    const uint64_t millis = static_cast<uint64_t>(ns2ms(latency));
+    size_t bucket = millis == 0 ? 0 : 64 - static_cast<size_t>(__builtin_clzll(millis));
+    bucket = std::min(bucket, LatencyHistogram::NUM_BUCKETS - 1);
+    ++histogram.buckets[bucket];
+    ++histogram.count;
+    histogram.total += latency;
+    histogram.max = std::max(histogram.max, latency);
+}
+
+void OccupancyTracker::dumpLatencies(const String8& prefix, String8* outResult) const {
+    static constexpr const char* kNames[] = {"dequeue-wait", "queue-to-acquire",
+                                             "acquire-to-release"};
+    static_assert(std::size(kNames) == static_cast<size_t>(Latency::Count));
+
+    outResult->appendFormat("%sLatencies (ms):\n", prefix.string());
+    for (size_t i = 0; i < mLatencies.size(); ++i) {
+        const LatencyHistogram& histogram = mLatencies[i];
+        const double average = histogram.count == 0
+                ? 0.0
+                : static_cast<double>(histogram.total) / histogram.count / 1e6;
+        outResult->appendFormat("%s  %-18s count=%" PRIu64 " avg=%.2f max=%.2f [", prefix.string(),
+                                kNames[i], histogram.count, average, histogram.max / 1e6);
+        for (size_t bucket = 0; bucket < LatencyHistogram::NUM_BUCKETS; ++bucket) {
+            const bool last = bucket == LatencyHistogram::NUM_BUCKETS - 1;
+            if (last) {
+                outResult->appendFormat(">=%u:", 1u << (bucket - 1));
+            } else {
+                outResult->appendFormat("<%u:", 1u << bucket);
+            }
+            outResult->appendFormat("%" PRIu64 "%s", histogram.buckets[bucket], last ? "]\n" : " ");
+        }
+    }
+}
+
 void OccupancyTracker::recordPendingSegment() {
     // Only record longer segments to get a better measurement of actual double-
     // vs. triple-buffered time
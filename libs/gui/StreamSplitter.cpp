@@ -73,7 +73,7 @@ StreamSplitter::~StreamSplitter() {
 }
 
 status_t StreamSplitter::addOutput(
-        const sp<IGraphicBufferProducer>& outputQueue) {
+        const sp<IGraphicBufferProducer>& outputQueue, bool lossy) {
     if (outputQueue == nullptr) {
         ALOGE("addOutput: outputQueue must not be NULL");
         return BAD_VALUE;
@@ -91,6 +91,15 @@ status_t StreamSplitter::addOutput(
         return status;
     }
 
+    if (lossy) {
+        status = outputQueue->setAsyncMode(true);
+        if (status != NO_ERROR) {
+            ALOGE("addOutput: failed to set async mode (%d)", status);
+            outputQueue->disconnect(NATIVE_WINDOW_API_CPU);
+            return status;
+        }
+    }
+
     mOutputs.push_back(outputQueue);
 
     return NO_ERROR;
@@ -108,7 +117,9 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
     // The current policy is that if any one consumer is consuming buffers too
     // slowly, the splitter will stall the rest of the outputs by not acquiring
     // any more buffers from the input. This will cause back pressure on the
-    // input queue, slowing down its producer.
+    // input queue, slowing down its producer. Outputs added as lossy only
+    // stall the others while their consumer holds acquired buffers, since
+    // buffers still queued to them are dropped (see addOutput).
 
     // If there are too many outstanding buffers, we block until a buffer is
     // released back to the input in onBufferReleased
@@ -183,6 +194,13 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
 
         ALOGV("queued buffer %#" PRIx64 " to output %p",
                 bufferItem.mGraphicBuffer->getId(), output->get());
+
+        // A lossy output drops the buffer that was still queued to it. It is
+        // now free in the output, so reclaim it as if the consumer had
+        // released it.
+        if (queueOutput.bufferReplaced) {
+            onBufferReleasedByOutputLocked(*output);
+        }
     }
 }
 
@@ -190,7 +208,11 @@ void StreamSplitter::onBufferReleasedByOutput(
         const sp<IGraphicBufferProducer>& from) {
     ATRACE_CALL();
     Mutex::Autolock lock(mMutex);
+    onBufferReleasedByOutputLocked(from);
+}
 
+void StreamSplitter::onBufferReleasedByOutputLocked(
+        const sp<IGraphicBufferProducer>& from) {
     sp<GraphicBuffer> buffer;
     sp<Fence> fence;
     status_t status = from->detachNextBuffer(&buffer, &fence);
@@ -277,6 +277,22 @@ static void getFrameTimestampFence(nsecs_t *dst,
     }
 }
 
+std::shared_ptr<FrameTimestampRing> Surface::getFrameTimestampRing() {
+    ATRACE_CALL();
+
+    Mutex::Autolock lock(mMutex);
+    if (mFrameTimestampRing == nullptr) {
+        base::unique_fd fd;
+        status_t err = mGraphicBufferProducer->getFrameTimestampRing(&fd);
+        if (err != NO_ERROR) {
+            ALOGV("getFrameTimestampRing: not supported by the consumer (%d)", err);
+            return nullptr;
+        }
+        mFrameTimestampRing = FrameTimestampRing::createFromFd(std::move(fd));
+    }
+    return mFrameTimestampRing;
+}
+
 status_t Surface::getFrameTimestamps(uint64_t frameNumber,
         nsecs_t* outRequestedPresentTime, nsecs_t* outAcquireTime,
         nsecs_t* outLatchTime, nsecs_t* outFirstRefreshStartTime,
@@ -943,10 +959,16 @@ int Surface::cancelBuffers(const std::vector<BatchBuffer>& buffers) {
     using CancelBufferInput = IGraphicBufferProducer::CancelBufferInput;
     ATRACE_CALL();
     ALOGV("Surface::cancelBuffers");
+    Mutex::Autolock lock(mMutex);
 
     if (mSharedBufferMode) {
         ALOGE("%s: batch operation is not supported in shared buffer mode!",
                 __FUNCTION__);
+        for (const auto& buffer : buffers) {
+            if (buffer.fenceFd >= 0) {
+                close(buffer.fenceFd);
+            }
+        }
         return INVALID_OPERATION;
     }
 
@@ -1118,6 +1140,8 @@ void Surface::onBufferQueuedLocked(int slot, sp<Fence> fence,
     mDefaultWidth = output.width;
     mDefaultHeight = output.height;
     mNextFrameNumber = output.nextFrameNumber;
+    mConsumerUsage = output.consumerUsageBits;
+    mHasConsumerUsage = output.hasConsumerUsageBits;
 
     // Ignore transform hint if sticky transform is set or transform to display inverse flag is
     // set.
@@ -1186,6 +1210,11 @@ int Surface::queueBuffers(const std::vector<BatchQueuedBuffer>& buffers) {
 
     if (mSharedBufferMode) {
         ALOGE("%s: batched operation is not supported in shared buffer mode", __FUNCTION__);
+        for (const auto& buffer : buffers) {
+            if (buffer.fenceFd >= 0) {
+                close(buffer.fenceFd);
+            }
+        }
         return INVALID_OPERATION;
     }
 
@@ -1349,6 +1378,12 @@ int Surface::query(int what, int* value) const {
                 *value = mMaxBufferCount;
                 return NO_ERROR;
             }
+            case NATIVE_WINDOW_CONSUMER_USAGE_BITS:
+                if (mHasConsumerUsage) {
+                    *value = static_cast<int>(mConsumerUsage);
+                    return NO_ERROR;
+                }
+                break;
         }
     }
     return mGraphicBufferProducer->query(what, value);
@@ -1506,6 +1541,15 @@ int Surface::perform(int operation, va_list args)
     case NATIVE_WINDOW_SET_FRAME_TIMELINE_INFO:
         res = dispatchSetFrameTimelineInfo(args);
         break;
+    case NATIVE_WINDOW_DEQUEUE_BUFFERS:
+        res = dispatchDequeueBuffers(args);
+        break;
+    case NATIVE_WINDOW_CANCEL_BUFFERS:
+        res = dispatchCancelBuffers(args);
+        break;
+    case NATIVE_WINDOW_QUEUE_BUFFERS:
+        res = dispatchQueueBuffers(args);
+        break;
     default:
         res = NAME_NOT_FOUND;
         break;
@@ -1855,6 +1899,53 @@ int Surface::dispatchSetFrameTimelineInfo(va_list args) {
     return setFrameTimelineInfo({frameTimelineVsyncId, inputEventId});
 }
 
+int Surface::dispatchDequeueBuffers(va_list args) {
+    ANativeWindowBuffer** buffers = va_arg(args, ANativeWindowBuffer**);
+    int* fenceFds = va_arg(args, int*);
+    size_t count = va_arg(args, size_t);
+
+    std::vector<BatchBuffer> batch(count);
+    int result = dequeueBuffers(&batch);
+    if (result != OK) {
+        return result;
+    }
+    for (size_t i = 0; i < count; i++) {
+        buffers[i] = batch[i].buffer;
+        fenceFds[i] = batch[i].fenceFd;
+    }
+    return OK;
+}
+
+int Surface::dispatchCancelBuffers(va_list args) {
+    ANativeWindowBuffer* const* buffers = va_arg(args, ANativeWindowBuffer* const*);
+    const int* fenceFds = va_arg(args, const int*);
+    size_t count = va_arg(args, size_t);
+
+    std::vector<BatchBuffer> batch(count);
+    for (size_t i = 0; i < count; i++) {
+        batch[i].buffer = buffers[i];
+        batch[i].fenceFd = fenceFds[i];
+    }
+    return cancelBuffers(batch);
+}
+
+int Surface::dispatchQueueBuffers(va_list args) {
+    ANativeWindowBuffer* const* buffers = va_arg(args, ANativeWindowBuffer* const*);
+    const int* fenceFds = va_arg(args, const int*);
+    const int64_t* timestamps = va_arg(args, const int64_t*);
+    size_t count = va_arg(args, size_t);
+
+    std::vector<BatchQueuedBuffer> batch(count);
+    for (size_t i = 0; i < count; i++) {
+        batch[i].buffer = buffers[i];
+        batch[i].fenceFd = fenceFds[i];
+        if (timestamps != nullptr) {
+            batch[i].timestamp = timestamps[i];
+        }
+    }
+    return queueBuffers(batch);
+}
+
 bool Surface::transformToDisplayInverse() const {
     return (mTransform & NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY) ==
             NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY;
@@ -1890,6 +1981,8 @@ int Surface::connect(
         mDefaultHeight = output.height;
         mNextFrameNumber = output.nextFrameNumber;
         mMaxBufferCount = output.maxBufferCount;
+        mConsumerUsage = output.consumerUsageBits;
+        mHasConsumerUsage = output.hasConsumerUsageBits;
 
         // Ignore transform hint if sticky transform is set or transform to display inverse flag is
         // set. Transform hint should be ignored if the client is expected to always submit buffers
@@ -1934,6 +2027,8 @@ int Surface::disconnect(int api, IGraphicBufferProducer::DisconnectMode mode) {
         mAutoPrerotation = false;
         mEnableFrameTimestamps = false;
         mMaxBufferCount = NUM_BUFFER_SLOTS;
+        mConsumerUsage = 0;
+        mHasConsumerUsage = false;
 
         if (api == NATIVE_WINDOW_API_CPU) {
             mConnectedToCpu = false;
@@ -2526,6 +2621,10 @@ status_t Surface::getUniqueId(uint64_t* outId) const {
 
 int Surface::getConsumerUsage(uint64_t* outUsage) const {
     Mutex::Autolock lock(mMutex);
+    if (mHasConsumerUsage) {
+        *outUsage = mConsumerUsage;
+        return NO_ERROR;
+    }
     return mGraphicBufferProducer->getConsumerUsage(outUsage);
 }
 
@@ -18,6 +18,7 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include <list>
 
 #include <utils/Errors.h>
 #include <utils/Log.h>
@@ -33,6 +34,7 @@
 
 #include <gui/BufferItemConsumer.h>
 #include <gui/CpuConsumer.h>
+#include <gui/DisplayEventDispatcher.h>
 #include <gui/IGraphicBufferProducer.h>
 #include <gui/ISurfaceComposer.h>
 #include <gui/ISurfaceComposerClient.h>
@@ -50,7 +52,10 @@
 #include <private/gui/ComposerService.h>
 
 // This server size should always be smaller than the server cache size
-#define BUFFER_CACHE_MAX_SIZE 64
+// Kept below the limits of SurfaceFlinger's ClientCache, so that it does not have to evict buffers
+// this cache still refers to.
+#define BUFFER_CACHE_MAX_SIZE 256
+#define BUFFER_CACHE_MAX_BYTES (512 * 1024 * 1024)
 
 namespace android {
 
@@ -242,6 +247,12 @@ void TransactionCompletedListener::addSurfaceControlToCallbacks(
 }
 
 void TransactionCompletedListener::onTransactionCompleted(ListenerStats listenerStats) {
+    // Buffers that were dropped before being presented were released before anything else.
+    for (const auto& stats : listenerStats.releaseBufferStats) {
+        onReleaseBuffer(stats.callbackId, stats.releaseFence, stats.transformHint,
+                        stats.currentMaxAcquiredBufferCount);
+    }
+
     std::unordered_map<CallbackId, CallbackTranslation, CallbackIdHash> callbacksMap;
     std::multimap<sp<IBinder>, sp<JankDataListener>> jankListenersMap;
     {
@@ -285,7 +296,7 @@ void TransactionCompletedListener::onTransactionCompleted(ListenerStats listener
                                       transactionStats.latchTime, surfaceStats.acquireTime,
                                       transactionStats.presentFence,
                                       surfaceStats.previousReleaseFence, surfaceStats.transformHint,
-                                      surfaceStats.eventStats);
+                                      surfaceStats.eventStats, surfaceStats.jankData);
             }
 
             callbackFunction(transactionStats.latchTime, transactionStats.presentFence,
@@ -310,7 +321,7 @@ void TransactionCompletedListener::onTransactionCompleted(ListenerStats listener
                                       transactionStats.latchTime, surfaceStats.acquireTime,
                                       transactionStats.presentFence,
                                       surfaceStats.previousReleaseFence, surfaceStats.transformHint,
-                                      surfaceStats.eventStats);
+                                      surfaceStats.eventStats, surfaceStats.jankData);
                 if (callbacksMap[callbackId].surfaceControls[surfaceStats.surfaceControl]) {
                     callbacksMap[callbackId]
                             .surfaceControls[surfaceStats.surfaceControl]
@@ -411,9 +422,11 @@ void removeDeadBufferCallback(void* /*context*/, uint64_t graphicBufferId);
  *        along with the Buffer, SurfaceFlinger on it's side creates a new cache
  *        entry, and we use the integer for further communication.
  * A few details about lifetime:
- *     1. The cache evicts by LRU. The server side cache is keyed by BufferCache::getToken
- *        which is per process Unique. The server side cache is larger than the client side
- *        cache so that the server will never evict entries before the client.
+ *     1. The cache evicts by LRU, once it holds BUFFER_CACHE_MAX_SIZE buffers or
+ *        BUFFER_CACHE_MAX_BYTES of them. The server side cache is keyed by
+ *        BufferCache::getToken which is per process Unique. The server side cache is larger
+ *        than the client side cache so that the server will never evict entries before the
+ *        client. Should it have to, it tells the client through onBufferEvicted.
  *     2. When the client evicts an entry it notifies the server via an uncacheBuffer
  *        transaction.
  *     3. The client only references the Buffers by ID, and uses buffer->addDeathCallback
@@ -434,7 +447,7 @@ public:
         if (itr == mBuffers.end()) {
             return BAD_VALUE;
         }
-        itr->second = getCounter();
+        mLru.splice(mLru.begin(), mLru, itr->second.lruPosition);
         *cacheId = buffer->getId();
         return NO_ERROR;
     }
@@ -442,13 +455,18 @@ public:
     uint64_t cache(const sp<GraphicBuffer>& buffer) {
         std::lock_guard<std::mutex> lock(mMutex);
 
-        if (mBuffers.size() >= BUFFER_CACHE_MAX_SIZE) {
+        const size_t bytes = getBufferSize(buffer);
+        while (!mLru.empty() &&
+               (mBuffers.size() >= BUFFER_CACHE_MAX_SIZE ||
+                mBytes + bytes > BUFFER_CACHE_MAX_BYTES)) {
             evictLeastRecentlyUsedBuffer();
         }
 
         buffer->addDeathCallback(removeDeadBufferCallback, nullptr);
 
-        mBuffers[buffer->getId()] = getCounter();
+        mLru.push_front(buffer->getId());
+        mBuffers[buffer->getId()] = {mLru.begin(), bytes};
+        mBytes += bytes;
         return buffer->getId();
     }
 
@@ -458,35 +476,49 @@ public:
     }
 
     void uncacheLocked(uint64_t cacheId) REQUIRES(mMutex) {
-        mBuffers.erase(cacheId);
-        SurfaceComposerClient::doUncacheBufferTransaction(cacheId);
+        // The buffer may already have been evicted, so only tell the server about buffers it has.
+        if (eraseLocked(cacheId)) {
+            SurfaceComposerClient::doUncacheBufferTransaction(cacheId);
+        }
+    }
+
+    // The server dropped the buffer, so it needs to be sent again next time.
+    void onEvicted(uint64_t cacheId) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        eraseLocked(cacheId);
     }
 
 private:
-    void evictLeastRecentlyUsedBuffer() REQUIRES(mMutex) {
-        auto itr = mBuffers.begin();
-        uint64_t minCounter = itr->second;
-        auto minBuffer = itr;
-        itr++;
-
-        while (itr != mBuffers.end()) {
-            uint64_t counter = itr->second;
-            if (counter < minCounter) {
-                minCounter = counter;
-                minBuffer = itr;
-            }
-            itr++;
-        }
-        uncacheLocked(minBuffer->first);
+    struct CachedBuffer {
+        std::list<uint64_t>::iterator lruPosition;
+        size_t bytes;
+    };
+
+    static size_t getBufferSize(const sp<GraphicBuffer>& buffer) {
+        // Formats without a fixed pixel size are YUV, which take less than 2 bytes per pixel.
+        const uint32_t bpp = bytesPerPixel(buffer->getPixelFormat());
+        return static_cast<size_t>(buffer->getStride()) * buffer->getHeight() *
+                buffer->getLayerCount() * (bpp > 0 ? bpp : 2);
     }
 
-    uint64_t getCounter() REQUIRES(mMutex) {
-        static uint64_t counter = 0;
-        return counter++;
+    bool eraseLocked(uint64_t cacheId) REQUIRES(mMutex) {
+        auto itr = mBuffers.find(cacheId);
+        if (itr == mBuffers.end()) {
+            return false;
+        }
+        mLru.erase(itr->second.lruPosition);
+        mBytes -= itr->second.bytes;
+        mBuffers.erase(itr);
+        return true;
     }
 
+    void evictLeastRecentlyUsedBuffer() REQUIRES(mMutex) { uncacheLocked(mLru.back()); }
+
     std::mutex mMutex;
-    std::map<uint64_t /*Cache id*/, uint64_t /*counter*/> mBuffers GUARDED_BY(mMutex);
+    // Most recently used first.
+    std::list<uint64_t /*Cache id*/> mLru GUARDED_BY(mMutex);
+    std::unordered_map<uint64_t /*Cache id*/, CachedBuffer> mBuffers GUARDED_BY(mMutex);
+    size_t mBytes GUARDED_BY(mMutex) = 0;
 
     // Used by ISurfaceComposer to identify which process is sending the cached buffer.
     sp<IBinder> token;
@@ -499,10 +531,106 @@ void removeDeadBufferCallback(void* /*context*/, uint64_t graphicBufferId) {
     BufferCache::getInstance().uncache(graphicBufferId);
 }
 
+void TransactionCompletedListener::onBufferEvicted(uint64_t cacheId) {
+    BufferCache::getInstance().onEvicted(cacheId);
+}
+
 // ---------------------------------------------------------------------------
 
 // Initialize transaction id counter used to generate transaction ids
 // Transactions will start counting at 1, 0 is used for invalid transactions
+namespace {
+
+// Applies a thread's coalesced transactions by the frame deadline, for threads with a Looper.
+// The last vsync's deadline is used while it is still ahead, otherwise the next vsync is waited
+// for.
+class TransactionCoalescer : public DisplayEventDispatcher, public MessageHandler {
+public:
+    explicit TransactionCoalescer(const sp<Looper>& looper)
+          : DisplayEventDispatcher(looper), mLooper(looper) {}
+
+    void onPending() {
+        const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (mDeadline - kDeadlineMargin > now) {
+            mLooper->sendMessageAtTime(mDeadline - kDeadlineMargin, this, Message());
+        } else {
+            scheduleVsync();
+        }
+    }
+
+    void onFlushed() { mLooper->removeMessages(this); }
+
+    void handleMessage(const Message&) override {
+        SurfaceComposerClient::Transaction::flushCoalesced();
+    }
+
+private:
+    // How long before the deadline the transaction is sent, to leave time for the binder call
+    static constexpr nsecs_t kDeadlineMargin = 2'000'000;
+
+    void dispatchVsync(nsecs_t, PhysicalDisplayId, uint32_t,
+                       VsyncEventData vsyncEventData) override {
+        mDeadline = vsyncEventData.deadlineTimestamp;
+        SurfaceComposerClient::Transaction::flushCoalesced();
+    }
+    void dispatchHotplug(nsecs_t, PhysicalDisplayId, bool) override {}
+    void dispatchModeChanged(nsecs_t, PhysicalDisplayId, int32_t, nsecs_t) override {}
+    void dispatchNullEvent(nsecs_t, PhysicalDisplayId) override {}
+    void dispatchFrameRateOverrides(nsecs_t, PhysicalDisplayId,
+                                    std::vector<FrameRateOverride>) override {}
+
+    const sp<Looper> mLooper;
+    nsecs_t mDeadline = 0;
+};
+
+struct CoalescingState {
+    bool enabled = false;
+    bool flushing = false;
+    std::optional<SurfaceComposerClient::Transaction> pending;
+    sp<TransactionCoalescer> coalescer;
+    bool coalescerInitialized = false;
+
+    ~CoalescingState() {
+        SurfaceComposerClient::Transaction::flushCoalesced();
+        if (coalescer != nullptr) {
+            coalescer->dispose();
+        }
+    }
+};
+
+thread_local CoalescingState tCoalescing;
+
+} // namespace
+
+void SurfaceComposerClient::Transaction::setCoalescingEnabled(bool enabled) {
+    if (!enabled) {
+        flushCoalesced();
+    }
+    tCoalescing.enabled = enabled;
+}
+
+status_t SurfaceComposerClient::Transaction::flushCoalesced() {
+    CoalescingState& state = tCoalescing;
+    if (!state.pending || state.flushing) {
+        return NO_ERROR;
+    }
+    if (state.coalescer != nullptr) {
+        state.coalescer->onFlushed();
+    }
+    Transaction transaction = std::move(*state.pending);
+    state.pending.reset();
+
+    state.flushing = true;
+    status_t status = transaction.apply();
+    state.flushing = false;
+    return status;
+}
+
+bool SurfaceComposerClient::Transaction::canCoalesce(bool synchronous) const {
+    return tCoalescing.enabled && !tCoalescing.flushing && !synchronous && !mForceSynchronous &&
+            mApplyToken == nullptr && mIsAutoTimestamp && !mContainsBuffer && !mAnimation;
+}
+
 std::atomic<uint32_t> SurfaceComposerClient::Transaction::idCounter = 1;
 
 SurfaceComposerClient::Transaction::Transaction() {
@@ -822,6 +950,35 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
         return mStatus;
     }
 
+    if (canCoalesce(synchronous)) {
+        CoalescingState& state = tCoalescing;
+        const bool wasEmpty = !state.pending;
+        if (wasEmpty) {
+            state.pending.emplace();
+        }
+        state.pending->merge(std::move(*this));
+        mId = generateId();
+        if (wasEmpty) {
+            if (!state.coalescerInitialized) {
+                state.coalescerInitialized = true;
+                if (sp<Looper> looper = Looper::getForThread(); looper != nullptr) {
+                    state.coalescer = new TransactionCoalescer(looper);
+                    if (state.coalescer->initialize() != OK) {
+                        ALOGW("Failed to initialize the transaction coalescer, transactions "
+                              "will only be applied on flushCoalesced");
+                        state.coalescer = nullptr;
+                    }
+                }
+            }
+            if (state.coalescer != nullptr) {
+                state.coalescer->onPending();
+            }
+        }
+        return NO_ERROR;
+    }
+    // Keep the order with transactions applied earlier on this thread
+    flushCoalesced();
+
     sp<ISurfaceComposer> sf(ComposerService::getComposerService());
 
     bool hasListenerCallbacks = !mListenerCallbacks.empty();
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "VsyncTimeline"
+
+#include <gui/VsyncTimeline.h>
+
+#include <utils/Log.h>
+
+#include <atomic>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace android {
+
+using base::unique_fd;
+
+namespace {
+
+constexpr uint32_t kMagic = 0x56535954; // 'VSYT'
+
+// A slot is rewritten once every kCapacity vsyncs, so a reader that keeps
+// racing with the writer for this long has most likely lost it mid-write.
+constexpr int kMaxReadAttempts = 16;
+
+struct Slot {
+    // Odd while the slot is being written.
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> count;
+    std::atomic<int64_t> timestamp;
+    std::atomic<int64_t> expectedVSyncTimestamp;
+    std::atomic<int64_t> deadlineTimestamp;
+    std::atomic<int64_t> vsyncId;
+};
+
+static_assert(std::atomic<int64_t>::is_always_lock_free,
+              "The timeline is shared between processes, its atomics must not need a lock");
+
+} // namespace
+
+struct VsyncTimeline::Layout {
+    uint32_t magic;
+    uint32_t capacity;
+    std::atomic<uint32_t> latestCount;
+    Slot slots[kCapacity];
+};
+
+VsyncTimeline::VsyncTimeline(unique_fd fd, Layout* layout, bool writable)
+      : mFd(std::move(fd)), mLayout(layout), mWritable(writable) {}
+
+VsyncTimeline::~VsyncTimeline() {
+    munmap(mLayout, sizeof(Layout));
+}
+
+std::shared_ptr<VsyncTimeline> VsyncTimeline::create() {
+    unique_fd fd(memfd_create("vsync_timeline", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (!fd.ok()) {
+        ALOGE("Could not create memfd: %s", strerror(errno));
+        return nullptr;
+    }
+    // Clients must be able to rely on the size of the mapping.
+    if (ftruncate(fd.get(), sizeof(Layout)) != 0 ||
+        fcntl(fd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) != 0) {
+        ALOGE("Could not size memfd: %s", strerror(errno));
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        ALOGE("Could not map memfd: %s", strerror(errno));
+        return nullptr;
+    }
+#ifdef F_SEAL_FUTURE_WRITE
+    // Nobody else gets to map it writable. Not all kernels support this, and
+    // the timeline doesn't depend on it.
+    fcntl(fd.get(), F_ADD_SEALS, F_SEAL_FUTURE_WRITE | F_SEAL_SEAL);
+#endif
+
+    // memfds are zero-filled, which is a valid empty timeline.
+    Layout* layout = static_cast<Layout*>(addr);
+    layout->magic = kMagic;
+    layout->capacity = kCapacity;
+    return std::shared_ptr<VsyncTimeline>(
+            new VsyncTimeline(std::move(fd), layout, true /* writable */));
+}
+
+std::shared_ptr<VsyncTimeline> VsyncTimeline::createFromFd(unique_fd fd) {
+    struct stat st;
+    if (!fd.ok() || fstat(fd.get(), &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Layout))) {
+        ALOGE("Vsync timeline is not a memfd of %zu bytes", sizeof(Layout));
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, sizeof(Layout), PROT_READ, MAP_SHARED, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        ALOGE("Could not map vsync timeline: %s", strerror(errno));
+        return nullptr;
+    }
+    Layout* layout = static_cast<Layout*>(addr);
+    if (layout->magic != kMagic || layout->capacity != kCapacity) {
+        ALOGE("Vsync timeline has an unexpected layout");
+        munmap(addr, sizeof(Layout));
+        return nullptr;
+    }
+    return std::shared_ptr<VsyncTimeline>(
+            new VsyncTimeline(std::move(fd), layout, false /* writable */));
+}
+
+unique_fd VsyncTimeline::getFd() const {
+    return unique_fd(fcntl(mFd.get(), F_DUPFD_CLOEXEC, 0));
+}
+
+void VsyncTimeline::publish(const VsyncTimelineEntry& vsync) {
+    LOG_ALWAYS_FATAL_IF(!mWritable, "publish called on a read-only vsync timeline");
+
+    Slot& slot = mLayout->slots[vsync.count % kCapacity];
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.count.store(vsync.count, std::memory_order_relaxed);
+    slot.timestamp.store(vsync.timestamp, std::memory_order_relaxed);
+    slot.expectedVSyncTimestamp.store(vsync.expectedVSyncTimestamp, std::memory_order_relaxed);
+    slot.deadlineTimestamp.store(vsync.deadlineTimestamp, std::memory_order_relaxed);
+    slot.vsyncId.store(vsync.vsyncId, std::memory_order_relaxed);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+
+    mLayout->latestCount.store(vsync.count, std::memory_order_release);
+}
+
+status_t VsyncTimeline::getVsync(uint32_t count, VsyncTimelineEntry* outEntry) const {
+    const Slot& slot = mLayout->slots[count % kCapacity];
+    VsyncTimelineEntry entry;
+    uint32_t sequence;
+    int attempts = 0;
+    while (true) {
+        if (attempts++ == kMaxReadAttempts) {
+            return WOULD_BLOCK;
+        }
+        sequence = slot.sequence.load(std::memory_order_acquire);
+        if ((sequence & 1) != 0) {
+            continue;
+        }
+        entry.count = slot.count.load(std::memory_order_relaxed);
+        entry.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+        entry.expectedVSyncTimestamp = slot.expectedVSyncTimestamp.load(std::memory_order_relaxed);
+        entry.deadlineTimestamp = slot.deadlineTimestamp.load(std::memory_order_relaxed);
+        entry.vsyncId = slot.vsyncId.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence == slot.sequence.load(std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (sequence == 0 || entry.count != count) {
+        return NAME_NOT_FOUND;
+    }
+
+    *outEntry = entry;
+    return NO_ERROR;
+}
+
+status_t VsyncTimeline::getLatestVsync(VsyncTimelineEntry* outEntry) const {
+    const uint32_t count = mLayout->latestCount.load(std::memory_order_acquire);
+    if (count == 0) {
+        return NAME_NOT_FOUND;
+    }
+    return getVsync(count, outEntry);
+}
+
+} // namespace android
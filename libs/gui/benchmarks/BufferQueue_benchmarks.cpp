@@ -0,0 +1,472 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/logging.h>
+#include <benchmark/benchmark.h>
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+#include <gui/BLASTBufferQueue.h>
+#include <gui/BufferItemConsumer.h>
+#include <gui/BufferQueue.h>
+#include <gui/IProducerListener.h>
+#include <gui/Surface.h>
+#include <gui/SurfaceComposerClient.h>
+#include <utils/Timers.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/wait.h>
+
+using namespace android;
+using ::benchmark::State;
+
+namespace {
+
+const String16 kServiceName("libgui_benchmarks");
+constexpr uint32_t kBufferWidth = 64;
+constexpr uint32_t kBufferHeight = 64;
+constexpr PixelFormat kBufferFormat = PIXEL_FORMAT_RGBA_8888;
+constexpr uint64_t kProducerUsage = GRALLOC_USAGE_HW_RENDER;
+constexpr uint64_t kConsumerUsage = GRALLOC_USAGE_HW_TEXTURE;
+
+enum BenchmarkServiceCode {
+    CREATE_BUFFER_QUEUE = IBinder::FIRST_CALL_TRANSACTION,
+};
+
+// Latencies of one kind of operation, reported as a distribution.
+class LatencyStats {
+public:
+    explicit LatencyStats(std::string name) : mName(std::move(name)) { mSamples.reserve(1 << 16); }
+
+    void add(nsecs_t duration) { mSamples.push_back(duration); }
+
+    template <typename F>
+    status_t time(F&& f) {
+        const nsecs_t start = systemTime();
+        const status_t result = f();
+        add(systemTime() - start);
+        return result;
+    }
+
+    void report(State& state) {
+        if (mSamples.empty()) {
+            return;
+        }
+        std::sort(mSamples.begin(), mSamples.end());
+        auto percentileUs = [this](double percentile) {
+            const size_t index =
+                    std::min(mSamples.size() - 1, static_cast<size_t>(percentile * mSamples.size()));
+            return toMicros(static_cast<double>(mSamples[index]));
+        };
+        state.counters[mName + "_p50_us"] = percentileUs(0.5);
+        state.counters[mName + "_p90_us"] = percentileUs(0.9);
+        state.counters[mName + "_p99_us"] = percentileUs(0.99);
+        state.counters[mName + "_max_us"] = toMicros(static_cast<double>(mSamples.back()));
+    }
+
+private:
+    static double toMicros(double ns) { return ns / 1000.0; }
+
+    const std::string mName;
+    std::vector<nsecs_t> mSamples;
+};
+
+// Measures how long the benchmarked operations keep others waiting for
+// BufferQueueCore's mutex. query() only reads a field under that mutex, so
+// while the queue is busy its latency is almost entirely lock wait time.
+class LockProbe {
+public:
+    explicit LockProbe(const sp<IGraphicBufferProducer>& producer)
+          : mProducer(producer), mThread(&LockProbe::threadMain, this) {}
+
+    ~LockProbe() { stop(); }
+
+    void stop() {
+        mStopped = true;
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+    }
+
+    void report(State& state) {
+        stop();
+        mLockWait.report(state);
+    }
+
+private:
+    void threadMain() {
+        while (!mStopped) {
+            int value;
+            mLockWait.time([&] { return mProducer->query(NATIVE_WINDOW_WIDTH, &value); });
+            // Don't become the main source of contention.
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    const sp<IGraphicBufferProducer> mProducer;
+    LatencyStats mLockWait{"lock_wait"};
+    std::atomic<bool> mStopped{false};
+    std::thread mThread;
+};
+
+// Acquires and immediately releases every frame on its own thread, like a
+// compositor would.
+class ThreadedConsumer : public ConsumerBase::FrameAvailableListener {
+public:
+    explicit ThreadedConsumer(const sp<BufferItemConsumer>& consumer) : mConsumer(consumer) {}
+
+    ~ThreadedConsumer() override { stop(); }
+
+    void start() { mThread = std::thread(&ThreadedConsumer::threadMain, this); }
+
+    void stop() {
+        {
+            std::lock_guard lock(mMutex);
+            mStopped = true;
+        }
+        mCondition.notify_one();
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+    }
+
+    void report(State& state) {
+        stop();
+        mAcquire.report(state);
+        mRelease.report(state);
+        mQueueToAcquire.report(state);
+    }
+
+    void onFrameAvailable(const BufferItem&) override {
+        {
+            std::lock_guard lock(mMutex);
+            mPendingFrames++;
+        }
+        mCondition.notify_one();
+    }
+
+private:
+    void threadMain() {
+        std::unique_lock lock(mMutex);
+        while (true) {
+            mCondition.wait(lock, [this] { return mStopped || mPendingFrames > 0; });
+            if (mStopped) {
+                return;
+            }
+            mPendingFrames--;
+            lock.unlock();
+
+            BufferItem item;
+            status_t err = mAcquire.time([&] { return mConsumer->acquireBuffer(&item, 0); });
+            if (err == OK) {
+                // Producers queue with the current time as the timestamp.
+                mQueueToAcquire.add(systemTime() - item.mTimestamp);
+                mRelease.time([&] { return mConsumer->releaseBuffer(item); });
+            }
+
+            lock.lock();
+        }
+    }
+
+    const sp<BufferItemConsumer> mConsumer;
+    LatencyStats mAcquire{"acquire"};
+    LatencyStats mRelease{"release"};
+    LatencyStats mQueueToAcquire{"queue_to_acquire"};
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    size_t mPendingFrames = 0;
+    bool mStopped = false;
+    std::thread mThread;
+};
+
+// Connects to the producer with the benchmark's buffer count and async mode.
+status_t connectProducer(const sp<IGraphicBufferProducer>& producer, int bufferCount, bool async) {
+    IGraphicBufferProducer::QueueBufferOutput output;
+    status_t err = producer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU,
+                                     /*producerControlledByApp=*/false, &output);
+    if (err != OK) {
+        return err;
+    }
+    err = producer->setMaxDequeuedBufferCount(bufferCount - 1);
+    if (err != OK) {
+        return err;
+    }
+    return producer->setAsyncMode(async);
+}
+
+// Dequeues and queues one buffer, timing each step.
+status_t produceFrame(const sp<IGraphicBufferProducer>& producer, LatencyStats& dequeueStats,
+                      LatencyStats& queueStats) {
+    int slot;
+    sp<Fence> fence;
+    status_t err = dequeueStats.time([&] {
+        return producer->dequeueBuffer(&slot, &fence, kBufferWidth, kBufferHeight, kBufferFormat,
+                                       kProducerUsage, nullptr, nullptr);
+    });
+    if (err < 0) {
+        return err;
+    }
+    if (err & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+        sp<GraphicBuffer> buffer;
+        err = producer->requestBuffer(slot, &buffer);
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    IGraphicBufferProducer::QueueBufferInput input(systemTime(), /*isAutoTimestamp=*/false,
+                                                   HAL_DATASPACE_UNKNOWN,
+                                                   Rect(kBufferWidth, kBufferHeight),
+                                                   NATIVE_WINDOW_SCALING_MODE_FREEZE,
+                                                   /*transform=*/0, Fence::NO_FENCE);
+    IGraphicBufferProducer::QueueBufferOutput output;
+    return queueStats.time([&] { return producer->queueBuffer(slot, input, &output); });
+}
+
+void bufferCountsAndModes(::benchmark::internal::Benchmark* b) {
+    b->ArgNames({"buffers", "async"});
+    for (int async : {0, 1}) {
+        for (int bufferCount : {2, 3, 4}) {
+            b->Args({bufferCount, async});
+        }
+    }
+}
+
+// Every operation on one thread, in lock step. This is the cost of the
+// BufferQueue itself, without any waiting for the other side.
+void BM_BufferQueueLocal(State& state) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<BufferItemConsumer> itemConsumer = new BufferItemConsumer(consumer, kConsumerUsage);
+    if (connectProducer(producer, state.range(0), state.range(1)) != OK) {
+        state.SkipWithError("Could not connect to the BufferQueue");
+        return;
+    }
+
+    LatencyStats dequeueStats("dequeue");
+    LatencyStats queueStats("queue");
+    LatencyStats acquireStats("acquire");
+    LatencyStats releaseStats("release");
+    for (auto _ : state) {
+        if (produceFrame(producer, dequeueStats, queueStats) != OK) {
+            state.SkipWithError("Could not produce a frame");
+            return;
+        }
+        BufferItem item;
+        if (acquireStats.time([&] { return itemConsumer->acquireBuffer(&item, 0); }) != OK) {
+            state.SkipWithError("Could not acquire a frame");
+            return;
+        }
+        releaseStats.time([&] { return itemConsumer->releaseBuffer(item); });
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    dequeueStats.report(state);
+    queueStats.report(state);
+    acquireStats.report(state);
+    releaseStats.report(state);
+}
+BENCHMARK(BM_BufferQueueLocal)->Apply(bufferCountsAndModes);
+
+// The producer and the consumer each run on their own thread, so they
+// contend for the BufferQueue and the producer waits for free buffers.
+void BM_BufferQueueThreaded(State& state) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<BufferItemConsumer> itemConsumer = new BufferItemConsumer(consumer, kConsumerUsage);
+    sp<ThreadedConsumer> threadedConsumer = new ThreadedConsumer(itemConsumer);
+    itemConsumer->setFrameAvailableListener(threadedConsumer);
+    if (connectProducer(producer, state.range(0), state.range(1)) != OK) {
+        state.SkipWithError("Could not connect to the BufferQueue");
+        return;
+    }
+    threadedConsumer->start();
+    LockProbe lockProbe(producer);
+
+    LatencyStats dequeueStats("dequeue");
+    LatencyStats queueStats("queue");
+    for (auto _ : state) {
+        if (produceFrame(producer, dequeueStats, queueStats) != OK) {
+            state.SkipWithError("Could not produce a frame");
+            break;
+        }
+    }
+
+    producer->disconnect(NATIVE_WINDOW_API_CPU);
+    threadedConsumer->report(state);
+    lockProbe.report(state);
+    state.SetItemsProcessed(state.iterations());
+    dequeueStats.report(state);
+    queueStats.report(state);
+}
+BENCHMARK(BM_BufferQueueThreaded)->Apply(bufferCountsAndModes)->UseRealTime();
+
+// Owns the consumer ends of the BufferQueues used by BM_BufferQueueRemote.
+class BenchmarkService : public BBinder {
+public:
+    status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
+                        uint32_t flags) override {
+        switch (code) {
+            case CREATE_BUFFER_QUEUE: {
+                sp<IGraphicBufferProducer> producer;
+                sp<IGraphicBufferConsumer> consumer;
+                BufferQueue::createBufferQueue(&producer, &consumer);
+                sp<BufferItemConsumer> itemConsumer =
+                        new BufferItemConsumer(consumer, kConsumerUsage);
+                sp<ThreadedConsumer> threadedConsumer = new ThreadedConsumer(itemConsumer);
+                itemConsumer->setFrameAvailableListener(threadedConsumer);
+                threadedConsumer->start();
+
+                std::lock_guard lock(mMutex);
+                // Keep them alive until the next queue is created.
+                if (mConsumer != nullptr) {
+                    mConsumer->stop();
+                }
+                mItemConsumer = itemConsumer;
+                mConsumer = threadedConsumer;
+                return reply->writeStrongBinder(IInterface::asBinder(producer));
+            }
+            default:
+                return BBinder::onTransact(code, data, reply, flags);
+        }
+    }
+
+private:
+    std::mutex mMutex;
+    sp<BufferItemConsumer> mItemConsumer;
+    sp<ThreadedConsumer> mConsumer;
+};
+
+// The producer is in this process and the consumer in the forked service,
+// like an app and SurfaceFlinger before BLAST.
+void BM_BufferQueueRemote(State& state) {
+    sp<IBinder> service = defaultServiceManager()->getService(kServiceName);
+    if (service == nullptr) {
+        state.SkipWithError("The benchmark service isn't running");
+        return;
+    }
+    Parcel data, reply;
+    sp<IBinder> producerBinder;
+    if (service->transact(CREATE_BUFFER_QUEUE, data, &reply) != OK ||
+        reply.readNullableStrongBinder(&producerBinder) != OK || producerBinder == nullptr) {
+        state.SkipWithError("Could not create a BufferQueue in the benchmark service");
+        return;
+    }
+    sp<IGraphicBufferProducer> producer = interface_cast<IGraphicBufferProducer>(producerBinder);
+    if (connectProducer(producer, state.range(0), state.range(1)) != OK) {
+        state.SkipWithError("Could not connect to the BufferQueue");
+        return;
+    }
+
+    LatencyStats dequeueStats("dequeue");
+    LatencyStats queueStats("queue");
+    for (auto _ : state) {
+        if (produceFrame(producer, dequeueStats, queueStats) != OK) {
+            state.SkipWithError("Could not produce a frame");
+            break;
+        }
+    }
+
+    producer->disconnect(NATIVE_WINDOW_API_CPU);
+    state.SetItemsProcessed(state.iterations());
+    dequeueStats.report(state);
+    queueStats.report(state);
+}
+BENCHMARK(BM_BufferQueueRemote)->Apply(bufferCountsAndModes)->UseRealTime();
+
+// Frames go through a BLASTBufferQueue to SurfaceFlinger, which has to be
+// running. The layer is shown on top of everything else, so the producer
+// is paced by composition.
+void BM_BLASTBufferQueue(State& state) {
+    sp<SurfaceComposerClient> client = new SurfaceComposerClient();
+    sp<SurfaceControl> surfaceControl =
+            client->createSurface(String8("libgui_benchmarks"), kBufferWidth, kBufferHeight,
+                                  kBufferFormat, ISurfaceComposerClient::eFXSurfaceBufferState);
+    if (surfaceControl == nullptr) {
+        state.SkipWithError("Could not create a layer, is SurfaceFlinger running?");
+        return;
+    }
+    SurfaceComposerClient::Transaction()
+            .setLayer(surfaceControl, std::numeric_limits<int32_t>::max())
+            .show(surfaceControl)
+            .apply(/*synchronous=*/true);
+
+    sp<BLASTBufferQueue> blastBufferQueue =
+            new BLASTBufferQueue("libgui_benchmarks", surfaceControl, kBufferWidth, kBufferHeight,
+                                 kBufferFormat);
+    sp<IGraphicBufferProducer> producer = blastBufferQueue->getIGraphicBufferProducer();
+    if (connectProducer(producer, state.range(0), state.range(1)) != OK) {
+        state.SkipWithError("Could not connect to the BLASTBufferQueue");
+        return;
+    }
+
+    LatencyStats dequeueStats("dequeue");
+    LatencyStats queueStats("queue");
+    for (auto _ : state) {
+        if (produceFrame(producer, dequeueStats, queueStats) != OK) {
+            state.SkipWithError("Could not produce a frame");
+            break;
+        }
+    }
+
+    producer->disconnect(NATIVE_WINDOW_API_CPU);
+    state.SetItemsProcessed(state.iterations());
+    dequeueStats.report(state);
+    queueStats.report(state);
+}
+BENCHMARK(BM_BLASTBufferQueue)->Apply(bufferCountsAndModes)->UseRealTime();
+
+[[noreturn]] void runService() {
+    sp<ProcessState> proc = ProcessState::self();
+    proc->startThreadPool();
+    status_t err = defaultServiceManager()->addService(kServiceName, new BenchmarkService);
+    CHECK_EQ(err, OK) << "Could not register the benchmark service";
+    IPCThreadState::self()->joinThreadPool();
+    _exit(0);
+}
+
+} // namespace
+
+// The service for BM_BufferQueueRemote is forked before binder is opened in
+// this process, and killed once the benchmarks are done.
+int main(int argc, char** argv) {
+    pid_t servicePid = fork();
+    if (servicePid == 0) {
+        runService();
+    }
+
+    ProcessState::self()->startThreadPool();
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+
+    if (servicePid > 0) {
+        kill(servicePid, SIGKILL);
+        waitpid(servicePid, nullptr, 0);
+    }
+    return 0;
+}
@@ -47,6 +47,7 @@ public:
     void onDisconnect() override;
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
                                   FrameEventHistoryDelta* outDelta) override REQUIRES(mMutex);
+    status_t getFrameTimestampRing(base::unique_fd* outFd) override REQUIRES(mMutex);
     void updateFrameTimestamps(uint64_t frameNumber, nsecs_t refreshStartTime,
                                const sp<Fence>& gpuCompositionDoneFence,
                                const sp<Fence>& presentFence, const sp<Fence>& prevReleaseFence,
@@ -115,6 +116,13 @@ public:
 
     uint32_t getLastTransformHint() const;
 
+    // When enabled, BLASTBufferQueue owns the producer's max dequeued buffer count and moves it
+    // between double and triple buffering at runtime. It grows as soon as several of the app's
+    // frames miss their deadline, according to the jank classification SurfaceFlinger reports in
+    // transaction callbacks, and shrinks again once the app has kept up for a while, which saves
+    // a buffer and a frame of latency.
+    void setAdaptiveBufferCountEnabled(bool enabled);
+
     virtual ~BLASTBufferQueue();
 
 private:
@@ -131,6 +139,11 @@ private:
     // Return true if we need to reject the buffer based on the scaling mode and the buffer size.
     bool rejectBuffer(const BufferItem& item) REQUIRES(mMutex);
     bool maxBuffersAcquired(bool includeExtraAcquire) const REQUIRES(mMutex);
+    // Returns the max dequeued buffer count to switch to given the jank data for newly classified
+    // frames, or 0 to keep the current one.
+    int32_t updateAdaptiveBufferCountLocked(const std::vector<JankData>& jankData)
+            REQUIRES(mMutex);
+    void applyMaxDequeuedBufferCount(int32_t count) EXCLUDES(mMutex);
     static PixelFormat convertBufferFormat(PixelFormat& format);
 
     std::string mName;
@@ -241,6 +254,21 @@ private:
     // Keep track of SurfaceControls that have submitted a transaction and BBQ is waiting on a
     // callback for them.
     std::queue<sp<SurfaceControl>> mSurfaceControlsWithPendingCallback GUARDED_BY(mMutex);
+
+    // Adaptive buffer count, see setAdaptiveBufferCountEnabled. Frames are looked at in windows
+    // of kAdaptiveWindowFrames classified frames. The queue grows as soon as a window has
+    // kAdaptiveGrowMisses missed frames, and shrinks after kAdaptiveShrinkWindows windows in a
+    // row without any.
+    static constexpr int32_t kAdaptiveMinDequeuedBuffers = 1;
+    static constexpr int32_t kAdaptiveMaxDequeuedBuffers = 2;
+    static constexpr uint32_t kAdaptiveWindowFrames = 60;
+    static constexpr uint32_t kAdaptiveGrowMisses = 2;
+    static constexpr uint32_t kAdaptiveShrinkWindows = 3;
+    bool mAdaptiveBufferCount GUARDED_BY(mMutex) = false;
+    int32_t mMaxDequeuedBufferCount GUARDED_BY(mMutex) = 2;
+    uint32_t mJankWindowFrames GUARDED_BY(mMutex) = 0;
+    uint32_t mJankWindowMisses GUARDED_BY(mMutex) = 0;
+    uint32_t mCleanJankWindows GUARDED_BY(mMutex) = 0;
 };
 
 } // namespace android
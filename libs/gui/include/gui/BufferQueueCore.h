@@ -45,6 +45,7 @@
 
 namespace android {
 
+class BufferQueueProducer;
 class IConsumerListener;
 class IProducerListener;
 
@@ -114,6 +115,13 @@ private:
     // given slot.
     void clearBufferSlotLocked(int slot);
 
+    // schedulePreallocationLocked is called when the consumer changes the
+    // default size, format or usage. If the producer opted into preallocation
+    // and no pass is running already, it marks one as pending and returns the
+    // producer, which should then be told to preallocateBuffersAsync once
+    // mMutex has been released.
+    sp<BufferQueueProducer> schedulePreallocationLocked();
+
     // freeAllBuffersLocked frees the GraphicBuffer and sync resources for
     // all slots, even if they're currently dequeued, queued, or acquired.
     void freeAllBuffersLocked();
@@ -357,6 +365,27 @@ private:
     // This allows the consumer to acquire an additional buffer if that buffer is not droppable and
     // will eventually be released or acquired by the consumer.
     bool mAllowExtraAcquire = false;
+
+    // mPreallocationEnabled is set once the producer calls allocateBuffers, which records its
+    // arguments in mPreallocWidth, mPreallocHeight, mPreallocFormat and mPreallocUsage. From then
+    // on, when the consumer changes the default size, format or usage, mPreallocatingProducer
+    // replaces the free buffers this made stale on a background thread, instead of the next
+    // dequeueBuffer calls reallocating them. It is cleared on disconnect.
+    bool mPreallocationEnabled = false;
+    uint32_t mPreallocWidth = 0;
+    uint32_t mPreallocHeight = 0;
+    PixelFormat mPreallocFormat = PIXEL_FORMAT_UNKNOWN;
+    uint64_t mPreallocUsage = 0;
+    wp<BufferQueueProducer> mPreallocatingProducer;
+
+    // mPreallocationPending is true while a background preallocation is scheduled or running, so
+    // that a burst of changes to the defaults only starts one. mPreallocationGeneration is bumped
+    // on every change, so that the running pass knows to go around again.
+    bool mPreallocationPending = false;
+    uint64_t mPreallocationGeneration = 0;
+
+    // mHotPathAllocationCount counts the buffers dequeueBuffer had to allocate itself.
+    uint64_t mHotPathAllocationCount = 0;
 }; // class BufferQueueCore
 
 } // namespace android
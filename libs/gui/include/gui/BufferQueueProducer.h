@@ -20,6 +20,8 @@
 #include <gui/BufferQueueDefs.h>
 #include <gui/IGraphicBufferProducer.h>
 
+#include <functional>
+
 namespace android {
 
 class IBinder;
@@ -193,6 +195,9 @@ public:
     // See IGraphicBufferProducer::getFrameTimestamps
     virtual void getFrameTimestamps(FrameEventHistoryDelta* outDelta) override;
 
+    // See IGraphicBufferProducer::getFrameTimestampRing
+    virtual status_t getFrameTimestampRing(base::unique_fd* outFd) override;
+
     // See IGraphicBufferProducer::getUniqueId
     virtual status_t getUniqueId(uint64_t* outId) const override;
 
@@ -202,7 +207,15 @@ public:
     // See IGraphicBufferProducer::setAutoPrerotation
     virtual status_t setAutoPrerotation(bool autoPrerotation);
 
+    // Replaces the free buffers made stale by a change to the consumer's
+    // default size, format or usage, and fills any empty slots, on a
+    // background thread. See BufferQueueCore::mPreallocationEnabled.
+    void preallocateBuffersAsync();
+
 private:
+    // The body of preallocateBuffersAsync
+    void preallocateBuffers();
+
     // This is required by the IBinder::DeathRecipient interface
     virtual void binderDied(const wp<IBinder>& who);
 
@@ -264,6 +277,13 @@ private:
     int mCurrentCallbackTicket; // Protected by mCallbackMutex
     std::condition_variable mCallbackCondition;
 
+    // Waits for callbackTicket to come up, and then calls 'callback' with
+    // mCallbackMutex held. Used so that consumer listener callbacks are made
+    // in order, but without holding mCore->mMutex, which the consumer may be
+    // waiting on. Every ticket taken must be passed here, or later callbacks
+    // never run.
+    void callbackInOrder(int callbackTicket, const std::function<void()>& callback);
+
     // Sets how long dequeueBuffer or attachBuffer will block if a buffer or
     // slot is not yet available.
     nsecs_t mDequeueTimeout;
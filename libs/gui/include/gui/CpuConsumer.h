@@ -24,6 +24,7 @@
 
 #include <utils/Vector.h>
 
+#include <unordered_map>
 
 namespace android {
 
@@ -111,6 +112,16 @@ class CpuConsumer : public ConsumerBase
     // lockNextBuffer.
     status_t unlockBuffer(const LockedBuffer &nativeBuffer);
 
+    // When enabled, buffers are left locked by unlockBuffer, and acquiring the
+    // same buffer again only waits for its fence and has gralloc re-read its
+    // contents instead of locking it all over again. A buffer stays locked
+    // until it leaves the BufferQueue's slots or this is disabled. Requires
+    // gralloc 4.0 or later. Disabled by default.
+    void setPersistentMappingEnabled(bool enabled);
+
+  protected:
+    void freeBufferLocked(int slotIndex) override;
+
   private:
     // Maximum number of buffers that can be locked at a time
     const size_t mMaxLockedBuffers;
@@ -138,14 +149,32 @@ class CpuConsumer : public ConsumerBase
         }
     };
 
+    // A buffer left locked after it was returned to the queue, see
+    // setPersistentMappingEnabled.
+    struct PersistentMapping {
+        sp<GraphicBuffer> mGraphicBuffer;
+        // Only the fields describing the mapping are kept up to date.
+        LockedBuffer mLayout;
+        // Set when the buffer has to be unlocked, but the user still holds it.
+        bool mStale = false;
+    };
+
     size_t findAcquiredBufferLocked(uintptr_t id) const;
+    bool isBufferAcquiredLocked(const sp<GraphicBuffer>& buffer) const;
 
-    status_t lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) const;
+    status_t lockBufferItem(const BufferItem& item, const Rect& bounds,
+                            LockedBuffer* outBuffer) const;
+    status_t lockBufferItemPersistentLocked(const BufferItem& item, LockedBuffer* outBuffer);
+    void releasePersistentMappingsLocked();
 
     Vector<AcquiredBuffer> mAcquiredBuffers;
 
     // Count of currently locked buffers
     size_t mCurrentLockedBuffers;
+
+    bool mPersistentMappingEnabled = false;
+    // Keyed by GraphicBuffer id.
+    std::unordered_map<uint64_t, PersistentMapping> mPersistentMappings;
 };
 
 } // namespace android
@@ -18,6 +18,8 @@
 #include <utils/Log.h>
 #include <utils/Looper.h>
 
+#include <memory>
+
 namespace android {
 using FrameRateOverride = DisplayEventReceiver::Event::FrameRateOverride;
 
@@ -59,6 +61,9 @@ private:
 
     std::vector<FrameRateOverride> mFrameRateOverrides;
 
+    // Slots for the messages read at once from mReceiver.
+    std::unique_ptr<DisplayEventReceiver::Event[]> mEventBuffer;
+
     virtual void dispatchVsync(nsecs_t timestamp, PhysicalDisplayId displayId, uint32_t count,
                                VsyncEventData vsyncEventData) = 0;
     virtual void dispatchHotplug(nsecs_t timestamp, PhysicalDisplayId displayId,
@@ -74,5 +79,10 @@ private:
 
     bool processPendingEvents(nsecs_t* outTimestamp, PhysicalDisplayId* outDisplayId,
                               uint32_t* outCount, VsyncEventData* outVsyncEventData);
+
+    // Dispatches an event other than vsync. Frame rate overrides are collected until the flush
+    // that ends their message.
+    void processEvent(const DisplayEventReceiver::Event& ev,
+                      const DisplayEventReceiver::Event* messageEnd);
 };
 } // namespace android
@@ -34,6 +34,7 @@ namespace android {
 // ----------------------------------------------------------------------------
 
 class IDisplayEventConnection;
+class VsyncTimeline;
 
 namespace gui {
 class BitTube;
@@ -142,6 +143,16 @@ public:
     ssize_t getEvents(Event* events, size_t count);
     static ssize_t getEvents(gui::BitTube* dataChannel, Event* events, size_t count);
 
+    /*
+     * getEventMessages reads up to messageCount queued messages at once, each of which holds the
+     * events of one sendEvents call. Message i is read into the eventsPerMessage events at
+     * events + i * eventsPerMessage, and its event count is stored in outCounts[i]. Returns how
+     * many messages were read, or a negative error code as for getEvents. Fewer messages than
+     * messageCount means that the queue was drained.
+     */
+    ssize_t getEventMessages(Event* events, size_t eventsPerMessage, size_t messageCount,
+                             size_t* outCounts);
+
     /*
      * sendEvents write events to the queue and returns how many events were
      * written.
@@ -163,9 +174,16 @@ public:
      */
     status_t requestNextVsync();
 
+    /*
+     * getVsyncTimeline() returns the timeline of recent vsyncs of the event thread, from which the
+     * latest vsync can be read without requesting it. Returns nullptr if it is not available.
+     */
+    std::shared_ptr<VsyncTimeline> getVsyncTimeline();
+
 private:
     sp<IDisplayEventConnection> mEventConnection;
     std::unique_ptr<gui::BitTube> mDataChannel;
+    std::shared_ptr<VsyncTimeline> mVsyncTimeline;
 };
 
 // ----------------------------------------------------------------------------
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+#include <memory>
+
+namespace android {
+
+struct FrameEvents;
+
+// The timestamps of a single frame, as read from a FrameTimestampRing. Like
+// Surface::getFrameTimestamps, times that aren't known yet are
+// NATIVE_WINDOW_TIMESTAMP_PENDING and times that will never be known are
+// NATIVE_WINDOW_TIMESTAMP_INVALID.
+struct FrameTimestampRingEntry {
+    uint64_t frameNumber{0};
+    nsecs_t postedTime{0};
+    nsecs_t requestedPresentTime{0};
+    nsecs_t acquireTime{0};
+    nsecs_t latchTime{0};
+    nsecs_t displayPresentTime{0};
+    nsecs_t dequeueReadyTime{0};
+};
+
+// A ring of recent frame timestamps in memory shared between the consumer,
+// which publishes them as they become known, and the producer, which can read
+// them without a binder call or any lock. Each frame has its own slot, indexed
+// by frame number, guarded by a sequence counter so readers never see a slot
+// while it is being rewritten.
+//
+// Only the consumer side writes to the ring, and it never trusts anything it
+// reads back from it.
+class FrameTimestampRing {
+public:
+    // Number of frames kept in the ring.
+    static constexpr size_t kCapacity = 64;
+
+    ~FrameTimestampRing();
+
+    // Creates a new ring owned by the consumer.
+    static std::shared_ptr<FrameTimestampRing> create();
+
+    // Maps a ring received from the consumer through getFd(). The mapping is
+    // read-only, so publish() must not be called on the result.
+    static std::shared_ptr<FrameTimestampRing> createFromFd(base::unique_fd fd);
+
+    // Returns a duplicate of the fd backing the ring, to be sent to the
+    // producer.
+    base::unique_fd getFd() const;
+
+    // Writes the current state of a frame into its slot. Returns true if some
+    // of its fences haven't signaled yet, so it needs to be published again
+    // once they have.
+    bool publish(const FrameEvents& frame);
+
+    // Reads the timestamps of a frame. Returns NAME_NOT_FOUND if the frame was
+    // never published or has since been overwritten by a newer one, and
+    // WOULD_BLOCK if its slot kept changing while it was being read.
+    status_t getFrame(uint64_t frameNumber, FrameTimestampRingEntry* outEntry) const;
+
+    // Returns the frame number of the most recently queued frame, or 0 if
+    // there isn't one yet.
+    uint64_t getLatestFrameNumber() const;
+
+private:
+    struct Layout;
+
+    FrameTimestampRing(base::unique_fd fd, Layout* layout, bool writable);
+
+    const base::unique_fd mFd;
+    Layout* const mLayout;
+    const bool mWritable;
+};
+
+} // namespace android
@@ -17,6 +17,7 @@
 #ifndef ANDROID_GUI_FRAMETIMESTAMPS_H
 #define ANDROID_GUI_FRAMETIMESTAMPS_H
 
+#include <gui/FrameTimestampRing.h>
 #include <ui/FenceTime.h>
 #include <utils/Flattenable.h>
 #include <utils/StrongPointer.h>
@@ -225,10 +226,19 @@ public:
 
     void getAndResetDelta(FrameEventHistoryDelta* delta);
 
+    // Returns the ring the events are mirrored to, creating it on first use.
+    // Until then, nothing is written to shared memory.
+    std::shared_ptr<FrameTimestampRing> getTimestampRing();
+
 private:
     void getFrameDelta(FrameEventHistoryDelta* delta,
                        const std::vector<FrameEvents>::iterator& frame);
 
+    void publishToRing(size_t index);
+    // Publishes frames whose fences hadn't signaled the last time they were
+    // written to the ring.
+    void publishPendingFencesToRing();
+
     std::vector<FrameEventDirtyFields> mFramesDirty;
 
     size_t mQueueOffset{0};
@@ -237,6 +247,10 @@ private:
 
     int mCurrentConnectId{0};
     bool mProducerWantsEvents{false};
+
+    std::shared_ptr<FrameTimestampRing> mTimestampRing;
+    // Whether each frame was published with fences that hadn't signaled.
+    std::vector<bool> mRingFencesPending;
 };
 
 
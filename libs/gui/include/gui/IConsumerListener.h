@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <android-base/unique_fd.h>
 #include <binder/IInterface.h>
 #include <binder/SafeInterface.h>
 
@@ -90,6 +91,14 @@ public:
     // WARNING: This method can only be called when the BufferQueue is in the consumer's process.
     virtual void addAndGetFrameTimestamps(const NewFrameEventsEntry* /*newTimestamps*/,
                                           FrameEventHistoryDelta* /*outDelta*/) {}
+
+    // Returns an fd for the shared memory the consumer mirrors frame timestamps to (see
+    // FrameTimestampRing), so that the producer can read them without calling into the consumer.
+    //
+    // WARNING: This method can only be called when the BufferQueue is in the consumer's process.
+    virtual status_t getFrameTimestampRing(base::unique_fd* /*outFd*/) {
+        return INVALID_OPERATION;
+    }
 };
 
 #ifndef NO_BINDER
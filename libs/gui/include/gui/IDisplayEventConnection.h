@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <android-base/unique_fd.h>
 #include <binder/IInterface.h>
 #include <binder/SafeInterface.h>
 #include <gui/ISurfaceComposer.h>
@@ -51,6 +52,12 @@ public:
      * requestNextVsync() schedules the next vsync event. It has no effect if the vsync rate is > 0.
      */
     virtual void requestNextVsync() = 0; // Asynchronous
+
+    /*
+     * getVsyncTimeline() returns the fd of a VsyncTimeline on which every vsync of this
+     * connection's event thread is published, whether or not it is delivered to this connection.
+     */
+    virtual status_t getVsyncTimeline(base::unique_fd* outFd) = 0;
 };
 
 class BnDisplayEventConnection : public SafeBnInterface<IDisplayEventConnection> {
@@ -23,6 +23,7 @@
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 
+#include <android-base/unique_fd.h>
 #include <binder/IInterface.h>
 
 #include <ui/BufferQueueDefs.h>
@@ -401,6 +402,11 @@ public:
         FrameEventHistoryDelta frameTimestamps;
         bool bufferReplaced{false};
         int maxBufferCount{0};
+        // Consumer usage bits at the time of the call. Only meaningful when
+        // hasConsumerUsageBits is set, which producers that do not report
+        // them leave false.
+        uint64_t consumerUsageBits{0};
+        bool hasConsumerUsageBits{false};
         status_t result{NO_ERROR};
     };
 
@@ -664,6 +670,17 @@ public:
     // Gets the frame events that haven't already been retrieved.
     virtual void getFrameTimestamps(FrameEventHistoryDelta* /*outDelta*/) {}
 
+    // Returns an fd for a FrameTimestampRing the consumer mirrors frame events
+    // to, so that they can be polled without calling getFrameTimestamps. The
+    // consumer only starts writing to it once this has been called.
+    //
+    // Returns INVALID_OPERATION if the consumer doesn't provide one.
+#ifndef NO_BINDER
+    virtual status_t getFrameTimestampRing(base::unique_fd* outFd);
+#else
+    virtual status_t getFrameTimestampRing(base::unique_fd*) { return INVALID_OPERATION; }
+#endif
+
     // Returns a unique id for this BufferQueue
     virtual status_t getUniqueId(uint64_t* outId) const = 0;
 
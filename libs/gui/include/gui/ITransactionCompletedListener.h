@@ -172,6 +172,26 @@ public:
     std::vector<SurfaceStats> surfaceStats;
 };
 
+// A buffer released without having been presented, e.g. because another buffer replaced it first.
+class ReleaseBufferStats : public Parcelable {
+public:
+    status_t writeToParcel(Parcel* output) const override;
+    status_t readFromParcel(const Parcel* input) override;
+
+    ReleaseBufferStats() = default;
+    ReleaseBufferStats(ReleaseCallbackId callbackId, const sp<Fence>& releaseFence,
+                       uint32_t transformHint, uint32_t currentMaxAcquiredBufferCount)
+          : callbackId(callbackId),
+            releaseFence(releaseFence),
+            transformHint(transformHint),
+            currentMaxAcquiredBufferCount(currentMaxAcquiredBufferCount) {}
+
+    ReleaseCallbackId callbackId;
+    sp<Fence> releaseFence;
+    uint32_t transformHint = 0;
+    uint32_t currentMaxAcquiredBufferCount = 0;
+};
+
 class ListenerStats : public Parcelable {
 public:
     status_t writeToParcel(Parcel* output) const override;
@@ -183,6 +203,9 @@ public:
 
     sp<IBinder> listener;
     std::vector<TransactionStats> transactionStats;
+    // Sent along with the transaction stats, so that a frame's callbacks to a process are a
+    // single binder call.
+    std::vector<ReleaseBufferStats> releaseBufferStats;
 };
 
 class ITransactionCompletedListener : public IInterface {
@@ -194,6 +217,10 @@ public:
     virtual void onReleaseBuffer(ReleaseCallbackId callbackId, sp<Fence> releaseFence,
                                  uint32_t transformHint,
                                  uint32_t currentMaxAcquiredBufferCount) = 0;
+
+    // Called when SurfaceFlinger drops a buffer this process cached with it. The buffer has to be
+    // sent again before its cache id can be used.
+    virtual void onBufferEvicted(uint64_t cacheId) = 0;
 };
 
 class BnTransactionCompletedListener : public SafeBnInterface<ITransactionCompletedListener> {
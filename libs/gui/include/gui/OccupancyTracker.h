@@ -22,6 +22,7 @@
 
 #include <utils/Timers.h>
 
+#include <array>
 #include <deque>
 #include <unordered_map>
 
@@ -72,6 +73,20 @@ public:
     void registerOccupancyChange(size_t occupancy);
     std::vector<Segment> getSegmentHistory(bool forceFlush);
 
+    // Latencies that are tracked as histograms in addition to occupancy
+    enum class Latency : size_t {
+        // Time dequeueBuffer waited for a free buffer
+        DequeueWait,
+        // Time a buffer spent queued before being acquired
+        QueueToAcquire,
+        // Time the consumer held a buffer between acquiring and releasing it
+        AcquireToRelease,
+        Count,
+    };
+
+    void registerLatency(Latency which, nsecs_t latency);
+    void dumpLatencies(const String8& prefix, String8* outResult) const;
+
 private:
     static constexpr size_t MAX_HISTORY_SIZE = 10;
     static constexpr nsecs_t NEW_SEGMENT_DELAY = ms2ns(100);
@@ -89,8 +104,22 @@ private:
         std::unordered_map<size_t, nsecs_t> mOccupancyTimes;
     };
 
+    // Counts latencies in power-of-two buckets of milliseconds: the first
+    // bucket counts latencies under 1ms, bucket i counts those in
+    // [2^(i-1), 2^i) ms, and the last one counts everything longer.
+    struct LatencyHistogram {
+        static constexpr size_t NUM_BUCKETS = 10;
+
+        std::array<uint64_t, NUM_BUCKETS> buckets{};
+        uint64_t count = 0;
+        nsecs_t total = 0;
+        nsecs_t max = 0;
+    };
+
     void recordPendingSegment();
 
+    std::array<LatencyHistogram, static_cast<size_t>(Latency::Count)> mLatencies;
+
     PendingSegment mPendingSegment;
     std::deque<Segment> mSegmentHistory;
 
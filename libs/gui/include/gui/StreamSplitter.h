@@ -57,11 +57,20 @@ public:
     // output is abandoned by its consumer, the splitter will abandon its input
     // queue (see onAbandoned).
     //
+    // If lossy is true, the output queue is put in async mode, so a buffer
+    // that is still queued to it is dropped when the next one arrives instead
+    // of waiting for its consumer to acquire it. Dropped buffers count as
+    // released by that output, which keeps a slow lossy consumer from holding
+    // back the input and the other outputs. Buffers the consumer has acquired
+    // must still be released as usual.
+    //
     // A return value other than NO_ERROR means that an error has occurred and
     // outputQueue has not been added to the splitter. BAD_VALUE is returned if
-    // outputQueue is NULL. See IGraphicBufferProducer::connect for explanations
-    // of other error codes.
-    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue);
+    // outputQueue is NULL. See IGraphicBufferProducer::connect and
+    // IGraphicBufferProducer::setAsyncMode for explanations of other error
+    // codes.
+    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue,
+            bool lossy = false);
 
     // setName sets the consumer name of the input queue
     void setName(const String8& name);
@@ -97,6 +106,12 @@ private:
     // onFrameAvailable call to proceed.
     void onBufferReleasedByOutput(const sp<IGraphicBufferProducer>& from);
 
+    // Does the work of onBufferReleasedByOutput. This is also called from
+    // onFrameAvailable when queueing to a lossy output has dropped the buffer
+    // that was queued to it before. This must be called with mMutex locked.
+    void onBufferReleasedByOutputLocked(
+            const sp<IGraphicBufferProducer>& from);
+
     // When this is called, the splitter disconnects from (i.e., abandons) its
     // input queue and signals any waiting onFrameAvailable calls to wake up.
     // It still processes callbacks from other outputs, but only detaches their
@@ -181,6 +181,13 @@ public:
             nsecs_t* outDisplayPresentTime, nsecs_t* outDequeueReadyTime,
             nsecs_t* outReleaseTime);
 
+    /* Returns the recent frame timestamps shared by the consumer, or nullptr if
+     * the consumer doesn't share them. Reading the ring doesn't take a lock or
+     * make a binder call, so it can be polled every frame. It doesn't depend
+     * on enableFrameTimestamps.
+     */
+    std::shared_ptr<FrameTimestampRing> getFrameTimestampRing();
+
     status_t getWideColorSupport(bool* supported);
     status_t getHdrSupport(bool* supported);
 
@@ -277,6 +284,9 @@ private:
     int dispatchGetLastQueuedBuffer(va_list args);
     int dispatchGetLastQueuedBuffer2(va_list args);
     int dispatchSetFrameTimelineInfo(va_list args);
+    int dispatchDequeueBuffers(va_list args);
+    int dispatchCancelBuffers(va_list args);
+    int dispatchQueueBuffers(va_list args);
 
 protected:
     virtual int dequeueBuffer(ANativeWindowBuffer** buffer, int* fenceFd);
@@ -577,6 +587,9 @@ protected:
     bool mEnableFrameTimestamps = false;
     std::unique_ptr<ProducerFrameEventHistory> mFrameEventHistory;
 
+    // Mapped on the first call to getFrameTimestampRing.
+    std::shared_ptr<FrameTimestampRing> mFrameTimestampRing;
+
     // Reference to the SurfaceFlinger layer that was used to create this
     // surface. This is only populated when the Surface is created from
     // a BlastBufferQueue.
@@ -586,6 +599,13 @@ protected:
     std::vector<sp<GraphicBuffer>> mRemovedBuffers;
     int mMaxBufferCount;
 
+    // Consumer usage bits reported by the producer on connect and on each
+    // queueBuffer. Queries for them are served locally while
+    // mHasConsumerUsage is set, which avoids a round trip for producers that
+    // check them every frame. Cleared on disconnect.
+    uint64_t mConsumerUsage = 0;
+    bool mHasConsumerUsage = false;
+
     sp<IProducerListener> mListenerProxy;
 
     // Get and flush the buffers of given slots, if the buffer in the slot
@@ -56,14 +56,16 @@ class Region;
 struct SurfaceControlStats {
     SurfaceControlStats(const sp<SurfaceControl>& sc, nsecs_t latchTime, nsecs_t acquireTime,
                         const sp<Fence>& presentFence, const sp<Fence>& prevReleaseFence,
-                        uint32_t hint, FrameEventHistoryStats eventStats)
+                        uint32_t hint, FrameEventHistoryStats eventStats,
+                        std::vector<JankData> jankData = {})
           : surfaceControl(sc),
             latchTime(latchTime),
             acquireTime(acquireTime),
             presentFence(presentFence),
             previousReleaseFence(prevReleaseFence),
             transformHint(hint),
-            frameEventStats(eventStats) {}
+            frameEventStats(eventStats),
+            jankData(std::move(jankData)) {}
 
     sp<SurfaceControl> surfaceControl;
     nsecs_t latchTime = -1;
@@ -72,6 +74,7 @@ struct SurfaceControlStats {
     sp<Fence> previousReleaseFence;
     uint32_t transformHint = 0;
     FrameEventHistoryStats frameEventStats;
+    std::vector<JankData> jankData;
 };
 
 using TransactionCompletedCallbackTakesContext =
@@ -398,6 +401,9 @@ public:
         layer_state_t* getLayerState(const sp<SurfaceControl>& sc);
         DisplayState& getDisplayState(const sp<IBinder>& token);
 
+        // Whether apply() may merge this transaction into the thread's pending one.
+        bool canCoalesce(bool synchronous) const;
+
         void cacheBuffers();
         void registerSurfaceControlForCallback(const sp<SurfaceControl>& sc);
         void setReleaseBufferCallback(layer_state_t*, const ReleaseCallbackId&,
@@ -419,6 +425,21 @@ public:
         void clear();
 
         status_t apply(bool synchronous = false);
+
+        // Opt-in transaction coalescing for the calling thread. While enabled, apply() merges
+        // the transaction into a pending transaction for the thread instead of sending it to
+        // SurfaceFlinger straight away, so that many small transactions cost one
+        // setTransactionState. Transactions which are applied synchronously, or which set an
+        // apply token, a desired present time, a buffer or the animation flag, are still sent
+        // as before, after flushing whatever is pending so that ordering is kept.
+        //
+        // Callers should flush at the end of their frame. If the thread has a Looper, pending
+        // transactions are otherwise applied by the frame deadline of the current vsync, or at
+        // the next vsync if there is none. Disabling coalescing flushes.
+        static void setCoalescingEnabled(bool enabled);
+        // Applies the calling thread's pending coalesced transaction, if there is one.
+        static status_t flushCoalesced();
+
         // Merge another transaction in to this one, clearing other
         // as if it had been applied.
         Transaction& merge(Transaction&& other);
@@ -732,6 +753,7 @@ public:
     void onTransactionCompleted(ListenerStats stats) override;
     void onReleaseBuffer(ReleaseCallbackId, sp<Fence> releaseFence, uint32_t transformHint,
                          uint32_t currentMaxAcquiredBufferCount) override;
+    void onBufferEvicted(uint64_t cacheId) override;
 
 private:
     ReleaseBufferCallback popReleaseBufferCallbackLocked(const ReleaseCallbackId&);
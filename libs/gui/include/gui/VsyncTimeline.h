@@ -0,0 +1,85 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+#include <memory>
+
+namespace android {
+
+// A vsync as read from a VsyncTimeline, with the same meaning as the fields of
+// DisplayEventReceiver::Event::VSync.
+struct VsyncTimelineEntry {
+    uint32_t count{0};
+    nsecs_t timestamp{0};
+    nsecs_t expectedVSyncTimestamp{0};
+    nsecs_t deadlineTimestamp{0};
+    int64_t vsyncId{0};
+};
+
+// A ring of recent vsyncs of an EventThread in memory shared between
+// SurfaceFlinger, which publishes every vsync it generates, and its clients,
+// which can read the latest vsync on demand instead of being woken up for
+// each one. Each vsync has its own slot, indexed by vsync count, guarded by a
+// sequence counter so readers never see a slot while it is being rewritten.
+//
+// Only SurfaceFlinger writes to the timeline, and it never trusts anything it
+// reads back from it.
+class VsyncTimeline {
+public:
+    // Number of vsyncs kept in the timeline.
+    static constexpr size_t kCapacity = 8;
+
+    ~VsyncTimeline();
+
+    // Creates a new timeline owned by SurfaceFlinger.
+    static std::shared_ptr<VsyncTimeline> create();
+
+    // Maps a timeline received from SurfaceFlinger through getFd(). The
+    // mapping is read-only, so publish() must not be called on the result.
+    static std::shared_ptr<VsyncTimeline> createFromFd(base::unique_fd fd);
+
+    // Returns a duplicate of the fd backing the timeline, to be sent to a
+    // client.
+    base::unique_fd getFd() const;
+
+    // Writes a vsync into its slot.
+    void publish(const VsyncTimelineEntry& vsync);
+
+    // Reads a vsync. Returns NAME_NOT_FOUND if the vsync was never published
+    // or has since been overwritten by a newer one, and WOULD_BLOCK if its
+    // slot kept changing while it was being read.
+    status_t getVsync(uint32_t count, VsyncTimelineEntry* outEntry) const;
+
+    // Reads the most recently published vsync, or returns NAME_NOT_FOUND if
+    // there isn't one yet.
+    status_t getLatestVsync(VsyncTimelineEntry* outEntry) const;
+
+private:
+    struct Layout;
+
+    VsyncTimeline(base::unique_fd fd, Layout* layout, bool writable);
+
+    const base::unique_fd mFd;
+    Layout* const mLayout;
+    const bool mWritable;
+};
+
+} // namespace android
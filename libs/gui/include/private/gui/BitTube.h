@@ -74,6 +74,20 @@ public:
         return recvObjects(tube, events, count, sizeof(T));
     }
 
+    // receive up to messageCount messages with a single system call. Message i is received into
+    // the objectsPerMessage objects at events + i * objectsPerMessage, and its object count is
+    // stored in outCounts[i]. Returns the number of messages received, so fewer than messageCount
+    // means that no more messages were pending.
+    template <typename T>
+    static ssize_t recvObjectMessages(BitTube* tube, T* events, size_t objectsPerMessage,
+                                      size_t messageCount, size_t* outCounts) {
+        return recvObjectMessages(tube, events, objectsPerMessage, messageCount, outCounts,
+                                  sizeof(T));
+    }
+
+    // the maximum number of messages received by recvObjectMessages.
+    static constexpr size_t MAX_MESSAGES_PER_READ = 16;
+
     // implement the Parcelable protocol. Only parcels the receive file descriptor
     status_t writeToParcel(Parcel* reply) const;
     status_t readFromParcel(const Parcel* parcel);
@@ -88,12 +102,19 @@ private:
     // the message, excess data is silently discarded.
     ssize_t read(void* vaddr, size_t size);
 
+    // receive up to messageCount messages of at most messageSize bytes each, into consecutive
+    // slots of messageSize bytes. The size of each message is stored in outSizes.
+    ssize_t readMessages(void* vaddr, size_t messageSize, size_t messageCount, size_t* outSizes);
+
     mutable base::unique_fd mSendFd;
     mutable base::unique_fd mReceiveFd;
 
     static ssize_t sendObjects(BitTube* tube, void const* events, size_t count, size_t objSize);
 
     static ssize_t recvObjects(BitTube* tube, void* events, size_t count, size_t objSize);
+
+    static ssize_t recvObjectMessages(BitTube* tube, void* events, size_t objectsPerMessage,
+                                      size_t messageCount, size_t* outCounts, size_t objSize);
 };
 
 } // namespace gui
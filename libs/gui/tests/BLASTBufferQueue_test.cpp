@@ -75,6 +75,29 @@ public:
         return mBlastBufferQueueAdapter->getSurface(false /* includeSurfaceControlHandle */);
     }
 
+    void setAdaptiveBufferCountEnabled(bool enabled) {
+        mBlastBufferQueueAdapter->setAdaptiveBufferCountEnabled(enabled);
+    }
+
+    // Feeds one window of classified frames, 'misses' of which missed their deadline, and
+    // returns the max dequeued buffer count the adapter ends up with.
+    int32_t onJankWindow(uint32_t misses) {
+        std::vector<JankData> jankData(BLASTBufferQueue::kAdaptiveWindowFrames);
+        for (uint32_t i = 0; i < misses; i++) {
+            jankData[i].jankType = JankType::AppDeadlineMissed;
+        }
+        int32_t count;
+        {
+            std::unique_lock lock{mBlastBufferQueueAdapter->mMutex};
+            count = mBlastBufferQueueAdapter->updateAdaptiveBufferCountLocked(jankData);
+        }
+        if (count > 0) {
+            mBlastBufferQueueAdapter->applyMaxDequeuedBufferCount(count);
+        }
+        std::unique_lock lock{mBlastBufferQueueAdapter->mMutex};
+        return mBlastBufferQueueAdapter->mMaxDequeuedBufferCount;
+    }
+
     void waitForCallbacks() {
         std::unique_lock lock{mBlastBufferQueueAdapter->mMutex};
         // Wait until all but one of the submitted buffers have been released.
@@ -316,6 +339,27 @@ TEST_F(BLASTBufferQueueTest, Update) {
     ASSERT_EQ(mDisplayHeight / 2, height);
 }
 
+TEST_F(BLASTBufferQueueTest, AdaptiveBufferCount) {
+    BLASTBufferQueueHelper adapter(mSurfaceControl, mDisplayWidth, mDisplayHeight);
+    adapter.setAdaptiveBufferCountEnabled(true);
+
+    // Triple buffered until the app has kept up for three windows in a row
+    ASSERT_EQ(2, adapter.onJankWindow(0));
+    ASSERT_EQ(2, adapter.onJankWindow(1));
+    ASSERT_EQ(2, adapter.onJankWindow(0));
+    ASSERT_EQ(2, adapter.onJankWindow(0));
+    ASSERT_EQ(1, adapter.onJankWindow(0));
+
+    // A single miss is tolerated, a second one adds headroom back
+    ASSERT_EQ(1, adapter.onJankWindow(1));
+    ASSERT_EQ(2, adapter.onJankWindow(2));
+
+    adapter.setAdaptiveBufferCountEnabled(false);
+    ASSERT_EQ(2, adapter.onJankWindow(0));
+    ASSERT_EQ(2, adapter.onJankWindow(0));
+    ASSERT_EQ(2, adapter.onJankWindow(0));
+}
+
 TEST_F(BLASTBufferQueueTest, SetNextTransaction) {
     BLASTBufferQueueHelper adapter(mSurfaceControl, mDisplayWidth, mDisplayHeight);
     Transaction next;
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <private/gui/BitTube.h>
+
+namespace android::test {
+
+using gui::BitTube;
+
+TEST(BitTubeTest, RecvObjectMessages) {
+    BitTube tube(BitTube::DefaultSize);
+    ASSERT_EQ(NO_ERROR, tube.initCheck());
+
+    const int first[] = {1};
+    const int second[] = {2, 3, 4};
+    ASSERT_EQ(1, BitTube::sendObjects(&tube, first, 1));
+    ASSERT_EQ(3, BitTube::sendObjects(&tube, second, 3));
+
+    constexpr size_t kObjectsPerMessage = 4;
+    int objects[kObjectsPerMessage * 4] = {};
+    size_t counts[4];
+    ASSERT_EQ(2, BitTube::recvObjectMessages(&tube, objects, kObjectsPerMessage, 4, counts));
+
+    EXPECT_EQ(1u, counts[0]);
+    EXPECT_EQ(1, objects[0]);
+
+    EXPECT_EQ(3u, counts[1]);
+    EXPECT_EQ(2, objects[kObjectsPerMessage]);
+    EXPECT_EQ(3, objects[kObjectsPerMessage + 1]);
+    EXPECT_EQ(4, objects[kObjectsPerMessage + 2]);
+
+    // Drained.
+    EXPECT_EQ(0, BitTube::recvObjectMessages(&tube, objects, kObjectsPerMessage, 4, counts));
+}
+
+TEST(BitTubeTest, RecvObjectMessagesUpToCount) {
+    BitTube tube(BitTube::DefaultSize);
+    ASSERT_EQ(NO_ERROR, tube.initCheck());
+
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(1, BitTube::sendObjects(&tube, &i, 1));
+    }
+
+    int objects[2];
+    size_t counts[2];
+    ASSERT_EQ(2, BitTube::recvObjectMessages(&tube, objects, 1, 2, counts));
+    EXPECT_EQ(0, objects[0]);
+    EXPECT_EQ(1, objects[1]);
+
+    ASSERT_EQ(1, BitTube::recvObjectMessages(&tube, objects, 1, 2, counts));
+    EXPECT_EQ(1u, counts[0]);
+    EXPECT_EQ(2, objects[0]);
+}
+
+} // namespace android::test
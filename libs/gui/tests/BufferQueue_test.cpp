@@ -36,7 +36,9 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
 #include <thread>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -381,6 +383,52 @@ TEST_F(BufferQueueTest, DetachAndReattachOnProducerSide) {
     ASSERT_EQ(OK, item.mGraphicBuffer->unlock());
 }
 
+// Records consumer listener callbacks. Each one calls back into the consumer,
+// which would deadlock if the callback was made with the BufferQueue lock held.
+struct LockCheckingConsumer : public MockConsumer {
+    void onFrameDequeued(const uint64_t bufferId) override { record("dequeued", bufferId); }
+    void onFrameCancelled(const uint64_t bufferId) override { record("cancelled", bufferId); }
+    void onFrameDetached(const uint64_t bufferId) override { record("detached", bufferId); }
+
+    void record(const char* event, uint64_t bufferId) {
+        uint64_t mask;
+        EXPECT_EQ(OK, consumer->getReleasedBuffers(&mask));
+        events.push_back(std::string(event) + " " + std::to_string(bufferId));
+    }
+
+    // not owned, the consumer holds on to this listener
+    IGraphicBufferConsumer* consumer = nullptr;
+    std::vector<std::string> events;
+};
+
+TEST_F(BufferQueueTest, ConsumerListenerCalledWithoutBufferQueueLock) {
+    createBufferQueue();
+    sp<LockCheckingConsumer> mc = sp<LockCheckingConsumer>::make();
+    mc->consumer = mConsumer.get();
+    ASSERT_EQ(OK, mConsumer->consumerConnect(mc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK,
+              mProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false, &output));
+
+    int slot;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                       nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(OK, mProducer->cancelBuffer(slot, Fence::NO_FENCE));
+    ASSERT_EQ(OK,
+              mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                       nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->detachBuffer(slot));
+
+    const std::string id = std::to_string(buffer->getId());
+    EXPECT_EQ((std::vector<std::string>{"dequeued " + id, "cancelled " + id, "dequeued " + id,
+                                        "detached " + id}),
+              mc->events);
+}
+
 TEST_F(BufferQueueTest, DetachAndReattachOnConsumerSide) {
     createBufferQueue();
     sp<MockConsumer> mc(new MockConsumer);
@@ -1224,4 +1272,39 @@ TEST_F(BufferQueueTest, TestProducerConnectDisconnect) {
     ASSERT_EQ(NO_INIT, mProducer->disconnect(NATIVE_WINDOW_API_CPU));
 }
 
+TEST_F(BufferQueueTest, PreallocatedBuffersFollowDefaultBufferSize) {
+    createBufferQueue();
+    sp<MockConsumer> mc(new MockConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(mc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false,
+                                     &output));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(2));
+    ASSERT_EQ(OK, mConsumer->setDefaultBufferSize(100, 100));
+    mProducer->allocateBuffers(0, 0, PIXEL_FORMAT_RGBA_8888, GRALLOC_USAGE_SW_READ_OFTEN);
+
+    // Resizing replaces the preallocated buffers in the background. Whether or
+    // not that has finished, every buffer handed out has to be reported as
+    // new, and have the new size.
+    ASSERT_EQ(OK, mConsumer->setDefaultBufferSize(200, 100));
+
+    std::vector<int> slots;
+    for (int i = 0; i < 2; i++) {
+        int slot;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buffer;
+        status_t result = mProducer->dequeueBuffer(&slot, &fence, 0, 0, PIXEL_FORMAT_RGBA_8888,
+                                                   GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr);
+        ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION, result);
+        ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+        EXPECT_EQ(200u, buffer->getWidth());
+        EXPECT_EQ(100u, buffer->getHeight());
+        slots.push_back(slot);
+    }
+    for (int slot : slots) {
+        ASSERT_EQ(OK, mProducer->cancelBuffer(slot, Fence::NO_FENCE));
+    }
+    ASSERT_EQ(OK, mProducer->disconnect(NATIVE_WINDOW_API_CPU));
+}
+
 } // namespace android
@@ -610,6 +610,43 @@ TEST_P(CpuConsumerTest, FromCpuManyInQueue) {
 
 // This test is disabled because the HAL_PIXEL_FORMAT_RAW16 format is not
 // supported on all devices.
+TEST_P(CpuConsumerTest, FromCpuPersistentMapping) {
+    status_t err;
+    CpuConsumerTestParams params = GetParam();
+
+    // Few enough buffers that each of them is acquired several times
+    const int numFrames = 8;
+    ASSERT_NO_FATAL_FAILURE(configureANW(mANW, params, 1));
+
+    mCC->setPersistentMappingEnabled(true);
+
+    for (int i = 0; i < numFrames; i++) {
+        ALOGV("Producing frame %d", i);
+        const int64_t time = 12345678L + i;
+        uint32_t stride;
+        ASSERT_NO_FATAL_FAILURE(produceOneFrame(mANW, params, time, &stride));
+
+        CpuConsumer::LockedBuffer b;
+        err = mCC->lockNextBuffer(&b);
+        ASSERT_NO_ERROR(err, "getNextBuffer error: ");
+
+        ASSERT_TRUE(b.data != nullptr);
+        EXPECT_EQ(params.width, b.width);
+        EXPECT_EQ(params.height, b.height);
+        EXPECT_EQ(params.format, b.format);
+        EXPECT_EQ(stride, b.stride);
+        EXPECT_EQ(time, b.timestamp);
+        EXPECT_EQ(static_cast<uint64_t>(i + 1), b.frameNumber);
+
+        checkAnyBuffer(b, GetParam().format);
+
+        err = mCC->unlockBuffer(b);
+        ASSERT_NO_ERROR(err, "unlockBuffer error: ");
+    }
+
+    mCC->setPersistentMappingEnabled(false);
+}
+
 TEST_P(CpuConsumerTest, FromCpuLockMax) {
     status_t err;
     CpuConsumerTestParams params = GetParam();
@@ -1117,6 +1117,50 @@ TEST_P(IGraphicBufferProducerTest, DetachThenAttach_Succeeds) {
     }
 }
 
+TEST(QueueBufferInputTest, ParcelsSurfaceDamageAndHdrMetadata) {
+    using QueueBufferInput = IGraphicBufferProducer::QueueBufferInput;
+
+    auto roundTrip = [](const QueueBufferInput& input) {
+        Parcel parcel;
+        EXPECT_OK(parcel.write(input));
+        parcel.setDataPosition(0);
+        return QueueBufferInput(parcel);
+    };
+
+    QueueBufferInput input(QUEUE_BUFFER_INPUT_TIMESTAMP, QUEUE_BUFFER_INPUT_IS_AUTO_TIMESTAMP,
+                           QUEUE_BUFFER_INPUT_DATASPACE, QUEUE_BUFFER_INPUT_RECT,
+                           QUEUE_BUFFER_INPUT_SCALING_MODE, QUEUE_BUFFER_INPUT_TRANSFORM,
+                           Fence::NO_FENCE, QUEUE_BUFFER_INPUT_STICKY_TRANSFORM,
+                           QUEUE_BUFFER_INPUT_GET_TIMESTAMPS, 3);
+
+    // Full surface damage without HDR metadata, which is parcelled compactly
+    input.setSurfaceDamage(Region::INVALID_REGION);
+    QueueBufferInput output = roundTrip(input);
+    EXPECT_EQ(QUEUE_BUFFER_INPUT_TIMESTAMP, output.timestamp);
+    EXPECT_EQ(QUEUE_BUFFER_INPUT_RECT, output.crop);
+    EXPECT_EQ(3, output.slot);
+    EXPECT_TRUE(output.getSurfaceDamage().isRect());
+    EXPECT_EQ(Rect::INVALID_RECT, output.getSurfaceDamage().bounds());
+    EXPECT_EQ(HdrMetadata(), output.getHdrMetadata());
+
+    // Partial damage and HDR metadata
+    Region damage(Rect(1, 2, 3, 4));
+    damage.orSelf(Rect(5, 6, 7, 8));
+    HdrMetadata hdrMetadata;
+    hdrMetadata.validTypes = HdrMetadata::CTA861_3 | HdrMetadata::HDR10PLUS;
+    hdrMetadata.cta8613.maxContentLightLevel = 1000.0f;
+    hdrMetadata.cta8613.maxFrameAverageLightLevel = 400.0f;
+    hdrMetadata.hdr10plus = {1, 2, 3};
+    input.setSurfaceDamage(damage);
+    input.setHdrMetadata(hdrMetadata);
+    output = roundTrip(input);
+    EXPECT_EQ(QUEUE_BUFFER_INPUT_TIMESTAMP, output.timestamp);
+    EXPECT_EQ(3, output.slot);
+    EXPECT_TRUE(output.getSurfaceDamage().subtract(damage).isEmpty());
+    EXPECT_TRUE(damage.subtract(output.getSurfaceDamage()).isEmpty());
+    EXPECT_EQ(hdrMetadata, output.getHdrMetadata());
+}
+
 #if USE_BUFFER_HUB_AS_BUFFER_QUEUE
 INSTANTIATE_TEST_CASE_P(IGraphicBufferProducerBackends, IGraphicBufferProducerTest,
                         ::testing::Values(USE_BUFFER_QUEUE_PRODUCER, USE_BUFFER_HUB_PRODUCER));
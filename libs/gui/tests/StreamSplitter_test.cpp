@@ -196,6 +196,80 @@ TEST_F(StreamSplitterTest, OneInputMultipleOutputs) {
                                            nullptr, nullptr));
 }
 
+TEST_F(StreamSplitterTest, LossyOutputDoesNotStallOtherOutputs) {
+    const int NUM_FRAMES = 4;
+
+    sp<IGraphicBufferProducer> inputProducer;
+    sp<IGraphicBufferConsumer> inputConsumer;
+    BufferQueue::createBufferQueue(&inputProducer, &inputConsumer);
+
+    sp<IGraphicBufferProducer> outputProducer;
+    sp<IGraphicBufferConsumer> outputConsumer;
+    BufferQueue::createBufferQueue(&outputProducer, &outputConsumer);
+    ASSERT_EQ(OK, outputConsumer->consumerConnect(new FakeListener, false));
+
+    sp<IGraphicBufferProducer> lossyProducer;
+    sp<IGraphicBufferConsumer> lossyConsumer;
+    BufferQueue::createBufferQueue(&lossyProducer, &lossyConsumer);
+    ASSERT_EQ(OK, lossyConsumer->consumerConnect(new FakeListener, false));
+
+    sp<StreamSplitter> splitter;
+    status_t status = StreamSplitter::createSplitter(inputConsumer, &splitter);
+    ASSERT_EQ(OK, status);
+    ASSERT_EQ(OK, splitter->addOutput(outputProducer));
+    ASSERT_EQ(OK, splitter->addOutput(lossyProducer, /* lossy */ true));
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    ASSERT_EQ(OK,
+              inputProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false,
+                                     &qbOutput));
+
+    // The lossy output's consumer never acquires anything while frames are
+    // queued. Without dropping, the splitter would run out of outstanding
+    // buffers and block the input after the second frame.
+    for (int frame = 0; frame < NUM_FRAMES; ++frame) {
+        int slot;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buffer;
+        status_t result = inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                                                       GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr,
+                                                       nullptr);
+        ASSERT_GE(result, OK);
+        ASSERT_EQ(OK, inputProducer->requestBuffer(slot, &buffer));
+
+        uint32_t* dataIn;
+        ASSERT_EQ(OK, buffer->lock(GraphicBuffer::USAGE_SW_WRITE_OFTEN,
+                reinterpret_cast<void**>(&dataIn)));
+        *dataIn = TEST_DATA + frame;
+        ASSERT_EQ(OK, buffer->unlock());
+
+        IGraphicBufferProducer::QueueBufferInput qbInput(frame + 1, false,
+                HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+                NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+        ASSERT_EQ(OK, inputProducer->queueBuffer(slot, qbInput, &qbOutput));
+
+        BufferItem item;
+        ASSERT_EQ(OK, outputConsumer->acquireBuffer(&item, 0));
+        ASSERT_EQ(frame + 1, item.mTimestamp);
+        ASSERT_EQ(OK, outputConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    }
+
+    // Only the latest frame is left in the lossy output
+    BufferItem item;
+    ASSERT_EQ(OK, lossyConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(NUM_FRAMES, item.mTimestamp);
+
+    uint32_t* dataOut;
+    ASSERT_EQ(OK, item.mGraphicBuffer->lock(GraphicBuffer::USAGE_SW_READ_OFTEN,
+            reinterpret_cast<void**>(&dataOut)));
+    ASSERT_EQ(*dataOut, TEST_DATA + NUM_FRAMES - 1);
+    ASSERT_EQ(OK, item.mGraphicBuffer->unlock());
+
+    ASSERT_EQ(OK, lossyConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+}
+
 TEST_F(StreamSplitterTest, OutputAbandonment) {
     sp<IGraphicBufferProducer> inputProducer;
     sp<IGraphicBufferConsumer> inputConsumer;
@@ -333,6 +333,38 @@ TEST_F(SurfaceTest, QueryConsumerUsage) {
     ASSERT_EQ(TEST_USAGE_FLAGS, flags);
 }
 
+TEST_F(SurfaceTest, QueryConsumerUsageUpdatesOnQueue) {
+    const uint64_t TEST_USAGE_FLAGS = GRALLOC_USAGE_SW_READ_OFTEN;
+    const uint64_t NEW_USAGE_FLAGS = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_HW_TEXTURE;
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<BufferItemConsumer> c = new BufferItemConsumer(consumer, TEST_USAGE_FLAGS);
+    sp<Surface> s = new Surface(producer);
+
+    sp<ANativeWindow> anw(s);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(anw.get(), NATIVE_WINDOW_API_CPU));
+
+    uint64_t usage = 0;
+    ASSERT_EQ(NO_ERROR, s->getConsumerUsage(&usage));
+    EXPECT_EQ(TEST_USAGE_FLAGS, usage);
+
+    // The cached value is refreshed by the next queueBuffer.
+    ASSERT_EQ(NO_ERROR, consumer->setConsumerUsageBits(NEW_USAGE_FLAGS));
+    ANativeWindowBuffer* buffer;
+    int fenceFd;
+    ASSERT_EQ(NO_ERROR, anw->dequeueBuffer(anw.get(), &buffer, &fenceFd));
+    ASSERT_EQ(NO_ERROR, anw->queueBuffer(anw.get(), buffer, fenceFd));
+
+    ASSERT_EQ(NO_ERROR, s->getConsumerUsage(&usage));
+    EXPECT_EQ(NEW_USAGE_FLAGS, usage);
+    int flags = -1;
+    ASSERT_EQ(NO_ERROR, anw->query(anw.get(), NATIVE_WINDOW_CONSUMER_USAGE_BITS, &flags));
+    EXPECT_EQ(static_cast<int>(NEW_USAGE_FLAGS), flags);
+
+    ASSERT_EQ(NO_ERROR, native_window_api_disconnect(anw.get(), NATIVE_WINDOW_API_CPU));
+}
+
 TEST_F(SurfaceTest, QueryDefaultBuffersDataSpace) {
     const android_dataspace TEST_DATASPACE = HAL_DATASPACE_V0_SRGB;
     sp<IGraphicBufferProducer> producer;
@@ -666,6 +698,15 @@ public:
         mAddAndGetFrameTimestampsCallCount++;
     }
 
+    status_t getFrameTimestampRing(base::unique_fd* outFd) override {
+        std::shared_ptr<FrameTimestampRing> ring = mFrameEventHistory.getTimestampRing();
+        if (ring == nullptr) {
+            return NO_MEMORY;
+        }
+        *outFd = ring->getFd();
+        return NO_ERROR;
+    }
+
     bool mGetFrameTimestampsEnabled = false;
 
     ConsumerFrameEventHistory mFrameEventHistory;
@@ -1337,6 +1378,53 @@ TEST_F(GetFrameTimestampsTest, EnabledSimple) {
     EXPECT_EQ(4, mFakeConsumer->mGetFrameTimestampsCount);
 }
 
+// This test verifies that the timestamps recorded by the consumer can be read
+// from the ring it shares, without asking the consumer for them.
+TEST_F(GetFrameTimestampsTest, FrameTimestampRing) {
+    enableFrameTimestamps();
+
+    std::shared_ptr<FrameTimestampRing> ring = mSurface->getFrameTimestampRing();
+    ASSERT_NE(nullptr, ring);
+    EXPECT_EQ(ring, mSurface->getFrameTimestampRing());
+    EXPECT_EQ(0u, ring->getLatestFrameNumber());
+
+    const uint64_t fId1 = getNextFrameId();
+    dequeueAndQueue(0);
+    mFrames[0].signalQueueFences();
+    addFrameEvents(true, NO_FRAME_INDEX, 0);
+
+    // Reading the ring doesn't call into the consumer.
+    int getFrameTimestampsCount = mFakeConsumer->mGetFrameTimestampsCount;
+    FrameTimestampRingEntry entry;
+    ASSERT_EQ(NO_ERROR, ring->getFrame(fId1, &entry));
+    EXPECT_EQ(fId1, ring->getLatestFrameNumber());
+    EXPECT_EQ(fId1, entry.frameNumber);
+    EXPECT_EQ(mFrames[0].kPostedTime, entry.postedTime);
+    EXPECT_EQ(mFrames[0].kRequestedPresentTime, entry.requestedPresentTime);
+    EXPECT_EQ(mFrames[0].kConsumerAcquireTime, entry.acquireTime);
+    EXPECT_EQ(mFrames[0].kLatchTime, entry.latchTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_PENDING, entry.displayPresentTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_PENDING, entry.dequeueReadyTime);
+    EXPECT_EQ(getFrameTimestampsCount, mFakeConsumer->mGetFrameTimestampsCount);
+
+    // The present fence is picked up on the next composition once it signals.
+    mFrames[0].signalRefreshFences();
+    const uint64_t fId2 = getNextFrameId();
+    dequeueAndQueue(1);
+    addFrameEvents(true, 0, 1);
+
+    getFrameTimestampsCount = mFakeConsumer->mGetFrameTimestampsCount;
+    ASSERT_EQ(NO_ERROR, ring->getFrame(fId1, &entry));
+    EXPECT_EQ(mFrames[0].mRefreshes[0].kPresentTime, entry.displayPresentTime);
+    EXPECT_EQ(mFrames[0].kDequeueReadyTime, entry.dequeueReadyTime);
+    EXPECT_EQ(fId2, ring->getLatestFrameNumber());
+
+    // Frames that were never queued, or have been overwritten, aren't found.
+    EXPECT_EQ(NAME_NOT_FOUND, ring->getFrame(fId2 + 1, &entry));
+    EXPECT_EQ(NAME_NOT_FOUND, ring->getFrame(fId1 + FrameTimestampRing::kCapacity, &entry));
+    EXPECT_EQ(getFrameTimestampsCount, mFakeConsumer->mGetFrameTimestampsCount);
+}
+
 TEST_F(GetFrameTimestampsTest, QueryPresentSupported) {
     bool displayPresentSupported = true;
     mSurface->mFakeSurfaceComposer->setSupportsPresent(displayPresentSupported);
@@ -2092,6 +2180,36 @@ TEST_F(SurfaceTest, BatchOperations) {
     ASSERT_EQ(NO_ERROR, surface->disconnect(NATIVE_WINDOW_API_CPU));
 }
 
+TEST_F(SurfaceTest, BatchOperationsThroughANativeWindow) {
+    const int BUFFER_COUNT = 16;
+    const int BATCH_SIZE = 8;
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+
+    sp<CpuConsumer> cpuConsumer = new CpuConsumer(consumer, 1);
+    sp<Surface> surface = new Surface(producer);
+    sp<ANativeWindow> window(surface);
+
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+    ASSERT_EQ(NO_ERROR, native_window_set_buffer_count(window.get(), BUFFER_COUNT));
+
+    ANativeWindowBuffer* buffers[BATCH_SIZE];
+    int fences[BATCH_SIZE];
+
+    ASSERT_EQ(NO_ERROR, native_window_dequeue_buffers(window.get(), buffers, fences, BATCH_SIZE));
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+        ASSERT_NE(nullptr, buffers[i]);
+    }
+    ASSERT_EQ(NO_ERROR, native_window_cancel_buffers(window.get(), buffers, fences, BATCH_SIZE));
+
+    ASSERT_EQ(NO_ERROR, native_window_dequeue_buffers(window.get(), buffers, fences, BATCH_SIZE));
+    ASSERT_EQ(NO_ERROR,
+              native_window_queue_buffers(window.get(), buffers, fences, nullptr, BATCH_SIZE));
+
+    ASSERT_EQ(NO_ERROR, native_window_api_disconnect(window.get(), NATIVE_WINDOW_API_CPU));
+}
+
 TEST_F(SurfaceTest, BatchIllegalOperations) {
     const int BUFFER_COUNT = 16;
     const int BATCH_SIZE = 8;
@@ -23,12 +23,17 @@ static constexpr bool DEBUG_TRANSPORT_ACTIONS = false;
 #include <fcntl.h>
 #include <inttypes.h>
 #include <math.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+
 #include <android-base/stringprintf.h>
 #include <binder/Parcel.h>
+#include <cutils/ashmem.h>
 #include <cutils/properties.h>
 #include <log/log.h>
 #include <utils/Trace.h>
@@ -64,6 +69,10 @@ static const nsecs_t RESAMPLE_MAX_DELTA = 20 * NANOS_PER_MS;
 // far into the future.  This time is further bounded by 50% of the last time delta.
 static const nsecs_t RESAMPLE_MAX_PREDICTION = 8 * NANOS_PER_MS;
 
+// Maximum time a touch predictor may predict forward from the last known state, about a frame
+// at 60Hz. Past that a velocity model says more about its own assumptions than about the touch.
+static const nsecs_t RESAMPLE_MAX_MODEL_PREDICTION = 16 * NANOS_PER_MS;
+
 /**
  * System property for enabling / disabling touch resampling.
  * Resampling extrapolates / interpolates the reported touch event coordinates to better
@@ -76,11 +85,34 @@ static const nsecs_t RESAMPLE_MAX_PREDICTION = 8 * NANOS_PER_MS;
  */
 static const char* PROPERTY_RESAMPLING_ENABLED = "ro.input.resampling";
 
+/**
+ * System property for making input channels exchange messages through shared memory.
+ * The socket of the channel is then only used to wake up the receiving end, which saves a
+ * system call per message on each side when events arrive faster than they are consumed, e.g.
+ * for high rate styluses.
+ * Set to "1" to use shared memory.
+ * Set to "0" to send every message through the socket (default).
+ */
+static const char* PROPERTY_SHARED_MEMORY_TRANSPORT = "ro.input.shared_memory_transport";
+
+// Number of messages each direction of a shared memory channel can hold. About the number of
+// large motion events that fit in SOCKET_BUFFER_SIZE.
+static constexpr uint32_t SHARED_MEMORY_RING_CAPACITY = 16;
+
 template<typename T>
 inline static T min(const T& a, const T& b) {
     return a < b ? a : b;
 }
 
+// Evaluates the polynomial with the given coefficients, lowest degree first, at x.
+static float evaluatePolynomial(const float* coefficients, uint32_t degree, float x) {
+    float result = 0;
+    for (int32_t i = degree; i >= 0; i--) {
+        result = result * x + coefficients[i];
+    }
+    return result;
+}
+
 inline static float lerp(float a, float b, float alpha) {
     return a + alpha * (b - a);
 }
@@ -294,6 +326,127 @@ void InputMessage::getSanitizedCopy(InputMessage* msg) const {
     }
 }
 
+// Motion events are sent with only the values of the axes their pointers have, which are the
+// first BitSet64::count(bits) entries of PointerCoords::values. Each pointer is written as its
+// properties, its bits and those values, right after the previous one. Other messages are sent
+// as is.
+static constexpr size_t MOTION_POINTERS_OFFSET =
+        offsetof(InputMessage, body) + offsetof(InputMessage::Body::Motion, pointers);
+
+static size_t encodeMessage(const InputMessage& msg, InputMessage* outWireMsg) {
+    if (msg.header.type != InputMessage::Type::MOTION) {
+        const size_t size = msg.size();
+        memcpy(outWireMsg, &msg, size);
+        return size;
+    }
+    uint8_t* out = reinterpret_cast<uint8_t*>(outWireMsg);
+    memcpy(out, &msg, MOTION_POINTERS_OFFSET);
+    size_t size = MOTION_POINTERS_OFFSET;
+    for (uint32_t i = 0; i < msg.body.motion.pointerCount; i++) {
+        const InputMessage::Body::Motion::Pointer& pointer = msg.body.motion.pointers[i];
+        memcpy(out + size, &pointer.properties, sizeof(PointerProperties));
+        size += sizeof(PointerProperties);
+        memcpy(out + size, &pointer.coords.bits, sizeof(pointer.coords.bits));
+        size += sizeof(pointer.coords.bits);
+        const size_t valuesSize = sizeof(float) *
+                std::min(BitSet64::count(pointer.coords.bits),
+                         static_cast<uint32_t>(PointerCoords::MAX_AXES));
+        memcpy(out + size, pointer.coords.values, valuesSize);
+        size += valuesSize;
+    }
+    return size;
+}
+
+static bool decodeMessage(const InputMessage& wireMsg, size_t size, InputMessage* outMsg) {
+    if (size > sizeof(InputMessage) || size < sizeof(InputMessage::Header)) {
+        ALOGE("Received message of incorrect size %zu", size);
+        return false;
+    }
+    if (wireMsg.header.type != InputMessage::Type::MOTION) {
+        memcpy(outMsg, &wireMsg, size);
+        return outMsg->isValid(size);
+    }
+    if (size < MOTION_POINTERS_OFFSET) {
+        ALOGE("Received MOTION of incorrect size %zu", size);
+        return false;
+    }
+    memcpy(outMsg, &wireMsg, MOTION_POINTERS_OFFSET);
+    const uint32_t pointerCount = outMsg->body.motion.pointerCount;
+    if (pointerCount == 0 || pointerCount > MAX_POINTERS) {
+        ALOGE("Received invalid MOTION: pointerCount = %" PRIu32, pointerCount);
+        return false;
+    }
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(&wireMsg);
+    size_t offset = MOTION_POINTERS_OFFSET;
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        InputMessage::Body::Motion::Pointer& pointer = outMsg->body.motion.pointers[i];
+        if (size - offset < sizeof(PointerProperties) + sizeof(pointer.coords.bits)) {
+            ALOGE("Received MOTION truncated at pointer %" PRIu32, i);
+            return false;
+        }
+        memcpy(&pointer.properties, in + offset, sizeof(PointerProperties));
+        offset += sizeof(PointerProperties);
+        memcpy(&pointer.coords.bits, in + offset, sizeof(pointer.coords.bits));
+        offset += sizeof(pointer.coords.bits);
+        const uint32_t valueCount = BitSet64::count(pointer.coords.bits);
+        if (valueCount > PointerCoords::MAX_AXES || size - offset < sizeof(float) * valueCount) {
+            ALOGE("Received MOTION with %" PRIu32 " axes truncated at pointer %" PRIu32,
+                  valueCount, i);
+            return false;
+        }
+        memcpy(pointer.coords.values, in + offset, sizeof(float) * valueCount);
+        offset += sizeof(float) * valueCount;
+        std::fill(pointer.coords.values + valueCount,
+                  pointer.coords.values + PointerCoords::MAX_AXES, 0.f);
+    }
+    if (offset != size) {
+        ALOGE("Received MOTION with %zu extra bytes", size - offset);
+        return false;
+    }
+    return outMsg->isValid(outMsg->size());
+}
+
+// --- InputChannel::SharedMemory ---
+
+namespace {
+
+// Single producer, single consumer queue of messages. head and tail only go up; the slot of a
+// message is its index modulo the capacity.
+struct MessageRing {
+    struct Slot {
+        uint32_t size;
+        uint32_t empty1;
+        InputMessage message;
+    };
+
+    // Index of the next message to receive. Only written by the receiver.
+    alignas(64) std::atomic<uint32_t> head;
+    // Index of the next message to send. Only written by the sender.
+    alignas(64) std::atomic<uint32_t> tail;
+    // Wake ups written to the socket and not read yet. The sender only writes one when there are
+    // none, so that the messages it sends before the receiver wakes up share a single one.
+    alignas(64) std::atomic<uint32_t> pendingWakeUps;
+    Slot slots[SHARED_MEMORY_RING_CAPACITY];
+};
+
+// The rings are zero-filled when the memory is created, which is their initial state.
+struct MessageRings {
+    MessageRing toClient;
+    MessageRing toServer;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "Shared memory rings rely on lock-free atomics across processes");
+
+} // namespace
+
+struct InputChannel::SharedMemory {
+    explicit SharedMemory(MessageRings* rings) : rings(rings) {}
+    ~SharedMemory() { munmap(rings, sizeof(MessageRings)); }
+
+    MessageRings* const rings;
+};
+
 // --- InputChannel ---
 
 std::unique_ptr<InputChannel> InputChannel::create(const std::string& name,
@@ -324,6 +477,14 @@ InputChannel::~InputChannel() {
 status_t InputChannel::openInputChannelPair(const std::string& name,
                                             std::unique_ptr<InputChannel>& outServerChannel,
                                             std::unique_ptr<InputChannel>& outClientChannel) {
+    static const bool useSharedMemory = property_get_bool(PROPERTY_SHARED_MEMORY_TRANSPORT, false);
+    return openInputChannelPair(name, outServerChannel, outClientChannel, useSharedMemory);
+}
+
+status_t InputChannel::openInputChannelPair(const std::string& name,
+                                            std::unique_ptr<InputChannel>& outServerChannel,
+                                            std::unique_ptr<InputChannel>& outClientChannel,
+                                            bool useSharedMemory) {
     int sockets[2];
     if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets)) {
         status_t result = -errno;
@@ -349,16 +510,59 @@ status_t InputChannel::openInputChannelPair(const std::string& name,
     std::string clientChannelName = name + " (client)";
     android::base::unique_fd clientFd(sockets[1]);
     outClientChannel = InputChannel::create(clientChannelName, std::move(clientFd), token);
+
+    if (useSharedMemory) {
+        status_t result = OK;
+        android::base::unique_fd sharedMemoryFd(
+                ashmem_create_region(name.c_str(), sizeof(MessageRings)));
+        android::base::unique_fd clientSharedMemoryFd(sharedMemoryFd.ok() ? ::dup(sharedMemoryFd)
+                                                                           : -1);
+        if (!clientSharedMemoryFd.ok()) {
+            result = -errno;
+        } else {
+            result = outServerChannel->attachSharedMemory(std::move(sharedMemoryFd), true)
+                    ?: outClientChannel->attachSharedMemory(std::move(clientSharedMemoryFd), false);
+        }
+        if (result != OK) {
+            ALOGE("channel '%s' ~ Could not set up shared memory: %s(%d)", name.c_str(),
+                  strerror(-result), -result);
+            outServerChannel.reset();
+            outClientChannel.reset();
+            return result;
+        }
+    }
+    return OK;
+}
+
+status_t InputChannel::attachSharedMemory(android::base::unique_fd sharedMemoryFd, bool isServer) {
+    const int size = ashmem_get_size_region(sharedMemoryFd);
+    if (size < 0 || static_cast<size_t>(size) != sizeof(MessageRings)) {
+        ALOGE("channel '%s' ~ Shared memory has size %d, expected %zu", mName.c_str(), size,
+              sizeof(MessageRings));
+        return BAD_VALUE;
+    }
+    void* address = mmap(nullptr, sizeof(MessageRings), PROT_READ | PROT_WRITE, MAP_SHARED,
+                         sharedMemoryFd, 0);
+    if (address == MAP_FAILED) {
+        return -errno;
+    }
+    mSharedMemoryFd = std::move(sharedMemoryFd);
+    mSharedMemory = std::make_shared<SharedMemory>(static_cast<MessageRings*>(address));
+    mIsServer = isServer;
     return OK;
 }
 
 status_t InputChannel::sendMessage(const InputMessage* msg) {
-    const size_t msgLength = msg->size();
     InputMessage cleanMsg;
     msg->getSanitizedCopy(&cleanMsg);
+    InputMessage wireMsg;
+    const size_t msgLength = encodeMessage(cleanMsg, &wireMsg);
+    if (mSharedMemory) {
+        return sendSharedMemoryMessage(wireMsg, msgLength);
+    }
     ssize_t nWrite;
     do {
-        nWrite = ::send(getFd(), &cleanMsg, msgLength, MSG_DONTWAIT | MSG_NOSIGNAL);
+        nWrite = ::send(getFd(), &wireMsg, msgLength, MSG_DONTWAIT | MSG_NOSIGNAL);
     } while (nWrite == -1 && errno == EINTR);
 
     if (nWrite < 0) {
@@ -391,9 +595,13 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
 }
 
 status_t InputChannel::receiveMessage(InputMessage* msg) {
+    if (mSharedMemory) {
+        return receiveSharedMemoryMessage(msg);
+    }
+    InputMessage wireMsg;
     ssize_t nRead;
     do {
-        nRead = ::recv(getFd(), msg, sizeof(InputMessage), MSG_DONTWAIT);
+        nRead = ::recv(getFd(), &wireMsg, sizeof(InputMessage), MSG_DONTWAIT);
     } while (nRead == -1 && errno == EINTR);
 
     if (nRead < 0) {
@@ -417,7 +625,7 @@ status_t InputChannel::receiveMessage(InputMessage* msg) {
         return DEAD_OBJECT;
     }
 
-    if (!msg->isValid(nRead)) {
+    if (!decodeMessage(wireMsg, nRead, msg)) {
         ALOGE("channel '%s' ~ received invalid message of size %zd", mName.c_str(), nRead);
         return BAD_VALUE;
     }
@@ -428,15 +636,128 @@ status_t InputChannel::receiveMessage(InputMessage* msg) {
     return OK;
 }
 
+// The sender publishes the message before checking whether a wake up is pending, and the
+// receiver consumes wake ups before looking for messages. So either the sender sees no pending
+// wake up and writes one, or the receiver finds the message after consuming the pending one.
+status_t InputChannel::sendSharedMemoryMessage(const InputMessage& msg, size_t msgLength) {
+    MessageRing& ring = mIsServer ? mSharedMemory->rings->toClient : mSharedMemory->rings->toServer;
+    const uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail - ring.head.load(std::memory_order_acquire) >= SHARED_MEMORY_RING_CAPACITY) {
+        return WOULD_BLOCK;
+    }
+    MessageRing::Slot& slot = ring.slots[tail % SHARED_MEMORY_RING_CAPACITY];
+    slot.size = msgLength;
+    memcpy(&slot.message, &msg, msgLength);
+    ring.tail.store(tail + 1);
+
+    if (ring.pendingWakeUps.load() != 0) {
+#if DEBUG_CHANNEL_MESSAGES
+        ALOGD("channel '%s' ~ sent message of type %d without wake up", mName.c_str(),
+              msg.header.type);
+#endif
+        return OK;
+    }
+    ring.pendingWakeUps++;
+    const uint8_t wakeUp = 0;
+    ssize_t nWrite;
+    do {
+        nWrite = ::send(getFd(), &wakeUp, sizeof(wakeUp), MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (nWrite == -1 && errno == EINTR);
+
+    if (nWrite < 0) {
+        int error = errno;
+        ring.pendingWakeUps--;
+        // The message can't be taken back, so it will be received if the peer wakes up for some
+        // other reason. A full socket can't happen, since it holds at most one wake up.
+        if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED || error == ECONNRESET) {
+            return DEAD_OBJECT;
+        }
+        return -error;
+    }
+
+#if DEBUG_CHANNEL_MESSAGES
+    ALOGD("channel '%s' ~ sent message of type %d", mName.c_str(), msg.header.type);
+#endif
+    return OK;
+}
+
+status_t InputChannel::receiveSharedMemoryMessage(InputMessage* msg) {
+    MessageRing& ring = mIsServer ? mSharedMemory->rings->toServer : mSharedMemory->rings->toClient;
+    bool peerClosed = false;
+    while (true) {
+        uint8_t wakeUp;
+        const ssize_t nRead = ::recv(getFd(), &wakeUp, sizeof(wakeUp), MSG_DONTWAIT);
+        if (nRead > 0) {
+            // Don't trust the peer to have counted its wake ups.
+            uint32_t pending = ring.pendingWakeUps.load();
+            while (pending > 0 && !ring.pendingWakeUps.compare_exchange_weak(pending, pending - 1)) {
+            }
+            continue;
+        }
+        if (nRead == 0) {
+            peerClosed = true;
+            break;
+        }
+        const int error = errno;
+        if (error == EINTR) {
+            continue;
+        }
+        if (error == EAGAIN || error == EWOULDBLOCK) {
+            break;
+        }
+        if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED) {
+            return DEAD_OBJECT;
+        }
+        return -error;
+    }
+
+    const uint32_t head = ring.head.load(std::memory_order_relaxed);
+    const uint32_t available = ring.tail.load() - head;
+    if (available == 0) {
+        return peerClosed ? DEAD_OBJECT : WOULD_BLOCK;
+    }
+    if (available > SHARED_MEMORY_RING_CAPACITY) {
+        ALOGE("channel '%s' ~ shared memory ring is corrupted: %" PRIu32 " messages available",
+              mName.c_str(), available);
+        return BAD_VALUE;
+    }
+    // The peer can write to the slot at any time, so only look at the copy.
+    const MessageRing::Slot& slot = ring.slots[head % SHARED_MEMORY_RING_CAPACITY];
+    const size_t size = std::min(static_cast<size_t>(slot.size), sizeof(InputMessage));
+    InputMessage wireMsg;
+    memcpy(&wireMsg, &slot.message, size);
+    ring.head.store(head + 1, std::memory_order_release);
+
+    if (!decodeMessage(wireMsg, size, msg)) {
+        ALOGE("channel '%s' ~ received invalid message of size %zu", mName.c_str(), size);
+        return BAD_VALUE;
+    }
+
+#if DEBUG_CHANNEL_MESSAGES
+    ALOGD("channel '%s' ~ received message of type %d", mName.c_str(), msg->header.type);
+#endif
+    return OK;
+}
+
 std::unique_ptr<InputChannel> InputChannel::dup() const {
     base::unique_fd newFd(dupFd());
-    return InputChannel::create(getName(), std::move(newFd), getConnectionToken());
+    std::unique_ptr<InputChannel> channel =
+            InputChannel::create(getName(), std::move(newFd), getConnectionToken());
+    copySharedMemoryTo(*channel);
+    return channel;
 }
 
 void InputChannel::copyTo(InputChannel& outChannel) const {
     outChannel.mName = getName();
     outChannel.mFd = dupFd();
     outChannel.mToken = getConnectionToken();
+    copySharedMemoryTo(outChannel);
+}
+
+void InputChannel::copySharedMemoryTo(InputChannel& outChannel) const {
+    outChannel.mSharedMemoryFd.reset(mSharedMemory ? ::dup(mSharedMemoryFd) : -1);
+    outChannel.mSharedMemory = mSharedMemory;
+    outChannel.mIsServer = mIsServer;
 }
 
 status_t InputChannel::writeToParcel(android::Parcel* parcel) const {
@@ -444,8 +765,13 @@ status_t InputChannel::writeToParcel(android::Parcel* parcel) const {
         ALOGE("%s: Null parcel", __func__);
         return BAD_VALUE;
     }
-    return parcel->writeStrongBinder(mToken)
-            ?: parcel->writeUtf8AsUtf16(mName) ?: parcel->writeUniqueFileDescriptor(mFd);
+    status_t result = parcel->writeStrongBinder(mToken)
+            ?: parcel->writeUtf8AsUtf16(mName) ?: parcel->writeUniqueFileDescriptor(mFd)
+            ?: parcel->writeBool(mSharedMemory != nullptr);
+    if (result != OK || !mSharedMemory) {
+        return result;
+    }
+    return parcel->writeUniqueFileDescriptor(mSharedMemoryFd) ?: parcel->writeBool(mIsServer);
 }
 
 status_t InputChannel::readFromParcel(const android::Parcel* parcel) {
@@ -454,7 +780,18 @@ status_t InputChannel::readFromParcel(const android::Parcel* parcel) {
         return BAD_VALUE;
     }
     mToken = parcel->readStrongBinder();
-    return parcel->readUtf8FromUtf16(&mName) ?: parcel->readUniqueFileDescriptor(&mFd);
+    bool usesSharedMemory = false;
+    status_t result = parcel->readUtf8FromUtf16(&mName) ?: parcel->readUniqueFileDescriptor(&mFd)
+            ?: parcel->readBool(&usesSharedMemory);
+    mSharedMemoryFd.reset();
+    mSharedMemory.reset();
+    if (result != OK || !usesSharedMemory) {
+        return result;
+    }
+    android::base::unique_fd sharedMemoryFd;
+    bool isServer = false;
+    return parcel->readUniqueFileDescriptor(&sharedMemoryFd) ?: parcel->readBool(&isServer)
+            ?: attachSharedMemory(std::move(sharedMemoryFd), isServer);
 }
 
 sp<IBinder> InputChannel::getConnectionToken() const {
@@ -703,6 +1040,11 @@ bool InputConsumer::isTouchResamplingEnabled() {
     return property_get_bool(PROPERTY_RESAMPLING_ENABLED, true);
 }
 
+void InputConsumer::setTouchPredictor(VelocityTracker::Strategy strategy, nsecs_t maxPrediction) {
+    mTouchPredictorStrategy = strategy;
+    mMaxTouchPrediction = std::clamp(maxPrediction, nsecs_t(0), RESAMPLE_MAX_MODEL_PREDICTION);
+}
+
 status_t InputConsumer::consume(InputEventFactoryInterface* factory, bool consumeBatches,
                                 nsecs_t frameTime, uint32_t* outSeq, InputEvent** outEvent,
                                 int* motionEventType, int* touchMoveNumber, bool* flag) {
@@ -962,7 +1304,7 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
             index = mTouchStates.size() - 1;
         }
         TouchState& touchState = mTouchStates[index];
-        touchState.initialize(deviceId, source);
+        touchState.initialize(deviceId, source, mTouchPredictorStrategy);
         touchState.addHistory(msg);
         break;
     }
@@ -1094,6 +1436,8 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
     const History* other;
     History future;
     float alpha;
+    // Whether to extrapolate with the touch predictor rather than linearly.
+    bool predict = false;
     if (next) {
         // Interpolate between current sample and future sample.
         // So current->eventTime <= sampleTime <= future.eventTime.
@@ -1123,7 +1467,9 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
 #endif
             return;
         }
-        nsecs_t maxPredict = current->eventTime + min(delta / 2, RESAMPLE_MAX_PREDICTION);
+        predict = touchState.predictor != nullptr;
+        nsecs_t maxPredict = current->eventTime +
+                (predict ? mMaxTouchPrediction : min(delta / 2, RESAMPLE_MAX_PREDICTION));
         if (sampleTime > maxPredict) {
 #if DEBUG_RESAMPLING
             ALOGD("Sample time is too far in the future, adjusting prediction "
@@ -1132,7 +1478,10 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
 #endif
             sampleTime = maxPredict;
         }
-        alpha = float(current->eventTime - sampleTime) / delta;
+        // Pointers that can't be predicted are extrapolated linearly, within the usual bounds.
+        nsecs_t linearSampleTime =
+                min(sampleTime, current->eventTime + min(delta / 2, RESAMPLE_MAX_PREDICTION));
+        alpha = float(current->eventTime - linearSampleTime) / delta;
     } else {
 #if DEBUG_RESAMPLING
         ALOGD("Not resampled, insufficient data.");
@@ -1164,7 +1513,21 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
         PointerCoords& resampledCoords = touchState.lastResample.pointers[i];
         const PointerCoords& currentCoords = current->getPointerById(id);
         resampledCoords.copyFrom(currentCoords);
-        if (other->idBits.hasBit(id)
+        VelocityTracker::Estimator estimator;
+        if (predict && shouldResampleTool(event->getToolType(i)) &&
+            touchState.predictor->getEstimator(id, &estimator) && estimator.degree >= 1) {
+            // The estimator is a polynomial of the time in seconds since its time base.
+            const float t = (sampleTime - estimator.time) * 0.000000001f;
+            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
+                                         evaluatePolynomial(estimator.xCoeff, estimator.degree, t));
+            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y,
+                                         evaluatePolynomial(estimator.yCoeff, estimator.degree, t));
+#if DEBUG_RESAMPLING
+            ALOGD("[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f), predicted %" PRId64 " ns ahead",
+                  id, resampledCoords.getX(), resampledCoords.getY(), currentCoords.getX(),
+                  currentCoords.getY(), sampleTime - current->eventTime);
+#endif
+        } else if (other->idBits.hasBit(id)
                 && shouldResampleTool(event->getToolType(i))) {
             const PointerCoords& otherCoords = other->getPointerById(id);
             resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
@@ -1416,6 +1779,10 @@ ssize_t InputConsumer::findSampleNoLaterThan(const Batch& batch, nsecs_t time) {
 std::string InputConsumer::dump() const {
     std::string out;
     out = out + "mResampleTouch = " + toString(mResampleTouch) + "\n";
+    if (mTouchPredictorStrategy) {
+        out += StringPrintf("mTouchPredictorStrategy = %d, mMaxTouchPrediction = %" PRId64 "ns\n",
+                            static_cast<int32_t>(*mTouchPredictorStrategy), mMaxTouchPrediction);
+    }
     out = out + "mChannel = " + mChannel->getName() + "\n";
     out = out + "mMsgDeferred: " + toString(mMsgDeferred) + "\n";
     if (mMsgDeferred) {
@@ -66,6 +66,7 @@ bool InputWindowInfo::operator==(const InputWindowInfo& info) const {
             info.packageName == packageName && info.inputFeatures == inputFeatures &&
             info.displayId == displayId && info.portalToDisplayId == portalToDisplayId &&
             info.replaceTouchableRegionWithCrop == replaceTouchableRegionWithCrop &&
+            info.touchableRegionCropHandle == touchableRegionCropHandle && info.alpha == alpha &&
             info.applicationInfo == applicationInfo;
 }
 
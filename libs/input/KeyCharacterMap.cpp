@@ -18,6 +18,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #ifdef __linux__
 #include <binder/Parcel.h>
@@ -33,6 +34,9 @@
 #include <utils/Tokenizer.h>
 #include <utils/Timers.h>
 
+#include <map>
+#include <mutex>
+
 // Enables debug output for the parser.
 #define DEBUG_PARSER 0
 
@@ -83,12 +87,36 @@ static String8 toString(const char16_t* chars, size_t numChars) {
 #endif
 
 
+// Parsed key character maps, so that devices using the same file don't parse it again. Overlays
+// are combined into the map a device gets, so each load returns a copy of the cached map.
+namespace {
+
+struct CachedKeyCharacterMap {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    time_t modificationTime;
+    std::shared_ptr<const KeyCharacterMap> map;
+
+    bool matches(const struct stat& st) const {
+        return device == st.st_dev && inode == st.st_ino && size == st.st_size &&
+                modificationTime == st.st_mtime;
+    }
+};
+
+std::mutex sKeyCharacterMapCacheLock;
+std::map<std::pair<std::string, KeyCharacterMap::Format>, CachedKeyCharacterMap>
+        sKeyCharacterMapCache;
+
+} // namespace
+
 // --- KeyCharacterMap ---
 
 KeyCharacterMap::KeyCharacterMap() : mType(KeyboardType::UNKNOWN) {}
 
 KeyCharacterMap::KeyCharacterMap(const KeyCharacterMap& other)
       : mType(other.mType),
+        mLoadFileName(other.mLoadFileName),
         mKeysByScanCode(other.mKeysByScanCode),
         mKeysByUsageCode(other.mKeysByUsageCode) {
     for (size_t i = 0; i < other.mKeys.size(); i++) {
@@ -147,6 +175,16 @@ bool KeyCharacterMap::operator==(const KeyCharacterMap& other) const {
 
 base::Result<std::shared_ptr<KeyCharacterMap>> KeyCharacterMap::load(const std::string& filename,
                                                                      Format format) {
+    struct stat st;
+    const bool haveStat = stat(filename.c_str(), &st) == 0;
+    if (haveStat) {
+        std::scoped_lock lock(sKeyCharacterMapCacheLock);
+        auto it = sKeyCharacterMapCache.find({filename, format});
+        if (it != sKeyCharacterMapCache.end() && it->second.matches(st)) {
+            return std::make_shared<KeyCharacterMap>(*it->second.map);
+        }
+    }
+
     Tokenizer* tokenizer;
     status_t status = Tokenizer::open(String8(filename.c_str()), &tokenizer);
     if (status) {
@@ -156,6 +194,13 @@ base::Result<std::shared_ptr<KeyCharacterMap>> KeyCharacterMap::load(const std::
     auto ret = load(t.get(), format);
     if (ret.ok()) {
         (*ret)->mLoadFileName = filename;
+        if (haveStat) {
+            std::scoped_lock lock(sKeyCharacterMapCacheLock);
+            sKeyCharacterMapCache[{filename, format}] = {st.st_dev, st.st_ino, st.st_size,
+                                                         st.st_mtime,
+                                                         std::make_shared<KeyCharacterMap>(
+                                                                 **ret)};
+        }
     }
     return ret;
 }
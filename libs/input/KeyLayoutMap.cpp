@@ -17,6 +17,7 @@
 #define LOG_TAG "KeyLayoutMap"
 
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #include <android/keycodes.h>
 #include <input/InputEventLabels.h>
@@ -28,6 +29,8 @@
 #include <utils/Timers.h>
 #include <utils/Tokenizer.h>
 
+#include <mutex>
+
 // Enables debug output for the parser.
 #define DEBUG_PARSER 0
 
@@ -62,6 +65,28 @@ static const std::unordered_map<std::string, InputDeviceSensorType> SENSOR_LIST
          {SENSOR_ENTRY(InputDeviceSensorType::GYROSCOPE_UNCALIBRATED)},
          {SENSOR_ENTRY(InputDeviceSensorType::SIGNIFICANT_MOTION)}};
 
+// Key layout maps are immutable once loaded, so devices using the same file share one parsed
+// map. Entries are dropped when the file no longer matches what was parsed.
+namespace {
+
+struct CachedKeyLayoutMap {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    time_t modificationTime;
+    std::shared_ptr<KeyLayoutMap> map;
+
+    bool matches(const struct stat& st) const {
+        return device == st.st_dev && inode == st.st_ino && size == st.st_size &&
+                modificationTime == st.st_mtime;
+    }
+};
+
+std::mutex sKeyLayoutMapCacheLock;
+std::unordered_map<std::string, CachedKeyLayoutMap> sKeyLayoutMapCache;
+
+} // namespace
+
 // --- KeyLayoutMap ---
 
 KeyLayoutMap::KeyLayoutMap() {
@@ -87,6 +112,16 @@ base::Result<std::shared_ptr<KeyLayoutMap>> KeyLayoutMap::loadContents(const std
 }
 
 base::Result<std::shared_ptr<KeyLayoutMap>> KeyLayoutMap::load(const std::string& filename) {
+    struct stat st;
+    const bool haveStat = stat(filename.c_str(), &st) == 0;
+    if (haveStat) {
+        std::scoped_lock lock(sKeyLayoutMapCacheLock);
+        auto it = sKeyLayoutMapCache.find(filename);
+        if (it != sKeyLayoutMapCache.end() && it->second.matches(st)) {
+            return it->second.map;
+        }
+    }
+
     Tokenizer* tokenizer;
     status_t status = Tokenizer::open(String8(filename.c_str()), &tokenizer);
     if (status) {
@@ -97,6 +132,10 @@ base::Result<std::shared_ptr<KeyLayoutMap>> KeyLayoutMap::load(const std::string
     auto ret = load(t.get());
     if (ret.ok()) {
         (*ret)->mLoadFileName = filename;
+        if (haveStat) {
+            std::scoped_lock lock(sKeyLayoutMapCacheLock);
+            sKeyLayoutMapCache[filename] = {st.st_dev, st.st_ino, st.st_size, st.st_mtime, *ret};
+        }
     }
     return ret;
 }
@@ -410,21 +410,31 @@ void LeastSquaresVelocityTrackerStrategy::addMovement(
  * Finally we solve the system of linear equations given by R1 B = (Qtranspose W Y)
  * to find B.
  *
+ * Since Q and R only depend on X and W, the decomposition is shared by the two Y vectors
+ * Y1 and Y2 (the x and y positions of a pointer over time) that are fit at once.
+ *
  * For efficiency, we lay out A and Q column-wise in memory because we frequently
  * operate on the column vectors.  Conversely, we lay out R row-wise.
  *
  * http://en.wikipedia.org/wiki/Numerical_methods_for_linear_least_squares
  * http://en.wikipedia.org/wiki/Gram-Schmidt
  */
-static bool solveLeastSquares(const std::vector<float>& x, const std::vector<float>& y,
-                              const std::vector<float>& w, uint32_t n, float* outB, float* outDet) {
+static void solveLeastSquaresWithQR(const std::vector<float>& x, const std::vector<float>& y,
+                                    const std::vector<float>& w, uint32_t n, const float* q,
+                                    const float* r, float* outB, float* outDet);
+
+static bool solveLeastSquares(const std::vector<float>& x, const std::vector<float>& y1,
+                              const std::vector<float>& y2, const std::vector<float>& w,
+                              uint32_t n, float* outB1, float* outDet1, float* outB2,
+                              float* outDet2) {
     const size_t m = x.size();
 #if DEBUG_STRATEGY
-    ALOGD("solveLeastSquares: m=%d, n=%d, x=%s, y=%s, w=%s", int(m), int(n),
-            vectorToString(x, m).c_str(), vectorToString(y, m).c_str(),
-            vectorToString(w, m).c_str());
+    ALOGD("solveLeastSquares: m=%d, n=%d, x=%s, y1=%s, y2=%s, w=%s", int(m), int(n),
+            vectorToString(x, m).c_str(), vectorToString(y1, m).c_str(),
+            vectorToString(y2, m).c_str(), vectorToString(w, m).c_str());
 #endif
-    LOG_ALWAYS_FATAL_IF(m != y.size() || m != w.size(), "Mismatched vector sizes");
+    LOG_ALWAYS_FATAL_IF(m != y1.size() || m != y2.size() || m != w.size(),
+                        "Mismatched vector sizes");
 
     // Expand the X vector to a matrix A, pre-multiplied by the weights.
     float a[n][m]; // column-major order
@@ -486,6 +496,21 @@ static bool solveLeastSquares(const std::vector<float>& x, const std::vector<flo
     ALOGD("  - qr=%s", matrixToString(&qr[0][0], m, n, false /*rowMajor*/).c_str());
 #endif
 
+    // Q and R only depend on X and W, so the same decomposition solves for both Y vectors.
+    solveLeastSquaresWithQR(x, y1, w, n, &q[0][0], &r[0][0], outB1, outDet1);
+    solveLeastSquaresWithQR(x, y2, w, n, &q[0][0], &r[0][0], outB2, outDet2);
+    return true;
+}
+
+/**
+ * Finishes the least squares fit of Y given the QR decomposition of the weighted X matrix computed
+ * by solveLeastSquares. Q is m by n in column-major order, R is n by n in row-major order.
+ */
+static void solveLeastSquaresWithQR(const std::vector<float>& x, const std::vector<float>& y,
+                                    const std::vector<float>& w, uint32_t n, const float* q,
+                                    const float* r, float* outB, float* outDet) {
+    const size_t m = x.size();
+
     // Solve R B = Qt W Y to find B.  This is easy because R is upper triangular.
     // We just work from bottom-right to top-left calculating B's coefficients.
     float wy[m];
@@ -494,11 +519,11 @@ static bool solveLeastSquares(const std::vector<float>& x, const std::vector<flo
     }
     for (uint32_t i = n; i != 0; ) {
         i--;
-        outB[i] = vectorDot(&q[i][0], wy, m);
+        outB[i] = vectorDot(&q[i * m], wy, m);
         for (uint32_t j = n - 1; j > i; j--) {
-            outB[i] -= r[i][j] * outB[j];
+            outB[i] -= r[i * n + j] * outB[j];
         }
-        outB[i] /= r[i][i];
+        outB[i] /= r[i * n + i];
     }
 #if DEBUG_STRATEGY
     ALOGD("  - b=%s", vectorToString(outB, n).c_str());
@@ -533,42 +558,44 @@ static bool solveLeastSquares(const std::vector<float>& x, const std::vector<flo
     ALOGD("  - sstot=%f", sstot);
     ALOGD("  - det=%f", *outDet);
 #endif
-    return true;
 }
 
 /*
  * Optimized unweighted second-order least squares fit. About 2x speed improvement compared to
  * the default implementation
+ *
+ * Fits both Y1 and Y2 against X at once, since all the sums over X and the denominator are the
+ * same for both.
  */
-static std::optional<std::array<float, 3>> solveUnweightedLeastSquaresDeg2(
-        const std::vector<float>& x, const std::vector<float>& y) {
+static std::optional<std::array<std::array<float, 3>, 2>> solveUnweightedLeastSquaresDeg2(
+        const std::vector<float>& x, const std::vector<float>& y1, const std::vector<float>& y2) {
     const size_t count = x.size();
-    LOG_ALWAYS_FATAL_IF(count != y.size(), "Mismatching array sizes");
+    LOG_ALWAYS_FATAL_IF(count != y1.size() || count != y2.size(), "Mismatching array sizes");
     // Solving y = a*x^2 + b*x + c
-    float sxi = 0, sxiyi = 0, syi = 0, sxi2 = 0, sxi3 = 0, sxi2yi = 0, sxi4 = 0;
+    float sxi = 0, sxi2 = 0, sxi3 = 0, sxi4 = 0;
+    float sxiyi[2] = {0, 0}, syi[2] = {0, 0}, sxi2yi[2] = {0, 0};
 
     for (size_t i = 0; i < count; i++) {
         float xi = x[i];
-        float yi = y[i];
         float xi2 = xi*xi;
         float xi3 = xi2*xi;
         float xi4 = xi3*xi;
-        float xiyi = xi*yi;
-        float xi2yi = xi2*yi;
 
         sxi += xi;
         sxi2 += xi2;
-        sxiyi += xiyi;
-        sxi2yi += xi2yi;
-        syi += yi;
         sxi3 += xi3;
         sxi4 += xi4;
+
+        const float yi[2] = {y1[i], y2[i]};
+        for (size_t k = 0; k < 2; k++) {
+            sxiyi[k] += xi*yi[k];
+            sxi2yi[k] += xi2*yi[k];
+            syi[k] += yi[k];
+        }
     }
 
     float Sxx = sxi2 - sxi*sxi / count;
-    float Sxy = sxiyi - sxi*syi / count;
     float Sxx2 = sxi3 - sxi*sxi2 / count;
-    float Sx2y = sxi2yi - sxi2*syi / count;
     float Sx2x2 = sxi4 - sxi2*sxi2 / count;
 
     float denominator = Sxx*Sx2x2 - Sxx2*Sxx2;
@@ -576,18 +603,26 @@ static std::optional<std::array<float, 3>> solveUnweightedLeastSquaresDeg2(
         ALOGW("division by 0 when computing velocity, Sxx=%f, Sx2x2=%f, Sxx2=%f", Sxx, Sx2x2, Sxx2);
         return std::nullopt;
     }
-    // Compute a
-    float numerator = Sx2y*Sxx - Sxy*Sxx2;
-    float a = numerator / denominator;
 
-    // Compute b
-    numerator = Sxy*Sx2x2 - Sx2y*Sxx2;
-    float b = numerator / denominator;
+    std::array<std::array<float, 3>, 2> coefficients;
+    for (size_t k = 0; k < 2; k++) {
+        float Sxy = sxiyi[k] - sxi*syi[k] / count;
+        float Sx2y = sxi2yi[k] - sxi2*syi[k] / count;
 
-    // Compute c
-    float c = syi/count - b * sxi/count - a * sxi2/count;
+        // Compute a
+        float numerator = Sx2y*Sxx - Sxy*Sxx2;
+        float a = numerator / denominator;
 
-    return std::make_optional(std::array<float, 3>({c, b, a}));
+        // Compute b
+        numerator = Sxy*Sx2x2 - Sx2y*Sxx2;
+        float b = numerator / denominator;
+
+        // Compute c
+        float c = syi[k]/count - b * sxi/count - a * sxi2/count;
+
+        coefficients[k] = {c, b, a};
+    }
+    return coefficients;
 }
 
 bool LeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
@@ -634,15 +669,16 @@ bool LeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
 
     if (degree == 2 && mWeighting == WEIGHTING_NONE) {
         // Optimize unweighted, quadratic polynomial fit
-        std::optional<std::array<float, 3>> xCoeff = solveUnweightedLeastSquaresDeg2(time, x);
-        std::optional<std::array<float, 3>> yCoeff = solveUnweightedLeastSquaresDeg2(time, y);
-        if (xCoeff && yCoeff) {
+        std::optional<std::array<std::array<float, 3>, 2>> coeffs =
+                solveUnweightedLeastSquaresDeg2(time, x, y);
+        if (coeffs) {
+            const auto& [xCoeff, yCoeff] = *coeffs;
             outEstimator->time = newestMovement.eventTime;
             outEstimator->degree = 2;
             outEstimator->confidence = 1;
             for (size_t i = 0; i <= outEstimator->degree; i++) {
-                outEstimator->xCoeff[i] = (*xCoeff)[i];
-                outEstimator->yCoeff[i] = (*yCoeff)[i];
+                outEstimator->xCoeff[i] = xCoeff[i];
+                outEstimator->yCoeff[i] = yCoeff[i];
             }
             return true;
         }
@@ -650,8 +686,8 @@ bool LeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
         // General case for an Nth degree polynomial fit
         float xdet, ydet;
         uint32_t n = degree + 1;
-        if (solveLeastSquares(time, x, w, n, outEstimator->xCoeff, &xdet) &&
-            solveLeastSquares(time, y, w, n, outEstimator->yCoeff, &ydet)) {
+        if (solveLeastSquares(time, x, y, w, n, outEstimator->xCoeff, &xdet,
+                              outEstimator->yCoeff, &ydet)) {
             outEstimator->time = newestMovement.eventTime;
             outEstimator->degree = degree;
             outEstimator->confidence = xdet * ydet;
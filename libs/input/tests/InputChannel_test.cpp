@@ -18,6 +18,7 @@
 
 #include "TestHelpers.h"
 
+#include <sys/socket.h>
 #include <unistd.h>
 #include <time.h>
 #include <errno.h>
@@ -195,6 +196,42 @@ TEST_F(InputChannelTest, SendAndReceive_MotionClassification) {
     }
 }
 
+TEST_F(InputChannelTest, SendAndReceive_Motion_OnlySendsAxesThatAreSet) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel));
+
+    InputMessage serverMsg = {};
+    serverMsg.header.type = InputMessage::Type::MOTION;
+    serverMsg.header.seq = 1;
+    serverMsg.body.motion.pointerCount = 2;
+    for (uint32_t i = 0; i < 2; i++) {
+        auto& pointer = serverMsg.body.motion.pointers[i];
+        pointer.properties.id = i + 3;
+        pointer.properties.toolType = AMOTION_EVENT_TOOL_TYPE_STYLUS;
+        pointer.coords.setAxisValue(AMOTION_EVENT_AXIS_X, 10.f * (i + 1));
+        pointer.coords.setAxisValue(AMOTION_EVENT_AXIS_Y, 20.f * (i + 1));
+        pointer.coords.setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, 0.5f);
+        if (i == 1) {
+            pointer.coords.setAxisValue(AMOTION_EVENT_AXIS_TILT, 0.25f);
+        }
+    }
+    ASSERT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+
+    InputMessage clientMsg;
+    const ssize_t wireSize =
+            recv(clientChannel->getFd(), &clientMsg, sizeof(clientMsg), MSG_DONTWAIT | MSG_PEEK);
+    EXPECT_LT(wireSize, static_cast<ssize_t>(serverMsg.size()));
+
+    ASSERT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+    ASSERT_EQ(2u, clientMsg.body.motion.pointerCount);
+    for (uint32_t i = 0; i < 2; i++) {
+        const auto& sent = serverMsg.body.motion.pointers[i];
+        const auto& received = clientMsg.body.motion.pointers[i];
+        EXPECT_EQ(sent.properties, received.properties);
+        EXPECT_EQ(sent.coords, received.coords);
+    }
+}
+
 TEST_F(InputChannelTest, InputChannelParcelAndUnparcel) {
     std::unique_ptr<InputChannel> serverChannel, clientChannel;
 
@@ -227,4 +264,113 @@ TEST_F(InputChannelTest, DuplicateChannelAndAssertEqual) {
     EXPECT_EQ(*serverChannel == *dupChan, true) << "inputchannel should be equal after duplication";
 }
 
+TEST_F(InputChannelTest, SharedMemory_SendAndReceiveInBothDirections) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 /*useSharedMemory*/ true));
+    ASSERT_TRUE(serverChannel->usesSharedMemory());
+    ASSERT_TRUE(clientChannel->usesSharedMemory());
+
+    InputMessage serverMsg = {};
+    serverMsg.header.type = InputMessage::Type::MOTION;
+    serverMsg.header.seq = 1;
+    serverMsg.body.motion.pointerCount = 1;
+    serverMsg.body.motion.action = AMOTION_EVENT_ACTION_MOVE;
+    ASSERT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+
+    InputMessage clientMsg;
+    ASSERT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+    EXPECT_EQ(InputMessage::Type::MOTION, clientMsg.header.type);
+    EXPECT_EQ(1u, clientMsg.header.seq);
+    EXPECT_EQ(AMOTION_EVENT_ACTION_MOVE, clientMsg.body.motion.action);
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&clientMsg));
+
+    InputMessage clientReply = {};
+    clientReply.header.type = InputMessage::Type::FINISHED;
+    clientReply.header.seq = 1;
+    clientReply.body.finished.handled = true;
+    ASSERT_EQ(OK, clientChannel->sendMessage(&clientReply));
+
+    InputMessage serverReply;
+    ASSERT_EQ(OK, serverChannel->receiveMessage(&serverReply));
+    EXPECT_EQ(InputMessage::Type::FINISHED, serverReply.header.type);
+    EXPECT_EQ(1u, serverReply.header.seq);
+    EXPECT_TRUE(serverReply.body.finished.handled);
+}
+
+TEST_F(InputChannelTest, SharedMemory_MessagesSentBeforeReceiving_ShareOneWakeUp) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 /*useSharedMemory*/ true));
+
+    InputMessage msg = {};
+    msg.header.type = InputMessage::Type::KEY;
+    size_t sent = 0;
+    while (serverChannel->sendMessage(&msg) == OK) {
+        msg.header.seq = ++sent;
+    }
+    ASSERT_GT(sent, 1u);
+
+    // A single wake up is readable on the client socket.
+    uint8_t wakeUps[2];
+    EXPECT_EQ(1, recv(clientChannel->getFd(), wakeUps, sizeof(wakeUps), MSG_DONTWAIT | MSG_PEEK));
+
+    for (size_t i = 0; i < sent; i++) {
+        InputMessage received;
+        ASSERT_EQ(OK, clientChannel->receiveMessage(&received));
+        EXPECT_EQ(i, received.header.seq);
+    }
+    InputMessage received;
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&received));
+    EXPECT_EQ(-1, recv(clientChannel->getFd(), wakeUps, sizeof(wakeUps), MSG_DONTWAIT | MSG_PEEK))
+            << "the wake up should have been consumed";
+
+    // Once the client has caught up, the next message wakes it up again.
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    EXPECT_EQ(1, recv(clientChannel->getFd(), wakeUps, sizeof(wakeUps), MSG_DONTWAIT | MSG_PEEK));
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&received));
+}
+
+TEST_F(InputChannelTest, SharedMemory_ReceiveWhenPeerClosed_ReturnsPendingMessagesFirst) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 /*useSharedMemory*/ true));
+
+    InputMessage msg = {};
+    msg.header.type = InputMessage::Type::KEY;
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    serverChannel.reset();
+
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&msg));
+    EXPECT_EQ(DEAD_OBJECT, clientChannel->receiveMessage(&msg));
+    EXPECT_EQ(DEAD_OBJECT, clientChannel->sendMessage(&msg));
+}
+
+TEST_F(InputChannelTest, SharedMemory_ParcelledChannelKeepsUsingSharedMemory) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel parceling", serverChannel,
+                                                 clientChannel, /*useSharedMemory*/ true));
+
+    InputChannel chan;
+    Parcel parcel;
+    ASSERT_EQ(OK, clientChannel->writeToParcel(&parcel));
+    parcel.setDataPosition(0);
+    ASSERT_EQ(OK, chan.readFromParcel(&parcel));
+    clientChannel.reset();
+    ASSERT_TRUE(chan.usesSharedMemory());
+
+    InputMessage msg = {};
+    msg.header.type = InputMessage::Type::KEY;
+    msg.header.seq = 42;
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+
+    InputMessage received;
+    ASSERT_EQ(OK, chan.receiveMessage(&received));
+    EXPECT_EQ(42u, received.header.seq);
+}
+
 } // namespace android
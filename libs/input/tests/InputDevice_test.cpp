@@ -82,4 +82,20 @@ TEST_F(InputDeviceKeyMapTest, keyCharacterMapParcelingTest) {
     ASSERT_EQ(*map, *mKeyMap.keyCharacterMap);
 }
 
+TEST_F(InputDeviceKeyMapTest, keyLayoutMapIsSharedBetweenLoads) {
+    base::Result<std::shared_ptr<KeyLayoutMap>> ret = KeyLayoutMap::load(mKeyMap.keyLayoutFile);
+    ASSERT_TRUE(ret.ok());
+    ASSERT_EQ(mKeyMap.keyLayoutMap, *ret);
+}
+
+TEST_F(InputDeviceKeyMapTest, keyCharacterMapIsCopiedBetweenLoads) {
+    base::Result<std::shared_ptr<KeyCharacterMap>> ret =
+            KeyCharacterMap::load(mKeyMap.keyCharacterMapFile, KeyCharacterMap::Format::BASE);
+    ASSERT_TRUE(ret.ok());
+    // Overlays are combined into a device's map, so loads must not share it.
+    ASSERT_NE(mKeyMap.keyCharacterMap, *ret);
+    ASSERT_EQ(*mKeyMap.keyCharacterMap, **ret);
+    ASSERT_EQ(mKeyMap.keyCharacterMapFile, (*ret)->getLoadFileName());
+}
+
 } // namespace android
@@ -68,6 +68,27 @@ TEST(TouchVideoFrame, Equality) {
     ASSERT_FALSE(frame == changedTimestampFrame);
 }
 
+TEST(TouchVideoFrame, CopiesShareData) {
+    TouchVideoFrame frame(3, 2, {1, 2, 3, 4, 5, 6}, TIMESTAMP);
+    TouchVideoFrame copy = frame;
+
+    ASSERT_EQ(frame, copy);
+    ASSERT_EQ(frame.getData().data(), copy.getData().data());
+}
+
+TEST(TouchVideoFrame, RotateDoesNotAffectCopies) {
+    TouchVideoFrame frame(3, 2, {1, 2, 3, 4, 5, 6}, TIMESTAMP);
+    TouchVideoFrame copy = frame;
+
+    copy.rotate(DISPLAY_ORIENTATION_180);
+    ASSERT_EQ(TouchVideoFrame(3, 2, {1, 2, 3, 4, 5, 6}, TIMESTAMP), frame);
+    ASSERT_EQ(TouchVideoFrame(3, 2, {6, 5, 4, 3, 2, 1}, TIMESTAMP), copy);
+
+    copy = frame;
+    copy.rotate(DISPLAY_ORIENTATION_90);
+    ASSERT_EQ(TouchVideoFrame(3, 2, {1, 2, 3, 4, 5, 6}, TIMESTAMP), frame);
+}
+
 // --- Rotate 90 degrees ---
 
 TEST(TouchVideoFrame, Rotate90_0x0) {
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <input/VelocityTracker.h>
+
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+namespace android {
+
+// Enough samples to fill the history of the least squares strategies.
+static constexpr size_t SAMPLE_COUNT = 20;
+static constexpr nsecs_t SAMPLE_INTERVAL = std::chrono::nanoseconds(4ms).count(); // ~240Hz
+
+// A pointer accelerating along a curve, so that the fit has something to do.
+static void addFlingMovements(VelocityTracker& tracker) {
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        const float t = i;
+        tracker.addMovement(i * SAMPLE_INTERVAL, BitSet32(1 << 0),
+                            {{.x = 10 * t + 0.5f * t * t, .y = 600 - 20 * t - t * t}});
+    }
+}
+
+static void benchmarkGetVelocity(benchmark::State& state, VelocityTracker::Strategy strategy) {
+    VelocityTracker tracker(strategy);
+    addFlingMovements(tracker);
+    float vx, vy;
+    for (auto _ : state) {
+        tracker.getVelocity(0, &vx, &vy);
+        benchmark::DoNotOptimize(vx);
+        benchmark::DoNotOptimize(vy);
+    }
+}
+
+BENCHMARK_CAPTURE(benchmarkGetVelocity, IMPULSE, VelocityTracker::Strategy::IMPULSE);
+BENCHMARK_CAPTURE(benchmarkGetVelocity, LSQ1, VelocityTracker::Strategy::LSQ1);
+BENCHMARK_CAPTURE(benchmarkGetVelocity, LSQ2, VelocityTracker::Strategy::LSQ2);
+BENCHMARK_CAPTURE(benchmarkGetVelocity, LSQ3, VelocityTracker::Strategy::LSQ3);
+BENCHMARK_CAPTURE(benchmarkGetVelocity, WLSQ2_DELTA, VelocityTracker::Strategy::WLSQ2_DELTA);
+BENCHMARK_CAPTURE(benchmarkGetVelocity, WLSQ2_RECENT, VelocityTracker::Strategy::WLSQ2_RECENT);
+
+} // namespace android
+
+BENCHMARK_MAIN();
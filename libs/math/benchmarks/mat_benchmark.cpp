@@ -0,0 +1,64 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <math/mat4.h>
+
+namespace android {
+namespace {
+
+// A color matrix, as composed by RenderEngine and SurfaceFlinger color transforms.
+mat4 makeMatrix() {
+    return mat4(vec4(0.8f, 0.1f, 0.05f, 0.0f),
+                vec4(0.15f, 0.85f, 0.1f, 0.0f),
+                vec4(0.05f, 0.05f, 0.85f, 0.0f),
+                vec4(0.01f, -0.02f, 0.03f, 1.0f));
+}
+
+void benchmarkMultiplyVector(benchmark::State& state) {
+    const mat4 m = makeMatrix();
+    vec4 v(0.25f, 0.5f, 0.75f, 1.0f);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(v);
+        benchmark::DoNotOptimize(m * v);
+    }
+}
+BENCHMARK(benchmarkMultiplyVector);
+
+void benchmarkMultiplyMatrix(benchmark::State& state) {
+    const mat4 m = makeMatrix();
+    mat4 n = inverse(m);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(n);
+        benchmark::DoNotOptimize(m * n);
+    }
+}
+BENCHMARK(benchmarkMultiplyMatrix);
+
+void benchmarkInverse(benchmark::State& state) {
+    mat4 m = makeMatrix();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(m);
+        benchmark::DoNotOptimize(inverse(m));
+    }
+}
+BENCHMARK(benchmarkInverse);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
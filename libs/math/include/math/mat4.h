@@ -507,6 +507,105 @@ CONSTEXPR TMat44<T> TMat44<T>::lookAt(const TVec3<A>& eye, const TVec3<B>& cente
             TVec4<T>(eye, 1));
 }
 
+// ----------------------------------------------------------------------------------------
+// Vector kernels for mat4
+// ----------------------------------------------------------------------------------------
+
+/* The generic loops on TMat44<T> are not reliably vectorized, so mat4 * vec4 and inverse()
+ * are specialized with 128-bit GCC/Clang vector types, which compile to NEON or SSE. The
+ * generic mat4 * mat4 goes through mat4 * vec4 for each column.
+ *
+ * The kernels perform the same IEEE operations in the same order as the generic code, one
+ * column at a time, so the results are bit-identical.
+ */
+#if (defined(__ARM_NEON) || defined(__SSE__)) && defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define MATH_MAT4_SIMD
+#endif
+#endif
+
+#ifdef MATH_MAT4_SIMD
+namespace simd {
+
+typedef float float4 __attribute__((vector_size(16)));
+
+inline float4 load(const TVec4<float>& v) {
+    float4 r;
+    __builtin_memcpy(&r, &v[0], sizeof(r));
+    return r;
+}
+
+inline void store(TVec4<float>& v, float4 r) {
+    __builtin_memcpy(&v[0], &r, sizeof(r));
+}
+
+// Sum of the columns weighted by the elements of v, accumulated from zero like the generic code.
+inline float4 PURE multiply(const TMat44<float>& m, const TVec4<float>& v) {
+    float4 r = {};
+    r += load(m[0]) * v[0];
+    r += load(m[1]) * v[1];
+    r += load(m[2]) * v[2];
+    r += load(m[3]) * v[3];
+    return r;
+}
+
+} // namespace simd
+
+namespace matrix {
+
+// gaussJordanInverse() for mat4, with the row operations done on whole columns.
+template<>
+inline TMat44<float> PURE inverse<TMat44<float>>(const TMat44<float>& src) {
+    simd::float4 tmp[4];
+    simd::float4 inverted[4];
+    for (size_t i = 0; i < 4; ++i) {
+        tmp[i] = simd::load(src[i]);
+        inverted[i] = simd::float4{};
+        inverted[i][i] = 1;
+    }
+
+    for (size_t i = 0; i < 4; ++i) {
+        // look for largest element in i'th column
+        size_t swap = i;
+        float t = std::abs(tmp[i][i]);
+        for (size_t j = i + 1; j < 4; ++j) {
+            const float t2 = std::abs(tmp[j][i]);
+            if (t2 > t) {
+                swap = j;
+                t = t2;
+            }
+        }
+
+        if (swap != i) {
+            // swap columns.
+            std::swap(tmp[i], tmp[swap]);
+            std::swap(inverted[i], inverted[swap]);
+        }
+
+        const float denom(tmp[i][i]);
+        tmp[i] /= denom;
+        inverted[i] /= denom;
+
+        // Factor out the lower triangle
+        for (size_t j = 0; j < 4; ++j) {
+            if (j != i) {
+                const float d = tmp[j][i];
+                tmp[j] -= tmp[i] * d;
+                inverted[j] -= inverted[i] * d;
+            }
+        }
+    }
+
+    TMat44<float> result(TMat44<float>::NO_INIT);
+    for (size_t i = 0; i < 4; ++i) {
+        simd::store(result[i], inverted[i]);
+    }
+    return result;
+}
+
+} // namespace matrix
+#endif // MATH_MAT4_SIMD
+
 // ----------------------------------------------------------------------------------------
 // Arithmetic operators outside of class
 // ----------------------------------------------------------------------------------------
@@ -530,6 +629,18 @@ CONSTEXPR typename TMat44<T>::col_type PURE operator *(const TMat44<T>& lhs, con
     return result;
 }
 
+#ifdef MATH_MAT4_SIMD
+// mat4 * vec4, as above with vector instructions, see simd::multiply()
+inline CONSTEXPR TVec4<float> PURE operator *(const TMat44<float>& lhs, const TVec4<float>& rhs) {
+    if (__builtin_is_constant_evaluated()) {
+        return operator*<float, float>(lhs, rhs);
+    }
+    TVec4<float> result(TVec4<float>::NO_INIT);
+    simd::store(result, simd::multiply(lhs, rhs));
+    return result;
+}
+#endif
+
 // mat44 * vec3, result is vec3( mat44 * {vec3, 1} )
 template <typename T, typename U>
 CONSTEXPR typename TMat44<T>::col_type PURE operator *(const TMat44<T>& lhs, const TVec3<U>& rhs) {
@@ -584,3 +695,4 @@ typedef details::TMat44<float> mat4f;
 
 #undef PURE
 #undef CONSTEXPR
+#undef MATH_MAT4_SIMD
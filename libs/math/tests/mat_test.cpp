@@ -17,6 +17,7 @@
 #define LOG_TAG "MatTest"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <limits>
 #include <random>
@@ -163,6 +164,41 @@ TEST_F(MatTest, ElementAccess) {
     EXPECT_FLOAT_EQ(m(3, 2), 100);
 }
 
+// mat4 products and inverse may use vector kernels, which must match the generic code bit for bit.
+TEST_F(MatTest, MatchesGeneric) {
+    std::default_random_engine engine(42);
+    std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+    const auto random = [&] { return distribution(engine); };
+
+    const auto bitEqual = [](const auto& lhs, const auto& rhs) {
+        static_assert(sizeof(lhs) == sizeof(rhs));
+        return memcmp(&lhs, &rhs, sizeof(lhs)) == 0;
+    };
+
+    const auto genericMultiply = [](const mat4& lhs, const mat4& rhs) {
+        mat4 res;
+        for (size_t col = 0; col < 4; ++col) {
+            res[col] = details::operator*<float, float>(lhs, rhs[col]);
+        }
+        return res;
+    };
+
+    for (int i = 0; i < 1000; i++) {
+        mat4 m;
+        mat4 n;
+        vec4 v;
+        for (size_t c = 0; c < 4; c++) {
+            m[c] = vec4(random(), random(), random(), random());
+            n[c] = vec4(random(), random(), random(), random());
+        }
+        v = vec4(random(), random(), random(), random());
+
+        EXPECT_TRUE(bitEqual(m * v, details::operator*<float, float>(m, v)));
+        EXPECT_TRUE(bitEqual(m * n, genericMultiply(m, n)));
+        EXPECT_TRUE(bitEqual(inverse(m), details::matrix::gaussJordanInverse(m)));
+    }
+}
+
 //------------------------------------------------------------------------------
 // MAT 3
 //------------------------------------------------------------------------------
@@ -154,6 +154,10 @@ private:
     nsecs_t mLatestVsyncPeriod = -1;
     VsyncEventData mLastVsyncEventData;
 
+    // Storage for the callbacks that are due on a vsync. Only used by dispatchVsync, and kept
+    // between frames so that dispatching does not allocate once it has grown large enough.
+    std::vector<FrameCallback> mDueFrameCallbacks;
+
     const sp<Looper> mLooper;
     const std::thread::id mThreadId;
 };
@@ -358,7 +362,10 @@ void Choreographer::handleRefreshRateUpdates() {
 // the internal display implicitly.
 void Choreographer::dispatchVsync(nsecs_t timestamp, PhysicalDisplayId, uint32_t,
                                   VsyncEventData vsyncEventData) {
-    std::vector<FrameCallback> callbacks{};
+    // Take the storage rather than iterating over it in place, in case a callback ends up
+    // dispatching events itself.
+    std::vector<FrameCallback> callbacks;
+    callbacks.swap(mDueFrameCallbacks);
     {
         std::lock_guard<std::mutex> _l{mLock};
         nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
@@ -375,6 +382,8 @@ void Choreographer::dispatchVsync(nsecs_t timestamp, PhysicalDisplayId, uint32_t
             cb.callback(timestamp, cb.data);
         }
     }
+    callbacks.clear();
+    mDueFrameCallbacks.swap(callbacks);
 }
 
 void Choreographer::dispatchHotplug(nsecs_t, PhysicalDisplayId displayId, bool connected) {
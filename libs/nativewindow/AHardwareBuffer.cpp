@@ -20,12 +20,15 @@
 
 #include <errno.h>
 #include <sys/socket.h>
+#include <deque>
 #include <memory>
+#include <mutex>
 
 #include <cutils/native_handle.h>
 #include <log/log.h>
 #include <utils/StrongPointer.h>
 #include <ui/GraphicBuffer.h>
+#include <ui/GraphicBufferMapper.h>
 #include <system/graphics.h>
 
 #include <private/android/AHardwareBufferHelpers.h>
@@ -408,6 +411,125 @@ int AHardwareBuffer_getId(const AHardwareBuffer* buffer, uint64_t* outId) {
     return OK;
 }
 
+struct AHardwareBuffer_Pool {
+    struct Entry {
+        sp<GraphicBuffer> buffer;
+        uint64_t size;
+    };
+
+    explicit AHardwareBuffer_Pool(size_t maxBytes) : maxBytes(maxBytes) {}
+
+    // Releases the oldest idle buffers until they take at most the given size.
+    void trimLocked(uint64_t size) {
+        while (bytes > size) {
+            bytes -= idle.front().size;
+            idle.pop_front();
+        }
+    }
+
+    const size_t maxBytes;
+
+    std::mutex mutex;
+    std::deque<Entry> idle; // Oldest first.
+    uint64_t bytes = 0;
+};
+
+static uint64_t getAllocationSize(const GraphicBuffer& gbuffer) {
+    uint64_t size = 0;
+    if (GraphicBufferMapper::get().getAllocationSize(gbuffer.handle, &size) == NO_ERROR &&
+        size > 0) {
+        return size;
+    }
+
+    // Mappers before 4.0 don't report the size, so estimate it. Formats without a fixed size
+    // per pixel, e.g. YUV, are counted as 4 bytes per pixel.
+    uint64_t bpp = bytesPerPixel(gbuffer.getPixelFormat());
+    if (gbuffer.getPixelFormat() == HAL_PIXEL_FORMAT_BLOB) {
+        bpp = 1;
+    } else if (bpp == 0) {
+        bpp = 4;
+    }
+    return bpp * gbuffer.getStride() * gbuffer.getHeight() * gbuffer.getLayerCount();
+}
+
+int AHardwareBuffer_Pool_create(size_t maxBytes, AHardwareBuffer_Pool** outPool) {
+    if (!outPool) return BAD_VALUE;
+
+    *outPool = new AHardwareBuffer_Pool(maxBytes);
+    return OK;
+}
+
+void AHardwareBuffer_Pool_destroy(AHardwareBuffer_Pool* pool) {
+    delete pool;
+}
+
+int AHardwareBuffer_Pool_allocate(AHardwareBuffer_Pool* pool, const AHardwareBuffer_Desc* desc,
+        AHardwareBuffer** outBuffer) {
+    if (!pool || !outBuffer || !desc) return BAD_VALUE;
+    if (!AHardwareBuffer_isValidDescription(desc, /*log=*/true)) return BAD_VALUE;
+
+    const PixelFormat format = AHardwareBuffer_convertToPixelFormat(desc->format);
+    const uint64_t usage = AHardwareBuffer_convertToGrallocUsageBits(desc->usage);
+
+    sp<GraphicBuffer> gbuffer;
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        // Prefer the most recently recycled buffer, as its memory is the most likely to be warm.
+        for (auto it = pool->idle.rbegin(); it != pool->idle.rend(); ++it) {
+            const GraphicBuffer& candidate = *it->buffer;
+            // A buffer recycled while still referenced elsewhere in the process isn't idle yet.
+            if (candidate.getStrongCount() == 1 && candidate.getWidth() == desc->width &&
+                candidate.getHeight() == desc->height &&
+                candidate.getLayerCount() == desc->layers &&
+                candidate.getPixelFormat() == format && candidate.getUsage() == usage) {
+                gbuffer = std::move(it->buffer);
+                pool->bytes -= it->size;
+                pool->idle.erase(std::next(it).base());
+                break;
+            }
+        }
+    }
+
+    if (gbuffer) {
+        *outBuffer = AHardwareBuffer_from_GraphicBuffer(gbuffer.get());
+        AHardwareBuffer_acquire(*outBuffer);
+        return NO_ERROR;
+    }
+
+    int err = AHardwareBuffer_allocate(desc, outBuffer);
+    if (err == NO_MEMORY) {
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            if (pool->idle.empty()) return err;
+            pool->trimLocked(0);
+        }
+        err = AHardwareBuffer_allocate(desc, outBuffer);
+    }
+    return err;
+}
+
+void AHardwareBuffer_Pool_recycle(AHardwareBuffer_Pool* pool, AHardwareBuffer* buffer) {
+    if (!pool || !buffer) return;
+
+    sp<GraphicBuffer> gbuffer = AHardwareBuffer_to_GraphicBuffer(buffer);
+    AHardwareBuffer_release(buffer);
+
+    const uint64_t size = getAllocationSize(*gbuffer);
+    if (size > pool->maxBytes) return;
+
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    pool->trimLocked(pool->maxBytes - size);
+    pool->idle.push_back({std::move(gbuffer), size});
+    pool->bytes += size;
+}
+
+void AHardwareBuffer_Pool_trim(AHardwareBuffer_Pool* pool, size_t maxBytes) {
+    if (!pool) return;
+
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    pool->trimLocked(maxBytes);
+}
+
 // ----------------------------------------------------------------------------
 // VNDK functions
 // ----------------------------------------------------------------------------
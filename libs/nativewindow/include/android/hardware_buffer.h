@@ -47,6 +47,7 @@
 
 #include <android/rect.h>
 #include <inttypes.h>
+#include <stddef.h>
 #include <sys/cdefs.h>
 
 __BEGIN_DECLS
@@ -567,6 +568,78 @@ int AHardwareBuffer_lockAndGetInfo(AHardwareBuffer* _Nonnull buffer, uint64_t us
 int AHardwareBuffer_getId(const AHardwareBuffer* _Nonnull buffer, uint64_t* _Nonnull outId)
         __INTRODUCED_IN(31);
 
+/**
+ * Opaque handle for a pool of recycled AHardwareBuffers.
+ *
+ * A pool keeps the buffers released to it with AHardwareBuffer_Pool_recycle(), and hands them out
+ * again from AHardwareBuffer_Pool_allocate() for a matching description instead of allocating new
+ * memory. Streaming workloads that churn buffers of the same description thus allocate only
+ * while they ramp up. A pool may be used from any thread.
+ */
+typedef struct AHardwareBuffer_Pool AHardwareBuffer_Pool;
+
+/**
+ * Creates a pool that keeps at most \a maxBytes of idle buffers. Buffers handed out by the pool
+ * don't count towards the limit.
+ *
+ * Available since API level 33.
+ *
+ * \return 0 on success, -EINVAL if \a outPool is NULL.
+ */
+int AHardwareBuffer_Pool_create(size_t maxBytes, AHardwareBuffer_Pool* _Nullable* _Nonnull outPool)
+        __INTRODUCED_IN(33);
+
+/**
+ * Destroys the pool, and releases its idle buffers. Buffers handed out by the pool stay valid, and
+ * must still be released with AHardwareBuffer_release().
+ *
+ * Available since API level 33.
+ */
+void AHardwareBuffer_Pool_destroy(AHardwareBuffer_Pool* _Nullable pool) __INTRODUCED_IN(33);
+
+/**
+ * Same as AHardwareBuffer_allocate(), but reuses an idle buffer of the pool if one has the same
+ * width, height, layer count, format and usage as \a desc. The contents of a reused buffer are
+ * those it had when it was recycled.
+ *
+ * If the allocation of a new buffer fails for lack of memory, the idle buffers of the pool are
+ * released and the allocation is retried.
+ *
+ * Available since API level 33.
+ *
+ * \return 0 on success, or an error number if the allocation fails for any reason. The returned
+ * buffer has a reference count of 1.
+ */
+int AHardwareBuffer_Pool_allocate(AHardwareBuffer_Pool* _Nonnull pool,
+                                  const AHardwareBuffer_Desc* _Nonnull desc,
+                                  AHardwareBuffer* _Nullable* _Nonnull outBuffer)
+        __INTRODUCED_IN(33);
+
+/**
+ * Removes the reference of the caller to the buffer like AHardwareBuffer_release(), but keeps
+ * the buffer in the pool for reuse. The buffer need not have been allocated from the pool.
+ *
+ * The pool only reuses the buffer once it holds the last reference within the process, but can't
+ * track its use by other processes. Only recycle a buffer that was sent to another process once
+ * that process is done with it, e.g. after the release fence it returned has signaled.
+ *
+ * The oldest idle buffers are released if the pool exceeds its limit.
+ *
+ * Available since API level 33.
+ */
+void AHardwareBuffer_Pool_recycle(AHardwareBuffer_Pool* _Nonnull pool,
+                                  AHardwareBuffer* _Nonnull buffer) __INTRODUCED_IN(33);
+
+/**
+ * Releases the oldest idle buffers of the pool until they take at most \a maxBytes. Meant to be
+ * called when the system is low on memory, e.g. from ComponentCallbacks2.onTrimMemory(). Passing
+ * 0 releases all idle buffers.
+ *
+ * Available since API level 33.
+ */
+void AHardwareBuffer_Pool_trim(AHardwareBuffer_Pool* _Nonnull pool, size_t maxBytes)
+        __INTRODUCED_IN(33);
+
 __END_DECLS
 
 #endif // ANDROID_HARDWARE_BUFFER_H
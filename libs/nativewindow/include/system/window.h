@@ -257,6 +257,9 @@ enum {
     NATIVE_WINDOW_SET_QUERY_INTERCEPTOR           = 47,    /* private */
     NATIVE_WINDOW_SET_FRAME_TIMELINE_INFO         = 48,    /* private */
     NATIVE_WINDOW_GET_LAST_QUEUED_BUFFER2         = 49,    /* private */
+    NATIVE_WINDOW_DEQUEUE_BUFFERS                 = 50,    /* private */
+    NATIVE_WINDOW_CANCEL_BUFFERS                  = 51,    /* private */
+    NATIVE_WINDOW_QUEUE_BUFFERS                   = 52,    /* private */
     // clang-format on
 };
 
@@ -1086,6 +1089,52 @@ static inline int ANativeWindow_getLastQueuedBuffer2(ANativeWindow* window,
                            outCropRect, outTransform);
 }
 
+/**
+ * Dequeues count buffers in a single call, filling in buffers[i] and the fence
+ * which must be waited on before writing to it in fenceFds[i]. Either all
+ * buffers are dequeued, or none are and an error is returned.
+ *
+ * This is not supported in shared buffer mode.
+ *
+ * \return NO_ERROR on success.
+ * \return NAME_NOT_FOUND if this ANativeWindow doesn't support batched operations, callers
+ *         should fall back to calling dequeueBuffer count times instead.
+ */
+static inline int native_window_dequeue_buffers(struct ANativeWindow* window,
+                                                struct ANativeWindowBuffer** buffers,
+                                                int* fenceFds, size_t count) {
+    return window->perform(window, NATIVE_WINDOW_DEQUEUE_BUFFERS, buffers, fenceFds, count);
+}
+
+/**
+ * Batched version of cancelBuffer. Ownership of every fence in fenceFds is
+ * transferred to the window, even on error.
+ *
+ * \return NO_ERROR on success.
+ * \return NAME_NOT_FOUND if this ANativeWindow doesn't support batched operations.
+ */
+static inline int native_window_cancel_buffers(struct ANativeWindow* window,
+                                               struct ANativeWindowBuffer* const* buffers,
+                                               const int* fenceFds, size_t count) {
+    return window->perform(window, NATIVE_WINDOW_CANCEL_BUFFERS, buffers, fenceFds, count);
+}
+
+/**
+ * Batched version of queueBuffer. timestamps may be NULL, in which case every
+ * buffer is timestamped with NATIVE_WINDOW_TIMESTAMP_AUTO. Ownership of every
+ * fence in fenceFds is transferred to the window, even on error.
+ *
+ * \return NO_ERROR on success.
+ * \return NAME_NOT_FOUND if this ANativeWindow doesn't support batched operations.
+ */
+static inline int native_window_queue_buffers(struct ANativeWindow* window,
+                                              struct ANativeWindowBuffer* const* buffers,
+                                              const int* fenceFds, const int64_t* timestamps,
+                                              size_t count) {
+    return window->perform(window, NATIVE_WINDOW_QUEUE_BUFFERS, buffers, fenceFds, timestamps,
+                           count);
+}
+
 /**
  * Retrieves an identifier for the next frame to be queued by this window.
  *
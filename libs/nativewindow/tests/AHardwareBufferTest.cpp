@@ -170,3 +170,82 @@ TEST(AHardwareBufferTest, GetIdTest) {
 
     EXPECT_NE(id1, id2);
 }
+
+TEST(AHardwareBufferTest, PoolRecyclesMatchingBuffers) {
+    AHardwareBuffer_Pool* pool = nullptr;
+    ASSERT_EQ(0, AHardwareBuffer_Pool_create(1 << 20, &pool));
+
+    AHardwareBuffer_Desc desc = {
+            .width = 64,
+            .height = 64,
+            .layers = 1,
+            .format = AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM,
+            .usage = AHARDWAREBUFFER_USAGE_CPU_READ_RARELY,
+    };
+
+    AHardwareBuffer* buffer = nullptr;
+    ASSERT_EQ(0, AHardwareBuffer_Pool_allocate(pool, &desc, &buffer));
+    uint64_t id = 0;
+    EXPECT_EQ(0, AHardwareBuffer_getId(buffer, &id));
+    AHardwareBuffer_Pool_recycle(pool, buffer);
+
+    // Same description.
+    ASSERT_EQ(0, AHardwareBuffer_Pool_allocate(pool, &desc, &buffer));
+    uint64_t otherId = 0;
+    EXPECT_EQ(0, AHardwareBuffer_getId(buffer, &otherId));
+    EXPECT_EQ(id, otherId);
+
+    // Still referenced by the caller.
+    AHardwareBuffer_acquire(buffer);
+    AHardwareBuffer_Pool_recycle(pool, buffer);
+    AHardwareBuffer* otherBuffer = nullptr;
+    ASSERT_EQ(0, AHardwareBuffer_Pool_allocate(pool, &desc, &otherBuffer));
+    EXPECT_EQ(0, AHardwareBuffer_getId(otherBuffer, &otherId));
+    EXPECT_NE(id, otherId);
+    AHardwareBuffer_release(buffer);
+    AHardwareBuffer_Pool_recycle(pool, otherBuffer);
+
+    // Different description.
+    desc.width = 32;
+    ASSERT_EQ(0, AHardwareBuffer_Pool_allocate(pool, &desc, &buffer));
+    EXPECT_EQ(0, AHardwareBuffer_getId(buffer, &otherId));
+    EXPECT_NE(id, otherId);
+    AHardwareBuffer_release(buffer);
+
+    // Trimmed.
+    desc.width = 64;
+    AHardwareBuffer_Pool_trim(pool, 0);
+    ASSERT_EQ(0, AHardwareBuffer_Pool_allocate(pool, &desc, &buffer));
+    EXPECT_EQ(0, AHardwareBuffer_getId(buffer, &otherId));
+    EXPECT_NE(id, otherId);
+    AHardwareBuffer_release(buffer);
+
+    AHardwareBuffer_Pool_destroy(pool);
+}
+
+TEST(AHardwareBufferTest, PoolKeepsAtMostMaxBytes) {
+    AHardwareBuffer_Pool* pool = nullptr;
+    ASSERT_EQ(0, AHardwareBuffer_Pool_create(0, &pool));
+
+    const AHardwareBuffer_Desc desc = {
+            .width = 64,
+            .height = 64,
+            .layers = 1,
+            .format = AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM,
+            .usage = AHARDWAREBUFFER_USAGE_CPU_READ_RARELY,
+    };
+
+    AHardwareBuffer* buffer = nullptr;
+    ASSERT_EQ(0, AHardwareBuffer_Pool_allocate(pool, &desc, &buffer));
+    uint64_t id = 0;
+    EXPECT_EQ(0, AHardwareBuffer_getId(buffer, &id));
+    AHardwareBuffer_Pool_recycle(pool, buffer);
+
+    ASSERT_EQ(0, AHardwareBuffer_Pool_allocate(pool, &desc, &buffer));
+    uint64_t otherId = 0;
+    EXPECT_EQ(0, AHardwareBuffer_getId(buffer, &otherId));
+    EXPECT_NE(id, otherId);
+    AHardwareBuffer_release(buffer);
+
+    AHardwareBuffer_Pool_destroy(pool);
+}
@@ -18,14 +18,48 @@
 
 #include <cutils/properties.h>
 #include <log/log.h>
+
+#include <algorithm>
+
 #include "gl/GLESRenderEngine.h"
 #include "threaded/RenderEngineThreaded.h"
 
 #include "skia/SkiaGLRenderEngine.h"
+#include "skia/SkiaVkRenderEngine.h"
 
 namespace android {
 namespace renderengine {
 
+// These need to be recreated, since they are a constant reference, and we need to let SkiaRE
+// know which type it is running as, e.g. that all GPU operations will happen on the same thread.
+static RenderEngineCreationArgs withRenderEngineType(const RenderEngineCreationArgs& args,
+                                                     RenderEngine::RenderEngineType type) {
+    return RenderEngineCreationArgs::Builder()
+            .setPixelFormat(args.pixelFormat)
+            .setImageCacheSize(args.imageCacheSize)
+            .setUseColorManagerment(args.useColorManagement)
+            .setEnableProtectedContext(args.enableProtectedContext)
+            .setPrecacheToneMapperShaderOnly(args.precacheToneMapperShaderOnly)
+            .setSupportsBackgroundBlur(args.supportsBackgroundBlur)
+            .setContextPriority(args.contextPriority)
+            .setRenderEngineType(type)
+            .build();
+}
+
+// Creates the Vulkan backend, or the GL one if the device can't run Vulkan.
+static std::unique_ptr<skia::SkiaRenderEngine> createSkiaVkOrGl(
+        const RenderEngineCreationArgs& args, bool threaded) {
+    using RenderEngineType = RenderEngine::RenderEngineType;
+    if (auto engine = skia::SkiaVkRenderEngine::create(args)) {
+        return engine;
+    }
+    ALOGW("Failed to create SkiaVk RenderEngine, falling back to SkiaGL");
+    return skia::SkiaGLRenderEngine::create(
+            withRenderEngineType(args,
+                                 threaded ? RenderEngineType::SKIA_GL_THREADED
+                                          : RenderEngineType::SKIA_GL));
+}
+
 std::unique_ptr<RenderEngine> RenderEngine::create(const RenderEngineCreationArgs& args) {
     RenderEngineType renderEngineType = args.renderEngineType;
 
@@ -44,6 +78,12 @@ std::unique_ptr<RenderEngine> RenderEngine::create(const RenderEngineCreationArg
     if (strcmp(prop, "skiaglthreaded") == 0) {
         renderEngineType = RenderEngineType::SKIA_GL_THREADED;
     }
+    if (strcmp(prop, "skiavk") == 0) {
+        renderEngineType = RenderEngineType::SKIA_VK;
+    }
+    if (strcmp(prop, "skiavkthreaded") == 0) {
+        renderEngineType = RenderEngineType::SKIA_VK_THREADED;
+    }
 
     switch (renderEngineType) {
         case RenderEngineType::THREADED:
@@ -55,20 +95,7 @@ std::unique_ptr<RenderEngine> RenderEngine::create(const RenderEngineCreationArg
             ALOGD("RenderEngine with SkiaGL Backend");
             return renderengine::skia::SkiaGLRenderEngine::create(args);
         case RenderEngineType::SKIA_GL_THREADED: {
-            // These need to be recreated, since they are a constant reference, and we need to
-            // let SkiaRE know that it's running as threaded, and all GL operation will happen on
-            // the same thread.
-            RenderEngineCreationArgs skiaArgs =
-                    RenderEngineCreationArgs::Builder()
-                            .setPixelFormat(args.pixelFormat)
-                            .setImageCacheSize(args.imageCacheSize)
-                            .setUseColorManagerment(args.useColorManagement)
-                            .setEnableProtectedContext(args.enableProtectedContext)
-                            .setPrecacheToneMapperShaderOnly(args.precacheToneMapperShaderOnly)
-                            .setSupportsBackgroundBlur(args.supportsBackgroundBlur)
-                            .setContextPriority(args.contextPriority)
-                            .setRenderEngineType(renderEngineType)
-                            .build();
+            RenderEngineCreationArgs skiaArgs = withRenderEngineType(args, renderEngineType);
             ALOGD("Threaded RenderEngine with SkiaGL Backend");
             return renderengine::threaded::RenderEngineThreaded::create(
                     [skiaArgs]() {
@@ -76,6 +103,19 @@ std::unique_ptr<RenderEngine> RenderEngine::create(const RenderEngineCreationArg
                     },
                     renderEngineType);
         }
+        case RenderEngineType::SKIA_VK:
+            ALOGD("RenderEngine with SkiaVk Backend");
+            return createSkiaVkOrGl(withRenderEngineType(args, renderEngineType),
+                                    /*threaded*/ false);
+        case RenderEngineType::SKIA_VK_THREADED: {
+            RenderEngineCreationArgs skiaArgs = withRenderEngineType(args, renderEngineType);
+            ALOGD("Threaded RenderEngine with SkiaVk Backend");
+            // RenderEngineThreaded only reports SKIA_VK_THREADED; the engine running on its thread
+            // knows whether it fell back to GL.
+            return renderengine::threaded::RenderEngineThreaded::create(
+                    [skiaArgs]() { return createSkiaVkOrGl(skiaArgs, /*threaded*/ true); },
+                    renderEngineType);
+        }
         case RenderEngineType::GLES:
         default:
             ALOGD("RenderEngine with GLES Backend");
@@ -85,6 +125,24 @@ std::unique_ptr<RenderEngine> RenderEngine::create(const RenderEngineCreationArg
 
 RenderEngine::~RenderEngine() = default;
 
+void RenderEngine::drawLayersAsync(const DisplaySettings& display, std::vector<LayerSettings> layers,
+                                   const std::shared_ptr<ExternalTexture>& buffer,
+                                   bool useProtectedContext, base::unique_fd&& bufferFence,
+                                   DrawLayersCallback&& callback) {
+    std::vector<const LayerSettings*> layerPointers(layers.size());
+    std::transform(layers.begin(), layers.end(), layerPointers.begin(),
+                   std::pointer_traits<LayerSettings*>::pointer_to);
+
+    const bool wasProtected = isProtected();
+    this->useProtectedContext(useProtectedContext);
+    base::unique_fd drawFence;
+    const status_t status = drawLayers(display, layerPointers, buffer,
+                                       false /* useFramebufferCache */, std::move(bufferFence),
+                                       &drawFence);
+    this->useProtectedContext(wasProtected);
+    callback(status, std::move(drawFence));
+}
+
 void RenderEngine::validateInputBufferUsage(const sp<GraphicBuffer>& buffer) {
     LOG_ALWAYS_FATAL_IF(!(buffer->getUsage() & GraphicBuffer::USAGE_HW_TEXTURE),
                         "input buffer not gpu readable");
@@ -0,0 +1,312 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+#include <renderengine/ExternalTexture.h>
+#include <renderengine/LayerSettings.h>
+#include <renderengine/RenderEngine.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+#include <utils/Timers.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace android;
+using namespace android::renderengine;
+using ::benchmark::State;
+
+namespace {
+
+// The size of a common phone display, so that fill rate weighs in as it does on a device.
+constexpr int32_t kDisplayWidth = 1080;
+constexpr int32_t kDisplayHeight = 2340;
+const Rect kDisplayRect(0, 0, kDisplayWidth, kDisplayHeight);
+
+using RenderEngineType = RenderEngine::RenderEngineType;
+
+// Latencies of one part of a frame, reported as a distribution.
+class LatencyStats {
+public:
+    explicit LatencyStats(std::string name) : mName(std::move(name)) {}
+
+    void add(nsecs_t duration) { mSamples.push_back(duration); }
+
+    void report(State& state) {
+        if (mSamples.empty()) {
+            return;
+        }
+        std::sort(mSamples.begin(), mSamples.end());
+        auto percentileUs = [this](double percentile) {
+            const size_t index =
+                    std::min(mSamples.size() - 1, static_cast<size_t>(percentile * mSamples.size()));
+            return toMicros(static_cast<double>(mSamples[index]));
+        };
+        state.counters[mName + "_p50_us"] = percentileUs(0.5);
+        state.counters[mName + "_p90_us"] = percentileUs(0.9);
+        state.counters[mName + "_max_us"] = toMicros(static_cast<double>(mSamples.back()));
+    }
+
+private:
+    static double toMicros(double ns) { return ns / 1000.0; }
+
+    const std::string mName;
+    std::vector<nsecs_t> mSamples;
+};
+
+// Engines are created once per backend, as SurfaceFlinger does, so that EGL and Skia setup costs
+// aren't timed and the caches RenderEngine keeps between frames stay warm across runs.
+RenderEngine* getRenderEngine(RenderEngineType type) {
+    static std::map<RenderEngineType, std::unique_ptr<RenderEngine>> sRenderEngines;
+    auto& renderEngine = sRenderEngines[type];
+    if (!renderEngine) {
+        renderEngine = RenderEngine::create(
+                RenderEngineCreationArgs::Builder()
+                        .setPixelFormat(static_cast<int>(ui::PixelFormat::RGBA_8888))
+                        .setImageCacheSize(1)
+                        .setUseColorManagerment(true)
+                        .setEnableProtectedContext(false)
+                        .setPrecacheToneMapperShaderOnly(false)
+                        .setSupportsBackgroundBlur(true)
+                        .setContextPriority(RenderEngine::ContextPriority::HIGH)
+                        .setRenderEngineType(type)
+                        .build());
+        CHECK(renderEngine) << "Could not create RenderEngine type " << static_cast<int>(type);
+    }
+    return renderEngine.get();
+}
+
+std::shared_ptr<ExternalTexture> allocateBuffer(RenderEngine& renderEngine, const char* name) {
+    return std::make_shared<ExternalTexture>(new GraphicBuffer(kDisplayWidth, kDisplayHeight,
+                                                               HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                                                               GRALLOC_USAGE_HW_RENDER |
+                                                                       GRALLOC_USAGE_HW_TEXTURE,
+                                                               name),
+                                             renderEngine,
+                                             ExternalTexture::Usage::READABLE |
+                                                     ExternalTexture::Usage::WRITEABLE);
+}
+
+// A frame to draw. The scenes are the ones skia::Cache warms shaders for, at display size and with
+// the number of layers a busy client composition frame has.
+struct Scene {
+    DisplaySettings display;
+    std::vector<LayerSettings> layers;
+};
+
+using SceneBuilder = std::function<Scene(const std::shared_ptr<ExternalTexture>& srcTexture)>;
+
+DisplaySettings defaultDisplay() {
+    return DisplaySettings{
+            .physicalDisplay = kDisplayRect,
+            .clip = kDisplayRect,
+            .maxLuminance = 500,
+            .outputDataspace = ui::Dataspace::SRGB,
+    };
+}
+
+LayerSettings bufferLayer(const std::shared_ptr<ExternalTexture>& srcTexture, FloatRect bounds) {
+    return LayerSettings{
+            .geometry = Geometry{.boundaries = bounds},
+            .source = PixelSource{.buffer = Buffer{.buffer = srcTexture}},
+            .alpha = 1,
+            .sourceDataspace = ui::Dataspace::SRGB,
+    };
+}
+
+// A wallpaper under rows of opaque and translucent rounded rects, like a launcher or a list with
+// cards.
+Scene roundedCornersScene(const std::shared_ptr<ExternalTexture>& srcTexture) {
+    Scene scene{.display = defaultDisplay()};
+    scene.layers.push_back(bufferLayer(srcTexture, kDisplayRect.toFloatRect()));
+    constexpr int kRows = 12;
+    const float rowHeight = static_cast<float>(kDisplayHeight) / kRows;
+    for (int i = 0; i < kRows; i++) {
+        const FloatRect bounds(40.f, i * rowHeight + 8.f, kDisplayWidth - 40.f,
+                               (i + 1) * rowHeight - 8.f);
+        scene.layers.push_back(LayerSettings{
+                .geometry =
+                        Geometry{
+                                .boundaries = bounds,
+                                .roundedCornersRadius = 32.f,
+                                .roundedCornersCrop = bounds,
+                        },
+                .source = PixelSource{.solidColor = half3(0.1f * (i % 10), 0.2f, 0.3f)},
+                .alpha = i % 2 ? 0.5f : 1.f,
+                .sourceDataspace = ui::Dataspace::SRGB,
+        });
+    }
+    return scene;
+}
+
+// A floating window casting a shadow over the app below it.
+Scene shadowScene(const std::shared_ptr<ExternalTexture>& srcTexture) {
+    Scene scene{.display = defaultDisplay()};
+    scene.layers.push_back(bufferLayer(srcTexture, kDisplayRect.toFloatRect()));
+    const FloatRect windowBounds(100.f, 400.f, kDisplayWidth - 100.f, kDisplayHeight - 400.f);
+    LayerSettings window = bufferLayer(srcTexture, windowBounds);
+    window.geometry.roundedCornersRadius = 50.f;
+    window.geometry.roundedCornersCrop = windowBounds;
+    window.shadow = ShadowSettings{
+            .boundaries = windowBounds,
+            .ambientColor = vec4(0, 0, 0, 0.00935997f),
+            .spotColor = vec4(0, 0, 0, 0.0455841f),
+            .lightPos = vec3(kDisplayWidth / 2.f, -1000.f, 1500.f),
+            .lightRadius = 2500.0f,
+            .length = 30.f,
+    };
+    scene.layers.push_back(std::move(window));
+    return scene;
+}
+
+// The notification shade: a full screen background blur over the app, with a panel on top.
+Scene blurScene(const std::shared_ptr<ExternalTexture>& srcTexture) {
+    Scene scene{.display = defaultDisplay()};
+    scene.layers.push_back(bufferLayer(srcTexture, kDisplayRect.toFloatRect()));
+    scene.layers.push_back(LayerSettings{
+            .geometry = Geometry{.boundaries = kDisplayRect.toFloatRect()},
+            .alpha = 1,
+            .skipContentDraw = true,
+            .backgroundBlurRadius = 60,
+    });
+    LayerSettings panel = bufferLayer(srcTexture, FloatRect(0.f, 0.f, kDisplayWidth, 900.f));
+    panel.alpha = 0.8f;
+    scene.layers.push_back(std::move(panel));
+    return scene;
+}
+
+// HDR video tone mapped to an SDR display, with the player UI dimmed to the SDR white point above
+// it.
+Scene hdrScene(const std::shared_ptr<ExternalTexture>& srcTexture) {
+    Scene scene{.display = defaultDisplay()};
+    scene.display.sdrWhitePointNits = 200.f;
+    LayerSettings video = bufferLayer(srcTexture, kDisplayRect.toFloatRect());
+    video.source.buffer.maxLuminanceNits = 1000.f;
+    video.sourceDataspace = ui::Dataspace::BT2020_ITU_PQ;
+    scene.layers.push_back(std::move(video));
+    LayerSettings controls =
+            bufferLayer(srcTexture, FloatRect(0.f, kDisplayHeight - 400.f, kDisplayWidth,
+                                              kDisplayHeight));
+    controls.source.buffer.isOpaque = false;
+    scene.layers.push_back(std::move(controls));
+    return scene;
+}
+
+// Fills the source buffer once, so that the scenes sample something other than undefined memory.
+void fillSourceBuffer(RenderEngine& renderEngine,
+                      const std::shared_ptr<ExternalTexture>& srcTexture) {
+    const LayerSettings fill{
+            .geometry = Geometry{.boundaries = kDisplayRect.toFloatRect()},
+            .source = PixelSource{.solidColor = half3(0.4f, 0.6f, 0.8f)},
+            .alpha = 1,
+    };
+    base::unique_fd drawFence;
+    renderEngine.drawLayers(defaultDisplay(), {&fill}, srcTexture, false, base::unique_fd(),
+                            &drawFence);
+    sp<Fence> fence = new Fence(std::move(drawFence));
+    fence->waitForever("fillSourceBuffer");
+}
+
+// Draws one frame per iteration and waits for it, reporting:
+// - submit: the time drawLayers takes on the calling thread, i.e. the CPU cost of the frame.
+// - complete: the time from the start of drawLayers until the draw fence signals, i.e. the
+//   latency of the frame including GPU work. When the backend returns no fence the frame is
+//   already done, and the time drawLayers returned is used.
+void BM_drawLayers(State& state, RenderEngineType type, SceneBuilder buildScene) {
+    RenderEngine* renderEngine = getRenderEngine(type);
+    const auto srcTexture = allocateBuffer(*renderEngine, "RenderEngineBench_src");
+    const auto dstTexture = allocateBuffer(*renderEngine, "RenderEngineBench_dst");
+    fillSourceBuffer(*renderEngine, srcTexture);
+
+    const Scene scene = buildScene(srcTexture);
+    if (std::any_of(scene.layers.begin(), scene.layers.end(),
+                    [](const LayerSettings& layer) { return layer.backgroundBlurRadius > 0; }) &&
+        !renderEngine->supportsBackgroundBlur()) {
+        state.SkipWithError("Backend doesn't support background blur");
+        return;
+    }
+    std::vector<const LayerSettings*> layers;
+    for (const auto& layer : scene.layers) {
+        layers.push_back(&layer);
+    }
+
+    LatencyStats submit("submit");
+    LatencyStats complete("complete");
+    for (auto _ : state) {
+        base::unique_fd drawFence;
+        const nsecs_t start = systemTime();
+        const status_t err = renderEngine->drawLayers(scene.display, layers, dstTexture, false,
+                                                      base::unique_fd(), &drawFence);
+        const nsecs_t submitted = systemTime();
+        if (err != NO_ERROR) {
+            state.SkipWithError("drawLayers failed");
+            return;
+        }
+
+        nsecs_t completed = submitted;
+        if (drawFence.ok()) {
+            const sp<Fence> fence = new Fence(std::move(drawFence));
+            fence->waitForever("BM_drawLayers");
+            const nsecs_t signalTime = fence->getSignalTime();
+            if (signalTime != Fence::SIGNAL_TIME_INVALID &&
+                signalTime != Fence::SIGNAL_TIME_PENDING) {
+                completed = signalTime;
+            }
+        }
+        submit.add(submitted - start);
+        complete.add(completed - start);
+    }
+    submit.report(state);
+    complete.report(state);
+}
+
+const std::pair<const char*, RenderEngineType> kBackends[] = {
+        {"GLES", RenderEngineType::GLES},
+        {"GLESThreaded", RenderEngineType::THREADED},
+        {"SkiaGL", RenderEngineType::SKIA_GL},
+        {"SkiaGLThreaded", RenderEngineType::SKIA_GL_THREADED},
+};
+
+const std::pair<const char*, SceneBuilder> kScenes[] = {
+        {"RoundedCorners", roundedCornersScene},
+        {"Shadow", shadowScene},
+        {"Blur", blurScene},
+        {"Hdr", hdrScene},
+};
+
+} // namespace
+
+// Registers BM_drawLayers/<backend>/<scene> for every backend and scene, so that
+// --benchmark_filter can pick out either.
+int main(int argc, char** argv) {
+    for (const auto& [backendName, type] : kBackends) {
+        for (const auto& [sceneName, buildScene] : kScenes) {
+            const std::string name =
+                    std::string("BM_drawLayers/") + backendName + "/" + sceneName;
+            ::benchmark::RegisterBenchmark(name.c_str(), BM_drawLayers, type, buildScene)
+                    ->UseRealTime();
+        }
+    }
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
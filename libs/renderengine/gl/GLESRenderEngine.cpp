@@ -20,7 +20,9 @@
 #define LOG_TAG "RenderEngine"
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <pthread.h>
 #include <sched.h>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <sstream>
@@ -396,6 +398,9 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // Programs may be generated with another context current, which would not
+    // enable the position attribute on this one.
+    glEnableVertexAttribArray(Program::position);
 
     // Initialize protected EGL Context.
     if (mProtectedEGLContext != EGL_NO_CONTEXT) {
@@ -404,6 +409,7 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
         ALOGE_IF(!success, "can't make protected context current");
         glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
         glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glEnableVertexAttribArray(Program::position);
         success = eglMakeCurrent(display, mStubSurface, mStubSurface, mEGLContext);
         LOG_ALWAYS_FATAL_IF(!success, "can't make default context current");
     }
@@ -479,6 +485,9 @@ GLESRenderEngine::~GLESRenderEngine() {
     mImageManager = nullptr;
     mShadowTexture = nullptr;
     cleanFramebufferCache();
+    if (mPrimeCacheThread.joinable()) {
+        mPrimeCacheThread.join();
+    }
     ProgramCache::getInstance().purgeCaches();
     std::lock_guard<std::mutex> lock(mRenderingMutex);
     glDisableVertexAttribArray(Program::position);
@@ -516,9 +525,60 @@ Framebuffer* GLESRenderEngine::getFramebufferForDrawing() {
 }
 
 std::future<void> GLESRenderEngine::primeCache() {
-    ProgramCache::getInstance().primeCache(mInProtectedContext ? mProtectedEGLContext : mEGLContext,
-                                           mUseColorManagement, mPrecacheToneMapperShaderOnly);
-    return {};
+    const EGLContext context = mInProtectedContext ? mProtectedEGLContext : mEGLContext;
+    const Protection protection =
+            mInProtectedContext ? Protection::PROTECTED : Protection::UNPROTECTED;
+
+    // Generate the programs with a context sharing objects with the one they are
+    // for, so that drawLayers only waits for the programs it actually needs.
+    const bool surfaceless = GLExtensions::getInstance().hasSurfacelessContext();
+    EGLContext compileContext = EGL_NO_CONTEXT;
+    if (surfaceless || mEGLConfig != EGL_NO_CONFIG) {
+        compileContext =
+                createEglContext(mEGLDisplay, mEGLConfig, context, std::nullopt, protection);
+    }
+    EGLSurface compileSurface = EGL_NO_SURFACE;
+    if (compileContext != EGL_NO_CONTEXT && !surfaceless) {
+        compileSurface = createStubEglPbufferSurface(mEGLDisplay, mEGLConfig,
+                                                     HAL_PIXEL_FORMAT_RGBA_8888, protection);
+        if (compileSurface == EGL_NO_SURFACE) {
+            eglDestroyContext(mEGLDisplay, compileContext);
+            compileContext = EGL_NO_CONTEXT;
+        }
+    }
+    if (compileContext == EGL_NO_CONTEXT) {
+        ALOGW("Can't create a shader compilation context, priming the cache synchronously");
+        ProgramCache::getInstance().primeCache(context, mUseColorManagement,
+                                               mPrecacheToneMapperShaderOnly);
+        return {};
+    }
+
+    if (mPrimeCacheThread.joinable()) {
+        mPrimeCacheThread.join();
+    }
+    std::promise<void> promise;
+    std::future<void> future = promise.get_future();
+    mPrimeCacheThread = std::thread([this, context, compileContext, compileSurface,
+                                     promise = std::move(promise)]() mutable {
+        if (pthread_setname_np(pthread_self(), "REShaderCompile")) {
+            ALOGW("Failed to set thread name on shader compilation thread");
+        }
+        if (eglMakeCurrent(mEGLDisplay, compileSurface, compileSurface, compileContext)) {
+            ProgramCache::getInstance().primeCache(context, mUseColorManagement,
+                                                   mPrecacheToneMapperShaderOnly);
+            eglMakeCurrent(mEGLDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        } else {
+            // Programs will be generated on first use instead.
+            ALOGE("Can't make shader compilation context current");
+        }
+        if (compileSurface != EGL_NO_SURFACE) {
+            eglDestroySurface(mEGLDisplay, compileSurface);
+        }
+        eglDestroyContext(mEGLDisplay, compileContext);
+        eglReleaseThread();
+        promise.set_value();
+    });
+    return future;
 }
 
 base::unique_fd GLESRenderEngine::flush() {
@@ -1825,9 +1885,19 @@ void GLESRenderEngine::FlushTracer::loop() {
     }
 }
 
-void GLESRenderEngine::handleShadow(const FloatRect& casterRect, float casterCornerRadius,
-                                    const ShadowSettings& settings) {
-    ATRACE_CALL();
+const Mesh& GLESRenderEngine::getShadowMesh(const FloatRect& casterRect, float casterCornerRadius,
+                                            const ShadowSettings& settings) {
+    const ShadowMeshKey key{casterRect, casterCornerRadius, settings};
+    const auto it = std::find_if(mShadowMeshCache.begin(), mShadowMeshCache.end(),
+                                 [&](const auto& entry) { return entry.first == key; });
+    if (it != mShadowMeshCache.end()) {
+        auto entry = std::move(*it);
+        mShadowMeshCache.erase(it);
+        mShadowMeshCache.push_back(std::move(entry));
+        return *mShadowMeshCache.back().second;
+    }
+
+    ATRACE_NAME("tessellateShadow");
     const float casterZ = settings.length / 2.0f;
     const GLShadowVertexGenerator shadows(casterRect, casterCornerRadius, casterZ,
                                           settings.casterIsTranslucent, settings.ambientColor,
@@ -1835,18 +1905,30 @@ void GLESRenderEngine::handleShadow(const FloatRect& casterRect, float casterCor
                                           settings.lightRadius);
 
     // setup mesh for both shadows
-    Mesh mesh = Mesh::Builder()
-                        .setPrimitive(Mesh::TRIANGLES)
-                        .setVertices(shadows.getVertexCount(), 2 /* size */)
-                        .setShadowAttrs()
-                        .setIndices(shadows.getIndexCount())
-                        .build();
-
-    Mesh::VertexArray<vec2> position = mesh.getPositionArray<vec2>();
-    Mesh::VertexArray<vec4> shadowColor = mesh.getShadowColorArray<vec4>();
-    Mesh::VertexArray<vec3> shadowParams = mesh.getShadowParamsArray<vec3>();
+    std::unique_ptr<Mesh> mesh(new Mesh(Mesh::Builder()
+                                                .setPrimitive(Mesh::TRIANGLES)
+                                                .setVertices(shadows.getVertexCount(), 2 /* size */)
+                                                .setShadowAttrs()
+                                                .setIndices(shadows.getIndexCount())
+                                                .build()));
+
+    Mesh::VertexArray<vec2> position = mesh->getPositionArray<vec2>();
+    Mesh::VertexArray<vec4> shadowColor = mesh->getShadowColorArray<vec4>();
+    Mesh::VertexArray<vec3> shadowParams = mesh->getShadowParamsArray<vec3>();
     shadows.fillVertices(position, shadowColor, shadowParams);
-    shadows.fillIndices(mesh.getIndicesArray());
+    shadows.fillIndices(mesh->getIndicesArray());
+
+    if (mShadowMeshCache.size() >= kShadowMeshCacheSize) {
+        mShadowMeshCache.pop_front();
+    }
+    mShadowMeshCache.emplace_back(key, std::move(mesh));
+    return *mShadowMeshCache.back().second;
+}
+
+void GLESRenderEngine::handleShadow(const FloatRect& casterRect, float casterCornerRadius,
+                                    const ShadowSettings& settings) {
+    ATRACE_CALL();
+    const Mesh& mesh = getShadowMesh(casterRect, casterCornerRadius, settings);
 
     mState.cornerRadius = 0.0f;
     mState.drawShadows = true;
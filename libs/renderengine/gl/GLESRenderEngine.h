@@ -172,6 +172,8 @@ private:
     void fillRegionWithColor(const Region& region, float red, float green, float blue, float alpha);
     void handleShadow(const FloatRect& casterRect, float casterCornerRadius,
                       const ShadowSettings& shadowSettings);
+    const Mesh& getShadowMesh(const FloatRect& casterRect, float casterCornerRadius,
+                              const ShadowSettings& shadowSettings);
     void setupLayerBlending(bool premultipliedAlpha, bool opaque, bool disableTexture,
                             const half4& color, float cornerRadius);
     void setupLayerTexturing(const Texture& texture);
@@ -204,6 +206,21 @@ private:
     Description mState;
     std::unique_ptr<GLShadowTexture> mShadowTexture = nullptr;
 
+    // Tessellated shadow meshes, least recently used first. Shadows are only re-tessellated when
+    // the caster's geometry or the shadow settings change, which is rare for most windows.
+    struct ShadowMeshKey {
+        FloatRect casterRect;
+        float casterCornerRadius;
+        ShadowSettings settings;
+
+        bool operator==(const ShadowMeshKey& other) const {
+            return casterRect == other.casterRect &&
+                    casterCornerRadius == other.casterCornerRadius && settings == other.settings;
+        }
+    };
+    static constexpr size_t kShadowMeshCacheSize = 32;
+    std::deque<std::pair<ShadowMeshKey, std::unique_ptr<Mesh>>> mShadowMeshCache;
+
     mat4 mSrgbToXyz;
     mat4 mDisplayP3ToXyz;
     mat4 mBt2020ToXyz;
@@ -245,6 +262,10 @@ private:
     // primeCache().
     const bool mPrecacheToneMapperShaderOnly = false;
 
+    // Thread on which primeCache() generates programs, using a context that shares
+    // objects with the RenderEngine context so that rendering is not held up.
+    std::thread mPrimeCacheThread;
+
     // Cache of GL images that we'll store per GraphicBuffer ID
     std::unordered_map<uint64_t, std::unique_ptr<Image>> mImageCache GUARDED_BY(mRenderingMutex);
     std::unordered_map<uint32_t, std::optional<uint64_t>> mTextureView;
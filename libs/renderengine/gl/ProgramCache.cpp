@@ -18,6 +18,7 @@
 
 #include "ProgramCache.h"
 
+#include <EGL/egl.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <log/log.h>
@@ -79,7 +80,6 @@ Formatter& dedent(Formatter& f) {
 
 void ProgramCache::primeCache(
         EGLContext context, bool useColorManagement, bool toneMapperShaderOnly) {
-    auto& cache = mCaches[context];
     uint32_t shaderCount = 0;
 
     if (toneMapperShaderOnly) {
@@ -101,8 +101,9 @@ void ProgramCache::primeCache(
             // Cache Y410 input on or off
             shaderKey.set(Key::Y410_BT2020_MASK, (i & 2) ?
                     Key::Y410_BT2020_ON : Key::Y410_BT2020_OFF);
-            if (cache.count(shaderKey) == 0) {
-                cache.emplace(shaderKey, generateProgram(shaderKey));
+            bool generated = false;
+            getOrGenerateProgram(context, shaderKey, &generated);
+            if (generated) {
                 shaderCount++;
             }
         }
@@ -122,8 +123,9 @@ void ProgramCache::primeCache(
         if (tex != Key::TEXTURE_OFF && tex != Key::TEXTURE_EXT && tex != Key::TEXTURE_2D) {
             continue;
         }
-        if (cache.count(shaderKey) == 0) {
-            cache.emplace(shaderKey, generateProgram(shaderKey));
+        bool generated = false;
+        getOrGenerateProgram(context, shaderKey, &generated);
+        if (generated) {
             shaderCount++;
         }
     }
@@ -146,8 +148,9 @@ void ProgramCache::primeCache(
 
             // Cache texture off option for window transition
             shaderKey.set(Key::TEXTURE_MASK, (i & 8) ? Key::TEXTURE_EXT : Key::TEXTURE_OFF);
-            if (cache.count(shaderKey) == 0) {
-                cache.emplace(shaderKey, generateProgram(shaderKey));
+            bool generated = false;
+            getOrGenerateProgram(context, shaderKey, &generated);
+            if (generated) {
                 shaderCount++;
             }
         }
@@ -800,25 +803,53 @@ std::unique_ptr<Program> ProgramCache::generateProgram(const Key& needs) {
     return std::make_unique<Program>(needs, vs.string(), fs.string());
 }
 
+Program* ProgramCache::getOrGenerateProgram(EGLContext context, const Key& needs,
+                                           bool* generated) {
+    std::unique_lock lock(mMutex);
+    auto& cache = mCaches[context];
+    auto& pendingKeys = mPendingKeys[context];
+
+    // Waiting for a program being generated on another thread is never slower
+    // than generating it again.
+    mCondition.wait(lock, [&] { return pendingKeys.count(needs) == 0; });
+    if (const auto it = cache.find(needs); it != cache.end()) {
+        *generated = false;
+        return it->second.get();
+    }
+
+    pendingKeys.insert(needs);
+    lock.unlock();
+    std::unique_ptr<Program> program = generateProgram(needs);
+    if (eglGetCurrentContext() != context) {
+        // The program is used from the context it is cached for, so make sure
+        // the commands creating it are submitted before it can be looked up.
+        glFlush();
+    }
+    lock.lock();
+
+    Program* result = program.get();
+    cache.emplace(needs, std::move(program));
+    pendingKeys.erase(needs);
+    mCondition.notify_all();
+    *generated = true;
+    return result;
+}
+
 void ProgramCache::useProgram(EGLContext context, const Description& description) {
     // generate the key for the shader based on the description
     Key needs(computeKey(description));
 
-    // look-up the program in the cache
-    auto& cache = mCaches[context];
-    auto it = cache.find(needs);
-    if (it == cache.end()) {
-        // we didn't find our program, so generate one...
-        nsecs_t time = systemTime();
-        it = cache.emplace(needs, generateProgram(needs)).first;
+    // look-up the program in the cache, or generate one if we didn't find it
+    nsecs_t time = systemTime();
+    bool generated = false;
+    Program* program = getOrGenerateProgram(context, needs, &generated);
+    if (generated) {
         time = systemTime() - time;
-
         ALOGV(">>> generated new program for context %p: needs=%08X, time=%u ms (%zu programs)",
-              context, needs.mKey, uint32_t(ns2ms(time)), cache.size());
+              context, needs.mKey, uint32_t(ns2ms(time)), getSize(context));
     }
 
     // here we have a suitable program for this description
-    std::unique_ptr<Program>& program = it->second;
     if (program->isValid()) {
         program->use();
         program->setUniforms(description);
@@ -17,8 +17,11 @@
 #ifndef SF_RENDER_ENGINE_PROGRAMCACHE_H
 #define SF_RENDER_ENGINE_PROGRAMCACHE_H
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
@@ -194,18 +197,30 @@ public:
     ProgramCache() = default;
     ~ProgramCache() = default;
 
-    // Generate shaders to populate the cache
+    // Generate shaders to populate the cache. This may be called with another
+    // context current, as long as it shares objects with the given context, so
+    // that the cache can be populated from another thread.
     void primeCache(const EGLContext context, bool useColorManagement, bool toneMapperShaderOnly);
 
-    size_t getSize(const EGLContext context) { return mCaches[context].size(); }
+    size_t getSize(const EGLContext context) {
+        std::lock_guard lock(mMutex);
+        return mCaches[context].size();
+    }
 
     // useProgram lookup a suitable program in the cache or generates one
-    // if none can be found.
+    // if none can be found. If the program is being generated by primeCache on
+    // another thread, this waits for it rather than generating it again.
     void useProgram(const EGLContext context, const Description& description);
 
-    void purgeCaches() { mCaches.clear(); }
+    void purgeCaches() {
+        std::lock_guard lock(mMutex);
+        mCaches.clear();
+    }
 
 private:
+    // Returns the program for the Key, generating it if it isn't cached yet.
+    // generated is set to whether this call generated the program.
+    Program* getOrGenerateProgram(const EGLContext context, const Key& needs, bool* generated);
     // compute a cache Key from a Description
     static Key computeKey(const Description& description);
     // Generate EOTF based from Key.
@@ -223,10 +238,17 @@ private:
     // generates the fragment shader from the Key
     static String8 generateFragmentShader(const Key& needs);
 
+    // Guards mCaches and mPendingKeys, and is signaled through mCondition
+    // whenever a pending program has been generated.
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+
     // Key/Value map used for caching Programs. Currently the cache
     // is never shrunk (and the GL program objects are never deleted).
     std::unordered_map<EGLContext, std::unordered_map<Key, std::unique_ptr<Program>, Key::Hash>>
             mCaches;
+    // Keys of the programs being generated, outside of mMutex, for each context.
+    std::unordered_map<EGLContext, std::unordered_set<Key, Key::Hash>> mPendingKeys;
 };
 
 } // namespace gl
@@ -63,13 +63,19 @@ struct DisplaySettings {
 
     // SDR white point, -1f if unknown
     float sdrWhitePointNits = -1.f;
+
+    // If valid, only this part of the output buffer, in physical display space, needs to be
+    // redrawn: the rest of the buffer already holds what the layers would draw there. An
+    // implementation may still redraw the whole buffer.
+    Rect partialUpdateArea = Rect::INVALID_RECT;
 };
 
 static inline bool operator==(const DisplaySettings& lhs, const DisplaySettings& rhs) {
     return lhs.physicalDisplay == rhs.physicalDisplay && lhs.clip == rhs.clip &&
             lhs.maxLuminance == rhs.maxLuminance && lhs.outputDataspace == rhs.outputDataspace &&
             lhs.colorTransform == rhs.colorTransform &&
-            lhs.clearRegion.hasSameRects(rhs.clearRegion) && lhs.orientation == rhs.orientation;
+            lhs.clearRegion.hasSameRects(rhs.clearRegion) && lhs.orientation == rhs.orientation &&
+            lhs.partialUpdateArea == rhs.partialUpdateArea;
 }
 
 // Defining PrintTo helps with Google Tests.
@@ -86,6 +92,8 @@ static inline void PrintTo(const DisplaySettings& settings, ::std::ostream* os)
     *os << "\n    .clearRegion = ";
     PrintTo(settings.clearRegion, os);
     *os << "\n    .orientation = " << settings.orientation;
+    *os << "\n    .partialUpdateArea = ";
+    PrintTo(settings.partialUpdateArea, os);
     *os << "\n}";
 }
 
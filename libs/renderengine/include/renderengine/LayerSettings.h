@@ -66,6 +66,11 @@ struct Buffer {
     bool isY410BT2020 = false;
 
     float maxLuminanceNits = 0.0;
+
+    // Frame number of the content latched into the buffer, so that renderers can tell when the
+    // same buffer holds new content. 0 if unknown, in which case nothing derived from the
+    // buffer's content may be reused across frames.
+    uint64_t frameNumber = 0;
 };
 
 // Metadata describing the layer geometry.
@@ -182,7 +187,7 @@ static inline bool operator==(const Buffer& lhs, const Buffer& rhs) {
             lhs.textureTransform == rhs.textureTransform &&
             lhs.usePremultipliedAlpha == rhs.usePremultipliedAlpha &&
             lhs.isOpaque == rhs.isOpaque && lhs.isY410BT2020 == rhs.isY410BT2020 &&
-            lhs.maxLuminanceNits == rhs.maxLuminanceNits;
+            lhs.maxLuminanceNits == rhs.maxLuminanceNits && lhs.frameNumber == rhs.frameNumber;
 }
 
 static inline bool operator==(const Geometry& lhs, const Geometry& rhs) {
@@ -236,6 +241,7 @@ static inline void PrintTo(const Buffer& settings, ::std::ostream* os) {
     *os << "\n    .isOpaque = " << settings.isOpaque;
     *os << "\n    .isY410BT2020 = " << settings.isY410BT2020;
     *os << "\n    .maxLuminanceNits = " << settings.maxLuminanceNits;
+    *os << "\n    .frameNumber = " << settings.frameNumber;
     *os << "\n}";
 }
 
@@ -29,11 +29,15 @@
 #include <ui/GraphicTypes.h>
 #include <ui/Transform.h>
 
+#include <functional>
 #include <future>
 #include <memory>
+#include <vector>
 
 /**
  * Allows to set RenderEngine backend to GLES (default) or SkiaGL (NOT yet supported).
+ * "skiavk" and "skiavkthreaded" select the Skia Vulkan backend, falling back to SkiaGL on devices
+ * whose Vulkan driver lacks what it needs.
  */
 #define PROPERTY_DEBUG_RENDERENGINE_BACKEND "debug.renderengine.backend"
 
@@ -54,6 +58,26 @@
  */
 #define PROPERTY_SKIA_ATRACE_ENABLED "debug.renderengine.skia_atrace_enabled"
 
+/**
+ * File in which Skia RE keeps the shaders it compiled, so that they can be compiled again when the
+ * cache is primed on the next boot. Must be writable by the process using RenderEngine. Empty
+ * (the default) disables it.
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_SHADER_CACHE_PATH "debug.renderengine.shader_cache_path"
+
+/**
+ * Caps the memory, in MiB, of the buffers Skia RE keeps imported as textures. The least recently
+ * used ones are dropped past it. 0 (the default) leaves the cache unbounded.
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_TEXTURE_CACHE_MB "debug.renderengine.texture_cache_mb"
+
+/**
+ * Makes Skia RE wait on the GPU for the acquire fences of the buffers it draws, instead of
+ * assuming that they have signaled. The fences of a drawLayers call are merged into a single wait,
+ * so that buffers from producers that finish late don't block the RenderEngine thread.
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_WAIT_LAYER_FENCES "debug.renderengine.wait_layer_fences"
+
 struct ANativeWindowBuffer;
 
 namespace android {
@@ -96,6 +120,8 @@ public:
         THREADED = 2,
         SKIA_GL = 3,
         SKIA_GL_THREADED = 4,
+        SKIA_VK = 5,
+        SKIA_VK_THREADED = 6,
     };
 
     static std::unique_ptr<RenderEngine> create(const RenderEngineCreationArgs& args);
@@ -170,6 +196,22 @@ public:
                                 const bool useFramebufferCache, base::unique_fd&& bufferFence,
                                 base::unique_fd* drawFence) = 0;
 
+    using DrawLayersCallback = std::function<void(status_t, base::unique_fd&&)>;
+
+    // Like drawLayers, but the caller does not wait for the layers to be
+    // drawn. The display, layers and buffer are copied, so the caller may
+    // release them once this returns. Implementations with their own thread
+    // may defer the draw until that thread has nothing else to do, so this is
+    // meant for work such as screenshots that must not delay composition.
+    // @param useProtectedContext Whether to draw in the protected context. The
+    // context is switched back once drawing is done.
+    // @param callback Invoked with drawLayers' result and draw fence once the
+    // draw has been submitted, possibly on another thread. It should not block.
+    virtual void drawLayersAsync(const DisplaySettings& display, std::vector<LayerSettings> layers,
+                                 const std::shared_ptr<ExternalTexture>& buffer,
+                                 bool useProtectedContext, base::unique_fd&& bufferFence,
+                                 DrawLayersCallback&& callback);
+
     // Clean-up method that should be called on the main thread after the
     // drawFence returned by drawLayers fires. This method will free up
     // resources used by the most recently drawn frame. If the frame is still
@@ -50,6 +50,18 @@ const auto kFlip = mat4(1.1f, -0.1f,  0.f, 0.f,
 // a color correction effect is added to the shader.
 constexpr auto kDestDataSpace = ui::Dataspace::SRGB;
 constexpr auto kOtherDataSpace = ui::Dataspace::DISPLAY_P3;
+// Dataspaces of the HDR content that must be tone mapped to the SDR output dataspaces above. Video
+// decoders usually produce the ITU (limited range) variants, while apps and games produce the
+// full range ones.
+constexpr ui::Dataspace kHdrDataSpaces[] = {
+        ui::Dataspace::BT2020_PQ,
+        ui::Dataspace::BT2020_ITU_PQ,
+        ui::Dataspace::BT2020_HLG,
+        ui::Dataspace::BT2020_ITU_HLG,
+};
+// Below the display's max luminance, so that SDR layers are dimmed with a LinearEffect too, as they
+// are while HDR content is on screen.
+constexpr float kSdrWhitePointNits = 250.f;
 } // namespace
 
 static void drawShadowLayers(SkiaRenderEngine* renderengine, const DisplaySettings& display,
@@ -158,6 +170,49 @@ static void drawImageLayers(SkiaRenderEngine* renderengine, const DisplaySetting
     }
 }
 
+// Every LinearEffect is built from its own SkSL, which is slow to compile for the tone mapping
+// ones, so draw each combination of input dataspace, output dataspace and alpha handling the
+// displays can end up with once HDR content starts playing.
+static void drawLinearEffectLayers(SkiaRenderEngine* renderengine, const DisplaySettings& display,
+                                   const std::shared_ptr<ExternalTexture>& dstTexture,
+                                   const std::shared_ptr<ExternalTexture>& srcTexture) {
+    const Rect& displayRect = display.physicalDisplay;
+    FloatRect rect(0, 0, displayRect.width(), displayRect.height());
+    LayerSettings layer{
+            .geometry =
+                    Geometry{
+                            .positionTransform = mat4(),
+                            .boundaries = rect,
+                    },
+            .source = PixelSource{.buffer =
+                                          Buffer{
+                                                  .buffer = srcTexture,
+                                                  .maxLuminanceNits = 1000.f,
+                                          }},
+            .alpha = 1,
+    };
+
+    DisplaySettings dimmedDisplay = display;
+    dimmedDisplay.sdrWhitePointNits = kSdrWhitePointNits;
+
+    auto layers = std::vector<const LayerSettings*>{&layer};
+    auto drawWithDataspace = [&](ui::Dataspace dataspace, const DisplaySettings& settings) {
+        layer.sourceDataspace = dataspace;
+        // Translucent buffers need the variant of the effect that undoes premultiplied alpha.
+        for (bool isOpaque : {true, false}) {
+            layer.source.buffer.isOpaque = isOpaque;
+            renderengine->drawLayers(settings, layers, dstTexture, kUseFrameBufferCache,
+                                     base::unique_fd(), nullptr);
+        }
+    };
+    for (auto dataspace : kHdrDataSpaces) {
+        drawWithDataspace(dataspace, display);
+    }
+    for (auto dataspace : {kDestDataSpace, kOtherDataSpace}) {
+        drawWithDataspace(dataspace, dimmedDisplay);
+    }
+}
+
 static void drawSolidLayers(SkiaRenderEngine* renderengine, const DisplaySettings& display,
                             const std::shared_ptr<ExternalTexture>& dstTexture) {
     const Rect& displayRect = display.physicalDisplay;
@@ -419,12 +474,17 @@ void Cache::primeShaderCache(SkiaRenderEngine* renderengine) {
             drawClippedLayers(renderengine, display, dstTexture, texture);
         }
 
+        for (const auto& settings : {display, p3Display}) {
+            drawLinearEffectLayers(renderengine, settings, dstTexture, externalTexture);
+        }
+
         drawPIPImageLayer(renderengine, display, dstTexture, externalTexture);
 
         const nsecs_t timeAfter = systemTime();
         const float compileTimeMs = static_cast<float>(timeAfter - timeBefore) / 1.0E6;
         const int shadersCompiled = renderengine->reportShadersCompiled();
-        ALOGD("Shader cache generated %d shaders in %f ms\n", shadersCompiled, compileTimeMs);
+        ALOGD("Shader cache generated %d shaders and %zu runtime effects in %f ms\n",
+              shadersCompiled, renderengine->getRuntimeEffectCount(), compileTimeMs);
     }
 }
 
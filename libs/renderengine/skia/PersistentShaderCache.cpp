@@ -0,0 +1,233 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "RenderEngine"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "PersistentShaderCache.h"
+
+#include <android-base/file.h>
+#include <log/log.h>
+#include <pthread.h>
+#include <utils/Trace.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+namespace android::renderengine::skia {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+constexpr uint32_t kMagic = 0x52455343; // 'RESC'
+constexpr uint32_t kVersion = 1;
+
+// Time without new shaders after which the file is written.
+constexpr auto kWriteDelay = 5s;
+
+// Bounds on what gets persisted, in case something keeps generating new shaders.
+constexpr size_t kMaxShaders = 1024;
+constexpr size_t kMaxTotalSize = 4 * 1024 * 1024;
+
+void appendUint32(std::string* out, uint32_t value) {
+    out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void appendBytes(std::string* out, const std::string& bytes) {
+    appendUint32(out, static_cast<uint32_t>(bytes.size()));
+    out->append(bytes);
+}
+
+// Reads from a serialized cache, failing once the input is exhausted.
+class Reader {
+public:
+    explicit Reader(const std::string& input) : mInput(input) {}
+
+    bool readUint32(uint32_t* value) {
+        if (mInput.size() - mOffset < sizeof(*value)) return false;
+        memcpy(value, mInput.data() + mOffset, sizeof(*value));
+        mOffset += sizeof(*value);
+        return true;
+    }
+
+    bool readBytes(std::string* bytes) {
+        uint32_t size;
+        if (!readUint32(&size) || mInput.size() - mOffset < size) return false;
+        bytes->assign(mInput, mOffset, size);
+        mOffset += size;
+        return true;
+    }
+
+private:
+    const std::string& mInput;
+    size_t mOffset = 0;
+};
+
+std::string toString(const SkData& data) {
+    return std::string(static_cast<const char*>(data.data()), data.size());
+}
+
+} // namespace
+
+PersistentShaderCache::PersistentShaderCache(std::string path, std::string identity)
+      : mPath(std::move(path)), mIdentity(std::move(identity)) {
+    {
+        std::lock_guard lock(mMutex);
+        readFromFile();
+    }
+    mWriterThread = std::thread(&PersistentShaderCache::writerLoop, this);
+}
+
+PersistentShaderCache::~PersistentShaderCache() {
+    {
+        std::lock_guard lock(mMutex);
+        mStopped = true;
+    }
+    mCondition.notify_one();
+    mWriterThread.join();
+}
+
+sk_sp<SkData> PersistentShaderCache::load(const SkData& key) {
+    std::lock_guard lock(mMutex);
+    const auto it = mShaders.find(toString(key));
+    return it == mShaders.end() ? nullptr : it->second;
+}
+
+void PersistentShaderCache::store(const SkData& key, const SkData& data) {
+    std::lock_guard lock(mMutex);
+    if (mShaders.size() >= kMaxShaders ||
+        mTotalSize + key.size() + data.size() > kMaxTotalSize) {
+        return;
+    }
+
+    auto& shader = mShaders[toString(key)];
+    if (shader) {
+        mTotalSize -= shader->size();
+    } else {
+        mTotalSize += key.size();
+    }
+    shader = SkData::MakeWithCopy(data.data(), data.size());
+    mTotalSize += data.size();
+    mUnwrittenShaders++;
+    mCondition.notify_one();
+}
+
+void PersistentShaderCache::forEachShader(
+        const std::function<void(const SkData& key, const SkData& data)>& visitor) {
+    std::unordered_map<std::string, sk_sp<SkData>> shaders;
+    {
+        std::lock_guard lock(mMutex);
+        shaders = mShaders;
+    }
+    for (const auto& [key, data] : shaders) {
+        visitor(*SkData::MakeWithoutCopy(key.data(), key.size()), *data);
+    }
+}
+
+void PersistentShaderCache::readFromFile() {
+    std::string contents;
+    if (!base::ReadFileToString(mPath, &contents)) {
+        ALOGD("No shader cache at %s", mPath.c_str());
+        return;
+    }
+
+    Reader reader(contents);
+    uint32_t magic, version, count;
+    std::string identity;
+    if (!reader.readUint32(&magic) || magic != kMagic || !reader.readUint32(&version) ||
+        version != kVersion || !reader.readBytes(&identity) || !reader.readUint32(&count)) {
+        ALOGW("Ignoring shader cache at %s with an unexpected header", mPath.c_str());
+        return;
+    }
+    if (identity != mIdentity) {
+        ALOGI("Ignoring shader cache at %s from another build or driver", mPath.c_str());
+        return;
+    }
+
+    for (uint32_t i = 0; i < count && mShaders.size() < kMaxShaders; i++) {
+        std::string key, data;
+        if (!reader.readBytes(&key) || !reader.readBytes(&data)) {
+            ALOGW("Shader cache at %s is truncated", mPath.c_str());
+            break;
+        }
+        mTotalSize += key.size() + data.size();
+        mShaders[std::move(key)] = SkData::MakeWithCopy(data.data(), data.size());
+    }
+    ALOGD("Loaded %zu shaders from %s", mShaders.size(), mPath.c_str());
+}
+
+std::string PersistentShaderCache::serializeLocked() const {
+    std::string contents;
+    contents.reserve(mTotalSize + mIdentity.size() + (mShaders.size() + 2) * 2 * sizeof(uint32_t));
+    appendUint32(&contents, kMagic);
+    appendUint32(&contents, kVersion);
+    appendBytes(&contents, mIdentity);
+    appendUint32(&contents, static_cast<uint32_t>(mShaders.size()));
+    for (const auto& [key, data] : mShaders) {
+        appendBytes(&contents, key);
+        appendBytes(&contents, toString(*data));
+    }
+    return contents;
+}
+
+void PersistentShaderCache::writeToFile(const std::string& contents) {
+    ATRACE_CALL();
+    // Write to a temporary file first, so that a crash never leaves a partial cache behind.
+    const std::string tempPath = mPath + ".tmp";
+    if (!base::WriteStringToFile(contents, tempPath)) {
+        ALOGW("Failed to write shader cache to %s", tempPath.c_str());
+        return;
+    }
+    if (rename(tempPath.c_str(), mPath.c_str()) != 0) {
+        ALOGW("Failed to move shader cache to %s: %s", mPath.c_str(), strerror(errno));
+        unlink(tempPath.c_str());
+    }
+}
+
+void PersistentShaderCache::writerLoop() {
+    if (pthread_setname_np(pthread_self(), "REShaderCache")) {
+        ALOGW("Failed to set thread name on shader cache thread");
+    }
+
+    std::unique_lock lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this]() REQUIRES(mMutex) { return mStopped || mUnwrittenShaders; });
+        if (mStopped) {
+            return;
+        }
+
+        // Wait for shaders to stop coming in, since they are usually compiled in bursts.
+        size_t unwrittenShaders;
+        do {
+            unwrittenShaders = mUnwrittenShaders;
+            mCondition.wait_for(lock, kWriteDelay, [this]() REQUIRES(mMutex) { return mStopped; });
+        } while (!mStopped && unwrittenShaders != mUnwrittenShaders);
+        if (mStopped) {
+            return;
+        }
+
+        const std::string contents = serializeLocked();
+        mUnwrittenShaders = 0;
+        lock.unlock();
+        writeToFile(contents);
+        lock.lock();
+    }
+}
+
+} // namespace android::renderengine::skia
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <SkData.h>
+#include <SkRefCnt.h>
+#include <android-base/thread_annotations.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace android::renderengine::skia {
+
+// Shaders compiled by Skia, kept in a file so that the shaders a device actually uses can be
+// compiled again at boot rather than on first use. Entries are only reused as long as the build
+// and the GL driver are the same as when they were stored.
+//
+// The file is written on a separate thread, once no new shader was stored for a few seconds, so
+// storing a shader never blocks rendering on I/O.
+class PersistentShaderCache {
+public:
+    // Loads the shaders stored at path by an earlier run with the same identity, if any.
+    PersistentShaderCache(std::string path, std::string identity);
+    ~PersistentShaderCache();
+
+    // Returns the data stored for the key, or nullptr.
+    sk_sp<SkData> load(const SkData& key);
+    void store(const SkData& key, const SkData& data);
+
+    // Calls the visitor for every shader in the cache.
+    void forEachShader(const std::function<void(const SkData& key, const SkData& data)>& visitor);
+
+private:
+    void readFromFile() REQUIRES(mMutex);
+    void writeToFile(const std::string& contents);
+    std::string serializeLocked() const REQUIRES(mMutex);
+    void writerLoop();
+
+    const std::string mPath;
+    const std::string mIdentity;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::unordered_map<std::string, sk_sp<SkData>> mShaders GUARDED_BY(mMutex);
+    size_t mTotalSize GUARDED_BY(mMutex) = 0;
+    // Number of shaders stored since the file was last written.
+    size_t mUnwrittenShaders GUARDED_BY(mMutex) = 0;
+    bool mStopped GUARDED_BY(mMutex) = false;
+    std::thread mWriterThread;
+};
+
+} // namespace android::renderengine::skia
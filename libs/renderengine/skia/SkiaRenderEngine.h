@@ -17,9 +17,27 @@
 #ifndef SF_SKIARENDERENGINE_H_
 #define SF_SKIARENDERENGINE_H_
 
+#include <GrContextOptions.h>
+#include <GrDirectContext.h>
+#include <SkSurface.h>
+#include <android-base/macros.h>
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
+#include <renderengine/ExternalTexture.h>
 #include <renderengine/RenderEngine.h>
 #include <sys/types.h>
 
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "AutoBackendTexture.h"
+#include "PersistentShaderCache.h"
+#include "debug/SkiaCapture.h"
+#include "filters/BlurFilter.h"
+#include "filters/LinearEffect.h"
+#include "filters/StretchShaderFactory.h"
+
 namespace android {
 
 namespace renderengine {
@@ -31,36 +49,220 @@ namespace skia {
 
 class BlurFilter;
 
-// TODO: Put common skia stuff here that can be shared between the GL & Vulkan backends
-// Currently mostly just handles all the no-op / missing APIs
+// Draws layers with Skia, sharing everything but the GPU context setup, fences and submission
+// between the GL and Vulkan backends.
 class SkiaRenderEngine : public RenderEngine {
 public:
     static std::unique_ptr<SkiaRenderEngine> create(const RenderEngineCreationArgs& args);
-    SkiaRenderEngine(RenderEngineType type);
-    ~SkiaRenderEngine() override {}
+    SkiaRenderEngine(RenderEngineType type, PixelFormat pixelFormat, bool useColorManagement,
+                     bool supportsBackgroundBlur);
+    ~SkiaRenderEngine() override;
 
-    virtual std::future<void> primeCache() override { return {}; };
+    std::future<void> primeCache() override;
     virtual void genTextures(size_t /*count*/, uint32_t* /*names*/) override{};
     virtual void deleteTextures(size_t /*count*/, uint32_t const* /*names*/) override{};
-    virtual bool isProtected() const override { return false; } // mInProtectedContext; }
-    virtual bool supportsProtectedContent() const override { return false; };
-    virtual status_t drawLayers(const DisplaySettings& /*display*/,
-                                const std::vector<const LayerSettings*>& /*layers*/,
-                                const std::shared_ptr<ExternalTexture>& /*buffer*/,
-                                const bool /*useFramebufferCache*/,
-                                base::unique_fd&& /*bufferFence*/,
-                                base::unique_fd* /*drawFence*/) override {
-        return 0;
-    };
-    virtual int getContextPriority() override { return 0; }
-    virtual void assertShadersCompiled(int numShaders) {}
-    virtual int reportShadersCompiled() { return 0; }
+    bool isProtected() const override { return mInProtectedContext; }
+    void useProtectedContext(bool useProtectedContext) override;
+    status_t drawLayers(const DisplaySettings& display,
+                        const std::vector<const LayerSettings*>& layers,
+                        const std::shared_ptr<ExternalTexture>& buffer,
+                        const bool useFramebufferCache, base::unique_fd&& bufferFence,
+                        base::unique_fd* drawFence) override;
+    void cleanupPostRender() override;
+    void cleanFramebufferCache() override{};
+    bool supportsBackgroundBlur() override { return mBlurFilter != nullptr; }
+    virtual void assertShadersCompiled(int numShaders);
+    void onPrimaryDisplaySizeChanged(ui::Size size) override;
+    virtual int reportShadersCompiled();
+    int getRETid() override { return gettid(); }
     void setViewportAndProjection(Rect /*viewPort*/, Rect /*sourceCrop*/) override { }
+    // Returns the number of LinearEffects built so far, e.g. by Cache::primeShaderCache.
+    size_t getRuntimeEffectCount() const EXCLUDES(mRenderingMutex);
 
 protected:
-    virtual void mapExternalTextureBuffer(const sp<GraphicBuffer>& /*buffer*/,
-                                          bool /*isRenderable*/) override = 0;
-    virtual void unmapExternalTextureBuffer(const sp<GraphicBuffer>& /*buffer*/) override = 0;
+    void dump(std::string& result) override;
+    size_t getMaxTextureSize() const override;
+    size_t getMaxViewportDims() const override;
+    void mapExternalTextureBuffer(const sp<GraphicBuffer>& buffer, bool isRenderable) override;
+    void unmapExternalTextureBuffer(const sp<GraphicBuffer>& buffer) override;
+    bool canSkipPostRenderCleanup() const override;
+
+    // Returns the options the backend should create its GrDirectContexts with. driverIdentity
+    // describes the GPU driver, so that persisted shaders are not used with another one.
+    GrContextOptions createGrContextOptions(const std::string& driverIdentity);
+    // Releases the GrDirectContexts. Must be called by the backend before it tears down the
+    // objects they were created from.
+    void finishRenderingAndAbandonContexts() EXCLUDES(mRenderingMutex);
+
+    // Makes the protected or unprotected context current. Returns false if it fails, in which
+    // case the current context must not change.
+    virtual bool useProtectedContextImpl(GrProtected isProtected) = 0;
+    // Makes the GPU work submitted after this call wait for the fence. Falls back to waiting on
+    // the CPU if the backend can't.
+    virtual void waitFence(GrDirectContext* grContext, base::borrowed_fd fenceFd) = 0;
+    // Submits the work flushed to grContext. If drawFence is not null, it is set to a fence that
+    // signals once that work is done, or to -1 once the work is done if no fence can be created.
+    virtual status_t flushAndSubmit(GrDirectContext* grContext, base::unique_fd* drawFence) = 0;
+    virtual void appendBackendSpecificInfoToDump(std::string& result) = 0;
+
+    GrDirectContext* getActiveGrContext() const;
+
+    // Graphics context used for creating surfaces and submitting commands
+    sk_sp<GrDirectContext> mGrContext;
+    // Same as above, but for protected content (eg. DRM)
+    sk_sp<GrDirectContext> mProtectedGrContext;
+
+private:
+    // Identifier used or various mappings of layers to various
+    // textures or shaders
+    using GraphicBufferId = uint64_t;
+
+    inline SkRect getSkRect(const FloatRect& layer);
+    inline SkRect getSkRect(const Rect& layer);
+    inline std::pair<SkRRect, SkRRect> getBoundsAndClip(const FloatRect& bounds,
+                                                        const FloatRect& crop, float cornerRadius);
+    inline bool layerHasBlur(const LayerSettings* layer, bool colorTransformModifiesAlpha);
+    inline SkColor getSkColor(const vec4& color);
+    inline SkM44 getSkM44(const mat4& matrix);
+    inline SkPoint3 getSkPoint3(const vec3& vector);
+
+    // Returns the cached texture for the buffer, marking it as the most recently used.
+    std::shared_ptr<AutoBackendTexture::LocalRef> findCachedTexture(GraphicBufferId id)
+            REQUIRES(mRenderingMutex);
+    void cacheTexture(const sp<GraphicBuffer>& buffer,
+                      std::shared_ptr<AutoBackendTexture::LocalRef> texture)
+            REQUIRES(mRenderingMutex);
+    void uncacheTexture(GraphicBufferId id) REQUIRES(mRenderingMutex);
+
+    // Makes the GPU wait for bufferFence, and for the acquire fences of the layers that haven't
+    // signaled yet if mWaitLayerFences is set, merging them so that the backend waits only once.
+    void waitInputFences(GrDirectContext* grContext,
+                         const std::vector<const LayerSettings*>& layers,
+                         base::unique_fd&& bufferFence) REQUIRES(mRenderingMutex);
+
+    // Returns blurInput blurred over blurRect, reusing a blur an earlier frame generated with the
+    // same settings and the same layers drawn below blurringLayer, if any.
+    sk_sp<SkImage> generateBlur(GrDirectContext* grContext, const DisplaySettings& display,
+                                const std::vector<const LayerSettings*>& layers,
+                                const LayerSettings* blurringLayer, uint32_t blurRadius,
+                                const sk_sp<SkImage>& blurInput, const SkRect& blurRect)
+            REQUIRES(mRenderingMutex);
+
+    void initCanvas(SkCanvas* canvas, const DisplaySettings& display);
+    void drawShadow(SkCanvas* canvas, const SkRRect& casterRRect,
+                    const ShadowSettings& shadowSettings);
+    // If requiresLinearEffect is true or the layer has a stretchEffect a new shader is returned.
+    // Otherwise it returns the input shader.
+    sk_sp<SkShader> createRuntimeEffectShader(sk_sp<SkShader> shader,
+                                              const LayerSettings* layer,
+                                              const DisplaySettings& display,
+                                              bool undoPremultipliedAlpha,
+                                              bool requiresLinearEffect);
+
+    BlurFilter* mBlurFilter = nullptr;
+
+    const PixelFormat mDefaultPixelFormat;
+    const bool mUseColorManagement;
+    // Number of bytes of mapped textures kept in mTextureCache, or 0 if it is unbounded.
+    const size_t mTextureCacheBudget;
+    const bool mWaitLayerFences;
+
+    // Number of external holders of ExternalTexture references, per GraphicBuffer ID.
+    std::unordered_map<GraphicBufferId, int32_t> mGraphicBufferExternalRefs
+            GUARDED_BY(mRenderingMutex);
+    // Cache of GPU textures that we'll store per GraphicBuffer ID, shared between GPU contexts.
+    // Once the textures use more than mTextureCacheBudget, the least recently used ones are
+    // dropped, and drawn from a temporary import until they are mapped again.
+    struct CachedTexture {
+        std::shared_ptr<AutoBackendTexture::LocalRef> texture;
+        size_t size;
+        std::list<GraphicBufferId>::iterator lruPosition;
+    };
+    std::unordered_map<GraphicBufferId, CachedTexture> mTextureCache GUARDED_BY(mRenderingMutex);
+    // Buffer IDs in mTextureCache, most recently used first.
+    std::list<GraphicBufferId> mTextureCacheLru GUARDED_BY(mRenderingMutex);
+    size_t mTextureCacheSize GUARDED_BY(mRenderingMutex) = 0;
+    size_t mTextureCacheEvictions GUARDED_BY(mRenderingMutex) = 0;
+    // Blurs generated by recent frames, most recently used first. The content below a blurring
+    // layer rarely changes while it is shown (e.g. the shade over a still launcher), so the blur
+    // can usually be drawn again without running its passes.
+    struct CachedBlurLayer {
+        GraphicBufferId bufferId;
+        // Without the buffer and its fence, so that the cache doesn't keep buffers alive.
+        LayerSettings settings;
+
+        bool operator==(const CachedBlurLayer& other) const {
+            return bufferId == other.bufferId && settings == other.settings;
+        }
+    };
+    struct CachedBlur {
+        GrDirectContext* grContext;
+        DisplaySettings display;
+        std::vector<CachedBlurLayer> layersBelow;
+        uint32_t blurRadius;
+        SkRect blurRect;
+        sk_sp<SkImage> blurredImage;
+    };
+    std::list<CachedBlur> mBlurCache GUARDED_BY(mRenderingMutex);
+    size_t mBlurCacheHits GUARDED_BY(mRenderingMutex) = 0;
+    size_t mBlurCacheMisses GUARDED_BY(mRenderingMutex) = 0;
+    // What drawLayers asked Skia to do for the last frame. A frame with many more draws or canvas
+    // saves than layers spends its CPU time in draw submission rather than in the layers.
+    struct DrawStats {
+        size_t layers = 0;
+        size_t draws = 0;
+        size_t saves = 0;
+        size_t clips = 0;
+        size_t shaders = 0;
+    };
+    DrawStats mLastFrameDrawStats GUARDED_BY(mRenderingMutex);
+    std::unordered_map<LinearEffect, sk_sp<SkRuntimeEffect>, LinearEffectHasher> mRuntimeEffects;
+    // Lookups of mRuntimeEffects. Misses after primeCache() are effects it doesn't build yet.
+    size_t mRuntimeEffectHits = 0;
+    size_t mRuntimeEffectMisses = 0;
+    AutoBackendTexture::CleanupManager mTextureCleanupMgr GUARDED_BY(mRenderingMutex);
+
+    StretchShaderFactory mStretchShaderFactory;
+    // Mutex guarding rendering operations, so that:
+    // 1. GPU operations aren't interleaved, and
+    // 2. Internal state related to rendering that is potentially modified by
+    // multiple threads is guaranteed thread-safe.
+    mutable std::mutex mRenderingMutex;
+
+    bool mInProtectedContext = false;
+    // Object to capture commands send to Skia.
+    std::unique_ptr<SkiaCapture> mCapture;
+
+    // Implements PersistentCache as a way to monitor what SkSL shaders Skia has
+    // cached. When a PersistentShaderCache is set, shaders are also loaded from and
+    // stored to it, so that they can be compiled again by the next primeCache().
+    class SkSLCacheMonitor : public GrContextOptions::PersistentCache {
+    public:
+        SkSLCacheMonitor() = default;
+        ~SkSLCacheMonitor() override = default;
+
+        sk_sp<SkData> load(const SkData& key) override;
+
+        void store(const SkData& key, const SkData& data, const SkString& description) override;
+
+        int shadersCachedSinceLastCall() {
+            const int shadersCachedSinceLastCall = mShadersCachedSinceLastCall;
+            mShadersCachedSinceLastCall = 0;
+            return shadersCachedSinceLastCall;
+        }
+
+        void setPersistentCache(std::unique_ptr<PersistentShaderCache> persistentCache) {
+            mPersistentCache = std::move(persistentCache);
+        }
+
+        PersistentShaderCache* persistentCache() const { return mPersistentCache.get(); }
+
+    private:
+        int mShadersCachedSinceLastCall = 0;
+        std::unique_ptr<PersistentShaderCache> mPersistentCache;
+    };
+
+    SkSLCacheMonitor mSkSLCacheMonitor;
 };
 
 } // namespace skia
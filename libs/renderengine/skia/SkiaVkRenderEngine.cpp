@@ -0,0 +1,561 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "RenderEngine"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "SkiaVkRenderEngine.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GrBackendSemaphore.h>
+#include <GrContextOptions.h>
+#include <android-base/stringprintf.h>
+#include <log/log.h>
+#include <sync/sync.h>
+#include <utils/Trace.h>
+#include <vk/GrVkBackendContext.h>
+#include <vk/GrVkExtensions.h>
+#include <vk/GrVkTypes.h>
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace renderengine {
+namespace skia {
+
+using base::StringAppendF;
+
+namespace {
+
+// Device extensions RenderEngine can't work without: importing AHardwareBuffers as VkImages
+// (which also needs the foreign queue family to hand them back to the rest of the system), and
+// exchanging fences with the rest of the system as sync fds.
+const char* const kRequiredDeviceExtensions[] = {
+        VK_ANDROID_EXTERNAL_MEMORY_ANDROID_HARDWARE_BUFFER_EXTENSION_NAME,
+        VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME,
+        VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
+};
+
+VkQueueGlobalPriorityEXT toVkPriority(RenderEngine::ContextPriority priority) {
+    switch (priority) {
+        case RenderEngine::ContextPriority::REALTIME:
+            return VK_QUEUE_GLOBAL_PRIORITY_REALTIME_EXT;
+        case RenderEngine::ContextPriority::MEDIUM:
+            return VK_QUEUE_GLOBAL_PRIORITY_MEDIUM_EXT;
+        case RenderEngine::ContextPriority::LOW:
+            return VK_QUEUE_GLOBAL_PRIORITY_LOW_EXT;
+        case RenderEngine::ContextPriority::HIGH:
+        default:
+            return VK_QUEUE_GLOBAL_PRIORITY_HIGH_EXT;
+    }
+}
+
+PFN_vkVoidFunction getProc(const char* name, VkInstance instance, VkDevice device) {
+    if (device != VK_NULL_HANDLE) {
+        return vkGetDeviceProcAddr(device, name);
+    }
+    return vkGetInstanceProcAddr(instance, name);
+}
+
+// Semaphores signalled by a flush may only be destroyed once the GPU is done with them, which Skia
+// reports through the finished callback, and once their sync fd has been exported. Whichever
+// happens last destroys the semaphore.
+struct DestroySemaphoreInfo {
+    VkDevice device;
+    VkSemaphore semaphore;
+    int refs = 2;
+};
+
+void unrefSemaphore(DestroySemaphoreInfo* info) {
+    if (--info->refs == 0) {
+        vkDestroySemaphore(info->device, info->semaphore, nullptr);
+        delete info;
+    }
+}
+
+void onSemaphoreFinished(GrGpuFinishedContext context) {
+    unrefSemaphore(static_cast<DestroySemaphoreInfo*>(context));
+}
+
+} // namespace
+
+// Owns the Vulkan instance and device RenderEngine draws with. The unprotected and protected
+// GrDirectContexts each get their own queue on the same device, so that images imported by one
+// can be drawn by the other.
+struct SkiaVkRenderEngine::VulkanInterface {
+    ~VulkanInterface();
+
+    // Creates the instance and device. Returns false if Vulkan is missing anything we need.
+    bool init(const RenderEngineCreationArgs& args);
+
+    GrVkBackendContext getBackendContext(GrProtected isProtected) const;
+
+    VkSemaphore createExportableSemaphore() const;
+    // Takes ownership of fenceFd on success.
+    VkSemaphore importSemaphoreFromSyncFd(int fenceFd) const;
+    base::unique_fd exportSemaphoreSyncFd(VkSemaphore semaphore) const;
+
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties physicalDeviceProperties = {};
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t queueIndex = 0;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkQueue protectedQueue = VK_NULL_HANDLE;
+    std::optional<RenderEngine::ContextPriority> priority;
+
+    std::vector<const char*> deviceExtensions;
+    GrVkExtensions grExtensions;
+    VkPhysicalDeviceFeatures2 features = {};
+    VkPhysicalDeviceSamplerYcbcrConversionFeatures ycbcrFeatures = {};
+    VkPhysicalDeviceProtectedMemoryFeatures protectedMemoryFeatures = {};
+
+    PFN_vkImportSemaphoreFdKHR importSemaphoreFd = nullptr;
+    PFN_vkGetSemaphoreFdKHR getSemaphoreFd = nullptr;
+
+private:
+    VkResult createDevice(bool withProtectedQueue, bool withPriority,
+                          RenderEngine::ContextPriority contextPriority);
+};
+
+SkiaVkRenderEngine::VulkanInterface::~VulkanInterface() {
+    if (device != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(device);
+        vkDestroyDevice(device, nullptr);
+    }
+    if (instance != VK_NULL_HANDLE) {
+        vkDestroyInstance(instance, nullptr);
+    }
+}
+
+bool SkiaVkRenderEngine::VulkanInterface::init(const RenderEngineCreationArgs& args) {
+    uint32_t instanceVersion = 0;
+    if (vkEnumerateInstanceVersion(&instanceVersion) != VK_SUCCESS ||
+        instanceVersion < VK_API_VERSION_1_1) {
+        ALOGW("Vulkan 1.1 instance is not available");
+        return false;
+    }
+
+    const VkApplicationInfo appInfo = {
+            .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+            .pApplicationName = "RenderEngine",
+            .applicationVersion = 0,
+            .pEngineName = "Skia",
+            .engineVersion = 0,
+            .apiVersion = VK_API_VERSION_1_1,
+    };
+    const VkInstanceCreateInfo instanceInfo = {
+            .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+            .pApplicationInfo = &appInfo,
+    };
+    if (vkCreateInstance(&instanceInfo, nullptr, &instance) != VK_SUCCESS) {
+        ALOGW("Failed to create a Vulkan instance");
+        instance = VK_NULL_HANDLE;
+        return false;
+    }
+
+    uint32_t gpuCount = 1;
+    if (vkEnumeratePhysicalDevices(instance, &gpuCount, &physicalDevice) < 0 || gpuCount == 0) {
+        ALOGW("No Vulkan physical device");
+        return false;
+    }
+    vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+    if (physicalDeviceProperties.apiVersion < VK_API_VERSION_1_1) {
+        ALOGW("Vulkan device only supports %u.%u",
+              VK_VERSION_MAJOR(physicalDeviceProperties.apiVersion),
+              VK_VERSION_MINOR(physicalDeviceProperties.apiVersion));
+        return false;
+    }
+
+    uint32_t queueCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueProperties(queueCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, queueProperties.data());
+    queueIndex = queueCount;
+    for (uint32_t i = 0; i < queueCount; i++) {
+        if (queueProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            queueIndex = i;
+            break;
+        }
+    }
+    if (queueIndex == queueCount) {
+        ALOGW("No Vulkan graphics queue");
+        return false;
+    }
+
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount,
+                                         extensions.data());
+    const auto hasExtension = [&](const char* name) {
+        return std::any_of(extensions.begin(), extensions.end(),
+                           [&](const VkExtensionProperties& extension) {
+                               return strcmp(extension.extensionName, name) == 0;
+                           });
+    };
+    for (const char* extension : kRequiredDeviceExtensions) {
+        if (!hasExtension(extension)) {
+            ALOGW("Vulkan device is missing %s", extension);
+            return false;
+        }
+        deviceExtensions.push_back(extension);
+    }
+    const bool hasGlobalPriority = hasExtension(VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME);
+    if (hasGlobalPriority) {
+        deviceExtensions.push_back(VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME);
+    }
+
+    ycbcrFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES;
+    protectedMemoryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROTECTED_MEMORY_FEATURES;
+    protectedMemoryFeatures.pNext = &ycbcrFeatures;
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &protectedMemoryFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    // Skia doesn't draw with these, and they may cost performance when enabled.
+    features.features.robustBufferAccess = VK_FALSE;
+
+    const bool withProtectedQueue = args.enableProtectedContext &&
+            protectedMemoryFeatures.protectedMemory &&
+            (queueProperties[queueIndex].queueFlags & VK_QUEUE_PROTECTED_BIT);
+    if (!withProtectedQueue) {
+        protectedMemoryFeatures.protectedMemory = VK_FALSE;
+    }
+
+    VkResult result = createDevice(withProtectedQueue, hasGlobalPriority, args.contextPriority);
+    if (result == VK_ERROR_NOT_PERMITTED_EXT) {
+        ALOGI("Vulkan queue priority not permitted, using the default priority");
+        result = createDevice(withProtectedQueue, /*withPriority*/ false, args.contextPriority);
+    }
+    if (result != VK_SUCCESS) {
+        ALOGW("Failed to create a Vulkan device: %d", result);
+        device = VK_NULL_HANDLE;
+        return false;
+    }
+
+    vkGetDeviceQueue(device, queueIndex, 0, &queue);
+    if (withProtectedQueue) {
+        const VkDeviceQueueInfo2 queueInfo = {
+                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_INFO_2,
+                .flags = VK_DEVICE_QUEUE_CREATE_PROTECTED_BIT,
+                .queueFamilyIndex = queueIndex,
+                .queueIndex = 0,
+        };
+        vkGetDeviceQueue2(device, &queueInfo, &protectedQueue);
+    }
+
+    importSemaphoreFd = reinterpret_cast<PFN_vkImportSemaphoreFdKHR>(
+            vkGetDeviceProcAddr(device, "vkImportSemaphoreFdKHR"));
+    getSemaphoreFd = reinterpret_cast<PFN_vkGetSemaphoreFdKHR>(
+            vkGetDeviceProcAddr(device, "vkGetSemaphoreFdKHR"));
+    if (!importSemaphoreFd || !getSemaphoreFd) {
+        ALOGW("Vulkan device is missing external semaphore entry points");
+        return false;
+    }
+
+    grExtensions.init(getProc, instance, physicalDevice, 0, nullptr, deviceExtensions.size(),
+                      deviceExtensions.data());
+    return true;
+}
+
+VkResult SkiaVkRenderEngine::VulkanInterface::createDevice(
+        bool withProtectedQueue, bool withPriority, RenderEngine::ContextPriority contextPriority) {
+    const VkDeviceQueueGlobalPriorityCreateInfoEXT priorityInfo = {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_GLOBAL_PRIORITY_CREATE_INFO_EXT,
+            .globalPriority = toVkPriority(contextPriority),
+    };
+    const float queuePriority = 1.0f;
+    const VkDeviceQueueCreateInfo queueInfos[] = {
+            {
+                    .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                    .pNext = withPriority ? &priorityInfo : nullptr,
+                    .queueFamilyIndex = queueIndex,
+                    .queueCount = 1,
+                    .pQueuePriorities = &queuePriority,
+            },
+            {
+                    .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                    .pNext = withPriority ? &priorityInfo : nullptr,
+                    .flags = VK_DEVICE_QUEUE_CREATE_PROTECTED_BIT,
+                    .queueFamilyIndex = queueIndex,
+                    .queueCount = 1,
+                    .pQueuePriorities = &queuePriority,
+            },
+    };
+    const VkDeviceCreateInfo deviceInfo = {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+            .pNext = &features,
+            .queueCreateInfoCount = withProtectedQueue ? 2u : 1u,
+            .pQueueCreateInfos = queueInfos,
+            .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
+            .ppEnabledExtensionNames = deviceExtensions.data(),
+    };
+    const VkResult result = vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device);
+    if (result == VK_SUCCESS && withPriority) {
+        priority = contextPriority;
+    }
+    return result;
+}
+
+GrVkBackendContext SkiaVkRenderEngine::VulkanInterface::getBackendContext(
+        GrProtected isProtected) const {
+    GrVkBackendContext backendContext;
+    backendContext.fInstance = instance;
+    backendContext.fPhysicalDevice = physicalDevice;
+    backendContext.fDevice = device;
+    backendContext.fQueue = isProtected == GrProtected::kYes ? protectedQueue : queue;
+    backendContext.fGraphicsQueueIndex = queueIndex;
+    backendContext.fMaxAPIVersion = VK_API_VERSION_1_1;
+    backendContext.fVkExtensions = &grExtensions;
+    backendContext.fDeviceFeatures2 = &features;
+    backendContext.fGetProc = getProc;
+    backendContext.fProtectedContext = isProtected;
+    return backendContext;
+}
+
+VkSemaphore SkiaVkRenderEngine::VulkanInterface::createExportableSemaphore() const {
+    const VkExportSemaphoreCreateInfo exportInfo = {
+            .sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,
+            .handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
+    };
+    const VkSemaphoreCreateInfo semaphoreInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &exportInfo,
+    };
+    VkSemaphore semaphore;
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+        ALOGE("Failed to create an exportable semaphore");
+        return VK_NULL_HANDLE;
+    }
+    return semaphore;
+}
+
+VkSemaphore SkiaVkRenderEngine::VulkanInterface::importSemaphoreFromSyncFd(int fenceFd) const {
+    const VkSemaphoreCreateInfo semaphoreInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    VkSemaphore semaphore;
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+        ALOGE("Failed to create a semaphore to import a fence into");
+        return VK_NULL_HANDLE;
+    }
+
+    const VkImportSemaphoreFdInfoKHR importInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR,
+            .semaphore = semaphore,
+            .flags = VK_SEMAPHORE_IMPORT_TEMPORARY_BIT,
+            .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
+            .fd = fenceFd,
+    };
+    if (importSemaphoreFd(device, &importInfo) != VK_SUCCESS) {
+        ALOGE("Failed to import a fence into a semaphore");
+        vkDestroySemaphore(device, semaphore, nullptr);
+        return VK_NULL_HANDLE;
+    }
+    return semaphore;
+}
+
+base::unique_fd SkiaVkRenderEngine::VulkanInterface::exportSemaphoreSyncFd(
+        VkSemaphore semaphore) const {
+    const VkSemaphoreGetFdInfoKHR getFdInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
+            .semaphore = semaphore,
+            .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
+    };
+    int fenceFd = -1;
+    if (getSemaphoreFd(device, &getFdInfo, &fenceFd) != VK_SUCCESS) {
+        ALOGE("Failed to export a semaphore as a fence");
+        return base::unique_fd();
+    }
+    return base::unique_fd(fenceFd);
+}
+
+std::unique_ptr<SkiaVkRenderEngine> SkiaVkRenderEngine::create(
+        const RenderEngineCreationArgs& args) {
+    auto vulkanInterface = std::make_unique<VulkanInterface>();
+    if (!vulkanInterface->init(args)) {
+        return nullptr;
+    }
+
+    std::unique_ptr<SkiaVkRenderEngine> engine(
+            new SkiaVkRenderEngine(args, std::move(vulkanInterface)));
+    if (!engine->mGrContext) {
+        ALOGW("Failed to create a Skia Vulkan context");
+        return nullptr;
+    }
+
+    const VkPhysicalDeviceProperties& properties =
+            engine->mVulkanInterface->physicalDeviceProperties;
+    ALOGI("Vulkan informations:");
+    ALOGI("device    : %s", properties.deviceName);
+    ALOGI("api       : %u.%u.%u", VK_VERSION_MAJOR(properties.apiVersion),
+          VK_VERSION_MINOR(properties.apiVersion), VK_VERSION_PATCH(properties.apiVersion));
+    ALOGI("driver    : %#x", properties.driverVersion);
+    ALOGI("max texture size = %zu", engine->getMaxTextureSize());
+    ALOGI("max viewport dims = %zu", engine->getMaxViewportDims());
+
+    return engine;
+}
+
+SkiaVkRenderEngine::SkiaVkRenderEngine(const RenderEngineCreationArgs& args,
+                                       std::unique_ptr<VulkanInterface> vulkanInterface)
+      : SkiaRenderEngine(args.renderEngineType, static_cast<PixelFormat>(args.pixelFormat),
+                         args.useColorManagement, args.supportsBackgroundBlur),
+        mVulkanInterface(std::move(vulkanInterface)) {
+    const VkPhysicalDeviceProperties& properties = mVulkanInterface->physicalDeviceProperties;
+    const GrContextOptions options = createGrContextOptions(
+            base::StringPrintf("vulkan|%u|%u|%u|%s", properties.vendorID, properties.deviceID,
+                               properties.driverVersion, properties.deviceName));
+
+    mGrContext =
+            GrDirectContext::MakeVulkan(mVulkanInterface->getBackendContext(GrProtected::kNo),
+                                        options);
+    if (supportsProtectedContent()) {
+        mProtectedGrContext =
+                GrDirectContext::MakeVulkan(mVulkanInterface->getBackendContext(GrProtected::kYes),
+                                            options);
+    }
+}
+
+SkiaVkRenderEngine::~SkiaVkRenderEngine() {
+    finishRenderingAndAbandonContexts();
+}
+
+int SkiaVkRenderEngine::getContextPriority() {
+    // Report the priority the way the GL backends do, since clients compare it with the EGL
+    // priority levels.
+    if (!mVulkanInterface->priority) {
+        return EGL_CONTEXT_PRIORITY_MEDIUM_IMG;
+    }
+    switch (*mVulkanInterface->priority) {
+        case ContextPriority::REALTIME:
+            return EGL_CONTEXT_PRIORITY_REALTIME_NV;
+        case ContextPriority::MEDIUM:
+            return EGL_CONTEXT_PRIORITY_MEDIUM_IMG;
+        case ContextPriority::LOW:
+            return EGL_CONTEXT_PRIORITY_LOW_IMG;
+        case ContextPriority::HIGH:
+        default:
+            return EGL_CONTEXT_PRIORITY_HIGH_IMG;
+    }
+}
+
+bool SkiaVkRenderEngine::supportsProtectedContent() const {
+    return mVulkanInterface->protectedQueue != VK_NULL_HANDLE;
+}
+
+bool SkiaVkRenderEngine::useProtectedContextImpl(GrProtected isProtected) {
+    // Each GrDirectContext submits to its own queue, so there is nothing to make current.
+    return isProtected == GrProtected::kNo || mProtectedGrContext != nullptr;
+}
+
+void SkiaVkRenderEngine::waitFence(GrDirectContext* grContext, base::borrowed_fd fenceFd) {
+    if (fenceFd.get() < 0) {
+        return;
+    }
+
+    base::unique_fd fenceDup(dup(fenceFd.get()));
+    if (fenceDup.get() >= 0) {
+        const VkSemaphore semaphore =
+                mVulkanInterface->importSemaphoreFromSyncFd(fenceDup.get());
+        if (semaphore != VK_NULL_HANDLE) {
+            // The semaphore owns the fd now.
+            fenceDup.release();
+            GrBackendSemaphore beSemaphore;
+            beSemaphore.initVulkan(semaphore);
+            // Skia deletes the semaphore once the wait is done.
+            if (grContext->wait(1, &beSemaphore, /*deleteSemaphoresAfterWait*/ true)) {
+                return;
+            }
+        }
+    }
+
+    ATRACE_NAME("Waiting before draw");
+    sync_wait(fenceFd.get(), -1);
+}
+
+status_t SkiaVkRenderEngine::flushAndSubmit(GrDirectContext* grContext,
+                                            base::unique_fd* drawFence) {
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    if (drawFence != nullptr) {
+        semaphore = mVulkanInterface->createExportableSemaphore();
+    }
+
+    GrFlushInfo flushInfo;
+    GrBackendSemaphore beSemaphore;
+    DestroySemaphoreInfo* destroyInfo = nullptr;
+    if (semaphore != VK_NULL_HANDLE) {
+        beSemaphore.initVulkan(semaphore);
+        destroyInfo = new DestroySemaphoreInfo{mVulkanInterface->device, semaphore};
+        flushInfo.fNumSemaphores = 1;
+        flushInfo.fSignalSemaphores = &beSemaphore;
+        flushInfo.fFinishedProc = onSemaphoreFinished;
+        flushInfo.fFinishedContext = destroyInfo;
+    }
+    const bool semaphoreSubmitted =
+            grContext->flush(flushInfo) == GrSemaphoresSubmitted::kYes && destroyInfo != nullptr;
+
+    // Without a semaphore to export, the caller can only know the work is done once we wait
+    // for it.
+    const bool requireSync = !semaphoreSubmitted;
+    if (requireSync) {
+        ATRACE_BEGIN("Submit(sync=true)");
+    } else {
+        ATRACE_BEGIN("Submit(sync=false)");
+    }
+    const bool success = grContext->submit(requireSync);
+    ATRACE_END();
+
+    if (drawFence != nullptr) {
+        *drawFence = semaphoreSubmitted && success
+                ? mVulkanInterface->exportSemaphoreSyncFd(semaphore)
+                : base::unique_fd();
+    }
+    if (destroyInfo != nullptr) {
+        unrefSemaphore(destroyInfo);
+    }
+
+    if (!success) {
+        ALOGE("Failed to flush RenderEngine commands");
+        return INVALID_OPERATION;
+    }
+    return NO_ERROR;
+}
+
+void SkiaVkRenderEngine::appendBackendSpecificInfoToDump(std::string& result) {
+    const VkPhysicalDeviceProperties& properties = mVulkanInterface->physicalDeviceProperties;
+    StringAppendF(&result, "Vulkan: %s, api %u.%u.%u, driver %#x\n", properties.deviceName,
+                  VK_VERSION_MAJOR(properties.apiVersion), VK_VERSION_MINOR(properties.apiVersion),
+                  VK_VERSION_PATCH(properties.apiVersion), properties.driverVersion);
+    for (const char* extension : mVulkanInterface->deviceExtensions) {
+        StringAppendF(&result, "%s ", extension);
+    }
+    StringAppendF(&result, "\n");
+}
+
+} // namespace skia
+} // namespace renderengine
+} // namespace android
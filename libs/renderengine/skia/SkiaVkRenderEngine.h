@@ -0,0 +1,62 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SF_SKIAVKRENDERENGINE_H_
+#define SF_SKIAVKRENDERENGINE_H_
+
+#include <GrDirectContext.h>
+#include <android-base/unique_fd.h>
+#include <renderengine/RenderEngine.h>
+
+#include <memory>
+
+#include "SkiaRenderEngine.h"
+
+namespace android {
+namespace renderengine {
+namespace skia {
+
+// Skia backend drawing with Vulkan. Buffers are imported as VkImages, and fences are exchanged
+// with the rest of the system through external semaphores rather than EGL native fences.
+class SkiaVkRenderEngine : public skia::SkiaRenderEngine {
+public:
+    // Returns nullptr if the device can't provide what RenderEngine needs from Vulkan.
+    static std::unique_ptr<SkiaVkRenderEngine> create(const RenderEngineCreationArgs& args);
+    ~SkiaVkRenderEngine() override;
+
+    int getContextPriority() override;
+    bool supportsProtectedContent() const override;
+
+protected:
+    bool useProtectedContextImpl(GrProtected isProtected) override;
+    void waitFence(GrDirectContext* grContext, base::borrowed_fd fenceFd) override;
+    status_t flushAndSubmit(GrDirectContext* grContext, base::unique_fd* drawFence) override;
+    void appendBackendSpecificInfoToDump(std::string& result) override;
+
+private:
+    struct VulkanInterface;
+
+    SkiaVkRenderEngine(const RenderEngineCreationArgs& args,
+                       std::unique_ptr<VulkanInterface> vulkanInterface);
+
+    std::unique_ptr<VulkanInterface> mVulkanInterface;
+};
+
+} // namespace skia
+} // namespace renderengine
+} // namespace android
+
+#endif /* SF_SKIAVKRENDERENGINE_H_ */
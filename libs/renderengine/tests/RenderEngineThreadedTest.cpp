@@ -24,6 +24,7 @@ namespace android {
 
 using testing::_;
 using testing::Eq;
+using testing::Invoke;
 using testing::Mock;
 using testing::Return;
 
@@ -151,11 +152,14 @@ TEST_F(RenderEngineThreadedTest, PostRenderCleanup_skipped) {
 
 TEST_F(RenderEngineThreadedTest, PostRenderCleanup_notSkipped) {
     EXPECT_CALL(*mRenderEngine, canSkipPostRenderCleanup()).WillOnce(Return(false));
-    EXPECT_CALL(*mRenderEngine, cleanupPostRender()).WillOnce(Return());
+    std::promise<void> cleanedUp;
+    EXPECT_CALL(*mRenderEngine, cleanupPostRender()).WillOnce(Invoke([&] {
+        cleanedUp.set_value();
+    }));
     mThreadedRE->cleanupPostRender();
 
-    // call ANY synchronous function to ensure that cleanupPostRender has completed.
-    mThreadedRE->getContextPriority();
+    // cleanupPostRender may run after later synchronous calls, so wait for it explicitly.
+    cleanedUp.get_future().wait();
 }
 
 TEST_F(RenderEngineThreadedTest, supportsBackgroundBlur_returnsFalse) {
@@ -190,4 +194,40 @@ TEST_F(RenderEngineThreadedTest, drawLayers) {
     ASSERT_EQ(NO_ERROR, result);
 }
 
+TEST_F(RenderEngineThreadedTest, drawLayersAsync_copiesLayersAndRestoresContext) {
+    renderengine::DisplaySettings settings;
+    settings.maxLuminance = 500.f;
+    std::vector<renderengine::LayerSettings> layers(2);
+    layers[1].alpha = 0.5f;
+    std::shared_ptr<renderengine::ExternalTexture> buffer = std::make_shared<
+            renderengine::ExternalTexture>(new GraphicBuffer(), *mRenderEngine,
+                                           renderengine::ExternalTexture::Usage::READABLE |
+                                                   renderengine::ExternalTexture::Usage::WRITEABLE);
+
+    EXPECT_CALL(*mRenderEngine, isProtected()).WillRepeatedly(Return(false));
+    {
+        testing::InSequence seq;
+        EXPECT_CALL(*mRenderEngine, useProtectedContext(true));
+        EXPECT_CALL(*mRenderEngine, drawLayers)
+                .WillOnce([](const renderengine::DisplaySettings& display,
+                             const std::vector<const renderengine::LayerSettings*>& layers,
+                             const std::shared_ptr<renderengine::ExternalTexture>&, const bool,
+                             base::unique_fd&&, base::unique_fd*) -> status_t {
+                    EXPECT_EQ(500.f, display.maxLuminance);
+                    EXPECT_EQ(2u, layers.size());
+                    EXPECT_EQ(0.5f, layers[1]->alpha);
+                    return NO_ERROR;
+                });
+        EXPECT_CALL(*mRenderEngine, useProtectedContext(false));
+    }
+
+    std::promise<status_t> resultPromise;
+    std::future<status_t> resultFuture = resultPromise.get_future();
+    mThreadedRE->drawLayersAsync(settings, std::move(layers), buffer, true, base::unique_fd(),
+                                 [&resultPromise](status_t status, base::unique_fd&&) {
+                                     resultPromise.set_value(status);
+                                 });
+    ASSERT_EQ(NO_ERROR, resultFuture.get());
+}
+
 } // namespace android
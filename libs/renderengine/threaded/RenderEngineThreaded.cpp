@@ -18,7 +18,9 @@
 
 #include "RenderEngineThreaded.h"
 
+#include <inttypes.h>
 #include <sched.h>
+#include <algorithm>
 #include <chrono>
 #include <future>
 
@@ -103,10 +105,12 @@ void RenderEngineThreaded::threadMain(CreateInstanceFactory factory) NO_THREAD_S
     while (mRunning) {
         const auto getNextTask = [this]() -> std::optional<Work> {
             std::scoped_lock lock(mThreadMutex);
-            if (!mFunctionCalls.empty()) {
-                Work task = mFunctionCalls.front();
-                mFunctionCalls.pop();
-                return std::make_optional<Work>(task);
+            for (auto* queue : {&mFunctionCalls, &mBackgroundFunctionCalls}) {
+                if (!queue->empty()) {
+                    Work task = std::move(queue->front());
+                    queue->pop();
+                    return std::make_optional<Work>(std::move(task));
+                }
             }
             return std::nullopt;
         };
@@ -119,7 +123,7 @@ void RenderEngineThreaded::threadMain(CreateInstanceFactory factory) NO_THREAD_S
 
         std::unique_lock<std::mutex> lock(mThreadMutex);
         mCondition.wait(lock, [this]() REQUIRES(mThreadMutex) {
-            return !mRunning || !mFunctionCalls.empty();
+            return !mRunning || !mFunctionCalls.empty() || !mBackgroundFunctionCalls.empty();
         });
     }
 
@@ -164,10 +168,13 @@ void RenderEngineThreaded::dump(std::string& result) {
     std::future<std::string> resultFuture = resultPromise.get_future();
     {
         std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([&resultPromise, &result](renderengine::RenderEngine& instance) {
+        mFunctionCalls.push([this, &resultPromise, &result](renderengine::RenderEngine& instance) {
             ATRACE_NAME("REThreaded::dump");
             std::string localResult = result;
             instance.dump(localResult);
+            localResult.append("Buffer import latencies (us):\n");
+            mImportWaitLatencies.dump("wait", localResult);
+            mImportLatencies.dump("import", localResult);
             resultPromise.set_value(std::move(localResult));
         });
     }
@@ -195,21 +202,50 @@ void RenderEngineThreaded::mapExternalTextureBuffer(const sp<GraphicBuffer>& buf
     // for the futures.
     {
         std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([=](renderengine::RenderEngine& instance) {
+        const nsecs_t requestTime = systemTime();
+        mBackgroundFunctionCalls.push([=](renderengine::RenderEngine& instance) {
             ATRACE_NAME("REThreaded::mapExternalTextureBuffer");
+            const nsecs_t startTime = systemTime();
             instance.mapExternalTextureBuffer(buffer, isRenderable);
+            mImportWaitLatencies.record(startTime - requestTime);
+            mImportLatencies.record(systemTime() - startTime);
         });
     }
     mCondition.notify_one();
 }
 
+void RenderEngineThreaded::LatencyHistogram::record(nsecs_t latency) {
+    const uint64_t micros = static_cast<uint64_t>(std::max<nsecs_t>(ns2us(latency), 0));
+    size_t bucket = micros < 64 ? 0 : 64 - static_cast<size_t>(__builtin_clzll(micros >> 6));
+    bucket = std::min(bucket, kNumBuckets - 1);
+    ++buckets[bucket];
+    ++count;
+    total += latency;
+    max = std::max(max, latency);
+}
+
+void RenderEngineThreaded::LatencyHistogram::dump(const char* name, std::string& result) const {
+    const double average = count == 0 ? 0.0 : static_cast<double>(total) / count / 1e3;
+    base::StringAppendF(&result, "  %-6s count=%" PRIu64 " avg=%.1f max=%.1f [", name, count,
+                        average, max / 1e3);
+    for (size_t bucket = 0; bucket < kNumBuckets; ++bucket) {
+        const bool last = bucket == kNumBuckets - 1;
+        if (last) {
+            base::StringAppendF(&result, ">=%u:", 64u << (bucket - 1));
+        } else {
+            base::StringAppendF(&result, "<%u:", 64u << bucket);
+        }
+        base::StringAppendF(&result, "%" PRIu64 "%s", buckets[bucket], last ? "]\n" : " ");
+    }
+}
+
 void RenderEngineThreaded::unmapExternalTextureBuffer(const sp<GraphicBuffer>& buffer) {
     ATRACE_CALL();
     // This function is designed so it can run asynchronously, so we do not need to wait
     // for the futures.
     {
         std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([=](renderengine::RenderEngine& instance) {
+        mBackgroundFunctionCalls.push([=](renderengine::RenderEngine& instance) {
             ATRACE_NAME("REThreaded::unmapExternalTextureBuffer");
             instance.unmapExternalTextureBuffer(buffer);
         });
@@ -271,7 +307,7 @@ void RenderEngineThreaded::cleanupPostRender() {
     // for the futures.
     {
         std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([=](renderengine::RenderEngine& instance) {
+        mBackgroundFunctionCalls.push([=](renderengine::RenderEngine& instance) {
             ATRACE_NAME("REThreaded::unmapExternalTextureBuffer");
             instance.cleanupPostRender();
         });
@@ -322,6 +358,42 @@ status_t RenderEngineThreaded::drawLayers(const DisplaySettings& display,
     return resultFuture.get();
 }
 
+void RenderEngineThreaded::drawLayersAsync(const DisplaySettings& display,
+                                           std::vector<LayerSettings> layers,
+                                           const std::shared_ptr<ExternalTexture>& buffer,
+                                           bool useProtectedContext, base::unique_fd&& bufferFence,
+                                           DrawLayersCallback&& callback) {
+    ATRACE_CALL();
+    // Nobody waits for this draw, so it goes on the background queue and is only run once the
+    // frames that are already queued have been drawn.
+    {
+        std::lock_guard lock(mThreadMutex);
+        mBackgroundFunctionCalls.push(
+                [display, layers = std::move(layers), buffer, useProtectedContext,
+                 bufferFence = std::make_shared<base::unique_fd>(std::move(bufferFence)),
+                 callback = std::move(callback)](renderengine::RenderEngine& instance) {
+                    ATRACE_NAME("REThreaded::drawLayersAsync");
+                    std::vector<const LayerSettings*> layerPointers;
+                    layerPointers.reserve(layers.size());
+                    for (const auto& layer : layers) {
+                        layerPointers.push_back(&layer);
+                    }
+
+                    // Leave the context as the last synchronous call asked for it.
+                    const bool wasProtected = instance.isProtected();
+                    instance.useProtectedContext(useProtectedContext);
+                    base::unique_fd drawFence;
+                    const status_t status =
+                            instance.drawLayers(display, layerPointers, buffer,
+                                                false /* useFramebufferCache */,
+                                                std::move(*bufferFence), &drawFence);
+                    instance.useProtectedContext(wasProtected);
+                    callback(status, std::move(drawFence));
+                });
+    }
+    mCondition.notify_one();
+}
+
 void RenderEngineThreaded::cleanFramebufferCache() {
     ATRACE_CALL();
     // This function is designed so it can run asynchronously, so we do not need to wait
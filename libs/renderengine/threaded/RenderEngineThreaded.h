@@ -17,6 +17,8 @@
 #pragma once
 
 #include <android-base/thread_annotations.h>
+#include <utils/Timers.h>
+#include <array>
 #include <condition_variable>
 #include <mutex>
 #include <queue>
@@ -33,7 +35,8 @@ using CreateInstanceFactory = std::function<std::unique_ptr<renderengine::Render
 /**
  * This class extends a basic RenderEngine class. It contains a thread. Each time a function of
  * this class is called, we create a lambda function that is put on a queue. The main thread then
- * executes the functions in order.
+ * executes the functions in order. Asynchronous buffer caching and cleanup go on a separate queue,
+ * which is only drained while no other function is waiting, so that they never delay a frame.
  */
 class RenderEngineThreaded : public RenderEngine {
 public:
@@ -62,6 +65,9 @@ public:
                         const std::shared_ptr<ExternalTexture>& buffer,
                         const bool useFramebufferCache, base::unique_fd&& bufferFence,
                         base::unique_fd* drawFence) override;
+    void drawLayersAsync(const DisplaySettings& display, std::vector<LayerSettings> layers,
+                         const std::shared_ptr<ExternalTexture>& buffer, bool useProtectedContext,
+                         base::unique_fd&& bufferFence, DrawLayersCallback&& callback) override;
 
     void cleanFramebufferCache() override;
     int getContextPriority() override;
@@ -90,6 +96,9 @@ private:
 
     using Work = std::function<void(renderengine::RenderEngine&)>;
     mutable std::queue<Work> mFunctionCalls GUARDED_BY(mThreadMutex);
+    // Functions no caller waits on and that may run after later calls on mFunctionCalls. They are
+    // executed in order with respect to each other.
+    mutable std::queue<Work> mBackgroundFunctionCalls GUARDED_BY(mThreadMutex);
     mutable std::condition_variable mCondition;
 
     // Used to allow select thread safe methods to be accessed without requiring the
@@ -103,6 +112,24 @@ private:
      */
     std::unique_ptr<renderengine::RenderEngine> mRenderEngine;
     std::atomic<bool> mIsProtected = false;
+
+    // Distribution of buffer import latencies, in power-of-two buckets starting below 64us.
+    struct LatencyHistogram {
+        static constexpr size_t kNumBuckets = 10;
+
+        std::array<uint64_t, kNumBuckets> buckets{};
+        uint64_t count = 0;
+        nsecs_t total = 0;
+        nsecs_t max = 0;
+
+        void record(nsecs_t latency);
+        void dump(const char* name, std::string& result) const;
+    };
+
+    // How long mapExternalTextureBuffer requests waited for the thread, and how long mapping the
+    // buffer then took. Only accessed on the RenderEngine thread.
+    LatencyHistogram mImportWaitLatencies;
+    LatencyHistogram mImportLatencies;
 };
 } // namespace threaded
 } // namespace renderengine
@@ -485,6 +485,16 @@ void Sensor::capHighestDirectReportRateLevel(int32_t cappedRateLevel) {
     }
 }
 
+void Sensor::setDirectReportSupport(int32_t highestRateLevel, uint32_t directChannelFlags) {
+    // only on continuous sensors direct report mode is defined
+    if ((mFlags & REPORTING_MODE_MASK) != SENSOR_FLAG_CONTINUOUS_MODE) {
+        return;
+    }
+    mFlags &= ~(SENSOR_FLAG_MASK_DIRECT_REPORT | SENSOR_FLAG_MASK_DIRECT_CHANNEL);
+    mFlags |= (highestRateLevel << SENSOR_FLAG_SHIFT_DIRECT_REPORT) & SENSOR_FLAG_MASK_DIRECT_REPORT;
+    mFlags |= directChannelFlags & SENSOR_FLAG_MASK_DIRECT_CHANNEL;
+}
+
 int32_t Sensor::getId() const {
     return int32_t(mUuid.i64[0]);
 }
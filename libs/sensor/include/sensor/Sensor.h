@@ -106,6 +106,8 @@ public:
 
     void capMinDelayMicros(int32_t cappedMinDelay);
     void capHighestDirectReportRateLevel(int32_t cappedRateLevel);
+    // For sensors whose direct reports are produced by sensorservice rather than the HAL.
+    void setDirectReportSupport(int32_t highestRateLevel, uint32_t directChannelFlags);
 
     // LightFlattenable protocol
     inline bool isFixedSize() const { return false; }
@@ -27,6 +27,8 @@
 #include <sync/sync.h>
 #pragma clang diagnostic pop
 
+#include <linux/sync_file.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <utils/Log.h>
@@ -144,11 +146,47 @@ int Fence::dup() const {
     return ::dup(mFenceFd);
 }
 
+// Most fences have a few sync points, e.g. a merged fence has one per merged fence.
+static constexpr size_t MAX_INLINE_SYNC_POINTS = 8;
+
+// sync_file_info() issues SYNC_IOC_FILE_INFO twice, first to size the buffer that it allocates.
+// Fences are polled while mostly pending, so query into a buffer on the stack with one ioctl
+// instead. Returns false if the kernel lacks SYNC_IOC_FILE_INFO or the fence has more sync
+// points, in which case the caller should fall back to sync_file_info().
+static bool getSignalTimeInline(int fd, nsecs_t* outSignalTime) {
+    struct sync_fence_info pinfo[MAX_INLINE_SYNC_POINTS] = {};
+    struct sync_file_info finfo = {};
+    finfo.num_fences = MAX_INLINE_SYNC_POINTS;
+    finfo.sync_fence_info = reinterpret_cast<uintptr_t>(pinfo);
+
+    if (ioctl(fd, SYNC_IOC_FILE_INFO, &finfo) < 0) {
+        return false;
+    }
+    if (finfo.status != 1) {
+        *outSignalTime = Fence::SIGNAL_TIME_PENDING;
+        return true;
+    }
+
+    uint64_t timestamp = 0;
+    for (size_t i = 0; i < finfo.num_fences; i++) {
+        if (pinfo[i].timestamp_ns > timestamp) {
+            timestamp = pinfo[i].timestamp_ns;
+        }
+    }
+    *outSignalTime = nsecs_t(timestamp);
+    return true;
+}
+
 nsecs_t Fence::getSignalTime() const {
     if (mFenceFd == -1) {
         return SIGNAL_TIME_INVALID;
     }
 
+    nsecs_t signalTime;
+    if (getSignalTimeInline(mFenceFd, &signalTime)) {
+        return signalTime;
+    }
+
     struct sync_file_info* finfo = sync_file_info(mFenceFd);
     if (finfo == nullptr) {
         ALOGE("sync_file_info returned NULL for fd %d", mFenceFd.get());
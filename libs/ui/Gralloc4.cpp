@@ -20,6 +20,7 @@
 #include <hwbinder/IPCThreadState.h>
 #include <ui/Gralloc4.h>
 
+#include <algorithm>
 #include <inttypes.h>
 #include <log/log.h>
 #pragma clang diagnostic push
@@ -82,6 +83,30 @@ static inline void sBufferDescriptorInfo(std::string name, uint32_t width, uint3
     outDescriptorInfo->reservedSize = 0;
 }
 
+// Whether the metadata is fixed at allocation, so that it can be cached until the buffer is freed.
+bool isImmutableMetadataType(const MetadataType& metadataType) {
+    if (!gralloc4::isStandardMetadataType(metadataType)) {
+        return false;
+    }
+    switch (gralloc4::getStandardMetadataTypeValue(metadataType)) {
+        case StandardMetadataType::BUFFER_ID:
+        case StandardMetadataType::NAME:
+        case StandardMetadataType::WIDTH:
+        case StandardMetadataType::HEIGHT:
+        case StandardMetadataType::LAYER_COUNT:
+        case StandardMetadataType::PIXEL_FORMAT_REQUESTED:
+        case StandardMetadataType::PIXEL_FORMAT_FOURCC:
+        case StandardMetadataType::PIXEL_FORMAT_MODIFIER:
+        case StandardMetadataType::USAGE:
+        case StandardMetadataType::ALLOCATION_SIZE:
+        case StandardMetadataType::PROTECTED_CONTENT:
+        case StandardMetadataType::PLANE_LAYOUTS:
+            return true;
+        default:
+            return false;
+    }
+}
+
 } // anonymous namespace
 
 void Gralloc4Mapper::preload() {
@@ -156,6 +181,11 @@ status_t Gralloc4Mapper::importBuffer(const hardware::hidl_handle& rawHandle,
 
 void Gralloc4Mapper::freeBuffer(buffer_handle_t bufferHandle) const {
     auto buffer = const_cast<native_handle_t*>(bufferHandle);
+    {
+        // Drop the cached metadata before the handle can be reused by another import.
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        mMetadataCache.erase(bufferHandle);
+    }
     auto ret = mMapper->freeBuffer(buffer);
 
     auto error = (ret.isOk()) ? static_cast<Error>(ret) : kTransactionError;
@@ -404,6 +434,18 @@ int Gralloc4Mapper::unlock(buffer_handle_t bufferHandle) const {
     return releaseFence;
 }
 
+status_t Gralloc4Mapper::rereadLockedBuffer(buffer_handle_t bufferHandle) const {
+    auto buffer = const_cast<native_handle_t*>(bufferHandle);
+    auto ret = mMapper->rereadLockedBuffer(buffer);
+
+    auto error = (ret.isOk()) ? static_cast<Error>(ret) : kTransactionError;
+    if (error != Error::NONE) {
+        ALOGE("rereadLockedBuffer(%p) failed with %d", buffer, error);
+    }
+
+    return static_cast<status_t>(error);
+}
+
 status_t Gralloc4Mapper::isSupported(uint32_t width, uint32_t height, PixelFormat format,
                                      uint32_t layerCount, uint64_t usage,
                                      bool* outSupported) const {
@@ -434,19 +476,28 @@ status_t Gralloc4Mapper::isSupported(uint32_t width, uint32_t height, PixelForma
     return static_cast<status_t>(error);
 }
 
-template <class T>
-status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& metadataType,
-                             DecodeFunction<T> decodeFunction, T* outMetadata) const {
-    if (!outMetadata) {
-        return BAD_VALUE;
+status_t Gralloc4Mapper::getEncoded(buffer_handle_t bufferHandle,
+                                    const MetadataType& metadataType,
+                                    hidl_vec<uint8_t>* outVec) const {
+    const bool immutable = isImmutableMetadataType(metadataType);
+    if (immutable) {
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        const auto it = mMetadataCache.find(bufferHandle);
+        if (it != mMetadataCache.end()) {
+            for (const auto& [type, vec] : it->second) {
+                if (type == metadataType) {
+                    *outVec = vec;
+                    return NO_ERROR;
+                }
+            }
+        }
     }
 
-    hidl_vec<uint8_t> vec;
     Error error;
     auto ret = mMapper->get(const_cast<native_handle_t*>(bufferHandle), metadataType,
                             [&](const auto& tmpError, const hidl_vec<uint8_t>& tmpVec) {
                                 error = tmpError;
-                                vec = tmpVec;
+                                *outVec = tmpVec;
                             });
 
     if (!ret.isOk()) {
@@ -459,6 +510,51 @@ status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& m
         return static_cast<status_t>(error);
     }
 
+    if (immutable) {
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        auto& cached = mMetadataCache[bufferHandle];
+        const bool present = std::any_of(cached.begin(), cached.end(), [&](const auto& entry) {
+            return entry.first == metadataType;
+        });
+        if (!present) {
+            cached.emplace_back(metadataType, *outVec);
+        }
+    }
+
+    return NO_ERROR;
+}
+
+status_t Gralloc4Mapper::getMetadata(buffer_handle_t bufferHandle,
+                                     const std::vector<MetadataType>& metadataTypes,
+                                     std::vector<hidl_vec<uint8_t>>* outMetadata) const {
+    if (!outMetadata) {
+        return BAD_VALUE;
+    }
+
+    outMetadata->resize(metadataTypes.size());
+    for (size_t i = 0; i < metadataTypes.size(); i++) {
+        status_t error = getEncoded(bufferHandle, metadataTypes[i], &(*outMetadata)[i]);
+        if (error != NO_ERROR) {
+            outMetadata->clear();
+            return error;
+        }
+    }
+    return NO_ERROR;
+}
+
+template <class T>
+status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& metadataType,
+                             DecodeFunction<T> decodeFunction, T* outMetadata) const {
+    if (!outMetadata) {
+        return BAD_VALUE;
+    }
+
+    hidl_vec<uint8_t> vec;
+    status_t error = getEncoded(bufferHandle, metadataType, &vec);
+    if (error != NO_ERROR) {
+        return error;
+    }
+
     return decodeFunction(vec, outMetadata);
 }
 
@@ -20,7 +20,12 @@
 
 #include <ui/GraphicBufferMapper.h>
 
+#include <android-base/stringprintf.h>
 #include <grallocusage/GrallocUsageConversion.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#include <algorithm>
 
 // We would eliminate the non-conforming zero-length array, but we can't since
 // this is effectively included from the Linux kernel
@@ -43,6 +48,8 @@
 namespace android {
 // ---------------------------------------------------------------------------
 
+using base::StringAppendF;
+
 ANDROID_SINGLETON_STATIC_INSTANCE( GraphicBufferMapper )
 
 void GraphicBufferMapper::preloadHal() {
@@ -105,7 +112,90 @@ status_t GraphicBufferMapper::importBuffer(buffer_handle_t rawHandle,
     }
 
     *outHandle = bufferHandle;
+    mHalImportCount++;
+
+    return NO_ERROR;
+}
+
+// The fds of a buffer refer to the same dma-buf files in every process, whereas the fd numbers
+// differ between imports.
+static bool getFiles(buffer_handle_t handle, std::vector<std::pair<dev_t, ino_t>>* outFiles) {
+    outFiles->reserve(static_cast<size_t>(handle->numFds));
+    for (int i = 0; i < handle->numFds; i++) {
+        struct stat st;
+        if (fstat(handle->data[i], &st) != 0) {
+            return false;
+        }
+        outFiles->emplace_back(st.st_dev, st.st_ino);
+    }
+    return true;
+}
+
+bool GraphicBufferMapper::matches(const SharedImport& import, buffer_handle_t rawHandle,
+                                  const std::vector<std::pair<dev_t, ino_t>>& files,
+                                  uint32_t width, uint32_t height, uint32_t layerCount,
+                                  PixelFormat format, uint64_t usage, uint32_t stride) {
+    const int* ints = rawHandle->data + rawHandle->numFds;
+    return import.files == files &&
+            std::equal(import.ints.begin(), import.ints.end(), ints, ints + rawHandle->numInts) &&
+            import.width == width && import.height == height &&
+            import.layerCount == layerCount && import.format == format &&
+            import.usage == usage && import.stride == stride;
+}
+
+status_t GraphicBufferMapper::importBuffer(buffer_handle_t rawHandle, uint64_t bufferId,
+        uint32_t generationNumber, uint32_t width, uint32_t height, uint32_t layerCount,
+        PixelFormat format, uint64_t usage, uint32_t stride, buffer_handle_t* outHandle)
+{
+    constexpr uint64_t kCpuUsage = GRALLOC_USAGE_SW_READ_MASK | GRALLOC_USAGE_SW_WRITE_MASK;
+
+    std::vector<std::pair<dev_t, ino_t>> files;
+    if ((usage & kCpuUsage) != 0 || !getFiles(rawHandle, &files)) {
+        return importBuffer(rawHandle, width, height, layerCount, format, usage, stride,
+                            outHandle);
+    }
+
+    const auto key = std::make_pair(bufferId, generationNumber);
+    bool share = true;
+    {
+        std::lock_guard<std::mutex> lock(mImportMutex);
+        const auto it = mSharedImports.find(key);
+        if (it != mSharedImports.end()) {
+            if (matches(it->second, rawHandle, files, width, height, layerCount, format, usage,
+                        stride)) {
+                it->second.refCount++;
+                mSharedImportCount++;
+                *outHandle = it->second.handle;
+                return NO_ERROR;
+            }
+            // The ID was reused for another buffer, which must not share the handle.
+            ALOGW("importBuffer(%p): buffer %" PRIu64 " does not match its shared import",
+                  rawHandle, bufferId);
+            share = false;
+        }
+    }
+
+    // Import without the lock held, so that imports of other buffers are not serialized.
+    buffer_handle_t bufferHandle;
+    status_t error = importBuffer(rawHandle, width, height, layerCount, format, usage, stride,
+                                  &bufferHandle);
+    if (error != NO_ERROR) {
+        return error;
+    }
 
+    std::lock_guard<std::mutex> lock(mImportMutex);
+    // If another thread imported the buffer meanwhile, this handle is simply not shared.
+    if (share && mSharedImports.count(key) == 0) {
+        const int* ints = rawHandle->data + rawHandle->numFds;
+        mSharedImports.emplace(key,
+                               SharedImport{bufferHandle, std::move(files),
+                                            std::vector<int>(ints, ints + rawHandle->numInts),
+                                            width, height, layerCount, format, usage, stride,
+                                            1});
+        mSharedHandles.emplace(bufferHandle, key);
+    }
+
+    *outHandle = bufferHandle;
     return NO_ERROR;
 }
 
@@ -119,11 +209,48 @@ status_t GraphicBufferMapper::freeBuffer(buffer_handle_t handle)
 {
     ATRACE_CALL();
 
+    {
+        std::lock_guard<std::mutex> lock(mImportMutex);
+        const auto it = mSharedHandles.find(handle);
+        if (it != mSharedHandles.end()) {
+            const auto importIt = mSharedImports.find(it->second);
+            if (--importIt->second.refCount > 0) {
+                return NO_ERROR;
+            }
+            mSharedImports.erase(importIt);
+            mSharedHandles.erase(it);
+        }
+    }
+
     mMapper->freeBuffer(handle);
 
     return NO_ERROR;
 }
 
+void GraphicBufferMapper::dumpImportStats(std::string& result) const {
+    std::lock_guard<std::mutex> lock(mImportMutex);
+    const uint64_t halImportCount = mHalImportCount;
+    const uint64_t sharedImportCount = mSharedImportCount;
+    const nsecs_t now = systemTime();
+
+    StringAppendF(&result,
+                  "GraphicBufferMapper imports: %" PRIu64 " from HAL, %" PRIu64
+                  " shared, %zu shared handles\n",
+                  halImportCount, sharedImportCount, mSharedImports.size());
+    if (mLastDumpTime != 0 && now > mLastDumpTime) {
+        const double seconds = static_cast<double>(now - mLastDumpTime) / 1e9;
+        StringAppendF(&result,
+                      "  per second since last dump: %.2f from HAL, %.2f shared\n",
+                      static_cast<double>(halImportCount - mLastDumpHalImportCount) / seconds,
+                      static_cast<double>(sharedImportCount - mLastDumpSharedImportCount) /
+                              seconds);
+    }
+
+    mLastDumpHalImportCount = halImportCount;
+    mLastDumpSharedImportCount = sharedImportCount;
+    mLastDumpTime = now;
+}
+
 status_t GraphicBufferMapper::lock(buffer_handle_t handle, uint32_t usage, const Rect& bounds,
                                    void** vaddr, int32_t* outBytesPerPixel,
                                    int32_t* outBytesPerStride) {
@@ -183,6 +310,12 @@ status_t GraphicBufferMapper::unlockAsync(buffer_handle_t handle, int *fenceFd)
     return NO_ERROR;
 }
 
+status_t GraphicBufferMapper::rereadLockedBuffer(buffer_handle_t handle) {
+    ATRACE_CALL();
+
+    return mMapper->rereadLockedBuffer(handle);
+}
+
 status_t GraphicBufferMapper::isSupported(uint32_t width, uint32_t height,
                                           android::PixelFormat format, uint32_t layerCount,
                                           uint64_t usage, bool* outSupported) {
@@ -19,6 +19,8 @@
 #include <inttypes.h>
 #include <limits.h>
 
+#include <algorithm>
+
 #include <android-base/stringprintf.h>
 
 #include <utils/Log.h>
@@ -304,6 +306,99 @@ bool Region::hasSameRects(const Region& other) const {
 
 // ----------------------------------------------------------------------------
 
+/**
+ * Computes lhs op rhs without sweeping when both operands are valid rects and the result is known
+ * to be a single rect, which covers most of the operations done on visible regions. Returns false
+ * when the result has to be computed by region_operator.
+ *
+ * An empty result is returned as Rect(0, 0), the bounds the rasterizer gives an empty region.
+ */
+static bool rectOperation(uint32_t op, const Rect& lhs, const Rect& rhs, Rect* result) {
+    if (!lhs.isValid() || !rhs.isValid()) {
+        return false;
+    }
+
+    const bool lhsEmpty = lhs.isEmpty();
+    const bool rhsEmpty = rhs.isEmpty();
+    switch (op) {
+        case op_and:
+            if (lhsEmpty || rhsEmpty || !lhs.intersect(rhs, result)) {
+                *result = Rect(0, 0);
+            }
+            return true;
+        case op_or:
+        case op_xor:
+            if (lhsEmpty || rhsEmpty) {
+                *result = lhsEmpty ? (rhsEmpty ? Rect(0, 0) : rhs) : lhs;
+                return true;
+            }
+            if (op == op_xor) {
+                return false;
+            }
+            if (Rect overlap; lhs.intersect(rhs, &overlap)) {
+                if (overlap == rhs) {
+                    *result = lhs;
+                    return true;
+                }
+                if (overlap == lhs) {
+                    *result = rhs;
+                    return true;
+                }
+            }
+            // Rects sharing a full edge, overlapping or touching, merge into one.
+            if (lhs.left == rhs.left && lhs.right == rhs.right && lhs.top <= rhs.bottom &&
+                rhs.top <= lhs.bottom) {
+                *result = Rect(lhs.left, std::min(lhs.top, rhs.top), lhs.right,
+                               std::max(lhs.bottom, rhs.bottom));
+                return true;
+            }
+            if (lhs.top == rhs.top && lhs.bottom == rhs.bottom && lhs.left <= rhs.right &&
+                rhs.left <= lhs.right) {
+                *result = Rect(std::min(lhs.left, rhs.left), lhs.top,
+                               std::max(lhs.right, rhs.right), lhs.bottom);
+                return true;
+            }
+            return false;
+        case op_nand: {
+            Rect overlap;
+            if (lhsEmpty) {
+                *result = Rect(0, 0);
+                return true;
+            }
+            if (rhsEmpty || !lhs.intersect(rhs, &overlap)) {
+                *result = lhs;
+                return true;
+            }
+            if (overlap == lhs) {
+                *result = Rect(0, 0);
+                return true;
+            }
+            // rhs spanning lhs in one direction leaves a single rect when it covers one side.
+            if (overlap.left == lhs.left && overlap.right == lhs.right) {
+                if (overlap.top == lhs.top) {
+                    *result = Rect(lhs.left, overlap.bottom, lhs.right, lhs.bottom);
+                    return true;
+                }
+                if (overlap.bottom == lhs.bottom) {
+                    *result = Rect(lhs.left, lhs.top, lhs.right, overlap.top);
+                    return true;
+                }
+            } else if (overlap.top == lhs.top && overlap.bottom == lhs.bottom) {
+                if (overlap.left == lhs.left) {
+                    *result = Rect(overlap.right, lhs.top, lhs.right, lhs.bottom);
+                    return true;
+                }
+                if (overlap.right == lhs.right) {
+                    *result = Rect(lhs.left, lhs.top, overlap.left, lhs.bottom);
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+    return false;
+}
+
 void Region::addRectUnchecked(int l, int t, int r, int b)
 {
     Rect rect(l,t,r,b);
@@ -329,6 +424,11 @@ Region& Region::subtractSelf(const Rect& r) {
     return operationSelf(r, op_nand);
 }
 Region& Region::operationSelf(const Rect& r, uint32_t op) {
+    Rect result;
+    if (isRect() && rectOperation(op, getBounds(), r, &result)) {
+        set(result);
+        return *this;
+    }
     Region lhs(*this);
     boolean_operation(op, *this, lhs, r);
     return *this;
@@ -353,6 +453,11 @@ Region& Region::subtractSelf(const Region& rhs) {
     return operationSelf(rhs, op_nand);
 }
 Region& Region::operationSelf(const Region& rhs, uint32_t op) {
+    Rect result;
+    if (isRect() && rhs.isRect() && rectOperation(op, getBounds(), rhs.getBounds(), &result)) {
+        set(result);
+        return *this;
+    }
     Region lhs(*this);
     boolean_operation(op, *this, lhs, rhs);
     return *this;
@@ -653,6 +758,14 @@ void Region::boolean_operation(uint32_t op, Region& dst,
     validate(dst, "boolean_operation (before): dst");
 #endif
 
+    if (lhs.isRect() && rhs.isRect()) {
+        Rect result;
+        if (rectOperation(op, lhs.getBounds(), rhs.getBounds().offsetBy(dx, dy), &result)) {
+            dst.set(result);
+            return;
+        }
+    }
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -764,6 +877,14 @@ void Region::boolean_operation(uint32_t op, Region& dst,
         return;
     }
 
+    if (lhs.isRect()) {
+        Rect result;
+        if (rectOperation(op, lhs.getBounds(), Rect(rhs).offsetBy(dx, dy), &result)) {
+            dst.set(result);
+            return;
+        }
+    }
+
 #if VALIDATE_WITH_CORECG || defined(VALIDATE_REGIONS)
     boolean_operation(op, dst, lhs, Region(rhs), dx, dy);
 #else
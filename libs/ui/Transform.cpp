@@ -67,6 +67,17 @@ Transform Transform::operator*(const Transform& rhs) const {
     if (rhs.mType == IDENTITY)
         return r;
 
+    if ((mType | rhs.mType) <= TRANSLATE) {
+        // Neither has an unknown type, a rotation or a scale: only the translations add up, as
+        // they would in the product below.
+        const float x = rhs.mMatrix[2][0] + mMatrix[2][0];
+        const float y = rhs.mMatrix[2][1] + mMatrix[2][1];
+        r.mMatrix[2][0] = x;
+        r.mMatrix[2][1] = y;
+        r.mType = (isZero(x) && isZero(y)) ? IDENTITY : TRANSLATE;
+        return r;
+    }
+
     // TODO: we could use mType to optimize the matrix multiply
     const mat33& A(mMatrix);
     const mat33& B(rhs.mMatrix);
@@ -248,50 +259,68 @@ Rect Transform::makeBounds(int w, int h) const {
 }
 
 Rect Transform::transform(const Rect& bounds, bool roundOutwards) const {
-    Rect r;
-    vec2 lt( bounds.left,  bounds.top    );
-    vec2 rt( bounds.right, bounds.top    );
-    vec2 lb( bounds.left,  bounds.bottom );
-    vec2 rb( bounds.right, bounds.bottom );
-
-    lt = transform(lt);
-    rt = transform(rt);
-    lb = transform(lb);
-    rb = transform(rb);
+    const FloatRect f = transform(bounds.toFloatRect());
 
+    Rect r;
     if (roundOutwards) {
-        r.left   = static_cast<int32_t>(floorf(std::min({lt[0], rt[0], lb[0], rb[0]})));
-        r.top    = static_cast<int32_t>(floorf(std::min({lt[1], rt[1], lb[1], rb[1]})));
-        r.right  = static_cast<int32_t>(ceilf(std::max({lt[0], rt[0], lb[0], rb[0]})));
-        r.bottom = static_cast<int32_t>(ceilf(std::max({lt[1], rt[1], lb[1], rb[1]})));
+        r.left   = static_cast<int32_t>(floorf(f.left));
+        r.top    = static_cast<int32_t>(floorf(f.top));
+        r.right  = static_cast<int32_t>(ceilf(f.right));
+        r.bottom = static_cast<int32_t>(ceilf(f.bottom));
     } else {
-        r.left   = static_cast<int32_t>(floorf(std::min({lt[0], rt[0], lb[0], rb[0]}) + 0.5f));
-        r.top    = static_cast<int32_t>(floorf(std::min({lt[1], rt[1], lb[1], rb[1]}) + 0.5f));
-        r.right  = static_cast<int32_t>(floorf(std::max({lt[0], rt[0], lb[0], rb[0]}) + 0.5f));
-        r.bottom = static_cast<int32_t>(floorf(std::max({lt[1], rt[1], lb[1], rb[1]}) + 0.5f));
+        r.left   = static_cast<int32_t>(floorf(f.left + 0.5f));
+        r.top    = static_cast<int32_t>(floorf(f.top + 0.5f));
+        r.right  = static_cast<int32_t>(floorf(f.right + 0.5f));
+        r.bottom = static_cast<int32_t>(floorf(f.bottom + 0.5f));
     }
 
     return r;
 }
 
 FloatRect Transform::transform(const FloatRect& bounds) const {
-    vec2 lt(bounds.left, bounds.top);
-    vec2 rt(bounds.right, bounds.top);
-    vec2 lb(bounds.left, bounds.bottom);
-    vec2 rb(bounds.right, bounds.bottom);
-
-    lt = transform(lt);
-    rt = transform(rt);
-    lb = transform(lb);
-    rb = transform(rb);
-
-    FloatRect r;
-    r.left = std::min({lt[0], rt[0], lb[0], rb[0]});
-    r.top = std::min({lt[1], rt[1], lb[1], rb[1]});
-    r.right = std::max({lt[0], rt[0], lb[0], rb[0]});
-    r.bottom = std::max({lt[1], rt[1], lb[1], rb[1]});
+    const uint32_t type = this->type();
+    const mat33& M(mMatrix);
+    float x0, x1, y0, y1;
+
+    // Unless there is a skew or a rotation other than a multiple of 90 degrees, each of the
+    // transformed coordinates depends on a single coordinate of bounds, so only two corners need
+    // to be transformed. The matrix entries skipped are exactly zero, so the results are the same
+    // as transforming all four corners.
+    if (CC_LIKELY((type & 0xFF) <= TRANSLATE)) {
+        x0 = bounds.left + M[2][0];
+        x1 = bounds.right + M[2][0];
+        y0 = bounds.top + M[2][1];
+        y1 = bounds.bottom + M[2][1];
+    } else if ((type >> 8) & ROT_INVALID) {
+        vec2 lt(bounds.left, bounds.top);
+        vec2 rt(bounds.right, bounds.top);
+        vec2 lb(bounds.left, bounds.bottom);
+        vec2 rb(bounds.right, bounds.bottom);
+
+        lt = transform(lt);
+        rt = transform(rt);
+        lb = transform(lb);
+        rb = transform(rb);
+
+        FloatRect r;
+        r.left = std::min({lt[0], rt[0], lb[0], rb[0]});
+        r.top = std::min({lt[1], rt[1], lb[1], rb[1]});
+        r.right = std::max({lt[0], rt[0], lb[0], rb[0]});
+        r.bottom = std::max({lt[1], rt[1], lb[1], rb[1]});
+        return r;
+    } else if ((type >> 8) & ROT_90) {
+        x0 = M[1][0] * bounds.top + M[2][0];
+        x1 = M[1][0] * bounds.bottom + M[2][0];
+        y0 = M[0][1] * bounds.left + M[2][1];
+        y1 = M[0][1] * bounds.right + M[2][1];
+    } else {
+        x0 = M[0][0] * bounds.left + M[2][0];
+        x1 = M[0][0] * bounds.right + M[2][0];
+        y0 = M[1][1] * bounds.top + M[2][1];
+        y1 = M[1][1] * bounds.bottom + M[2][1];
+    }
 
-    return r;
+    return FloatRect(std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1));
 }
 
 Region Transform::transform(const Region& reg) const {
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+#include <vector>
+
+namespace android {
+namespace {
+
+const Rect kDisplay(1080, 2340);
+
+struct Layer {
+    Rect bounds;
+    bool opaque;
+};
+
+// A layer stack ordered from top to bottom: the system bars, numLayers - 3 app windows cascading
+// down the screen, every other one opaque, and the wallpaper.
+std::vector<Layer> makeLayerStack(int numLayers) {
+    std::vector<Layer> layers;
+    layers.push_back({Rect(0, 0, 1080, 80), false});
+    layers.push_back({Rect(0, 2214, 1080, 2340), false});
+    for (int i = 0; i < numLayers - 3; i++) {
+        const int offset = (i * 37) % 400;
+        layers.push_back({Rect(offset, 80 + offset, 1080 - offset / 2, 2214 - offset), i % 2 == 0});
+    }
+    layers.push_back({kDisplay, true});
+    return layers;
+}
+
+// The per-layer region computation of Output::ensureOutputLayerIfVisible, for a frame where the
+// geometry of every layer changed.
+void computeVisibleRegions(const std::vector<Layer>& layers, std::vector<Region>& visibleRegions,
+                           std::vector<Region>& coveredRegions) {
+    Region aboveOpaqueLayers;
+    Region aboveCoveredLayers;
+    Region dirtyRegion;
+    for (size_t i = 0; i < layers.size(); i++) {
+        Region visibleRegion(layers[i].bounds);
+        const Region coveredRegion = aboveCoveredLayers.intersect(visibleRegion);
+        aboveCoveredLayers.orSelf(visibleRegion);
+        visibleRegion.subtractSelf(aboveOpaqueLayers);
+
+        const Region newExposed = visibleRegion - coveredRegion;
+        const Region oldExposed = visibleRegions[i] - coveredRegions[i];
+        dirtyRegion.orSelf((visibleRegion & coveredRegions[i]) | (newExposed - oldExposed));
+        if (layers[i].opaque) {
+            aboveOpaqueLayers.orSelf(layers[i].bounds);
+        }
+
+        Region drawRegion(visibleRegion);
+        drawRegion.andSelf(kDisplay);
+        benchmark::DoNotOptimize(drawRegion.intersect(kDisplay));
+
+        visibleRegions[i] = visibleRegion;
+        coveredRegions[i] = coveredRegion;
+    }
+    benchmark::DoNotOptimize(Region(kDisplay).subtractSelf(aboveOpaqueLayers));
+}
+
+/**
+ * Visible, covered and dirty regions of a stack of state.range(0) layers, as SurfaceFlinger
+ * computes them each frame.
+ */
+static void benchmarkVisibleRegions(benchmark::State& state) {
+    const std::vector<Layer> layers = makeLayerStack(state.range(0));
+    std::vector<Region> visibleRegions(layers.size());
+    std::vector<Region> coveredRegions(layers.size());
+
+    for (auto _ : state) {
+        computeVisibleRegions(layers, visibleRegions, coveredRegions);
+    }
+    state.SetItemsProcessed(state.iterations() * layers.size());
+}
+BENCHMARK(benchmarkVisibleRegions)->Arg(4)->Arg(8)->Arg(16)->Arg(32);
+
+/**
+ * Operations between two rects, with a result that is a single rect.
+ */
+static void benchmarkRectOperations(benchmark::State& state) {
+    const Region region(Rect(100, 100, 900, 1600));
+    const Rect overlapping(0, 1200, 1080, 2340);
+    const Rect contained(200, 200, 800, 1500);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(region.intersect(overlapping));
+        benchmark::DoNotOptimize(region.merge(contained));
+        benchmark::DoNotOptimize(region.subtract(overlapping));
+    }
+    state.SetItemsProcessed(state.iterations() * 3);
+}
+BENCHMARK(benchmarkRectOperations);
+
+/**
+ * Operations on a region made of state.range(0) rows of two rects.
+ */
+static void benchmarkComplexRegion(benchmark::State& state) {
+    Region region;
+    for (int i = 0; i < state.range(0); i++) {
+        region.orSelf(Rect(0, i * 20, 100, i * 20 + 10));
+        region.orSelf(Rect(200, i * 20, 300, i * 20 + 10));
+    }
+    const Rect rect(50, 0, 250, state.range(0) * 10);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(region.intersect(rect));
+        benchmark::DoNotOptimize(region.merge(rect));
+        benchmark::DoNotOptimize(region.subtract(rect));
+    }
+    state.SetItemsProcessed(state.iterations() * 3);
+}
+BENCHMARK(benchmarkComplexRegion)->Arg(2)->Arg(16)->Arg(64);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
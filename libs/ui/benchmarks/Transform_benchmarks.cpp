@@ -0,0 +1,80 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <ui/Rect.h>
+#include <ui/Transform.h>
+
+namespace android::ui {
+namespace {
+
+enum TransformKind { kIdentity, kTranslate, kScale, kRotate90, kSkew };
+
+Transform makeTransform(int64_t kind) {
+    Transform t;
+    switch (kind) {
+        case kIdentity:
+            break;
+        case kTranslate:
+            t.set(100, 200);
+            break;
+        case kScale:
+            t.set(2, 0, 0, 2);
+            t.set(100, 200);
+            break;
+        case kRotate90:
+            t.set(Transform::ROT_90, 1080, 2340);
+            break;
+        case kSkew:
+            t.set(0.9f, 0.1f, 0.1f, 0.9f);
+            break;
+    }
+    return t;
+}
+
+/**
+ * Transform of a layer's bounds, as done for every layer when SurfaceFlinger computes bounds.
+ */
+static void benchmarkTransformRect(benchmark::State& state) {
+    const Transform t = makeTransform(state.range(0));
+    const Rect bounds(10, 20, 1000, 2000);
+    const FloatRect floatBounds(10.5f, 20.5f, 1000.5f, 2000.5f);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(t.transform(bounds));
+        benchmark::DoNotOptimize(t.transform(floatBounds));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(benchmarkTransformRect)->DenseRange(kIdentity, kSkew);
+
+/**
+ * Composition of a parent and a child layer transform.
+ */
+static void benchmarkTransformMultiply(benchmark::State& state) {
+    const Transform parent = makeTransform(state.range(0));
+    Transform child;
+    child.set(30, 40);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parent * child);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(benchmarkTransformMultiply)->DenseRange(kIdentity, kSkew);
+
+} // namespace
+} // namespace android::ui
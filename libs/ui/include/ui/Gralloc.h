@@ -74,6 +74,14 @@ public:
     // owned by the caller
     virtual int unlock(buffer_handle_t bufferHandle) const = 0;
 
+    // Makes the latest contents of a buffer that is already locked for CPU
+    // reading visible, after changes made to it by other agents. This lets a
+    // buffer stay locked while it is written to, instead of being unlocked and
+    // locked again.
+    virtual status_t rereadLockedBuffer(buffer_handle_t /*bufferHandle*/) const {
+        return INVALID_OPERATION;
+    }
+
     // isSupported queries whether or not a buffer with the given width, height,
     // format, layer count, and usage can be allocated on the device.  If
     // *outSupported is set to true, a buffer with the given specifications may be successfully
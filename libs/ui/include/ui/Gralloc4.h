@@ -26,7 +26,11 @@
 #include <ui/Rect.h>
 #include <utils/StrongPointer.h>
 
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace android {
 
@@ -64,6 +68,8 @@ public:
 
     int unlock(buffer_handle_t bufferHandle) const override;
 
+    status_t rereadLockedBuffer(buffer_handle_t bufferHandle) const override;
+
     status_t isSupported(uint32_t width, uint32_t height, PixelFormat format, uint32_t layerCount,
                          uint64_t usage, bool* outSupported) const override;
 
@@ -149,6 +155,15 @@ public:
     std::vector<android::hardware::graphics::mapper::V4_0::IMapper::MetadataTypeDescription>
     listSupportedMetadataTypes() const;
 
+    // Gets the encoded metadata of each type, in order, to be decoded with gralloc4::decode*.
+    // Metadata that is fixed at allocation, e.g. the size and plane layouts, is only fetched from
+    // the mapper once per buffer, and is cached until the buffer is freed.
+    status_t getMetadata(
+            buffer_handle_t bufferHandle,
+            const std::vector<android::hardware::graphics::mapper::V4_0::IMapper::MetadataType>&
+                    metadataTypes,
+            std::vector<hardware::hidl_vec<uint8_t>>* outMetadata) const;
+
 private:
     friend class GraphicBufferAllocator;
 
@@ -159,6 +174,11 @@ private:
     template <class T>
     using DecodeFunction = status_t (*)(const hardware::hidl_vec<uint8_t>& input, T* output);
 
+    status_t getEncoded(
+            buffer_handle_t bufferHandle,
+            const android::hardware::graphics::mapper::V4_0::IMapper::MetadataType& metadataType,
+            hardware::hidl_vec<uint8_t>* outVec) const;
+
     template <class T>
     status_t get(
             buffer_handle_t bufferHandle,
@@ -182,6 +202,13 @@ private:
             std::ostringstream* outDump, uint64_t* outAllocationSize, bool less) const;
 
     sp<hardware::graphics::mapper::V4_0::IMapper> mMapper;
+
+    using CachedMetadata =
+            std::vector<std::pair<android::hardware::graphics::mapper::V4_0::IMapper::MetadataType,
+                                  hardware::hidl_vec<uint8_t>>>;
+
+    mutable std::mutex mMetadataCacheMutex;
+    mutable std::unordered_map<buffer_handle_t, CachedMetadata> mMetadataCache;
 };
 
 class Gralloc4Allocator : public GrallocAllocator {
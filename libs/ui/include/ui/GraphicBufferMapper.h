@@ -20,12 +20,18 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <atomic>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include <ui/GraphicTypes.h>
 #include <ui/PixelFormat.h>
 #include <ui/Rect.h>
 #include <utils/Singleton.h>
+#include <utils/Timers.h>
 
 // Needed by code that still uses the GRALLOC_USAGE_* constants.
 // when/if we get rid of gralloc, we should provide aliases or fix call sites.
@@ -59,8 +65,22 @@ public:
             PixelFormat format, uint64_t usage, uint32_t stride,
             buffer_handle_t* outHandle);
 
+    // Same as above, except that imports of the same buffer share the imported outHandle while
+    // it is in use, and only the first one goes through the mapper HAL. The buffer is identified
+    // by the ID and generation number of its GraphicBuffer, and rawHandle must refer to the same
+    // files and parameters. Buffers with CPU usage are not shared, so a shared handle is never
+    // locked twice. Each import must still be matched by a freeBuffer.
+    status_t importBuffer(buffer_handle_t rawHandle, uint64_t bufferId, uint32_t generationNumber,
+            uint32_t width, uint32_t height, uint32_t layerCount,
+            PixelFormat format, uint64_t usage, uint32_t stride,
+            buffer_handle_t* outHandle);
+
     status_t freeBuffer(buffer_handle_t handle);
 
+    // Appends the number of imports through the mapper HAL and of shared imports, in total and per
+    // second since the previous call.
+    void dumpImportStats(std::string& result) const;
+
     void getTransportSize(buffer_handle_t handle,
             uint32_t* outTransportNumFds, uint32_t* outTransportNumInts);
 
@@ -86,6 +106,10 @@ public:
 
     status_t unlockAsync(buffer_handle_t handle, int *fenceFd);
 
+    // Picks up changes made by other agents to a buffer that is still locked
+    // for CPU reading. Supported by gralloc 4.0+.
+    status_t rereadLockedBuffer(buffer_handle_t handle);
+
     status_t isSupported(uint32_t width, uint32_t height, android::PixelFormat format,
                          uint32_t layerCount, uint64_t usage, bool* outSupported);
 
@@ -180,9 +204,40 @@ private:
 
     GraphicBufferMapper();
 
+    // A handle shared by the imports of a buffer, see importBuffer.
+    struct SharedImport {
+        buffer_handle_t handle;
+        // Identity of the files of the raw handle, and its ints.
+        std::vector<std::pair<dev_t, ino_t>> files;
+        std::vector<int> ints;
+        uint32_t width;
+        uint32_t height;
+        uint32_t layerCount;
+        PixelFormat format;
+        uint64_t usage;
+        uint32_t stride;
+        size_t refCount;
+    };
+
+    static bool matches(const SharedImport& import, buffer_handle_t rawHandle,
+                        const std::vector<std::pair<dev_t, ino_t>>& files, uint32_t width,
+                        uint32_t height, uint32_t layerCount, PixelFormat format, uint64_t usage,
+                        uint32_t stride);
+
     std::unique_ptr<const GrallocMapper> mMapper;
 
     Version mMapperVersion;
+
+    mutable std::mutex mImportMutex;
+    // Keyed by buffer ID and generation number.
+    std::map<std::pair<uint64_t, uint32_t>, SharedImport> mSharedImports;
+    std::unordered_map<buffer_handle_t, std::pair<uint64_t, uint32_t>> mSharedHandles;
+
+    std::atomic<uint64_t> mHalImportCount = 0;
+    std::atomic<uint64_t> mSharedImportCount = 0;
+    mutable uint64_t mLastDumpHalImportCount = 0;
+    mutable uint64_t mLastDumpSharedImportCount = 0;
+    mutable nsecs_t mLastDumpTime = 0;
 };
 
 // ---------------------------------------------------------------------------
@@ -152,6 +152,41 @@ TEST_F(RegionTest, Random_TJunction) {
     }
 }
 
+TEST_F(RegionTest, RectOperations_MatchSweep) {
+    // lhs is given a far away rect so that operations on it go through region_operator, and the
+    // far away rect is removed from the result afterwards.
+    const Rect far(100, 100, 101, 101);
+    const auto randomRect = [] {
+        const int left = random() % 8;
+        const int top = random() % 8;
+        return Rect(left, top, left + random() % 5, top + random() % 5);
+    };
+    srandom(12345);
+
+    for (int iter = 0; iter < 10000; iter++) {
+        const Rect lhs = randomRect();
+        const Rect rhs = randomRect();
+        Region swept(lhs);
+        swept.orSelf(far);
+
+        EXPECT_TRUE(Region(lhs).merge(rhs).hasSameRects(swept.merge(rhs).subtract(far)));
+        EXPECT_TRUE(Region(lhs).mergeExclusive(rhs).hasSameRects(
+                swept.mergeExclusive(rhs).subtract(far)));
+        EXPECT_TRUE(Region(lhs).intersect(rhs).hasSameRects(swept.intersect(rhs).subtract(far)));
+        EXPECT_TRUE(Region(lhs).subtract(rhs).hasSameRects(swept.subtract(rhs).subtract(far)));
+
+        Region result(lhs);
+        result.xorSelf(Region(rhs));
+        EXPECT_TRUE(result.hasSameRects(swept.mergeExclusive(rhs).subtract(far)));
+        result.set(lhs);
+        result.andSelf(rhs);
+        EXPECT_TRUE(result.hasSameRects(swept.intersect(rhs).subtract(far)));
+        result.set(lhs);
+        result.subtractSelf(Region(rhs), 1, 1);
+        EXPECT_TRUE(result.hasSameRects(swept.subtract(Region(rhs), 1, 1).subtract(far)));
+    }
+}
+
 TEST_F(RegionTest, EqualsToSelf) {
     Region touchableRegion;
     touchableRegion.orSelf(Rect(0, 0, 100, 100));
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ui/Rect.h>
+#include <ui/Transform.h>
+
+#include <gtest/gtest.h>
+
+namespace android::ui {
+
+TEST(TransformTest, transformRectIdentity) {
+    const Transform t;
+    EXPECT_EQ(Rect(10, 20, 30, 40), t.transform(Rect(10, 20, 30, 40)));
+    // The result is always sorted.
+    EXPECT_EQ(Rect(-1, -1, 0, 0), t.transform(Rect::INVALID_RECT));
+}
+
+TEST(TransformTest, transformRectTranslate) {
+    Transform t;
+    t.set(5, -5);
+    EXPECT_EQ(Transform::TRANSLATE, t.getType());
+    EXPECT_EQ(Rect(15, 15, 35, 35), t.transform(Rect(10, 20, 30, 40)));
+    EXPECT_EQ(FloatRect(15.5f, 15.5f, 35.5f, 35.5f),
+              t.transform(FloatRect(10.5f, 20.5f, 30.5f, 40.5f)));
+}
+
+TEST(TransformTest, transformRectScale) {
+    Transform t;
+    t.set(2, 0, 0, -0.5f);
+    t.set(1, 2);
+    EXPECT_EQ(Rect(21, -18, 61, -8), t.transform(Rect(10, 20, 30, 40)));
+    EXPECT_EQ(FloatRect(21, -18, 61, -8), t.transform(FloatRect(10, 20, 30, 40)));
+}
+
+TEST(TransformTest, transformRectRotate) {
+    Transform t;
+    t.set(Transform::ROT_90, 100, 200);
+    EXPECT_EQ(Transform::ROT_90, t.getOrientation());
+    EXPECT_EQ(Rect(60, 10, 80, 30), t.transform(Rect(10, 20, 30, 40)));
+
+    t.set(Transform::ROT_270, 100, 200);
+    EXPECT_EQ(Rect(20, 170, 40, 190), t.transform(Rect(10, 20, 30, 40)));
+}
+
+TEST(TransformTest, transformRectSkew) {
+    Transform t;
+    t.set(1, 1, 0, 1);
+    EXPECT_FALSE(t.preserveRects());
+    EXPECT_EQ(Rect(30, 20, 70, 40), t.transform(Rect(10, 20, 30, 40)));
+}
+
+TEST(TransformTest, multiplyTranslate) {
+    Transform a;
+    a.set(10, 20);
+    Transform b;
+    b.set(-10, 5);
+
+    const Transform product = a * b;
+    EXPECT_EQ(Transform::TRANSLATE, product.getType());
+    EXPECT_EQ(0, product.tx());
+    EXPECT_EQ(25, product.ty());
+
+    b.set(-10, -20);
+    EXPECT_EQ(Transform::IDENTITY, (a * b).getType());
+}
+
+TEST(TransformTest, multiplyTranslateAndRotate) {
+    Transform translate;
+    translate.set(10, 20);
+    Transform rotate;
+    rotate.set(Transform::ROT_90, 100, 200);
+
+    const Transform product = translate * rotate;
+    EXPECT_EQ(Transform::ROT_90, product.getOrientation());
+    EXPECT_EQ(translate.transform(rotate.transform(Rect(10, 20, 30, 40))),
+              product.transform(Rect(10, 20, 30, 40)));
+}
+
+} // namespace android::ui
@@ -0,0 +1,145 @@
+#include "libbroadcastring/broadcast_ring.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string.h>
+
+// Measures ring throughput with one writer and many readers.
+//
+// Thread 0 puts records as fast as it can while all other threads read them,
+// which is the access pattern of pose and vsync rings shared with many client
+// processes. The writer's rate is reported as items per second; readers report
+// how many records they read and missed under that load.
+
+namespace android {
+namespace dvr {
+namespace {
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+
+constexpr uint32_t kRecordCount = 64;
+
+template <uint32_t N>
+struct alignas(8) Payload {
+  char v[N];
+};
+
+template <uint32_t SlotAlignment>
+struct BenchmarkTraits : public DefaultRingTraits {
+  static constexpr uint32_t kStaticRecordCount = kRecordCount;
+  static constexpr uint32_t kRecordSlotAlignment = SlotAlignment;
+};
+
+template <typename Record, uint32_t SlotAlignment = 8>
+using Ring = BroadcastRing<Record, BenchmarkTraits<SlotAlignment>>;
+
+template <typename Record>
+void Fill(Record* record, uint32_t /*size*/, char c) {
+  memset(record, c, sizeof(*record));
+}
+
+template <uint32_t Capacity>
+void Fill(VariableSizeRecord<Capacity>* record, uint32_t size, char c) {
+  record->size = size;
+  memset(record->data, c, size);
+}
+
+// Ring shared by all the threads of a benchmark.
+template <typename RingType>
+class SharedRing {
+ public:
+  static RingType* Get() {
+    static SharedRing* shared_ring = new SharedRing;
+    return &shared_ring->ring_;
+  }
+
+ private:
+  SharedRing()
+      : size_(RingType::MemorySize()),
+        buffer_(new char[size_ + RingType::mmap_alignment()]) {
+    void* base = buffer_.get();
+    size_t space = size_ + RingType::mmap_alignment();
+    void* mmap = std::align(RingType::mmap_alignment(), size_, base, space);
+    ring_ = RingType::Create(mmap, size_);
+  }
+
+  size_t size_;
+  std::unique_ptr<char[]> buffer_;
+  RingType ring_;
+};
+
+// Writes records of |size| bytes on thread 0 and reads them on the others.
+template <typename RingType>
+void RunBroadcastRing(State& state, uint32_t size) {
+  using Record = typename RingType::Record;
+  RingType* ring = SharedRing<RingType>::Get();
+
+  if (state.thread_index == 0) {
+    Record record;
+    Fill(&record, size, 0);
+    char c = 0;
+    while (state.KeepRunning()) {
+      ring->Put(record);
+      Fill(&record, size, ++c);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * size);
+  } else {
+    Record record;
+    uint32_t sequence = ring->GetNextSequence();
+    int64_t reads = 0;
+    int64_t misses = 0;
+    int64_t skipped = 0;
+    while (state.KeepRunning()) {
+      const uint32_t expected = sequence;
+      if (ring->Get(&sequence, &record)) {
+        benchmark::DoNotOptimize(record);
+        skipped += sequence - expected;
+        reads++;
+        sequence++;
+      } else {
+        misses++;
+      }
+    }
+    state.counters["reads"] = Counter(reads, Counter::kIsRate);
+    state.counters["misses"] = Counter(misses, Counter::kIsRate);
+    state.counters["skipped"] = Counter(skipped, Counter::kIsRate);
+  }
+}
+
+template <typename Record, uint32_t SlotAlignment>
+void BM_FixedSize(State& state) {
+  RunBroadcastRing<Ring<Record, SlotAlignment>>(state, sizeof(Record));
+}
+
+template <uint32_t Capacity, uint32_t SlotAlignment>
+void BM_VariableSize(State& state) {
+  RunBroadcastRing<Ring<VariableSizeRecord<Capacity>, SlotAlignment>>(
+      state, static_cast<uint32_t>(state.range(0)));
+}
+
+constexpr int kMaxThreads = 16;
+
+BENCHMARK_TEMPLATE(BM_FixedSize, Payload<16>, 8)->ThreadRange(2, kMaxThreads);
+BENCHMARK_TEMPLATE(BM_FixedSize, Payload<16>, 64)->ThreadRange(2, kMaxThreads);
+BENCHMARK_TEMPLATE(BM_FixedSize, Payload<256>, 8)->ThreadRange(2, kMaxThreads);
+BENCHMARK_TEMPLATE(BM_FixedSize, Payload<256>, 64)
+    ->ThreadRange(2, kMaxThreads);
+
+// Small records in a ring sized for large ones, as when record sizes vary.
+BENCHMARK_TEMPLATE(BM_VariableSize, 248, 8)
+    ->Arg(16)
+    ->Arg(248)
+    ->ThreadRange(2, kMaxThreads);
+BENCHMARK_TEMPLATE(BM_VariableSize, 248, 64)
+    ->Arg(16)
+    ->Arg(248)
+    ->ThreadRange(2, kMaxThreads);
+
+}  // namespace
+}  // namespace dvr
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -52,6 +52,19 @@ struct FakeMmap {
   void* mmap() { return static_cast<void*>(data.get()); }
 };
 
+struct AlignedFakeMmap {
+  AlignedFakeMmap(size_t size, size_t alignment)
+      : size(size), data(new char[size + alignment]) {
+    void* base = data.get();
+    size_t space = size + alignment;
+    aligned = std::align(alignment, size, base, space);
+  }
+  size_t size;
+  std::unique_ptr<char[]> data;
+  void* aligned;
+  void* mmap() { return aligned; }
+};
+
 template <typename Ring>
 FakeMmap CreateRing(Ring* ring, uint32_t count) {
   FakeMmap mmap(Ring::MemorySize(count));
@@ -87,6 +100,21 @@ struct TraitsStatic
   static uint32_t MinCount() { return StaticCount; }
 };
 
+template <typename Record, uint32_t SlotAlignment, uint32_t StaticCount = 0>
+struct TraitsAligned : public Traits<Record, true, StaticCount, 1, 7> {
+  static constexpr uint32_t kRecordSlotAlignment = SlotAlignment;
+  using Ring = BroadcastRing<Record, TraitsAligned>;
+  static uint32_t MinCount() { return StaticCount ? StaticCount : 8; }
+};
+
+template <typename Record>
+Record VariableFill(uint32_t size, char c) {
+  Record record;
+  record.size = size;
+  memset(record.data, c, sizeof(record.data));
+  return record;
+}
+
 using Dynamic_8_NxM = TraitsDynamic<Sized<8>>;
 using Dynamic_16_NxM = TraitsDynamic<Sized<16>>;
 using Dynamic_32_NxM = TraitsDynamic<Sized<32>>;
@@ -103,6 +131,14 @@ using Static_16_16x16 = TraitsStatic<Sized<16>, 16>;
 using Static_16_16x32 = TraitsStatic<Sized<16>, 32>;
 using Static_32_Nx8 = TraitsStatic<Sized<32>, 8, false>;
 
+using Aligned_16_NxM = TraitsAligned<Sized<16>, 64>;
+using Aligned_72_8xM = TraitsAligned<Sized<72>, 64, 8>;
+
+using Variable_60_NxM = TraitsDynamic<VariableSizeRecord<60>, true>;
+using Variable_60_1x1 = TraitsStatic<VariableSizeRecord<60>, 1>;
+using Variable_248_NxM_1plus0 =
+    TraitsDynamic<VariableSizeRecord<248>, true, 1, 0>;
+
 using TraitsList = ::testing::Types<Dynamic_8_NxM,           //
                                     Dynamic_16_NxM,          //
                                     Dynamic_32_NxM,          //
@@ -673,6 +709,137 @@ TEST(BroadcastRingTest, ShouldDieIfCreationMmapMisaligned) {
   }
 }
 
+TEST(BroadcastRingTest, DefaultSlotAlignmentKeepsLayout) {
+  EXPECT_EQ(16u + 8u * 16u, Dynamic_16_NxM::Ring::MemorySize(8));
+  EXPECT_EQ(16u + 16u * 8u, Static_8_8x16::Ring::MemorySize());
+  EXPECT_EQ(8u, Dynamic_16_NxM::Ring::mmap_alignment());
+
+  using Ring = Dynamic_16_NxM::Ring;
+  Ring ring;
+  auto mmap = CreateRing(&ring, 8);
+  EXPECT_EQ(16u, ring.record_size());
+}
+
+TEST(BroadcastRingTest, AlignedSlotsGeometry) {
+  using Ring = Aligned_16_NxM::Ring;
+  EXPECT_EQ(64u, Ring::mmap_alignment());
+  EXPECT_EQ(64u + 64u * 8u, Ring::MemorySize(8));
+  EXPECT_EQ(8u, Ring::GetRecordCount(Ring::MemorySize(8)));
+  EXPECT_EQ(64u + 128u * 8u, Aligned_72_8xM::Ring::MemorySize());
+
+  AlignedFakeMmap mmap(Ring::MemorySize(8), Ring::mmap_alignment());
+  Ring ring = Ring::Create(mmap.mmap(), mmap.size, 8);
+  EXPECT_EQ(8u, ring.record_count());
+  EXPECT_EQ(64u, ring.record_size());
+}
+
+TEST(BroadcastRingTest, AlignedSlotsPutGet) {
+  using Ring = Aligned_72_8xM::Ring;
+  using Record = Ring::Record;
+  AlignedFakeMmap mmap(Ring::MemorySize(), Ring::mmap_alignment());
+  Ring ring = Ring::Create(mmap.mmap(), mmap.size);
+
+  // Wrap around the ring a few times.
+  const uint32_t record_count = ring.record_count();
+  for (uint32_t i = 0; i < 3 * record_count; ++i) {
+    ring.Put(Record::Pattern(i));
+  }
+
+  bool import_ok;
+  Ring imported_ring;
+  std::tie(imported_ring, import_ok) = Ring::Import(mmap.mmap(), mmap.size);
+  ASSERT_TRUE(import_ok);
+
+  uint32_t oldest_sequence = imported_ring.GetOldestSequence();
+  for (uint32_t i = 0; i < record_count; ++i) {
+    uint32_t sequence = oldest_sequence + i;
+    Record record;
+    EXPECT_TRUE(imported_ring.Get(&sequence, &record));
+    EXPECT_EQ(Record::Pattern(2 * record_count + i), record);
+  }
+}
+
+TEST(BroadcastRingTest, ShouldFailImportIfAlignedMmapTooSmall) {
+  using Ring = Aligned_16_NxM::Ring;
+  AlignedFakeMmap mmap(Ring::MemorySize(8), Ring::mmap_alignment());
+  Ring ring = Ring::Create(mmap.mmap(), mmap.size, 8);
+
+  bool import_ok;
+  std::tie(ring, import_ok) = Ring::Import(mmap.mmap(), mmap.size - 1);
+  EXPECT_FALSE(import_ok);
+  std::tie(ring, import_ok) = Ring::Import(mmap.mmap(), mmap.size);
+  EXPECT_TRUE(import_ok);
+}
+
+TEST(BroadcastRingTest, ShouldDieIfCreationMmapMisalignedForSlots) {
+  using Ring = Aligned_16_NxM::Ring;
+  size_t ring_size = Ring::MemorySize(8);
+  AlignedFakeMmap mmap(ring_size + 8, Ring::mmap_alignment());
+  char* misaligned = static_cast<char*>(mmap.mmap()) + 8;
+
+  EXPECT_DEATH_IF_SUPPORTED(
+      { Ring ring = Ring::Create(misaligned, ring_size, 8); }, "");
+}
+
+TEST(BroadcastRingTest, VariableSizeRecords) {
+  using Ring = Variable_60_NxM::Ring;
+  using Record = Ring::Record;
+  Ring ring;
+  auto mmap = CreateRing(&ring, Ring::Traits::MinCount());
+
+  for (uint32_t size : {0u, 1u, 7u, 8u, 9u, 60u}) {
+    Record out_record = VariableFill<Record>(size, 0);
+    for (uint32_t i = 0; i < size; ++i) {
+      out_record.data[i] = static_cast<uint8_t>(size + i);
+    }
+    ring.Put(out_record);
+
+    uint32_t sequence = ring.GetNewestSequence();
+    Record in_record;
+    EXPECT_TRUE(ring.Get(&sequence, &in_record));
+    ASSERT_EQ(size, in_record.size);
+    EXPECT_EQ(0, memcmp(out_record.data, in_record.data, size));
+  }
+}
+
+TEST(BroadcastRingTest, VariableSizeRecordsOnlyCopyUsedData) {
+  using Ring = Variable_60_1x1::Ring;
+  using Record = Ring::Record;
+  Ring ring;
+  auto mmap = CreateRing(&ring, Ring::Traits::MinCount());
+
+  ring.Put(VariableFill<Record>(Record::kCapacity, 0x11));
+  ring.Put(VariableFill<Record>(4, 0x22));
+
+  uint32_t sequence = ring.GetNewestSequence();
+  Record record = VariableFill<Record>(0, 0x33);
+  EXPECT_TRUE(ring.Get(&sequence, &record));
+  EXPECT_EQ(4u, record.size);
+  // The first word of data is copied, nothing after it is.
+  for (uint32_t i = 0; i < 8; ++i) EXPECT_EQ(0x22, record.data[i]);
+  for (uint32_t i = 8; i < Record::kCapacity; ++i) {
+    EXPECT_EQ(0x33, record.data[i]);
+  }
+}
+
+TEST(BroadcastRingTest, VariableSizeRecordsClampBadSize) {
+  using Ring = Variable_60_1x1::Ring;
+  using Record = Ring::Record;
+  Ring ring;
+  auto mmap = CreateRing(&ring, Ring::Traits::MinCount());
+
+  // A size beyond the capacity must not cause out-of-bounds copies.
+  ring.Put(VariableFill<Record>(0xffffffff, 0x44));
+
+  uint32_t sequence = ring.GetNewestSequence();
+  Record record = VariableFill<Record>(0, 0);
+  EXPECT_TRUE(ring.Get(&sequence, &record));
+  EXPECT_EQ(0xffffffff, record.size);
+  for (uint32_t i = 0; i < Record::kCapacity; ++i) {
+    EXPECT_EQ(0x44, record.data[i]);
+  }
+}
+
 template <typename Ring>
 std::unique_ptr<std::thread> CopyTask(std::atomic<bool>* quit, void* in_base,
                                       size_t in_size, void* out_base,
@@ -862,5 +1029,47 @@ TEST(BroadcastRingTest, ThreadedOverwriteTortureLarge) {
   ThreadedOverwriteTorture<Dynamic_256_NxM_1plus0::Ring>();
 }
 
+TEST(BroadcastRingTest, ThreadedOverwriteTortureVariableSize) {
+  using Ring = Variable_248_NxM_1plus0::Ring;
+  using Record = Ring::Record;
+
+  Ring out_ring;
+  auto out_mmap = CreateRing(&out_ring, 1);
+
+  std::atomic<bool> quit(false);
+  std::thread check_task([&quit, &out_mmap]() {
+    bool import_ok;
+    Ring in_ring;
+    std::tie(in_ring, import_ok) = Ring::Import(out_mmap.mmap(), out_mmap.size);
+    ASSERT_TRUE(import_ok);
+
+    uint32_t sequence = in_ring.GetOldestSequence();
+    while (!std::atomic_load_explicit(&quit, std::memory_order_relaxed)) {
+      Record record;
+      if (in_ring.Get(&sequence, &record)) {
+        // The size and the data are always from the same Put().
+        ASSERT_LE(record.size, Record::kCapacity);
+        if (record.size > 0) {
+          ASSERT_EQ(record.data[0] % (Record::kCapacity + 1), record.size);
+        }
+        for (uint32_t i = 1; i < record.size; ++i) {
+          ASSERT_EQ(record.data[0], record.data[i]);
+        }
+        sequence++;
+      }
+    }
+  });
+
+  constexpr int kIterations = 10000;
+  for (int i = 0; i < kIterations; ++i) {
+    const uint8_t fill = static_cast<uint8_t>(i);
+    out_ring.Put(VariableFill<Record>(fill % (Record::kCapacity + 1),
+                                      static_cast<char>(fill)));
+  }
+
+  std::atomic_store_explicit(&quit, true, std::memory_order_relaxed);
+  check_task.join();
+}
+
 } // namespace dvr
 } // namespace android
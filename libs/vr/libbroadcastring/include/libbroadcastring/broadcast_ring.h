@@ -31,8 +31,52 @@ struct DefaultRingTraits {
 
   // Set this to the min number of records that must be readable.
   static constexpr uint32_t kMinAvailableRecords = 1;
+
+  // Set this to the alignment of each record in the ring, e.g. to 64 to give
+  // every record its own cache lines when there are many readers. Must be a
+  // power of two of at least 8, and the same for the writer and all readers.
+  static constexpr uint32_t kRecordSlotAlignment = 8;
+};
+
+// Record carrying a variable amount of data, up to |Capacity| bytes.
+//
+// Only the used part of |data| is copied into and out of the ring, so a ring
+// can be sized for the largest record without making small records slower to
+// put and get. Bytes of |data| past |size| are unspecified after a Get().
+template <uint32_t Capacity>
+struct alignas(8) VariableSizeRecord {
+  static constexpr uint32_t kCapacity = Capacity;
+
+  // Number of bytes used in |data|.
+  uint32_t size = 0;
+  uint32_t reserved = 0;
+  uint8_t data[(Capacity + 7) & ~7u];
 };
 
+namespace broadcast_ring_internal {
+
+// Rounds |size| up to a multiple of |alignment|, which is a power of two.
+constexpr size_t RoundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// Slot alignment for traits that predate kRecordSlotAlignment.
+template <typename Traits, typename = void>
+struct RecordSlotAlignment : std::integral_constant<uint32_t, 8> {};
+
+template <typename Traits>
+struct RecordSlotAlignment<Traits,
+                           decltype(void(Traits::kRecordSlotAlignment))>
+    : std::integral_constant<uint32_t, Traits::kRecordSlotAlignment> {};
+
+template <typename Record>
+struct IsVariableSizeRecord : std::false_type {};
+
+template <uint32_t Capacity>
+struct IsVariableSizeRecord<VariableSizeRecord<Capacity>> : std::true_type {};
+
+}  // namespace broadcast_ring_internal
+
 // Nonblocking ring suitable for concurrent single-writer, multi-reader access.
 //
 // Readers never block the writer and thus this is a nondeterministically lossy
@@ -151,6 +195,10 @@ class BroadcastRing {
     // If both record size and count are static then the overall size is too.
     static constexpr bool kIsStaticSize =
         BaseTraits::kUseStaticRecordSize && kUseStaticRecordCount;
+
+    // Defaults to 8 when not set in BaseTraits.
+    static constexpr uint32_t kRecordSlotAlignment =
+        broadcast_ring_internal::RecordSlotAlignment<BaseTraits>::value;
   };
 
   static constexpr bool IsPowerOfTwo(uint32_t size) {
@@ -167,6 +215,9 @@ class BroadcastRing {
                 "Static record count is not a power of two");
   static_assert(std::is_standard_layout<Record>::value,
                 "Record type must be standard layout");
+  static_assert(Traits::kRecordSlotAlignment >= 8 &&
+                    IsPowerOfTwo(Traits::kRecordSlotAlignment),
+                "Record slot alignment is not a power of two of at least 8");
 
   BroadcastRing() {}
 
@@ -177,8 +228,8 @@ class BroadcastRing {
   static BroadcastRing Create(void* mmap, size_t mmap_size,
                               uint32_t record_count) {
     BroadcastRing ring(mmap);
-    CHECK(ring.ValidateGeometry(mmap_size, sizeof(Record), record_count));
-    ring.InitializeHeader(sizeof(Record), record_count);
+    CHECK(ring.ValidateGeometry(mmap_size, kSlotSize, record_count));
+    ring.InitializeHeader(kSlotSize, record_count);
     return ring;
   }
 
@@ -217,7 +268,7 @@ class BroadcastRing {
   //
   // Use this function for dynamically sized rings.
   static constexpr size_t MemorySize(uint32_t record_count) {
-    return sizeof(Header) + sizeof(Record) * record_count;
+    return kRecordsOffset + kSlotSize * record_count;
   }
 
   // Calculates the space necessary for a statically sized ring.
@@ -246,11 +297,11 @@ class BroadcastRing {
   //
   // The header size has been taken into account.
   static uint32_t GetRecordCount(size_t mmap_size) {
-    if (mmap_size <= sizeof(Header)) {
+    if (mmap_size <= kRecordsOffset) {
       return 0;
     }
     uint32_t count =
-        static_cast<uint32_t>((mmap_size - sizeof(Header)) / sizeof(Record));
+        static_cast<uint32_t>((mmap_size - kRecordsOffset) / kSlotSize);
     return IsPowerOfTwo(count) ? count : (NextPowerOf2(count) / 2);
   }
 
@@ -374,7 +425,11 @@ class BroadcastRing {
 
   uint32_t record_count() const { return record_count_internal(); }
   uint32_t record_size() const { return record_size_internal(); }
-  static constexpr uint32_t mmap_alignment() { return alignof(Mmap); }
+  static constexpr uint32_t mmap_alignment() {
+    return alignof(Mmap) > Traits::kRecordSlotAlignment
+               ? alignof(Mmap)
+               : Traits::kRecordSlotAlignment;
+  }
 
  private:
   struct Header {
@@ -423,6 +478,14 @@ class BroadcastRing {
                     sizeof(Record),
                 "Record length must be a multiple of sizeof(StorageType)");
 
+  // Size of each record in the ring, and offset of the first one in the mmap
+  // area. Both are unchanged from sizeof(Record) and sizeof(Header) with the
+  // default alignment, so that the layout stays compatible.
+  static constexpr size_t kSlotSize = broadcast_ring_internal::RoundUp(
+      sizeof(Record), Traits::kRecordSlotAlignment);
+  static constexpr size_t kRecordsOffset = broadcast_ring_internal::RoundUp(
+      sizeof(Header), Traits::kRecordSlotAlignment);
+
   struct Geometry {
     // Static geometry.
     uint32_t record_count;
@@ -448,7 +511,8 @@ class BroadcastRing {
   // Mmap area layout.
   //
   // Readers should not index directly into |records| as this is not valid when
-  // dynamic record sizes are used; use record_mmap_reader() instead.
+  // dynamic record sizes or a record slot alignment are used; use
+  // record_mmap_reader() instead.
   struct Mmap {
     Header header;
     RecordStorage records[];
@@ -462,7 +526,7 @@ class BroadcastRing {
                 "Lockless atomics contain extra state");
 
   explicit BroadcastRing(void* mmap) {
-    CHECK_EQ(0U, reinterpret_cast<uintptr_t>(mmap) % alignof(Mmap));
+    CHECK_EQ(0U, reinterpret_cast<uintptr_t>(mmap) % mmap_alignment());
     data_.mmap = reinterpret_cast<Mmap*>(mmap);
   }
 
@@ -494,24 +558,48 @@ class BroadcastRing {
     if (record_count() < Traits::kMinRecordCount) return false;
     if (record_size() < sizeof(Record)) return false;
     if (record_size() % kRecordAlignment != 0) return false;
+    if (record_size() % Traits::kRecordSlotAlignment != 0) return false;
     if (!IsPowerOfTwo(record_count())) return false;
 
     size_t memory_size = record_count() * record_size();
     if (memory_size / record_size() != record_count()) return false;
-    if (memory_size + sizeof(Header) < memory_size) return false;
-    if (memory_size + sizeof(Header) > mmap_size) return false;
+    if (memory_size + kRecordsOffset < memory_size) return false;
+    if (memory_size + kRecordsOffset > mmap_size) return false;
 
     return true;
   }
 
+  static constexpr size_t kRecordWords = sizeof(Record) / sizeof(StorageType);
+
+  // Number of storage words used by |record|: all of them, except for variable
+  // size records, which only use their size field and the filled part of their
+  // data. The size is clamped, as it may come from a misbehaving writer.
+  template <typename T = Record>
+  static typename std::enable_if<
+      !broadcast_ring_internal::IsVariableSizeRecord<T>::value, size_t>::type
+  UsedRecordWords(const T& /*record*/) {
+    return kRecordWords;
+  }
+
+  template <typename T = Record>
+  static typename std::enable_if<
+      broadcast_ring_internal::IsVariableSizeRecord<T>::value, size_t>::type
+  UsedRecordWords(const T& record) {
+    const size_t used_size = offsetof(T, data) + record.size;
+    const size_t used_words =
+        (used_size + sizeof(StorageType) - 1) / sizeof(StorageType);
+    return used_words < kRecordWords ? used_words : kRecordWords;
+  }
+
   // Copies a record into the ring.
   //
   // This is done with relaxed atomics because otherwise it is racy according to
   // the C++ memory model. This is very low overhead once optimized.
   static inline void PutRecordInternal(const Record* in, RecordStorage* out) {
-    StorageType data[sizeof(Record) / sizeof(StorageType)];
+    StorageType data[kRecordWords];
     memcpy(data, in, sizeof(*in));
-    for (size_t i = 0; i < std::extent<decltype(data)>(); ++i) {
+    const size_t used_words = UsedRecordWords(*in);
+    for (size_t i = 0; i < used_words; ++i) {
       std::atomic_store_explicit(&out->data[i], data[i],
                                  std::memory_order_relaxed);
     }
@@ -521,13 +609,27 @@ class BroadcastRing {
   //
   // This is done with relaxed atomics because otherwise it is racy according to
   // the C++ memory model. This is very low overhead once optimized.
+  //
+  // Variable size records are read in two steps: the first word holds the
+  // size, which is then used to read only the filled part of the data. A size
+  // changed by a concurrent Put() is caught by the caller like any other
+  // concurrent modification.
   static inline void GetRecordInternal(RecordStorage* in, Record* out) {
-    StorageType data[sizeof(Record) / sizeof(StorageType)];
-    for (size_t i = 0; i < std::extent<decltype(data)>(); ++i) {
+    StorageType data[kRecordWords];
+    size_t used_words = kRecordWords;
+    size_t i = 0;
+    if (broadcast_ring_internal::IsVariableSizeRecord<Record>::value) {
+      data[i] =
+          std::atomic_load_explicit(&in->data[i], std::memory_order_relaxed);
+      ++i;
+      memcpy(out, &data, sizeof(StorageType));
+      used_words = UsedRecordWords(*out);
+    }
+    for (; i < used_words; ++i) {
       data[i] =
           std::atomic_load_explicit(&in->data[i], std::memory_order_relaxed);
     }
-    memcpy(out, &data, sizeof(*out));
+    memcpy(out, &data, used_words * sizeof(StorageType));
   }
 
   // Converts a record's sequence number into a storage index.
@@ -599,18 +701,23 @@ class BroadcastRing {
   // Helpers to compute addresses in mmap area.
   Mmap* mmap() const { return data_.mmap; }
   Header* header_mmap() const { return &data_.mmap->header; }
+  char* records_mmap() const {
+    return reinterpret_cast<char*>(data_.mmap) + kRecordsOffset;
+  }
   RecordStorage* record_mmap_writer(uint32_t index) const {
-    DCHECK_EQ(sizeof(Record), record_size());
-    return &data_.mmap->records[index];
+    DCHECK_EQ(kSlotSize, record_size());
+    return reinterpret_cast<RecordStorage*>(records_mmap() +
+                                            index * kSlotSize);
   }
   RecordStorage* record_mmap_reader(uint32_t index) const {
     if (Traits::kUseStaticRecordSize) {
-      return &data_.mmap->records[index];
+      return reinterpret_cast<RecordStorage*>(records_mmap() +
+                                              index * kSlotSize);
     } else {
       // Calculate the location of a record in the ring without assuming that
-      // sizeof(Record) == record_size.
-      return reinterpret_cast<RecordStorage*>(
-          reinterpret_cast<char*>(data_.mmap->records) + index * record_size());
+      // kSlotSize == record_size.
+      return reinterpret_cast<RecordStorage*>(records_mmap() +
+                                              index * record_size());
     }
   }
 
@@ -623,7 +730,7 @@ class BroadcastRing {
   template <typename T = Traits>
   typename std::enable_if<T::kUseStaticRecordSize, uint32_t>::type
   record_size_internal() const {
-    return sizeof(Record);
+    return kSlotSize;
   }
 
   template <typename T = Traits>
@@ -86,13 +86,51 @@ Status<void> ReadAndDiscardData(const BorrowedHandle& socket_fd, size_t size) {
   return ErrorStatus(EIO);
 }
 
+Status<void> ReadBulkData(const BulkDataRegion& bulk_data, size_t size,
+                          const iovec* receive_vector, size_t receive_count) {
+  if (size > bulk_data.size())
+    return ErrorStatus(EIO);
+
+  const uint8_t* data = bulk_data.data();
+  for (size_t i = 0; i < receive_count && size > 0; i++) {
+    size_t size_to_copy = std::min(size, receive_vector[i].iov_len);
+    memcpy(receive_vector[i].iov_base, data, size_to_copy);
+    data += size_to_copy;
+    size -= size_to_copy;
+  }
+  // Same as for the data sent through the socket, a response larger than the
+  // buffers provided by the caller is an error.
+  if (size > 0)
+    return ErrorStatus(EIO);
+  return {};
+}
+
 Status<void> SendRequest(const BorrowedHandle& socket_fd,
-                         TransactionState* transaction_state, int opcode,
+                         TransactionState* transaction_state,
+                         BulkDataRegion* bulk_data, int opcode,
                          const iovec* send_vector, size_t send_count,
                          size_t max_recv_len) {
   size_t send_len = CountVectorSize(send_vector, send_count);
   InitRequest(&transaction_state->request, opcode, send_len, max_recv_len,
               false);
+  if (send_len >= kBulkDataThreshold || max_recv_len >= kBulkDataThreshold) {
+    // The service holds on to the region, so it only needs to be sent along
+    // with the request when it changes.
+    auto reserve_status = bulk_data->Reserve(std::max(send_len, max_recv_len));
+    if (!reserve_status)
+      return reserve_status.error_status();
+    if (reserve_status.get())
+      transaction_state->request.bulk_data_fd = bulk_data->fd();
+  }
+  if (send_len >= kBulkDataThreshold) {
+    uint8_t* data = bulk_data->data();
+    for (size_t i = 0; i < send_count; i++) {
+      memcpy(data, send_vector[i].iov_base, send_vector[i].iov_len);
+      data += send_vector[i].iov_len;
+    }
+    transaction_state->request.is_bulk_data = true;
+    send_len = 0;
+  }
   if (send_len == 0) {
     send_vector = nullptr;
     send_count = 0;
@@ -103,12 +141,18 @@ Status<void> SendRequest(const BorrowedHandle& socket_fd,
 
 Status<void> ReceiveResponse(const BorrowedHandle& socket_fd,
                              TransactionState* transaction_state,
+                             const BulkDataRegion& bulk_data,
                              const iovec* receive_vector, size_t receive_count,
                              size_t max_recv_len) {
   auto status = ReceiveData(socket_fd, &transaction_state->response);
   if (!status)
     return status;
 
+  if (transaction_state->response.is_bulk_data) {
+    return ReadBulkData(bulk_data, transaction_state->response.recv_len,
+                        receive_vector, receive_count);
+  }
+
   if (transaction_state->response.recv_len > 0) {
     std::vector<iovec> read_buffers;
     size_t size_remaining = 0;
@@ -191,11 +235,13 @@ Status<int> ClientChannel::SendAndReceive(void* transaction_state, int opcode,
   auto* state = static_cast<TransactionState*>(transaction_state);
   size_t max_recv_len = CountVectorSize(receive_vector, receive_count);
 
-  auto status = SendRequest(BorrowedHandle{channel_handle_.value()}, state,
-                            opcode, send_vector, send_count, max_recv_len);
+  auto status =
+      SendRequest(BorrowedHandle{channel_handle_.value()}, state, &bulk_data_,
+                  opcode, send_vector, send_count, max_recv_len);
   if (status) {
     status = ReceiveResponse(BorrowedHandle{channel_handle_.value()}, state,
-                             receive_vector, receive_count, max_recv_len);
+                             bulk_data_, receive_vector, receive_count,
+                             max_recv_len);
   }
   if (!result.PropagateError(status)) {
     const int return_code = state->response.ret_code;
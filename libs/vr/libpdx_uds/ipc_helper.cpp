@@ -2,12 +2,16 @@
 
 #include <alloca.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <log/log.h>
 #include <poll.h>
 #include <string.h>
 #include <sys/inotify.h>
+#include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
 
@@ -365,6 +369,92 @@ bool ReceivePayload::GetChannelHandle(ChannelReference /*ref*/,
   return false;
 }
 
+BulkDataRegion::~BulkDataRegion() {
+  if (data_)
+    munmap(data_, size_);
+}
+
+Status<bool> BulkDataRegion::Reserve(size_t size) {
+  if (size <= size_)
+    return false;
+
+  // Grow geometrically so that slowly increasing payloads don't require the
+  // region to be sent to the peer on every message.
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t new_size = std::max(size, size_ * 2);
+  new_size = (new_size + page_size - 1) / page_size * page_size;
+
+  if (!fd_) {
+    LocalHandle fd{
+        memfd_create("pdx_uds_bulk_data", MFD_CLOEXEC | MFD_ALLOW_SEALING)};
+    if (!fd || fcntl(fd.Get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) < 0) {
+      const int error = errno;
+      ALOGE("BulkDataRegion::Reserve: Failed to create region: %s",
+            strerror(error));
+      return ErrorStatus(error);
+    }
+    fd_ = std::move(fd);
+  }
+
+  if (ftruncate(fd_.Get(), new_size) < 0) {
+    const int error = errno;
+    ALOGE("BulkDataRegion::Reserve: Failed to resize region to %zu bytes: %s",
+          new_size, strerror(error));
+    return ErrorStatus(error);
+  }
+
+  void* data =
+      mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_.Get(), 0);
+  if (data == MAP_FAILED) {
+    const int error = errno;
+    ALOGE("BulkDataRegion::Reserve: Failed to map region: %s",
+          strerror(error));
+    return ErrorStatus(error);
+  }
+
+  if (data_)
+    munmap(data_, size_);
+  data_ = static_cast<uint8_t*>(data);
+  size_ = new_size;
+  return true;
+}
+
+Status<void> BulkDataRegion::Map(LocalHandle fd) {
+  // Without the seal the peer could truncate the region while it is mapped
+  // here, and make any access to it fault.
+  const int seals = fcntl(fd.Get(), F_GET_SEALS);
+  if (seals < 0 || (seals & F_SEAL_SHRINK) == 0) {
+    ALOGE("BulkDataRegion::Map: Region is not sealed against shrinking");
+    return ErrorStatus(EINVAL);
+  }
+
+  struct stat stat_buf;
+  if (fstat(fd.Get(), &stat_buf) < 0) {
+    const int error = errno;
+    ALOGE("BulkDataRegion::Map: Failed to get region size: %s",
+          strerror(error));
+    return ErrorStatus(error);
+  }
+  const size_t size = stat_buf.st_size;
+  if (size == 0)
+    return ErrorStatus(EINVAL);
+
+  void* data =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.Get(), 0);
+  if (data == MAP_FAILED) {
+    const int error = errno;
+    ALOGE("BulkDataRegion::Map: Failed to map region: %s", strerror(error));
+    return ErrorStatus(error);
+  }
+
+  if (data_)
+    munmap(data_, size_);
+  fd_ = std::move(fd);
+  data_ = static_cast<uint8_t*>(data);
+  size_ = size;
+  return {};
+}
+
 Status<void> SendData(const BorrowedHandle& socket_fd, const void* data,
                       size_t size) {
   return SendAll(&g_socket_sender, socket_fd, data, size);
@@ -407,6 +497,8 @@ void InitRequest(android::pdx::uds::RequestHeader<BorrowedHandle>* request,
   request->send_len = send_len;
   request->max_recv_len = max_recv_len;
   request->is_impulse = is_impulse;
+  request->bulk_data_fd = BorrowedHandle{};
+  request->is_bulk_data = false;
 }
 
 Status<void> WaitForEndpoint(const std::string& endpoint_path,
@@ -1,5 +1,8 @@
 #include "uds/ipc_helper.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -8,6 +11,8 @@ using testing::SetErrnoAndReturn;
 using testing::_;
 
 using android::pdx::BorrowedHandle;
+using android::pdx::LocalHandle;
+using android::pdx::uds::BulkDataRegion;
 using android::pdx::uds::SendInterface;
 using android::pdx::uds::RecvInterface;
 using android::pdx::uds::SendAll;
@@ -362,4 +367,59 @@ TEST_F(RecvMessageTest, Error2) {
   EXPECT_EQ(EBADF, status.error());
 }
 
+// BulkDataRegion
+
+TEST(BulkDataRegionTest, Reserve) {
+  BulkDataRegion region;
+  EXPECT_EQ(0u, region.size());
+
+  auto status = region.Reserve(100);
+  ASSERT_TRUE(status);
+  EXPECT_TRUE(status.get());
+  EXPECT_TRUE(region.fd());
+  EXPECT_LE(100u, region.size());
+  const size_t size = region.size();
+
+  // Fits in the existing region.
+  status = region.Reserve(size);
+  ASSERT_TRUE(status);
+  EXPECT_FALSE(status.get());
+
+  // The region is grown, but not recreated.
+  const int fd = region.fd().Get();
+  region.data()[0] = 'x';
+  status = region.Reserve(size + 1);
+  ASSERT_TRUE(status);
+  EXPECT_TRUE(status.get());
+  EXPECT_LT(size, region.size());
+  EXPECT_EQ(fd, region.fd().Get());
+  EXPECT_EQ('x', region.data()[0]);
+}
+
+TEST(BulkDataRegionTest, MapSharesData) {
+  BulkDataRegion region;
+  ASSERT_TRUE(region.Reserve(100));
+
+  BulkDataRegion peer;
+  ASSERT_TRUE(peer.Map(LocalHandle::AsDuplicate(region.fd().Get())));
+  EXPECT_EQ(region.size(), peer.size());
+
+  memcpy(region.data(), "request", 8);
+  EXPECT_STREQ("request", reinterpret_cast<char*>(peer.data()));
+  memcpy(peer.data(), "reply", 6);
+  EXPECT_STREQ("reply", reinterpret_cast<char*>(region.data()));
+}
+
+TEST(BulkDataRegionTest, MapRejectsUnsealedRegion) {
+  LocalHandle fd{memfd_create("test", MFD_CLOEXEC | MFD_ALLOW_SEALING)};
+  ASSERT_TRUE(fd);
+  ASSERT_EQ(0, ftruncate(fd.Get(), 4096));
+
+  BulkDataRegion peer;
+  auto status = peer.Map(std::move(fd));
+  ASSERT_FALSE(status);
+  EXPECT_EQ(EINVAL, status.error());
+  EXPECT_EQ(0u, peer.size());
+}
+
 }  // namespace
@@ -7,6 +7,7 @@
 
 #include <uds/channel_event_set.h>
 #include <uds/channel_manager.h>
+#include <uds/ipc_helper.h>
 #include <uds/service_endpoint.h>
 
 namespace android {
@@ -89,6 +90,8 @@ class ClientChannel : public pdx::ClientChannel {
   LocalChannelHandle channel_handle_;
   ChannelEventReceiver* channel_data_;
   std::mutex socket_mutex_;
+  // Created on the first transaction with a large payload.
+  BulkDataRegion bulk_data_;
 };
 
 }  // namespace uds
@@ -107,6 +107,39 @@ class ReceivePayload : public MessageReader, public InputResourceMapper {
   size_t read_pos_{0};
 };
 
+// Requests and responses with at least this many bytes of payload data are
+// passed through the channel's bulk data region instead of the socket.
+constexpr size_t kBulkDataThreshold = 64 * 1024;
+
+// Shared memory region that a client lends to the service side of its channel
+// to pass large message payloads without copying them through the kernel. The
+// client creates and grows the region, which is sealed against shrinking so
+// that the service can keep it mapped safely.
+class BulkDataRegion {
+ public:
+  BulkDataRegion() = default;
+  ~BulkDataRegion();
+
+  // Makes the region at least |size| bytes large. Returns true if the region
+  // was created or grown, in which case it has to be sent to the peer again.
+  Status<bool> Reserve(size_t size);
+
+  // Maps the region created by the peer and referred to by |fd|.
+  Status<void> Map(LocalHandle fd);
+
+  BorrowedHandle fd() const { return fd_.Borrow(); }
+  uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  BulkDataRegion(const BulkDataRegion&) = delete;
+  void operator=(const BulkDataRegion&) = delete;
+
+  LocalHandle fd_;
+  uint8_t* data_{nullptr};
+  size_t size_{0};
+};
+
 template <typename FileHandleType>
 class ChannelInfo {
  public:
@@ -139,11 +172,15 @@ class RequestHeader {
   std::vector<ChannelInfo<FileHandleType>> channels;
   std::array<uint8_t, 32> impulse_payload;
   bool is_impulse{false};
+  // Set when the client created or grew its bulk data region.
+  FileHandleType bulk_data_fd;
+  // Set when the request payload is in the bulk data region.
+  bool is_bulk_data{false};
 
  private:
   PDX_SERIALIZABLE_MEMBERS(RequestHeader, op, send_len, max_recv_len,
                            file_descriptors, channels, impulse_payload,
-                           is_impulse);
+                           is_impulse, bulk_data_fd, is_bulk_data);
 };
 
 template <typename FileHandleType>
@@ -153,10 +190,12 @@ class ResponseHeader {
   uint32_t recv_len{0};
   std::vector<FileHandleType> file_descriptors;
   std::vector<ChannelInfo<FileHandleType>> channels;
+  // Set when the response payload is in the bulk data region.
+  bool is_bulk_data{false};
 
  private:
   PDX_SERIALIZABLE_MEMBERS(ResponseHeader, ret_code, recv_len, file_descriptors,
-                           channels);
+                           channels, is_bulk_data);
 };
 
 template <typename T>
@@ -13,6 +13,7 @@
 #include <pdx/service.h>
 #include <pdx/service_endpoint.h>
 #include <uds/channel_event_set.h>
+#include <uds/ipc_helper.h>
 
 namespace android {
 namespace pdx {
@@ -112,6 +113,8 @@ class Endpoint : public pdx::Endpoint {
     LocalHandle data_fd;
     ChannelEventSet event_set;
     Channel* channel_state{nullptr};
+    // Shared by the messages in flight, as the client may replace the region.
+    std::shared_ptr<BulkDataRegion> bulk_data;
   };
 
   // This class must be instantiated using Create() static methods above.
@@ -143,6 +146,8 @@ class Endpoint : public pdx::Endpoint {
   Status<std::pair<BorrowedHandle, BorrowedHandle>> GetChannelEventFd(
       int32_t channel_id);
   int32_t GetChannelId(const BorrowedHandle& channel_fd);
+  Status<std::shared_ptr<BulkDataRegion>> GetChannelBulkData(
+      int32_t channel_id, LocalHandle bulk_data_fd);
   Status<void> CreateChannelSocketPair(LocalHandle* local_socket,
                                        LocalHandle* remote_socket);
 
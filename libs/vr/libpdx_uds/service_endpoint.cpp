@@ -28,6 +28,7 @@ using android::pdx::FileReference;
 using android::pdx::LocalChannelHandle;
 using android::pdx::LocalHandle;
 using android::pdx::Status;
+using android::pdx::uds::BulkDataRegion;
 using android::pdx::uds::ChannelInfo;
 using android::pdx::uds::ChannelManager;
 
@@ -104,12 +105,17 @@ struct MessageState {
   }
 
   Status<size_t> ReadData(const iovec* vector, size_t vector_length) {
-    size_t size_remaining = request_data.size() - request_data_read_pos;
+    const uint8_t* data = request_data.data();
+    size_t data_size = request_data.size();
+    if (request.is_bulk_data) {
+      data = bulk_data->data();
+      data_size = request.send_len;
+    }
+    size_t size_remaining = data_size - request_data_read_pos;
     size_t size = 0;
     for (size_t i = 0; i < vector_length && size_remaining > 0; i++) {
       size_t size_to_copy = std::min(size_remaining, vector[i].iov_len);
-      memcpy(vector[i].iov_base, request_data.data() + request_data_read_pos,
-             size_to_copy);
+      memcpy(vector[i].iov_base, data + request_data_read_pos, size_to_copy);
       size += size_to_copy;
       request_data_read_pos += size_to_copy;
       size_remaining -= size_to_copy;
@@ -123,6 +129,7 @@ struct MessageState {
   std::vector<uint8_t> request_data;
   size_t request_data_read_pos{0};
   std::vector<uint8_t> response_data;
+  std::shared_ptr<BulkDataRegion> bulk_data;
 };
 
 }  // anonymous namespace
@@ -494,6 +501,26 @@ int32_t Endpoint::GetChannelId(const BorrowedHandle& channel_fd) {
   return (iter != channel_fd_to_id_.end()) ? iter->second : -1;
 }
 
+Status<std::shared_ptr<BulkDataRegion>> Endpoint::GetChannelBulkData(
+    int32_t channel_id, LocalHandle bulk_data_fd) {
+  std::shared_ptr<BulkDataRegion> bulk_data;
+  if (bulk_data_fd) {
+    // Map outside of the lock; messages in flight keep using the old region.
+    bulk_data = std::make_shared<BulkDataRegion>();
+    auto status = bulk_data->Map(std::move(bulk_data_fd));
+    if (!status)
+      return status.error_status();
+  }
+
+  std::lock_guard<std::mutex> autolock(channel_mutex_);
+  auto channel_data = channels_.find(channel_id);
+  if (channel_data == channels_.end())
+    return bulk_data;
+  if (bulk_data)
+    channel_data->second.bulk_data = bulk_data;
+  return channel_data->second.bulk_data;
+}
+
 Status<void> Endpoint::ReceiveMessageForChannel(
     const BorrowedHandle& channel_fd, Message* message) {
   RequestHeader<LocalHandle> request;
@@ -535,7 +562,27 @@ Status<void> Endpoint::ReceiveMessageForChannel(
   *message = Message{info};
   auto* state = static_cast<MessageState*>(message->GetState());
   state->request = std::move(request);
-  if (state->request.send_len > 0 && !state->request.is_impulse) {
+  if (!state->request.is_impulse) {
+    auto bulk_data_status = GetChannelBulkData(
+        channel_id, std::move(state->request.bulk_data_fd));
+    if (bulk_data_status)
+      state->bulk_data = bulk_data_status.take();
+    else
+      status.SetError(bulk_data_status.error());
+  }
+
+  if (status && state->request.is_bulk_data) {
+    if (!state->bulk_data ||
+        state->request.send_len > state->bulk_data->size()) {
+      ALOGE(
+          "Endpoint::ReceiveMessageForChannel: Request payload does not fit "
+          "the bulk data region of channel %d",
+          channel_id);
+      state->request.is_bulk_data = false;
+      status.SetError(EIO);
+    }
+  } else if (status && state->request.send_len > 0 &&
+             !state->request.is_impulse) {
     state->request_data.resize(state->request.send_len);
     status = ReceiveData(channel_fd, state->request_data.data(),
                          state->request_data.size());
@@ -645,8 +692,19 @@ Status<void> Endpoint::MessageReply(Message* message, int return_code) {
 
   state->response.ret_code = return_code;
   state->response.recv_len = state->response_data.size();
+  // The client is waiting for the reply and done with the region, so the
+  // response can overwrite the request payload.
+  state->response.is_bulk_data =
+      state->bulk_data &&
+      state->response_data.size() >= kBulkDataThreshold &&
+      state->response_data.size() <= state->bulk_data->size();
+  if (state->response.is_bulk_data) {
+    memcpy(state->bulk_data->data(), state->response_data.data(),
+           state->response_data.size());
+  }
   auto status = SendData(channel_socket, state->response);
-  if (status && !state->response_data.empty()) {
+  if (status && !state->response_data.empty() &&
+      !state->response.is_bulk_data) {
     status = SendData(channel_socket, state->response_data.data(),
                       state->response_data.size());
   }
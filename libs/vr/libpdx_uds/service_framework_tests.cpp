@@ -5,12 +5,15 @@
 #include <sys/eventfd.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <functional>
 #include <memory>
 #include <numeric>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <pdx/channel_handle.h>
@@ -65,6 +68,7 @@ enum test_op_codes {
   TEST_OP_POLLHUP_FROM_SERVICE,
   TEST_OP_POLLIN_FROM_SERVICE,
   TEST_OP_SEND_LARGE_DATA_RETURN_SUM,
+  TEST_OP_NEGATE_LARGE_DATA,
 };
 
 using ImpulsePayload = std::array<std::uint8_t, sizeof(MessageInfo::impulse)>;
@@ -222,6 +226,20 @@ class TestService : public ServiceBase<TestService> {
         REPLY_MESSAGE_RETURN(message, sum, {});
       }
 
+      case TEST_OP_NEGATE_LARGE_DATA: {
+        std::vector<int> data(message.GetSendLength() / sizeof(int));
+        size_t size = data.size() * sizeof(int);
+        if (!message.ReadAll(data.data(), size)) {
+          REPLY_ERROR_RETURN(message, EIO, {});
+        }
+        std::transform(data.begin(), data.end(), data.begin(),
+                       std::negate<int>());
+        if (!message.WriteAll(data.data(), size)) {
+          REPLY_ERROR_RETURN(message, EIO, {});
+        }
+        REPLY_MESSAGE_RETURN(message, 0, {});
+      }
+
       default:
         return Service::DefaultHandleMessage(message);
     }
@@ -381,6 +399,14 @@ class TestClient : public ClientBase<TestClient> {
                         data_array.size() * sizeof(int), nullptr, 0));
   }
 
+  int NegateLargeData(std::vector<int>* data) {
+    Transaction trans{*this};
+    return ReturnStatusOrError(
+        trans.Send<int>(TEST_OP_NEGATE_LARGE_DATA, data->data(),
+                        data->size() * sizeof(int), data->data(),
+                        data->size() * sizeof(int)));
+  }
+
   Status<int> GetEventMask(int events) {
     if (auto* client_channel = GetChannel()) {
       return client_channel->GetEventMask(events);
@@ -695,6 +721,27 @@ TEST_F(ServiceFrameworkTest, LargeDataSum) {
   ASSERT_EQ(expected_sum, sum);
 }
 
+TEST_F(ServiceFrameworkTest, LargeDataRoundTrip) {
+  // Create a test service and add it to the dispatcher.
+  auto service = TestService::Create(kTestService1);
+  ASSERT_NE(nullptr, service);
+  ASSERT_EQ(0, dispatcher_->AddService(service));
+
+  // Create a client to service.
+  auto client = TestClient::Create(kTestService1);
+  ASSERT_NE(nullptr, client);
+
+  // Both below and above kBulkDataThreshold, and growing the client's bulk
+  // data region between messages.
+  for (size_t count : {1000u, 20000u, 30000u, 100000u}) {
+    std::vector<int> data(count);
+    std::iota(data.begin(), data.end(), 0);
+    ASSERT_EQ(0, client->NegateLargeData(&data));
+    for (size_t i = 0; i < count; i++)
+      ASSERT_EQ(-static_cast<int>(i), data[i]);
+  }
+}
+
 TEST_F(ServiceFrameworkTest, Cancel) {
   // Create a test service and add it to the dispatcher.
   auto service = TestService::Create(kTestService1, nullptr, true);
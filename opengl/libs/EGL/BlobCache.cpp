@@ -23,7 +23,7 @@
 #include <inttypes.h>
 #include <log/log.h>
 
-#include <chrono>
+#include <algorithm>
 
 namespace android {
 
@@ -31,7 +31,7 @@ namespace android {
 static const uint32_t blobCacheMagic = ('_' << 24) + ('B' << 16) + ('b' << 8) + '$';
 
 // BlobCache::Header::mBlobCacheVersion value
-static const uint32_t blobCacheVersion = 3;
+static const uint32_t blobCacheVersion = 4;
 
 // BlobCache::Header::mDeviceVersion value
 static const uint32_t blobCacheDeviceVersion = 1;
@@ -40,19 +40,15 @@ BlobCache::BlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize
       : mMaxTotalSize(maxTotalSize),
         mMaxKeySize(maxKeySize),
         mMaxValueSize(maxValueSize),
-        mTotalSize(0) {
-    int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
-#ifdef _WIN32
-    srand(now);
-#else
-    mRandState[0] = (now >> 0) & 0xFFFF;
-    mRandState[1] = (now >> 16) & 0xFFFF;
-    mRandState[2] = (now >> 32) & 0xFFFF;
-#endif
-    ALOGV("initializing random seed using %lld", (unsigned long long)now);
-}
+        mTotalSize(0),
+        mAccessClock(0) {}
 
 void BlobCache::set(const void* key, size_t keySize, const void* value, size_t valueSize) {
+    set(key, keySize, value, valueSize, true);
+}
+
+void BlobCache::set(const void* key, size_t keySize, const void* value, size_t valueSize,
+                    bool copyData) {
     if (mMaxKeySize < keySize) {
         ALOGV("set: not caching because the key is too large: %zu (limit: %zu)", keySize,
               mMaxKeySize);
@@ -85,8 +81,8 @@ void BlobCache::set(const void* key, size_t keySize, const void* value, size_t v
         auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), cacheEntry);
         if (index == mCacheEntries.end() || cacheEntry < *index) {
             // Create a new cache entry.
-            std::shared_ptr<Blob> keyBlob(new Blob(key, keySize, true));
-            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
+            std::shared_ptr<Blob> keyBlob(new Blob(key, keySize, copyData));
+            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, copyData));
             size_t newTotalSize = mTotalSize + keySize + valueSize;
             if (mMaxTotalSize < newTotalSize) {
                 if (isCleanable()) {
@@ -101,13 +97,14 @@ void BlobCache::set(const void* key, size_t keySize, const void* value, size_t v
                     break;
                 }
             }
-            mCacheEntries.insert(index, CacheEntry(keyBlob, valueBlob));
+            index = mCacheEntries.insert(index, CacheEntry(keyBlob, valueBlob));
+            index->recordAccess(++mAccessClock);
             mTotalSize = newTotalSize;
             ALOGV("set: created new cache entry with %zu byte key and %zu byte value", keySize,
                   valueSize);
         } else {
             // Update the existing cache entry.
-            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
+            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, copyData));
             std::shared_ptr<Blob> oldValueBlob(index->getValue());
             size_t newTotalSize = mTotalSize + valueSize - oldValueBlob->getSize();
             if (mMaxTotalSize < newTotalSize) {
@@ -123,6 +120,7 @@ void BlobCache::set(const void* key, size_t keySize, const void* value, size_t v
                 }
             }
             index->setValue(valueBlob);
+            index->recordAccess(++mAccessClock);
             mTotalSize = newTotalSize;
             ALOGV("set: updated existing cache entry with %zu byte key and %zu byte "
                   "value",
@@ -143,8 +141,10 @@ size_t BlobCache::get(const void* key, size_t keySize, void* value, size_t value
     auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), cacheEntry);
     if (index == mCacheEntries.end() || cacheEntry < *index) {
         ALOGV("get: no cache entry found for key of size %zu", keySize);
+        mStats.misses++;
         return 0;
     }
+    mStats.hits++;
 
     // The key was found. Return the value if the caller's buffer is large
     // enough.
@@ -153,6 +153,9 @@ size_t BlobCache::get(const void* key, size_t keySize, void* value, size_t value
     if (valueBlobSize <= valueSize) {
         ALOGV("get: copying %zu bytes to caller's buffer", valueBlobSize);
         memcpy(value, valueBlob->getData(), valueBlobSize);
+        // Only count the accesses that return the value, since callers may
+        // query the size of the value first.
+        index->recordAccess(++mAccessClock);
     } else {
         ALOGV("get: caller's buffer is too small for value: %zu (needs %zu)", valueSize,
               valueBlobSize);
@@ -209,6 +212,8 @@ int BlobCache::flatten(void* buffer, size_t size) const {
         EntryHeader* eheader = reinterpret_cast<EntryHeader*>(&byteBuffer[byteOffset]);
         eheader->mKeySize = keySize;
         eheader->mValueSize = valueSize;
+        eheader->mAccessCount = e.getAccessCount();
+        eheader->mLastAccess = e.getLastAccess();
 
         memcpy(eheader->mData, keyBlob->getData(), keySize);
         memcpy(eheader->mData + keySize, valueBlob->getData(), valueSize);
@@ -226,8 +231,12 @@ int BlobCache::flatten(void* buffer, size_t size) const {
 }
 
 int BlobCache::unflatten(void const* buffer, size_t size) {
+    return unflatten(buffer, size, true);
+}
+
+int BlobCache::unflatten(void const* buffer, size_t size, bool copyData) {
     // All errors should result in the BlobCache being in an empty state.
-    mCacheEntries.clear();
+    clear();
 
     // Read the cache header
     if (size < sizeof(Header)) {
@@ -272,7 +281,15 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
         }
 
         const uint8_t* data = eheader->mData;
-        set(data, keySize, data + keySize, valueSize);
+        set(data, keySize, data + keySize, valueSize, copyData);
+
+        // Restore the access metadata that set just reset.
+        CacheEntry cacheEntry(std::make_shared<Blob>(data, keySize, false), nullptr);
+        auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), cacheEntry);
+        if (index != mCacheEntries.end() && !(cacheEntry < *index)) {
+            index->setAccess(eheader->mAccessCount, eheader->mLastAccess);
+            mAccessClock = std::max(mAccessClock, eheader->mLastAccess);
+        }
 
         byteOffset += totalSize;
     }
@@ -280,23 +297,69 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     return 0;
 }
 
-long int BlobCache::blob_random() {
-#ifdef _WIN32
-    return rand();
-#else
-    return nrand48(mRandState);
-#endif
+void BlobCache::forEachEntry(const EntryVisitor& visitor) const {
+    for (const CacheEntry& e : mCacheEntries) {
+        std::shared_ptr<Blob> const& keyBlob = e.getKey();
+        std::shared_ptr<Blob> const& valueBlob = e.getValue();
+        visitor(keyBlob->getData(), keyBlob->getSize(), valueBlob->getData(),
+                valueBlob->getSize());
+    }
+}
+
+bool BlobCache::relocateValue(const void* key, size_t keySize, const void* value) {
+    std::shared_ptr<Blob> cacheKey(new Blob(key, keySize, false));
+    CacheEntry cacheEntry(cacheKey, nullptr);
+    auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), cacheEntry);
+    if (index == mCacheEntries.end() || cacheEntry < *index) {
+        return false;
+    }
+    size_t valueSize = index->getValue()->getSize();
+    index->setValue(std::make_shared<Blob>(value, valueSize, false));
+    return true;
 }
 
 void BlobCache::clean() {
-    // Remove a random cache entry until the total cache size gets below half
-    // the maximum total cache size.
-    while (mTotalSize > mMaxTotalSize / 2) {
-        size_t i = size_t(blob_random() % (mCacheEntries.size()));
-        const CacheEntry& entry(mCacheEntries[i]);
+    // Order the entries from the first to evict to the last: entries used only
+    // once before entries used several times, and the least recently used
+    // first within each group.
+    std::vector<size_t> order(mCacheEntries.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](size_t lhs, size_t rhs) {
+        const CacheEntry& l = mCacheEntries[lhs];
+        const CacheEntry& r = mCacheEntries[rhs];
+        const bool lFrequent = l.getAccessCount() > 1;
+        const bool rFrequent = r.getAccessCount() > 1;
+        if (lFrequent != rFrequent) {
+            return rFrequent;
+        }
+        return l.getLastAccess() < r.getLastAccess();
+    });
+
+    // Evict entries until the total cache size gets below half the maximum
+    // total cache size.
+    std::vector<bool> evicted(mCacheEntries.size(), false);
+    for (size_t i = 0; i < order.size() && mTotalSize > mMaxTotalSize / 2; i++) {
+        const CacheEntry& entry(mCacheEntries[order[i]]);
         mTotalSize -= entry.getKey()->getSize() + entry.getValue()->getSize();
-        mCacheEntries.erase(mCacheEntries.begin() + i);
+        evicted[order[i]] = true;
+        mStats.evictions++;
     }
+
+    size_t next = 0;
+    for (size_t i = 0; i < mCacheEntries.size(); i++) {
+        if (evicted[i]) {
+            continue;
+        }
+        CacheEntry& entry = mCacheEntries[i];
+        entry.setAccess(std::max(entry.getAccessCount() / 2, 1u), entry.getLastAccess());
+        if (next != i) {
+            mCacheEntries[next] = entry;
+        }
+        next++;
+    }
+    mCacheEntries.resize(next);
 }
 
 bool BlobCache::isCleanable() const {
@@ -332,13 +395,17 @@ size_t BlobCache::Blob::getSize() const {
     return mSize;
 }
 
-BlobCache::CacheEntry::CacheEntry() {}
+BlobCache::CacheEntry::CacheEntry() : mAccessCount(0), mLastAccess(0) {}
 
 BlobCache::CacheEntry::CacheEntry(const std::shared_ptr<Blob>& key,
                                   const std::shared_ptr<Blob>& value)
-      : mKey(key), mValue(value) {}
+      : mKey(key), mValue(value), mAccessCount(0), mLastAccess(0) {}
 
-BlobCache::CacheEntry::CacheEntry(const CacheEntry& ce) : mKey(ce.mKey), mValue(ce.mValue) {}
+BlobCache::CacheEntry::CacheEntry(const CacheEntry& ce)
+      : mKey(ce.mKey),
+        mValue(ce.mValue),
+        mAccessCount(ce.mAccessCount),
+        mLastAccess(ce.mLastAccess) {}
 
 bool BlobCache::CacheEntry::operator<(const CacheEntry& rhs) const {
     return *mKey < *rhs.mKey;
@@ -347,6 +414,8 @@ bool BlobCache::CacheEntry::operator<(const CacheEntry& rhs) const {
 const BlobCache::CacheEntry& BlobCache::CacheEntry::operator=(const CacheEntry& rhs) {
     mKey = rhs.mKey;
     mValue = rhs.mValue;
+    mAccessCount = rhs.mAccessCount;
+    mLastAccess = rhs.mLastAccess;
     return *this;
 }
 
@@ -362,4 +431,16 @@ void BlobCache::CacheEntry::setValue(const std::shared_ptr<Blob>& value) {
     mValue = value;
 }
 
+void BlobCache::CacheEntry::recordAccess(uint64_t now) {
+    if (mAccessCount < UINT32_MAX) {
+        mAccessCount++;
+    }
+    mLastAccess = now;
+}
+
+void BlobCache::CacheEntry::setAccess(uint32_t accessCount, uint64_t lastAccess) {
+    mAccessCount = accessCount;
+    mLastAccess = lastAccess;
+}
+
 } // namespace android
@@ -18,7 +18,9 @@
 #define ANDROID_BLOB_CACHE_H
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -31,6 +33,11 @@ namespace android {
 // and then reloaded in a subsequent execution of the program.  This
 // serialization is non-portable and the data should only be used by the device
 // that generated it.
+//
+// When the cache is full, entries that were only used once are evicted before
+// entries that were used several times, and the least recently used go first
+// within each group.  How often and how recently each entry was used is kept
+// in the serialized cache.
 class BlobCache {
 public:
     // Create an empty blob cache. The blob cache will cache key/value pairs
@@ -97,7 +104,25 @@ public:
 
     // clear flushes out all contents of the cache then the BlobCache, leaving
     // it in an empty state.
-    void clear() { mCacheEntries.clear(); }
+    void clear() {
+        mCacheEntries.clear();
+        mTotalSize = 0;
+    }
+
+    // Stats counts the lookups and evictions of the cache since it was
+    // created.
+    struct Stats {
+        // hits is the number of calls to get that found the key.
+        uint64_t hits = 0;
+
+        // misses is the number of calls to get that didn't find the key.
+        uint64_t misses = 0;
+
+        // evictions is the number of entries removed to make room for others.
+        uint64_t evictions = 0;
+    };
+
+    const Stats& getStats() const { return mStats; }
 
 protected:
     // mMaxTotalSize is the maximum size that all cache entries can occupy. This
@@ -107,16 +132,35 @@ protected:
     // will be evicted from the cache to make room for the new entry.
     const size_t mMaxTotalSize;
 
+    // set and unflatten behave like the public methods of the same name, but
+    // when copyData is false the cache keeps pointers to the given key and
+    // value data instead of copying it.  The data must then stay valid until
+    // the entry is evicted or the cache is cleared.
+    void set(const void* key, size_t keySize, const void* value, size_t valueSize,
+             bool copyData);
+    int unflatten(void const* buffer, size_t size, bool copyData);
+
+    // forEachEntry calls visitor with the key and value data of every entry in
+    // the cache, in key order.
+    using EntryVisitor = std::function<void(const void* key, size_t keySize, const void* value,
+                                            size_t valueSize)>;
+    void forEachEntry(const EntryVisitor& visitor) const;
+
+    // relocateValue makes the entry for the given key point at 'value', which
+    // must hold a copy of the current value of the entry and stay valid like
+    // the data passed to set with copyData false.  The access history of the
+    // entry is unchanged.  Returns false if the key is not in the cache.
+    bool relocateValue(const void* key, size_t keySize, const void* value);
+
 private:
     // Copying is disallowed.
     BlobCache(const BlobCache&);
     void operator=(const BlobCache&);
 
-    // A random function helper to get around MinGW not having nrand48()
-    long int blob_random();
-
-    // clean evicts a randomly chosen set of entries from the cache such that
-    // the total size of all remaining entries is less than mMaxTotalSize/2.
+    // clean evicts the entries with the fewest and oldest accesses from the
+    // cache such that the total size of all remaining entries is less than
+    // mMaxTotalSize/2.  The access counts of the remaining entries are then
+    // halved, so that entries which stopped being used can eventually go.
     void clean();
 
     // isCleanable returns true if the cache is full enough for the clean method
@@ -165,12 +209,27 @@ private:
 
         void setValue(const std::shared_ptr<Blob>& value);
 
+        uint32_t getAccessCount() const { return mAccessCount; }
+        uint64_t getLastAccess() const { return mLastAccess; }
+
+        // recordAccess counts an access to the entry at logical time 'now'.
+        void recordAccess(uint64_t now);
+        void setAccess(uint32_t accessCount, uint64_t lastAccess);
+
     private:
         // mKey is the key that identifies the cache entry.
         std::shared_ptr<Blob> mKey;
 
         // mValue is the cached data associated with the key.
         std::shared_ptr<Blob> mValue;
+
+        // mAccessCount is the number of times the entry was set or read,
+        // halved each time the cache is cleaned.
+        uint32_t mAccessCount;
+
+        // mLastAccess is the value of BlobCache::mAccessClock when the entry
+        // was last set or read.
+        uint64_t mLastAccess;
     };
 
     // A Header is the header for the entire BlobCache serialization format. No
@@ -214,6 +273,11 @@ private:
         // mValueSize is the size of the entry value in bytes.
         size_t mValueSize;
 
+        // mAccessCount and mLastAccess are the access metadata of the entry,
+        // used to choose which entries to evict.
+        uint32_t mAccessCount;
+        uint64_t mLastAccess;
+
         // mData contains both the key and value data for the cache entry.  The
         // key comes first followed immediately by the value.
         uint8_t mData[];
@@ -233,9 +297,12 @@ private:
     // the cache.
     size_t mTotalSize;
 
-    // mRandState is the pseudo-random number generator state. It is passed to
-    // nrand48 to generate random numbers when needed.
-    unsigned short mRandState[3];
+    // mAccessClock is a logical clock, advanced on each access to an entry.
+    // It orders the accesses to the entries for eviction.
+    uint64_t mAccessClock;
+
+    // mStats counts the lookups and evictions of the cache.
+    Stats mStats;
 
     // mCacheEntries stores all the cache entries that are resident in memory.
     // Cache entries are added to it by the 'set' method.
@@ -261,6 +261,55 @@ TEST_F(BlobCacheTest, ExceedingTotalLimitHalvesCacheSize) {
     ASSERT_EQ(maxEntries / 2 + 1, numCached);
 }
 
+TEST_F(BlobCacheTest, CleanKeepsFrequentlyUsedEntries) {
+    // Fill up the entire cache with 1 char key/value pairs.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // Use the first entries several times.
+    const int numHot = maxEntries / 4;
+    for (int i = 0; i < numHot; i++) {
+        uint8_t k = i;
+        char v;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, &v, 1));
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, &v, 1));
+    }
+    // Insert one more entry, causing a cache overflow.
+    {
+        uint8_t k = maxEntries;
+        mBC->set(&k, 1, "x", 1);
+    }
+    for (int i = 0; i < numHot; i++) {
+        uint8_t k = i;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, nullptr, 0));
+    }
+    // The entries used once were evicted oldest first.
+    {
+        uint8_t k = numHot;
+        ASSERT_EQ(size_t(0), mBC->get(&k, 1, nullptr, 0));
+        k = maxEntries - 1;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, nullptr, 0));
+    }
+}
+
+TEST_F(BlobCacheTest, StatsCountHitsMissesAndEvictions) {
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries + 1; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    for (int i = 0; i < maxEntries + 1; i++) {
+        uint8_t k = i;
+        mBC->get(&k, 1, nullptr, 0);
+    }
+    const int numCached = maxEntries / 2 + 1;
+    ASSERT_EQ(uint64_t(numCached), mBC->getStats().hits);
+    ASSERT_EQ(uint64_t(maxEntries + 1 - numCached), mBC->getStats().misses);
+    ASSERT_EQ(uint64_t(maxEntries + 1 - numCached), mBC->getStats().evictions);
+}
+
 class BlobCacheFlattenTest : public BlobCacheTest {
 protected:
     virtual void SetUp() {
@@ -314,6 +363,28 @@ TEST_F(BlobCacheFlattenTest, FlattenFullCache) {
     }
 }
 
+TEST_F(BlobCacheFlattenTest, FlattenKeepsAccessHistory) {
+    // Fill up the entire cache with 1 char key/value pairs, and use the
+    // first one several times.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, &k, 1);
+    }
+    uint8_t hot = 0;
+    uint8_t v;
+    ASSERT_EQ(size_t(1), mBC->get(&hot, 1, &v, 1));
+    ASSERT_EQ(size_t(1), mBC->get(&hot, 1, &v, 1));
+
+    roundTrip();
+
+    // Overflowing the deserialized cache keeps the frequently used entry.
+    uint8_t k = maxEntries;
+    mBC2->set(&k, 1, &k, 1);
+    ASSERT_EQ(size_t(1), mBC2->get(&hot, 1, &v, 1));
+    ASSERT_EQ(hot, v);
+}
+
 TEST_F(BlobCacheFlattenTest, FlattenDoesntChangeCache) {
     // Fill up the entire cache with 1 char key/value pairs.
     const int maxEntries = MAX_TOTAL_SIZE / 2;
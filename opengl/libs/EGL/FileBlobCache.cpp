@@ -19,21 +19,49 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <stddef.h>
+#include <sys/file.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <memory>
+
 #include <log/log.h>
 
 // Cache file header
 static const char* cacheFileMagic = "EGL$";
-static const size_t cacheFileHeaderSize = 8;
+static const uint32_t cacheFileVersion = 2;
 
 namespace android {
 
-static uint32_t crc32c(const uint8_t* buf, size_t len) {
+// A FileHeader is at the start of the cache file.  It is followed by
+// mBaseSize bytes of flattened BlobCache contents, and then by mLogSize bytes
+// of entries appended since the file was written.  Bytes past the log are
+// from an append that didn't complete, and are ignored.
+struct FileHeader {
+    char mMagic[4];
+    uint32_t mVersion;
+    uint64_t mBaseSize;
+    uint64_t mLogSize;
+
+    // mCrc is the CRC of the fields above.
+    uint32_t mCrc;
+};
+
+// An EntryRecord starts each entry in the log.  It is followed by the key and
+// the value data, padded to 4 bytes.
+struct EntryRecord {
+    uint32_t mKeySize;
+    uint32_t mValueSize;
+
+    // mCrc is the CRC of the sizes and of the key data.  The value data isn't
+    // checked when loading the cache, so that it never needs to be read in.
+    uint32_t mCrc;
+};
+
+static uint32_t crc32c(const uint8_t* buf, size_t len, uint32_t r = 0) {
     const uint32_t polyBits = 0x82F63B78;
-    uint32_t r = 0;
     for (size_t i = 0; i < len; i++) {
         r ^= buf[i];
         for (int j = 0; j < 8; j++) {
@@ -47,14 +75,54 @@ static uint32_t crc32c(const uint8_t* buf, size_t len) {
     return r;
 }
 
+static inline size_t align4(size_t size) {
+    return (size + 3) & ~3;
+}
+
+static inline size_t recordSize(size_t keySize, size_t valueSize) {
+    return align4(sizeof(EntryRecord) + keySize + valueSize);
+}
+
+static uint32_t headerCrc(const FileHeader& header) {
+    return crc32c(reinterpret_cast<const uint8_t*>(&header), offsetof(FileHeader, mCrc));
+}
+
+static uint32_t recordCrc(const EntryRecord& record, const void* key) {
+    uint32_t crc = crc32c(reinterpret_cast<const uint8_t*>(&record),
+            offsetof(EntryRecord, mCrc));
+    return crc32c(reinterpret_cast<const uint8_t*>(key), record.mKeySize, crc);
+}
+
+static bool isValidHeader(const FileHeader& header, size_t fileSize) {
+    if (memcmp(header.mMagic, cacheFileMagic, 4) != 0) {
+        ALOGE("cache file has bad mojo");
+        return false;
+    }
+    if (header.mVersion != cacheFileVersion) {
+        // The file was written by an older version, treat it as empty.
+        return false;
+    }
+    if (headerCrc(header) != header.mCrc) {
+        ALOGE("cache file failed CRC check");
+        return false;
+    }
+    if (header.mBaseSize > fileSize || header.mLogSize > fileSize ||
+            sizeof(FileHeader) + header.mBaseSize + header.mLogSize > fileSize) {
+        ALOGE("cache file is truncated");
+        return false;
+    }
+    return true;
+}
+
 FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
         const std::string& filename)
         : BlobCache(maxKeySize, maxValueSize, maxTotalSize)
-        , mFilename(filename) {
+        , mFilename(filename)
+        , mFileDev(0)
+        , mFileIno(0)
+        , mFileMode(S_IRUSR | S_IWUSR) {
     if (mFilename.length() > 0) {
-        size_t headerSize = cacheFileHeaderSize;
-
-        int fd = open(mFilename.c_str(), O_RDONLY, 0);
+        int fd = open(mFilename.c_str(), O_RDONLY | O_CLOEXEC, 0);
         if (fd == -1) {
             if (errno != ENOENT) {
                 ALOGE("error opening cache file %s: %s (%d)", mFilename.c_str(),
@@ -78,111 +146,299 @@ FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxT
             close(fd);
             return;
         }
-
-        uint8_t* buf = reinterpret_cast<uint8_t*>(mmap(nullptr, fileSize,
-                PROT_READ, MAP_PRIVATE, fd, 0));
-        if (buf == MAP_FAILED) {
-            ALOGE("error mmaping cache file: %s (%d)", strerror(errno),
-                    errno);
+        if (fileSize < sizeof(FileHeader)) {
+            ALOGE("cache file is too small: %zu", fileSize);
             close(fd);
             return;
         }
 
-        // Check the file magic and CRC
-        size_t cacheSize = fileSize - headerSize;
-        if (memcmp(buf, cacheFileMagic, 4) != 0) {
-            ALOGE("cache file has bad mojo");
+        const uint8_t* buf = mapFile(fd, 0, fileSize);
+        if (buf == nullptr) {
             close(fd);
             return;
         }
-        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
-        if (crc32c(buf + headerSize, cacheSize) != *crc) {
-            ALOGE("cache file failed CRC check");
-            close(fd);
+        setFileIdentity(fd);
+        close(fd);
+
+        // Only the header is copied, as other processes may append to the
+        // file and update it.
+        FileHeader header;
+        memcpy(&header, buf, sizeof(header));
+        if (!isValidHeader(header, fileSize)) {
+            unmapOldFiles(0);
             return;
         }
 
-        int err = unflatten(buf + headerSize, cacheSize);
+        // The entries point into the mapping, so that only the pages that
+        // are actually looked up get read from the file.
+        const uint8_t* base = buf + sizeof(FileHeader);
+        int err = unflatten(base, header.mBaseSize, false);
         if (err < 0) {
             ALOGE("error reading cache contents: %s (%d)", strerror(-err),
                     -err);
-            munmap(buf, fileSize);
-            close(fd);
+            unmapOldFiles(0);
             return;
         }
 
-        munmap(buf, fileSize);
-        close(fd);
+        // Replay the log in order, so that later entries replace earlier ones
+        // with the same key.
+        const uint8_t* log = base + header.mBaseSize;
+        size_t offset = 0;
+        while (offset + sizeof(EntryRecord) <= header.mLogSize) {
+            EntryRecord record;
+            memcpy(&record, log + offset, sizeof(record));
+            const uint8_t* key = log + offset + sizeof(EntryRecord);
+            size_t size = recordSize(record.mKeySize, record.mValueSize);
+            if (record.mKeySize > header.mLogSize || record.mValueSize > header.mLogSize ||
+                    offset + size > header.mLogSize || recordCrc(record, key) != record.mCrc) {
+                ALOGE("cache file has a bad entry at %zu, ignoring the rest of the log",
+                        offset);
+                break;
+            }
+            set(key, record.mKeySize, key + record.mKeySize, record.mValueSize, false);
+            offset += size;
+        }
     }
 }
 
-void FileBlobCache::writeToFile() {
-    if (mFilename.length() > 0) {
-        size_t cacheSize = getFlattenedSize();
-        size_t headerSize = cacheFileHeaderSize;
-        const char* fname = mFilename.c_str();
+FileBlobCache::~FileBlobCache() {
+    // The entries may point into the mappings.
+    clear();
+    unmapOldFiles(0);
+}
 
-        // Try to create the file with no permissions so we can write it
-        // without anyone trying to read it.
-        int fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
-        if (fd == -1) {
-            if (errno == EEXIST) {
-                // The file exists, delete it and try again.
-                if (unlink(fname) == -1) {
-                    // No point in retrying if the unlink failed.
-                    ALOGE("error unlinking cache file %s: %s (%d)", fname,
-                            strerror(errno), errno);
-                    return;
-                }
-                // Retry now that we've unlinked the file.
-                fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
-            }
-            if (fd == -1) {
-                ALOGE("error creating cache file %s: %s (%d)", fname,
-                        strerror(errno), errno);
-                return;
-            }
+const uint8_t* FileBlobCache::mapFile(int fd, size_t offset, size_t size) {
+    // mmap offsets must be page aligned.
+    size_t pageOffset = offset % sysconf(_SC_PAGE_SIZE);
+    size_t mapSize = pageOffset + size;
+    void* addr = mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, fd, offset - pageOffset);
+    if (addr == MAP_FAILED) {
+        ALOGE("error mmaping cache file: %s (%d)", strerror(errno),
+                errno);
+        return nullptr;
+    }
+    mMappings.push_back({addr, mapSize});
+    return reinterpret_cast<const uint8_t*>(addr) + pageOffset;
+}
+
+bool FileBlobCache::isMapped(const void* data) const {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    for (const Mapping& m : mMappings) {
+        const uint8_t* addr = reinterpret_cast<const uint8_t*>(m.mAddr);
+        if (p >= addr && p < addr + m.mSize) {
+            return true;
         }
+    }
+    return false;
+}
+
+void FileBlobCache::unmapOldFiles(size_t keep) {
+    if (mMappings.size() <= keep) {
+        return;
+    }
+    auto end = mMappings.end() - keep;
+    for (auto it = mMappings.begin(); it != end; ++it) {
+        munmap(it->mAddr, it->mSize);
+    }
+    mMappings.erase(mMappings.begin(), end);
+}
 
-        size_t fileSize = headerSize + cacheSize;
+void FileBlobCache::setFileIdentity(int fd) {
+    struct stat statBuf;
+    if (fstat(fd, &statBuf) == 0) {
+        mFileDev = statBuf.st_dev;
+        mFileIno = statBuf.st_ino;
+    }
+}
 
-        uint8_t* buf = new uint8_t [fileSize];
-        if (!buf) {
-            ALOGE("error allocating buffer for cache contents: %s (%d)",
-                    strerror(errno), errno);
-            close(fd);
-            unlink(fname);
+bool FileBlobCache::isSameFile(int fd) const {
+    struct stat statBuf;
+    return fstat(fd, &statBuf) == 0 && statBuf.st_dev == mFileDev &&
+            statBuf.st_ino == mFileIno;
+}
+
+void FileBlobCache::writeToFile() {
+    if (mFilename.length() > 0) {
+        // The entries that point into the file mappings are already in the
+        // file, the others need to be written.
+        std::vector<PendingEntry> pending;
+        forEachEntry([&](const void* key, size_t keySize, const void* value, size_t valueSize) {
+            if (!isMapped(value)) {
+                pending.push_back({key, keySize, value, valueSize});
+            }
+        });
+        if (pending.empty()) {
             return;
         }
 
-        int err = flatten(buf + headerSize, cacheSize);
-        if (err < 0) {
-            ALOGE("error writing cache contents: %s (%d)", strerror(-err),
-                    -err);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
-            return;
+        if (mMappings.empty() || !appendToFile(pending)) {
+            rewriteFile();
         }
+    }
+}
+
+bool FileBlobCache::appendToFile(const std::vector<PendingEntry>& entries) {
+    const char* fname = mFilename.c_str();
+    int fd = open(fname, O_RDWR | O_CLOEXEC, 0);
+    if (fd == -1) {
+        return false;
+    }
+    // The file may have been replaced by another process since it was mapped.
+    if (!isSameFile(fd)) {
+        close(fd);
+        return false;
+    }
+    // Other processes using the same cache file may be appending to it too.
+    if (flock(fd, LOCK_EX) == -1) {
+        ALOGE("error locking cache file %s: %s (%d)", fname, strerror(errno), errno);
+        close(fd);
+        return false;
+    }
 
-        // Write the file magic and CRC
-        memcpy(buf, cacheFileMagic, 4);
-        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
-        *crc = crc32c(buf + headerSize, cacheSize);
+    bool appended = appendToFileLocked(fd, entries);
 
-        if (write(fd, buf, fileSize) == -1) {
-            ALOGE("error writing cache file: %s (%d)", strerror(errno),
-                    errno);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
-            return;
-        }
+    // The lock is held by the open file, which the new mapping keeps open
+    // after fd is closed, so it has to be released explicitly.
+    flock(fd, LOCK_UN);
+    close(fd);
+    return appended;
+}
+
+bool FileBlobCache::appendToFileLocked(int fd, const std::vector<PendingEntry>& entries) {
+    struct stat statBuf;
+    FileHeader header;
+    if (fstat(fd, &statBuf) == -1 ||
+            pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+            !isValidHeader(header, statBuf.st_size)) {
+        return false;
+    }
+
+    size_t appendSize = 0;
+    for (const PendingEntry& e : entries) {
+        appendSize += recordSize(e.mKeySize, e.mValueSize);
+    }
 
-        delete [] buf;
-        fchmod(fd, S_IRUSR);
+    // Rewrite the file instead once it would get too large to be loaded.  As
+    // the cache contents never exceed mMaxTotalSize, this leaves room for at
+    // least as much data to be appended before the next rewrite.
+    if (sizeof(FileHeader) + header.mBaseSize + header.mLogSize + appendSize >
+            mMaxTotalSize * 2) {
+        return false;
+    }
+
+    std::unique_ptr<uint8_t[]> buf(new uint8_t[appendSize]);
+    memset(buf.get(), 0, appendSize);
+    size_t offset = 0;
+    for (const PendingEntry& e : entries) {
+        EntryRecord record;
+        record.mKeySize = e.mKeySize;
+        record.mValueSize = e.mValueSize;
+        record.mCrc = recordCrc(record, e.mKey);
+        memcpy(buf.get() + offset, &record, sizeof(record));
+        memcpy(buf.get() + offset + sizeof(record), e.mKey, e.mKeySize);
+        memcpy(buf.get() + offset + sizeof(record) + e.mKeySize, e.mValue, e.mValueSize);
+        offset += recordSize(e.mKeySize, e.mValueSize);
+    }
+
+    // The entries must be on disk before the header includes them in the log,
+    // so that a crash can't leave the log pointing at garbage.
+    size_t logEnd = sizeof(FileHeader) + header.mBaseSize + header.mLogSize;
+    if (pwrite(fd, buf.get(), appendSize, logEnd) != static_cast<ssize_t>(appendSize) ||
+            fdatasync(fd) == -1) {
+        ALOGE("error appending to cache file: %s (%d)", strerror(errno), errno);
+        return true;
+    }
+    header.mLogSize += appendSize;
+    header.mCrc = headerCrc(header);
+    if (pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+        ALOGE("error writing cache file header: %s (%d)", strerror(errno), errno);
+        return true;
+    }
+
+    // Point the entries at the file, so that their copies in memory are freed
+    // and they aren't appended again.
+    const uint8_t* mapped = mapFile(fd, logEnd, appendSize);
+    if (mapped == nullptr) {
+        return true;
+    }
+    offset = 0;
+    for (const PendingEntry& e : entries) {
+        const uint8_t* key = mapped + offset + sizeof(EntryRecord);
+        relocateValue(e.mKey, e.mKeySize, key + e.mKeySize);
+        offset += recordSize(e.mKeySize, e.mValueSize);
+    }
+    return true;
+}
+
+void FileBlobCache::rewriteFile() {
+    size_t cacheSize = getFlattenedSize();
+    size_t headerSize = sizeof(FileHeader);
+    size_t fileSize = headerSize + cacheSize;
+
+    std::unique_ptr<uint8_t[]> buf(new uint8_t[fileSize]);
+    int err = flatten(buf.get() + headerSize, cacheSize);
+    if (err < 0) {
+        ALOGE("error writing cache contents: %s (%d)", strerror(-err),
+                -err);
+        return;
+    }
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.mMagic, cacheFileMagic, 4);
+    header.mVersion = cacheFileVersion;
+    header.mBaseSize = cacheSize;
+    header.mLogSize = 0;
+    header.mCrc = headerCrc(header);
+    memcpy(buf.get(), &header, sizeof(header));
+
+    // Write a new file and rename it over the old one, so that processes
+    // reading or appending to the old file are not affected.
+    std::string tmpName = mFilename + ".tmp" + std::to_string(getpid());
+    const char* tname = tmpName.c_str();
+    int fd = open(tname, O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        ALOGE("error creating cache file %s: %s (%d)", tname,
+                strerror(errno), errno);
+        return;
+    }
+    // The mode given to open is restricted by the umask.
+    if (mFileMode != (S_IRUSR | S_IWUSR)) {
+        fchmod(fd, mFileMode);
+    }
+
+    if (write(fd, buf.get(), fileSize) != static_cast<ssize_t>(fileSize) ||
+            fdatasync(fd) == -1) {
+        ALOGE("error writing cache file: %s (%d)", strerror(errno),
+                errno);
         close(fd);
+        unlink(tname);
+        return;
+    }
+    if (rename(tname, mFilename.c_str()) == -1) {
+        ALOGE("error renaming cache file %s: %s (%d)", tname,
+                strerror(errno), errno);
+        close(fd);
+        unlink(tname);
+        return;
+    }
+    buf.reset();
+
+    // Reload the cache from the new file, which frees the copies of the
+    // entries in memory and the mappings of the old file.
+    const uint8_t* mapped = mapFile(fd, 0, fileSize);
+    if (mapped == nullptr) {
+        close(fd);
+        return;
+    }
+    setFileIdentity(fd);
+    close(fd);
+    err = unflatten(mapped + headerSize, cacheSize, false);
+    if (err < 0) {
+        ALOGE("error reloading cache contents: %s (%d)", strerror(-err),
+                -err);
     }
+    unmapOldFiles(1);
 }
 
 }
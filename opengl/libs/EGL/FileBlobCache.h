@@ -18,24 +18,89 @@
 #define ANDROID_FILE_BLOB_CACHE_H
 
 #include "BlobCache.h"
+
+#include <sys/types.h>
+
 #include <string>
+#include <vector>
 
 namespace android {
 
+// The cache file holds the flattened BlobCache contents written when the file
+// was last compacted, followed by a log of the entries added since.  The file
+// is mmap'd and the cache entries point straight into the mapping, so loading
+// the cache doesn't copy any key or value data.
 class FileBlobCache : public BlobCache {
 public:
     // FileBlobCache attempts to load the saved cache contents from disk into
     // BlobCache.
     FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
             const std::string& filename);
+    ~FileBlobCache();
 
     // writeToFile attempts to save the current contents of BlobCache to
-    // disk.
+    // disk.  The entries that aren't in the file yet are appended to it, and
+    // the whole file is only rewritten once the evicted and replaced entries
+    // left in it would make it too large.
     void writeToFile();
 
+    // setFileMode sets the permissions that writeToFile gives to new cache
+    // files.  They default to being readable and writable by the owner only.
+    void setFileMode(mode_t mode) { mFileMode = mode; }
+
 private:
+    // A Mapping is a read-only mapping of a part of the cache file.
+    struct Mapping {
+        void* mAddr;
+        size_t mSize;
+    };
+
+    // mapFile maps 'size' bytes of fd starting at 'offset' and returns the
+    // address of the byte at 'offset', or nullptr on error.
+    const uint8_t* mapFile(int fd, size_t offset, size_t size);
+
+    // isMapped returns whether data points into one of the file mappings.
+    bool isMapped(const void* data) const;
+
+    // unmapOldFiles unmaps all but the last 'keep' mappings.
+    void unmapOldFiles(size_t keep);
+
+    // setFileIdentity remembers which file fd refers to, so writeToFile can
+    // tell whether the cache file was replaced since it was mapped.
+    void setFileIdentity(int fd);
+    bool isSameFile(int fd) const;
+
+    // A PendingEntry is a cache entry that isn't in the cache file yet.
+    struct PendingEntry {
+        const void* mKey;
+        size_t mKeySize;
+        const void* mValue;
+        size_t mValueSize;
+    };
+
+    // appendToFile appends the given entries to the log of the cache file,
+    // with appendToFileLocked doing the work once the file is locked.
+    // Returns false if the file needs to be rewritten instead.
+    bool appendToFile(const std::vector<PendingEntry>& entries);
+    bool appendToFileLocked(int fd, const std::vector<PendingEntry>& entries);
+
+    // rewriteFile replaces the cache file with one holding only the current
+    // contents of the cache, and remaps the entries to the new file.
+    void rewriteFile();
+
     // mFilename is the name of the file for storing cache contents.
     std::string mFilename;
+
+    // mMappings holds the mappings of the cache file that the cache entries
+    // may point into.
+    std::vector<Mapping> mMappings;
+
+    // mFileDev and mFileIno identify the cache file that was mapped.
+    dev_t mFileDev;
+    ino_t mFileIno;
+
+    // mFileMode is the permissions of new cache files.
+    mode_t mFileMode;
 };
 
 } // namespace android
@@ -115,7 +115,10 @@ int Loader::driver_t::set(void* hnd, int32_t api)
 }
 
 Loader::Loader()
-    : getProcAddress(nullptr)
+    : getProcAddress(nullptr),
+      gles1Pending(false),
+      gles1Dso(nullptr),
+      gles1GetProcAddress(nullptr)
 {
 }
 
@@ -174,6 +177,13 @@ static void uninit_api(char const* const* api, __eglMustCastToProperFunctionPoin
 void Loader::unload_system_driver(egl_connection_t* cnx) {
     ATRACE_CALL();
 
+    {
+        std::lock_guard<std::mutex> lock(gles1Mutex);
+        gles1Pending = false;
+        gles1Dso = nullptr;
+        gles1GetProcAddress = nullptr;
+    }
+
     uninit_api(gl_names,
                (__eglMustCastToProperFunctionPointerType*)&cnx
                        ->hooks[egl_connection_t::GLESv2_INDEX]
@@ -652,10 +662,11 @@ void Loader::initialize_api(void* dso, egl_connection_t* cnx, uint32_t mask) {
     }
 
     if (mask & GLESv1_CM) {
-        init_api(dso, gl_names_1, gl_names,
-            (__eglMustCastToProperFunctionPointerType*)
-                &cnx->hooks[egl_connection_t::GLESv1_INDEX]->gl,
-            getProcAddress);
+        // Deferred to init_gles1_api.
+        std::lock_guard<std::mutex> lock(gles1Mutex);
+        gles1Pending = true;
+        gles1Dso = dso;
+        gles1GetProcAddress = getProcAddress;
     }
 
     if (mask & GLESv2) {
@@ -666,4 +677,16 @@ void Loader::initialize_api(void* dso, egl_connection_t* cnx, uint32_t mask) {
     }
 }
 
+void Loader::init_gles1_api(egl_connection_t* cnx) {
+    std::lock_guard<std::mutex> lock(gles1Mutex);
+    if (!gles1Pending) {
+        return;
+    }
+    init_api(gles1Dso, gl_names_1, gl_names,
+        (__eglMustCastToProperFunctionPointerType*)
+            &cnx->hooks[egl_connection_t::GLESv1_INDEX]->gl,
+        gles1GetProcAddress);
+    gles1Pending = false;
+}
+
 } // namespace android
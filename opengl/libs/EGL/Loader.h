@@ -20,6 +20,8 @@
 #include <EGL/egl.h>
 #include <stdint.h>
 
+#include <mutex>
+
 namespace android {
 
 struct egl_connection_t;
@@ -43,6 +45,15 @@ class Loader {
 
     getProcAddressType getProcAddress;
 
+    // The GLESv1 entry points are only resolved when the first GLESv1 context
+    // is created, since few apps use GLESv1.  While gles1Pending is set,
+    // gles1Dso is the library providing them and gles1GetProcAddress its
+    // eglGetProcAddress.
+    std::mutex gles1Mutex;
+    bool gles1Pending;
+    void* gles1Dso;
+    getProcAddressType gles1GetProcAddress;
+
 public:
     static Loader& getInstance();
     ~Loader();
@@ -50,6 +61,10 @@ public:
     void* open(egl_connection_t* cnx);
     void close(egl_connection_t* cnx);
 
+    // Resolves the GLESv1 entry points of the loaded driver if that hasn't
+    // been done yet.  Must be called before a GLESv1 context is used.
+    void init_gles1_api(egl_connection_t* cnx);
+
 private:
     Loader();
     driver_t* attempt_to_load_angle(egl_connection_t* cnx);
@@ -16,11 +16,14 @@
 
 #include "egl_cache.h"
 
+#include <graphicsenv/GraphicsEnv.h>
 #include <log/log.h>
 #include <private/EGL/cache.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <thread>
+#include <vector>
 
 #include "../egl_impl.h"
 #include "egl_display.h"
@@ -110,6 +113,7 @@ void egl_cache_t::terminate() {
         mBlobCache->writeToFile();
     }
     mBlobCache = nullptr;
+    mSharedBlobCache = nullptr;
 }
 
 void egl_cache_t::setBlob(const void* key, EGLsizeiANDROID keySize, const void* value,
@@ -122,6 +126,16 @@ void egl_cache_t::setBlob(const void* key, EGLsizeiANDROID keySize, const void*
     }
 
     if (mInitialized) {
+        // Don't keep a private copy of what the shared cache already has.
+        BlobCache* shared = getSharedBlobCacheLocked();
+        if (shared && shared->get(key, keySize, nullptr, 0) == size_t(valueSize)) {
+            std::vector<uint8_t> sharedValue(valueSize);
+            shared->get(key, keySize, sharedValue.data(), valueSize);
+            if (memcmp(sharedValue.data(), value, valueSize) == 0) {
+                return;
+            }
+        }
+
         BlobCache* bc = getBlobCacheLocked();
         bc->set(key, keySize, value, valueSize);
 
@@ -150,6 +164,13 @@ EGLsizeiANDROID egl_cache_t::getBlob(const void* key, EGLsizeiANDROID keySize, v
     }
 
     if (mInitialized) {
+        BlobCache* shared = getSharedBlobCacheLocked();
+        if (shared) {
+            size_t size = shared->get(key, keySize, value, valueSize);
+            if (size > 0) {
+                return size;
+            }
+        }
         BlobCache* bc = getBlobCacheLocked();
         return bc->get(key, keySize, value, valueSize);
     }
@@ -161,11 +182,33 @@ void egl_cache_t::setCacheFilename(const char* filename) {
     mFilename = filename;
 }
 
+BlobCache::Stats egl_cache_t::getStats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mBlobCache ? mBlobCache->getStats() : BlobCache::Stats();
+}
+
 BlobCache* egl_cache_t::getBlobCacheLocked() {
     if (mBlobCache == nullptr) {
         mBlobCache.reset(new FileBlobCache(maxKeySize, maxValueSize, maxTotalSize, mFilename));
+        // A process populating the shared cache writes it for all to read.
+        const std::string& sharedPath = GraphicsEnv::getInstance().getSharedShaderCachePath();
+        if (!mFilename.empty() && mFilename == sharedPath) {
+            mBlobCache->setFileMode(S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        }
     }
     return mBlobCache.get();
 }
 
+BlobCache* egl_cache_t::getSharedBlobCacheLocked() {
+    const std::string& sharedPath = GraphicsEnv::getInstance().getSharedShaderCachePath();
+    if (sharedPath.empty() || sharedPath == mFilename) {
+        return nullptr;
+    }
+    if (mSharedBlobCache == nullptr) {
+        mSharedBlobCache.reset(
+                new FileBlobCache(maxKeySize, maxValueSize, maxTotalSize, sharedPath));
+    }
+    return mSharedBlobCache.get();
+}
+
 }; // namespace android
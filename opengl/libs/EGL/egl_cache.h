@@ -64,6 +64,10 @@ public:
     // cache contents from one program invocation to another.
     void setCacheFilename(const char* filename);
 
+    // getStats returns the number of hits, misses and evictions of the cache
+    // since it was loaded.  All are 0 if the cache wasn't used yet.
+    BlobCache::Stats getStats();
+
 private:
     // Creation and (the lack of) destruction is handled internally.
     egl_cache_t();
@@ -79,6 +83,11 @@ private:
     // possible.
     BlobCache* getBlobCacheLocked();
 
+    // getSharedBlobCacheLocked returns the read-only cache shared by all
+    // processes, loading it the first time, or nullptr if there is none or if
+    // this process is the one populating it.
+    BlobCache* getSharedBlobCacheLocked();
+
     // mInitialized indicates whether the egl_cache_t is in the initialized
     // state.  It is initialized to false at construction time, and gets set to
     // true when initialize is called.  It is set back to false when terminate
@@ -92,6 +101,11 @@ private:
     // first time it's needed.
     std::unique_ptr<FileBlobCache> mBlobCache;
 
+    // mSharedBlobCache is the read-only cache at the path given by
+    // GraphicsEnv::getSharedShaderCachePath, which is looked up before
+    // mBlobCache.  It is never written to by this process.
+    std::unique_ptr<FileBlobCache> mSharedBlobCache;
+
     // mFilename is the name of the file for storing cache contents in between
     // program invocations.  It is initialized to an empty string at
     // construction time, and can be set with the setCacheFilename method.  An
@@ -162,6 +162,14 @@ LayerLoader& LayerLoader::getInstance() {
 
 const char kSystemLayerLibraryDir[] = "/data/local/debug/gles";
 
+// The tracing layer is installed with the platform libraries, and can be enabled on any build.
+const char kTraceLayerName[] = "libGLES_trace_layer.so";
+#if defined(__LP64__)
+const char kTraceLayerLibraryDir[] = "/system/lib64";
+#else
+const char kTraceLayerLibraryDir[] = "/system/lib";
+#endif
+
 std::string LayerLoader::GetDebugLayers() {
     // Layers can be specified at the Java level in GraphicsEnvironment
     // gpu_debug_layers_gles = layer1:layer2:layerN
@@ -366,6 +374,9 @@ void LayerLoader::LoadLayers() {
             auto it = paths.begin();
             paths.insert(it, system_path);
         }
+        if (layers[i] == kTraceLayerName) {
+            paths.push_back(kTraceLayerLibraryDir);
+        }
 
         bool layer_found = false;
         for (uint32_t j = 0; j < paths.size() && !layer_found; j++) {
@@ -390,7 +401,10 @@ void LayerLoader::LoadLayers() {
                 // can't safely use libc++_shared, for example. Which is one reason
                 // (among several) we only allow them in non-user builds.
                 auto app_namespace = android::GraphicsEnv::getInstance().getAppNamespace();
-                if (app_namespace && !android::base::StartsWith(layer, kSystemLayerLibraryDir)) {
+                const bool is_trace_layer =
+                        layer == std::string(kTraceLayerLibraryDir) + "/" + kTraceLayerName;
+                if (app_namespace && !android::base::StartsWith(layer, kSystemLayerLibraryDir) &&
+                    !is_trace_layer) {
                     char* error_message = nullptr;
                     dlhandle_ = OpenNativeLibraryInNamespace(app_namespace, layer.c_str(),
                                                              &native_bridge_, &error_message);
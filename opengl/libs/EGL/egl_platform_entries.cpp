@@ -38,6 +38,7 @@
 #include <unordered_map>
 
 #include "../egl_impl.h"
+#include "EGL/Loader.h"
 #include "EGL/egl.h"
 #include "EGL/eglext.h"
 #include "EGL/eglext_angle.h"
@@ -931,6 +932,7 @@ EGLContext eglCreateContextImpl(EGLDisplay dpy, EGLConfig config, EGLContext sha
             if (version == egl_connection_t::GLESv1_INDEX) {
                 android::GraphicsEnv::getInstance().setTargetStats(
                         android::GpuStatsInfo::Stats::GLES_1_IN_USE);
+                Loader::getInstance().init_gles1_api(cnx);
             }
             egl_context_t* c = new egl_context_t(dpy, context, config, cnx, version);
             return c;
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// GLES layer recording the CPU time of every EGL and GLES call into Perfetto.
+//
+// Each intercepted call appends its begin and end timestamps to a ring owned by the calling
+// thread, so recording takes no lock and makes no syscall beyond reading the clock. A thread
+// writes its ring out as track events when it swaps buffers, which also marks the frame
+// boundary, or when its ring is full. Nothing is recorded unless a trace session enables the
+// "gles" category.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES/gl.h>
+#include <GLES/glext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl31.h>
+#include <GLES3/gl32.h>
+#include <log/log.h>
+#include <perfetto/tracing.h>
+#include <time.h>
+
+#include <atomic>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+PERFETTO_DEFINE_CATEGORIES(
+        perfetto::Category("gles").SetDescription("EGL and GLES calls of the GLES trace layer"));
+PERFETTO_TRACK_EVENT_STATIC_STORAGE();
+
+namespace android {
+namespace {
+
+typedef __eglMustCastToProperFunctionPointerType EGLFuncPointer;
+typedef void* (*PFNEGLGETNEXTLAYERPROCADDRESSPROC)(void*, const char*);
+
+// Every function the loader can route through a layer, from the loader's own lists. The GLES
+// functions implemented by the platform are listed in entries.in as well, so only the EGL
+// functions are taken from platform_entries.in.
+#define PLATFORM_GL_ENTRY(_r, _api, ...)
+enum Function : uint32_t {
+#define GL_ENTRY PLATFORM_GL_ENTRY
+#define EGL_ENTRY(_r, _api, ...) k_##_api,
+#include "../platform_entries.in"
+#undef GL_ENTRY
+#define GL_ENTRY(_r, _api, ...) k_##_api,
+#include "../entries.in"
+#undef GL_ENTRY
+#undef EGL_ENTRY
+    kNumFunctions
+};
+
+const char* const kFunctionNames[] = {
+#define GL_ENTRY PLATFORM_GL_ENTRY
+#define EGL_ENTRY(_r, _api, ...) #_api,
+#include "../platform_entries.in"
+#undef GL_ENTRY
+#define GL_ENTRY(_r, _api, ...) #_api,
+#include "../entries.in"
+#undef GL_ENTRY
+#undef EGL_ENTRY
+};
+
+// Next entry point in the chain for each function, set by AndroidGLESLayer_GetProcAddress.
+std::atomic<EGLFuncPointer> sNext[kNumFunctions];
+
+int64_t now() {
+    struct timespec ts;
+    // The default clock of Perfetto track events.
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+struct CallRecord {
+    uint32_t function;
+    int64_t begin;
+    int64_t end;
+};
+
+// Calls still in the ring when its thread exits are dropped, since Perfetto can't be used from
+// thread local destructors.
+class CallRing {
+public:
+    void add(uint32_t function, int64_t begin, int64_t end) {
+        if (mCount == kSize) flush();
+        mRecords[mCount++] = {function, begin, end};
+    }
+
+    // Writes the recorded calls as slices on the track of this thread.
+    void flush() {
+        for (size_t i = 0; i < mCount; i++) {
+            const CallRecord& record = mRecords[i];
+            TRACE_EVENT_BEGIN("gles", perfetto::StaticString{kFunctionNames[record.function]},
+                              perfetto::ThreadTrack::Current(),
+                              static_cast<uint64_t>(record.begin));
+            TRACE_EVENT_END("gles", perfetto::ThreadTrack::Current(),
+                            static_cast<uint64_t>(record.end));
+        }
+        mCount = 0;
+    }
+
+private:
+    static constexpr size_t kSize = 1024;
+
+    CallRecord mRecords[kSize];
+    size_t mCount = 0;
+};
+
+thread_local CallRing sRing;
+
+bool isSwap(uint32_t function) {
+    return function == k_eglSwapBuffers || function == k_eglSwapBuffersWithDamageKHR;
+}
+
+template <uint32_t kFunction, typename Fn>
+struct TracedCall;
+
+template <uint32_t kFunction, typename R, typename... Args>
+struct TracedCall<kFunction, R(Args...)> {
+    static R call(Args... args) {
+        const auto next = reinterpret_cast<R (*)(Args...)>(
+                sNext[kFunction].load(std::memory_order_relaxed));
+        if (!TRACE_EVENT_CATEGORY_ENABLED("gles")) {
+            return next(args...);
+        }
+
+        struct Recorder {
+            const int64_t begin = now();
+            ~Recorder() {
+                const int64_t end = now();
+                sRing.add(kFunction, begin, end);
+                if (isSwap(kFunction)) {
+                    sRing.flush();
+                    TRACE_EVENT_INSTANT("gles", "Frame", perfetto::ThreadTrack::Current(),
+                                        static_cast<uint64_t>(end));
+                }
+            }
+        } recorder;
+        return next(args...);
+    }
+};
+
+#define TRACED_ENTRY(_r, _api, ...) \
+    reinterpret_cast<EGLFuncPointer>(&TracedCall<k_##_api, _r(__VA_ARGS__)>::call),
+const EGLFuncPointer kTracedFunctions[] = {
+#define GL_ENTRY PLATFORM_GL_ENTRY
+#define EGL_ENTRY TRACED_ENTRY
+#include "../platform_entries.in"
+#undef GL_ENTRY
+#define GL_ENTRY TRACED_ENTRY
+#include "../entries.in"
+#undef GL_ENTRY
+#undef EGL_ENTRY
+};
+#undef TRACED_ENTRY
+#undef PLATFORM_GL_ENTRY
+
+static_assert(sizeof(kFunctionNames) / sizeof(kFunctionNames[0]) == kNumFunctions);
+static_assert(sizeof(kTracedFunctions) / sizeof(kTracedFunctions[0]) == kNumFunctions);
+
+const std::unordered_map<std::string_view, uint32_t>& functionIndices() {
+    static const auto* indices = [] {
+        auto* map = new std::unordered_map<std::string_view, uint32_t>();
+        for (uint32_t i = 0; i < kNumFunctions; i++) {
+            map->emplace(kFunctionNames[i], i);
+        }
+        return map;
+    }();
+    return *indices;
+}
+
+} // namespace
+} // namespace android
+
+extern "C" {
+
+__attribute__((visibility("default"))) void* AndroidGLESLayer_Initialize(
+        void* /*layer_id*/, android::PFNEGLGETNEXTLAYERPROCADDRESSPROC /*get_next_layer_proc_address*/) {
+    static std::once_flag sInitOnce;
+    std::call_once(sInitOnce, [] {
+        perfetto::TracingInitArgs args;
+        args.backends = perfetto::kSystemBackend;
+        perfetto::Tracing::Initialize(args);
+        perfetto::TrackEvent::Register();
+        ALOGI("GLES trace layer initialized");
+    });
+    return nullptr;
+}
+
+__attribute__((visibility("default"))) void* AndroidGLESLayer_GetProcAddress(
+        const char* funcName, android::EGLFuncPointer next) {
+    const auto& indices = android::functionIndices();
+    const auto it = indices.find(funcName);
+    if (it == indices.end() || !next) {
+        return reinterpret_cast<void*>(next);
+    }
+    android::sNext[it->second].store(next, std::memory_order_relaxed);
+    return reinterpret_cast<void*>(android::kTracedFunctions[it->second]);
+}
+
+} // extern "C"
@@ -19,9 +19,12 @@
 
 #include <gtest/gtest.h>
 
+#include <sys/stat.h>
+
 #include <utils/Log.h>
 
 #include <android-base/test_utils.h>
+#include <graphicsenv/GraphicsEnv.h>
 
 #include "egl_cache.h"
 #include "egl_display.h"
@@ -87,6 +90,7 @@ protected:
     }
 
     virtual void TearDown() {
+        GraphicsEnv::getInstance().setSharedShaderCachePath("");
         mTempFile.reset(nullptr);
         EGLCacheTest::TearDown();
     }
@@ -108,4 +112,80 @@ TEST_F(EGLCacheSerializationTest, ReinitializedCacheContainsValues) {
     ASSERT_EQ('h', buf[3]);
 }
 
+TEST_F(EGLCacheSerializationTest, ReinitializedCacheContainsAppendedValues) {
+    uint8_t buf[4] = { 0xee, 0xee, 0xee, 0xee };
+    mCache->setCacheFilename(&mTempFile->path[0]);
+    mCache->initialize(egl_display_t::get(EGL_DEFAULT_DISPLAY));
+    mCache->setBlob("abcd", 4, "efgh", 4);
+    mCache->terminate();
+
+    // The second value is appended to the file written above.
+    struct stat before;
+    ASSERT_EQ(0, stat(&mTempFile->path[0], &before));
+    mCache->initialize(egl_display_t::get(EGL_DEFAULT_DISPLAY));
+    mCache->setBlob("ijkl", 4, "mnop", 4);
+    mCache->terminate();
+    struct stat after;
+    ASSERT_EQ(0, stat(&mTempFile->path[0], &after));
+    ASSERT_EQ(before.st_ino, after.st_ino);
+    ASSERT_LT(before.st_size, after.st_size);
+
+    mCache->initialize(egl_display_t::get(EGL_DEFAULT_DISPLAY));
+    ASSERT_EQ(4, mCache->getBlob("abcd", 4, buf, 4));
+    ASSERT_EQ('e', buf[0]);
+    ASSERT_EQ('h', buf[3]);
+    ASSERT_EQ(4, mCache->getBlob("ijkl", 4, buf, 4));
+    ASSERT_EQ('m', buf[0]);
+    ASSERT_EQ('p', buf[3]);
+}
+
+TEST_F(EGLCacheSerializationTest, ReinitializedCacheContainsReplacedValues) {
+    uint8_t buf[4] = { 0xee, 0xee, 0xee, 0xee };
+    mCache->setCacheFilename(&mTempFile->path[0]);
+    mCache->initialize(egl_display_t::get(EGL_DEFAULT_DISPLAY));
+    mCache->setBlob("abcd", 4, "efgh", 4);
+    mCache->terminate();
+
+    // The new value is appended to the file, and replaces the old one when
+    // the file is loaded.
+    mCache->initialize(egl_display_t::get(EGL_DEFAULT_DISPLAY));
+    mCache->setBlob("abcd", 4, "wxyz", 4);
+    mCache->terminate();
+
+    mCache->initialize(egl_display_t::get(EGL_DEFAULT_DISPLAY));
+    ASSERT_EQ(4, mCache->getBlob("abcd", 4, buf, 4));
+    ASSERT_EQ('w', buf[0]);
+    ASSERT_EQ('x', buf[1]);
+    ASSERT_EQ('y', buf[2]);
+    ASSERT_EQ('z', buf[3]);
+}
+
+TEST_F(EGLCacheSerializationTest, SharedCacheValuesAreFound) {
+    uint8_t buf[4] = { 0xee, 0xee, 0xee, 0xee };
+    TemporaryFile sharedFile;
+
+    // Populate the shared cache, like a prewarm run would.
+    GraphicsEnv::getInstance().setSharedShaderCachePath(sharedFile.path);
+    mCache->setCacheFilename(sharedFile.path);
+    mCache->initialize(egl_display_t::get(EGL_DEFAULT_DISPLAY));
+    mCache->setBlob("abcd", 4, "efgh", 4);
+    mCache->terminate();
+
+    // A process with its own cache finds the shared value, and doesn't keep a
+    // private copy of it.
+    mCache->setCacheFilename(&mTempFile->path[0]);
+    mCache->initialize(egl_display_t::get(EGL_DEFAULT_DISPLAY));
+    ASSERT_EQ(4, mCache->getBlob("abcd", 4, buf, 4));
+    ASSERT_EQ('e', buf[0]);
+    ASSERT_EQ('f', buf[1]);
+    ASSERT_EQ('g', buf[2]);
+    ASSERT_EQ('h', buf[3]);
+    mCache->setBlob("abcd", 4, "efgh", 4);
+    mCache->terminate();
+
+    GraphicsEnv::getInstance().setSharedShaderCachePath("");
+    mCache->initialize(egl_display_t::get(EGL_DEFAULT_DISPLAY));
+    ASSERT_EQ(0, mCache->getBlob("abcd", 4, buf, 4));
+}
+
 }
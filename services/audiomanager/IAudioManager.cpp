@@ -21,6 +21,9 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <map>
+#include <mutex>
+
 #include <binder/Parcel.h>
 #include <audiomanager/AudioManager.h>
 #include <audiomanager/IAudioManager.h>
@@ -88,15 +91,33 @@ public:
 
     virtual status_t playerEvent(audio_unique_id_t piid, player_state_t event,
             audio_port_handle_t deviceId) {
+        {
+            std::lock_guard<std::mutex> _l(mLock);
+            const auto it = mLastPlayerEvents.find(piid);
+            if (it != mLastPlayerEvents.end() && it->second.event == event &&
+                    it->second.deviceId == deviceId) {
+                ALOGV("playerEvent() skipping repeated event %d for piid %d", event, piid);
+                return OK;
+            }
+        }
         Parcel data, reply;
         data.writeInterfaceToken(IAudioManager::getInterfaceDescriptor());
         data.writeInt32((int32_t) piid);
         data.writeInt32((int32_t) event);
         data.writeInt32((int32_t) deviceId);
-        return remote()->transact(PLAYER_EVENT, data, &reply, IBinder::FLAG_ONEWAY);
+        const status_t res = remote()->transact(PLAYER_EVENT, data, &reply, IBinder::FLAG_ONEWAY);
+        if (res == OK) {
+            std::lock_guard<std::mutex> _l(mLock);
+            mLastPlayerEvents[piid] = PlayerEvent{event, deviceId};
+        }
+        return res;
     }
 
     virtual status_t releasePlayer(audio_unique_id_t piid) {
+        {
+            std::lock_guard<std::mutex> _l(mLock);
+            mLastPlayerEvents.erase(piid);
+        }
         Parcel data, reply;
         data.writeInterfaceToken(IAudioManager::getInterfaceDescriptor());
         data.writeInt32((int32_t) piid);
@@ -141,6 +162,18 @@ public:
         data.writeInt32((int32_t) sessionId);
         return remote()->transact(PLAYER_SESSION_ID, data, &reply, IBinder::FLAG_ONEWAY);
     }
+
+private:
+    struct PlayerEvent {
+        player_state_t event;
+        audio_port_handle_t deviceId;
+    };
+
+    // The last event sent for each player. The audio service ignores an event that repeats the
+    // player's current state and device, so those are not sent again. Players commonly report
+    // the same state several times, e.g. on every start() of an already started track.
+    std::mutex mLock;
+    std::map<audio_unique_id_t, PlayerEvent> mLastPlayerEvents;
 };
 
 IMPLEMENT_META_INTERFACE(AudioManager, "android.media.IAudioService");
@@ -74,6 +74,14 @@ void GpuService::setTargetStats(const std::string& appPackageName, const uint64_
     mGpuStats->insertTargetStats(appPackageName, driverVersionCode, stats, value);
 }
 
+void GpuService::setTargetStatsArray(
+        const std::string& appPackageName, const uint64_t driverVersionCode,
+        const std::vector<std::pair<GpuStatsInfo::Stats, uint64_t>>& stats) {
+    for (const auto& [stat, value] : stats) {
+        mGpuStats->insertTargetStats(appPackageName, driverVersionCode, stat, value);
+    }
+}
+
 void GpuService::setUpdatableDriverPath(const std::string& driverPath) {
     IPCThreadState* ipc = IPCThreadState::self();
     const int pid = ipc->getCallingPid();
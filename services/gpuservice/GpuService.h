@@ -52,6 +52,9 @@ private:
                      int64_t driverLoadingTime) override;
     void setTargetStats(const std::string& appPackageName, const uint64_t driverVersionCode,
                         const GpuStatsInfo::Stats stats, const uint64_t value) override;
+    void setTargetStatsArray(
+            const std::string& appPackageName, const uint64_t driverVersionCode,
+            const std::vector<std::pair<GpuStatsInfo::Stats, uint64_t>>& stats) override;
     void setUpdatableDriverPath(const std::string& driverPath) override;
     std::string getUpdatableDriverPath() override;
 
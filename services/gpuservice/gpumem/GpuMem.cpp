@@ -24,10 +24,13 @@
 #include <libbpf.h>
 #include <libbpf_android.h>
 #include <log/log.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <utils/Timers.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
+#include <chrono>
 #include <unordered_map>
 #include <vector>
 
@@ -36,6 +39,7 @@ namespace android {
 using base::StringAppendF;
 
 GpuMem::~GpuMem() {
+    stopSampling();
     bpf_detach_tracepoint(kGpuMemTraceGroup, kGpuMemTotalTracepoint);
 }
 
@@ -75,6 +79,7 @@ void GpuMem::initialize() {
     setGpuMemTotalMap(map);
 
     mInitialized.store(true);
+    startSampling();
 }
 
 void GpuMem::setGpuMemTotalMap(bpf::BpfMap<uint64_t, uint64_t>& map) {
@@ -132,6 +137,51 @@ void GpuMem::dump(const Vector<String16>& /* args */, std::string* result) {
                           gpu.second[i].second);
         }
     }
+
+    dumpSamples(result);
+}
+
+void GpuMem::dumpSamples(std::string* result) {
+    std::lock_guard<std::mutex> lock(mSampleLock);
+    if (mSamples.empty()) return;
+
+    // Per process peaks, ordered by gpu and pid.
+    std::vector<std::pair<uint64_t, uint64_t>> peaks;
+    for (const auto& [key, procMem] : mProcMem) {
+        if (static_cast<uint32_t>(key) != 0) peaks.emplace_back(key, procMem.peak);
+    }
+    std::sort(peaks.begin(), peaks.end());
+    uint32_t lastGpuId = UINT32_MAX;
+    for (const auto& [key, peak] : peaks) {
+        const uint32_t gpuId = key >> 32;
+        if (gpuId != lastGpuId) {
+            StringAppendF(result, "Process peaks for GPU %u:\n", gpuId);
+            lastGpuId = gpuId;
+        }
+        StringAppendF(result, "Proc %u peak: %" PRIu64 "\n", static_cast<uint32_t>(key), peak);
+    }
+
+    // Global totals of each sample, with the change since the previous sample.
+    const nsecs_t now = systemTime();
+    result->append("Global total history:\n");
+    const Sample* previous = nullptr;
+    for (const Sample& sample : mSamples) {
+        StringAppendF(result, "  -%" PRId64 "s:", ns2s(now - sample.timestamp));
+        std::vector<std::pair<uint32_t, uint64_t>> totals(sample.globalTotals.begin(),
+                                                          sample.globalTotals.end());
+        std::sort(totals.begin(), totals.end());
+        for (const auto& [gpuId, total] : totals) {
+            StringAppendF(result, " GPU %u %" PRIu64, gpuId, total);
+            if (previous) {
+                const auto it = previous->globalTotals.find(gpuId);
+                const uint64_t previousTotal = it == previous->globalTotals.end() ? 0 : it->second;
+                StringAppendF(result, " (%+" PRId64 ")",
+                              static_cast<int64_t>(total - previousTotal));
+            }
+        }
+        result->append("\n");
+        previous = &sample;
+    }
 }
 
 void GpuMem::traverseGpuMemTotals(const std::function<void(int64_t ts, uint32_t gpuId, uint32_t pid,
@@ -154,4 +204,95 @@ void GpuMem::traverseGpuMemTotals(const std::function<void(int64_t ts, uint32_t
     }
 }
 
+void GpuMem::sample() {
+    ATRACE_CALL();
+
+    if (!mInitialized.load() || !mGpuMemTotalMap.isValid()) return;
+
+    Sample sample;
+    sample.timestamp = systemTime();
+    std::unordered_map<uint64_t, uint64_t> procTotals;
+    traverseGpuMemTotals([&](int64_t, uint32_t gpuId, uint32_t pid, uint64_t size) {
+        if (pid == 0) {
+            sample.globalTotals[gpuId] = size;
+        } else {
+            procTotals[(static_cast<uint64_t>(gpuId) << 32) | pid] = size;
+        }
+    });
+
+    std::lock_guard<std::mutex> lock(mSampleLock);
+    // Forget the processes which are gone from the map.
+    for (auto it = mProcMem.begin(); it != mProcMem.end();) {
+        it = procTotals.count(it->first) ? std::next(it) : mProcMem.erase(it);
+    }
+    for (const auto& [key, total] : procTotals) {
+        ProcMem& procMem = mProcMem[key];
+        procMem.total = total;
+        procMem.peak = std::max(procMem.peak, total);
+    }
+
+    mSamples.push_back(std::move(sample));
+    while (mSamples.size() > kMaxSamples) {
+        mSamples.pop_front();
+    }
+}
+
+uint64_t GpuMem::getGlobalGpuMemTotal(uint32_t gpuId) {
+    std::lock_guard<std::mutex> lock(mSampleLock);
+    if (mSamples.empty()) return 0;
+    const auto& totals = mSamples.back().globalTotals;
+    const auto it = totals.find(gpuId);
+    return it == totals.end() ? 0 : it->second;
+}
+
+uint64_t GpuMem::getProcGpuMemTotal(uint32_t gpuId, uint32_t pid) {
+    std::lock_guard<std::mutex> lock(mSampleLock);
+    const auto it = mProcMem.find((static_cast<uint64_t>(gpuId) << 32) | pid);
+    return it == mProcMem.end() ? 0 : it->second.total;
+}
+
+uint64_t GpuMem::getProcGpuMemPeak(uint32_t gpuId, uint32_t pid) {
+    std::lock_guard<std::mutex> lock(mSampleLock);
+    const auto it = mProcMem.find((static_cast<uint64_t>(gpuId) << 32) | pid);
+    return it == mProcMem.end() ? 0 : it->second.peak;
+}
+
+int64_t GpuMem::getGlobalGpuMemDelta(uint32_t gpuId) {
+    std::lock_guard<std::mutex> lock(mSampleLock);
+    if (mSamples.empty()) return 0;
+    const auto& first = mSamples.front().globalTotals;
+    const auto& last = mSamples.back().globalTotals;
+    const auto firstIt = first.find(gpuId);
+    const auto lastIt = last.find(gpuId);
+    return static_cast<int64_t>((lastIt == last.end() ? 0 : lastIt->second) -
+                                (firstIt == first.end() ? 0 : firstIt->second));
+}
+
+void GpuMem::startSampling() {
+    mSamplingThread = std::thread(&GpuMem::samplingLoop, this);
+    pthread_setname_np(mSamplingThread.native_handle(), "GpuMemSampling");
+}
+
+void GpuMem::stopSampling() {
+    {
+        std::lock_guard<std::mutex> lock(mSampleLock);
+        mSamplingStopped = true;
+    }
+    mSamplingCondition.notify_all();
+    if (mSamplingThread.joinable()) {
+        mSamplingThread.join();
+    }
+}
+
+void GpuMem::samplingLoop() {
+    while (true) {
+        sample();
+        std::unique_lock<std::mutex> lock(mSampleLock);
+        if (mSamplingCondition.wait_for(lock, std::chrono::nanoseconds(kSamplePeriod),
+                                        [this] { return mSamplingStopped; })) {
+            return;
+        }
+    }
+}
+
 } // namespace android
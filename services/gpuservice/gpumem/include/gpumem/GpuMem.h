@@ -18,9 +18,16 @@
 
 #include <bpf/BpfMap.h>
 #include <utils/String16.h>
+#include <utils/Timers.h>
 #include <utils/Vector.h>
 
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace android {
 
@@ -39,12 +46,41 @@ public:
     void traverseGpuMemTotals(const std::function<void(int64_t ts, uint32_t gpuId, uint32_t pid,
                                                        uint64_t size)>& callback);
 
+    // Reads the gpu memory totals into the sample history, and updates the per process peaks.
+    void sample();
+
+    // Cheap queries answered from the latest sample, without reading the bpf map. They return 0
+    // until the first sample, or for an unknown gpu or process.
+    uint64_t getGlobalGpuMemTotal(uint32_t gpuId);
+    uint64_t getProcGpuMemTotal(uint32_t gpuId, uint32_t pid);
+    // Largest total of the process seen by any sample.
+    uint64_t getProcGpuMemPeak(uint32_t gpuId, uint32_t pid);
+    // Change of the global total of gpuId over the sample history.
+    int64_t getGlobalGpuMemDelta(uint32_t gpuId);
+
 private:
     // Friend class for testing.
     friend class TestableGpuMem;
 
+    struct Sample {
+        nsecs_t timestamp;
+        // Global total of each gpu, keyed by gpu id.
+        std::unordered_map<uint32_t, uint64_t> globalTotals;
+    };
+
+    struct ProcMem {
+        uint64_t total;
+        uint64_t peak;
+    };
+
     // set gpu memory total map
     void setGpuMemTotalMap(bpf::BpfMap<uint64_t, uint64_t>& map);
+    // start and stop the periodic sampling thread
+    void startSampling();
+    void stopSampling();
+    void samplingLoop();
+    // dump the sample history and the per process peaks
+    void dumpSamples(std::string* result);
 
     // indicate whether ebpf has been initialized
     std::atomic<bool> mInitialized = false;
@@ -62,6 +98,20 @@ private:
     static constexpr char kGpuMemTotalMapPath[] = "/sys/fs/bpf/map_gpu_mem_gpu_mem_total_map";
     // 30 seconds timeout for trying to attach bpf program to tracepoint
     static constexpr int kGpuWaitTimeout = 30;
+    // period of the gpu memory sampling
+    static constexpr nsecs_t kSamplePeriod = s2ns(10);
+    // number of samples kept in the history
+    static constexpr size_t kMaxSamples = 60;
+
+    std::mutex mSampleLock;
+    // sample history, oldest first
+    std::deque<Sample> mSamples;
+    // latest total and peak of each process, keyed like the bpf map by (gpu id << 32 | pid)
+    std::unordered_map<uint64_t, ProcMem> mProcMem;
+
+    std::thread mSamplingThread;
+    std::condition_variable mSamplingCondition;
+    bool mSamplingStopped = false;
 };
 
 } // namespace android
@@ -26,6 +26,7 @@
 #include <statslog.h>
 #include <utils/Trace.h>
 
+#include <memory>
 #include <unordered_set>
 
 namespace android {
@@ -35,6 +36,12 @@ GpuStats::~GpuStats() {
         AStatsManager_clearPullAtomCallback(android::util::GPU_STATS_GLOBAL_INFO);
         AStatsManager_clearPullAtomCallback(android::util::GPU_STATS_APP_INFO);
     }
+
+    PendingStats* pending = mPendingStats.exchange(nullptr);
+    while (pending) {
+        std::unique_ptr<PendingStats> stats(pending);
+        pending = pending->next;
+    }
 }
 
 static void addLoadingCount(GpuStatsInfo::Driver driver, bool isDriverLoaded,
@@ -91,8 +98,6 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
                                  bool isDriverLoaded, int64_t driverLoadingTime) {
     ATRACE_CALL();
 
-    std::lock_guard<std::mutex> lock(mLock);
-    registerStatsdCallbacksIfNeeded();
     ALOGV("Received:\n"
           "\tdriverPackageName[%s]\n"
           "\tdriverVersionName[%s]\n"
@@ -107,20 +112,88 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
           appPackageName.c_str(), vulkanVersion, static_cast<int32_t>(driver), isDriverLoaded,
           driverLoadingTime);
 
+    PendingStats* pending = new PendingStats;
+    pending->driverPackageName = driverPackageName;
+    pending->driverVersionName = driverVersionName;
+    pending->driverVersionCode = driverVersionCode;
+    pending->driverBuildTime = driverBuildTime;
+    pending->appPackageName = appPackageName;
+    pending->vulkanVersion = vulkanVersion;
+    pending->driver = driver;
+    pending->isDriverLoaded = isDriverLoaded;
+    pending->driverLoadingTime = driverLoadingTime;
+    pushPendingStats(pending);
+}
+
+void GpuStats::insertTargetStats(const std::string& appPackageName,
+                                 const uint64_t driverVersionCode, const GpuStatsInfo::Stats stats,
+                                 const uint64_t /*value*/) {
+    ATRACE_CALL();
+
+    PendingStats* pending = new PendingStats;
+    pending->isTargetStats = true;
+    pending->appPackageName = appPackageName;
+    pending->driverVersionCode = driverVersionCode;
+    pending->stats = stats;
+    pushPendingStats(pending);
+}
+
+void GpuStats::pushPendingStats(PendingStats* pending) {
+    PendingStats* head = mPendingStats.load(std::memory_order_relaxed);
+    do {
+        pending->next = head;
+    } while (!mPendingStats.compare_exchange_weak(head, pending, std::memory_order_release,
+                                                  std::memory_order_relaxed));
+
+    if (mNumPendingStats.fetch_add(1) + 1 >= MAX_NUM_PENDING_STATS || !mStatsdRegistered) {
+        std::lock_guard<std::mutex> lock(mLock);
+        registerStatsdCallbacksIfNeeded();
+        applyPendingStatsLocked();
+    }
+}
+
+void GpuStats::applyPendingStatsLocked() {
+    PendingStats* pending = mPendingStats.exchange(nullptr, std::memory_order_acquire);
+
+    // Reverse the list to apply the stats in insertion order.
+    PendingStats* ordered = nullptr;
+    size_t count = 0;
+    while (pending) {
+        PendingStats* next = pending->next;
+        pending->next = ordered;
+        ordered = pending;
+        pending = next;
+        count++;
+    }
+    mNumPendingStats.fetch_sub(count);
+
+    while (ordered) {
+        std::unique_ptr<PendingStats> stats(ordered);
+        ordered = ordered->next;
+        if (stats->isTargetStats) {
+            insertTargetStatsLocked(*stats);
+        } else {
+            insertDriverStatsLocked(*stats);
+        }
+    }
+}
+
+void GpuStats::insertDriverStatsLocked(const PendingStats& pending) {
+    const uint64_t driverVersionCode = pending.driverVersionCode;
     if (!mGlobalStats.count(driverVersionCode)) {
         GpuStatsGlobalInfo globalInfo;
-        addLoadingCount(driver, isDriverLoaded, &globalInfo);
-        globalInfo.driverPackageName = driverPackageName;
-        globalInfo.driverVersionName = driverVersionName;
+        addLoadingCount(pending.driver, pending.isDriverLoaded, &globalInfo);
+        globalInfo.driverPackageName = pending.driverPackageName;
+        globalInfo.driverVersionName = pending.driverVersionName;
         globalInfo.driverVersionCode = driverVersionCode;
-        globalInfo.driverBuildTime = driverBuildTime;
-        globalInfo.vulkanVersion = vulkanVersion;
+        globalInfo.driverBuildTime = pending.driverBuildTime;
+        globalInfo.vulkanVersion = pending.vulkanVersion;
         mGlobalStats.insert({driverVersionCode, globalInfo});
     } else {
-        addLoadingCount(driver, isDriverLoaded, &mGlobalStats[driverVersionCode]);
+        addLoadingCount(pending.driver, pending.isDriverLoaded, &mGlobalStats[driverVersionCode]);
     }
 
-    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
+    const std::string appStatsKey = pending.appPackageName + std::to_string(driverVersionCode);
     if (!mAppStats.count(appStatsKey)) {
         if (mAppStats.size() >= MAX_NUM_APP_RECORDS) {
             ALOGV("GpuStatsAppInfo has reached maximum size. Ignore new stats.");
@@ -128,30 +201,24 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
         }
 
         GpuStatsAppInfo appInfo;
-        addLoadingTime(driver, driverLoadingTime, &appInfo);
-        appInfo.appPackageName = appPackageName;
+        addLoadingTime(pending.driver, pending.driverLoadingTime, &appInfo);
+        appInfo.appPackageName = pending.appPackageName;
         appInfo.driverVersionCode = driverVersionCode;
         mAppStats.insert({appStatsKey, appInfo});
         return;
     }
 
-    addLoadingTime(driver, driverLoadingTime, &mAppStats[appStatsKey]);
+    addLoadingTime(pending.driver, pending.driverLoadingTime, &mAppStats[appStatsKey]);
 }
 
-void GpuStats::insertTargetStats(const std::string& appPackageName,
-                                 const uint64_t driverVersionCode, const GpuStatsInfo::Stats stats,
-                                 const uint64_t /*value*/) {
-    ATRACE_CALL();
-
-    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
-
-    std::lock_guard<std::mutex> lock(mLock);
-    registerStatsdCallbacksIfNeeded();
+void GpuStats::insertTargetStatsLocked(const PendingStats& pending) {
+    const std::string appStatsKey =
+            pending.appPackageName + std::to_string(pending.driverVersionCode);
     if (!mAppStats.count(appStatsKey)) {
         return;
     }
 
-    switch (stats) {
+    switch (pending.stats) {
         case GpuStatsInfo::Stats::CPU_VULKAN_IN_USE:
             mAppStats[appStatsKey].cpuVulkanInUse = true;
             break;
@@ -195,6 +262,7 @@ void GpuStats::dump(const Vector<String16>& args, std::string* result) {
     }
 
     std::lock_guard<std::mutex> lock(mLock);
+    applyPendingStatsLocked();
     bool dumpAll = true;
 
     std::unordered_set<std::string> argsSet;
@@ -288,6 +356,7 @@ AStatsManager_PullAtomCallbackReturn GpuStats::pullAppInfoAtom(AStatsEventList*
     ATRACE_CALL();
 
     std::lock_guard<std::mutex> lock(mLock);
+    applyPendingStatsLocked();
 
     if (data) {
         for (const auto& ele : mAppStats) {
@@ -324,6 +393,7 @@ AStatsManager_PullAtomCallbackReturn GpuStats::pullGlobalInfoAtom(AStatsEventLis
     ATRACE_CALL();
 
     std::lock_guard<std::mutex> lock(mLock);
+    applyPendingStatsLocked();
     // flush cpuVulkanVersion and glesVersion to builtin driver stats
     interceptSystemDriverStatsLocked();
 
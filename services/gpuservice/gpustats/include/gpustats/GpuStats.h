@@ -22,6 +22,7 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <atomic>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -32,6 +33,9 @@ class GpuStats {
 public:
     ~GpuStats();
 
+    // The insert functions only queue the stats without taking mLock, so that binder calls from
+    // many apps starting at once don't serialize here. The queue is applied to the stats when they
+    // are dumped or pulled, or once it holds MAX_NUM_PENDING_STATS entries.
     // Insert new gpu driver stats into global stats and app stats.
     void insertDriverStats(const std::string& driverPackageName,
                            const std::string& driverVersionName, uint64_t driverVersionCode,
@@ -46,11 +50,36 @@ public:
 
     // This limits the worst case number of loading times tracked.
     static const size_t MAX_NUM_LOADING_TIMES = 50;
+    // This limits the number of stats queued before they are applied.
+    static const size_t MAX_NUM_PENDING_STATS = 64;
 
 private:
     // Friend class for testing.
     friend class TestableGpuStats;
 
+    // Stats queued by insertDriverStats or insertTargetStats.
+    struct PendingStats {
+        PendingStats* next = nullptr;
+        bool isTargetStats = false;
+        std::string driverPackageName;
+        std::string driverVersionName;
+        uint64_t driverVersionCode = 0;
+        int64_t driverBuildTime = 0;
+        std::string appPackageName;
+        int32_t vulkanVersion = 0;
+        GpuStatsInfo::Driver driver = GpuStatsInfo::Driver::NONE;
+        bool isDriverLoaded = false;
+        int64_t driverLoadingTime = 0;
+        GpuStatsInfo::Stats stats = GpuStatsInfo::Stats::CPU_VULKAN_IN_USE;
+    };
+
+    // Queue stats, and apply the queue if it has grown long.
+    void pushPendingStats(PendingStats* pending);
+    // Apply the queued stats in the order they were inserted.
+    void applyPendingStatsLocked();
+    void insertDriverStatsLocked(const PendingStats& pending);
+    void insertTargetStatsLocked(const PendingStats& pending);
+
     // Native atom puller callback registered in statsd.
     static AStatsManager_PullAtomCallbackReturn pullAtomCallback(int32_t atomTag,
                                                                  AStatsEventList* data,
@@ -74,7 +103,10 @@ private:
     // GpuStats access should be guarded by mLock.
     std::mutex mLock;
     // True if statsd callbacks have been registered.
-    bool mStatsdRegistered = false;
+    std::atomic<bool> mStatsdRegistered = false;
+    // Last in first out list of the queued stats, and its length.
+    std::atomic<PendingStats*> mPendingStats = nullptr;
+    std::atomic<size_t> mNumPendingStats = 0;
     // Key is driver version code.
     std::unordered_map<uint64_t, GpuStatsGlobalInfo> mGlobalStats;
     // Key is <app package name>+<driver version code>.
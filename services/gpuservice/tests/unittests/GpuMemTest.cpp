@@ -167,5 +167,51 @@ TEST_F(GpuMemTest, traverseGpuMemTotals) {
     EXPECT_EQ(sCount, TEST_KEY_COUNT);
 }
 
+TEST_F(GpuMemTest, sampleBeforeInitialization) {
+    mGpuMem->sample();
+
+    EXPECT_EQ(mGpuMem->getGlobalGpuMemTotal(0), 0);
+    EXPECT_EQ(mGpuMem->getProcGpuMemTotal(0, (uint32_t)TEST_PROC_KEY_1), 0);
+}
+
+TEST_F(GpuMemTest, sampleTracksTotalsAndPeaks) {
+    ASSERT_RESULT_OK(mTestMap.writeValue(TEST_GLOBAL_KEY, TEST_GLOBAL_VAL, BPF_ANY));
+    ASSERT_RESULT_OK(mTestMap.writeValue(TEST_PROC_KEY_1, TEST_PROC_VAL_1, BPF_ANY));
+    mTestableGpuMem.setGpuMemTotalMap(mTestMap);
+    mGpuMem->sample();
+
+    // The map has been moved into GpuMem.
+    auto& map = mTestableGpuMem.getGpuMemTotalMap();
+    ASSERT_RESULT_OK(map.writeValue(TEST_GLOBAL_KEY, TEST_GLOBAL_VAL + 10, BPF_ANY));
+    ASSERT_RESULT_OK(map.writeValue(TEST_PROC_KEY_1, TEST_PROC_VAL_1 - 10, BPF_ANY));
+    mGpuMem->sample();
+
+    EXPECT_EQ(mGpuMem->getGlobalGpuMemTotal(0), TEST_GLOBAL_VAL + 10);
+    EXPECT_EQ(mGpuMem->getGlobalGpuMemDelta(0), 10);
+    EXPECT_EQ(mGpuMem->getProcGpuMemTotal(0, (uint32_t)TEST_PROC_KEY_1), TEST_PROC_VAL_1 - 10);
+    EXPECT_EQ(mGpuMem->getProcGpuMemPeak(0, (uint32_t)TEST_PROC_KEY_1), TEST_PROC_VAL_1);
+    EXPECT_THAT(dumpsys(),
+                HasSubstr(StringPrintf("Proc %u peak: %" PRIu64 "\n", (uint32_t)TEST_PROC_KEY_1,
+                                       TEST_PROC_VAL_1)));
+    EXPECT_THAT(dumpsys(), HasSubstr(StringPrintf(" GPU 0 %" PRIu64 " (+10)\n",
+                                                  TEST_GLOBAL_VAL + 10)));
+}
+
+TEST_F(GpuMemTest, sampleForgetsExitedProcesses) {
+    ASSERT_RESULT_OK(mTestMap.writeValue(TEST_PROC_KEY_1, TEST_PROC_VAL_1, BPF_ANY));
+    mTestableGpuMem.setGpuMemTotalMap(mTestMap);
+    mGpuMem->sample();
+
+    auto& map = mTestableGpuMem.getGpuMemTotalMap();
+    ASSERT_RESULT_OK(map.deleteValue(TEST_PROC_KEY_1));
+    ASSERT_RESULT_OK(map.writeValue(TEST_PROC_KEY_2, TEST_PROC_VAL_2, BPF_ANY));
+    mGpuMem->sample();
+
+    EXPECT_EQ(mGpuMem->getProcGpuMemPeak(0, (uint32_t)TEST_PROC_KEY_1), 0);
+    EXPECT_EQ(mGpuMem->getProcGpuMemPeak((uint32_t)(TEST_PROC_KEY_2 >> 32),
+                                         (uint32_t)TEST_PROC_KEY_2),
+              TEST_PROC_VAL_2);
+}
+
 } // namespace
 } // namespace android
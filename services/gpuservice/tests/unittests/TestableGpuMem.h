@@ -32,6 +32,8 @@ public:
         mGpuMem->setGpuMemTotalMap(map);
     }
 
+    bpf::BpfMap<uint64_t, uint64_t>& getGpuMemTotalMap() { return mGpuMem->mGpuMemTotalMap; }
+
     std::string getGpuMemTraceGroup() { return mGpuMem->kGpuMemTraceGroup; }
 
     std::string getGpuMemTotalTracepoint() { return mGpuMem->kGpuMemTotalTracepoint; }
@@ -378,16 +378,28 @@ void InputClassifier::notifyKey(const NotifyKeyArgs* args) {
 }
 
 void InputClassifier::notifyMotion(const NotifyMotionArgs* args) {
-    std::scoped_lock lock(mLock);
     // MotionClassifier is only used for touch events, for now
-    const bool sendToMotionClassifier = mMotionClassifier && isTouchEvent(*args);
-    if (!sendToMotionClassifier) {
+    if (!isTouchEvent(*args)) {
         mListener->notifyMotion(args);
         return;
     }
 
+    MotionClassification classification = args->classification;
+    { // acquire lock
+        std::scoped_lock lock(mLock);
+        if (mMotionClassifier) {
+            classification = mMotionClassifier->classify(*args);
+        }
+    } // release lock
+
+    // The event is forwarded right away, with the classification made so far for its gesture.
+    // Only copy it when that changes the event, which is rare.
+    if (classification == args->classification) {
+        mListener->notifyMotion(args);
+        return;
+    }
     NotifyMotionArgs newArgs(*args);
-    newArgs.classification = mMotionClassifier->classify(newArgs);
+    newArgs.classification = classification;
     mListener->notifyMotion(&newArgs);
 }
 
@@ -407,10 +419,13 @@ void InputClassifier::notifySwitch(const NotifySwitchArgs* args) {
 }
 
 void InputClassifier::notifyDeviceReset(const NotifyDeviceResetArgs* args) {
-    std::scoped_lock lock(mLock);
-    if (mMotionClassifier) {
-        mMotionClassifier->reset(*args);
-    }
+    { // acquire lock
+        std::scoped_lock lock(mLock);
+        if (mMotionClassifier) {
+            mMotionClassifier->reset(*args);
+        }
+    } // release lock
+
     // continue to next stage
     mListener->notifyDeviceReset(args);
 }
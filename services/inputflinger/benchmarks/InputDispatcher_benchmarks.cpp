@@ -18,12 +18,31 @@
 
 #include <android/os/IInputConstants.h>
 #include <binder/Binder.h>
+#include <stdlib.h>
+#include <atomic>
 #include "../dispatcher/InputDispatcher.h"
 
 using android::os::IInputConstants;
 using android::os::InputEventInjectionResult;
 using android::os::InputEventInjectionSync;
 
+// Counts the allocations made by the whole process, the dispatcher thread included, so that
+// benchmarks can report what dispatching an event costs in allocations.
+static std::atomic<uint64_t> gAllocationCount{0};
+
+void* operator new(size_t size) {
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        abort();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
 namespace android::inputdispatcher {
 
 // An arbitrary device id.
@@ -165,6 +184,12 @@ protected:
         mConsumer = std::make_unique<InputConsumer>(mClientChannel);
     }
 
+    FakeInputReceiver(const sp<InputDispatcher>& dispatcher,
+                      std::unique_ptr<InputChannel> clientChannel)
+          : mDispatcher(dispatcher), mClientChannel(std::move(clientChannel)) {
+        mConsumer = std::make_unique<InputConsumer>(mClientChannel);
+    }
+
     virtual ~FakeInputReceiver() {}
 
     sp<InputDispatcher> mDispatcher;
@@ -202,14 +227,73 @@ public:
         mInfo.hasWallpaper = false;
         mInfo.paused = false;
         mInfo.ownerPid = INJECTOR_PID;
-        mInfo.ownerUid = INJECTOR_UID;
-        mInfo.displayId = ADISPLAY_ID_DEFAULT;
+        mInfo.ownerUid = mOwnerUid;
+        mInfo.displayId = mDisplayId;
+        mInfo.flags = mFlags;
+        mInfo.alpha = mAlpha;
+        mInfo.touchOcclusionMode = mTouchOcclusionMode;
 
         return true;
     }
 
+    void setFrame(const Rect& frame) { mFrame = frame; }
+
+    void setFlags(Flags<InputWindowInfo::Flag> flags) { mFlags = flags; }
+
+    void setDisplayId(int32_t displayId) { mDisplayId = displayId; }
+
+    void setOwnerUid(int32_t ownerUid) { mOwnerUid = ownerUid; }
+
+    void setAlpha(float alpha) { mAlpha = alpha; }
+
+    void setTouchOcclusionMode(TouchOcclusionMode mode) { mTouchOcclusionMode = mode; }
+
 protected:
     Rect mFrame;
+    Flags<InputWindowInfo::Flag> mFlags;
+    int32_t mDisplayId = ADISPLAY_ID_DEFAULT;
+    int32_t mOwnerUid = INJECTOR_UID;
+    float mAlpha = 1.0f;
+    TouchOcclusionMode mTouchOcclusionMode = TouchOcclusionMode::BLOCK_UNTRUSTED;
+};
+
+class FakeMonitorReceiver : public FakeInputReceiver {
+public:
+    FakeMonitorReceiver(const sp<InputDispatcher>& dispatcher, const std::string name,
+                        int32_t displayId, bool isGestureMonitor)
+          : FakeInputReceiver(dispatcher,
+                              *dispatcher->createInputMonitor(displayId, isGestureMonitor, name,
+                                                              INJECTOR_PID)) {}
+};
+
+// Reports the wall time and the allocations per event of the dispatching done between start()
+// and stop(), which include the work of the receivers.
+class EventCostReporter {
+public:
+    explicit EventCostReporter(benchmark::State& state) : mState(state) {}
+
+    void start() {
+        mStartTime = now();
+        mStartAllocationCount = gAllocationCount.load(std::memory_order_relaxed);
+    }
+
+    void stop(int64_t eventsPerIteration) {
+        const nsecs_t elapsed = now() - mStartTime;
+        const uint64_t allocations =
+                gAllocationCount.load(std::memory_order_relaxed) - mStartAllocationCount;
+        const int64_t events = mState.iterations() * eventsPerIteration;
+        if (events == 0) {
+            return;
+        }
+        mState.SetItemsProcessed(events);
+        mState.counters["ns_per_event"] = static_cast<double>(elapsed) / events;
+        mState.counters["allocs_per_event"] = static_cast<double>(allocations) / events;
+    }
+
+private:
+    benchmark::State& mState;
+    nsecs_t mStartTime = 0;
+    uint64_t mStartAllocationCount = 0;
 };
 
 static MotionEvent generateMotionEvent() {
@@ -267,6 +351,58 @@ static NotifyMotionArgs generateMotionArgs() {
     return args;
 }
 
+// Creates a stack of small windows on the given display above a window that will receive motion
+// events. None of the small windows contain the touched point, so that hit-testing has to look
+// past all of them. The receiving window is the last one of the returned stack.
+static std::vector<sp<InputWindowHandle>> createWindowStack(
+        const std::shared_ptr<FakeApplicationHandle>& application,
+        const sp<InputDispatcher>& dispatcher, int32_t displayId, int32_t windowCount) {
+    static constexpr int32_t TILE_SIZE = 100;
+    static constexpr int32_t TILES_PER_ROW = 10;
+    std::vector<sp<InputWindowHandle>> windows;
+    for (int32_t i = 0; i < windowCount - 1; i++) {
+        sp<FakeWindowHandle> tile =
+                new FakeWindowHandle(application, dispatcher,
+                                     "Tile " + std::to_string(displayId) + ":" +
+                                             std::to_string(i));
+        const int32_t left = (i % TILES_PER_ROW) * TILE_SIZE;
+        // Start below the touched point.
+        const int32_t top = (i / TILES_PER_ROW + 2) * TILE_SIZE;
+        tile->setFrame(Rect(left, top, left + TILE_SIZE, top + TILE_SIZE));
+        tile->setFlags(InputWindowInfo::Flag::NOT_TOUCH_MODAL);
+        tile->setDisplayId(displayId);
+        windows.push_back(tile);
+    }
+    sp<FakeWindowHandle> window =
+            new FakeWindowHandle(application, dispatcher,
+                                 "Fake Window " + std::to_string(displayId));
+    const int32_t height = (windowCount / TILES_PER_ROW + 2) * TILE_SIZE;
+    window->setFrame(Rect(0, 0, TILES_PER_ROW * TILE_SIZE, height));
+    window->setFlags(InputWindowInfo::Flag::NOT_TOUCH_MODAL);
+    window->setDisplayId(displayId);
+    windows.push_back(window);
+    return windows;
+}
+
+static FakeWindowHandle* receivingWindow(const std::vector<sp<InputWindowHandle>>& windows) {
+    return static_cast<FakeWindowHandle*>(windows.back().get());
+}
+
+// Sends a down and an up event at the touched point of the given display.
+static void notifyTap(InputDispatcher& dispatcher, NotifyMotionArgs& motionArgs,
+                      int32_t displayId) {
+    motionArgs.displayId = displayId;
+
+    motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+    motionArgs.downTime = now();
+    motionArgs.eventTime = motionArgs.downTime;
+    dispatcher.notifyMotion(&motionArgs);
+
+    motionArgs.action = AMOTION_EVENT_ACTION_UP;
+    motionArgs.eventTime = now();
+    dispatcher.notifyMotion(&motionArgs);
+}
+
 static void benchmarkNotifyMotion(benchmark::State& state) {
     // Create dispatcher
     sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
@@ -334,8 +470,228 @@ static void benchmarkInjectMotion(benchmark::State& state) {
     dispatcher->stop();
 }
 
+static void benchmarkNotifyMotionManyWindows(benchmark::State& state) {
+    // Create dispatcher
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    static constexpr int32_t WINDOW_COUNT = 200;
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::vector<sp<InputWindowHandle>> windows =
+            createWindowStack(application, dispatcher, ADISPLAY_ID_DEFAULT, WINDOW_COUNT);
+    FakeWindowHandle* window = receivingWindow(windows);
+
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+
+    for (auto _ : state) {
+        // Send ACTION_DOWN
+        motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        dispatcher->notifyMotion(&motionArgs);
+
+        // Send ACTION_UP
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        motionArgs.eventTime = now();
+        dispatcher->notifyMotion(&motionArgs);
+
+        window->consumeEvent();
+        window->consumeEvent();
+    }
+
+    dispatcher->stop();
+}
+
+// Taps each display in turn, with a stack of windows on every display. The argument is the
+// number of displays.
+static void benchmarkNotifyMotionMultiDisplay(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    static constexpr int32_t WINDOWS_PER_DISPLAY = 100;
+    const int32_t displayCount = static_cast<int32_t>(state.range(0));
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> windowsByDisplay;
+    for (int32_t displayId = 0; displayId < displayCount; displayId++) {
+        windowsByDisplay[displayId] =
+                createWindowStack(application, dispatcher, displayId, WINDOWS_PER_DISPLAY);
+    }
+    dispatcher->setInputWindows(windowsByDisplay);
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+
+    EventCostReporter reporter(state);
+    reporter.start();
+    int32_t displayId = 0;
+    for (auto _ : state) {
+        notifyTap(*dispatcher, motionArgs, displayId);
+
+        FakeWindowHandle* window = receivingWindow(windowsByDisplay[displayId]);
+        window->consumeEvent();
+        window->consumeEvent();
+
+        displayId = (displayId + 1) % displayCount;
+    }
+    reporter.stop(/*eventsPerIteration*/ 2);
+
+    dispatcher->stop();
+}
+
+// Taps a window while global monitors and gesture monitors watch the display, as the system UI
+// and gesture navigation do. The arguments are the number of global and gesture monitors.
+static void benchmarkNotifyMotionWithMonitors(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    static constexpr int32_t WINDOW_COUNT = 100;
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::vector<sp<InputWindowHandle>> windows =
+            createWindowStack(application, dispatcher, ADISPLAY_ID_DEFAULT, WINDOW_COUNT);
+    FakeWindowHandle* window = receivingWindow(windows);
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+
+    std::vector<std::unique_ptr<FakeMonitorReceiver>> monitors;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        monitors.push_back(
+                std::make_unique<FakeMonitorReceiver>(dispatcher,
+                                                      "Global Monitor " + std::to_string(i),
+                                                      ADISPLAY_ID_DEFAULT,
+                                                      /*isGestureMonitor*/ false));
+    }
+    for (int64_t i = 0; i < state.range(1); i++) {
+        monitors.push_back(
+                std::make_unique<FakeMonitorReceiver>(dispatcher,
+                                                      "Gesture Monitor " + std::to_string(i),
+                                                      ADISPLAY_ID_DEFAULT,
+                                                      /*isGestureMonitor*/ true));
+    }
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+
+    EventCostReporter reporter(state);
+    reporter.start();
+    for (auto _ : state) {
+        notifyTap(*dispatcher, motionArgs, ADISPLAY_ID_DEFAULT);
+
+        window->consumeEvent();
+        window->consumeEvent();
+        for (const auto& monitor : monitors) {
+            monitor->consumeEvent();
+            monitor->consumeEvent();
+        }
+    }
+    reporter.stop(/*eventsPerIteration*/ 2);
+
+    dispatcher->stop();
+}
+
+// Taps a window that is covered by translucent, untouchable windows of other apps, so that every
+// touch goes through the occlusion checks against all of them. The overlays are faint enough for
+// the touch to be allowed. The argument is the number of overlays.
+static void benchmarkNotifyMotionOccluded(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::vector<sp<InputWindowHandle>> windows;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        sp<FakeWindowHandle> overlay =
+                new FakeWindowHandle(application, dispatcher, "Overlay " + std::to_string(i));
+        overlay->setFrame(Rect(0, 0, FakeWindowHandle::WIDTH, FakeWindowHandle::HEIGHT));
+        overlay->setFlags(InputWindowInfo::Flag::NOT_TOUCHABLE);
+        // Every overlay has its own uid, which keeps the obscuring opacity per uid low.
+        overlay->setOwnerUid(INJECTOR_UID + 1 + static_cast<int32_t>(i));
+        overlay->setAlpha(0.1f);
+        overlay->setTouchOcclusionMode(TouchOcclusionMode::USE_OPACITY);
+        windows.push_back(overlay);
+    }
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, dispatcher, "Fake Window");
+    windows.push_back(window);
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+
+    EventCostReporter reporter(state);
+    reporter.start();
+    for (auto _ : state) {
+        notifyTap(*dispatcher, motionArgs, ADISPLAY_ID_DEFAULT);
+
+        window->consumeEvent();
+        window->consumeEvent();
+    }
+    reporter.stop(/*eventsPerIteration*/ 2);
+
+    dispatcher->stop();
+}
+
+// Taps a window while a global monitor only reads its events in large batches, so that its
+// socket fills up and the dispatcher keeps hitting WOULD_BLOCK and queueing the events that did
+// not fit.
+static void benchmarkNotifyMotionSlowConsumer(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    static constexpr int32_t WINDOW_COUNT = 100;
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::vector<sp<InputWindowHandle>> windows =
+            createWindowStack(application, dispatcher, ADISPLAY_ID_DEFAULT, WINDOW_COUNT);
+    FakeWindowHandle* window = receivingWindow(windows);
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+
+    FakeMonitorReceiver monitor(dispatcher, "Slow Monitor", ADISPLAY_ID_DEFAULT,
+                                /*isGestureMonitor*/ false);
+
+    // Far more events than the socket buffer holds, while staying well within the dispatching
+    // timeout so that the monitor is not reported as unresponsive.
+    static constexpr int64_t TAPS_PER_BATCH = 256;
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+
+    EventCostReporter reporter(state);
+    reporter.start();
+    int64_t pendingTaps = 0;
+    for (auto _ : state) {
+        notifyTap(*dispatcher, motionArgs, ADISPLAY_ID_DEFAULT);
+
+        window->consumeEvent();
+        window->consumeEvent();
+
+        if (++pendingTaps == TAPS_PER_BATCH) {
+            for (; pendingTaps > 0; pendingTaps--) {
+                monitor.consumeEvent();
+                monitor.consumeEvent();
+            }
+        }
+    }
+    reporter.stop(/*eventsPerIteration*/ 2);
+
+    for (; pendingTaps > 0; pendingTaps--) {
+        monitor.consumeEvent();
+        monitor.consumeEvent();
+    }
+
+    dispatcher->stop();
+}
+
 BENCHMARK(benchmarkNotifyMotion);
 BENCHMARK(benchmarkInjectMotion);
+BENCHMARK(benchmarkNotifyMotionManyWindows);
+BENCHMARK(benchmarkNotifyMotionMultiDisplay)->Arg(1)->Arg(2)->Arg(4);
+BENCHMARK(benchmarkNotifyMotionWithMonitors)->Args({1, 0})->Args({1, 1})->Args({2, 4});
+BENCHMARK(benchmarkNotifyMotionOccluded)->Arg(10)->Arg(100);
+BENCHMARK(benchmarkNotifyMotionSlowConsumer);
 
 } // namespace android::inputdispatcher
 
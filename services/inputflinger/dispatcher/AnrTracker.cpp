@@ -16,15 +16,25 @@
 
 #include "AnrTracker.h"
 
-namespace android::inputdispatcher {
+#include <algorithm>
+#include <limits>
 
-template <typename T>
-static T max(const T& a, const T& b) {
-    return a < b ? b : a;
-}
+namespace android::inputdispatcher {
 
 void AnrTracker::insert(nsecs_t timeoutTime, sp<IBinder> token) {
-    mAnrTimeouts.insert(std::make_pair(timeoutTime, std::move(token)));
+    std::deque<nsecs_t>& timeouts = mAnrTimeouts[token];
+    if (timeouts.empty()) {
+        timeouts.push_back(timeoutTime);
+        mFirstTimeouts.emplace(timeoutTime, std::move(token));
+        return;
+    }
+    if (timeoutTime >= timeouts.back()) {
+        timeouts.push_back(timeoutTime);
+        return;
+    }
+    const nsecs_t oldTimeout = timeouts.front();
+    timeouts.insert(std::upper_bound(timeouts.begin(), timeouts.end(), timeoutTime), timeoutTime);
+    updateFirstTimeout(token, oldTimeout, timeouts);
 }
 
 /**
@@ -32,42 +42,69 @@ void AnrTracker::insert(nsecs_t timeoutTime, sp<IBinder> token) {
  * (same time, same connection), then only remove one of them.
  */
 void AnrTracker::erase(nsecs_t timeoutTime, const sp<IBinder>& token) {
-    auto pair = std::make_pair(timeoutTime, token);
-    auto it = mAnrTimeouts.find(pair);
-    if (it != mAnrTimeouts.end()) {
+    auto it = mAnrTimeouts.find(token);
+    if (it == mAnrTimeouts.end()) {
+        return;
+    }
+    std::deque<nsecs_t>& timeouts = it->second;
+    const nsecs_t oldTimeout = timeouts.front();
+    if (timeoutTime == oldTimeout) {
+        timeouts.pop_front();
+    } else {
+        auto timeoutIt = std::lower_bound(timeouts.begin(), timeouts.end(), timeoutTime);
+        if (timeoutIt != timeouts.end() && *timeoutIt == timeoutTime) {
+            timeouts.erase(timeoutIt);
+        }
+        return; // the earliest timeout did not change
+    }
+
+    if (timeouts.empty()) {
+        mFirstTimeouts.erase(std::make_pair(oldTimeout, token));
         mAnrTimeouts.erase(it);
+        return;
     }
+    updateFirstTimeout(token, oldTimeout, timeouts);
 }
 
 void AnrTracker::eraseToken(const sp<IBinder>& token) {
-    for (auto it = mAnrTimeouts.begin(); it != mAnrTimeouts.end();) {
-        if (it->second == token) {
-            it = mAnrTimeouts.erase(it);
-        } else {
-            ++it;
-        }
+    auto it = mAnrTimeouts.find(token);
+    if (it == mAnrTimeouts.end()) {
+        return;
+    }
+    mFirstTimeouts.erase(std::make_pair(it->second.front(), token));
+    mAnrTimeouts.erase(it);
+}
+
+void AnrTracker::updateFirstTimeout(const sp<IBinder>& token, nsecs_t oldTimeout,
+                                    const std::deque<nsecs_t>& timeouts) {
+    if (timeouts.front() == oldTimeout) {
+        return;
     }
+    auto node = mFirstTimeouts.extract(std::make_pair(oldTimeout, token));
+    node.value().first = timeouts.front();
+    mFirstTimeouts.insert(std::move(node));
 }
 
 bool AnrTracker::empty() const {
-    return mAnrTimeouts.empty();
+    return mFirstTimeouts.empty();
 }
 
 // If empty() is false, return the time at which the next connection should cause an ANR
 // If empty() is true, return LONG_LONG_MAX
 nsecs_t AnrTracker::firstTimeout() const {
-    if (mAnrTimeouts.empty()) {
+    if (mFirstTimeouts.empty()) {
         return std::numeric_limits<nsecs_t>::max();
     }
-    return mAnrTimeouts.begin()->first;
+    return mFirstTimeouts.begin()->first;
 }
 
 const sp<IBinder>& AnrTracker::firstToken() const {
-    return mAnrTimeouts.begin()->second;
+    return mFirstTimeouts.begin()->second;
 }
 
 void AnrTracker::clear() {
     mAnrTimeouts.clear();
+    mFirstTimeouts.clear();
 }
 
 } // namespace android::inputdispatcher
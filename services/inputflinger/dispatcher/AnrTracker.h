@@ -19,7 +19,9 @@
 
 #include <binder/IBinder.h>
 #include <utils/Timers.h>
+#include <deque>
 #include <set>
+#include <unordered_map>
 
 namespace android::inputdispatcher {
 
@@ -43,16 +45,31 @@ public:
     const sp<IBinder>& firstToken() const;
 
 private:
-    // Optimization: use a multiset to keep track of the event timeouts. When an event is sent
-    // to the InputConsumer, we add an entry to this structure. We look at the smallest value to
-    // determine if any of the connections is unresponsive, and to determine when we should wake
-    // next for the future ANR check.
-    // Using a multiset helps quickly look up the next timeout due.
+    struct IBinderHash {
+        std::size_t operator()(const sp<IBinder>& b) const {
+            return std::hash<IBinder*>{}(b.get());
+        }
+    };
+
+    // Optimization: an entry is added when an event is sent to the InputConsumer, and removed
+    // when the consumer finishes it. Both happen for every dispatched event, and events are sent
+    // and finished in order on each connection, with timeouts that are usually increasing.
+    //
+    // So the timeouts are kept in a sorted queue per connection, where adding and removing an
+    // entry is usually a push_back and a pop_front. Only the earliest timeout of each connection
+    // is kept in mFirstTimeouts, which is ordered to find the next connection that is going to
+    // ANR. It changes only when that earliest timeout changes, and its nodes are moved rather than
+    // reallocated when it does.
     //
-    // We must use a multi-set, because it is plausible (although highly unlikely) to have entries
-    // from the same connection and same timestamp, but different sequence numbers.
+    // A connection may have duplicate timeouts, because it is plausible (although highly
+    // unlikely) for it to have entries with the same timestamp but different sequence numbers.
     // We are not tracking sequence numbers, and just allow duplicates to exist.
-    std::multiset<std::pair<nsecs_t /*timeoutTime*/, sp<IBinder> /*connectionToken*/>> mAnrTimeouts;
+    std::unordered_map<sp<IBinder>, std::deque<nsecs_t /*timeoutTime*/>, IBinderHash> mAnrTimeouts;
+    std::set<std::pair<nsecs_t /*timeoutTime*/, sp<IBinder> /*connectionToken*/>> mFirstTimeouts;
+
+    // Update mFirstTimeouts after the earliest timeout of a connection changed from oldTimeout.
+    void updateFirstTimeout(const sp<IBinder>& token, nsecs_t oldTimeout,
+                            const std::deque<nsecs_t>& timeouts);
 };
 
 } // namespace android::inputdispatcher
@@ -20,14 +20,77 @@
 
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/thread_annotations.h>
 #include <cutils/atomic.h>
 #include <inttypes.h>
 
+#include <mutex>
+#include <new>
+#include <vector>
+
 using android::base::GetBoolProperty;
 using android::base::StringPrintf;
 
 namespace android::inputdispatcher {
 
+namespace {
+
+// Keeps up to Capacity freed blocks of Size bytes to hand out again, so that the objects created
+// for every input event don't go through malloc once the dispatcher has warmed up. Blocks beyond
+// the capacity, e.g. during a burst of events, are returned to the heap.
+template <size_t Size, size_t Capacity>
+class RecyclingAllocator {
+public:
+    RecyclingAllocator() { mFreeBlocks.reserve(Capacity); }
+
+    void* allocate() {
+        {
+            std::scoped_lock lock(mLock);
+            if (!mFreeBlocks.empty()) {
+                void* block = mFreeBlocks.back();
+                mFreeBlocks.pop_back();
+                return block;
+            }
+        }
+        return ::operator new(Size);
+    }
+
+    void deallocate(void* block) {
+        {
+            std::scoped_lock lock(mLock);
+            if (mFreeBlocks.size() < Capacity) {
+                mFreeBlocks.push_back(block);
+                return;
+            }
+        }
+        ::operator delete(block);
+    }
+
+private:
+    // Entries are created on the reader and binder threads and released on the dispatcher thread.
+    std::mutex mLock;
+    std::vector<void*> mFreeBlocks GUARDED_BY(mLock);
+};
+
+// Enough for a few frames of multi-touch samples queued up across several connections.
+constexpr size_t MOTION_ENTRY_POOL_CAPACITY = 32;
+constexpr size_t DISPATCH_ENTRY_POOL_CAPACITY = 64;
+
+// Never destroyed, so that entries released during static destruction can still be recycled.
+auto& motionEntryAllocator() {
+    static auto* allocator =
+            new RecyclingAllocator<sizeof(MotionEntry), MOTION_ENTRY_POOL_CAPACITY>();
+    return *allocator;
+}
+
+auto& dispatchEntryAllocator() {
+    static auto* allocator =
+            new RecyclingAllocator<sizeof(DispatchEntry), DISPATCH_ENTRY_POOL_CAPACITY>();
+    return *allocator;
+}
+
+} // namespace
+
 VerifiedKeyEvent verifiedKeyEventFromKeyEntry(const KeyEntry& entry) {
     return {{VerifiedInputEvent::Type::KEY, entry.deviceId, entry.eventTime, entry.source,
              entry.displayId},
@@ -229,6 +292,21 @@ MotionEntry::MotionEntry(int32_t id, nsecs_t eventTime, int32_t deviceId, uint32
 
 MotionEntry::~MotionEntry() {}
 
+void* MotionEntry::operator new(size_t size) {
+    if (size != sizeof(MotionEntry)) {
+        return ::operator new(size);
+    }
+    return motionEntryAllocator().allocate();
+}
+
+void MotionEntry::operator delete(void* ptr, size_t size) {
+    if (size != sizeof(MotionEntry)) {
+        ::operator delete(ptr);
+        return;
+    }
+    motionEntryAllocator().deallocate(ptr);
+}
+
 std::string MotionEntry::getDescription() const {
     if (!GetBoolProperty("ro.debuggable", false)) {
         return "MotionEvent";
@@ -307,6 +385,21 @@ DispatchEntry::DispatchEntry(std::shared_ptr<EventEntry> eventEntry, int32_t tar
         resolvedAction(0),
         resolvedFlags(0) {}
 
+void* DispatchEntry::operator new(size_t size) {
+    if (size != sizeof(DispatchEntry)) {
+        return ::operator new(size);
+    }
+    return dispatchEntryAllocator().allocate();
+}
+
+void DispatchEntry::operator delete(void* ptr, size_t size) {
+    if (size != sizeof(DispatchEntry)) {
+        ::operator delete(ptr);
+        return;
+    }
+    dispatchEntryAllocator().deallocate(ptr);
+}
+
 uint32_t DispatchEntry::nextSeq() {
     // Sequence number 0 is reserved and will never be returned.
     uint32_t seq;
@@ -186,6 +186,11 @@ struct MotionEntry : EventEntry {
     std::string getDescription() const override;
 
     virtual ~MotionEntry();
+
+    // Motion entries are created for every sample, so their memory is recycled rather than
+    // returned to the heap.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
 };
 
 struct SensorEntry : EventEntry {
@@ -234,6 +239,11 @@ struct DispatchEntry {
 
     inline bool isSplit() const { return targetFlags & InputTarget::FLAG_SPLIT; }
 
+    // Dispatch entries are created for every event and target, so their memory is recycled rather
+    // than returned to the heap.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+
 private:
     static volatile int32_t sNextSeqAtomic;
 
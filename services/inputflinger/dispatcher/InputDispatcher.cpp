@@ -638,6 +638,9 @@ void InputDispatcher::processNoFocusedWindowAnrLocked() {
  * Return the time at which we should wake up next.
  */
 nsecs_t InputDispatcher::processAnrsLocked() {
+    if (!mNoFocusedWindowTimeoutTime.has_value() && mAnrTracker.empty()) {
+        return LONG_LONG_MAX; // nothing is waiting on an app; no need to wake up
+    }
     const nsecs_t currentTime = now();
     nsecs_t nextAnrCheck = LONG_LONG_MAX;
     // Check if we are waiting for a focused window to appear. Raise ANR if waited too long
@@ -663,7 +666,11 @@ nsecs_t InputDispatcher::processAnrsLocked() {
     sp<Connection> connection = getConnectionLocked(mAnrTracker.firstToken());
     if (connection == nullptr) {
         ALOGE("Could not find connection for entry %" PRId64, mAnrTracker.firstTimeout());
-        return nextAnrCheck;
+        // The timeout has already passed, so keeping the entry would make the dispatcher wake up
+        // immediately, over and over, until the connection is removed.
+        const sp<IBinder> token = mAnrTracker.firstToken();
+        mAnrTracker.eraseToken(token);
+        return LONG_LONG_MIN;
     }
     connection->responsive = false;
     // Stop waking up for this unresponsive connection
@@ -999,9 +1006,11 @@ sp<InputWindowHandle> InputDispatcher::findTouchedWindowAtLocked(int32_t display
         LOG_ALWAYS_FATAL(
                 "Must provide a valid touch state if adding portal windows or outside targets");
     }
-    // Traverse windows from front to back to find touched window.
-    const std::vector<sp<InputWindowHandle>>& windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& windowHandle : windowHandles) {
+    // Traverse windows from front to back to find touched window. Only the windows that the index
+    // says may be hit at this point need to be checked.
+    const WindowSpatialIndex& index = getWindowSpatialIndexLocked(displayId);
+    for (uint32_t position : index.getCandidatesAt(x, y)) {
+        const sp<InputWindowHandle>& windowHandle = index.getWindowHandle(position);
         if (ignoreDragWindow && haveSameToken(windowHandle, mDragState->dragWindow)) {
             continue;
         }
@@ -2558,16 +2567,18 @@ InputDispatcher::TouchOcclusionInfo InputDispatcher::computeTouchOcclusionInfoLo
         const sp<InputWindowHandle>& windowHandle, int32_t x, int32_t y) const {
     const InputWindowInfo* windowInfo = windowHandle->getInfo();
     int32_t displayId = windowInfo->displayId;
-    const std::vector<sp<InputWindowHandle>>& windowHandles = getWindowHandlesLocked(displayId);
+    const WindowSpatialIndex& index = getWindowSpatialIndexLocked(displayId);
+    const uint32_t windowPosition = index.getPosition(windowHandle);
     TouchOcclusionInfo info;
     info.hasBlockingOcclusion = false;
     info.obscuringOpacity = 0;
     info.obscuringUid = -1;
     std::map<int32_t, float> opacityByUid;
-    for (const sp<InputWindowHandle>& otherHandle : windowHandles) {
-        if (windowHandle == otherHandle) {
+    for (uint32_t position : index.getCandidatesAt(x, y)) {
+        if (position >= windowPosition) {
             break; // All future windows are below us. Exit early.
         }
+        const sp<InputWindowHandle>& otherHandle = index.getWindowHandle(position);
         const InputWindowInfo* otherInfo = otherHandle->getInfo();
         if (canBeObscuredBy(windowHandle, otherHandle) && otherInfo->frameContainsPoint(x, y) &&
             !haveSameApplicationToken(windowInfo, otherInfo)) {
@@ -2644,11 +2655,13 @@ bool InputDispatcher::isTouchTrustedLocked(const TouchOcclusionInfo& occlusionIn
 bool InputDispatcher::isWindowObscuredAtPointLocked(const sp<InputWindowHandle>& windowHandle,
                                                     int32_t x, int32_t y) const {
     int32_t displayId = windowHandle->getInfo()->displayId;
-    const std::vector<sp<InputWindowHandle>>& windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& otherHandle : windowHandles) {
-        if (windowHandle == otherHandle) {
+    const WindowSpatialIndex& index = getWindowSpatialIndexLocked(displayId);
+    const uint32_t windowPosition = index.getPosition(windowHandle);
+    for (uint32_t position : index.getCandidatesAt(x, y)) {
+        if (position >= windowPosition) {
             break; // All future windows are below us. Exit early.
         }
+        const sp<InputWindowHandle>& otherHandle = index.getWindowHandle(position);
         const InputWindowInfo* otherInfo = otherHandle->getInfo();
         if (canBeObscuredBy(windowHandle, otherHandle) &&
             otherInfo->frameContainsPoint(x, y)) {
@@ -3882,6 +3895,14 @@ void InputDispatcher::notifyMotion(const NotifyMotionArgs* args) {
             mLock.lock();
         }
 
+        if (args->id != IInputConstants::INVALID_INPUT_EVENT_ID &&
+            IdGenerator::getSource(args->id) == IdGenerator::Source::INPUT_READER &&
+            !mInputFilterEnabled) {
+            const bool isDown = args->action == AMOTION_EVENT_ACTION_DOWN;
+            mLatencyTracker.trackListener(args->id, isDown, args->eventTime, args->readTime,
+                                          args->displayId);
+        }
+
         // Just enqueue a new motion event.
         std::unique_ptr<MotionEntry> newEntry =
                 std::make_unique<MotionEntry>(args->id, args->eventTime, args->deviceId,
@@ -4322,6 +4343,12 @@ const std::vector<sp<InputWindowHandle>>& InputDispatcher::getWindowHandlesLocke
     return it != mWindowHandlesByDisplay.end() ? it->second : EMPTY_WINDOW_HANDLES;
 }
 
+const WindowSpatialIndex& InputDispatcher::getWindowSpatialIndexLocked(int32_t displayId) const {
+    static const WindowSpatialIndex EMPTY_INDEX;
+    auto it = mWindowSpatialIndexByDisplay.find(displayId);
+    return it != mWindowSpatialIndexByDisplay.end() ? it->second : EMPTY_INDEX;
+}
+
 sp<InputWindowHandle> InputDispatcher::getWindowHandleLocked(
         const sp<IBinder>& windowHandleToken) const {
     if (windowHandleToken == nullptr) {
@@ -4355,19 +4382,18 @@ sp<InputWindowHandle> InputDispatcher::getWindowHandleLocked(const sp<IBinder>&
 
 sp<InputWindowHandle> InputDispatcher::getWindowHandleLocked(
         const sp<InputWindowHandle>& windowHandle) const {
-    for (auto& it : mWindowHandlesByDisplay) {
-        const std::vector<sp<InputWindowHandle>>& windowHandles = it.second;
-        for (const sp<InputWindowHandle>& handle : windowHandles) {
-            if (handle->getId() == windowHandle->getId() &&
-                handle->getToken() == windowHandle->getToken()) {
-                if (windowHandle->getInfo()->displayId != it.first) {
-                    ALOGE("Found window %s in display %" PRId32
-                          ", but it should belong to display %" PRId32,
-                          windowHandle->getName().c_str(), it.first,
-                          windowHandle->getInfo()->displayId);
-                }
-                return handle;
+    const auto [first, last] = mWindowHandlesById.equal_range(windowHandle->getId());
+    for (auto it = first; it != last; ++it) {
+        const auto& [displayId, handle] = it->second;
+        if (handle->getId() == windowHandle->getId() &&
+            handle->getToken() == windowHandle->getToken()) {
+            if (windowHandle->getInfo()->displayId != displayId) {
+                ALOGE("Found window %s in display %" PRId32
+                      ", but it should belong to display %" PRId32,
+                      windowHandle->getName().c_str(), displayId,
+                      windowHandle->getInfo()->displayId);
             }
+            return handle;
         }
     }
     return nullptr;
@@ -4415,6 +4441,8 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
     if (inputWindowHandles.empty()) {
         // Remove all handles on a display if there are no windows left.
         mWindowHandlesByDisplay.erase(displayId);
+        mWindowSpatialIndexByDisplay.erase(displayId);
+        rebuildWindowHandleIndexLocked();
         return;
     }
 
@@ -4464,7 +4492,19 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
     }
 
     // Insert or replace
-    mWindowHandlesByDisplay[displayId] = newHandles;
+    mWindowHandlesByDisplay[displayId] = std::move(newHandles);
+    mWindowSpatialIndexByDisplay[displayId] =
+            WindowSpatialIndex(mWindowHandlesByDisplay[displayId]);
+    rebuildWindowHandleIndexLocked();
+}
+
+void InputDispatcher::rebuildWindowHandleIndexLocked() {
+    mWindowHandlesById.clear();
+    for (const auto& [displayId, handles] : mWindowHandlesByDisplay) {
+        for (const sp<InputWindowHandle>& handle : handles) {
+            mWindowHandlesById.emplace(handle->getId(), std::make_pair(displayId, handle));
+        }
+    }
 }
 
 void InputDispatcher::setInputWindows(
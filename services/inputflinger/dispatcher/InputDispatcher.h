@@ -34,6 +34,7 @@
 #include "Monitor.h"
 #include "TouchState.h"
 #include "TouchedWindow.h"
+#include "WindowSpatialIndex.h"
 
 #include <attestation/HmacKeyManager.h>
 #include <com/android/internal/compat/IPlatformCompatNative.h>
@@ -316,11 +317,21 @@ private:
 
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> mWindowHandlesByDisplay
             GUARDED_BY(mLock);
+    // The handles of mWindowHandlesByDisplay with their display, by window id. Lets window updates
+    // find the windows that are still present without going through every window of every
+    // display for each of them. Rebuilt whenever mWindowHandlesByDisplay changes.
+    std::unordered_multimap<int32_t /*id*/, std::pair<int32_t /*displayId*/, sp<InputWindowHandle>>>
+            mWindowHandlesById GUARDED_BY(mLock);
+    // Hit-testing index over mWindowHandlesByDisplay, rebuilt along with it.
+    std::unordered_map<int32_t, WindowSpatialIndex> mWindowSpatialIndexByDisplay GUARDED_BY(mLock);
     void setInputWindowsLocked(const std::vector<sp<InputWindowHandle>>& inputWindowHandles,
                                int32_t displayId) REQUIRES(mLock);
     // Get a reference to window handles by display, return an empty vector if not found.
     const std::vector<sp<InputWindowHandle>>& getWindowHandlesLocked(int32_t displayId) const
             REQUIRES(mLock);
+    // Get the hit-testing index of a display, return an empty index if not found.
+    const WindowSpatialIndex& getWindowSpatialIndexLocked(int32_t displayId) const
+            REQUIRES(mLock);
     sp<InputWindowHandle> getWindowHandleLocked(const sp<IBinder>& windowHandleToken) const
             REQUIRES(mLock);
 
@@ -341,6 +352,7 @@ private:
     void updateWindowHandlesForDisplayLocked(
             const std::vector<sp<InputWindowHandle>>& inputWindowHandles, int32_t displayId)
             REQUIRES(mLock);
+    void rebuildWindowHandleIndexLocked() REQUIRES(mLock);
 
     std::unordered_map<int32_t, TouchState> mTouchStatesByDisplay GUARDED_BY(mLock);
     std::unique_ptr<DragState> mDragState GUARDED_BY(mLock);
@@ -64,8 +64,9 @@ bool ConnectionTimeline::operator!=(const ConnectionTimeline& rhs) const {
     return !operator==(rhs);
 }
 
-InputEventTimeline::InputEventTimeline(bool isDown, nsecs_t eventTime, nsecs_t readTime)
-      : isDown(isDown), eventTime(eventTime), readTime(readTime) {}
+InputEventTimeline::InputEventTimeline(bool isDown, nsecs_t eventTime, nsecs_t readTime,
+                                       int32_t displayId)
+      : isDown(isDown), eventTime(eventTime), readTime(readTime), displayId(displayId) {}
 
 bool InputEventTimeline::operator==(const InputEventTimeline& rhs) const {
     if (connectionTimelines.size() != rhs.connectionTimelines.size()) {
@@ -80,7 +81,8 @@ bool InputEventTimeline::operator==(const InputEventTimeline& rhs) const {
             return false;
         }
     }
-    return isDown == rhs.isDown && eventTime == rhs.eventTime && readTime == rhs.readTime;
+    return isDown == rhs.isDown && eventTime == rhs.eventTime && readTime == rhs.readTime &&
+            displayId == rhs.displayId;
 }
 
 } // namespace android::inputdispatcher
@@ -18,6 +18,7 @@
 #include "LatencyAggregator.h"
 
 #include <inttypes.h>
+#include <cmath>
 
 #include <android-base/stringprintf.h>
 #include <input/Input.h>
@@ -120,9 +121,78 @@ AStatsManager_PullAtomCallbackReturn LatencyAggregator::pullAtomCallback(int32_t
     return pAggregator->pullData(data);
 }
 
+size_t LatencyHistogram::getBucketIndex(int64_t micros) {
+    if (micros < static_cast<int64_t>(SUB_BUCKET_COUNT)) {
+        return micros < 0 ? 0 : static_cast<size_t>(micros);
+    }
+    const uint64_t value = static_cast<uint64_t>(micros);
+    const size_t highestBit = 63 - __builtin_clzll(value);
+    if (highestBit >= MAX_LATENCY_BITS) {
+        return BUCKET_COUNT - 1;
+    }
+    const size_t shift = highestBit - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) & (SUB_BUCKET_COUNT - 1));
+}
+
+int64_t LatencyHistogram::getBucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return static_cast<int64_t>(index) + 1;
+    }
+    const size_t shift = index / SUB_BUCKET_COUNT - 1;
+    const int64_t subBucket = index % SUB_BUCKET_COUNT;
+    return (static_cast<int64_t>(SUB_BUCKET_COUNT) + subBucket + 1) << shift;
+}
+
+void LatencyHistogram::add(nsecs_t latency) {
+    mBuckets[getBucketIndex(ns2us(latency))]++;
+    mCount++;
+}
+
+nsecs_t LatencyHistogram::percentile(float fraction) const {
+    if (mCount == 0) {
+        return 0;
+    }
+    const size_t rank = std::max<size_t>(1, std::ceil(fraction * mCount));
+    size_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += mBuckets[i];
+        if (seen >= rank) {
+            return us2ns(getBucketUpperBound(i));
+        }
+    }
+    return us2ns(getBucketUpperBound(BUCKET_COUNT - 1));
+}
+
 void LatencyAggregator::processTimeline(const InputEventTimeline& timeline) {
     processStatistics(timeline);
     processSlowEvent(timeline);
+    processHistograms(timeline);
+}
+
+void LatencyAggregator::processHistograms(const InputEventTimeline& timeline) {
+    std::array<LatencyHistogram, SketchIndex::SIZE>& histograms =
+            mHistogramsByDisplay[timeline.displayId];
+    histograms[SketchIndex::EVENT_TO_READ].add(timeline.readTime - timeline.eventTime);
+
+    for (const auto& [connectionToken, connectionTimeline] : timeline.connectionTimelines) {
+        if (!connectionTimeline.isComplete()) {
+            continue;
+        }
+        const nsecs_t gpuCompletedTime =
+                connectionTimeline.graphicsTimeline[GraphicsTimeline::GPU_COMPLETED_TIME];
+        const nsecs_t presentTime =
+                connectionTimeline.graphicsTimeline[GraphicsTimeline::PRESENT_TIME];
+        histograms[SketchIndex::READ_TO_DELIVER].add(connectionTimeline.deliveryTime -
+                                                     timeline.readTime);
+        histograms[SketchIndex::DELIVER_TO_CONSUME].add(connectionTimeline.consumeTime -
+                                                        connectionTimeline.deliveryTime);
+        histograms[SketchIndex::CONSUME_TO_FINISH].add(connectionTimeline.finishTime -
+                                                       connectionTimeline.consumeTime);
+        histograms[SketchIndex::CONSUME_TO_GPU_COMPLETE].add(gpuCompletedTime -
+                                                             connectionTimeline.consumeTime);
+        histograms[SketchIndex::GPU_COMPLETE_TO_PRESENT].add(presentTime - gpuCompletedTime);
+        histograms[SketchIndex::END_TO_END].add(presentTime - timeline.eventTime);
+    }
 }
 
 void LatencyAggregator::processStatistics(const InputEventTimeline& timeline) {
@@ -256,6 +326,46 @@ void LatencyAggregator::processSlowEvent(const InputEventTimeline& timeline) {
     }
 }
 
+static const char* sketchIndexToString(size_t index) {
+    switch (index) {
+        case SketchIndex::EVENT_TO_READ:
+            return "EVENT_TO_READ";
+        case SketchIndex::READ_TO_DELIVER:
+            return "READ_TO_DELIVER";
+        case SketchIndex::DELIVER_TO_CONSUME:
+            return "DELIVER_TO_CONSUME";
+        case SketchIndex::CONSUME_TO_FINISH:
+            return "CONSUME_TO_FINISH";
+        case SketchIndex::CONSUME_TO_GPU_COMPLETE:
+            return "CONSUME_TO_GPU_COMPLETE";
+        case SketchIndex::GPU_COMPLETE_TO_PRESENT:
+            return "GPU_COMPLETE_TO_PRESENT";
+        case SketchIndex::END_TO_END:
+            return "END_TO_END";
+    }
+    return "UNKNOWN";
+}
+
+std::string LatencyAggregator::dumpHistograms(const char* prefix) const {
+    std::string histogramDump = StringPrintf("%s  Latency histograms (ms):\n", prefix);
+    if (mHistogramsByDisplay.empty()) {
+        return histogramDump + StringPrintf("%s    <none>\n", prefix);
+    }
+    for (const auto& [displayId, histograms] : mHistogramsByDisplay) {
+        histogramDump += StringPrintf("%s    displayId=%" PRId32 ":\n", prefix, displayId);
+        for (size_t i = 0; i < SketchIndex::SIZE; i++) {
+            const LatencyHistogram& histogram = histograms[i];
+            histogramDump +=
+                    StringPrintf("%s      %s: count=%zu p50=%.1f p90=%.1f p99=%.1f\n", prefix,
+                                 sketchIndexToString(i), histogram.count(),
+                                 histogram.percentile(0.5) * 1E-6,
+                                 histogram.percentile(0.9) * 1E-6,
+                                 histogram.percentile(0.99) * 1E-6);
+        }
+    }
+    return histogramDump;
+}
+
 std::string LatencyAggregator::dump(const char* prefix) {
     std::string sketchDump = StringPrintf("%s  Sketches:\n", prefix);
     for (size_t i = 0; i < SketchIndex::SIZE; i++) {
@@ -276,7 +386,8 @@ std::string LatencyAggregator::dump(const char* prefix) {
             StringPrintf("%s  mLastSlowEventTime=%" PRId64 "\n", prefix, mLastSlowEventTime) +
             StringPrintf("%s  mNumEventsSinceLastSlowEventReport = %zu\n", prefix,
                          mNumEventsSinceLastSlowEventReport) +
-            StringPrintf("%s  mNumSkippedSlowEvents = %zu\n", prefix, mNumSkippedSlowEvents);
+            StringPrintf("%s  mNumSkippedSlowEvents = %zu\n", prefix, mNumSkippedSlowEvents) +
+            dumpHistograms(prefix);
 }
 
 } // namespace android::inputdispatcher
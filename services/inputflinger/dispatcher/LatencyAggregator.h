@@ -21,6 +21,8 @@
 #include <statslog.h>
 #include <utils/Timers.h>
 
+#include <map>
+
 #include "InputEventTimeline.h"
 
 namespace android::inputdispatcher {
@@ -46,6 +48,37 @@ enum SketchIndex : size_t {
 // GraphicsTimeline::GPU_COMPLETED_TIME
 // GraphicsTimeline::PRESENT_TIME
 
+/**
+ * A fixed-size histogram of latencies with logarithmically spaced buckets. Each power of two
+ * microseconds is split into SUB_BUCKET_COUNT linear buckets, so a recorded value is off by at
+ * most 1 / SUB_BUCKET_COUNT of its magnitude. Adding a value is a few integer operations and never
+ * allocates, which makes it cheap enough to keep running for every event.
+ */
+class LatencyHistogram {
+public:
+    void add(nsecs_t latency);
+    size_t count() const { return mCount; }
+    /**
+     * Return an approximate latency below which the given fraction (0 to 1) of the recorded
+     * values lie. Return 0 if no values have been recorded.
+     */
+    nsecs_t percentile(float fraction) const;
+
+private:
+    static constexpr size_t SUB_BUCKET_BITS = 3;
+    static constexpr size_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    // Latencies of 2^24 us (about 16 seconds) and above all go into the last bucket
+    static constexpr size_t MAX_LATENCY_BITS = 24;
+    static constexpr size_t BUCKET_COUNT = (MAX_LATENCY_BITS - SUB_BUCKET_BITS + 1) *
+            SUB_BUCKET_COUNT;
+
+    static size_t getBucketIndex(int64_t micros);
+    static int64_t getBucketUpperBound(size_t index);
+
+    std::array<uint32_t, BUCKET_COUNT> mBuckets{};
+    size_t mCount = 0;
+};
+
 /**
  * Keep sketches of the provided events and report slow events
  */
@@ -83,6 +116,13 @@ private:
             mMoveSketches;
     // How many events have been processed so far
     size_t mNumSketchEventsProcessed = 0;
+
+    // ---------- Histogram handling ----------
+    // Unlike the sketches, the histograms are never capped or reset, and are only used for dumps.
+    void processHistograms(const InputEventTimeline& timeline);
+    std::string dumpHistograms(const char* prefix) const;
+    std::map<int32_t /*displayId*/, std::array<LatencyHistogram, SketchIndex::SIZE>>
+            mHistogramsByDisplay;
 };
 
 } // namespace android::inputdispatcher
@@ -67,7 +67,7 @@ LatencyTracker::LatencyTracker(InputEventTimelineProcessor* processor)
 }
 
 void LatencyTracker::trackListener(int32_t inputEventId, bool isDown, nsecs_t eventTime,
-                                   nsecs_t readTime) {
+                                   nsecs_t readTime, int32_t displayId) {
     reportAndPruneMatureRecords(eventTime);
     const auto it = mTimelines.find(inputEventId);
     if (it != mTimelines.end()) {
@@ -81,7 +81,7 @@ void LatencyTracker::trackListener(int32_t inputEventId, bool isDown, nsecs_t ev
         eraseByKeyAndValue(mEventTimes, eventTime, inputEventId);
         return;
     }
-    mTimelines.emplace(inputEventId, InputEventTimeline(isDown, eventTime, readTime));
+    mTimelines.emplace(inputEventId, InputEventTimeline(isDown, eventTime, readTime, displayId));
     mEventTimes.emplace(eventTime, inputEventId);
 }
 
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WindowSpatialIndex.h"
+
+#include <algorithm>
+
+namespace android::inputdispatcher {
+
+namespace {
+
+Rect unionOf(const Rect& a, const Rect& b) {
+    return Rect(std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right),
+                std::max(a.bottom, b.bottom));
+}
+
+// The area in which the window can be hit by a touch, or in which it obscures other windows.
+Rect getHitBounds(const InputWindowInfo& info) {
+    Rect bounds = info.touchableRegion.getBounds();
+    const Rect frame(info.frameLeft, info.frameTop, info.frameRight, info.frameBottom);
+    if (frame.isEmpty()) {
+        return bounds;
+    }
+    if (bounds.isEmpty()) {
+        return frame;
+    }
+    return unionOf(bounds, frame);
+}
+
+bool canBeHitEverywhere(const InputWindowInfo& info) {
+    const bool isTouchModal = !info.flags.test(InputWindowInfo::Flag::NOT_FOCUSABLE) &&
+            !info.flags.test(InputWindowInfo::Flag::NOT_TOUCH_MODAL);
+    return isTouchModal || info.flags.test(InputWindowInfo::Flag::WATCH_OUTSIDE_TOUCH);
+}
+
+} // namespace
+
+WindowSpatialIndex::WindowSpatialIndex(const std::vector<sp<InputWindowHandle>>& windowHandles)
+      : mWindowHandles(windowHandles) {
+    std::vector<Rect> hitBounds;
+    hitBounds.reserve(mWindowHandles.size());
+    for (uint32_t i = 0; i < mWindowHandles.size(); i++) {
+        const InputWindowInfo& info = *mWindowHandles[i]->getInfo();
+        mPositions.emplace(mWindowHandles[i].get(), i);
+        if (canBeHitEverywhere(info)) {
+            mEverywhere.push_back(i);
+            hitBounds.push_back(Rect::EMPTY_RECT);
+            continue;
+        }
+        hitBounds.push_back(getHitBounds(info));
+        if (hitBounds.back().isEmpty()) {
+            // Can't be hit anywhere, leave it out of the grid.
+            continue;
+        }
+        mBounds = mBounds.isEmpty() ? hitBounds.back() : unionOf(mBounds, hitBounds.back());
+    }
+    if (mBounds.isEmpty()) {
+        return;
+    }
+
+    mCells.resize(GRID_SIZE * GRID_SIZE);
+    for (uint32_t i = 0; i < mWindowHandles.size(); i++) {
+        const bool everywhere = canBeHitEverywhere(*mWindowHandles[i]->getInfo());
+        if (!everywhere && hitBounds[i].isEmpty()) {
+            continue;
+        }
+        const int32_t left = everywhere ? 0 : cellXAt(hitBounds[i].left);
+        const int32_t top = everywhere ? 0 : cellYAt(hitBounds[i].top);
+        const int32_t right = everywhere ? GRID_SIZE - 1 : cellXAt(hitBounds[i].right - 1);
+        const int32_t bottom = everywhere ? GRID_SIZE - 1 : cellYAt(hitBounds[i].bottom - 1);
+        for (int32_t y = top; y <= bottom; y++) {
+            for (int32_t x = left; x <= right; x++) {
+                mCells[y * GRID_SIZE + x].push_back(i);
+            }
+        }
+    }
+}
+
+int32_t WindowSpatialIndex::cellXAt(int32_t x) const {
+    return static_cast<int32_t>(int64_t(x - mBounds.left) * GRID_SIZE / mBounds.getWidth());
+}
+
+int32_t WindowSpatialIndex::cellYAt(int32_t y) const {
+    return static_cast<int32_t>(int64_t(y - mBounds.top) * GRID_SIZE / mBounds.getHeight());
+}
+
+const std::vector<uint32_t>& WindowSpatialIndex::getCandidatesAt(int32_t x, int32_t y) const {
+    if (x < mBounds.left || x >= mBounds.right || y < mBounds.top || y >= mBounds.bottom) {
+        return mEverywhere;
+    }
+    return mCells[cellYAt(y) * GRID_SIZE + cellXAt(x)];
+}
+
+uint32_t WindowSpatialIndex::getPosition(const sp<InputWindowHandle>& windowHandle) const {
+    auto it = mPositions.find(windowHandle.get());
+    return it != mPositions.end() ? it->second : static_cast<uint32_t>(mWindowHandles.size());
+}
+
+} // namespace android::inputdispatcher
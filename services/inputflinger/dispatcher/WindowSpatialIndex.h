@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include <input/InputWindow.h>
+#include <ui/Rect.h>
+
+namespace android::inputdispatcher {
+
+// Buckets the windows of one display into a uniform grid over the area they cover, so that a touch
+// only has to be tested against the windows around it instead of every window on the display.
+//
+// A window is put in every cell that its frame or touchable region intersects. Windows that can
+// be hit from anywhere on the display (touch modal windows) or that need to hear about touches
+// anywhere (WATCH_OUTSIDE_TOUCH) are put in every cell. Within a cell the windows keep their z
+// order, so callers can walk the candidates front to back exactly like they would walk the whole
+// window list, and still have to apply their own checks to each candidate.
+//
+// The index is a snapshot of the window infos at construction time and has to be rebuilt whenever
+// the window list or any of the window infos change.
+class WindowSpatialIndex {
+public:
+    WindowSpatialIndex() = default;
+    explicit WindowSpatialIndex(const std::vector<sp<InputWindowHandle>>& windowHandles);
+
+    // Returns the z order positions of the windows that may contain the point, front to back.
+    const std::vector<uint32_t>& getCandidatesAt(int32_t x, int32_t y) const;
+
+    const sp<InputWindowHandle>& getWindowHandle(uint32_t position) const {
+        return mWindowHandles[position];
+    }
+
+    // Returns the z order position of the window, or the number of windows if it isn't indexed.
+    uint32_t getPosition(const sp<InputWindowHandle>& windowHandle) const;
+
+private:
+    // Cells per side of the grid. Kept small so that rebuilding the index on every window update
+    // stays cheap even when most windows cover the whole display.
+    static constexpr int32_t GRID_SIZE = 8;
+
+    std::vector<sp<InputWindowHandle>> mWindowHandles;
+    std::unordered_map<const InputWindowHandle*, uint32_t> mPositions;
+    // The area covered by the grid. Only the windows in mEverywhere can be hit outside of it.
+    Rect mBounds = Rect::EMPTY_RECT;
+    std::vector<std::vector<uint32_t>> mCells;
+    std::vector<uint32_t> mEverywhere;
+
+    int32_t cellXAt(int32_t x) const;
+    int32_t cellYAt(int32_t y) const;
+};
+
+} // namespace android::inputdispatcher
@@ -26,6 +26,7 @@
 #include <string.h>
 #include <sys/capability.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/inotify.h>
 #include <sys/ioctl.h>
 #include <sys/limits.h>
@@ -678,7 +679,10 @@ EventHub::EventHub(void)
         mNeedToScanDevices(true),
         mPendingEventCount(0),
         mPendingEventIndex(0),
-        mPendingINotify(false) {
+        mPendingINotify(false),
+        mUnfinishedProbeCount(0),
+        mProbeThreadsExiting(false),
+        mPendingProbeEvent(false) {
     ensureProcessCanBlockSuspend();
 
     mEpollFd = epoll_create1(EPOLL_CLOEXEC);
@@ -722,15 +726,31 @@ EventHub::EventHub(void)
     result = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeReadPipeFd, &eventItem);
     LOG_ALWAYS_FATAL_IF(result != 0, "Could not add wake read pipe to epoll instance.  errno=%d",
                         errno);
+
+    mProbeEventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    LOG_ALWAYS_FATAL_IF(mProbeEventFd < 0, "Could not create probe eventfd.  errno=%d", errno);
+
+    eventItem.data.fd = mProbeEventFd;
+    result = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mProbeEventFd, &eventItem);
+    LOG_ALWAYS_FATAL_IF(result != 0, "Could not add probe eventfd to epoll instance.  errno=%d",
+                        errno);
 }
 
 EventHub::~EventHub(void) {
+    {
+        std::scoped_lock lock(mProbeLock);
+        mProbeThreadsExiting = true;
+    }
+    mProbeCondition.notify_all();
+    mProbeThreads.clear();
+
     closeAllDevicesLocked();
 
     ::close(mEpollFd);
     ::close(mINotifyFd);
     ::close(mWakeReadPipeFd);
     ::close(mWakeWritePipeFd);
+    ::close(mProbeEventFd);
 }
 
 InputDeviceIdentifier EventHub::getDeviceIdentifier(int32_t deviceId) const {
@@ -1535,7 +1555,8 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             }
         }
 
-        if (mNeedToSendFinishedDeviceScan) {
+        // Devices that are still being probed are reported as part of the same scan.
+        if (mNeedToSendFinishedDeviceScan && mProbingDevices.empty()) {
             mNeedToSendFinishedDeviceScan = false;
             event->when = now;
             event->type = FINISHED_DEVICE_SCAN;
@@ -1574,6 +1595,16 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
                 continue;
             }
 
+            if (eventItem.data.fd == mProbeEventFd) {
+                if (eventItem.events & EPOLLIN) {
+                    mPendingProbeEvent = true;
+                } else {
+                    ALOGW("Received unexpected epoll event 0x%08x for probe eventfd.",
+                          eventItem.events);
+                }
+                continue;
+            }
+
             Device* device = getDeviceByFdLocked(eventItem.data.fd);
             if (device == nullptr) {
                 ALOGE("Received unexpected epoll event 0x%08x for unknown fd %d.", eventItem.events,
@@ -1620,12 +1651,15 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
                     ALOGE("could not get event (wrong size: %d)", readSize);
                 } else {
                     int32_t deviceId = device->id == mBuiltInKeyboardId ? 0 : device->id;
+                    // All the events of one read were read at the same time, so there is no need
+                    // to query the clock for each of them.
+                    const nsecs_t readTime = systemTime(SYSTEM_TIME_MONOTONIC);
 
                     size_t count = size_t(readSize) / sizeof(struct input_event);
                     for (size_t i = 0; i < count; i++) {
                         struct input_event& iev = readBuffer[i];
                         event->when = processEventTimestamp(iev);
-                        event->readTime = systemTime(SYSTEM_TIME_MONOTONIC);
+                        event->readTime = readTime;
                         event->deviceId = deviceId;
                         event->type = iev.type;
                         event->code = iev.code;
@@ -1660,6 +1694,13 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             deviceChanged = true;
         }
 
+        // Add the devices that finished probing on the probe threads.
+        if (mPendingProbeEvent && mPendingEventIndex >= mPendingEventCount) {
+            mPendingProbeEvent = false;
+            finishDeviceProbesLocked();
+            deviceChanged = true;
+        }
+
         // Report added or removed devices immediately.
         if (deviceChanged) {
             continue;
@@ -1743,6 +1784,9 @@ void EventHub::scanDevicesLocked() {
     if (result < 0) {
         ALOGE("scan dir failed for %s", DEVICE_PATH);
     }
+    // Report the devices found by the scan together, as if they had been opened serially.
+    waitForDeviceProbesLocked();
+    finishDeviceProbesLocked();
     if (isV4lScanningEnabled()) {
         result = scanVideoDirLocked(VIDEO_DEVICE_PATH);
         if (result != OK) {
@@ -1857,11 +1901,108 @@ void EventHub::openDeviceLocked(const std::string& devicePath) {
             return; // device was already registered
         }
     }
-
-    char buffer[80];
+    const auto probeIt = mProbingDevices.find(devicePath);
+    if (probeIt != mProbingDevices.end()) {
+        if (probeIt->second == ProbeState::REMOVED) {
+            probeIt->second = ProbeState::REOPENED;
+        }
+        return; // device is already being probed
+    }
 
     ALOGV("Opening device: %s", devicePath.c_str());
 
+    mProbingDevices.emplace(devicePath, ProbeState::PROBING);
+    auto probe = std::make_unique<DeviceProbe>(mNextDeviceId++, devicePath, mExcludedDevices);
+
+    size_t unfinishedProbeCount;
+    {
+        std::scoped_lock lock(mProbeLock);
+        mPendingProbes.push_back(std::move(probe));
+        unfinishedProbeCount = ++mUnfinishedProbeCount;
+    }
+    mProbeCondition.notify_one();
+
+    if (mProbeThreads.size() < MAX_DEVICE_PROBE_THREADS &&
+        mProbeThreads.size() < unfinishedProbeCount) {
+        mProbeThreads.push_back(std::make_unique<InputThread>(
+                "InputProbe", [this]() { processDeviceProbe(); },
+                [this]() { mProbeCondition.notify_all(); }));
+    }
+}
+
+void EventHub::processDeviceProbe() {
+    std::unique_ptr<DeviceProbe> probe;
+    {
+        std::unique_lock lock(mProbeLock);
+        mProbeCondition.wait(lock,
+                             [this]() { return mProbeThreadsExiting || !mPendingProbes.empty(); });
+        if (mProbeThreadsExiting) {
+            return;
+        }
+        probe = std::move(mPendingProbes.front());
+        mPendingProbes.pop_front();
+    }
+
+    probeDevice(*probe);
+
+    {
+        std::scoped_lock lock(mProbeLock);
+        mFinishedProbes.push_back(std::move(probe));
+        mUnfinishedProbeCount--;
+
+        const uint64_t value = 1;
+        if (TEMP_FAILURE_RETRY(write(mProbeEventFd, &value, sizeof(value))) != sizeof(value)) {
+            ALOGW("Could not signal device probe: %s", strerror(errno));
+        }
+    }
+    mProbeFinishedCondition.notify_all();
+}
+
+void EventHub::waitForDeviceProbesLocked() {
+    std::unique_lock lock(mProbeLock);
+    mProbeFinishedCondition.wait(lock, [this]() { return mUnfinishedProbeCount == 0; });
+}
+
+void EventHub::finishDeviceProbesLocked() {
+    std::vector<std::unique_ptr<DeviceProbe>> probes;
+    {
+        std::scoped_lock lock(mProbeLock);
+        uint64_t value;
+        if (TEMP_FAILURE_RETRY(read(mProbeEventFd, &value, sizeof(value))) < 0 &&
+            errno != EAGAIN) {
+            ALOGW("Could not read device probe signal: %s", strerror(errno));
+        }
+        probes.swap(mFinishedProbes);
+    }
+
+    for (std::unique_ptr<DeviceProbe>& probe : probes) {
+        const auto it = mProbingDevices.find(probe->path);
+        LOG_ALWAYS_FATAL_IF(it == mProbingDevices.end(), "No probe in progress for %s",
+                            probe->path.c_str());
+        const ProbeState state = it->second;
+        mProbingDevices.erase(it);
+
+        switch (state) {
+            case ProbeState::PROBING:
+                if (probe->device) {
+                    finishOpenDeviceLocked(std::move(probe->device), probe->keyMapStatus);
+                }
+                break;
+            case ProbeState::REMOVED:
+                ALOGV("Device %s was removed while it was being probed", probe->path.c_str());
+                break;
+            case ProbeState::REOPENED:
+                openDeviceLocked(probe->path);
+                break;
+        }
+    }
+}
+
+void EventHub::probeDevice(DeviceProbe& probe) {
+    const std::string& devicePath = probe.path;
+    const int32_t deviceId = probe.id;
+    char buffer[80];
+
     int fd = open(devicePath.c_str(), O_RDWR | O_CLOEXEC | O_NONBLOCK);
     if (fd < 0) {
         ALOGE("could not open %s, %s\n", devicePath.c_str(), strerror(errno));
@@ -1879,8 +2020,8 @@ void EventHub::openDeviceLocked(const std::string& devicePath) {
     }
 
     // Check to see if the device is on our excluded list
-    for (size_t i = 0; i < mExcludedDevices.size(); i++) {
-        const std::string& item = mExcludedDevices[i];
+    for (size_t i = 0; i < probe.excludedDevices.size(); i++) {
+        const std::string& item = probe.excludedDevices[i];
         if (identifier.name == item) {
             ALOGI("ignoring event id %s driver %s\n", devicePath.c_str(), item.c_str());
             close(fd);
@@ -1924,23 +2065,9 @@ void EventHub::openDeviceLocked(const std::string& devicePath) {
         identifier.uniqueId = buffer;
     }
 
-    // Fill in the descriptor.
-    assignDescriptorLocked(identifier);
-
     // Allocate device.  (The device object takes ownership of the fd at this point.)
-    int32_t deviceId = mNextDeviceId++;
     std::unique_ptr<Device> device = std::make_unique<Device>(fd, deviceId, devicePath, identifier);
 
-    ALOGV("add device %d: %s\n", deviceId, devicePath.c_str());
-    ALOGV("  bus:        %04x\n"
-          "  vendor      %04x\n"
-          "  product     %04x\n"
-          "  version     %04x\n",
-          identifier.bus, identifier.vendor, identifier.product, identifier.version);
-    ALOGV("  name:       \"%s\"\n", identifier.name.c_str());
-    ALOGV("  location:   \"%s\"\n", identifier.location.c_str());
-    ALOGV("  unique id:  \"%s\"\n", identifier.uniqueId.c_str());
-    ALOGV("  descriptor: \"%s\"\n", identifier.descriptor.c_str());
     ALOGV("  driver:     v%d.%d.%d\n", driverVersion >> 16, (driverVersion >> 8) & 0xff,
           driverVersion & 0xff);
 
@@ -1952,16 +2079,7 @@ void EventHub::openDeviceLocked(const std::string& devicePath) {
     // Check the sysfs root path
     std::optional<std::filesystem::path> sysfsRootPath = getSysfsRootPath(devicePath.c_str());
     if (sysfsRootPath.has_value()) {
-        std::shared_ptr<AssociatedDevice> associatedDevice;
-        for (const auto& [id, dev] : mDevices) {
-            if (device->identifier.descriptor == dev->identifier.descriptor &&
-                !dev->associatedDevice) {
-                associatedDevice = dev->associatedDevice;
-            }
-        }
-        if (!associatedDevice) {
-            associatedDevice = std::make_shared<AssociatedDevice>(sysfsRootPath.value());
-        }
+        auto associatedDevice = std::make_shared<AssociatedDevice>(sysfsRootPath.value());
         hasBattery = associatedDevice->configureBatteryLocked();
         hasLights = associatedDevice->configureLightsLocked();
 
@@ -2071,22 +2189,14 @@ void EventHub::openDeviceLocked(const std::string& devicePath) {
     // Load the key map.
     // We need to do this for joysticks too because the key layout may specify axes, and for
     // sensor as well because the key layout may specify the axes to sensor data mapping.
-    status_t keyMapStatus = NAME_NOT_FOUND;
     if (device->classes.any(InputDeviceClass::KEYBOARD | InputDeviceClass::JOYSTICK |
                             InputDeviceClass::SENSOR)) {
         // Load the keymap for the device.
-        keyMapStatus = device->loadKeyMapLocked();
+        probe.keyMapStatus = device->loadKeyMapLocked();
     }
 
     // Configure the keyboard, gamepad or virtual keyboard.
     if (device->classes.test(InputDeviceClass::KEYBOARD)) {
-        // Register the keyboard as a built-in keyboard if it is eligible.
-        if (!keyMapStatus && mBuiltInKeyboardId == NO_BUILT_IN_KEYBOARD &&
-            isEligibleBuiltInKeyboard(device->identifier, device->configuration.get(),
-                                      &device->keyMap)) {
-            mBuiltInKeyboardId = device->id;
-        }
-
         // 'Q' key support = cheap test of whether this is an alpha-capable kbd
         if (device->hasKeycodeLocked(AKEYCODE_Q)) {
             device->classes |= InputDeviceClass::ALPHAKEY;
@@ -2137,6 +2247,35 @@ void EventHub::openDeviceLocked(const std::string& devicePath) {
         device->classes |= InputDeviceClass::EXTERNAL;
     }
 
+    probe.device = std::move(device);
+}
+
+void EventHub::finishOpenDeviceLocked(std::unique_ptr<Device> device, status_t keyMapStatus) {
+    const int32_t deviceId = device->id;
+    const InputDeviceIdentifier& identifier = device->identifier;
+
+    // Fill in the descriptor.
+    assignDescriptorLocked(device->identifier);
+
+    ALOGV("add device %d: %s\n", deviceId, device->path.c_str());
+    ALOGV("  bus:        %04x\n"
+          "  vendor      %04x\n"
+          "  product     %04x\n"
+          "  version     %04x\n",
+          identifier.bus, identifier.vendor, identifier.product, identifier.version);
+    ALOGV("  name:       \"%s\"\n", identifier.name.c_str());
+    ALOGV("  location:   \"%s\"\n", identifier.location.c_str());
+    ALOGV("  unique id:  \"%s\"\n", identifier.uniqueId.c_str());
+    ALOGV("  descriptor: \"%s\"\n", identifier.descriptor.c_str());
+
+    // Register the keyboard as a built-in keyboard if it is eligible.
+    if (device->classes.test(InputDeviceClass::KEYBOARD) && !keyMapStatus &&
+        mBuiltInKeyboardId == NO_BUILT_IN_KEYBOARD &&
+        isEligibleBuiltInKeyboard(device->identifier, device->configuration.get(),
+                                  &device->keyMap)) {
+        mBuiltInKeyboardId = device->id;
+    }
+
     if (device->classes.any(InputDeviceClass::JOYSTICK | InputDeviceClass::DPAD) &&
         device->classes.test(InputDeviceClass::GAMEPAD)) {
         device->controllerNumber = getNextControllerNumberLocked(device->identifier.name);
@@ -2151,7 +2290,7 @@ void EventHub::openDeviceLocked(const std::string& devicePath) {
 
     ALOGI("New device: id=%d, fd=%d, path='%s', name='%s', classes=%s, "
           "configuration='%s', keyLayout='%s', keyCharacterMap='%s', builtinKeyboard=%s, ",
-          deviceId, fd, devicePath.c_str(), device->identifier.name.c_str(),
+          deviceId, device->fd, device->path.c_str(), device->identifier.name.c_str(),
           device->classes.string().c_str(), device->configurationFile.c_str(),
           device->keyMap.keyLayoutFile.c_str(), device->keyMap.keyCharacterMapFile.c_str(),
           toString(mBuiltInKeyboardId == deviceId));
@@ -2281,6 +2420,11 @@ void EventHub::closeDeviceByPathLocked(const std::string& devicePath) {
         closeDeviceLocked(*device);
         return;
     }
+    const auto probeIt = mProbingDevices.find(devicePath);
+    if (probeIt != mProbingDevices.end()) {
+        probeIt->second = ProbeState::REMOVED;
+        return;
+    }
     ALOGV("Remove device: %s not found, device may already have been removed.", devicePath.c_str());
 }
 
@@ -2310,6 +2454,9 @@ void EventHub::closeVideoDeviceByPathLocked(const std::string& devicePath) {
 
 void EventHub::closeAllDevicesLocked() {
     mUnattachedVideoDevices.clear();
+    for (auto& [path, state] : mProbingDevices) {
+        state = ProbeState::REMOVED;
+    }
     while (!mDevices.empty()) {
         closeDeviceLocked(*(mDevices.begin()->second));
     }
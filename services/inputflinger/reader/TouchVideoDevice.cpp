@@ -201,10 +201,13 @@ std::optional<TouchVideoFrame> TouchVideoDevice::readFrame() {
         ALOGW("The timestamp %ld.%ld was not acquired using CLOCK_MONOTONIC", buf.timestamp.tv_sec,
               buf.timestamp.tv_usec);
     }
-    std::vector<int16_t> data(mHeight * mWidth);
+    // Copy the frame out so that the buffer can be returned to the driver right away. There are
+    // only NUM_BUFFERS of them, and frames may be held for much longer by the queue and by the
+    // listeners. Copies of the frame after this point share its data.
     const int16_t* readFrom = mReadLocations[buf.index];
-    std::copy(readFrom, readFrom + mHeight * mWidth, data.begin());
-    TouchVideoFrame frame(mHeight, mWidth, std::move(data), buf.timestamp);
+    TouchVideoFrame frame(mHeight, mWidth,
+                          std::vector<int16_t>(readFrom, readFrom + mHeight * mWidth),
+                          buf.timestamp);
 
     result = ioctl(mFd.get(), VIDIOC_QBUF, &buf);
     if (result == -1) {
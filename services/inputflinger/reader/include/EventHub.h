@@ -19,6 +19,9 @@
 
 #include <bitset>
 #include <climits>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -42,6 +45,7 @@
 #include <utils/Log.h>
 #include <utils/Mutex.h>
 
+#include "InputThread.h"
 #include "TouchVideoDevice.h"
 #include "VibrationElement.h"
 
@@ -548,7 +552,8 @@ private:
         int fd; // may be -1 if device is closed
         const int32_t id;
         const std::string path;
-        const InputDeviceIdentifier identifier;
+        // Probed off the reader thread; the descriptor is assigned once probing completes.
+        InputDeviceIdentifier identifier;
 
         std::unique_ptr<TouchVideoDevice> videoDevice;
 
@@ -609,9 +614,50 @@ private:
     };
 
     /**
-     * Create a new device for the provided path.
+     * An input device node being opened on a probe thread. Opening a device issues a series of
+     * ioctls and loads its configuration, key map and sysfs nodes, so nodes found by a scan or
+     * reported by inotify are probed in parallel, off the reader thread.
+     */
+    struct DeviceProbe {
+        const int32_t id;
+        const std::string path;
+        const std::vector<std::string> excludedDevices;
+
+        // Set by the probe thread. Null if the node could not be opened or is not handled.
+        std::unique_ptr<Device> device;
+        status_t keyMapStatus = NAME_NOT_FOUND;
+
+        DeviceProbe(int32_t id, const std::string& path,
+                    const std::vector<std::string>& excludedDevices)
+              : id(id), path(path), excludedDevices(excludedDevices) {}
+    };
+
+    enum class ProbeState {
+        PROBING,
+        // The node was removed while it was being probed. The result is discarded.
+        REMOVED,
+        // The node was removed and created again while it was being probed. It is probed again.
+        REOPENED,
+    };
+
+    // Maximum number of threads probing input device nodes at the same time.
+    static constexpr size_t MAX_DEVICE_PROBE_THREADS = 4;
+
+    /**
+     * Start probing the device at the provided path. The device is added by
+     * finishDeviceProbesLocked once it has been probed.
      */
     void openDeviceLocked(const std::string& devicePath) REQUIRES(mLock);
+    /**
+     * Open the device node and read everything about it that does not depend on other devices.
+     * Runs on a probe thread without holding mLock.
+     */
+    static void probeDevice(DeviceProbe& probe);
+    void processDeviceProbe();
+    void waitForDeviceProbesLocked() REQUIRES(mLock);
+    void finishDeviceProbesLocked() REQUIRES(mLock);
+    void finishOpenDeviceLocked(std::unique_ptr<Device> device, status_t keyMapStatus)
+            REQUIRES(mLock);
     void openVideoDeviceLocked(const std::string& devicePath) REQUIRES(mLock);
     /**
      * Try to associate a video device with an input device. If the association succeeds,
@@ -692,6 +738,23 @@ private:
     std::vector<std::unique_ptr<Device>> mOpeningDevices;
     std::vector<std::unique_ptr<Device>> mClosingDevices;
 
+    // Paths of the device nodes that are being probed.
+    std::unordered_map<std::string, ProbeState> mProbingDevices;
+    std::vector<std::unique_ptr<InputThread>> mProbeThreads;
+
+    // Protects the probe queues shared with the probe threads. mLock must not be acquired while
+    // holding it.
+    std::mutex mProbeLock;
+    std::condition_variable mProbeCondition;
+    std::condition_variable mProbeFinishedCondition;
+    std::deque<std::unique_ptr<DeviceProbe>> mPendingProbes;
+    std::vector<std::unique_ptr<DeviceProbe>> mFinishedProbes;
+    size_t mUnfinishedProbeCount;
+    bool mProbeThreadsExiting;
+    // Signalled by the probe threads when a probe finishes.
+    int mProbeEventFd;
+    bool mPendingProbeEvent;
+
     bool mNeedToSendFinishedDeviceScan;
     bool mNeedToReopenDevices;
     bool mNeedToScanDevices;
@@ -132,6 +132,47 @@ TEST(AnrTrackerTest, MultipleTokens_IdenticalTimesRemove) {
     ASSERT_EQ(token1, tracker.firstToken());
 }
 
+TEST(AnrTrackerTest, MultipleTokens_RemoveFirst) {
+    AnrTracker tracker;
+
+    sp<IBinder> token1 = new BBinder();
+    sp<IBinder> token2 = new BBinder();
+
+    tracker.insert(1, token1);
+    tracker.insert(2, token2);
+    tracker.insert(3, token1);
+
+    tracker.erase(1, token1);
+    ASSERT_EQ(2, tracker.firstTimeout());
+    ASSERT_EQ(token2, tracker.firstToken());
+
+    tracker.erase(2, token2);
+    ASSERT_EQ(3, tracker.firstTimeout());
+    ASSERT_EQ(token1, tracker.firstToken());
+
+    tracker.erase(3, token1);
+    ASSERT_TRUE(tracker.empty());
+}
+
+TEST(AnrTrackerTest, SingleToken_RemoveOutOfOrder) {
+    AnrTracker tracker;
+
+    tracker.insert(1, nullptr);
+    tracker.insert(3, nullptr);
+    tracker.insert(2, nullptr);
+    tracker.insert(3, nullptr);
+
+    tracker.erase(3, nullptr);
+    tracker.erase(2, nullptr);
+    ASSERT_EQ(1, tracker.firstTimeout());
+
+    tracker.erase(1, nullptr);
+    ASSERT_EQ(3, tracker.firstTimeout());
+
+    tracker.erase(3, nullptr);
+    ASSERT_TRUE(tracker.empty());
+}
+
 TEST(AnrTrackerTest, Empty_DoesntCrash) {
     AnrTracker tracker;
 
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include "../dispatcher/LatencyAggregator.h"
 #include "../dispatcher/LatencyTracker.h"
 
 #include <binder/Binder.h>
@@ -124,6 +125,15 @@ TEST_F(LatencyTrackerTest, TrackListener_DoesNotTriggerReporting) {
     assertReceivedTimeline(InputEventTimeline{false, 2, 3});
 }
 
+/**
+ * The display that the event went to should be carried into the reported timeline.
+ */
+TEST_F(LatencyTrackerTest, TrackListener_StoresDisplayId) {
+    mTracker->trackListener(1 /*inputEventId*/, false /*isDown*/, 2 /*eventTime*/, 3 /*readTime*/,
+                            4 /*displayId*/);
+    assertReceivedTimeline(InputEventTimeline{false, 2, 3, 4});
+}
+
 /**
  * A single call to trackFinishedEvent should not cause a timeline to be reported.
  */
@@ -250,4 +260,42 @@ TEST_F(LatencyTrackerTest, EventsAreTracked_WhenTrackListenerIsCalledFirst) {
             InputEventTimeline{expected.isDown, expected.eventTime, expected.readTime});
 }
 
+// --- LatencyHistogramTest ---
+
+TEST(LatencyHistogramTest, Empty_ReturnsZero) {
+    LatencyHistogram histogram;
+    ASSERT_EQ(0u, histogram.count());
+    ASSERT_EQ(0, histogram.percentile(0.5));
+}
+
+/**
+ * Small values have exact buckets, and larger values stay within the bucket precision.
+ */
+TEST(LatencyHistogramTest, Percentiles_WithinBucketPrecision) {
+    LatencyHistogram histogram;
+    for (int i = 1; i <= 100; i++) {
+        histogram.add(ms2ns(i));
+    }
+    ASSERT_EQ(100u, histogram.count());
+    const std::array<std::pair<float, nsecs_t>, 3> expected = {{
+            {0.5, ms2ns(50)},
+            {0.9, ms2ns(90)},
+            {0.99, ms2ns(99)},
+    }};
+    for (const auto& [fraction, latency] : expected) {
+        const nsecs_t percentile = histogram.percentile(fraction);
+        ASSERT_GE(percentile, latency);
+        ASSERT_LE(percentile, latency + latency / 8);
+    }
+}
+
+TEST(LatencyHistogramTest, OutOfRangeValues_AreClamped) {
+    LatencyHistogram histogram;
+    histogram.add(-1);
+    histogram.add(s2ns(3600));
+    ASSERT_EQ(2u, histogram.count());
+    ASSERT_LE(histogram.percentile(0), us2ns(1));
+    ASSERT_GE(histogram.percentile(1), s2ns(16));
+}
+
 } // namespace android::inputdispatcher
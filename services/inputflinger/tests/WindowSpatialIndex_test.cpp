@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../WindowSpatialIndex.h"
+
+using namespace android::flag_operators;
+
+// atest inputflinger_tests:WindowSpatialIndexTest
+
+namespace android::inputdispatcher {
+
+class FakeHitTestWindowHandle : public InputWindowHandle {
+public:
+    FakeHitTestWindowHandle(const std::string& name, const Rect& frame,
+                            Flags<InputWindowInfo::Flag> flags =
+                                    InputWindowInfo::Flag::NOT_TOUCH_MODAL) {
+        mInfo.name = name;
+        mInfo.frameLeft = frame.left;
+        mInfo.frameTop = frame.top;
+        mInfo.frameRight = frame.right;
+        mInfo.frameBottom = frame.bottom;
+        mInfo.touchableRegion = Region(frame);
+        mInfo.flags = flags;
+    }
+
+    bool updateInfo() { return true; }
+};
+
+static std::vector<uint32_t> candidatesAt(const WindowSpatialIndex& index, int32_t x, int32_t y) {
+    return index.getCandidatesAt(x, y);
+}
+
+TEST(WindowSpatialIndexTest, CandidatesOnlyIncludeNearbyWindows) {
+    std::vector<sp<InputWindowHandle>> windows;
+    windows.push_back(new FakeHitTestWindowHandle("TopLeft", Rect(0, 0, 100, 100)));
+    windows.push_back(new FakeHitTestWindowHandle("BottomRight", Rect(700, 700, 800, 800)));
+    windows.push_back(new FakeHitTestWindowHandle("Fullscreen", Rect(0, 0, 800, 800)));
+    WindowSpatialIndex index(windows);
+
+    ASSERT_EQ((std::vector<uint32_t>{0, 2}), candidatesAt(index, 50, 50));
+    ASSERT_EQ((std::vector<uint32_t>{1, 2}), candidatesAt(index, 750, 750));
+    ASSERT_EQ((std::vector<uint32_t>{2}), candidatesAt(index, 400, 400));
+    ASSERT_TRUE(candidatesAt(index, 900, 900).empty());
+}
+
+TEST(WindowSpatialIndexTest, TouchModalAndOutsideWatchersAreEverywhere) {
+    std::vector<sp<InputWindowHandle>> windows;
+    const Flags<InputWindowInfo::Flag> outsideFlags =
+            InputWindowInfo::Flag::NOT_TOUCH_MODAL | InputWindowInfo::Flag::WATCH_OUTSIDE_TOUCH;
+    windows.push_back(new FakeHitTestWindowHandle("Outside", Rect(0, 0, 10, 10), outsideFlags));
+    windows.push_back(new FakeHitTestWindowHandle("TopLeft", Rect(0, 0, 100, 100)));
+    windows.push_back(new FakeHitTestWindowHandle("Modal", Rect(0, 0, 10, 10), /*flags*/ {}));
+    windows.push_back(new FakeHitTestWindowHandle("BottomRight", Rect(700, 700, 800, 800)));
+    WindowSpatialIndex index(windows);
+
+    ASSERT_EQ((std::vector<uint32_t>{0, 1, 2}), candidatesAt(index, 50, 50));
+    ASSERT_EQ((std::vector<uint32_t>{0, 2, 3}), candidatesAt(index, 750, 750));
+    ASSERT_EQ((std::vector<uint32_t>{0, 2}), candidatesAt(index, -50, 900));
+}
+
+TEST(WindowSpatialIndexTest, EmptyWindowsAreNeverCandidates) {
+    std::vector<sp<InputWindowHandle>> windows;
+    windows.push_back(new FakeHitTestWindowHandle("Empty", Rect()));
+    windows.push_back(new FakeHitTestWindowHandle("Fullscreen", Rect(0, 0, 800, 800)));
+    WindowSpatialIndex index(windows);
+
+    ASSERT_EQ((std::vector<uint32_t>{1}), candidatesAt(index, 0, 0));
+}
+
+TEST(WindowSpatialIndexTest, GetPosition) {
+    std::vector<sp<InputWindowHandle>> windows;
+    windows.push_back(new FakeHitTestWindowHandle("First", Rect(0, 0, 100, 100)));
+    windows.push_back(new FakeHitTestWindowHandle("Second", Rect(0, 0, 100, 100)));
+    WindowSpatialIndex index(windows);
+
+    ASSERT_EQ(1u, index.getPosition(windows[1]));
+    ASSERT_EQ(windows[1], index.getWindowHandle(1));
+    sp<InputWindowHandle> other = new FakeHitTestWindowHandle("Other", Rect(0, 0, 100, 100));
+    ASSERT_EQ(2u, index.getPosition(other));
+}
+
+} // namespace android::inputdispatcher
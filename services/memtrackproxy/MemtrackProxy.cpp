@@ -17,6 +17,7 @@
 #include "MemtrackProxy.h"
 
 #include <android-base/logging.h>
+#include <android-base/properties.h>
 #include <android/binder_manager.h>
 #include <private/android_filesystem_config.h>
 
@@ -97,9 +98,20 @@ bool MemtrackProxy::CheckPid(pid_t calling_pid, pid_t request_pid) {
     return calling_pid == request_pid;
 }
 
-MemtrackProxy::MemtrackProxy()
+std::chrono::milliseconds MemtrackProxy::CacheTtlFromProperty() {
+    // ActivityManager samples every process in sweeps, so a short delay is enough for
+    // repeated requests within a sweep to share one HAL query.
+    constexpr int64_t kDefaultCacheTtlMs = 1000;
+    return std::chrono::milliseconds(::android::base::GetIntProperty<int64_t>(
+            "memtrack.proxy.cache_ttl_ms", kDefaultCacheTtlMs, 0));
+}
+
+MemtrackProxy::MemtrackProxy() : MemtrackProxy(MemtrackProxy::CacheTtlFromProperty()) {}
+
+MemtrackProxy::MemtrackProxy(std::chrono::milliseconds cache_ttl)
       : memtrack_hidl_instance_(MemtrackProxy::MemtrackHidlInstance()),
-        memtrack_aidl_instance_(MemtrackProxy::MemtrackAidlInstance()) {}
+        memtrack_aidl_instance_(MemtrackProxy::MemtrackAidlInstance()),
+        cache_ttl_(cache_ttl) {}
 
 ndk::ScopedAStatus MemtrackProxy::getMemory(int pid, MemtrackType type,
                                             std::vector<MemtrackRecord>* _aidl_return) {
@@ -120,6 +132,66 @@ ndk::ScopedAStatus MemtrackProxy::getMemory(int pid, MemtrackType type,
         return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
     }
 
+    if (cache_ttl_.count() == 0) {
+        return getMemoryFromHal(pid, type, _aidl_return);
+    }
+
+    const CacheKey key{pid, type};
+    {
+        std::unique_lock<std::mutex> lock(cache_lock_);
+        for (;;) {
+            CacheEntry& entry = cache_[key];
+            const auto now = std::chrono::steady_clock::now();
+            if (entry.valid && now - entry.fetch_time < cache_ttl_) {
+                *_aidl_return = entry.records;
+                return ndk::ScopedAStatus::ok();
+            }
+            if (!entry.fetching) {
+                entry.fetching = true;
+                break;
+            }
+            // The cache may be pruned while waiting, so look the entry up again.
+            cache_cv_.wait(lock);
+        }
+    }
+
+    ndk::ScopedAStatus status = getMemoryFromHal(pid, type, _aidl_return);
+
+    {
+        std::lock_guard<std::mutex> lock(cache_lock_);
+        const auto now = std::chrono::steady_clock::now();
+        CacheEntry& entry = cache_[key];
+        entry.fetching = false;
+        // Only successful results are cached. Waiters for a failed request query the HAL
+        // themselves.
+        entry.valid = status.isOk();
+        if (entry.valid) {
+            entry.fetch_time = now;
+            entry.records = *_aidl_return;
+        }
+        pruneCacheLocked(now);
+    }
+    cache_cv_.notify_all();
+
+    return status;
+}
+
+void MemtrackProxy::pruneCacheLocked(std::chrono::steady_clock::time_point now) {
+    if (cache_.size() <= kMaxCacheEntries) {
+        return;
+    }
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        const CacheEntry& entry = it->second;
+        if (!entry.fetching && (!entry.valid || now - entry.fetch_time >= cache_ttl_)) {
+            it = cache_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+ndk::ScopedAStatus MemtrackProxy::getMemoryFromHal(int pid, MemtrackType type,
+                                                   std::vector<MemtrackRecord>* _aidl_return) {
     _aidl_return->clear();
 
     if (memtrack_aidl_instance_) {
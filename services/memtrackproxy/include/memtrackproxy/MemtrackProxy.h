@@ -23,6 +23,12 @@
 #include <aidl/android/hardware/memtrack/MemtrackType.h>
 #include <android/hardware/memtrack/1.0/IMemtrack.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <utility>
+
 using ::android::sp;
 
 namespace V1_0_hidl = ::android::hardware::memtrack::V1_0;
@@ -39,18 +45,44 @@ __attribute__((warn_unused_result)) bool translate(const V1_0_hidl::MemtrackReco
 class MemtrackProxy : public BnMemtrack {
 public:
     MemtrackProxy();
+    // Successful getMemory() results are reused for cache_ttl. A zero cache_ttl disables caching.
+    explicit MemtrackProxy(std::chrono::milliseconds cache_ttl);
     ndk::ScopedAStatus getMemory(int pid, MemtrackType type,
                                  std::vector<MemtrackRecord>* _aidl_return) override;
     ndk::ScopedAStatus getGpuDeviceInfo(std::vector<DeviceInfo>* _aidl_return) override;
 
 private:
+    // Cached getMemory() result for a pid and type.
+    struct CacheEntry {
+        std::chrono::steady_clock::time_point fetch_time;
+        std::vector<MemtrackRecord> records;
+        bool valid = false;
+        // Set while a request is querying the HAL, so that identical concurrent requests wait
+        // for its result instead of querying the HAL again.
+        bool fetching = false;
+    };
+    using CacheKey = std::pair<int, MemtrackType>;
+
+    // Don't let entries for processes that have died accumulate.
+    static constexpr size_t kMaxCacheEntries = 1024;
+
     static sp<V1_0_hidl::IMemtrack> MemtrackHidlInstance();
     static std::shared_ptr<V1_aidl::IMemtrack> MemtrackAidlInstance();
+    static std::chrono::milliseconds CacheTtlFromProperty();
     static bool CheckUid(uid_t calling_uid);
     static bool CheckPid(pid_t calling_pid, pid_t request_pid);
 
+    ndk::ScopedAStatus getMemoryFromHal(int pid, MemtrackType type,
+                                        std::vector<MemtrackRecord>* _aidl_return);
+    void pruneCacheLocked(std::chrono::steady_clock::time_point now);
+
     sp<V1_0_hidl::IMemtrack> memtrack_hidl_instance_;
     std::shared_ptr<V1_aidl::IMemtrack> memtrack_aidl_instance_;
+
+    const std::chrono::milliseconds cache_ttl_;
+    std::mutex cache_lock_;
+    std::condition_variable cache_cv_;
+    std::map<CacheKey, CacheEntry> cache_;
 };
 
 } // namespace memtrack
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *                        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PowerHalAsyncController"
+#include <android/hardware/power/Boost.h>
+#include <android/hardware/power/IPowerHintSession.h>
+#include <android/hardware/power/Mode.h>
+#include <powermanager/PowerHalAsyncController.h>
+#include <utils/Log.h>
+
+using namespace android::hardware::power;
+
+namespace android {
+
+namespace power {
+
+// -------------------------------------------------------------------------------------------------
+
+PowerHalAsyncController::PowerHalAsyncController(std::unique_ptr<HalWrapper> hal,
+                                                 std::chrono::nanoseconds boostCoalescingWindow)
+      : mHal(std::move(hal)),
+        mBoostCoalescingWindow(boostCoalescingWindow),
+        mThread(&PowerHalAsyncController::loop, this) {}
+
+PowerHalAsyncController::~PowerHalAsyncController() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDone = true;
+    }
+    mCondition.notify_all();
+    mThread.join();
+}
+
+HalResult<void> PowerHalAsyncController::setBoost(Boost boost, int32_t durationMs) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    const Clock::time_point now = Clock::now();
+    auto it = mSentBoosts.find(boost);
+    if (it != mSentBoosts.end() && it->second.durationMs == durationMs &&
+        now - it->second.time < mBoostCoalescingWindow) {
+        ALOGV("Skipped setBoost %s because it was sent in the last %lldns",
+              toString(boost).c_str(), static_cast<long long>(mBoostCoalescingWindow.count()));
+        return HalResult<void>::ok();
+    }
+
+    mSentBoosts[boost] = {durationMs, now};
+    enqueue([this, boost, durationMs] {
+        if (mHal->setBoost(boost, durationMs).isFailed()) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mSentBoosts.erase(boost);
+        }
+    });
+    return HalResult<void>::ok();
+}
+
+HalResult<void> PowerHalAsyncController::setMode(Mode mode, bool enabled) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mModes.find(mode);
+    if (it != mModes.end() && it->second == enabled) {
+        ALOGV("Skipped setMode %s to %s because it is already set", toString(mode).c_str(),
+              enabled ? "true" : "false");
+        return HalResult<void>::ok();
+    }
+
+    mModes[mode] = enabled;
+    enqueue([this, mode, enabled] {
+        if (mHal->setMode(mode, enabled).isFailed()) {
+            // The HAL state is unknown, so send the next request for this mode whatever it is.
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto it = mModes.find(mode);
+            if (it != mModes.end() && it->second == enabled) {
+                mModes.erase(it);
+            }
+        }
+    });
+    return HalResult<void>::ok();
+}
+
+HalResult<sp<IPowerHintSession>> PowerHalAsyncController::createHintSession(
+        int32_t tgid, int32_t uid, const std::vector<int32_t>& threadIds, int64_t durationNanos) {
+    return mHal->createHintSession(tgid, uid, threadIds, durationNanos);
+}
+
+HalResult<int64_t> PowerHalAsyncController::getHintSessionPreferredRate() {
+    return mHal->getHintSessionPreferredRate();
+}
+
+void PowerHalAsyncController::flush() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this]() REQUIRES(mMutex) { return mRequests.empty() && !mSending; });
+}
+
+void PowerHalAsyncController::enqueue(std::function<void()> request) {
+    mRequests.push_back(std::move(request));
+    mCondition.notify_all();
+}
+
+void PowerHalAsyncController::loop() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this]() REQUIRES(mMutex) { return mDone || !mRequests.empty(); });
+        // Queued requests are still sent after destruction starts.
+        if (mRequests.empty()) {
+            return;
+        }
+
+        std::function<void()> request = std::move(mRequests.front());
+        mRequests.pop_front();
+        mSending = true;
+
+        lock.unlock();
+        request();
+        lock.lock();
+
+        mSending = false;
+        mCondition.notify_all();
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+
+} // namespace power
+
+} // namespace android
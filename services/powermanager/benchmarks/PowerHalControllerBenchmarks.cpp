@@ -17,15 +17,23 @@
 #define LOG_TAG "PowerHalControllerBenchmarks"
 
 #include <android/hardware/power/Boost.h>
+#include <android/hardware/power/IPowerHintSession.h>
 #include <android/hardware/power/Mode.h>
+#include <android/hardware/power/WorkDuration.h>
 #include <benchmark/benchmark.h>
+#include <log/log.h>
+#include <powermanager/PowerHalAsyncController.h>
 #include <powermanager/PowerHalController.h>
 #include <testUtil.h>
+#include <unistd.h>
 #include <chrono>
 
 using android::hardware::power::Boost;
+using android::hardware::power::IPowerHintSession;
 using android::hardware::power::Mode;
+using android::hardware::power::WorkDuration;
 using android::power::HalResult;
+using android::power::PowerHalAsyncController;
 using android::power::PowerHalController;
 
 using namespace android;
@@ -108,9 +116,74 @@ static void BM_PowerHalControllerBenchmarks_setModeCached(benchmark::State& stat
     runCachedBenchmark(state, &PowerHalController::setMode, mode, false);
 }
 
+// Measures the cost seen by the caller, with boosts sent again after every coalescing window and
+// modes already in the requested state skipped.
+template <typename T, class... Args0, class... Args1>
+static void runAsyncBenchmark(benchmark::State& state,
+                              HalResult<T> (PowerHalAsyncController::*fn)(Args0...),
+                              Args1&&... args1) {
+    PowerHalAsyncController controller;
+    while (state.KeepRunning()) {
+        HalResult<T> ret = (controller.*fn)(std::forward<Args1>(args1)...);
+        state.PauseTiming();
+        if (ret.isFailed()) state.SkipWithError("Power HAL request failed");
+        state.ResumeTiming();
+    }
+    controller.flush();
+}
+
+static void BM_PowerHalAsyncControllerBenchmarks_setBoost(benchmark::State& state) {
+    Boost boost = static_cast<Boost>(state.range(0));
+    runAsyncBenchmark(state, &PowerHalAsyncController::setBoost, boost, 0);
+}
+
+static void BM_PowerHalAsyncControllerBenchmarks_setMode(benchmark::State& state) {
+    Mode mode = static_cast<Mode>(state.range(0));
+    runAsyncBenchmark(state, &PowerHalAsyncController::setMode, mode, false);
+}
+
+// Reports the work duration of as many frames as the benchmark argument at once, as done by
+// SurfaceFlinger once per frame or at the rate preferred by the Power HAL.
+static void BM_PowerHalControllerBenchmarks_reportFrameWorkDuration(benchmark::State& state) {
+    PowerHalController controller;
+    // do not use tid from the benchmark process, use 1 for init
+    std::vector<int32_t> threadIds{1};
+    int64_t targetDurationNanos = 16666666L;
+    auto result = controller.createHintSession(getpid(), static_cast<int32_t>(getuid()), threadIds,
+                                               targetDurationNanos);
+    if (!result.isOk() || result.value() == nullptr) {
+        ALOGI("Power HAL doesn't support session, skipping test...");
+        return;
+    }
+    sp<IPowerHintSession> session = result.value();
+
+    std::vector<WorkDuration> durations(state.range(0));
+    int64_t timeStampNanos = 0;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        for (auto& duration : durations) {
+            timeStampNanos += targetDurationNanos;
+            duration.timeStampNanos = timeStampNanos;
+            duration.durationNanos = targetDurationNanos / 2;
+        }
+        state.ResumeTiming();
+
+        binder::Status ret = session->reportActualWorkDuration(durations);
+        state.PauseTiming();
+        if (!ret.isOk()) state.SkipWithError(ret.toString8().c_str());
+        testDelaySpin(
+                std::chrono::duration_cast<std::chrono::duration<float>>(ONEWAY_API_DELAY).count());
+        state.ResumeTiming();
+    }
+    session->close();
+}
+
 BENCHMARK(BM_PowerHalControllerBenchmarks_init);
 BENCHMARK(BM_PowerHalControllerBenchmarks_initCached);
 BENCHMARK(BM_PowerHalControllerBenchmarks_setBoost)->DenseRange(FIRST_BOOST, LAST_BOOST, 1);
 BENCHMARK(BM_PowerHalControllerBenchmarks_setBoostCached)->DenseRange(FIRST_BOOST, LAST_BOOST, 1);
 BENCHMARK(BM_PowerHalControllerBenchmarks_setMode)->DenseRange(FIRST_MODE, LAST_MODE, 1);
 BENCHMARK(BM_PowerHalControllerBenchmarks_setModeCached)->DenseRange(FIRST_MODE, LAST_MODE, 1);
+BENCHMARK(BM_PowerHalAsyncControllerBenchmarks_setBoost)->DenseRange(FIRST_BOOST, LAST_BOOST, 1);
+BENCHMARK(BM_PowerHalAsyncControllerBenchmarks_setMode)->DenseRange(FIRST_MODE, LAST_MODE, 1);
+BENCHMARK(BM_PowerHalControllerBenchmarks_reportFrameWorkDuration)->Arg(1)->Arg(4)->Arg(8);
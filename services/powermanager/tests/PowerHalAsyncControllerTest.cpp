@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *                        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PowerHalAsyncControllerTest"
+
+#include <android/hardware/power/Boost.h>
+#include <android/hardware/power/IPowerHintSession.h>
+#include <android/hardware/power/Mode.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <powermanager/PowerHalAsyncController.h>
+#include <utils/Log.h>
+
+#include <future>
+
+using android::hardware::power::Boost;
+using android::hardware::power::IPowerHintSession;
+using android::hardware::power::Mode;
+
+using namespace android;
+using namespace android::power;
+using namespace std::chrono_literals;
+using namespace testing;
+
+// -------------------------------------------------------------------------------------------------
+
+class MockHalWrapper : public HalWrapper {
+public:
+    MOCK_METHOD(HalResult<void>, setBoost, (Boost boost, int32_t durationMs), (override));
+    MOCK_METHOD(HalResult<void>, setMode, (Mode mode, bool enabled), (override));
+    MOCK_METHOD(HalResult<sp<IPowerHintSession>>, createHintSession,
+                (int32_t tgid, int32_t uid, const std::vector<int32_t>& threadIds,
+                 int64_t durationNanos),
+                (override));
+    MOCK_METHOD(HalResult<int64_t>, getHintSessionPreferredRate, (), (override));
+};
+
+// -------------------------------------------------------------------------------------------------
+
+class PowerHalAsyncControllerTest : public Test {
+public:
+    void SetUp() override {
+        std::unique_ptr<StrictMock<MockHalWrapper>> mockHal =
+                std::make_unique<StrictMock<MockHalWrapper>>();
+        mMockHal = mockHal.get();
+        // Long enough that repeated boosts within a test are always coalesced.
+        mHalController = std::make_unique<PowerHalAsyncController>(std::move(mockHal), 1h);
+    }
+
+protected:
+    StrictMock<MockHalWrapper>* mMockHal = nullptr;
+    std::unique_ptr<PowerHalAsyncController> mHalController = nullptr;
+};
+
+// -------------------------------------------------------------------------------------------------
+
+TEST_F(PowerHalAsyncControllerTest, TestBoostsCoalescedWithinWindow) {
+    EXPECT_CALL(*mMockHal, setBoost(Eq(Boost::INTERACTION), Eq(100)))
+            .Times(Exactly(1))
+            .WillRepeatedly(Return(HalResult<void>::ok()));
+    EXPECT_CALL(*mMockHal, setBoost(Eq(Boost::INTERACTION), Eq(200)))
+            .Times(Exactly(1))
+            .WillRepeatedly(Return(HalResult<void>::ok()));
+    EXPECT_CALL(*mMockHal, setBoost(Eq(Boost::DISPLAY_UPDATE_IMMINENT), Eq(0)))
+            .Times(Exactly(1))
+            .WillRepeatedly(Return(HalResult<void>::ok()));
+
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(mHalController->setBoost(Boost::INTERACTION, 100).isOk());
+        ASSERT_TRUE(mHalController->setBoost(Boost::DISPLAY_UPDATE_IMMINENT, 0).isOk());
+    }
+    // A boost with a new duration is sent again.
+    ASSERT_TRUE(mHalController->setBoost(Boost::INTERACTION, 200).isOk());
+    mHalController->flush();
+}
+
+TEST_F(PowerHalAsyncControllerTest, TestBoostsSentAgainAfterWindow) {
+    std::unique_ptr<StrictMock<MockHalWrapper>> mockHal =
+            std::make_unique<StrictMock<MockHalWrapper>>();
+    EXPECT_CALL(*mockHal, setBoost(Eq(Boost::INTERACTION), Eq(100)))
+            .Times(Exactly(2))
+            .WillRepeatedly(Return(HalResult<void>::ok()));
+    PowerHalAsyncController halController(std::move(mockHal), 1ms);
+
+    ASSERT_TRUE(halController.setBoost(Boost::INTERACTION, 100).isOk());
+    std::this_thread::sleep_for(5ms);
+    ASSERT_TRUE(halController.setBoost(Boost::INTERACTION, 100).isOk());
+    halController.flush();
+}
+
+TEST_F(PowerHalAsyncControllerTest, TestFailedBoostNotCoalesced) {
+    EXPECT_CALL(*mMockHal, setBoost(Eq(Boost::INTERACTION), Eq(100)))
+            .Times(Exactly(2))
+            .WillOnce(Return(HalResult<void>::failed("Failed")))
+            .WillOnce(Return(HalResult<void>::ok()));
+
+    ASSERT_TRUE(mHalController->setBoost(Boost::INTERACTION, 100).isOk());
+    mHalController->flush();
+    ASSERT_TRUE(mHalController->setBoost(Boost::INTERACTION, 100).isOk());
+    mHalController->flush();
+}
+
+TEST_F(PowerHalAsyncControllerTest, TestRedundantModesSkipped) {
+    {
+        InSequence seq;
+        EXPECT_CALL(*mMockHal, setMode(Eq(Mode::LAUNCH), Eq(true)))
+                .Times(Exactly(1))
+                .WillRepeatedly(Return(HalResult<void>::ok()));
+        EXPECT_CALL(*mMockHal, setMode(Eq(Mode::LAUNCH), Eq(false)))
+                .Times(Exactly(1))
+                .WillRepeatedly(Return(HalResult<void>::ok()));
+    }
+    EXPECT_CALL(*mMockHal, setMode(Eq(Mode::LOW_POWER), Eq(true)))
+            .Times(Exactly(1))
+            .WillRepeatedly(Return(HalResult<void>::ok()));
+
+    ASSERT_TRUE(mHalController->setMode(Mode::LAUNCH, true).isOk());
+    ASSERT_TRUE(mHalController->setMode(Mode::LOW_POWER, true).isOk());
+    ASSERT_TRUE(mHalController->setMode(Mode::LAUNCH, true).isOk());
+    ASSERT_TRUE(mHalController->setMode(Mode::LOW_POWER, true).isOk());
+    ASSERT_TRUE(mHalController->setMode(Mode::LAUNCH, false).isOk());
+    ASSERT_TRUE(mHalController->setMode(Mode::LAUNCH, false).isOk());
+    mHalController->flush();
+}
+
+TEST_F(PowerHalAsyncControllerTest, TestFailedModeSentAgain) {
+    EXPECT_CALL(*mMockHal, setMode(Eq(Mode::LAUNCH), Eq(true)))
+            .Times(Exactly(2))
+            .WillOnce(Return(HalResult<void>::failed("Failed")))
+            .WillOnce(Return(HalResult<void>::ok()));
+
+    ASSERT_TRUE(mHalController->setMode(Mode::LAUNCH, true).isOk());
+    mHalController->flush();
+    ASSERT_TRUE(mHalController->setMode(Mode::LAUNCH, true).isOk());
+    mHalController->flush();
+}
+
+TEST_F(PowerHalAsyncControllerTest, TestApiCallsDoNotWaitForPowerHal) {
+    std::promise<void> halUnblocked;
+    std::shared_future<void> unblocked = halUnblocked.get_future().share();
+    EXPECT_CALL(*mMockHal, setBoost(Eq(Boost::INTERACTION), Eq(100)))
+            .Times(Exactly(1))
+            .WillRepeatedly([unblocked](Boost, int32_t) {
+                unblocked.wait();
+                return HalResult<void>::ok();
+            });
+    EXPECT_CALL(*mMockHal, setMode(Eq(Mode::LAUNCH), Eq(true)))
+            .Times(Exactly(1))
+            .WillRepeatedly(Return(HalResult<void>::ok()));
+
+    // Both calls return while the HAL is still busy with the boost.
+    ASSERT_TRUE(mHalController->setBoost(Boost::INTERACTION, 100).isOk());
+    ASSERT_TRUE(mHalController->setMode(Mode::LAUNCH, true).isOk());
+
+    halUnblocked.set_value();
+    mHalController->flush();
+}
+
+TEST_F(PowerHalAsyncControllerTest, TestPendingRequestsSentOnDestruction) {
+    EXPECT_CALL(*mMockHal, setMode(Eq(Mode::LAUNCH), Eq(true)))
+            .Times(Exactly(1))
+            .WillRepeatedly(Return(HalResult<void>::ok()));
+
+    ASSERT_TRUE(mHalController->setMode(Mode::LAUNCH, true).isOk());
+    mHalController.reset();
+}
+
+TEST_F(PowerHalAsyncControllerTest, TestHintSessionCallsForwarded) {
+    EXPECT_CALL(*mMockHal, getHintSessionPreferredRate())
+            .Times(Exactly(1))
+            .WillRepeatedly(Return(HalResult<int64_t>::ok(16666666L)));
+
+    auto result = mHalController->getHintSessionPreferredRate();
+    ASSERT_TRUE(result.isOk());
+    EXPECT_EQ(result.value(), 16666666L);
+}
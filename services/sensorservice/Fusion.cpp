@@ -487,7 +487,25 @@ void Fusion::predict(const vec3_t& w, float dT) {
     if (x0.w < 0)
         x0 = -x0;
 
-    P = Phi*P*transpose(Phi) + GQGt;
+    // Phi is | Phi00 Phi10 |, so Phi*P*Phi' only needs half of the block products of the
+    //        |   0     1   |
+    // generic 6x6 multiplication:
+    //
+    // Phi*P*Phi' = | (Phi00*P00 + Phi10*P01)*Phi00' + M*Phi10'    M                        |
+    //              | P01*Phi00' + P11*Phi10'                       P11                      |
+    //
+    // M = Phi00*P10 + Phi10*P11
+    const mat33_t& Phi00 = Phi[0][0];
+    const mat33_t& Phi10 = Phi[1][0];
+    const mat33_t Phi00t(transpose(Phi00));
+    const mat33_t Phi10t(transpose(Phi10));
+    const mat33_t M(Phi00*P[1][0] + Phi10*P[1][1]);
+    const mat33_t P00((Phi00*P[0][0] + Phi10*P[0][1])*Phi00t + M*Phi10t);
+    const mat33_t P01(P[0][1]*Phi00t + P[1][1]*Phi10t);
+    P[0][0] = P00 + GQGt[0][0];
+    P[1][0] = M + GQGt[1][0];
+    P[0][1] = P01 + GQGt[0][1];
+    P[1][1] += GQGt[1][1];
 
     checkState();
 }
@@ -49,6 +49,7 @@ GravitySensor::GravitySensor(sensor_t const* list, size_t count) {
         .minDelay   = mSensorFusion.getMinDelay(),
     };
     mSensor = Sensor(&sensor);
+    setDirectReportSupported();
 }
 
 bool GravitySensor::process(sensors_event_t* outEvent,
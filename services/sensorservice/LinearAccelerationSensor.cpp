@@ -44,6 +44,7 @@ LinearAccelerationSensor::LinearAccelerationSensor(sensor_t const* list, size_t
         .minDelay   = gsensor.getMinDelay(),
     };
     mSensor = Sensor(&sensor);
+    setDirectReportSupported();
 }
 
 bool LinearAccelerationSensor::process(sensors_event_t* outEvent,
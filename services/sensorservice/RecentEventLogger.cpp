@@ -23,6 +23,8 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 namespace android {
 namespace SensorServiceUtil {
 
@@ -34,36 +36,71 @@ namespace {
 
 RecentEventLogger::RecentEventLogger(int sensorType) :
         mSensorType(sensorType), mEventSize(eventSizeBySensorType(mSensorType)),
-        mRecentEvents(logSizeBySensorType(sensorType)), mMaskData(false),
-        mIsLastEventCurrent(false) {
+        mRecentEvents(logSizeBySensorType(sensorType)), mNextIndex(0), mNumEvents(0),
+        mSequence(0), mMaskData(false), mIsLastEventCurrent(false) {
     // blank
 }
 
 void RecentEventLogger::addEvent(const sensors_event_t& event) {
-    std::lock_guard<std::mutex> lk(mLock);
-    mRecentEvents.emplace(event);
+    const uint64_t sequence = mSequence.load(std::memory_order_relaxed);
+    mSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const size_t index = mNextIndex.load(std::memory_order_relaxed);
+    SensorEventLog& log = mRecentEvents[index];
+    log.mEvent = event;
+    clock_gettime(CLOCK_REALTIME, &log.mWallTime);
+    mNextIndex.store((index + 1) % mRecentEvents.size(), std::memory_order_relaxed);
+    const size_t numEvents = mNumEvents.load(std::memory_order_relaxed);
+    if (numEvents < mRecentEvents.size()) {
+        mNumEvents.store(numEvents + 1, std::memory_order_relaxed);
+    }
+
+    mSequence.store(sequence + 2, std::memory_order_release);
     mIsLastEventCurrent = true;
 }
 
+std::vector<RecentEventLogger::SensorEventLog> RecentEventLogger::getRecentEvents(
+        size_t maxCount) const {
+    const size_t capacity = mRecentEvents.size();
+    std::vector<SensorEventLog> events;
+    events.reserve(std::min(maxCount, capacity));
+    while (true) {
+        const uint64_t sequence = mSequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            // An event is being added, which only takes a copy and a clock read
+            continue;
+        }
+        events.clear();
+        const size_t numEvents = std::min(maxCount, mNumEvents.load(std::memory_order_relaxed));
+        const size_t nextIndex = mNextIndex.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < numEvents; i++) {
+            events.push_back(mRecentEvents[(nextIndex + capacity - numEvents + i) % capacity]);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mSequence.load(std::memory_order_relaxed) == sequence) {
+            return events;
+        }
+    }
+}
+
 bool RecentEventLogger::isEmpty() const {
-    return mRecentEvents.size() == 0;
+    return mNumEvents.load(std::memory_order_relaxed) == 0;
 }
 
 void RecentEventLogger::setLastEventStale() {
-    std::lock_guard<std::mutex> lk(mLock);
     mIsLastEventCurrent = false;
 }
 
 std::string RecentEventLogger::dump() const {
-    std::lock_guard<std::mutex> lk(mLock);
+    const std::vector<SensorEventLog> recentEvents = getRecentEvents(mRecentEvents.size());
 
     //TODO: replace String8 with std::string completely in this function
     String8 buffer;
 
-    buffer.appendFormat("last %zu events\n", mRecentEvents.size());
+    buffer.appendFormat("last %zu events\n", recentEvents.size());
     int j = 0;
-    for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
-        const auto& ev = mRecentEvents[i];
+    for (const auto& ev : recentEvents) {
         struct tm * timeinfo = localtime(&(ev.mWallTime.tv_sec));
         buffer.appendFormat("\t%2d (ts=%.9f, wall=%02d:%02d:%02d.%03d) ",
                 ++j, ev.mEvent.timestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
@@ -95,11 +132,10 @@ std::string RecentEventLogger::dump() const {
  */
 void RecentEventLogger::dump(util::ProtoOutputStream* proto) const {
     using namespace service::SensorEventsProto;
-    std::lock_guard<std::mutex> lk(mLock);
+    const std::vector<SensorEventLog> recentEvents = getRecentEvents(mRecentEvents.size());
 
-    proto->write(RecentEventsLog::RECENT_EVENTS_COUNT, int(mRecentEvents.size()));
-    for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
-        const auto& ev = mRecentEvents[i];
+    proto->write(RecentEventsLog::RECENT_EVENTS_COUNT, int(recentEvents.size()));
+    for (const auto& ev : recentEvents) {
         const uint64_t token = proto->start(RecentEventsLog::EVENTS);
         proto->write(Event::TIMESTAMP_SEC, float(ev.mEvent.timestamp) / 1e9f);
         proto->write(Event::WALL_TIMESTAMP_MS, ev.mWallTime.tv_sec * 1000LL
@@ -129,15 +165,15 @@ void RecentEventLogger::setFormat(std::string format) {
 }
 
 bool RecentEventLogger::populateLastEventIfCurrent(sensors_event_t *event) const {
-    std::lock_guard<std::mutex> lk(mLock);
-
-    if (mIsLastEventCurrent && mRecentEvents.size()) {
-        // Index 0 contains the latest event emplace()'ed
-        *event = mRecentEvents[0].mEvent;
-        return true;
-    } else {
+    if (!mIsLastEventCurrent) {
         return false;
     }
+    const std::vector<SensorEventLog> lastEvent = getRecentEvents(1);
+    if (lastEvent.empty()) {
+        return false;
+    }
+    *event = lastEvent[0].mEvent;
+    return true;
 }
 
 
@@ -154,9 +190,5 @@ size_t RecentEventLogger::logSizeBySensorType(int sensorType) {
     return LOG_SIZE;
 }
 
-RecentEventLogger::SensorEventLog::SensorEventLog(const sensors_event_t& e) : mEvent(e) {
-    clock_gettime(CLOCK_REALTIME, &mWallTime);
-}
-
 } // namespace SensorServiceUtil
 } // namespace android
@@ -17,13 +17,13 @@
 #ifndef ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 #define ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 
-#include "RingBuffer.h"
 #include "SensorServiceUtils.h"
 
 #include <hardware/sensors.h>
 #include <utils/String8.h>
 
-#include <mutex>
+#include <atomic>
+#include <vector>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -33,6 +33,9 @@ namespace SensorServiceUtil {
 // generated from the sensor are stored in this buffer.  The buffer is NOT cleared when the sensor
 // unregisters and as a result very old data in the dumpsys output can be seen, which is an intended
 // behavior.
+//
+// Events are only added from the SensorService thread. addEvent never blocks: readers take
+// seqlock-style snapshots of the buffer and retry if an event was added while they copied it.
 class RecentEventLogger : public Dumpable {
 public:
     explicit RecentEventLogger(int sensorType);
@@ -53,19 +56,27 @@ public:
 
 protected:
     struct SensorEventLog {
-        explicit SensorEventLog(const sensors_event_t& e);
+        SensorEventLog() : mWallTime{}, mEvent{} {}
         timespec mWallTime;
         sensors_event_t mEvent;
     };
 
+    // Returns a consistent copy of up to maxCount of the most recent events, oldest first.
+    std::vector<SensorEventLog> getRecentEvents(size_t maxCount) const;
+
     const int mSensorType;
     const size_t mEventSize;
 
-    mutable std::mutex mLock;
-    RingBuffer<SensorEventLog> mRecentEvents;
+    // Circular buffer of the recent events. Its size is fixed at construction so that readers
+    // never see it reallocated. mNextIndex is the slot of the next event to add.
+    std::vector<SensorEventLog> mRecentEvents;
+    std::atomic<size_t> mNextIndex;
+    std::atomic<size_t> mNumEvents;
+    // Odd while an event is being added.
+    std::atomic<uint64_t> mSequence;
 
     bool mMaskData;
-    bool mIsLastEventCurrent;
+    std::atomic_bool mIsLastEventCurrent;
 
 private:
     static size_t logSizeBySensorType(int sensorType);
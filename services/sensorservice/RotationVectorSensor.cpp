@@ -41,6 +41,7 @@ RotationVectorSensor::RotationVectorSensor(int mode) :
         .minDelay   = mSensorFusion.getMinDelay(),
     };
     mSensor = Sensor(&sensor);
+    setDirectReportSupported();
 }
 
 bool RotationVectorSensor::process(sensors_event_t* outEvent,
@@ -33,6 +33,7 @@
 #include <chrono>
 #include <cinttypes>
 #include <thread>
+#include <unordered_set>
 
 using namespace android::hardware::sensors;
 using namespace android::hardware::sensors::V1_0;
@@ -84,6 +85,11 @@ enum EventQueueFlagBitsInternal : uint32_t {
     INTERNAL_WAKE =  1 << 16,
 };
 
+// A batch timeout may be shortened by up to this fraction to match the batch timeout of another
+// active sensor, so that the FIFOs of both sensors are flushed at the same time. Shortening never
+// violates the maximum report latency that the clients asked for.
+constexpr float BATCH_TIMEOUT_ALIGNMENT_TOLERANCE = 0.25f;
+
 }  // anonymous namespace
 
 void SensorsHalDeathReceivier::serviceDied(
@@ -456,8 +462,29 @@ std::string SensorDevice::dump() const {
                     isClientDisabledLocked(info.batchParams.keyAt(j)) ? "(disabled)" : "",
                     (j < info.batchParams.size() - 1) ? ", " : "");
         }
-        result.appendFormat("}, selected = %.2f ms\n", info.bestBatchParams.mTBatch / 1e6f);
+        result.appendFormat("}, selected = %.2f ms", info.bestBatchParams.mTBatch / 1e6f);
+        if (info.bestBatchParams.mTBatch != info.requestedBatchTimeout) {
+            result.appendFormat(" (aligned from %.2f ms)", info.requestedBatchTimeout / 1e6f);
+        }
+        result.append("\n");
+    }
+
+    // Estimate how many batch timeouts per minute are saved by aligning them, assuming that the
+    // FIFOs with the same batch timeout are flushed together.
+    float requestedFlushesPerMinute = 0;
+    float alignedFlushesPerMinute = 0;
+    std::unordered_set<nsecs_t> alignedTimeouts;
+    for (size_t i = 0; i < mActivationCount.size(); ++i) {
+        const Info& info = mActivationCount.valueAt(i);
+        if (info.numActiveClients() == 0 || info.requestedBatchTimeout == 0) continue;
+        requestedFlushesPerMinute += 60e9f / info.requestedBatchTimeout;
+        if (alignedTimeouts.insert(info.bestBatchParams.mTBatch).second) {
+            alignedFlushesPerMinute += 60e9f / info.bestBatchParams.mTBatch;
+        }
     }
+    result.appendFormat("Batch timeout alignment: ~%.1f of %.1f batch flushes/min saved\n",
+                        requestedFlushesPerMinute - alignedFlushesPerMinute,
+                        requestedFlushesPerMinute);
 
     return result.string();
 }
@@ -597,11 +624,7 @@ ssize_t SensorDevice::pollFmq(sensors_event_t* buffer, size_t maxNumEventsToRead
             // the use of writeBlocking by the Sensors HAL.
             mEventQueueFlag->wake(asBaseType(EventQueueFlagBits::EVENTS_READ));
 
-            for (size_t i = 0; i < eventsToRead; i++) {
-                convertToSensorEvent(mEventBuffer[i], &buffer[i]);
-                android::SensorDeviceUtils::quantizeSensorEventValues(&buffer[i],
-                        getResolutionForSensor(buffer[i].sensor));
-            }
+            convertToSensorEventsAndQuantize(mEventBuffer.data(), eventsToRead, buffer);
             eventsRead = eventsToRead;
         } else {
             ALOGW("Failed to read %zu events, currently %zu events available",
@@ -1144,7 +1167,34 @@ void SensorDevice::Info::selectBatchParams() {
     if (bestParams.mTBatch <= bestParams.mTSample) {
         bestParams.mTBatch = 0;
     }
+    requestedBatchTimeout = bestParams.mTBatch;
     bestBatchParams = bestParams;
+    device.alignBatchTimeoutLocked(this);
+}
+
+void SensorDevice::alignBatchTimeoutLocked(Info* info) const {
+    const nsecs_t requested = info->requestedBatchTimeout;
+    if (requested == 0) {
+        // Streaming mode, nothing to align
+        return;
+    }
+    const nsecs_t minAligned =
+            requested - static_cast<nsecs_t>(requested * BATCH_TIMEOUT_ALIGNMENT_TOLERANCE);
+    nsecs_t aligned = 0;
+    for (size_t i = 0; i < mActivationCount.size(); ++i) {
+        const Info& other = mActivationCount.valueAt(i);
+        if (&other == info || other.numActiveClients() == 0) {
+            continue;
+        }
+        const nsecs_t timeout = other.bestBatchParams.mTBatch;
+        if (timeout >= minAligned && timeout <= requested &&
+            timeout > info->bestBatchParams.mTSample) {
+            aligned = std::max(aligned, timeout);
+        }
+    }
+    if (aligned != 0) {
+        info->bestBatchParams.mTBatch = aligned;
+    }
 }
 
 ssize_t SensorDevice::Info::removeBatchParamsForIdent(void* ident) {
@@ -1195,10 +1245,20 @@ void SensorDevice::convertToSensorEventsAndQuantize(
         onDynamicSensorsConnected(dynamicSensorsAdded);
     }
 
-    for (size_t i = 0; i < src.size(); ++i) {
-        V2_1::implementation::convertToSensorEvent(src[i], &dst[i]);
-        android::SensorDeviceUtils::quantizeSensorEventValues(&dst[i],
-                getResolutionForSensor(dst[i].sensor));
+    android::SensorDeviceUtils::convertToSensorEventsAndQuantize(src.data(), src.size(), dst,
+            [this](int32_t sensorHandle) { return getResolutionForSensor(sensorHandle); });
+}
+
+void SensorDevice::convertToSensorEventsAndQuantize(
+        const Event *src, size_t count, sensors_event_t *dst) {
+    android::SensorDeviceUtils::convertToSensorEventsAndQuantize(src, count, dst,
+            [this](int32_t sensorHandle) { return getResolutionForSensor(sensorHandle); });
+
+    // The connected sensor of dynamic sensor meta events is looked up by SensorDevice.
+    for (size_t i = 0; i < count; ++i) {
+        if (src[i].sensorType == V2_1::SensorType::DYNAMIC_SENSOR_META) {
+            convertToSensorEvent(src[i], &dst[i]);
+        }
     }
 }
 
@@ -169,6 +169,9 @@ private:
     // has registered for this sensor.
     struct Info {
         BatchParams bestBatchParams;
+        // The batch timeout selected from the client requests, before bestBatchParams.mTBatch is
+        // aligned with the batch timeouts of the other active sensors.
+        nsecs_t requestedBatchTimeout = 0;
         // Key is the unique identifier(ident) for each client, value is the batch parameters
         // requested by the client.
         KeyedVector<void*, BatchParams> batchParams;
@@ -262,6 +265,10 @@ private:
 
     bool isClientDisabled(void* ident) const;
     bool isClientDisabledLocked(void* ident) const;
+
+    // Shortens the batch timeout of the sensor to the batch timeout of another active sensor if it
+    // is close enough, so that both FIFOs are flushed together and the AP wakes up less often.
+    void alignBatchTimeoutLocked(Info* info) const;
     std::vector<void *> getDisabledClientsLocked() const;
 
     bool clientHasNoAccessLocked(void* ident) const;
@@ -275,6 +282,8 @@ private:
             const hardware::hidl_vec<Event> &src,
             const hardware::hidl_vec<SensorInfo> &dynamicSensorsAdded,
             sensors_event_t *dst);
+    // Converts a batch of events read from the event FMQ at once.
+    void convertToSensorEventsAndQuantize(const Event *src, size_t count, sensors_event_t *dst);
 
     float getResolutionForSensor(int sensorHandle);
 
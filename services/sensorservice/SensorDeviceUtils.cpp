@@ -20,6 +20,8 @@
 #include <android/hardware/sensors/2.1/ISensors.h>
 #include <utils/Log.h>
 
+#include "convertV2_1.h"
+
 #include <chrono>
 #include <thread>
 
@@ -35,16 +37,23 @@ void quantizeSensorEventValues(sensors_event_t *event, float resolution) {
         return;
     }
 
-    size_t axes = 0;
-    switch ((SensorTypeV2_1)event->type) {
+    // sensor_event_t is a union so we're able to perform the same quanitization action for most
+    // sensors by only knowing the number of axes their output data has.
+    const size_t axes = quantizedAxesForSensorType(event->type);
+    for (size_t i = 0; i < axes; i++) {
+        quantizeValue(&event->data[i], resolution);
+    }
+}
+
+size_t quantizedAxesForSensorType(int type) {
+    switch ((SensorTypeV2_1)type) {
         case SensorTypeV2_1::ACCELEROMETER:
         case SensorTypeV2_1::MAGNETIC_FIELD:
         case SensorTypeV2_1::GYROSCOPE:
         case SensorTypeV2_1::MAGNETIC_FIELD_UNCALIBRATED:
         case SensorTypeV2_1::GYROSCOPE_UNCALIBRATED:
         case SensorTypeV2_1::ACCELEROMETER_UNCALIBRATED:
-            axes = 3;
-            break;
+            return 3;
         case SensorTypeV2_1::DEVICE_ORIENTATION:
         case SensorTypeV2_1::LIGHT:
         case SensorTypeV2_1::PRESSURE:
@@ -64,17 +73,29 @@ void quantizeSensorEventValues(sensors_event_t *event, float resolution) {
         case SensorTypeV2_1::HEART_BEAT:
         case SensorTypeV2_1::LOW_LATENCY_OFFBODY_DETECT:
         case SensorTypeV2_1::HINGE_ANGLE:
-            axes = 1;
-            break;
+            return 1;
         default:
             // No other sensors have data that needs to be quantized.
-            break;
+            return 0;
     }
+}
 
-    // sensor_event_t is a union so we're able to perform the same quanitization action for most
-    // sensors by only knowing the number of axes their output data has.
-    for (size_t i = 0; i < axes; i++) {
-        quantizeValue(&event->data[i], resolution);
+void convertToSensorEventsAndQuantize(const hardware::sensors::V2_1::Event *src, size_t count,
+        sensors_event_t *dst, const std::function<float(int32_t)> &getResolution) {
+    size_t i = 0;
+    while (i < count) {
+        const int32_t sensorHandle = src[i].sensorHandle;
+        const SensorTypeV2_1 sensorType = src[i].sensorType;
+        const float resolution = getResolution(sensorHandle);
+        const size_t axes = resolution == 0 ? 0 : quantizedAxesForSensorType((int)sensorType);
+
+        for (; i < count && src[i].sensorHandle == sensorHandle
+                && src[i].sensorType == sensorType; i++) {
+            hardware::sensors::V2_1::implementation::convertToSensorEvent(src[i], &dst[i]);
+            for (size_t axis = 0; axis < axes; axis++) {
+                quantizeValue(&dst[i].data[axis], resolution);
+            }
+        }
     }
 }
 
@@ -17,12 +17,14 @@
 #ifndef ANDROID_SENSOR_DEVICE_UTIL
 #define ANDROID_SENSOR_DEVICE_UTIL
 
+#include <android/hardware/sensors/2.1/types.h>
 #include <android/hidl/manager/1.0/IServiceNotification.h>
 #include <hardware/sensors.h>
 #include <utils/Log.h>
 
 #include <cmath>
 #include <condition_variable>
+#include <functional>
 #include <thread>
 
 using ::android::hardware::hidl_string;
@@ -47,6 +49,16 @@ inline void quantizeValue(float *value, double resolution, double factor = 0.125
 // Ensures a sensor event doesn't provide values finer grained than its sensor resolution allows.
 void quantizeSensorEventValues(sensors_event_t *event, float resolution);
 
+// Returns the number of values that quantizeSensorEventValues() quantizes for a sensor type.
+size_t quantizedAxesForSensorType(int type);
+
+// Converts a batch of HAL events and quantizes their values, like quantizeSensorEventValues().
+// HALs deliver batched samples of a sensor back to back, so the resolution and the values to
+// quantize are looked up once per run of events from the same sensor rather than per event.
+// Dynamic sensor meta events are converted without their sensor, which the caller must fill in.
+void convertToSensorEventsAndQuantize(const hardware::sensors::V2_1::Event *src, size_t count,
+        sensors_event_t *dst, const std::function<float(int32_t)> &getResolution);
+
 // Returns the expected resolution value for the given sensor
 float resolutionForSensor(const sensor_t &sensor);
 
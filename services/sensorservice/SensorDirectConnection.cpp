@@ -20,6 +20,12 @@
 #include <frameworks/base/core/proto/android/service/sensor_service.proto.h>
 #include <hardware/sensors.h>
 
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "SensorServiceUtils.h"
+
 #define UNUSED(x) (void)(x)
 
 namespace android {
@@ -31,7 +37,8 @@ SensorService::SensorDirectConnection::SensorDirectConnection(const sp<SensorSer
         const String16& opPackageName)
         : mService(service), mUid(uid), mMem(*mem),
         mHalChannelHandle(halChannelHandle),
-        mOpPackageName(opPackageName), mDestroyed(false) {
+        mOpPackageName(opPackageName), mVirtualSensorsSuspended(false), mSharedEvents(nullptr),
+        mSharedEventCount(0), mNextSharedEvent(0), mEventCounter(0), mDestroyed(false) {
     mIsRateCappedBasedOnPermission = mService->isRateCappedBasedOnPermission(mOpPackageName);
     mUserId = multiuser_get_user_id(mUid);
     ALOGD_IF(DEBUG_CONNECTIONS, "Created SensorDirectConnection");
@@ -50,7 +57,15 @@ void SensorService::SensorDirectConnection::destroy() {
     }
 
     stopAll();
+    stopVirtualSensors();
     mService->cleanupConnection(this);
+    {
+        Mutex::Autolock _l(mConnectionLock);
+        if (mSharedEvents != nullptr) {
+            munmap(mSharedEvents, mMem.size);
+            mSharedEvents = nullptr;
+        }
+    }
     if (mMem.handle != nullptr) {
         native_handle_close(mMem.handle);
         native_handle_delete(const_cast<struct native_handle*>(mMem.handle));
@@ -64,10 +79,15 @@ void SensorService::SensorDirectConnection::onFirstRef() {
 void SensorService::SensorDirectConnection::dump(String8& result) const {
     Mutex::Autolock _l(mConnectionLock);
     result.appendFormat("\tPackage %s, HAL channel handle %d, total sensor activated %zu\n",
-            String8(mOpPackageName).string(), getHalChannelHandle(), mActivated.size());
+            String8(mOpPackageName).string(), getHalChannelHandle(),
+            mActivated.size() + mActivatedVirtual.size());
     for (auto &i : mActivated) {
         result.appendFormat("\t\tSensor %#08x, rate %d\n", i.first, i.second);
     }
+    for (auto &i : mActivatedVirtual) {
+        result.appendFormat("\t\tSensor %#08x, rate %d (virtual%s)\n", i.first,
+                i.second.rateLevel, mVirtualSensorsSuspended ? ", suspended" : "");
+    }
 }
 
 /**
@@ -82,13 +102,19 @@ void SensorService::SensorDirectConnection::dump(ProtoOutputStream* proto) const
     Mutex::Autolock _l(mConnectionLock);
     proto->write(PACKAGE_NAME, std::string(String8(mOpPackageName).string()));
     proto->write(HAL_CHANNEL_HANDLE, getHalChannelHandle());
-    proto->write(NUM_SENSOR_ACTIVATED, int(mActivated.size()));
+    proto->write(NUM_SENSOR_ACTIVATED, int(mActivated.size() + mActivatedVirtual.size()));
     for (auto &i : mActivated) {
         uint64_t token = proto->start(SENSORS);
         proto->write(SensorProto::SENSOR, i.first);
         proto->write(SensorProto::RATE, i.second);
         proto->end(token);
     }
+    for (auto &i : mActivatedVirtual) {
+        uint64_t token = proto->start(SENSORS);
+        proto->write(SensorProto::SENSOR, i.first);
+        proto->write(SensorProto::RATE, i.second.rateLevel);
+        proto->end(token);
+    }
 }
 
 sp<BitTube> SensorService::SensorDirectConnection::getSensorChannel() const {
@@ -101,6 +127,7 @@ void SensorService::SensorDirectConnection::onSensorAccessChanged(bool hasAccess
     } else {
         recoverAll();
     }
+    onVirtualSensorAccessChanged(hasAccess);
 }
 
 void SensorService::SensorDirectConnection::onMicSensorAccessChanged(bool isMicToggleOn) {
@@ -144,6 +171,7 @@ int32_t SensorService::SensorDirectConnection::configureChannel(int handle, int
 
     if (handle == -1 && rateLevel == SENSOR_DIRECT_RATE_STOP) {
         stopAll();
+        stopVirtualSensors();
         mMicRateBackup.clear();
         return NO_ERROR;
     }
@@ -168,6 +196,10 @@ int32_t SensorService::SensorDirectConnection::configureChannel(int handle, int
         return INVALID_OPERATION;
     }
 
+    if (si->isVirtual()) {
+        return configureVirtualSensor(handle, rateLevel);
+    }
+
     int requestedRateLevel = rateLevel;
     if (mService->isSensorInCappedSet(s.getType()) && rateLevel != SENSOR_DIRECT_RATE_STOP) {
         status_t err = mService->adjustRateLevelBasedOnMicAndPermission(&rateLevel, mOpPackageName);
@@ -181,6 +213,11 @@ int32_t SensorService::SensorDirectConnection::configureChannel(int handle, int
     };
 
     Mutex::Autolock _l(mConnectionLock);
+    // The HAL and SensorService can't both write into the same ring of events.
+    if (rateLevel != SENSOR_DIRECT_RATE_STOP
+            && (getHalChannelHandle() <= 0 || !mActivatedVirtual.empty())) {
+        return INVALID_OPERATION;
+    }
     SensorDevice& dev(SensorDevice::getInstance());
     int ret = dev.configureDirectChannel(handle, getHalChannelHandle(), &config);
 
@@ -210,6 +247,132 @@ int32_t SensorService::SensorDirectConnection::configureChannel(int handle, int
     return ret;
 }
 
+int32_t SensorService::SensorDirectConnection::configureVirtualSensor(int handle, int rateLevel) {
+    if (rateLevel != SENSOR_DIRECT_RATE_STOP) {
+        Mutex::Autolock _l(mConnectionLock);
+        // The HAL and SensorService can't both write into the same ring of events.
+        if (!mActivated.empty() || !mActivatedBackup.empty()) {
+            return INVALID_OPERATION;
+        }
+        if (!mapSharedMemoryLocked()) {
+            return NO_MEMORY;
+        }
+    }
+
+    // SensorService::mLock is taken before mConnectionLock, so it must not be held here.
+    status_t err = mService->setVirtualSensorDirectReport(this, handle, rateLevel);
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    Mutex::Autolock _l(mConnectionLock);
+    if (rateLevel == SENSOR_DIRECT_RATE_STOP) {
+        mActivatedVirtual.erase(handle);
+        return NO_ERROR;
+    }
+    const nsecs_t samplingPeriodNs =
+            SensorServiceUtil::samplingPeriodNsByDirectRateLevel(rateLevel);
+    // Allow for some jitter in the underlying sensors, so that e.g. a 200 Hz accelerometer that
+    // runs slightly fast doesn't get every other event dropped.
+    mActivatedVirtual[handle] = {
+        .rateLevel = rateLevel,
+        .minIntervalNs = samplingPeriodNs - samplingPeriodNs / 10,
+        .lastTimestamp = 0,
+    };
+    return handle;
+}
+
+void SensorService::SensorDirectConnection::stopVirtualSensors() {
+    std::unordered_map<int, VirtualSensorReport> activated;
+    bool suspended;
+    {
+        Mutex::Autolock _l(mConnectionLock);
+        activated.swap(mActivatedVirtual);
+        suspended = mVirtualSensorsSuspended;
+    }
+    // Suspended sensors have already been stopped in SensorService.
+    if (!suspended) {
+        for (auto &i : activated) {
+            mService->setVirtualSensorDirectReport(this, i.first, SENSOR_DIRECT_RATE_STOP);
+        }
+    }
+}
+
+void SensorService::SensorDirectConnection::onVirtualSensorAccessChanged(bool hasAccess) {
+    Mutex::Autolock _l(mConnectionLock);
+    if (mVirtualSensorsSuspended != hasAccess) {
+        return;
+    }
+    mVirtualSensorsSuspended = !hasAccess;
+    for (auto &i : mActivatedVirtual) {
+        mService->setVirtualSensorDirectReportLocked(this, i.first,
+                hasAccess ? i.second.rateLevel : SENSOR_DIRECT_RATE_STOP);
+        i.second.lastTimestamp = 0;
+    }
+}
+
+void SensorService::SensorDirectConnection::writeVirtualSensorEvents(
+        const sensors_event_t* buffer, const SensorEventIndex& index) {
+    Mutex::Autolock _l(mConnectionLock);
+    if (mVirtualSensorsSuspended || mSharedEvents == nullptr) {
+        return;
+    }
+    for (auto &i : mActivatedVirtual) {
+        const auto positions = index.find(i.first);
+        if (positions == index.end()) {
+            continue;
+        }
+        VirtualSensorReport& report = i.second;
+        for (size_t position : positions->second) {
+            const sensors_event_t& event = buffer[position];
+            // Flush complete events are indexed under the flushed sensor too.
+            if (event.type == SENSOR_TYPE_META_DATA) {
+                continue;
+            }
+            if (report.lastTimestamp != 0
+                    && event.timestamp - report.lastTimestamp < report.minIntervalNs) {
+                continue;
+            }
+            report.lastTimestamp = event.timestamp;
+            writeEventLocked(event, i.first);
+        }
+    }
+}
+
+bool SensorService::SensorDirectConnection::mapSharedMemoryLocked() {
+    if (mSharedEvents != nullptr) {
+        return true;
+    }
+    if (mMem.type != SENSOR_DIRECT_MEM_TYPE_ASHMEM || mMem.size < sizeof(sensors_event_t)) {
+        return false;
+    }
+    void* base = mmap(nullptr, mMem.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      mMem.handle->data[0], 0);
+    if (base == MAP_FAILED) {
+        ALOGE("Failed to map direct channel memory: %s", strerror(errno));
+        return false;
+    }
+    mSharedEvents = static_cast<sensors_event_t*>(base);
+    mSharedEventCount = mMem.size / sizeof(sensors_event_t);
+    return true;
+}
+
+void SensorService::SensorDirectConnection::writeEventLocked(const sensors_event_t& event,
+                                                             int32_t token) {
+    // Same layout as HAL direct reports: the sensor field carries the report token and reserved0
+    // an atomic counter starting from 1, which readers use to tell that the slot is complete.
+    sensors_event_t* slot = mSharedEvents + mNextSharedEvent;
+    mNextSharedEvent = (mNextSharedEvent + 1) % mSharedEventCount;
+    mEventCounter = mEventCounter == INT32_MAX ? 1 : mEventCounter + 1;
+
+    sensors_event_t out = event;
+    out.version = sizeof(sensors_event_t);
+    out.sensor = token;
+    out.reserved0 = __atomic_load_n(&slot->reserved0, __ATOMIC_RELAXED);
+    memcpy(slot, &out, sizeof(out));
+    __atomic_store_n(&slot->reserved0, mEventCounter, __ATOMIC_RELEASE);
+}
+
 void SensorService::SensorDirectConnection::capRates() {
     Mutex::Autolock _l(mConnectionLock);
     const struct sensors_direct_cfg_t capConfig = {
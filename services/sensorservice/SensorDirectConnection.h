@@ -53,6 +53,10 @@ public:
     void onMicSensorAccessChanged(bool isMicToggleOn);
     userid_t getUserId() const { return mUserId; }
 
+    // Writes the events of the virtual sensors configured on this channel into its shared memory,
+    // decimated to their rate levels. Called from the SensorService thread with mLock held.
+    void writeVirtualSensorEvents(const sensors_event_t* buffer, const SensorEventIndex& index);
+
 protected:
     virtual ~SensorDirectConnection();
     // ISensorEventConnection functions
@@ -84,6 +88,17 @@ private:
     // If no requests are backed up by stopAll(), this method is no-op.
     void recoverAll();
 
+    // Virtual sensors are reported by SensorService, not the HAL, so they are configured here
+    // rather than through SensorDevice. Returns the report token, which is the sensor handle.
+    int32_t configureVirtualSensor(int handle, int rateLevel);
+    // Stops all virtual sensors, called without SensorService::mLock held.
+    void stopVirtualSensors();
+    // Stops or restarts the virtual sensors when access changes, with SensorService::mLock held.
+    void onVirtualSensorAccessChanged(bool hasAccess);
+    // Maps the ashmem region for writing virtual sensor events into, if not already mapped.
+    bool mapSharedMemoryLocked();
+    void writeEventLocked(const sensors_event_t& event, int32_t token);
+
     // Limits all active sensor direct report requests when the mic toggle is flipped to on.
     void capRates();
     // Recover sensor requests previously capped by capRates().
@@ -100,6 +115,22 @@ private:
     std::unordered_map<int, int> mActivatedBackup;
     std::unordered_map<int, int> mMicRateBackup;
 
+    struct VirtualSensorReport {
+        int rateLevel;
+        // Events closer to the previous one than this are dropped to keep to the rate level.
+        nsecs_t minIntervalNs;
+        nsecs_t lastTimestamp;
+    };
+    std::unordered_map<int, VirtualSensorReport> mActivatedVirtual;
+    // Set while access is lost, the virtual sensors are stopped but kept in mActivatedVirtual.
+    bool mVirtualSensorsSuspended;
+
+    // Ring of events in the shared memory, only mapped once a virtual sensor is configured.
+    sensors_event_t* mSharedEvents;
+    size_t mSharedEventCount;
+    size_t mNextSharedEvent;
+    int32_t mEventCounter;
+
     std::atomic_bool mIsRateCappedBasedOnPermission;
     mutable Mutex mDestroyLock;
     bool mDestroyed;
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include <log/log.h>
 #include <sys/socket.h>
 #include <utils/threads.h>
@@ -41,7 +43,7 @@ SensorService::SensorEventConnection::SensorEventConnection(
         const String16& opPackageName, const String16& attributionTag)
     : mService(service), mUid(uid), mWakeLockRefCount(0), mHasLooperCallbacks(false),
       mDead(false), mDataInjectionMode(isDataInjectionMode), mEventCache(nullptr),
-      mCacheSize(0), mMaxCacheSize(0), mTimeOfLastEventDrop(0), mEventsDropped(0),
+      mCacheStart(0), mCacheSize(0), mMaxCacheSize(0), mTimeOfLastEventDrop(0), mEventsDropped(0),
       mPackageName(packageName), mOpPackageName(opPackageName), mAttributionTag(attributionTag),
       mTargetSdk(kTargetSdkUnknown), mDestroyed(false) {
     mIsRateCappedBasedOnPermission = mService->isRateCappedBasedOnPermission(mOpPackageName);
@@ -287,17 +289,59 @@ bool SensorService::SensorEventConnection::incrementPendingFlushCountIfHasAccess
     }
 }
 
+bool SensorService::SensorEventConnection::filterEventLocked(
+        sensors_event_t const* buffer, size_t index, FlushInfo& flushInfo,
+        wp<const SensorEventConnection> const* mapFlushEventsToConnections) {
+    const sensors_event_t& event = buffer[index];
+    if (event.type == SENSOR_TYPE_META_DATA) {
+        const bool isMappedToThis = mapFlushEventsToConnections[index] == this;
+        // Check if there is a pending flush_complete event for this sensor on this connection.
+        if (flushInfo.mFirstFlushPending && isMappedToThis) {
+            flushInfo.mFirstFlushPending = false;
+            ALOGD_IF(DEBUG_CONNECTIONS, "First flush event for sensor==%d ",
+                    event.meta_data.sensor);
+            return false;
+        }
+        // Flush complete events are only sent to the connection that they are mapped to.
+        return !flushInfo.mFirstFlushPending && isMappedToThis;
+    }
+
+    // If there is a pending flush complete event for this sensor on this connection, ignore the
+    // event. Otherwise copy it to the scratch buffer after checking the AppOp.
+    return !flushInfo.mFirstFlushPending && hasSensorAccess() && noteOpIfRequired(event);
+}
+
 status_t SensorService::SensorEventConnection::sendEvents(
         sensors_event_t const* buffer, size_t numEvents,
         sensors_event_t* scratch,
-        wp<const SensorEventConnection> const * mapFlushEventsToConnections) {
+        wp<const SensorEventConnection> const * mapFlushEventsToConnections,
+        const SensorEventIndex* eventIndex) {
     // filter out events not for this connection
 
     std::unique_ptr<sensors_event_t[]> sanitizedBuffer;
 
     int count = 0;
     Mutex::Autolock _l(mConnectionLock);
-    if (scratch) {
+    if (scratch && eventIndex) {
+        mIndexedEvents.clear();
+        for (auto& [handle, flushInfo] : mSensorInfo) {
+            const auto it = eventIndex->find(handle);
+            if (it == eventIndex->end()) {
+                continue;
+            }
+            for (size_t i : it->second) {
+                mIndexedEvents.emplace_back(i, &flushInfo);
+            }
+        }
+        // Deliver the events in the order of the buffer, which is sorted by timestamp.
+        std::sort(mIndexedEvents.begin(), mIndexedEvents.end(),
+                  [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+        for (const auto& [i, flushInfo] : mIndexedEvents) {
+            if (filterEventLocked(buffer, i, *flushInfo, mapFlushEventsToConnections)) {
+                scratch[count++] = buffer[i];
+            }
+        }
+    } else if (scratch) {
         size_t i=0;
         while (i<numEvents) {
             int32_t sensor_handle = buffer[i].sensor;
@@ -318,38 +362,11 @@ status_t SensorService::SensorEventConnection::sendEvents(
             }
 
             FlushInfo& flushInfo = mSensorInfo[sensor_handle];
-            // Check if there is a pending flush_complete event for this sensor on this connection.
-            if (buffer[i].type == SENSOR_TYPE_META_DATA && flushInfo.mFirstFlushPending == true &&
-                    mapFlushEventsToConnections[i] == this) {
-                flushInfo.mFirstFlushPending = false;
-                ALOGD_IF(DEBUG_CONNECTIONS, "First flush event for sensor==%d ",
-                        buffer[i].meta_data.sensor);
-                ++i;
-                continue;
-            }
-
-            // If there is a pending flush complete event for this sensor on this connection,
-            // ignore the event and proceed to the next.
-            if (flushInfo.mFirstFlushPending) {
-                ++i;
-                continue;
-            }
-
             do {
-                // Keep copying events into the scratch buffer as long as they are regular
-                // sensor_events are from the same sensor_handle OR they are flush_complete_events
-                // from the same sensor_handle AND the current connection is mapped to the
-                // corresponding flush_complete_event.
-                if (buffer[i].type == SENSOR_TYPE_META_DATA) {
-                    if (mapFlushEventsToConnections[i] == this) {
-                        scratch[count++] = buffer[i];
-                    }
-                } else {
-                    // Regular sensor event, just copy it to the scratch buffer after checking
-                    // the AppOp.
-                    if (hasSensorAccess() && noteOpIfRequired(buffer[i])) {
-                        scratch[count++] = buffer[i];
-                    }
+                // Keep filtering events into the scratch buffer as long as they are from the same
+                // sensor_handle, to avoid looking up the FlushInfo again.
+                if (filterEventLocked(buffer, i, flushInfo, mapFlushEventsToConnections)) {
+                    scratch[count++] = buffer[i];
                 }
                 i++;
             } while ((i<numEvents) && ((buffer[i].sensor == sensor_handle &&
@@ -418,6 +435,7 @@ status_t SensorService::SensorEventConnection::sendEvents(
         if (mEventCache == nullptr) {
             mMaxCacheSize = computeMaxCacheSizeLocked();
             mEventCache = new sensors_event_t[mMaxCacheSize];
+            mCacheStart = 0;
             mCacheSize = 0;
         }
         // Save the events so that they can be written later
@@ -479,9 +497,13 @@ void SensorService::SensorEventConnection::reAllocateCacheLocked(sensors_event_t
                                                                  int count) {
     sensors_event_t *eventCache_new;
     const int new_cache_size = computeMaxCacheSizeLocked();
-    // Allocate new cache, copy over events from the old cache & scratch, free up memory.
+    // Allocate new cache, copy over events from the old cache & scratch, free up memory. The
+    // events of the old cache are unwrapped so that the new cache starts at index 0.
     eventCache_new = new sensors_event_t[new_cache_size];
-    memcpy(eventCache_new, mEventCache, mCacheSize * sizeof(sensors_event_t));
+    const int firstSegmentSize = std::min(mCacheSize, mMaxCacheSize - mCacheStart);
+    memcpy(eventCache_new, &mEventCache[mCacheStart], firstSegmentSize * sizeof(sensors_event_t));
+    memcpy(&eventCache_new[firstSegmentSize], mEventCache,
+            (mCacheSize - firstSegmentSize) * sizeof(sensors_event_t));
     memcpy(&eventCache_new[mCacheSize], scratch, count * sizeof(sensors_event_t));
 
     ALOGD_IF(DEBUG_CONNECTIONS, "reAllocateCacheLocked maxCacheSize=%d %d", mMaxCacheSize,
@@ -489,18 +511,31 @@ void SensorService::SensorEventConnection::reAllocateCacheLocked(sensors_event_t
 
     delete[] mEventCache;
     mEventCache = eventCache_new;
+    mCacheStart = 0;
     mCacheSize += count;
     mMaxCacheSize = new_cache_size;
 }
 
+void SensorService::SensorEventConnection::writeEventsToCacheLocked(sensors_event_t const* events,
+                                                                    int count) {
+    if (count <= 0) {
+        return;
+    }
+    const int end = (mCacheStart + mCacheSize) % mMaxCacheSize;
+    const int firstSegmentSize = std::min(count, mMaxCacheSize - end);
+    memcpy(&mEventCache[end], events, firstSegmentSize * sizeof(sensors_event_t));
+    memcpy(mEventCache, &events[firstSegmentSize],
+            (count - firstSegmentSize) * sizeof(sensors_event_t));
+    mCacheSize += count;
+}
+
 void SensorService::SensorEventConnection::appendEventsToCacheLocked(sensors_event_t const* events,
                                                                      int count) {
     if (count <= 0) {
         return;
     } else if (mCacheSize + count <= mMaxCacheSize) {
         // The events fit within the current cache: add them
-        memcpy(&mEventCache[mCacheSize], events, count * sizeof(sensors_event_t));
-        mCacheSize += count;
+        writeEventsToCacheLocked(events, count);
     } else if (mCacheSize + count <= computeMaxCacheSizeLocked()) {
         // The events fit within a resized cache: resize the cache and add the events
         reAllocateCacheLocked(events, count);
@@ -530,20 +565,20 @@ void SensorService::SensorEventConnection::appendEventsToCacheLocked(sensors_eve
         }
 
         // Check for any flush complete events in the events that will be dropped
-        countFlushCompleteEventsLocked(mEventCache, cachedEventsToDrop);
-        countFlushCompleteEventsLocked(events, newEventsToDrop);
+        if (cachedEventsToDrop > 0) {
+            const int firstSegmentSize =
+                    std::min(cachedEventsToDrop, mMaxCacheSize - mCacheStart);
+            countFlushCompleteEventsLocked(&mEventCache[mCacheStart], firstSegmentSize);
+            countFlushCompleteEventsLocked(mEventCache, cachedEventsToDrop - firstSegmentSize);
 
-        // Only shift the events if they will not all be overwritten
-        if (eventsToCopy != mMaxCacheSize) {
-            memmove(mEventCache, &mEventCache[cachedEventsToDrop],
-                    (mCacheSize - cachedEventsToDrop) * sizeof(sensors_event_t));
+            // The cache is circular, so dropping the oldest events only moves its start
+            mCacheStart = (mCacheStart + cachedEventsToDrop) % mMaxCacheSize;
+            mCacheSize -= cachedEventsToDrop;
         }
-        mCacheSize -= cachedEventsToDrop;
+        countFlushCompleteEventsLocked(events, newEventsToDrop);
 
         // Copy the events into the cache
-        memcpy(&mEventCache[mCacheSize], &events[newEventsToDrop],
-                eventsToCopy * sizeof(sensors_event_t));
-        mCacheSize += eventsToCopy;
+        writeEventsToCacheLocked(&events[newEventsToDrop], eventsToCopy);
     }
 }
 
@@ -588,15 +623,18 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
     Mutex::Autolock _l(mConnectionLock);
     // Send pending flush complete events (if any)
     sendPendingFlushEventsLocked();
-    for (int numEventsSent = 0; numEventsSent < mCacheSize;) {
-        const int numEventsToWrite = helpers::min(mCacheSize - numEventsSent, maxWriteSize);
+    int numEventsSent = 0;
+    while (mCacheSize > 0) {
+        // Only write up to the end of the circular cache. Any wrapped events are written by the
+        // next iteration.
+        sensors_event_t* const events = &mEventCache[mCacheStart];
+        const int numEventsToWrite = helpers::min(helpers::min(mCacheSize, maxWriteSize),
+                                                  mMaxCacheSize - mCacheStart);
         int index_wake_up_event = -1;
         if (hasSensorAccess()) {
-            index_wake_up_event =
-                      findWakeUpSensorEventLocked(mEventCache + numEventsSent, numEventsToWrite);
+            index_wake_up_event = findWakeUpSensorEventLocked(events, numEventsToWrite);
             if (index_wake_up_event >= 0) {
-                mEventCache[index_wake_up_event + numEventsSent].flags |=
-                        WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
+                events[index_wake_up_event].flags |= WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
                 ++mWakeLockRefCount;
 #if DEBUG_CONNECTIONS
                 ++mTotalAcksNeeded;
@@ -605,13 +643,11 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
         }
 
         ssize_t size = SensorEventQueue::write(mChannel,
-                          reinterpret_cast<ASensorEvent const*>(mEventCache + numEventsSent),
-                          numEventsToWrite);
+                          reinterpret_cast<ASensorEvent const*>(events), numEventsToWrite);
         if (size < 0) {
             if (index_wake_up_event >= 0) {
                 // If there was a wake_up sensor_event, reset the flag.
-                mEventCache[index_wake_up_event + numEventsSent].flags  &=
-                        ~WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
+                events[index_wake_up_event].flags &= ~WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
                 if (mWakeLockRefCount > 0) {
                     --mWakeLockRefCount;
                 }
@@ -619,21 +655,20 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
                 --mTotalAcksNeeded;
 #endif
             }
-            memmove(mEventCache, &mEventCache[numEventsSent],
-                                 (mCacheSize - numEventsSent) * sizeof(sensors_event_t));
             ALOGD_IF(DEBUG_CONNECTIONS, "wrote %d events from cache size==%d ",
                     numEventsSent, mCacheSize);
-            mCacheSize -= numEventsSent;
             return;
         }
+        mCacheStart = (mCacheStart + numEventsToWrite) % mMaxCacheSize;
+        mCacheSize -= numEventsToWrite;
         numEventsSent += numEventsToWrite;
 #if DEBUG_CONNECTIONS
         mEventsSentFromCache += numEventsToWrite;
 #endif
     }
-    ALOGD_IF(DEBUG_CONNECTIONS, "wrote all events from cache size=%d ", mCacheSize);
-    // All events from the cache have been sent. Reset cache size to zero.
-    mCacheSize = 0;
+    ALOGD_IF(DEBUG_CONNECTIONS, "wrote all events from cache size=%d ", numEventsSent);
+    // All events from the cache have been sent.
+    mCacheStart = 0;
     // There are no more events in the cache. We don't need to poll for write on the fd.
     // Update Looper registration.
     updateLooperRegistrationLocked(mService->getLooper());
@@ -53,8 +53,11 @@ public:
                           bool isDataInjectionMode, const String16& opPackageName,
                           const String16& attributionTag);
 
+    // If eventIndex is provided, only the events of the sensors registered on this connection are
+    // visited, instead of the whole buffer.
     status_t sendEvents(sensors_event_t const* buffer, size_t count, sensors_event_t* scratch,
-                        wp<const SensorEventConnection> const * mapFlushEventsToConnections = nullptr);
+                        wp<const SensorEventConnection> const * mapFlushEventsToConnections = nullptr,
+                        const SensorEventIndex* eventIndex = nullptr);
     bool hasSensor(int32_t handle) const;
     bool hasAnySensor() const;
     bool hasOneShotSensors() const;
@@ -116,6 +119,10 @@ private:
     // the cache.
     void appendEventsToCacheLocked(sensors_event_t const* events, int count);
 
+    // Copy the events to the end of the cache, wrapping around if needed. The cache must have
+    // enough free space for them.
+    void writeEventsToCacheLocked(sensors_event_t const* events, int count);
+
     // LooperCallback method. If there is data to read on this fd, it is an ack from the app that it
     // has read events from a wake up sensor, decrement mWakeLockRefCount.  If this fd is available
     // for writing send the data from the cache.
@@ -178,9 +185,19 @@ private:
     };
     // protected by SensorService::mLock. Key for this map is the sensor handle.
     std::unordered_map<int32_t, FlushInfo> mSensorInfo;
+    // Events gathered from the SensorEventIndex in sendEvents, kept to reuse the allocation.
+    // Protected by mConnectionLock.
+    std::vector<std::pair<size_t, FlushInfo*>> mIndexedEvents;
+
+    // Returns true if the event at the given index of the buffer should be copied to the client,
+    // and updates the pending flush state of its sensor.
+    bool filterEventLocked(sensors_event_t const* buffer, size_t index, FlushInfo& flushInfo,
+                           wp<const SensorEventConnection> const* mapFlushEventsToConnections);
 
+    // mEventCache is a circular buffer of mMaxCacheSize events. The mCacheSize cached events start
+    // at index mCacheStart, so sent or dropped events never need to be shifted.
     sensors_event_t *mEventCache;
-    int mCacheSize, mMaxCacheSize;
+    int mCacheStart, mCacheSize, mMaxCacheSize;
     int64_t mTimeOfLastEventDrop;
     int mEventsDropped;
     String8 mPackageName;
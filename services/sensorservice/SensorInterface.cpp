@@ -18,6 +18,7 @@
 #include "SensorDevice.h"
 #include "SensorFusion.h"
 #include "SensorService.h"
+#include "SensorServiceUtils.h"
 
 #include <stdint.h>
 #include <sys/types.h>
@@ -85,6 +86,24 @@ VirtualSensor::VirtualSensor() :
         BaseSensor(DUMMY_SENSOR), mSensorFusion(SensorFusion::getInstance()) {
 }
 
+void VirtualSensor::setDirectReportSupported() {
+    // Fusion produces an output per accelerometer event, so its minimum delay bounds the rate.
+    const int64_t minDelayNs = int64_t(mSensorFusion.getMinDelay()) * 1000;
+    int32_t rateLevel;
+    if (minDelayNs <= 0) {
+        return;
+    } else if (minDelayNs <= SensorServiceUtil::samplingPeriodNsByDirectRateLevel(
+                       SENSOR_DIRECT_RATE_FAST)) {
+        rateLevel = SENSOR_DIRECT_RATE_FAST;
+    } else if (minDelayNs <= SensorServiceUtil::samplingPeriodNsByDirectRateLevel(
+                       SENSOR_DIRECT_RATE_NORMAL)) {
+        rateLevel = SENSOR_DIRECT_RATE_NORMAL;
+    } else {
+        return;
+    }
+    mSensor.setDirectReportSupport(rateLevel, SENSOR_FLAG_DIRECT_CHANNEL_ASHMEM);
+}
+
 // ---------------------------------------------------------------------------
 
 ProximitySensor::ProximitySensor(const sensor_t& sensor, SensorService& service)
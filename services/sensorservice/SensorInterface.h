@@ -104,6 +104,10 @@ public:
     VirtualSensor();
     virtual bool isVirtual() const override { return true; }
 protected:
+    // Advertises ashmem direct channels for a fused sensor, up to the rate level fusion can run
+    // at. SensorService writes these reports itself, the HAL never sees them.
+    void setDirectReportSupported();
+
     SensorFusion& mSensorFusion;
 };
 
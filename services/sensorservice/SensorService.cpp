@@ -1063,12 +1063,16 @@ bool SensorService::threadLoop() {
             }
         }
 
+        // Index the events by sensor once, so that each connection only looks at the events of
+        // the sensors that it has registered for.
+        buildSensorEventIndex(mSensorEventBuffer, count, &mSensorEventIndex);
+
         // Send our events to clients. Check the state of wake lock for each client and release the
         // lock if none of the clients need it.
         bool needsWakeLock = false;
         for (const sp<SensorEventConnection>& connection : activeConnections) {
             connection->sendEvents(mSensorEventBuffer, count, mSensorEventScratch,
-                    mMapFlushEventsToConnections);
+                    mMapFlushEventsToConnections, &mSensorEventIndex);
             needsWakeLock |= connection->needsWakeLock();
             // If the connection has one-shot sensors, it may be cleaned up after first trigger.
             // Early check for one-shot sensors.
@@ -1077,6 +1081,13 @@ bool SensorService::threadLoop() {
             }
         }
 
+        // Virtual sensors reported through direct channels are written by us rather than the HAL.
+        if (!mVirtualDirectReports.empty()) {
+            for (const sp<SensorDirectConnection>& connection : connLock.getDirectConnections()) {
+                connection->writeVirtualSensorEvents(mSensorEventBuffer, mSensorEventIndex);
+            }
+        }
+
         if (mWakeLockAcquired && !needsWakeLock) {
             setWakeLockAcquiredLocked(false);
         }
@@ -1161,6 +1172,18 @@ void SensorService::sortEventBuffer(sensors_event_t* buffer, size_t count) {
     qsort(buffer, count, sizeof(sensors_event_t), compar::cmp);
 }
 
+void SensorService::buildSensorEventIndex(sensors_event_t const* buffer, size_t count,
+                                          SensorEventIndex* index) {
+    for (auto& [handle, positions] : *index) {
+        positions.clear();
+    }
+    for (size_t i = 0; i < count; i++) {
+        const int32_t handle = buffer[i].type == SENSOR_TYPE_META_DATA
+                ? buffer[i].meta_data.sensor : buffer[i].sensor;
+        (*index)[handle].push_back(i);
+    }
+}
+
 String8 SensorService::getSensorName(int handle) const {
     return mSensors.getName(handle);
 }
@@ -1418,11 +1441,19 @@ sp<ISensorEventConnection> SensorService::createSensorDirectConnection(
     SensorDevice& dev(SensorDevice::getInstance());
     int channelHandle = dev.registerDirectChannel(&mem);
 
-    if (channelHandle <= 0) {
-        ALOGE("SensorDevice::registerDirectChannel returns %d", channelHandle);
-    } else {
+    if (channelHandle > 0) {
         mem.handle = clone;
         conn = new SensorDirectConnection(this, uid, &mem, channelHandle, opPackageName);
+    } else if (type == SENSOR_DIRECT_MEM_TYPE_ASHMEM) {
+        // Without a HAL channel, ashmem can still carry virtual sensors, which SensorService
+        // writes itself.
+        ALOGI("SensorDevice::registerDirectChannel returns %d, only virtual sensors can be "
+              "configured", channelHandle);
+        mem.handle = clone;
+        conn = new SensorDirectConnection(this, uid, &mem, 0 /* halChannelHandle */,
+                                          opPackageName);
+    } else {
+        ALOGE("SensorDevice::registerDirectChannel returns %d", channelHandle);
     }
 
     if (conn == nullptr) {
@@ -1572,7 +1603,7 @@ void SensorService::cleanupConnection(SensorEventConnection* c) {
         if (rec && rec->removeConnection(connection)) {
             ALOGD_IF(DEBUG_CONNECTIONS, "... and it was the last connection");
             mActiveSensors.removeItemsAt(i, 1);
-            mActiveVirtualSensors.erase(handle);
+            removeActiveVirtualSensorLocked(handle);
             delete rec;
             size--;
         } else {
@@ -1602,10 +1633,64 @@ void SensorService::cleanupConnection(SensorDirectConnection* c) {
     Mutex::Autolock _l(mLock);
 
     SensorDevice& dev(SensorDevice::getInstance());
-    dev.unregisterDirectChannel(c->getHalChannelHandle());
+    if (c->getHalChannelHandle() > 0) {
+        dev.unregisterDirectChannel(c->getHalChannelHandle());
+    }
     mConnectionHolder.removeDirectConnection(c);
 }
 
+status_t SensorService::setVirtualSensorDirectReport(SensorDirectConnection* c, int handle,
+                                                     int rateLevel) {
+    Mutex::Autolock _l(mLock);
+    return setVirtualSensorDirectReportLocked(c, handle, rateLevel);
+}
+
+status_t SensorService::setVirtualSensorDirectReportLocked(SensorDirectConnection* c, int handle,
+                                                           int rateLevel) {
+    sp<SensorInterface> sensor = mSensors.getInterface(handle);
+    if (sensor == nullptr || !sensor->isVirtual()) {
+        return BAD_VALUE;
+    }
+
+    auto it = mVirtualDirectReports.find(handle);
+    if (rateLevel == SENSOR_DIRECT_RATE_STOP) {
+        if (it == mVirtualDirectReports.end() || it->second.erase(c) == 0) {
+            return NO_ERROR;
+        }
+        sensor->activate(c, false);
+        if (it->second.empty()) {
+            mVirtualDirectReports.erase(it);
+            if (mActiveSensors.valueFor(handle) == nullptr) {
+                mActiveVirtualSensors.erase(handle);
+            }
+        }
+        return NO_ERROR;
+    }
+
+    const nsecs_t samplingPeriodNs =
+            SensorServiceUtil::samplingPeriodNsByDirectRateLevel(rateLevel);
+    if (samplingPeriodNs == 0) {
+        return BAD_VALUE;
+    }
+    status_t err = sensor->setDelay(c, handle, samplingPeriodNs);
+    if (err == NO_ERROR) {
+        err = sensor->activate(c, true);
+    }
+    if (err != NO_ERROR) {
+        ALOGE("Failed to start direct report of virtual sensor 0x%08x: %d", handle, err);
+        return err;
+    }
+    mVirtualDirectReports[handle].insert(c);
+    mActiveVirtualSensors.emplace(handle);
+    return NO_ERROR;
+}
+
+void SensorService::removeActiveVirtualSensorLocked(int handle) {
+    if (mVirtualDirectReports.find(handle) == mVirtualDirectReports.end()) {
+        mActiveVirtualSensors.erase(handle);
+    }
+}
+
 void SensorService::onProximityActiveLocked(bool isActive) {
     int prevCount = mProximityActiveCount;
     bool activeStateChanged = false;
@@ -1867,7 +1952,7 @@ status_t SensorService::cleanupWithoutDisableLocked(
         // see if this sensor becomes inactive
         if (rec->removeConnection(connection)) {
             mActiveSensors.removeItem(handle);
-            mActiveVirtualSensors.erase(handle);
+            removeActiveVirtualSensorLocked(handle);
             delete rec;
         }
         return NO_ERROR;
@@ -136,6 +136,10 @@ private:
     class SensorRecord;
     class SensorRegistrationInfo;
 
+    // Positions of the events in mSensorEventBuffer, keyed by the handle of the sensor that they
+    // belong to. Flush complete events are keyed by the handle of the sensor that was flushed.
+    typedef std::unordered_map<int32_t, std::vector<size_t>> SensorEventIndex;
+
     // Promoting a SensorEventConnection or SensorDirectConnection from wp to sp must be done with
     // mLock held, but destroying that sp must be done unlocked to avoid a race condition that
     // causes a deadlock (remote dies while we hold a local sp, then our decStrong() call invokes
@@ -350,6 +354,10 @@ private:
     bool isWakeUpSensor(int type) const;
     void recordLastValueLocked(sensors_event_t const* buffer, size_t count);
     static void sortEventBuffer(sensors_event_t* buffer, size_t count);
+    // Fill the given index with the positions of the events in the buffer. Vectors of handles
+    // without events are cleared rather than erased to keep their storage across polls.
+    static void buildSensorEventIndex(sensors_event_t const* buffer, size_t count,
+                                      SensorEventIndex* index);
     const Sensor& registerSensor(SensorInterface* sensor,
                                  bool isDebug = false, bool isVirtual = false);
     const Sensor& registerVirtualSensor(SensorInterface* sensor, bool isDebug = false);
@@ -425,6 +433,15 @@ private:
     // Same as hasSensorAccess but with mLock held.
     bool hasSensorAccessLocked(uid_t uid, const String16& opPackageName);
 
+    // Starts, updates or, with SENSOR_DIRECT_RATE_STOP, stops a virtual sensor on behalf of a
+    // direct connection, which writes the sensor's events into its shared memory itself.
+    status_t setVirtualSensorDirectReport(SensorDirectConnection* c, int handle, int rateLevel);
+    // Same as setVirtualSensorDirectReport but with mLock held.
+    status_t setVirtualSensorDirectReportLocked(SensorDirectConnection* c, int handle,
+                                                int rateLevel);
+    // Removes a sensor from mActiveVirtualSensors, unless a direct connection still uses it.
+    void removeActiveVirtualSensorLocked(int handle);
+
     // Overrides the UID state as if it is idle
     status_t handleSetUidState(Vector<String16>& args, int err);
     // Clears the override for the UID state
@@ -465,12 +482,16 @@ private:
     mutable Mutex mLock;
     DefaultKeyedVector<int, SensorRecord*> mActiveSensors;
     std::unordered_set<int> mActiveVirtualSensors;
+    // Direct connections reporting each virtual sensor, keyed by handle. These hold no
+    // SensorRecord, as they don't go through the event connection path.
+    std::unordered_map<int, std::unordered_set<SensorDirectConnection*>> mVirtualDirectReports;
     SensorConnectionHolder mConnectionHolder;
     bool mWakeLockAcquired;
     sensors_event_t *mSensorEventBuffer, *mSensorEventScratch;
     // WARNING: these SensorEventConnection instances must not be promoted to sp, except via
     // modification to add support for them in ConnectionSafeAutolock
     wp<const SensorEventConnection> * mMapFlushEventsToConnections;
+    SensorEventIndex mSensorEventIndex;
     std::unordered_map<int, SensorServiceUtil::RecentEventLogger*> mRecentEvent;
     Mode mCurrentOperatingMode;
 
@@ -63,5 +63,18 @@ size_t eventSizeBySensorType(int type) {
     }
 }
 
+int64_t samplingPeriodNsByDirectRateLevel(int rateLevel) {
+    switch (rateLevel) {
+        case SENSOR_DIRECT_RATE_NORMAL:
+            return 20000000;   // 50 Hz
+        case SENSOR_DIRECT_RATE_FAST:
+            return 5000000;    // 200 Hz
+        case SENSOR_DIRECT_RATE_VERY_FAST:
+            return 1250000;    // 800 Hz
+        default:
+            return 0;
+    }
+}
+
 } // namespace SensorServiceUtil
 } // namespace android;
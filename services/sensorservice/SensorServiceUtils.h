@@ -18,6 +18,7 @@
 #define ANDROID_SENSOR_SERVICE_UTIL
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace android {
@@ -38,6 +39,10 @@ public:
 
 size_t eventSizeBySensorType(int type);
 
+// Nominal sampling period of a direct report rate level, or 0 for SENSOR_DIRECT_RATE_STOP and
+// unknown levels.
+int64_t samplingPeriodNsByDirectRateLevel(int rateLevel);
+
 } // namespace SensorServiceUtil
 } // namespace android;
 
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <poll.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <hardware/sensors.h>
+#include <sensor/BitTube.h>
+#include <sensor/SensorEventQueue.h>
+#include <utils/Timers.h>
+
+#include "../Fusion.h"
+#include "../RecentEventLogger.h"
+#include "../SensorDeviceUtils.h"
+#include "convertV2_1.h"
+
+namespace android {
+
+// The socket buffer size used by SensorService for connections with batched sensors
+static constexpr size_t SOCKET_BUFFER_SIZE = 100 * 1024;
+
+static constexpr float ACCELEROMETER_RATE_HZ = 400.f;
+
+static sensors_event_t createAccelerometerEvent(nsecs_t timestamp) {
+    sensors_event_t event{};
+    event.version = sizeof(sensors_event_t);
+    event.sensor = 1;
+    event.type = SENSOR_TYPE_ACCELEROMETER;
+    event.timestamp = timestamp;
+    event.acceleration.x = 0.1f;
+    event.acceleration.y = 0.2f;
+    event.acceleration.z = 9.8f;
+    return event;
+}
+
+static std::vector<sensors_event_t> createAccelerometerEvents(size_t count) {
+    std::vector<sensors_event_t> events;
+    for (size_t i = 0; i < count; i++) {
+        events.push_back(createAccelerometerEvent(i * s2ns(1) / ACCELEROMETER_RATE_HZ));
+    }
+    return events;
+}
+
+// --- SensorEventQueue over BitTube ---
+
+/**
+ * The last hop of the pipeline: SensorEventConnection writing a batch of events to the client
+ * socket, and the client reading it back. Runs on a single thread to measure the cost per event.
+ */
+static void benchmarkBitTubeThroughput(benchmark::State& state) {
+    const size_t batchSize = state.range(0);
+    sp<BitTube> tube = new BitTube(SOCKET_BUFFER_SIZE);
+    std::vector<sensors_event_t> events = createAccelerometerEvents(batchSize);
+    std::vector<ASensorEvent> received(batchSize);
+
+    for (auto _ : state) {
+        SensorEventQueue::write(tube, reinterpret_cast<ASensorEvent const*>(events.data()),
+                                batchSize);
+        benchmark::DoNotOptimize(BitTube::recvObjects(tube, received.data(), batchSize));
+    }
+    state.SetItemsProcessed(state.iterations() * batchSize);
+}
+BENCHMARK(benchmarkBitTubeThroughput)->Arg(1)->Arg(16)->Arg(128);
+
+/**
+ * Latency from the service writing an event until a client thread, blocked in poll() like
+ * Looper-based clients, has read it. Reported as the average in the "latency_us" counter.
+ */
+static void benchmarkBitTubeLatency(benchmark::State& state) {
+    sp<BitTube> tube = new BitTube(SOCKET_BUFFER_SIZE);
+    std::atomic<size_t> numReceived = 0;
+    std::atomic<nsecs_t> totalLatency = 0;
+    std::atomic_bool stop = false;
+
+    std::thread client([&]() {
+        struct pollfd fd = {.fd = tube->getFd(), .events = POLLIN};
+        ASensorEvent event;
+        while (!stop) {
+            if (poll(&fd, 1, 10 /*ms*/) <= 0) {
+                continue;
+            }
+            if (BitTube::recvObjects(tube, &event, 1) == 1) {
+                totalLatency += systemTime(SYSTEM_TIME_MONOTONIC) - event.timestamp;
+                numReceived++;
+            }
+        }
+    });
+
+    size_t numSent = 0;
+    for (auto _ : state) {
+        const sensors_event_t event = createAccelerometerEvent(systemTime(SYSTEM_TIME_MONOTONIC));
+        SensorEventQueue::write(tube, reinterpret_cast<ASensorEvent const*>(&event), 1);
+        numSent++;
+        while (numReceived < numSent) {
+            // Wait for the client to consume the event before sending the next one
+        }
+    }
+    stop = true;
+    client.join();
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["latency_us"] = numSent == 0 ? 0 : ns2us(totalLatency / numSent);
+}
+BENCHMARK(benchmarkBitTubeLatency);
+
+// --- RecentEventLogger ---
+
+/**
+ * Cost that the recent event log adds to every event in SensorService::threadLoop.
+ */
+static void benchmarkRecentEventLoggerAddEvent(benchmark::State& state) {
+    SensorServiceUtil::RecentEventLogger logger(SENSOR_TYPE_ACCELEROMETER);
+    const sensors_event_t event = createAccelerometerEvent(0);
+
+    for (auto _ : state) {
+        logger.addEvent(event);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(benchmarkRecentEventLoggerAddEvent);
+
+static void benchmarkRecentEventLoggerDump(benchmark::State& state) {
+    SensorServiceUtil::RecentEventLogger logger(SENSOR_TYPE_ACCELEROMETER);
+    for (const sensors_event_t& event : createAccelerometerEvents(100)) {
+        logger.addEvent(event);
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(logger.dump());
+    }
+}
+BENCHMARK(benchmarkRecentEventLoggerDump);
+
+// --- HAL event conversion ---
+
+using HalEvent = hardware::sensors::V2_1::Event;
+using HalSensorType = hardware::sensors::V2_1::SensorType;
+
+// Roughly the size of a phone's sensor list, which SensorDevice searches for resolutions.
+static constexpr int32_t NUM_HAL_SENSORS = 40;
+static constexpr int32_t ACCELEROMETER_HANDLE = NUM_HAL_SENSORS - 2;
+static constexpr int32_t GYROSCOPE_HANDLE = NUM_HAL_SENSORS - 1;
+
+static std::vector<sensor_t> createHalSensorList() {
+    std::vector<sensor_t> sensors(NUM_HAL_SENSORS);
+    for (int32_t i = 0; i < NUM_HAL_SENSORS; i++) {
+        sensors[i].handle = i;
+        sensors[i].resolution = 0.001f;
+    }
+    return sensors;
+}
+
+static float getResolutionFromSensorList(const std::vector<sensor_t>& sensors, int32_t handle) {
+    // Same linear search as SensorDevice::getResolutionForSensor
+    for (const sensor_t& sensor : sensors) {
+        if (sensor.handle == handle) {
+            return sensor.resolution;
+        }
+    }
+    return 0;
+}
+
+/**
+ * A batch of IMU samples as a HAL flushes them out of its FIFOs: a run of accelerometer events
+ * followed by a run of gyroscope events.
+ */
+static std::vector<HalEvent> createHalImuEvents(size_t count) {
+    std::vector<HalEvent> events(count);
+    for (size_t i = 0; i < count; i++) {
+        HalEvent& event = events[i];
+        const bool isAccelerometer = i < count / 2;
+        event.sensorHandle = isAccelerometer ? ACCELEROMETER_HANDLE : GYROSCOPE_HANDLE;
+        event.sensorType =
+                isAccelerometer ? HalSensorType::ACCELEROMETER : HalSensorType::GYROSCOPE;
+        event.timestamp = i * s2ns(1) / ACCELEROMETER_RATE_HZ;
+        event.u.vec3.x = 0.1f;
+        event.u.vec3.y = 0.2f;
+        event.u.vec3.z = 9.8f;
+    }
+    return events;
+}
+
+/**
+ * Converting and quantizing a batch of events one at a time, as SensorDevice did before batching,
+ * for comparison with benchmarkConvertHalEventsBatched.
+ */
+static void benchmarkConvertHalEventsPerEvent(benchmark::State& state) {
+    const size_t batchSize = state.range(0);
+    const std::vector<sensor_t> sensors = createHalSensorList();
+    const std::vector<HalEvent> events = createHalImuEvents(batchSize);
+    std::vector<sensors_event_t> converted(batchSize);
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < batchSize; i++) {
+            hardware::sensors::V2_1::implementation::convertToSensorEvent(events[i],
+                                                                          &converted[i]);
+            SensorDeviceUtils::quantizeSensorEventValues(&converted[i],
+                    getResolutionFromSensorList(sensors, converted[i].sensor));
+        }
+        benchmark::DoNotOptimize(converted.data());
+    }
+    state.SetItemsProcessed(state.iterations() * batchSize);
+}
+BENCHMARK(benchmarkConvertHalEventsPerEvent)->Arg(1)->Arg(16)->Arg(128);
+
+/**
+ * The conversion SensorDevice does for every poll, with resolutions looked up once per run of
+ * events from the same sensor.
+ */
+static void benchmarkConvertHalEventsBatched(benchmark::State& state) {
+    const size_t batchSize = state.range(0);
+    const std::vector<sensor_t> sensors = createHalSensorList();
+    const std::vector<HalEvent> events = createHalImuEvents(batchSize);
+    std::vector<sensors_event_t> converted(batchSize);
+    const auto getResolution = [&sensors](int32_t handle) {
+        return getResolutionFromSensorList(sensors, handle);
+    };
+
+    for (auto _ : state) {
+        SensorDeviceUtils::convertToSensorEventsAndQuantize(events.data(), batchSize,
+                                                            converted.data(), getResolution);
+        benchmark::DoNotOptimize(converted.data());
+    }
+    state.SetItemsProcessed(state.iterations() * batchSize);
+}
+BENCHMARK(benchmarkConvertHalEventsBatched)->Arg(1)->Arg(16)->Arg(128);
+
+// --- Fusion ---
+
+/**
+ * Per-sample cost of the virtual sensors fusion, for each fusion mode. A gyro and an accelerometer
+ * sample are processed per iteration, like SensorFusion does at matching sensor rates.
+ */
+static void benchmarkFusion(benchmark::State& state) {
+    const int mode = state.range(0);
+    const float dT = 1.f / ACCELEROMETER_RATE_HZ;
+    const vec3_t gyro(0.01f, 0.02f, 0.03f);
+    const vec3_t acc(0.1f, 0.2f, 9.8f);
+    const vec3_t mag(20.f, 0.f, -40.f);
+
+    Fusion fusion;
+    fusion.init(mode);
+    // Feed enough samples for the fusion to complete its initialization
+    for (int i = 0; i < 100; i++) {
+        fusion.handleGyro(gyro, dT);
+        fusion.handleAcc(acc, dT);
+        fusion.handleMag(mag);
+    }
+
+    for (auto _ : state) {
+        fusion.handleGyro(gyro, dT);
+        fusion.handleAcc(acc, dT);
+        benchmark::DoNotOptimize(fusion.getAttitude());
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(benchmarkFusion)->Arg(FUSION_9AXIS)->Arg(FUSION_NOMAG)->Arg(FUSION_NOGYRO);
+
+} // namespace android
+
+BENCHMARK_MAIN();
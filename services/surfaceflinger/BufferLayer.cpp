@@ -230,6 +230,7 @@ std::optional<compositionengine::LayerFE::LayerSettings> BufferLayer::prepareCli
         }
     }
     layer.source.buffer.maxLuminanceNits = maxLuminance;
+    layer.source.buffer.frameNumber = mCurrentFrameNumber;
     layer.frameNumber = mCurrentFrameNumber;
     layer.bufferId = mBufferInfo.mBuffer ? mBufferInfo.mBuffer->getBuffer()->getId() : 0;
 
@@ -547,6 +548,8 @@ bool BufferLayer::latchBuffer(bool& recomputeVisibleRegions, nsecs_t latchTime,
     }
 
     gatherBufferInfo();
+    // The source bounds come from the buffer.
+    invalidateBounds();
 
     mRefreshPending = true;
     if (oldBufferInfo.mBuffer == nullptr) {
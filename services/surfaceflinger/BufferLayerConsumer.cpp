@@ -480,6 +480,16 @@ void BufferLayerConsumer::addAndGetFrameTimestamps(const NewFrameEventsEntry* ne
     mLayer->addAndGetFrameTimestamps(newTimestamps, outDelta);
 }
 
+status_t BufferLayerConsumer::getFrameTimestampRing(base::unique_fd* outFd) {
+    Mutex::Autolock lock(mMutex);
+
+    if (mAbandoned) {
+        return NO_INIT;
+    }
+
+    return mLayer->getFrameTimestampRing(outFd);
+}
+
 void BufferLayerConsumer::abandonLocked() {
     BLC_LOGV("abandonLocked");
     mCurrentTextureBuffer = nullptr;
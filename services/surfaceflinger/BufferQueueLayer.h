@@ -45,6 +45,7 @@ public:
     void onLayerDisplayed(const sp<Fence>& releaseFence) override;
 
     std::vector<OccupancyTracker::Segment> getOccupancyHistory(bool forceFlush) override;
+    void dumpBufferQueue(std::string& result) const override;
 
     // If a buffer was replaced this frame, release the former buffer
     void releasePendingBuffer(nsecs_t dequeueReadyTime) override;
@@ -170,6 +170,12 @@ void BufferStateLayer::onLayerDisplayed(const sp<Fence>& releaseFence) {
 
     mPreviousReleaseFence = releaseFence;
 
+    if (mPreviousReleaseBufferListener) {
+        mEarlyReleaseFence = mEarlyReleaseFence
+                ? Fence::merge("EarlyRelease", mEarlyReleaseFence, releaseFence)
+                : releaseFence;
+    }
+
     // Prevent tracing the same release multiple times.
     if (mPreviousFrameNumber != mPreviousReleasedFrameNumber) {
         mPreviousReleasedFrameNumber = mPreviousFrameNumber;
@@ -205,10 +211,27 @@ void BufferStateLayer::releasePendingBuffer(nsecs_t dequeueReadyTime) {
     // listening end point is the same but the client expects the first transaction callback that
     // replaces the presented buffer to contain the release fence. This follows the same logic.
     // see BufferStateLayer::onLayerDisplayed.
-    for (auto& handle : mDrawingState.callbackHandles) {
-        if (handle->releasePreviousBuffer) {
-            handle->previousReleaseCallbackId = mPreviousReleaseCallbackId;
-            break;
+    //
+    // With early buffer release the previous buffer is instead released on its own, as soon as the
+    // frame that replaced it is presented, so that it does not wait for the transaction callbacks
+    // of this frame to complete. If the layer was not displayed in this frame, the present fence
+    // tells when the previous buffer is no longer read.
+    if (mPreviousReleaseBufferListener) {
+        sp<Fence> releaseFence = mEarlyReleaseFence ? mEarlyReleaseFence
+                                                    : mFlinger->mPreviousPresentFences[0].fence;
+        mFlinger->getTransactionCallbackInvoker().addReleaseBufferCallback(
+                mPreviousReleaseBufferListener,
+                {mPreviousReleaseCallbackId, releaseFence ? releaseFence : Fence::NO_FENCE,
+                 mTransformHint,
+                 mFlinger->getMaxAcquiredBufferCountForCurrentRefreshRate(mOwnerUid)});
+        mPreviousReleaseBufferListener = nullptr;
+        mEarlyReleaseFence = nullptr;
+    } else {
+        for (auto& handle : mDrawingState.callbackHandles) {
+            if (handle->releasePreviousBuffer) {
+                handle->previousReleaseCallbackId = mPreviousReleaseCallbackId;
+                break;
+            }
         }
     }
 
@@ -441,12 +464,17 @@ bool BufferStateLayer::setBuffer(const std::shared_ptr<renderengine::ExternalTex
             // If mDrawingState has a buffer, and we are about to update again
             // before swapping to drawing state, then the first buffer will be
             // dropped and we should decrement the pending buffer count and
-            // call any release buffer callbacks if set.
-            callReleaseBufferCallback(mDrawingState.releaseBufferListener,
-                                      mDrawingState.buffer->getBuffer(), mDrawingState.frameNumber,
-                                      mDrawingState.acquireFence, mTransformHint,
-                                      mFlinger->getMaxAcquiredBufferCountForCurrentRefreshRate(
-                                              mOwnerUid));
+            // call any release buffer callbacks if set. They are sent with this frame's other
+            // callbacks to the same listener.
+            if (mDrawingState.releaseBufferListener) {
+                mFlinger->getTransactionCallbackInvoker().addReleaseBufferCallback(
+                        mDrawingState.releaseBufferListener,
+                        {{mDrawingState.buffer->getBuffer()->getId(), mDrawingState.frameNumber},
+                         mDrawingState.acquireFence ? mDrawingState.acquireFence
+                                                    : Fence::NO_FENCE,
+                         mTransformHint,
+                         mFlinger->getMaxAcquiredBufferCountForCurrentRefreshRate(mOwnerUid)});
+            }
             decrementPendingBufferCount();
             if (mDrawingState.bufferSurfaceFrameTX != nullptr &&
                 mDrawingState.bufferSurfaceFrameTX->getPresentState() != PresentState::Presented) {
@@ -803,6 +831,10 @@ status_t BufferStateLayer::updateActiveBuffer() {
     }
 
     mPreviousReleaseCallbackId = {getCurrentBufferId(), mBufferInfo.mFrameNumber};
+    if (mFlinger->isEarlyBufferReleaseEnabled() && mBufferInfo.mBuffer) {
+        mPreviousReleaseBufferListener = mCurrentReleaseBufferListener;
+    }
+    mCurrentReleaseBufferListener = s.releaseBufferListener;
     mBufferInfo.mBuffer = s.buffer;
     mBufferInfo.mFence = s.acquireFence;
     mBufferInfo.mFrameNumber = s.frameNumber;
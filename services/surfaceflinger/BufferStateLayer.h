@@ -144,6 +144,14 @@ private:
 
     sp<Fence> mPreviousReleaseFence;
     ReleaseCallbackId mPreviousReleaseCallbackId = ReleaseCallbackId::INVALID_ID;
+    // Listener of the previously latched buffer. Only set while that buffer is waiting to be
+    // released early, see SurfaceFlinger::isEarlyBufferReleaseEnabled.
+    sp<ITransactionCompletedListener> mPreviousReleaseBufferListener;
+    // Release fences of the displays that showed this layer in the frame that replaced the
+    // previous buffer, merged.
+    sp<Fence> mEarlyReleaseFence;
+    // Listener of the currently latched buffer.
+    sp<ITransactionCompletedListener> mCurrentReleaseBufferListener;
     uint64_t mPreviousReleasedFrameNumber = 0;
 
     bool mReleasePreviousBuffer = false;
@@ -21,6 +21,9 @@
 
 #include <cinttypes>
 
+#include <gui/ITransactionCompletedListener.h>
+#include <ui/PixelFormat.h>
+
 #include "ClientCache.h"
 
 namespace android {
@@ -29,10 +32,22 @@ using base::StringAppendF;
 
 ANDROID_SINGLETON_STATIC_INSTANCE(ClientCache);
 
+namespace {
+
+size_t getBufferSize(const sp<GraphicBuffer>& buffer) {
+    // Formats without a fixed pixel size are YUV, which take less than 2 bytes per pixel.
+    const uint32_t bpp = bytesPerPixel(buffer->getPixelFormat());
+    return static_cast<size_t>(buffer->getStride()) * buffer->getHeight() *
+            buffer->getLayerCount() * (bpp > 0 ? bpp : 2);
+}
+
+} // namespace
+
 ClientCache::ClientCache() : mDeathRecipient(new CacheDeathRecipient) {}
 
 bool ClientCache::getBuffer(const client_cache_t& cacheId,
-                            ClientCacheBuffer** outClientCacheBuffer) {
+                            ClientCacheBuffer** outClientCacheBuffer,
+                            ProcessBuffers** outProcessBuffers) {
     auto& [processToken, id] = cacheId;
     if (processToken == nullptr) {
         ALOGE("failed to get buffer, invalid (nullptr) process token");
@@ -44,10 +59,13 @@ bool ClientCache::getBuffer(const client_cache_t& cacheId,
         return false;
     }
 
-    auto& processBuffers = it->second.second;
+    auto& processBuffers = it->second;
+    if (outProcessBuffers) {
+        *outProcessBuffers = &processBuffers;
+    }
 
-    auto bufItr = processBuffers.find(id);
-    if (bufItr == processBuffers.end()) {
+    auto bufItr = processBuffers.buffers.find(id);
+    if (bufItr == processBuffers.buffers.end()) {
         ALOGV("failed to get buffer, invalid buffer id");
         return false;
     }
@@ -57,79 +75,141 @@ bool ClientCache::getBuffer(const client_cache_t& cacheId,
     return true;
 }
 
-bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& buffer) {
+void ClientCache::eraseLocked(ProcessBuffers& processBuffers, uint64_t id,
+                              std::vector<sp<ErasedRecipient>>* outPendingErase) {
+    auto bufItr = processBuffers.buffers.find(id);
+    if (bufItr == processBuffers.buffers.end()) {
+        return;
+    }
+
+    ClientCacheBuffer& buf = bufItr->second;
+    for (auto& recipient : buf.recipients) {
+        sp<ErasedRecipient> erasedRecipient = recipient.promote();
+        if (erasedRecipient) {
+            outPendingErase->push_back(erasedRecipient);
+        }
+    }
+
+    processBuffers.lru.erase(buf.lruPosition);
+    processBuffers.bytes -= buf.bytes;
+    processBuffers.buffers.erase(bufItr);
+}
+
+std::shared_ptr<renderengine::ExternalTexture> ClientCache::add(const client_cache_t& cacheId,
+                                                                const sp<GraphicBuffer>& buffer) {
     auto& [processToken, id] = cacheId;
     if (processToken == nullptr) {
         ALOGE("failed to cache buffer: invalid process token");
-        return false;
+        return nullptr;
     }
 
     if (!buffer) {
         ALOGE("failed to cache buffer: invalid buffer");
-        return false;
+        return nullptr;
     }
 
-    std::lock_guard lock(mMutex);
+    std::vector<std::pair<sp<ErasedRecipient>, client_cache_t>> pendingErase;
+    std::vector<uint64_t> evictedIds;
     sp<IBinder> token;
+    std::shared_ptr<renderengine::ExternalTexture> texture;
+    {
+        std::lock_guard lock(mMutex);
 
-    // If this is a new process token, set a death recipient. If the client process dies, we will
-    // get a callback through binderDied.
-    auto it = mBuffers.find(processToken);
-    if (it == mBuffers.end()) {
-        token = processToken.promote();
-        if (!token) {
-            ALOGE("failed to cache buffer: invalid token");
-            return false;
+        // If this is a new process token, set a death recipient. If the client process dies, we
+        // will get a callback through binderDied.
+        auto it = mBuffers.find(processToken);
+        if (it == mBuffers.end()) {
+            token = processToken.promote();
+            if (!token) {
+                ALOGE("failed to cache buffer: invalid token");
+                return nullptr;
+            }
+
+            status_t err = token->linkToDeath(mDeathRecipient);
+            if (err != NO_ERROR) {
+                ALOGE("failed to cache buffer: could not link to death");
+                return nullptr;
+            }
+            ProcessBuffers processBuffers;
+            processBuffers.token = token;
+            auto [itr, success] = mBuffers.emplace(processToken, std::move(processBuffers));
+            LOG_ALWAYS_FATAL_IF(!success, "failed to insert new process into client cache");
+            it = itr;
         }
 
-        status_t err = token->linkToDeath(mDeathRecipient);
-        if (err != NO_ERROR) {
-            ALOGE("failed to cache buffer: could not link to death");
-            return false;
+        auto& processBuffers = it->second;
+        token = processBuffers.token;
+
+        // A buffer cached again under the same id replaces the previous one, and keeps its
+        // recipients.
+        std::set<wp<ErasedRecipient>> recipients;
+        if (auto bufItr = processBuffers.buffers.find(id); bufItr != processBuffers.buffers.end()) {
+            recipients = std::move(bufItr->second.recipients);
+            processBuffers.lru.erase(bufItr->second.lruPosition);
+            processBuffers.bytes -= bufItr->second.bytes;
+            processBuffers.buffers.erase(bufItr);
         }
-        auto [itr, success] =
-                mBuffers.emplace(processToken,
-                                 std::make_pair(token,
-                                                std::unordered_map<uint64_t, ClientCacheBuffer>()));
-        LOG_ALWAYS_FATAL_IF(!success, "failed to insert new process into client cache");
-        it = itr;
-    }
 
-    auto& processBuffers = it->second.second;
+        // Make room by evicting the least recently used buffers, rather than failing to cache the
+        // one that is about to be used.
+        const size_t bytes = getBufferSize(buffer);
+        while (!processBuffers.lru.empty() &&
+               (processBuffers.buffers.size() >= BUFFER_CACHE_MAX_SIZE ||
+                processBuffers.bytes + bytes > BUFFER_CACHE_MAX_BYTES)) {
+            const uint64_t evictedId = processBuffers.lru.back();
+            std::vector<sp<ErasedRecipient>> recipients;
+            eraseLocked(processBuffers, evictedId, &recipients);
+            for (auto& recipient : recipients) {
+                pendingErase.emplace_back(recipient, client_cache_t{processToken, evictedId});
+            }
+            evictedIds.push_back(evictedId);
+            processBuffers.evictions++;
+        }
 
-    if (processBuffers.size() > BUFFER_CACHE_MAX_SIZE) {
-        ALOGE("failed to cache buffer: cache is full");
-        return false;
+        LOG_ALWAYS_FATAL_IF(mRenderEngine == nullptr,
+                            "Attempted to build the ClientCache before a RenderEngine instance was "
+                            "ready!");
+        processBuffers.lru.push_front(id);
+        ClientCacheBuffer& buf = processBuffers.buffers[id];
+        buf.buffer = std::make_shared<
+                renderengine::ExternalTexture>(buffer, *mRenderEngine,
+                                               renderengine::ExternalTexture::Usage::READABLE);
+        buf.recipients = std::move(recipients);
+        buf.lruPosition = processBuffers.lru.begin();
+        buf.bytes = bytes;
+        processBuffers.bytes += bytes;
+        processBuffers.sent++;
+        texture = buf.buffer;
     }
 
-    LOG_ALWAYS_FATAL_IF(mRenderEngine == nullptr,
-                        "Attempted to build the ClientCache before a RenderEngine instance was "
-                        "ready!");
-    processBuffers[id].buffer = std::make_shared<
-            renderengine::ExternalTexture>(buffer, *mRenderEngine,
-                                           renderengine::ExternalTexture::Usage::READABLE);
-    return true;
+    if (!evictedIds.empty()) {
+        ALOGW("evicted %zu buffers from the cache of %p", evictedIds.size(), token.get());
+        for (auto& [recipient, evictedCacheId] : pendingErase) {
+            recipient->bufferErased(evictedCacheId);
+        }
+        // Let the client know right away, so that it sends these buffers again instead of
+        // referring to them by id.
+        const sp<ITransactionCompletedListener> listener =
+                interface_cast<ITransactionCompletedListener>(token);
+        for (const uint64_t evictedId : evictedIds) {
+            listener->onBufferEvicted(evictedId);
+        }
+    }
+    return texture;
 }
 
 void ClientCache::erase(const client_cache_t& cacheId) {
-    auto& [processToken, id] = cacheId;
     std::vector<sp<ErasedRecipient>> pendingErase;
     {
         std::lock_guard lock(mMutex);
         ClientCacheBuffer* buf = nullptr;
-        if (!getBuffer(cacheId, &buf)) {
+        ProcessBuffers* processBuffers = nullptr;
+        if (!getBuffer(cacheId, &buf, &processBuffers)) {
             ALOGE("failed to erase buffer, could not retrieve buffer");
             return;
         }
 
-        for (auto& recipient : buf->recipients) {
-            sp<ErasedRecipient> erasedRecipient = recipient.promote();
-            if (erasedRecipient) {
-                pendingErase.push_back(erasedRecipient);
-            }
-        }
-
-        mBuffers[processToken].second.erase(id);
+        eraseLocked(*processBuffers, cacheId.id, &pendingErase);
     }
 
     for (auto& recipient : pendingErase) {
@@ -141,11 +221,17 @@ std::shared_ptr<renderengine::ExternalTexture> ClientCache::get(const client_cac
     std::lock_guard lock(mMutex);
 
     ClientCacheBuffer* buf = nullptr;
-    if (!getBuffer(cacheId, &buf)) {
+    ProcessBuffers* processBuffers = nullptr;
+    if (!getBuffer(cacheId, &buf, &processBuffers)) {
         ALOGE("failed to get buffer, could not retrieve buffer");
+        if (processBuffers) {
+            processBuffers->misses++;
+        }
         return nullptr;
     }
 
+    processBuffers->hits++;
+    processBuffers->lru.splice(processBuffers->lru.begin(), processBuffers->lru, buf->lruPosition);
     return buf->buffer;
 }
 
@@ -189,7 +275,7 @@ void ClientCache::removeProcess(const wp<IBinder>& processToken) {
             return;
         }
 
-        for (auto& [id, clientCacheBuffer] : itr->second.second) {
+        for (auto& [id, clientCacheBuffer] : itr->second.buffers) {
             client_cache_t cacheId = {processToken, id};
             for (auto& recipient : clientCacheBuffer.recipients) {
                 sp<ErasedRecipient> erasedRecipient = recipient.promote();
@@ -212,11 +298,21 @@ void ClientCache::CacheDeathRecipient::binderDied(const wp<IBinder>& who) {
 
 void ClientCache::dump(std::string& result) {
     std::lock_guard lock(mMutex);
-    for (auto i : mBuffers) {
-        const sp<IBinder>& cacheOwner = i.second.first;
-        StringAppendF(&result," Cache owner: %p\n", cacheOwner.get());
-        auto &buffers = i.second.second;
-        for (auto& [id, clientCacheBuffer] : buffers) {
+    for (auto& [processToken, processBuffers] : mBuffers) {
+        const sp<IBinder>& cacheOwner = processBuffers.token;
+        const uint64_t received = processBuffers.sent + processBuffers.hits;
+        StringAppendF(&result,
+                      " Cache owner: %p, buffers: %zu, size: %.2f MB, sent: %" PRIu64
+                      ", hits: %" PRIu64 " (%.1f%%), misses: %" PRIu64 ", evictions: %" PRIu64
+                      "\n",
+                      cacheOwner.get(), processBuffers.buffers.size(),
+                      static_cast<float>(processBuffers.bytes) / (1024.0f * 1024.0f),
+                      processBuffers.sent, processBuffers.hits,
+                      received ? 100.0f * processBuffers.hits / received : 0.0f,
+                      processBuffers.misses, processBuffers.evictions);
+        // Most recently used first.
+        for (const uint64_t id : processBuffers.lru) {
+            const ClientCacheBuffer& clientCacheBuffer = processBuffers.buffers.at(id);
             StringAppendF(&result, "\t ID: %d, Width/Height: %d,%d\n", (int)id,
                           (int)clientCacheBuffer.buffer->getBuffer()->getWidth(),
                           (int)clientCacheBuffer.buffer->getBuffer()->getHeight());
@@ -24,12 +24,16 @@
 #include <utils/RefBase.h>
 #include <utils/Singleton.h>
 
+#include <list>
 #include <map>
 #include <mutex>
 #include <set>
 #include <unordered_map>
 
-#define BUFFER_CACHE_MAX_SIZE 64
+// Kept above the limits of BufferCache in SurfaceComposerClient, so that buffers are only evicted
+// here for clients that don't manage their cache with it.
+#define BUFFER_CACHE_MAX_SIZE 320
+#define BUFFER_CACHE_MAX_BYTES (768 * 1024 * 1024)
 
 namespace android {
 
@@ -37,7 +41,9 @@ class ClientCache : public Singleton<ClientCache> {
 public:
     ClientCache();
 
-    bool add(const client_cache_t& cacheId, const sp<GraphicBuffer>& buffer);
+    // Returns the cached buffer, or nullptr if it could not be cached.
+    std::shared_ptr<renderengine::ExternalTexture> add(const client_cache_t& cacheId,
+                                                       const sp<GraphicBuffer>& buffer);
     void erase(const client_cache_t& cacheId);
 
     std::shared_ptr<renderengine::ExternalTexture> get(const client_cache_t& cacheId);
@@ -66,11 +72,25 @@ private:
     struct ClientCacheBuffer {
         std::shared_ptr<renderengine::ExternalTexture> buffer;
         std::set<wp<ErasedRecipient>> recipients;
+        std::list<uint64_t>::iterator lruPosition;
+        size_t bytes = 0;
     };
-    std::map<wp<IBinder> /*caching process*/,
-             std::pair<sp<IBinder> /*strong ref to caching process*/,
-                       std::unordered_map<uint64_t /*cache id*/, ClientCacheBuffer>>>
-            mBuffers GUARDED_BY(mMutex);
+
+    struct ProcessBuffers {
+        sp<IBinder> token; // strong ref to caching process
+        std::unordered_map<uint64_t /*cache id*/, ClientCacheBuffer> buffers;
+        // Most recently used first.
+        std::list<uint64_t /*cache id*/> lru;
+        size_t bytes = 0;
+
+        // Buffers sent along with their cache id, and buffers sent as only their cache id.
+        uint64_t sent = 0;
+        uint64_t hits = 0;
+        // Cache ids for which there was no buffer.
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+    std::map<wp<IBinder> /*caching process*/, ProcessBuffers> mBuffers GUARDED_BY(mMutex);
 
     class CacheDeathRecipient : public IBinder::DeathRecipient {
     public:
@@ -80,8 +100,12 @@ private:
     sp<CacheDeathRecipient> mDeathRecipient;
     renderengine::RenderEngine* mRenderEngine = nullptr;
 
-    bool getBuffer(const client_cache_t& cacheId, ClientCacheBuffer** outClientCacheBuffer)
-            REQUIRES(mMutex);
+    bool getBuffer(const client_cache_t& cacheId, ClientCacheBuffer** outClientCacheBuffer,
+                   ProcessBuffers** outProcessBuffers = nullptr) REQUIRES(mMutex);
+
+    // Erases the buffer from the process' cache, and appends the recipients to notify of it.
+    void eraseLocked(ProcessBuffers&, uint64_t id,
+                     std::vector<sp<ErasedRecipient>>* outPendingErase) REQUIRES(mMutex);
 };
 
 }; // namespace android
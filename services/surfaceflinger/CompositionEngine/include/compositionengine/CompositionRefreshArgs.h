@@ -17,6 +17,7 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
 #include <optional>
 #include <vector>
 
@@ -90,6 +91,11 @@ struct CompositionRefreshArgs {
 
     // The predicted next invalidation time
     std::optional<std::chrono::steady_clock::time_point> nextInvalidateTime;
+
+    // If set, calls work(i) for every i in [0, count) concurrently and returns once all of the
+    // calls have returned. Used to generate the client composition requests of the outputs at
+    // once when there are several of them.
+    std::function<void(size_t count, const std::function<void(size_t)>& work)> runConcurrently;
 };
 
 } // namespace android::compositionengine
@@ -168,6 +168,10 @@ public:
     // Enables (or disables) layer caching on this output
     virtual void setLayerCachingEnabled(bool) = 0;
 
+    // Enables (or disables) only redrawing the damaged part of a reused framebuffer during client
+    // composition on this output
+    virtual void setPartialClientCompositionEnabled(bool) = 0;
+
     // Sets the projection state to use
     virtual void setProjection(ui::Rotation orientation, const Rect& layerStackSpaceRect,
                                const Rect& orientedDisplaySpaceRect) = 0;
@@ -264,6 +268,14 @@ public:
     // Presents the output, finalizing all composition details
     virtual void present(const CompositionRefreshArgs&) = 0;
 
+    // The steps present() is made of, for presenting several outputs at once. beginPresent() runs
+    // up to choosing the composition strategy with the HWC, finishPresent() composites and posts
+    // the frame. In between, prepareClientCompositionRequests() may be called on another thread
+    // than the other outputs' to generate this output's client composition requests ahead of time.
+    virtual void beginPresent(const CompositionRefreshArgs&) = 0;
+    virtual void prepareClientCompositionRequests() = 0;
+    virtual void finishPresent(const CompositionRefreshArgs&) = 0;
+
     // Latches the front-end layer state for each output layer
     virtual void updateLayerStateFromFE(const CompositionRefreshArgs&) const = 0;
 
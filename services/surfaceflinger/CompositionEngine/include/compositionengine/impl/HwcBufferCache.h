@@ -17,6 +17,7 @@
 #pragma once
 
 #include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
@@ -45,7 +46,8 @@ namespace compositionengine::impl {
 // for the HAL to clone and retain the handle.
 //
 // To be able to find out whether a buffer is already in the HAL's cache, we
-// use HWComposerBufferCache to mirror the cache in SF.
+// use HWComposerBufferCache to mirror the cache in SF. Buffers are told apart
+// by their id, so a lookup never touches the buffer's reference counts.
 class HwcBufferCache {
 public:
     HwcBufferCache();
@@ -54,19 +56,37 @@ public:
     //
     // outBuffer is set to buffer when buffer is not in the HWC cache;
     // otherwise, outBuffer is set to nullptr.
+    //
+    // If slot is not a valid slot, e.g. for a buffer the layer has no slot
+    // for, the buffer keeps the slot it was given last time it was seen, or
+    // gets the least recently used one.
     void getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uint32_t* outSlot,
                       sp<GraphicBuffer>* outBuffer);
 
+    // How many buffers HWC already had, and how many had to be sent to it.
+    uint64_t getHitCount() const { return mHitCount; }
+    uint64_t getMissCount() const { return mMissCount; }
+
     // Special caching slot for the layer caching feature.
     static const constexpr size_t FLATTENER_CACHING_SLOT = BufferQueue::NUM_BUFFER_SLOTS;
 
 private:
-    // an array where the index corresponds to a slot and the value corresponds to a (counter,
-    // buffer) pair. "counter" is a unique value that indicates the last time this slot was updated
-    // or used and allows us to keep track of the least-recently used buffer.
     static const constexpr size_t kMaxLayerBufferCount = BufferQueue::NUM_BUFFER_SLOTS + 1;
-    wp<GraphicBuffer> mBuffers[kMaxLayerBufferCount];
-    uint32_t mNextSlot = 0;
+
+    struct Slot {
+        bool used = false;
+        uint64_t bufferId = 0;
+        // Last time this slot was updated or used, to find the least recently used slot.
+        uint64_t counter = 0;
+    };
+
+    uint32_t getLeastRecentlyUsedSlot(uint32_t numSlots) const;
+
+    Slot mSlots[kMaxLayerBufferCount];
+    std::unordered_map<uint64_t /*buffer id*/, uint32_t /*slot*/> mSlotsByBufferId;
+    uint64_t mCounter = 0;
+    uint64_t mHitCount = 0;
+    uint64_t mMissCount = 0;
     bool mReduceSlotsForWideVideo = false;
 };
 
@@ -24,6 +24,8 @@
 #include <renderengine/DisplaySettings.h>
 #include <renderengine/LayerSettings.h>
 #include <memory>
+#include <optional>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -41,6 +43,7 @@ public:
     std::optional<DisplayId> getDisplayId() const override;
     void setCompositionEnabled(bool) override;
     void setLayerCachingEnabled(bool) override;
+    void setPartialClientCompositionEnabled(bool) override;
     void setProjection(ui::Rotation orientation, const Rect& layerStackSpaceRect,
                        const Rect& orientedDisplaySpaceRect) override;
     void setDisplaySize(const ui::Size&) override;
@@ -73,6 +76,9 @@ public:
 
     void prepare(const CompositionRefreshArgs&, LayerFESet&) override;
     void present(const CompositionRefreshArgs&) override;
+    void beginPresent(const CompositionRefreshArgs&) override;
+    void prepareClientCompositionRequests() override;
+    void finishPresent(const CompositionRefreshArgs&) override;
 
     void rebuildLayerStacks(const CompositionRefreshArgs&, LayerFESet&) override;
     void collectVisibleLayers(const CompositionRefreshArgs&,
@@ -132,6 +138,34 @@ private:
     ui::Dataspace getBestDataspace(ui::Dataspace*, bool*) const;
     compositionengine::Output::ColorProfile pickColorProfile(
             const compositionengine::CompositionRefreshArgs&) const;
+    void accumulateFramebufferDamage(const Region& debugRegion,
+                                     const compositionengine::CompositionRefreshArgs&);
+    Rect getPartialUpdateArea(const renderengine::DisplaySettings&, uint64_t framebufferId);
+    bool supportsProtectedClientComposition() const;
+
+    // Client composition requests generated by prepareClientCompositionRequests(), for the next
+    // composeSurfaces() to use.
+    struct PreparedClientComposition {
+        bool supportsProtectedContent;
+        Region clearRegion;
+        std::vector<LayerFE::LayerSettings> layers;
+    };
+
+    // What, besides their dirty regions, the contents of the layers drawn into the framebuffer
+    // depend on.
+    struct ClientCompositionLayerInfo {
+        const LayerFE* layerFE;
+        bool requiresClientComposition;
+        bool clearClientTarget;
+        const GraphicBuffer* overrideBuffer;
+
+        bool operator==(const ClientCompositionLayerInfo& other) const {
+            return layerFE == other.layerFE &&
+                    requiresClientComposition == other.requiresClientComposition &&
+                    clearClientTarget == other.clearClientTarget &&
+                    overrideBuffer == other.overrideBuffer;
+        }
+    };
 
     std::string mName;
 
@@ -142,6 +176,16 @@ private:
     OutputLayer* mLayerRequestingBackgroundBlur = nullptr;
     std::unique_ptr<ClientCompositionRequestCache> mClientCompositionRequestCache;
     std::unique_ptr<planner::Planner> mPlanner;
+    std::optional<PreparedClientComposition> mPreparedClientComposition;
+
+    bool mPartialClientCompositionEnabled = false;
+    // Damage, in layer stack space, accumulated since each framebuffer was last drawn into. A
+    // framebuffer that isn't in here is redrawn in full.
+    std::unordered_map<uint64_t, Region> mFramebufferDamage;
+    // What the framebuffers were last drawn with. If any of it changes, they are all redrawn in
+    // full.
+    renderengine::DisplaySettings mLastClientCompositionDisplay;
+    std::vector<ClientCompositionLayerInfo> mLastClientCompositionLayers;
 };
 
 // This template factory function standardizes the implementation details of the
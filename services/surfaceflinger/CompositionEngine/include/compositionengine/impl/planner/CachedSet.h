@@ -91,10 +91,27 @@ public:
     // Decomposes this CachedSet into a vector of its layers as individual CachedSets
     std::vector<CachedSet> decompose() const;
 
+    // Like decompose(), but keeps any previously rendered CachedSet that was appended into this one
+    // whole if none of its layers has a buffer update, so its buffer can be used again as is.
+    std::vector<CachedSet> decomposeKeepingValidChildren() const;
+
     void updateAge(std::chrono::steady_clock::time_point now);
 
     void setLastUpdate(std::chrono::steady_clock::time_point now) { mLastUpdate = now; }
     void append(const CachedSet& other) {
+        if (isReusableChild()) {
+            std::vector<CachedSet> children;
+            children.push_back(*this);
+            mChildren = std::move(children);
+        }
+        if (other.isReusableChild()) {
+            mChildren.push_back(other);
+        } else {
+            for (const CachedSet& child : other.mChildren) {
+                mChildren.push_back(child);
+            }
+        }
+
         mTexture.reset();
         mOutputDataspace = ui::Dataspace::UNKNOWN;
         mDrawFence = nullptr;
@@ -150,10 +167,21 @@ public:
 private:
     CachedSet() = default;
 
+    // Whether this CachedSet is worth keeping around when it is appended to another one: it has a
+    // rendered buffer of several layers that doesn't depend on anything drawn around it.
+    bool isReusableChild() const {
+        return mTexture && mLayers.size() > 1 && !mHolePunchLayer && !mBlurLayer;
+    }
+
     const NonBufferHash mFingerprint;
     std::chrono::steady_clock::time_point mLastUpdate = std::chrono::steady_clock::now();
     std::vector<Layer> mLayers;
 
+    // Rendered CachedSets that were appended into this one, in the order of their layers. They
+    // keep their buffers so that a buffer update in one part of this CachedSet doesn't require
+    // re-rendering the rest of it.
+    std::vector<CachedSet> mChildren;
+
     // Unowned.
     const LayerState* mHolePunchLayer = nullptr;
     const LayerState* mBlurLayer = nullptr;
@@ -73,6 +73,11 @@ public:
         mTexturePool.setDisplaySize(size);
     }
 
+    // Marks the current layer stack as one the Predictor is confident it has seen composed the
+    // same way many times before. Its inactive layers are then flattened sooner, so that the
+    // cached set is rendered ahead of the frames that would otherwise compose them on the GPU.
+    void setStackIsPredictable(bool predictable) { mStackIsPredictable = predictable; }
+
     NonBufferHash flattenLayers(const std::vector<const LayerState*>& layers, NonBufferHash,
                                 std::chrono::steady_clock::time_point now);
 
@@ -201,8 +206,11 @@ private:
     size_t mCachedSetCreationCost = 0;
     std::unordered_map<size_t, size_t> mInvalidatedCachedSetAges;
     std::chrono::nanoseconds mActiveLayerTimeout = kActiveLayerTimeout;
+    bool mStackIsPredictable = false;
 
     static constexpr auto kActiveLayerTimeout = std::chrono::nanoseconds(150ms);
+    // Used instead of mActiveLayerTimeout, if shorter, while the layer stack is predictable.
+    static constexpr auto kPredictableActiveLayerTimeout = std::chrono::nanoseconds(50ms);
 };
 
 } // namespace compositionengine::impl::planner
@@ -216,7 +216,8 @@ public:
 
     // Computes a hash for this LayerState.
     // The hash is only computed from NonUniqueFields, and excludes GraphicBuffers since they are
-    // not guaranteed to live longer than the LayerState object.
+    // not guaranteed to live longer than the LayerState object. It is cached until update() finds
+    // a field other than the buffer changed.
     size_t getHash() const;
 
     // Returns the bit-set of differing fields between this LayerState and another LayerState.
@@ -256,6 +257,8 @@ public:
 private:
     compositionengine::OutputLayer* mOutputLayer = nullptr;
 
+    mutable std::optional<size_t> mHash;
+
     OutputLayerState<LayerId, LayerStateField::Id> mId{
             [](const compositionengine::OutputLayer* layer) {
                 return layer->getLayerFE().getSequence();
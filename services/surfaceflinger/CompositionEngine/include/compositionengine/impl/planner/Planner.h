@@ -72,6 +72,11 @@ private:
     std::unordered_map<LayerId, LayerState> mPreviousLayers;
 
     std::vector<const LayerState*> mCurrentLayers;
+    std::vector<LayerId> mCurrentLayerIds;
+
+    // The NonBufferHash of mCurrentLayers, kept while no layer changes other than its buffer and
+    // the layer stack stays the same.
+    std::optional<NonBufferHash> mNonBufferHash;
 
     Predictor mPredictor;
     Flattener mFlattener;
@@ -247,6 +247,10 @@ public:
     void recordResult(std::optional<PredictedPlan> predictedPlan, NonBufferHash flattenedHash,
                       const std::vector<const LayerState*>&, bool hasSkippedLayers, Plan result);
 
+    // Whether the predicted plan is an exact match that has been right often enough to expect the
+    // same layer stack to keep being composed the same way.
+    bool isPredictionConfident(const PredictedPlan&) const;
+
     void dump(std::string&) const;
 
     void compareLayerStacks(NonBufferHash leftHash, NonBufferHash rightHash, std::string&) const;
@@ -278,6 +282,10 @@ private:
     };
 
     static constexpr const size_t MAX_CANDIDATES = 4;
+    // Exact hits needed before a prediction is considered confident, and the largest share of its
+    // exact predictions that may have missed.
+    static constexpr const size_t kMinConfidentHitCount = 10;
+    static constexpr const size_t kMaxConfidentMissPercent = 10;
     std::deque<PromotionCandidate> mCandidates;
     decltype(mCandidates)::const_iterator getCandidateEntryByHash(NonBufferHash hash) const {
         const auto candidateMatches = [&](const PromotionCandidate& candidate) {
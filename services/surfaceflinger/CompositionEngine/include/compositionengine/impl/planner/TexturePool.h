@@ -23,6 +23,8 @@
 
 #include <renderengine/ExternalTexture.h>
 #include <chrono>
+#include <memory>
+#include <vector>
 #include "android-base/macros.h"
 
 namespace android::compositionengine::impl::planner {
@@ -33,8 +35,45 @@ namespace android::compositionengine::impl::planner {
 // unbounded - there are a minimum number of textures preallocated. Under heavy system load, new
 // textures may be allocated, but only a maximum number of retained once those textures are no
 // longer necessary.
+//
+// The textures of all pools can additionally be limited in bytes by a shared Budget.
 class TexturePool {
 public:
+    // Memory accounting shared by the texture pools of all outputs. It limits the bytes allocated
+    // by all pools together and by each one of them. When an allocation would go over either
+    // limit, the textures that have been idle the longest are freed first, from any pool for the
+    // shared limit and from the allocating pool for its own. A limit of 0 is unlimited.
+    //
+    // Like the pools, a Budget must only be used from the thread that composites the outputs.
+    class Budget {
+    public:
+        Budget(size_t budgetBytes, size_t poolQuotaBytes)
+              : mBudgetBytes(budgetBytes), mPoolQuotaBytes(poolQuotaBytes) {}
+
+        // The budget shared by all pools that aren't given one, set up from
+        // debug.sf.planner_texture_budget_kb and debug.sf.planner_texture_quota_kb.
+        static const std::shared_ptr<Budget>& getDefault();
+
+        size_t getAllocatedBytes() const { return mAllocatedBytes; }
+        size_t getBudgetBytes() const { return mBudgetBytes; }
+        size_t getPoolQuotaBytes() const { return mPoolQuotaBytes; }
+
+    private:
+        friend class TexturePool;
+
+        // Accounts for pool allocating bytes, evicting idle textures if needed. Returns false if
+        // not enough could be freed.
+        bool reserve(TexturePool& pool, size_t bytes);
+        void release(TexturePool& pool, size_t bytes);
+
+        const size_t mBudgetBytes;
+        const size_t mPoolQuotaBytes;
+        size_t mAllocatedBytes = 0;
+        // Orders the idle textures of all pools by when they were returned.
+        uint64_t mNextReturnSequence = 0;
+        std::vector<TexturePool*> mPools;
+    };
+
     // RAII class helping with managing textures from the texture pool
     // Textures once they're no longer used should be returned to the pool instead of outright
     // deleted.
@@ -63,9 +102,10 @@ public:
         sp<Fence> mFence;
     };
 
-    TexturePool(renderengine::RenderEngine& renderEngine) : mRenderEngine(renderEngine) {}
+    TexturePool(renderengine::RenderEngine& renderEngine,
+                std::shared_ptr<Budget> budget = Budget::getDefault());
 
-    virtual ~TexturePool() = default;
+    virtual ~TexturePool();
 
     // Sets the display size for the texture pool.
     // This will trigger a reallocation for all remaining textures in the pool.
@@ -76,8 +116,11 @@ public:
     // If the pool is currently starved of textures, then a new texture is generated.
     // When the AutoTexture object is destroyed, the scratch texture is automatically returned
     // to the pool.
+    // Returns nullptr if the budget doesn't leave room for a new texture.
     std::shared_ptr<AutoTexture> borrowTexture();
 
+    void dump(std::string& result) const;
+
 protected:
     // Proteted visibility so that they can be used for testing
     const static constexpr size_t kMinPoolSize = 3;
@@ -86,17 +129,27 @@ protected:
     struct Entry {
         std::shared_ptr<renderengine::ExternalTexture> texture;
         sp<Fence> fence;
+        uint64_t returnSequence = 0;
     };
 
+    // Ordered from the longest idle texture to the most recently returned one.
     std::deque<Entry> mPool;
 
 private:
+    // Returns nullptr if the budget doesn't allow it.
     std::shared_ptr<renderengine::ExternalTexture> genTexture();
     // Returns a previously borrowed texture to the pool.
     void returnTexture(std::shared_ptr<renderengine::ExternalTexture>&& texture,
                        const sp<Fence>& fence);
+    // Frees the longest idle texture. Returns false if there is none.
+    bool evictOldestTexture();
+    void clearPool();
     renderengine::RenderEngine& mRenderEngine;
+    const std::shared_ptr<Budget> mBudget;
     ui::Size mSize;
+    // Bytes of the textures this pool allocated that still exist, borrowed or not.
+    size_t mAllocatedBytes = 0;
+    size_t mDeniedAllocationCount = 0;
 };
 
 } // namespace android::compositionengine::impl::planner
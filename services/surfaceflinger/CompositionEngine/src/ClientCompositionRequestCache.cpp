@@ -46,7 +46,7 @@ inline bool equalIgnoringBuffer(const renderengine::Buffer& lhs, const rendereng
             lhs.textureTransform == rhs.textureTransform &&
             lhs.usePremultipliedAlpha == rhs.usePremultipliedAlpha &&
             lhs.isOpaque == rhs.isOpaque && lhs.isY410BT2020 == rhs.isY410BT2020 &&
-            lhs.maxLuminanceNits == rhs.maxLuminanceNits;
+            lhs.maxLuminanceNits == rhs.maxLuminanceNits && lhs.frameNumber == rhs.frameNumber;
 }
 
 inline bool equalIgnoringBuffer(const renderengine::LayerSettings& lhs,
@@ -107,8 +107,25 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
 
     updateLayerStateFromFE(args);
 
+    if (!args.runConcurrently || args.outputs.size() < 2) {
+        for (const auto& output : args.outputs) {
+            output->present(args);
+        }
+        return;
+    }
+
+    // Talking to the HWC and drawing with RenderEngine stay on this thread, in output order, as
+    // neither is safe to do concurrently. What can run concurrently is generating the client
+    // composition requests, which is most of the CPU time of client composition.
+    for (const auto& output : args.outputs) {
+        output->beginPresent(args);
+    }
+
+    args.runConcurrently(args.outputs.size(),
+                         [&](size_t i) { args.outputs[i]->prepareClientCompositionRequests(); });
+
     for (const auto& output : args.outputs) {
-        output->present(args);
+        output->finishPresent(args);
     }
 }
 
@@ -22,6 +22,7 @@
 
 #include <gui/BufferQueue.h>
 #include <ui/GraphicBuffer.h>
+#include <algorithm>
 #include <cstdlib>
 #include <cutils/properties.h>
 #include <QtiGrallocDefs.h>
@@ -36,7 +37,6 @@ constexpr int MAX_NUM_SLOTS_FOR_WIDE_VIDEOS = 4;
 namespace android::compositionengine::impl {
 
 HwcBufferCache::HwcBufferCache() {
-    std::fill(std::begin(mBuffers), std::end(mBuffers), wp<GraphicBuffer>(nullptr));
     char value[PROPERTY_VALUE_MAX];
     property_get("vendor.display.reduce_slots_for_wide_video", value, "1");
     mReduceSlotsForWideVideo = atoi(value);
@@ -79,10 +79,22 @@ static bool formatIsYuv(const PixelFormat format) {
     }
 }
 
+uint32_t HwcBufferCache::getLeastRecentlyUsedSlot(uint32_t numSlots) const {
+    uint32_t lruSlot = 0;
+    for (uint32_t i = 0; i < numSlots; i++) {
+        if (!mSlots[i].used) {
+            return i;
+        }
+        if (mSlots[i].counter < mSlots[lruSlot].counter) {
+            lruSlot = i;
+        }
+    }
+    return lruSlot;
+}
+
 void HwcBufferCache::getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uint32_t* outSlot,
                                   sp<GraphicBuffer>* outBuffer) {
     // default is 0
-    wp<GraphicBuffer> weakCopy(buffer);
     uint32_t width = 0;
     uint32_t height = 0;
     PixelFormat format = PIXEL_FORMAT_NONE;
@@ -91,36 +103,65 @@ void HwcBufferCache::getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uin
         height = buffer->getHeight();
         format = buffer->getPixelFormat();
     }
-    bool widevideo = false;
     uint32_t numSlots = kMaxLayerBufferCount;
 
     // Workaround to reduce slots for 8k buffers
     if ((width * height > MAX_VIDEO_WIDTH * MAX_VIDEO_HEIGHT) && mReduceSlotsForWideVideo &&
         formatIsYuv(format)) {
         numSlots = MAX_NUM_SLOTS_FOR_WIDE_VIDEOS;
-        widevideo = true;
     }
+
+    if (!buffer) {
+        *outSlot = (slot == BufferQueue::INVALID_BUFFER_SLOT || slot < 0 ||
+                    static_cast<uint32_t>(slot) >= numSlots)
+                ? 0
+                : static_cast<uint32_t>(slot);
+        *outBuffer = nullptr;
+        auto& currentSlot = mSlots[*outSlot];
+        if (currentSlot.used) {
+            mSlotsByBufferId.erase(currentSlot.bufferId);
+            currentSlot = Slot{};
+        }
+        return;
+    }
+
+    const uint64_t bufferId = buffer->getId();
     if (slot == BufferQueue::INVALID_BUFFER_SLOT || slot < 0 ||
         static_cast<uint32_t>(slot) >= numSlots) {
-        *outSlot = 0;
-        if (widevideo && static_cast<uint32_t>(slot) >= numSlots) {
-            *outSlot = mNextSlot % numSlots;
-            mNextSlot = *outSlot + 1;
-        }
+        // Leave the flattener's slot to it.
+        const uint32_t numLruSlots = std::min(numSlots, uint32_t{FLATTENER_CACHING_SLOT});
+        const auto it = mSlotsByBufferId.find(bufferId);
+        *outSlot = it != mSlotsByBufferId.end() && it->second < numLruSlots
+                ? it->second
+                : getLeastRecentlyUsedSlot(numLruSlots);
     } else {
         *outSlot = static_cast<uint32_t>(slot);
     }
 
-    auto& currentBuffer = mBuffers[*outSlot];
-    if (currentBuffer == weakCopy) {
+    auto& currentSlot = mSlots[*outSlot];
+    currentSlot.counter = ++mCounter;
+    if (currentSlot.used && currentSlot.bufferId == bufferId) {
         // already cached in HWC, skip sending the buffer
         *outBuffer = nullptr;
-    } else {
-        *outBuffer = buffer;
+        mHitCount++;
+        return;
+    }
+
+    *outBuffer = buffer;
+    mMissCount++;
 
-        // update cache
-        currentBuffer = buffer;
+    // update cache
+    if (currentSlot.used) {
+        mSlotsByBufferId.erase(currentSlot.bufferId);
+    }
+    if (const auto it = mSlotsByBufferId.find(bufferId); it != mSlotsByBufferId.end()) {
+        // The buffer moved to another slot, which HWC will now hold it in.
+        mSlots[it->second] = Slot{};
+        mSlotsByBufferId.erase(it);
     }
+    currentSlot.used = true;
+    currentSlot.bufferId = bufferId;
+    mSlotsByBufferId[bufferId] = *outSlot;
 }
 
 } // namespace android::compositionengine::impl
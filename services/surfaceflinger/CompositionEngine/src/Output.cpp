@@ -89,6 +89,10 @@ ScaleVector getScale(const Rect& from, const Rect& to) {
             .y = static_cast<float>(to.height()) / from.height()};
 }
 
+// A render surface normally cycles through a handful of buffers. Anything beyond this means they
+// are being reallocated, and the damage of the old ones is no longer worth keeping.
+constexpr size_t kMaxTrackedFramebuffers = 8;
+
 } // namespace
 #ifdef QTI_UNIFIED_DRAW
 using vendor::qti::hardware::display::composer::V3_1::IQtiComposerClient;
@@ -150,6 +154,11 @@ void Output::setLayerCachingEnabled(bool enabled) {
     }
 }
 
+void Output::setPartialClientCompositionEnabled(bool enabled) {
+    mPartialClientCompositionEnabled = enabled;
+    mFramebufferDamage.clear();
+}
+
 void Output::setProjection(ui::Rotation orientation, const Rect& layerStackSpaceRect,
                            const Rect& orientedDisplaySpaceRect) {
     auto& outputState = editState();
@@ -428,6 +437,11 @@ void Output::present(const compositionengine::CompositionRefreshArgs& refreshArg
     ATRACE_CALL();
     ALOGV(__FUNCTION__);
 
+    beginPresent(refreshArgs);
+    finishPresent(refreshArgs);
+}
+
+void Output::beginPresent(const compositionengine::CompositionRefreshArgs& refreshArgs) {
     updateColorProfile(refreshArgs);
     updateCompositionState(refreshArgs);
     planComposition();
@@ -436,6 +450,28 @@ void Output::present(const compositionengine::CompositionRefreshArgs& refreshArg
     beginFrame();
     prepareFrame();
     devOptRepaintFlash(refreshArgs);
+}
+
+void Output::prepareClientCompositionRequests() {
+    ATRACE_CALL();
+
+    const auto& outputState = getState();
+    if (!outputState.isEnabled || !outputState.usesClientComposition) {
+        return;
+    }
+
+    PreparedClientComposition prepared;
+    prepared.supportsProtectedContent = supportsProtectedClientComposition();
+    prepared.clearRegion = Region::INVALID_REGION;
+    prepared.layers = generateClientCompositionRequests(prepared.supportsProtectedContent,
+                                                        prepared.clearRegion,
+                                                        mDisplayColorProfile->hasWideColorGamut()
+                                                                ? outputState.dataspace
+                                                                : ui::Dataspace::UNKNOWN);
+    mPreparedClientComposition = std::move(prepared);
+}
+
+void Output::finishPresent(const compositionengine::CompositionRefreshArgs& refreshArgs) {
     finishFrame(refreshArgs);
     postFramebuffer();
     renderCachedSets(refreshArgs);
@@ -1052,25 +1088,16 @@ std::optional<base::unique_fd> Output::composeSurfaces(
     const TracedOrdinal<bool> hasClientComposition = {"hasClientComposition",
                                                       outputState.usesClientComposition};
 
-    bool hasSecureCamera = false;
-    bool hasSecureDisplay = false;
-    bool needsProtected = false;
-    for (auto* layer : getOutputLayersOrderedByZ()) {
-        if (layer->getLayerFE().getCompositionState()->isSecureCamera) {
-            hasSecureCamera = true;
-        }
-        if (layer->getLayerFE().getCompositionState()->isSecureDisplay) {
-            hasSecureDisplay = true;
-        }
-        if (layer->getLayerFE().getCompositionState()->hasProtectedContent) {
-            needsProtected = true;
-        }
+    if (mPartialClientCompositionEnabled) {
+        accumulateFramebufferDamage(debugRegion, refreshArgs);
     }
 
+    // Only this frame's composition may use the prepared requests.
+    std::optional<PreparedClientComposition> prepared;
+    std::swap(prepared, mPreparedClientComposition);
+
     auto& renderEngine = getCompositionEngine().getRenderEngine();
-    const bool supportsProtectedContent = renderEngine.supportsProtectedContent() &&
-                                          !hasSecureCamera && !hasSecureDisplay &&
-                                          outputState.isSecure && needsProtected;
+    const bool supportsProtectedContent = supportsProtectedClientComposition();
 
     // If we the display is secure, protected content support is enabled, and at
     // least one layer has protected content, we need to use a secure back
@@ -1133,10 +1160,16 @@ std::optional<base::unique_fd> Output::composeSurfaces(
     clientCompositionDisplay.clearRegion = Region::INVALID_REGION;
 
     // Generate the client composition requests for the layers on this output.
-    std::vector<LayerFE::LayerSettings> clientCompositionLayers =
-            generateClientCompositionRequests(supportsProtectedContent,
-                                              clientCompositionDisplay.clearRegion,
-                                              clientCompositionDisplay.outputDataspace);
+    std::vector<LayerFE::LayerSettings> clientCompositionLayers;
+    if (prepared && prepared->supportsProtectedContent == supportsProtectedContent) {
+        clientCompositionDisplay.clearRegion = std::move(prepared->clearRegion);
+        clientCompositionLayers = std::move(prepared->layers);
+    } else {
+        clientCompositionLayers =
+                generateClientCompositionRequests(supportsProtectedContent,
+                                                  clientCompositionDisplay.clearRegion,
+                                                  clientCompositionDisplay.outputDataspace);
+    }
     appendRegionFlashRequests(debugRegion, clientCompositionLayers);
 
     // Check if the client composition requests were rendered into the provided graphic buffer. If
@@ -1147,6 +1180,8 @@ std::optional<base::unique_fd> Output::composeSurfaces(
                                                    clientCompositionLayers)) {
             outputCompositionState.reusedClientComposition = true;
             setExpensiveRenderingExpected(false);
+            // The framebuffer wasn't drawn with what the others were drawn with last.
+            mFramebufferDamage.erase(tex->getBuffer()->getId());
             return readyFence;
         }
         mClientCompositionRequestCache->add(tex->getBuffer()->getId(), clientCompositionDisplay,
@@ -1181,10 +1216,27 @@ std::optional<base::unique_fd> Output::composeSurfaces(
     // probably to encapsulate the output buffer into a structure that dispatches resource cleanup
     // over to RenderEngine, in which case this flag can be removed from the drawLayers interface.
     const bool useFramebufferCache = outputState.layerStackInternal;
+    if (mPartialClientCompositionEnabled) {
+        clientCompositionDisplay.partialUpdateArea =
+                getPartialUpdateArea(clientCompositionDisplay, tex->getBuffer()->getId());
+    }
     status_t status =
             renderEngine.drawLayers(clientCompositionDisplay, clientCompositionLayerPointers, tex,
                                     useFramebufferCache, std::move(fd), &readyFence);
 
+    if (mPartialClientCompositionEnabled) {
+        const uint64_t framebufferId = tex->getBuffer()->getId();
+        if (status != NO_ERROR) {
+            mFramebufferDamage.erase(framebufferId);
+        } else {
+            if (mFramebufferDamage.size() >= kMaxTrackedFramebuffers &&
+                mFramebufferDamage.count(framebufferId) == 0) {
+                mFramebufferDamage.clear();
+            }
+            mFramebufferDamage[framebufferId].clear();
+        }
+    }
+
     if (status != NO_ERROR && mClientCompositionRequestCache) {
         // If rendering was not successful, remove the request from the cache.
         mClientCompositionRequestCache->remove(tex->getBuffer()->getId());
@@ -1202,6 +1254,93 @@ std::optional<base::unique_fd> Output::composeSurfaces(
     return readyFence;
 }
 
+void Output::accumulateFramebufferDamage(const Region& debugRegion,
+                                         const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    // Flashed regions have to be drawn over again once the flash is done, without any damage to
+    // tell.
+    if (!debugRegion.isEmpty()) {
+        mFramebufferDamage.clear();
+        return;
+    }
+
+    // This may be called more than once per frame, which is fine as the dirty region is only
+    // cleared once the frame is posted.
+    const Region dirtyRegion = getDirtyRegion(refreshArgs.repaintEverything);
+    for (auto& [framebufferId, damage] : mFramebufferDamage) {
+        damage.orSelf(dirtyRegion);
+    }
+}
+
+Rect Output::getPartialUpdateArea(const renderengine::DisplaySettings& clientCompositionDisplay,
+                                  uint64_t framebufferId) {
+    ATRACE_CALL();
+    const auto& outputState = getState();
+
+    // Which layers are drawn by the client, and where device composited layers leave holes in
+    // the framebuffer, isn't part of the dirty region.
+    bool hasBlur = mLayerRequestingBackgroundBlur != nullptr;
+    std::vector<ClientCompositionLayerInfo> layers;
+    for (auto* layer : getOutputLayersOrderedByZ()) {
+        const auto& layerState = layer->getState();
+        const auto* layerFEState = layer->getLayerFE().getCompositionState();
+        hasBlur |= !layerFEState->blurRegions.empty();
+        layers.push_back({.layerFE = &layer->getLayerFE(),
+                          .requiresClientComposition = layer->requiresClientComposition(),
+                          .clearClientTarget = layerState.clearClientTarget,
+                          .overrideBuffer = layerState.overrideInfo.buffer
+                                  ? layerState.overrideInfo.buffer->getBuffer().get()
+                                  : nullptr});
+    }
+
+    if (!(clientCompositionDisplay == mLastClientCompositionDisplay) ||
+        layers != mLastClientCompositionLayers) {
+        mFramebufferDamage.clear();
+        mLastClientCompositionDisplay = clientCompositionDisplay;
+        mLastClientCompositionLayers = std::move(layers);
+    }
+
+    // Blurs sample outside of the damage, so they need the whole framebuffer redrawn.
+    const auto damage = mFramebufferDamage.find(framebufferId);
+    if (hasBlur || damage == mFramebufferDamage.end()) {
+        return Rect::INVALID_RECT;
+    }
+
+    // Grow the area by a pixel, to cover whatever filtering may have touched after scaling.
+    Rect partialUpdateArea = outputState.layerStackSpace.getTransform(outputState.framebufferSpace)
+                                     .transform(damage->second)
+                                     .getBounds();
+    if (partialUpdateArea.isEmpty()) {
+        return Rect::EMPTY_RECT;
+    }
+    partialUpdateArea.left -= 1;
+    partialUpdateArea.top -= 1;
+    partialUpdateArea.right += 1;
+    partialUpdateArea.bottom += 1;
+    partialUpdateArea.intersect(outputState.framebufferSpace.bounds, &partialUpdateArea);
+    ATRACE_INT("PartialUpdateArea", partialUpdateArea.width() * partialUpdateArea.height());
+    return partialUpdateArea;
+}
+
+bool Output::supportsProtectedClientComposition() const {
+    bool hasSecureCamera = false;
+    bool hasSecureDisplay = false;
+    bool needsProtected = false;
+    for (auto* layer : getOutputLayersOrderedByZ()) {
+        if (layer->getLayerFE().getCompositionState()->isSecureCamera) {
+            hasSecureCamera = true;
+        }
+        if (layer->getLayerFE().getCompositionState()->isSecureDisplay) {
+            hasSecureDisplay = true;
+        }
+        if (layer->getLayerFE().getCompositionState()->hasProtectedContent) {
+            needsProtected = true;
+        }
+    }
+
+    return getCompositionEngine().getRenderEngine().supportsProtectedContent() &&
+            !hasSecureCamera && !hasSecureDisplay && getState().isSecure && needsProtected;
+}
+
 std::vector<LayerFE::LayerSettings> Output::generateClientCompositionRequests(
         bool supportsProtectedContent, Region& clearRegion, ui::Dataspace outputDataspace) {
     std::vector<LayerFE::LayerSettings> clientCompositionLayers;
@@ -40,6 +40,8 @@ void dumpHwc(const OutputLayerCompositionState::Hwc& hwc, std::string& out) {
     }
 
     dumpVal(out, "composition", toString(hwc.hwcCompositionType), hwc.hwcCompositionType);
+    dumpVal(out, "buffer cache hits", std::to_string(hwc.hwcBufferCache.getHitCount()));
+    dumpVal(out, "misses", std::to_string(hwc.hwcBufferCache.getMissCount()));
 }
 
 } // namespace
@@ -146,6 +146,32 @@ std::vector<CachedSet> CachedSet::decompose() const {
     return layers;
 }
 
+std::vector<CachedSet> CachedSet::decomposeKeepingValidChildren() const {
+    std::vector<CachedSet> layers;
+
+    auto child = mChildren.cbegin();
+    for (auto layer = mLayers.cbegin(); layer != mLayers.cend();) {
+        if (child == mChildren.cend() ||
+            child->getFirstLayer().getState() != layer->getState()) {
+            layers.emplace_back(*layer);
+            ++layer;
+            continue;
+        }
+
+        if (child->hasBufferUpdate()) {
+            for (CachedSet& childLayer : child->decomposeKeepingValidChildren()) {
+                layers.push_back(std::move(childLayer));
+            }
+        } else {
+            layers.push_back(*child);
+        }
+        layer += static_cast<std::vector<Layer>::difference_type>(child->getLayerCount());
+        ++child;
+    }
+
+    return layers;
+}
+
 void CachedSet::updateAge(std::chrono::steady_clock::time_point now) {
     LOG_ALWAYS_FATAL_IF(mLayers.size() > 1, "[%s] This should only be called on single-layer sets",
                         __func__);
@@ -263,6 +289,10 @@ void CachedSet::render(renderengine::RenderEngine& renderEngine, TexturePool& te
     }
 
     auto texture = texturePool.borrowTexture();
+    if (!texture) {
+        // Out of texture memory, the layers stay unflattened.
+        return;
+    }
     LOG_ALWAYS_FATAL_IF(texture->get()->getBuffer()->initCheck() != OK);
 
     base::unique_fd bufferFence;
@@ -408,6 +438,9 @@ void CachedSet::dump(std::string& result) const {
             base::StringAppendF(&result, "\n      Protected [%s]",
                                 layer.getState()->isProtected() ? "true" : "false");
         }
+        if (!mChildren.empty()) {
+            base::StringAppendF(&result, "\n    Reusable child sets: %zu", mChildren.size());
+        }
     }
 
     base::StringAppendF(&result, "\n    Creation cost: %zd", getCreationCost());
@@ -198,6 +198,7 @@ void Flattener::dump(std::string& result) const {
     base::StringAppendF(&result, "\n    Cached sets created: %zd\n", mCachedSetCreationCount);
     base::StringAppendF(&result, "    Cost: %.2f\n",
                         static_cast<float>(mCachedSetCreationCost) / displayArea);
+    mTexturePool.dump(result);
 
     const auto lastUpdate =
             std::chrono::duration_cast<std::chrono::milliseconds>(now - mLastGeometryUpdate);
@@ -374,17 +375,45 @@ bool Flattener::mergeWithCachedSets(const std::vector<const LayerState*>& layers
                 ++incomingLayerIter;
             }
         } else if (currentLayerIter->getLayerCount() > 1) {
-            // Break the current layer into its constituent layers
+            // Break the current layer into its constituent layers, keeping any previously
+            // rendered part of it that is still valid
             ++mInvalidatedCachedSetAges[currentLayerIter->getAge()];
-            for (CachedSet& layer : currentLayerIter->decompose()) {
-                bool disableBlur =
-                        priorBlurLayer && priorBlurLayer == (*incomingLayerIter)->getOutputLayer();
-                OutputLayer::CompositionState& state =
-                        (*incomingLayerIter)->getOutputLayer()->editState();
-                state.overrideInfo.disableBackgroundBlur = disableBlur;
-                layer.updateAge(now);
+            for (CachedSet& layer : currentLayerIter->decomposeKeepingValidChildren()) {
+                if (layer.getLayerCount() == 1) {
+                    bool disableBlur = priorBlurLayer &&
+                            priorBlurLayer == (*incomingLayerIter)->getOutputLayer();
+                    OutputLayer::CompositionState& state =
+                            (*incomingLayerIter)->getOutputLayer()->editState();
+                    state.overrideInfo.disableBackgroundBlur = disableBlur;
+                    layer.updateAge(now);
+                    merged.emplace_back(layer);
+                    ++incomingLayerIter;
+                    continue;
+                }
+
+                ALOGV("[%s] Reusing child cached set of %zu layers", __func__,
+                      layer.getLayerCount());
+                for (size_t i = 0; i < layer.getLayerCount(); ++i) {
+                    bool disableBlur = priorBlurLayer &&
+                            priorBlurLayer == (*incomingLayerIter)->getOutputLayer();
+                    OutputLayer::CompositionState& state =
+                            (*incomingLayerIter)->getOutputLayer()->editState();
+                    // The override buffer is not the one used last frame, so the whole display
+                    // frame is damaged.
+                    state.overrideInfo = {
+                            .buffer = layer.getBuffer(),
+                            .acquireFence = layer.getDrawFence(),
+                            .displayFrame = layer.getTextureBounds(),
+                            .dataspace = layer.getOutputDataspace(),
+                            .displaySpace = layer.getOutputSpace(),
+                            .damageRegion = Region::INVALID_REGION,
+                            .visibleRegion = layer.getVisibleRegion(),
+                            .peekThroughLayer = nullptr,
+                            .disableBackgroundBlur = disableBlur,
+                    };
+                    ++incomingLayerIter;
+                }
                 merged.emplace_back(layer);
-                ++incomingLayerIter;
             }
         } else {
             bool disableBlur =
@@ -415,9 +444,12 @@ std::vector<Flattener::Run> Flattener::findCandidateRuns(time_point now) const {
     Run::Builder builder;
     bool firstLayer = true;
     bool runHasFirstLayer = false;
+    const auto activeLayerTimeout = mStackIsPredictable
+            ? std::min(mActiveLayerTimeout, kPredictableActiveLayerTimeout)
+            : mActiveLayerTimeout;
 
     for (auto currentSet = mLayers.cbegin(); currentSet != mLayers.cend(); ++currentSet) {
-        const bool layerIsInactive = now - currentSet->getLastUpdate() > mActiveLayerTimeout;
+        const bool layerIsInactive = now - currentSet->getLastUpdate() > activeLayerTimeout;
         const bool layerHasBlur = currentSet->hasBlurBehind();
         if (layerIsInactive && (firstLayer || runHasFirstLayer || !layerHasBlur) &&
             !currentSet->hasUnsupportedDataspace()) {
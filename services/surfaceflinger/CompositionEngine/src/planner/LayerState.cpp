@@ -61,10 +61,18 @@ Flags<LayerStateField> LayerState::update(compositionengine::OutputLayer* layer)
         differences |= field->update(layer);
     }
 
+    if (differences.get() != 0 && differences != LayerStateField::Buffer) {
+        mHash = {};
+    }
+
     return differences;
 }
 
 size_t LayerState::getHash() const {
+    if (mHash) {
+        return *mHash;
+    }
+
     size_t hash = 0;
     for (const StateInterface* field : getNonUniqueFields()) {
         if (field->getField() == LayerStateField::Buffer) {
@@ -73,6 +81,7 @@ size_t LayerState::getHash() const {
         android::hashCombineSingleHashed(hash, field->getHash());
     }
 
+    mHash = hash;
     return hash;
 }
 
@@ -82,6 +82,8 @@ void Planner::plan(
                    [](const auto& layer) { return layer.first; });
 
     std::vector<LayerId> currentLayerIds;
+    currentLayerIds.reserve(mCurrentLayerIds.size());
+    bool nonBufferStateChanged = false;
     for (auto layer : layers) {
         LayerId id = layer->getLayerFE().getSequence();
         if (const auto layerEntry = mPreviousLayers.find(id); layerEntry != mPreviousLayers.end()) {
@@ -99,10 +101,12 @@ void Planner::plan(
                 } else {
                     state.incrementFramesSinceBufferUpdate();
                 }
+                nonBufferStateChanged |= differences != LayerStateField::Buffer;
             }
         } else {
             LayerState state(layer);
             ALOGV("Added layer %s", state.getName().c_str());
+            nonBufferStateChanged = true;
             mPreviousLayers.emplace(std::make_pair(id, std::move(state)));
         }
 
@@ -113,16 +117,29 @@ void Planner::plan(
         }
     }
 
+    if (nonBufferStateChanged || currentLayerIds != mCurrentLayerIds) {
+        mNonBufferHash = {};
+    }
+    mCurrentLayerIds = std::move(currentLayerIds);
+
     mCurrentLayers.clear();
-    mCurrentLayers.reserve(currentLayerIds.size());
-    std::transform(currentLayerIds.cbegin(), currentLayerIds.cend(),
+    mCurrentLayers.reserve(mCurrentLayerIds.size());
+    std::transform(mCurrentLayerIds.cbegin(), mCurrentLayerIds.cend(),
                    std::back_inserter(mCurrentLayers), [this](LayerId id) {
                        LayerState* state = &mPreviousLayers.at(id);
                        state->getOutputLayer()->editState().overrideInfo = {};
                        return state;
                    });
 
-    const NonBufferHash hash = getNonBufferHash(mCurrentLayers);
+    // The prediction is only made once the layers have been flattened, so go by the previous
+    // frame's. If the layer stack changed since, the flattener starts over regardless.
+    mFlattener.setStackIsPredictable(mPredictorEnabled && mPredictedPlan &&
+                                     mPredictor.isPredictionConfident(*mPredictedPlan));
+
+    if (!mNonBufferHash) {
+        mNonBufferHash = getNonBufferHash(mCurrentLayers);
+    }
+    const NonBufferHash hash = *mNonBufferHash;
     mFlattenedHash =
             mFlattener.flattenLayers(mCurrentLayers, hash, std::chrono::steady_clock::now());
     const bool layersWereFlattened = hash != mFlattenedHash;
@@ -270,6 +270,28 @@ void Predictor::listSimilarStacks(Plan plan, std::string& result) const {
     }
 }
 
+bool Predictor::isPredictionConfident(const PredictedPlan& predictedPlan) const {
+    if (predictedPlan.type != Prediction::Type::Exact) {
+        return false;
+    }
+
+    const Prediction* prediction = nullptr;
+    if (const auto predictionEntry = mPredictions.find(predictedPlan.hash);
+        predictionEntry != mPredictions.end()) {
+        prediction = &predictionEntry->second;
+    } else if (const auto candidateEntry = getCandidateEntryByHash(predictedPlan.hash);
+               candidateEntry != mCandidates.cend()) {
+        prediction = &candidateEntry->prediction;
+    } else {
+        return false;
+    }
+
+    const size_t hitCount = prediction->getHitCount(Prediction::Type::Exact);
+    const size_t missCount = prediction->getMissCount(Prediction::Type::Exact);
+    return hitCount >= kMinConfidentHitCount &&
+            missCount * 100 <= (hitCount + missCount) * kMaxConfidentMissPercent;
+}
+
 const Prediction& Predictor::getPrediction(NonBufferHash hash) const {
     if (const auto predictionEntry = mPredictions.find(hash);
         predictionEntry != mPredictions.end()) {
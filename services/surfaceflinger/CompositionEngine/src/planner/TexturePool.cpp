@@ -19,24 +19,110 @@
 #undef LOG_TAG
 #define LOG_TAG "Planner"
 
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 #include <compositionengine/impl/planner/TexturePool.h>
+#include <ui/PixelFormat.h>
 #include <utils/Log.h>
 
+#include <algorithm>
+
 namespace android::compositionengine::impl::planner {
 
+namespace {
+
+constexpr PixelFormat kTextureFormat = HAL_PIXEL_FORMAT_RGBA_8888;
+
+size_t getTextureBytes(uint32_t width, uint32_t height) {
+    return static_cast<size_t>(width) * height * bytesPerPixel(kTextureFormat);
+}
+
+size_t getTextureBytes(const renderengine::ExternalTexture& texture) {
+    return getTextureBytes(texture.getBuffer()->getWidth(), texture.getBuffer()->getHeight());
+}
+
+std::string limitString(size_t bytes) {
+    return bytes == 0 ? std::string("unlimited") : base::StringPrintf("%zu KiB", bytes / 1024);
+}
+
+} // namespace
+
+const std::shared_ptr<TexturePool::Budget>& TexturePool::Budget::getDefault() {
+    static const auto sBudget = std::make_shared<Budget>(
+            base::GetUintProperty<size_t>(std::string("debug.sf.planner_texture_budget_kb"), 0) *
+                    1024,
+            base::GetUintProperty<size_t>(std::string("debug.sf.planner_texture_quota_kb"), 0) *
+                    1024);
+    return sBudget;
+}
+
+bool TexturePool::Budget::reserve(TexturePool& pool, size_t bytes) {
+    while (mPoolQuotaBytes != 0 && pool.mAllocatedBytes + bytes > mPoolQuotaBytes) {
+        if (!pool.evictOldestTexture()) {
+            return false;
+        }
+    }
+
+    while (mBudgetBytes != 0 && mAllocatedBytes + bytes > mBudgetBytes) {
+        TexturePool* oldest = nullptr;
+        for (TexturePool* candidate : mPools) {
+            if (!candidate->mPool.empty() &&
+                (!oldest ||
+                 candidate->mPool.front().returnSequence < oldest->mPool.front().returnSequence)) {
+                oldest = candidate;
+            }
+        }
+        if (!oldest) {
+            return false;
+        }
+        oldest->evictOldestTexture();
+    }
+
+    pool.mAllocatedBytes += bytes;
+    mAllocatedBytes += bytes;
+    return true;
+}
+
+void TexturePool::Budget::release(TexturePool& pool, size_t bytes) {
+    pool.mAllocatedBytes -= bytes;
+    mAllocatedBytes -= bytes;
+}
+
+TexturePool::TexturePool(renderengine::RenderEngine& renderEngine, std::shared_ptr<Budget> budget)
+      : mRenderEngine(renderEngine), mBudget(std::move(budget)) {
+    mBudget->mPools.push_back(this);
+}
+
+TexturePool::~TexturePool() {
+    clearPool();
+    auto& pools = mBudget->mPools;
+    pools.erase(std::remove(pools.begin(), pools.end(), this), pools.end());
+    // Borrowed textures are still accounted to the pool they came from, which is going away.
+    mBudget->release(*this, mAllocatedBytes);
+}
+
 void TexturePool::setDisplaySize(ui::Size size) {
     if (mSize == size) {
         return;
     }
     mSize = size;
-    mPool.clear();
-    mPool.resize(kMinPoolSize);
-    std::generate_n(mPool.begin(), kMinPoolSize, [&]() { return Entry{genTexture(), nullptr}; });
+    clearPool();
+    for (size_t i = 0; i < kMinPoolSize; i++) {
+        auto texture = genTexture();
+        if (!texture) {
+            break;
+        }
+        mPool.push_back({std::move(texture), nullptr, mBudget->mNextReturnSequence++});
+    }
 }
 
 std::shared_ptr<TexturePool::AutoTexture> TexturePool::borrowTexture() {
     if (mPool.empty()) {
-        return std::make_shared<AutoTexture>(*this, genTexture(), nullptr);
+        auto texture = genTexture();
+        if (!texture) {
+            return nullptr;
+        }
+        return std::make_shared<AutoTexture>(*this, std::move(texture), nullptr);
     }
 
     const auto entry = mPool.front();
@@ -44,6 +130,20 @@ std::shared_ptr<TexturePool::AutoTexture> TexturePool::borrowTexture() {
     return std::make_shared<AutoTexture>(*this, entry.texture, entry.fence);
 }
 
+void TexturePool::dump(std::string& result) const {
+    base::StringAppendF(&result,
+                        "    Texture pool: %zu idle, %zu KiB allocated (quota %s), "
+                        "%zu allocations denied
+",
+                        mPool.size(), mAllocatedBytes / 1024,
+                        limitString(mBudget->getPoolQuotaBytes()).c_str(),
+                        mDeniedAllocationCount);
+    base::StringAppendF(&result, "    All texture pools: %zu KiB allocated (budget %s)
+",
+                        mBudget->getAllocatedBytes() / 1024,
+                        limitString(mBudget->getBudgetBytes()).c_str());
+}
+
 void TexturePool::returnTexture(std::shared_ptr<renderengine::ExternalTexture>&& texture,
                                 const sp<Fence>& fence) {
     // Drop the texture on the floor if the pool is no longer tracking textures of the same size.
@@ -53,6 +153,7 @@ void TexturePool::returnTexture(std::shared_ptr<renderengine::ExternalTexture>&&
               "current: (%dx%d))",
               texture->getBuffer()->getWidth(), texture->getBuffer()->getHeight(), mSize.getWidth(),
               mSize.getHeight());
+        mBudget->release(*this, getTextureBytes(*texture));
         return;
     }
 
@@ -60,18 +161,43 @@ void TexturePool::returnTexture(std::shared_ptr<renderengine::ExternalTexture>&&
     if (mPool.size() == kMaxPoolSize) {
         ALOGD("Deallocating texture from Planner's pool - max size [%" PRIu64 "] reached",
               static_cast<uint64_t>(kMaxPoolSize));
+        mBudget->release(*this, getTextureBytes(*texture));
         return;
     }
 
-    mPool.push_back({std::move(texture), fence});
+    mPool.push_back({std::move(texture), fence, mBudget->mNextReturnSequence++});
+}
+
+bool TexturePool::evictOldestTexture() {
+    if (mPool.empty()) {
+        return false;
+    }
+    ALOGV("Deallocating texture from Planner's pool - memory budget reached");
+    mBudget->release(*this, getTextureBytes(*mPool.front().texture));
+    mPool.pop_front();
+    return true;
+}
+
+void TexturePool::clearPool() {
+    for (const auto& entry : mPool) {
+        mBudget->release(*this, getTextureBytes(*entry.texture));
+    }
+    mPool.clear();
 }
 
 std::shared_ptr<renderengine::ExternalTexture> TexturePool::genTexture() {
     LOG_ALWAYS_FATAL_IF(!mSize.isValid(), "Attempted to generate texture with invalid size");
+    if (!mBudget->reserve(*this,
+                          getTextureBytes(static_cast<uint32_t>(mSize.getWidth()),
+                                          static_cast<uint32_t>(mSize.getHeight())))) {
+        ALOGV("Not allocating a texture for Planner's pool - memory budget reached");
+        ++mDeniedAllocationCount;
+        return nullptr;
+    }
     return std::make_shared<
             renderengine::ExternalTexture>(sp<GraphicBuffer>::
                                                    make(mSize.getWidth(), mSize.getHeight(),
-                                                        HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                                                        kTextureFormat, 1,
                                                         GraphicBuffer::USAGE_HW_RENDER |
                                                                 GraphicBuffer::USAGE_HW_COMPOSER |
                                                                 GraphicBuffer::USAGE_HW_TEXTURE,
@@ -123,6 +123,57 @@ TEST_F(CompositionEnginePresentTest, worksAsExpected) {
     mEngine.present(mRefreshArgs);
 }
 
+TEST_F(CompositionEnginePresentTest, preparesClientCompositionConcurrentlyIfSupported) {
+    size_t concurrentCount = 0;
+    mRefreshArgs.runConcurrently = [&](size_t count, const std::function<void(size_t)>& work) {
+        concurrentCount = count;
+        for (size_t i = 0; i < count; i++) {
+            work(i);
+        }
+    };
+
+    // Expect calls to in a certain sequence
+    InSequence seq;
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput2, prepare(Ref(mRefreshArgs), _));
+
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, updateLayerStateFromFE(Ref(mRefreshArgs)));
+
+    // Every output picks its composition strategy before any of them prepare
+    // their client composition, and finishes presenting after all of them have.
+    EXPECT_CALL(*mOutput1, beginPresent(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, beginPresent(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, prepareClientCompositionRequests());
+    EXPECT_CALL(*mOutput2, prepareClientCompositionRequests());
+    EXPECT_CALL(*mOutput1, finishPresent(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, finishPresent(Ref(mRefreshArgs)));
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2};
+    mEngine.present(mRefreshArgs);
+
+    EXPECT_EQ(2u, concurrentCount);
+}
+
+TEST_F(CompositionEnginePresentTest, presentsSingleOutputDirectly) {
+    mRefreshArgs.runConcurrently = [](size_t, const std::function<void(size_t)>&) {
+        FAIL() << "A single output should not be presented concurrently";
+    };
+
+    InSequence seq;
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, present(Ref(mRefreshArgs)));
+
+    mRefreshArgs.outputs = {mOutput1};
+    mEngine.present(mRefreshArgs);
+}
+
 /*
  * CompositionEngine::updateCursorAsync
  */
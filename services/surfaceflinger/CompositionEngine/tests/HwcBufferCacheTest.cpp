@@ -19,6 +19,8 @@
 #include <gui/BufferQueue.h>
 #include <ui/GraphicBuffer.h>
 
+#include <vector>
+
 namespace android::compositionengine {
 namespace {
 
@@ -78,8 +80,74 @@ TEST_F(HwcBufferCacheTest, cacheWorksForMaxSlot) {
     testSlot(BufferQueue::NUM_BUFFER_SLOTS - 1, BufferQueue::NUM_BUFFER_SLOTS - 1);
 }
 
-TEST_F(HwcBufferCacheTest, cacheMapsNegativeSlotToZero) {
-    testSlot(-123, 0);
+TEST_F(HwcBufferCacheTest, cacheCountsHitsAndMisses) {
+    testSlot(0, 0);
+    EXPECT_EQ(2u, mCache.getHitCount());
+    EXPECT_EQ(2u, mCache.getMissCount());
+}
+
+TEST_F(HwcBufferCacheTest, cacheFindsSlotByBufferIdForInvalidSlots) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    mCache.getHwcBuffer(-123, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(mBuffer1, outBuffer);
+
+    // A different buffer gets its own slot, rather than replacing the first one.
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer2, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(mBuffer2, outBuffer);
+
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+
+    mCache.getHwcBuffer(-123, mBuffer2, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+
+    EXPECT_EQ(2u, mCache.getHitCount());
+    EXPECT_EQ(2u, mCache.getMissCount());
+}
+
+TEST_F(HwcBufferCacheTest, cacheReplacesLeastRecentlyUsedSlotForInvalidSlots) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    std::vector<sp<GraphicBuffer>> buffers;
+    for (size_t i = 0; i < BufferQueue::NUM_BUFFER_SLOTS; i++) {
+        buffers.push_back(new GraphicBuffer(1, 1, HAL_PIXEL_FORMAT_RGBA_8888, 1, 0));
+        mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffers.back(), &outSlot,
+                            &outBuffer);
+        EXPECT_EQ(i, outSlot);
+    }
+
+    // Use the first buffer again, so that the second one is the least recently used.
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffers[0], &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(mBuffer1, outBuffer);
+
+    // The evicted buffer has to be sent again.
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffers[1], &outSlot, &outBuffer);
+    EXPECT_EQ(buffers[1], outBuffer);
+}
+
+TEST_F(HwcBufferCacheTest, cacheResendsBufferMovedToAnotherSlot) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    mCache.getHwcBuffer(0, mBuffer1, &outSlot, &outBuffer);
+    mCache.getHwcBuffer(1, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(mBuffer1, outBuffer);
+
+    mCache.getHwcBuffer(1, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(nullptr, outBuffer.get());
 }
 
 } // namespace
@@ -3181,6 +3181,38 @@ TEST_F(OutputComposeSurfacesTest, buildsAndRendersRequestList) {
     verify().execute().expectAFenceWasReturned();
 }
 
+TEST_F(OutputComposeSurfacesTest, rendersPreparedRequestListOnce) {
+    LayerFE::LayerSettings r1;
+    LayerFE::LayerSettings r2;
+
+    r1.geometry.boundaries = FloatRect{1, 2, 3, 4};
+    r2.geometry.boundaries = FloatRect{5, 6, 7, 8};
+
+    EXPECT_CALL(mOutput, getSkipColorTransform()).WillRepeatedly(Return(false));
+    EXPECT_CALL(*mDisplayColorProfile, hasWideColorGamut()).WillRepeatedly(Return(true));
+    EXPECT_CALL(mRenderEngine, supportsProtectedContent()).WillRepeatedly(Return(false));
+    EXPECT_CALL(mRenderEngine, isProtected()).WillRepeatedly(Return(false));
+    EXPECT_CALL(mOutput, appendRegionFlashRequests(RegionEq(kDebugRegion), _))
+            .WillRepeatedly(Return());
+    EXPECT_CALL(*mRenderSurface, dequeueBuffer(_)).WillRepeatedly(Return(mOutputBuffer));
+
+    InSequence seq;
+    EXPECT_CALL(mOutput, generateClientCompositionRequests(false, _, kDefaultOutputDataspace))
+            .WillOnce(Return(std::vector<LayerFE::LayerSettings>{r1}));
+    EXPECT_CALL(mRenderEngine, drawLayers(_, ElementsAre(Pointee(r1)), _, false, _, _))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_CALL(mOutput, generateClientCompositionRequests(false, _, kDefaultOutputDataspace))
+            .WillOnce(Return(std::vector<LayerFE::LayerSettings>{r2}));
+    EXPECT_CALL(mRenderEngine, drawLayers(_, ElementsAre(Pointee(r2)), _, false, _, _))
+            .WillOnce(Return(NO_ERROR));
+
+    // The prepared requests are only used by the next composition.
+    mOutput.mState.isEnabled = true;
+    mOutput.prepareClientCompositionRequests();
+    verify().execute().expectAFenceWasReturned();
+    verify().execute().expectAFenceWasReturned();
+}
+
 TEST_F(OutputComposeSurfacesTest,
        buildsAndRendersRequestListAndCachesFramebufferForInternalLayers) {
     LayerFE::LayerSettings r1;
@@ -3335,6 +3367,58 @@ TEST_F(OutputComposeSurfacesTest, clientCompositionIfRequestChanges) {
     EXPECT_FALSE(mOutput.mState.reusedClientComposition);
 }
 
+MATCHER_P(PartialUpdateAreaEq, expected, "") {
+    *result_listener << "partialUpdateArea " << to_string(arg.partialUpdateArea) << " != "
+                     << to_string(expected);
+    return arg.partialUpdateArea == expected;
+}
+
+TEST_F(OutputComposeSurfacesTest, partialClientCompositionRedrawsOnlyDamageOfReusedFramebuffer) {
+    mOutput.cacheClientCompositionRequests(0);
+    mOutput.setPartialClientCompositionEnabled(true);
+    mOutput.mState.layerStackSpace = ProjectionSpace(ui::Size(100, 100), Rect(0, 0, 100, 100));
+    mOutput.mState.framebufferSpace = ProjectionSpace(ui::Size(100, 100), Rect(0, 0, 100, 100));
+
+    LayerFE::LayerSettings r1;
+    r1.geometry.boundaries = FloatRect{1, 2, 3, 4};
+
+    EXPECT_CALL(mOutput, getOutputLayerCount()).WillRepeatedly(Return(0u));
+    EXPECT_CALL(mOutput, getSkipColorTransform()).WillRepeatedly(Return(false));
+    EXPECT_CALL(*mDisplayColorProfile, hasWideColorGamut()).WillRepeatedly(Return(true));
+    EXPECT_CALL(mRenderEngine, supportsProtectedContent()).WillRepeatedly(Return(false));
+    EXPECT_CALL(mRenderEngine, isProtected()).WillRepeatedly(Return(false));
+    EXPECT_CALL(mOutput, generateClientCompositionRequests(_, _, kDefaultOutputDataspace))
+            .WillRepeatedly(Return(std::vector<LayerFE::LayerSettings>{r1}));
+    EXPECT_CALL(mOutput, appendRegionFlashRequests(_, _)).WillRepeatedly(Return());
+    EXPECT_CALL(*mRenderSurface, dequeueBuffer(_)).WillRepeatedly(Return(mOutputBuffer));
+
+    // The framebuffer was never drawn into, so it is drawn in full.
+    EXPECT_CALL(mRenderEngine, drawLayers(PartialUpdateAreaEq(Rect::INVALID_RECT), _, _, _, _, _))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_TRUE(mOutput.composeSurfaces(Region(), kDefaultRefreshArgs));
+
+    // Only the damage, grown by a pixel, is redrawn the next time it is used.
+    mOutput.mState.dirtyRegion = Region(Rect(10, 10, 20, 20));
+    EXPECT_CALL(mRenderEngine, drawLayers(PartialUpdateAreaEq(Rect(9, 9, 21, 21)), _, _, _, _, _))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_TRUE(mOutput.composeSurfaces(Region(), kDefaultRefreshArgs));
+
+    // Flashing the dirty region invalidates the framebuffer.
+    mOutput.mState.dirtyRegion.clear();
+    EXPECT_CALL(mRenderEngine, drawLayers(PartialUpdateAreaEq(Rect::INVALID_RECT), _, _, _, _, _))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_TRUE(mOutput.composeSurfaces(kDebugRegion, kDefaultRefreshArgs));
+
+    // As does any change to what is drawn besides the layer contents.
+    mOutput.mState.dataspace = kExpensiveOutputDataspace;
+    EXPECT_CALL(mOutput, generateClientCompositionRequests(_, _, kExpensiveOutputDataspace))
+            .WillRepeatedly(Return(std::vector<LayerFE::LayerSettings>{r1}));
+    EXPECT_CALL(mOutput, setExpensiveRenderingExpected(true));
+    EXPECT_CALL(mRenderEngine, drawLayers(PartialUpdateAreaEq(Rect::INVALID_RECT), _, _, _, _, _))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_TRUE(mOutput.composeSurfaces(Region(), kDefaultRefreshArgs));
+}
+
 struct OutputComposeSurfacesTest_UsesExpectedDisplaySettings : public OutputComposeSurfacesTest {
     OutputComposeSurfacesTest_UsesExpectedDisplaySettings() {
         EXPECT_CALL(mRenderEngine, supportsProtectedContent()).WillRepeatedly(Return(false));
@@ -215,6 +215,51 @@ TEST_F(CachedSetTest, decompose) {
     expectNoBuffer(decomposed[2]);
 }
 
+TEST_F(CachedSetTest, decomposeKeepingValidChildren) {
+    CachedSet::Layer& layer1 = *mTestLayers[0]->cachedSetLayer.get();
+    sp<mock::LayerFE> layerFE1 = mTestLayers[0]->layerFE;
+    CachedSet::Layer& layer2 = *mTestLayers[1]->cachedSetLayer.get();
+    sp<mock::LayerFE> layerFE2 = mTestLayers[1]->layerFE;
+    CachedSet::Layer& layer3 = *mTestLayers[2]->cachedSetLayer.get();
+
+    std::vector<compositionengine::LayerFE::LayerSettings> clientCompList;
+    clientCompList.push_back({});
+    EXPECT_CALL(*layerFE1, prepareClientCompositionList(_)).WillOnce(Return(clientCompList));
+    EXPECT_CALL(*layerFE2, prepareClientCompositionList(_)).WillOnce(Return(clientCompList));
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).WillOnce(Return(NO_ERROR));
+
+    CachedSet child(layer1);
+    child.append(CachedSet(layer2));
+    child.render(mRenderEngine, mTexturePool, mOutputState);
+    expectReadyBuffer(child);
+
+    CachedSet cachedSet(child);
+    cachedSet.append(CachedSet(layer3));
+    expectNoBuffer(cachedSet);
+
+    // Only the layer outside of the rendered child was updated, so the child is kept whole
+    mTestLayers[2]->layerState->resetFramesSinceBufferUpdate();
+    std::vector<CachedSet> decomposed = cachedSet.decomposeKeepingValidChildren();
+    ASSERT_EQ(2u, decomposed.size());
+    EXPECT_EQ(2u, decomposed[0].getLayerCount());
+    EXPECT_EQ(layer1.getState(), decomposed[0].getFirstLayer().getState());
+    EXPECT_EQ(child.getBuffer(), decomposed[0].getBuffer());
+    expectReadyBuffer(decomposed[0]);
+    expectEqual(decomposed[1], layer3);
+    expectNoBuffer(decomposed[1]);
+
+    // Once the child is also updated, it is broken into its layers
+    mTestLayers[1]->layerState->resetFramesSinceBufferUpdate();
+    decomposed = cachedSet.decomposeKeepingValidChildren();
+    ASSERT_EQ(3u, decomposed.size());
+    expectEqual(decomposed[0], layer1);
+    expectEqual(decomposed[1], layer2);
+    expectEqual(decomposed[2], layer3);
+    for (const auto& set : decomposed) {
+        expectNoBuffer(set);
+    }
+}
+
 TEST_F(CachedSetTest, setLastUpdate) {
     LayerState& layerState = *mTestLayers[0]->layerState.get();
     CachedSet cachedSet(&layerState, kStartTime);
@@ -353,6 +353,7 @@ TEST_F(LayerStateTest, updateBuffer) {
     setupMocksForLayer(mOutputLayer, mLayerFE, outputLayerCompositionState,
                        layerFECompositionState);
     mLayerState = std::make_unique<LayerState>(&mOutputLayer);
+    const size_t hash = mLayerState->getHash();
 
     mock::OutputLayer newOutputLayer;
     mock::LayerFE newLayerFE;
@@ -362,6 +363,8 @@ TEST_F(LayerStateTest, updateBuffer) {
                        layerFECompositionStateTwo);
     Flags<LayerStateField> updates = mLayerState->update(&newOutputLayer);
     EXPECT_EQ(Flags<LayerStateField>(LayerStateField::Buffer), updates);
+    // Buffers are excluded from the hash
+    EXPECT_EQ(hash, mLayerState->getHash());
 }
 
 TEST_F(LayerStateTest, compareBuffer) {
@@ -394,6 +397,7 @@ TEST_F(LayerStateTest, updateSourceCrop) {
     setupMocksForLayer(mOutputLayer, mLayerFE, outputLayerCompositionState,
                        layerFECompositionState);
     mLayerState = std::make_unique<LayerState>(&mOutputLayer);
+    const size_t hash = mLayerState->getHash();
 
     mock::OutputLayer newOutputLayer;
     mock::LayerFE newLayerFE;
@@ -403,6 +407,7 @@ TEST_F(LayerStateTest, updateSourceCrop) {
                        layerFECompositionState);
     Flags<LayerStateField> updates = mLayerState->update(&newOutputLayer);
     EXPECT_EQ(Flags<LayerStateField>(LayerStateField::SourceCrop), updates);
+    EXPECT_NE(hash, mLayerState->getHash());
 }
 
 TEST_F(LayerStateTest, compareSourceCrop) {
@@ -462,6 +462,41 @@ TEST_F(PredictorTest, getPredictedPlan_recordCandidateAndRetrieveExactMatch) {
     EXPECT_EQ(expectedPlan, predictedPlan);
 }
 
+TEST_F(PredictorTest, isPredictionConfident_requiresRepeatedExactHits) {
+    mock::OutputLayer outputLayerOne;
+    mock::LayerFE layerFEOne;
+    OutputLayerCompositionState outputLayerCompositionStateOne;
+    LayerFECompositionState layerFECompositionStateOne;
+    layerFECompositionStateOne.compositionType = hal::Composition::DEVICE;
+    setupMocksForLayer(outputLayerOne, layerFEOne, outputLayerCompositionStateOne,
+                       layerFECompositionStateOne);
+    LayerState layerStateOne(&outputLayerOne);
+
+    Plan plan;
+    plan.addLayerType(hal::Composition::DEVICE);
+
+    Predictor predictor;
+
+    NonBufferHash hash = getNonBufferHash({&layerStateOne});
+
+    predictor.recordResult(std::nullopt, hash, {&layerStateOne}, false, plan);
+    auto predictedPlan = predictor.getPredictedPlan({}, hash);
+    ASSERT_TRUE(predictedPlan);
+    EXPECT_FALSE(predictor.isPredictionConfident(*predictedPlan));
+
+    for (int i = 0; i < 10; i++) {
+        predictor.recordResult(predictedPlan, hash, {&layerStateOne}, false, plan);
+    }
+    EXPECT_TRUE(predictor.isPredictionConfident(*predictedPlan));
+
+    // Missing twice in twelve attempts is too unreliable.
+    Plan otherPlan;
+    otherPlan.addLayerType(hal::Composition::CLIENT);
+    predictor.recordResult(predictedPlan, hash, {&layerStateOne}, false, otherPlan);
+    predictor.recordResult(predictedPlan, hash, {&layerStateOne}, false, otherPlan);
+    EXPECT_FALSE(predictor.isPredictionConfident(*predictedPlan));
+}
+
 TEST_F(PredictorTest, getPredictedPlan_recordCandidateAndRetrieveApproximateMatch) {
     mock::OutputLayer outputLayerOne;
     mock::LayerFE layerFEOne;
@@ -31,6 +31,8 @@ const ui::Size kDisplaySizeTwo(2, 2);
 class TestableTexturePool : public TexturePool {
 public:
     TestableTexturePool(renderengine::RenderEngine& renderEngine) : TexturePool(renderEngine) {}
+    TestableTexturePool(renderengine::RenderEngine& renderEngine, std::shared_ptr<Budget> budget)
+          : TexturePool(renderEngine, std::move(budget)) {}
 
     size_t getMinPoolSize() const { return kMinPoolSize; }
     size_t getMaxPoolSize() const { return kMaxPoolSize; }
@@ -130,5 +132,52 @@ TEST_F(TexturePoolTest, reallocatesWhenDisplaySizeChanges) {
               static_cast<int32_t>(texture->get()->getBuffer()->getHeight()));
 }
 
+// Size of a texture of kDisplaySize.
+constexpr size_t kTextureBytes = 4;
+
+TEST_F(TexturePoolTest, quotaLimitsAllocations) {
+    auto budget = std::make_shared<TexturePool::Budget>(0, 4 * kTextureBytes);
+    TestableTexturePool texturePool(mRenderEngine, budget);
+    texturePool.setDisplaySize(kDisplaySize);
+    EXPECT_EQ(texturePool.getMinPoolSize() * kTextureBytes, budget->getAllocatedBytes());
+
+    std::vector<std::shared_ptr<TexturePool::AutoTexture>> textures;
+    for (size_t i = 0; i < 4; i++) {
+        textures.emplace_back(texturePool.borrowTexture());
+        ASSERT_NE(nullptr, textures.back());
+    }
+    EXPECT_EQ(nullptr, texturePool.borrowTexture());
+    EXPECT_EQ(4 * kTextureBytes, budget->getAllocatedBytes());
+
+    textures.clear();
+    EXPECT_EQ(4u, texturePool.getPoolSize());
+    EXPECT_EQ(4 * kTextureBytes, budget->getAllocatedBytes());
+}
+
+TEST_F(TexturePoolTest, budgetEvictsLongestIdleTexturesAcrossPools) {
+    auto budget = std::make_shared<TexturePool::Budget>(4 * kTextureBytes, 0);
+    TestableTexturePool first(mRenderEngine, budget);
+    TestableTexturePool second(mRenderEngine, budget);
+
+    first.setDisplaySize(kDisplaySize);
+    EXPECT_EQ(first.getMinPoolSize(), first.getPoolSize());
+
+    // The second pool can only preallocate by freeing the idle textures of the first one.
+    second.setDisplaySize(kDisplaySize);
+    EXPECT_EQ(second.getMinPoolSize(), second.getPoolSize());
+    EXPECT_EQ(4 - second.getMinPoolSize(), first.getPoolSize());
+    EXPECT_EQ(4 * kTextureBytes, budget->getAllocatedBytes());
+
+    // Borrowed textures can't be freed, so once every texture is in use allocations fail.
+    std::vector<std::shared_ptr<TexturePool::AutoTexture>> textures;
+    while (first.getPoolSize() > 0) {
+        textures.emplace_back(first.borrowTexture());
+    }
+    while (second.getPoolSize() > 0) {
+        textures.emplace_back(second.borrowTexture());
+    }
+    EXPECT_EQ(nullptr, first.borrowTexture());
+}
+
 } // namespace
 } // namespace android::compositionengine::impl::planner
@@ -19,6 +19,7 @@
 #include <android-base/expected.h>
 #include <gui/HdrMetadata.h>
 #include <math/mat4.h>
+#include <ui/FloatRect.h>
 #include <ui/HdrCapabilities.h>
 #include <ui/Region.h>
 #include <ui/StaticDisplayInfo.h>
@@ -28,6 +29,7 @@
 
 #include <functional>
 #include <future>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -374,6 +376,13 @@ private:
     android::mat4 mColorMatrix;
     uint32_t mBufferSlot;
     uint32_t mType{0};
+    std::optional<hal::BlendMode> mBlendMode;
+    std::optional<hal::Color> mColor;
+    std::optional<android::Rect> mDisplayFrame;
+    std::optional<float> mPlaneAlpha;
+    std::optional<android::FloatRect> mSourceCrop;
+    std::optional<hal::Transform> mTransform;
+    std::optional<uint32_t> mZOrder;
 #ifdef QTI_UNIFIED_DRAW
     IQtiComposerClient::LayerFlag mLayerFlag = IQtiComposerClient::LayerFlag::DEFAULT;
 #endif
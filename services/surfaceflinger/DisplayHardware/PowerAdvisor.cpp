@@ -19,6 +19,7 @@
 #undef LOG_TAG
 #define LOG_TAG "PowerAdvisor"
 
+#include <unistd.h>
 #include <cinttypes>
 
 #include <android-base/properties.h>
@@ -48,10 +49,14 @@ using V1_3::PowerHint;
 using android::hardware::power::Boost;
 using android::hardware::power::IPower;
 using android::hardware::power::Mode;
+using android::hardware::power::WorkDuration;
+using base::GetBoolProperty;
 using base::GetIntProperty;
 using scheduler::OneShotTimer;
 
-PowerAdvisor::~PowerAdvisor() = default;
+PowerAdvisor::~PowerAdvisor() {
+    closePowerHintSession();
+}
 
 namespace {
 int32_t getUpdateTimeout() {
@@ -60,6 +65,10 @@ int32_t getUpdateTimeout() {
     return timeout;
 }
 
+// Upper bound on the work durations batched into one report, should the Power HAL prefer a rate
+// much slower than the refresh rate.
+constexpr size_t kMaxPendingWorkDurations = 8;
+
 } // namespace
 
 PowerAdvisor::PowerAdvisor(SurfaceFlinger& flinger)
@@ -72,7 +81,8 @@ PowerAdvisor::PowerAdvisor(SurfaceFlinger& flinger)
                 [this] {
                     mSendUpdateImminent.store(true);
                     mFlinger.disableExpensiveRendering();
-                }) {}
+                }),
+        mUsePowerHintSession(GetBoolProperty("debug.sf.enable_power_hint_session", true)) {}
 
 void PowerAdvisor::init() {
     // Defer starting the screen update timer until SurfaceFlinger finishes construction.
@@ -144,6 +154,98 @@ bool PowerAdvisor::canNotifyDisplayUpdateImminent() {
     return canNotify;
 }
 
+void PowerAdvisor::setPowerHintSessionThreadIds(const std::vector<int32_t>& threadIds) {
+    if (threadIds == mPowerHintSessionThreadIds) {
+        return;
+    }
+    mPowerHintSessionThreadIds = threadIds;
+
+    // A session covers a fixed set of threads, so start a new one on the next report.
+    closePowerHintSession();
+}
+
+void PowerAdvisor::reportWorkDuration(nsecs_t targetDuration, nsecs_t actualDuration,
+                                      nsecs_t timestamp) {
+    // Like display update notifications, don't depend on the Power HAL before boot finishes
+    if (!mUsePowerHintSession || !mBootFinished.load() || targetDuration <= 0) {
+        return;
+    }
+
+    if (mPowerHintSession == nullptr && !startPowerHintSession(targetDuration)) {
+        return;
+    }
+
+    if (targetDuration != mTargetWorkDuration) {
+        ALOGV("Power hint session target duration %" PRId64 "ns", targetDuration);
+        if (!mPowerHintSession->updateTargetWorkDuration(targetDuration).isOk()) {
+            ALOGW("Failed to update the power hint session target duration");
+            closePowerHintSession();
+            return;
+        }
+        mTargetWorkDuration = targetDuration;
+    }
+
+    WorkDuration workDuration;
+    workDuration.timeStampNanos = timestamp;
+    workDuration.durationNanos = actualDuration;
+    mPendingWorkDurations.push_back(workDuration);
+
+    const bool missedTarget = actualDuration > targetDuration;
+    if (!missedTarget && timestamp - mLastReportTime < mPreferredReportRate &&
+        mPendingWorkDurations.size() < kMaxPendingWorkDurations) {
+        return;
+    }
+
+    ALOGV("Reporting %zu work durations, last %" PRId64 "ns of %" PRId64 "ns",
+          mPendingWorkDurations.size(), actualDuration, targetDuration);
+    const auto ret = mPowerHintSession->reportActualWorkDuration(mPendingWorkDurations);
+    mPendingWorkDurations.clear();
+    mLastReportTime = timestamp;
+    if (!ret.isOk()) {
+        // The session died with the HAL; start a new one on the next report
+        ALOGW("Failed to report work durations: %s", ret.toString8().c_str());
+        closePowerHintSession();
+    }
+}
+
+bool PowerAdvisor::startPowerHintSession(nsecs_t targetDuration) {
+    if (!mPowerHintSessionSupported || mPowerHintSessionThreadIds.empty()) {
+        return false;
+    }
+
+    auto result = mPowerHalController.createHintSession(getpid(), static_cast<int32_t>(getuid()),
+                                                        mPowerHintSessionThreadIds,
+                                                        targetDuration);
+    if (!result.isOk() || result.value() == nullptr) {
+        // Either the HAL doesn't support sessions or it is unlikely to start, so stop trying
+        ALOGW_IF(result.isFailed(), "Failed to create power hint session: %s",
+                 result.errorMessage());
+        ALOGI_IF(!result.isFailed(), "Power HAL doesn't support hint sessions");
+        mPowerHintSessionSupported = false;
+        return false;
+    }
+    ALOGI("Started power hint session for %zu threads", mPowerHintSessionThreadIds.size());
+
+    mPowerHintSession = result.value();
+    mTargetWorkDuration = targetDuration;
+
+    const auto rate = mPowerHalController.getHintSessionPreferredRate();
+    mPreferredReportRate = rate.isOk() ? rate.value() : 0;
+    return true;
+}
+
+void PowerAdvisor::closePowerHintSession() {
+    if (mPowerHintSession == nullptr) {
+        return;
+    }
+
+    mPowerHintSession->close();
+    mPowerHintSession = nullptr;
+    mTargetWorkDuration = 0;
+    mLastReportTime = 0;
+    mPendingWorkDurations.clear();
+}
+
 class HidlPowerHalWrapper : public PowerAdvisor::HalWrapper {
 public:
     HidlPowerHalWrapper(sp<V1_3::IPower> powerHal) : mPowerHal(std::move(powerHal)) {}
@@ -18,8 +18,13 @@
 
 #include <atomic>
 #include <unordered_set>
+#include <vector>
 
+#include <android/hardware/power/IPowerHintSession.h>
+#include <android/hardware/power/WorkDuration.h>
+#include <powermanager/PowerHalController.h>
 #include <utils/Mutex.h>
+#include <utils/Timers.h>
 
 #include "../Scheduler/OneShotTimer.h"
 #include "DisplayIdentification.h"
@@ -41,6 +46,15 @@ public:
     virtual bool isUsingExpensiveRendering() = 0;
     virtual void notifyDisplayUpdateImminent() = 0;
     virtual bool canNotifyDisplayUpdateImminent() = 0;
+
+    // Sets the threads whose work is reported by reportWorkDuration, i.e. the main and
+    // RenderEngine threads.
+    virtual void setPowerHintSessionThreadIds(const std::vector<int32_t>& threadIds) = 0;
+    // Reports how long SurfaceFlinger took to produce a frame, against how long it had, to the
+    // power hint session of its threads. This lets the Power HAL scale CPU performance to the
+    // deadline of SurfaceFlinger instead of boosting on every update.
+    virtual void reportWorkDuration(nsecs_t targetDuration, nsecs_t actualDuration,
+                                    nsecs_t timestamp) = 0;
 };
 
 namespace impl {
@@ -66,6 +80,9 @@ public:
     bool isUsingExpensiveRendering() override { return mNotifiedExpensiveRendering; }
     void notifyDisplayUpdateImminent() override;
     bool canNotifyDisplayUpdateImminent() override;
+    void setPowerHintSessionThreadIds(const std::vector<int32_t>& threadIds) override;
+    void reportWorkDuration(nsecs_t targetDuration, nsecs_t actualDuration,
+                            nsecs_t timestamp) override;
 
 private:
     HalWrapper* getPowerHal() REQUIRES(mPowerHalMutex);
@@ -81,6 +98,22 @@ private:
     const bool mUseScreenUpdateTimer;
     std::atomic_bool mSendUpdateImminent = true;
     scheduler::OneShotTimer mScreenUpdateTimer;
+
+    bool startPowerHintSession(nsecs_t targetDuration);
+    void closePowerHintSession();
+
+    // The power hint session is only used on the main thread.
+    const bool mUsePowerHintSession;
+    bool mPowerHintSessionSupported = true;
+    power::PowerHalController mPowerHalController;
+    sp<hardware::power::IPowerHintSession> mPowerHintSession;
+    std::vector<int32_t> mPowerHintSessionThreadIds;
+    nsecs_t mTargetWorkDuration = 0;
+    // Work durations are batched up to the rate preferred by the Power HAL, unless a frame misses
+    // its target.
+    nsecs_t mPreferredReportRate = 0;
+    nsecs_t mLastReportTime = 0;
+    std::vector<hardware::power::WorkDuration> mPendingWorkDurations;
 };
 
 } // namespace impl
@@ -106,6 +106,12 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc, VirtualDisplayId d
     sink->query(NATIVE_WINDOW_CONSUMER_USAGE_BITS, &sinkUsage);
     mSinkUsage |= (GRALLOC_USAGE_HW_COMPOSER | sinkUsage);
     setOutputUsage(mSinkUsage);
+    // Only a video encoder gains from HWC converting GPU-composed frames to YUV. For any other
+    // consumer the GPU renders straight into the sink buffer, which saves the HWC copy out of a
+    // scratch buffer.
+    if (!(sinkUsage & GRALLOC_USAGE_HW_VIDEO_ENCODER)) {
+        mForceHwcCopy = false;
+    }
     if (sinkUsage & (GRALLOC_USAGE_SW_READ_MASK | GRALLOC_USAGE_SW_WRITE_MASK)) {
         int sinkFormat;
         sink->query(NATIVE_WINDOW_FORMAT, &sinkFormat);
@@ -164,7 +170,8 @@ status_t VirtualDisplaySurface::prepareFrame(CompositionType compositionType) {
         // directly to the consumer.
         //
         // On the other hand, when the consumer prefers RGB or can consume RGB
-        // inexpensively, this forces an unnecessary copy.
+        // inexpensively, this forces an unnecessary copy, which is why it is
+        // only done for video encoder sinks.
         mCompositionType = COMPOSITION_MIXED;
     }
 
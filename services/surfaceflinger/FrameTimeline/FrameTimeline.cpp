@@ -817,7 +817,7 @@ FrameTimeline::DisplayFrame::DisplayFrame(std::shared_ptr<TimeStats> timeStats,
 void FrameTimeline::addSurfaceFrame(std::shared_ptr<SurfaceFrame> surfaceFrame) {
     ATRACE_CALL();
     std::scoped_lock lock(mMutex);
-    mCurrentDisplayFrame->addSurfaceFrame(surfaceFrame);
+    mCurrentDisplayFrame->addSurfaceFrame(std::move(surfaceFrame));
 }
 
 void FrameTimeline::setSfWakeUp(int64_t token, nsecs_t wakeUpTime, Fps refreshRate) {
@@ -825,6 +825,16 @@ void FrameTimeline::setSfWakeUp(int64_t token, nsecs_t wakeUpTime, Fps refreshRa
     std::scoped_lock lock(mMutex);
     mCurrentDisplayFrame->onSfWakeUp(token, refreshRate,
                                      mTokenManager.getPredictionsForToken(token), wakeUpTime);
+
+    uint32_t framesInFlight = 0;
+    for (const auto& [presentFence, displayFrame] : mPendingPresentFences) {
+        if (presentFence && presentFence->isValid() &&
+            presentFence->getSignalTime() == Fence::SIGNAL_TIME_PENDING) {
+            framesInFlight++;
+        }
+    }
+    mCurrentDisplayFrame->setFramesInFlight(framesInFlight);
+    ATRACE_INT("FramesInFlight", static_cast<int32_t>(framesInFlight));
 }
 
 void FrameTimeline::setSfPresent(nsecs_t sfPresentTime,
@@ -834,13 +844,39 @@ void FrameTimeline::setSfPresent(nsecs_t sfPresentTime,
     std::scoped_lock lock(mMutex);
     mCurrentDisplayFrame->setActualEndTime(sfPresentTime);
     mCurrentDisplayFrame->setGpuFence(gpuFence);
+    if (mCurrentDisplayFrame->getPredictionState() == PredictionState::Valid) {
+        mLastSfTimelines.emplace(mCurrentDisplayFrame->getPredictions(),
+                                 mCurrentDisplayFrame->getActuals());
+    } else {
+        mLastSfTimelines.reset();
+    }
     mPendingPresentFences.emplace_back(std::make_pair(presentFence, mCurrentDisplayFrame));
     flushPendingPresentFences();
     finalizeCurrentDisplayFrame();
 }
 
+std::optional<std::pair<TimelineItem, TimelineItem>> FrameTimeline::getLastSfTimelines() const {
+    std::scoped_lock lock(mMutex);
+    return mLastSfTimelines;
+}
+
+void FrameTimeline::DisplayFrame::reset() {
+    mToken = FrameTimelineInfo::INVALID_VSYNC_ID;
+    mSurfaceFlingerPredictions = TimelineItem();
+    mSurfaceFlingerActuals = TimelineItem();
+    mSurfaceFrames.clear();
+    mPredictionState = PredictionState::None;
+    mJankType = JankType::None;
+    mGpuFence = FenceTime::NO_FENCE;
+    mFramePresentMetadata = FramePresentMetadata::UnknownPresent;
+    mFrameReadyMetadata = FrameReadyMetadata::UnknownFinish;
+    mFrameStartMetadata = FrameStartMetadata::UnknownStart;
+    mFramesInFlight = 0;
+    mRefreshRate = Fps();
+}
+
 void FrameTimeline::DisplayFrame::addSurfaceFrame(std::shared_ptr<SurfaceFrame> surfaceFrame) {
-    mSurfaceFrames.push_back(surfaceFrame);
+    mSurfaceFrames.push_back(std::move(surfaceFrame));
 }
 
 void FrameTimeline::DisplayFrame::onSfWakeUp(int64_t token, Fps refreshRate,
@@ -857,6 +893,10 @@ void FrameTimeline::DisplayFrame::onSfWakeUp(int64_t token, Fps refreshRate,
     mSurfaceFlingerActuals.startTime = wakeUpTime;
 }
 
+void FrameTimeline::DisplayFrame::setFramesInFlight(uint32_t framesInFlight) {
+    mFramesInFlight = framesInFlight;
+}
+
 void FrameTimeline::DisplayFrame::setPredictions(PredictionState predictionState,
                                                  TimelineItem predictions) {
     mPredictionState = predictionState;
@@ -1178,14 +1218,23 @@ void FrameTimeline::flushPendingPresentFences() {
 }
 
 void FrameTimeline::finalizeCurrentDisplayFrame() {
+    std::shared_ptr<DisplayFrame> oldestDisplayFrame;
     while (mDisplayFrames.size() >= mMaxDisplayFrames) {
         // We maintain only a fixed number of frames' data. Pop older frames
+        oldestDisplayFrame = std::move(mDisplayFrames.front());
         mDisplayFrames.pop_front();
     }
-    mDisplayFrames.push_back(mCurrentDisplayFrame);
-    mCurrentDisplayFrame.reset();
-    mCurrentDisplayFrame = std::make_shared<DisplayFrame>(mTimeStats, mJankClassificationThresholds,
-                                                          &mTraceCookieCounter);
+    mDisplayFrames.push_back(std::move(mCurrentDisplayFrame));
+
+    // Recycle the frame that was popped, unless it is still waiting on its present fence.
+    if (oldestDisplayFrame && oldestDisplayFrame.use_count() == 1) {
+        oldestDisplayFrame->reset();
+        mCurrentDisplayFrame = std::move(oldestDisplayFrame);
+    } else {
+        mCurrentDisplayFrame =
+                std::make_shared<DisplayFrame>(mTimeStats, mJankClassificationThresholds,
+                                               &mTraceCookieCounter);
+    }
 }
 
 nsecs_t FrameTimeline::DisplayFrame::getBaseTime() const {
@@ -1234,6 +1283,7 @@ void FrameTimeline::DisplayFrame::dump(std::string& result, nsecs_t baseTime) co
     StringAppendF(&result, "Present Metadata : %s\n", toString(mFramePresentMetadata).c_str());
     StringAppendF(&result, "Finish Metadata: %s\n", toString(mFrameReadyMetadata).c_str());
     StringAppendF(&result, "Start Metadata: %s\n", toString(mFrameStartMetadata).c_str());
+    StringAppendF(&result, "Frames In Flight: %u\n", mFramesInFlight);
     std::chrono::nanoseconds vsyncPeriod(mRefreshRate.getPeriodNsecs());
     StringAppendF(&result, "Vsync Period: %10f\n",
                   std::chrono::duration<double, std::milli>(vsyncPeriod).count());
@@ -298,6 +298,11 @@ public:
     virtual void setSfPresent(nsecs_t sfPresentTime, const std::shared_ptr<FenceTime>& presentFence,
                               const std::shared_ptr<FenceTime>& gpuFence) = 0;
 
+    // Returns the predicted and actual SurfaceFlinger timelines of the DisplayFrame last finalized
+    // by setSfPresent, or nullopt if its predictions had expired. Only the start and end times are
+    // set, as the frame has not been presented yet.
+    virtual std::optional<std::pair<TimelineItem, TimelineItem>> getLastSfTimelines() const = 0;
+
     // Args:
     // -jank : Dumps only the Display Frames that are either janky themselves
     //         or contain janky Surface Frames.
@@ -375,6 +380,13 @@ public:
         void setActualStartTime(nsecs_t actualStartTime);
         void setActualEndTime(nsecs_t actualEndTime);
         void setGpuFence(const std::shared_ptr<FenceTime>& gpuFence);
+        // Sets the number of earlier DisplayFrames that were still waiting to be presented when
+        // SurfaceFlinger woke up for this one.
+        void setFramesInFlight(uint32_t framesInFlight);
+        PredictionState getPredictionState() const { return mPredictionState; }
+        // Clears all data so that the DisplayFrame can be reused for a new frame. Keeps the
+        // storage of the SurfaceFrame collection.
+        void reset();
 
         // BaseTime is the smallest timestamp in a DisplayFrame.
         // Used for dumping all timestamps relative to the oldest, making it easy to read.
@@ -387,6 +399,7 @@ public:
         FramePresentMetadata getFramePresentMetadata() const { return mFramePresentMetadata; };
         FrameReadyMetadata getFrameReadyMetadata() const { return mFrameReadyMetadata; };
         int32_t getJankType() const { return mJankType; }
+        uint32_t getFramesInFlight() const { return mFramesInFlight; }
         const std::vector<std::shared_ptr<SurfaceFrame>>& getSurfaceFrames() const {
             return mSurfaceFrames;
         }
@@ -424,6 +437,10 @@ public:
         FrameReadyMetadata mFrameReadyMetadata = FrameReadyMetadata::UnknownFinish;
         // Enum for the type of start
         FrameStartMetadata mFrameStartMetadata = FrameStartMetadata::UnknownStart;
+        // Number of earlier DisplayFrames whose present fence had not signaled yet when this
+        // DisplayFrame started. Non-zero when composition of this frame overlapped with the
+        // composition or present of an earlier one.
+        uint32_t mFramesInFlight = 0;
         // The refresh rate (vsync period) in nanoseconds as seen by SF during this DisplayFrame's
         // timeline
         Fps mRefreshRate;
@@ -446,6 +463,7 @@ public:
     void setSfWakeUp(int64_t token, nsecs_t wakeupTime, Fps refreshRate) override;
     void setSfPresent(nsecs_t sfPresentTime, const std::shared_ptr<FenceTime>& presentFence,
                       const std::shared_ptr<FenceTime>& gpuFence = FenceTime::NO_FENCE) override;
+    std::optional<std::pair<TimelineItem, TimelineItem>> getLastSfTimelines() const override;
     void parseArgs(const Vector<String16>& args, std::string& result) override;
     void setMaxDisplayFrames(uint32_t size) override;
     float computeFps(const std::unordered_set<int32_t>& layerIds) override;
@@ -468,11 +486,13 @@ private:
     void dumpAll(std::string& result);
     void dumpJank(std::string& result);
 
-    // Sliding window of display frames. TODO(b/168072834): compare perf with fixed size array
+    // Sliding window of display frames. The frame that slides out of the window is reused as the
+    // next current frame when nothing else refers to it anymore.
     std::deque<std::shared_ptr<DisplayFrame>> mDisplayFrames GUARDED_BY(mMutex);
     std::vector<std::pair<std::shared_ptr<FenceTime>, std::shared_ptr<DisplayFrame>>>
             mPendingPresentFences GUARDED_BY(mMutex);
     std::shared_ptr<DisplayFrame> mCurrentDisplayFrame GUARDED_BY(mMutex);
+    std::optional<std::pair<TimelineItem, TimelineItem>> mLastSfTimelines GUARDED_BY(mMutex);
     TokenManager mTokenManager;
     TraceCookieCounter mTraceCookieCounter;
     mutable std::mutex mMutex;
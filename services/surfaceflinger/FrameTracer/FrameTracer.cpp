@@ -26,6 +26,9 @@
 
 #include <android-base/stringprintf.h>
 #include <perfetto/common/builtin_clock.pbzero.h>
+#include <utils/Trace.h>
+
+#include <pthread.h>
 
 #include <algorithm>
 #include <mutex>
@@ -34,6 +37,20 @@ PERFETTO_DEFINE_DATA_SOURCE_STATIC_MEMBERS(android::FrameTracer::FrameTracerData
 
 namespace android {
 
+FrameTracer::FrameTracer() {
+    mThread = std::thread(&FrameTracer::threadMain, this);
+    pthread_setname_np(mThread.native_handle(), "FrameTracer");
+}
+
+FrameTracer::~FrameTracer() {
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        mStopped = true;
+    }
+    mQueueCondition.notify_all();
+    mThread.join();
+}
+
 void FrameTracer::initialize() {
     std::call_once(mInitializationFlag, [this]() {
         perfetto::TracingInitArgs args;
@@ -49,59 +66,178 @@ void FrameTracer::registerDataSource() {
     FrameTracerDataSource::Register(dsd);
 }
 
+bool FrameTracer::isTracing() {
+    bool tracing = false;
+    FrameTracerDataSource::Trace(
+            [&tracing](FrameTracerDataSource::TraceContext) { tracing = true; });
+    return tracing;
+}
+
 void FrameTracer::traceNewLayer(int32_t layerId, const std::string& layerName) {
-    FrameTracerDataSource::Trace([this, layerId, &layerName](FrameTracerDataSource::TraceContext) {
-        if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
-            std::lock_guard<std::mutex> lock(mTraceMutex);
-            mTraceTracker[layerId].layerName = layerName;
-        }
-    });
+    if (isTracing()) {
+        queueEvent({layerId, NewLayerEvent{layerName}});
+    }
 }
 
 void FrameTracer::traceTimestamp(int32_t layerId, uint64_t bufferID, uint64_t frameNumber,
                                  nsecs_t timestamp, FrameEvent::BufferEventType type,
                                  nsecs_t duration) {
-    FrameTracerDataSource::Trace([this, layerId, bufferID, frameNumber, timestamp, type,
-                                  duration](FrameTracerDataSource::TraceContext ctx) {
-        std::lock_guard<std::mutex> lock(mTraceMutex);
-        if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
+    if (isTracing()) {
+        queueEvent({layerId, TimestampEvent{bufferID, frameNumber, timestamp, type, duration}});
+    }
+}
+
+void FrameTracer::traceFence(int32_t layerId, uint64_t bufferID, uint64_t frameNumber,
+                             const std::shared_ptr<FenceTime>& fence,
+                             FrameEvent::BufferEventType type, nsecs_t startTime) {
+    // The fence is only queried on the tracer thread, which can mean a sync_file ioctl.
+    if (isTracing()) {
+        queueEvent({layerId, FenceEvent{bufferID, frameNumber, fence, type, startTime}});
+    }
+}
+
+void FrameTracer::onDestroy(int32_t layerId) {
+    // Queued even when not tracing, so that it is ordered after the layer's other events.
+    queueEvent({layerId, DestroyEvent{}});
+}
+
+void FrameTracer::queueEvent(QueuedEvent&& event) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        mQueue.push_back(std::move(event));
+        // Only the first event of a batch and a full batch need to wake the tracer thread, the
+        // rest are picked up when the frame is committed.
+        wake = mQueue.size() == 1 || mQueue.size() == kMaxBatchSize;
+    }
+    if (wake) {
+        mQueueCondition.notify_all();
+    }
+}
+
+void FrameTracer::commitFrame() {
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        if (mQueue.empty()) {
             return;
         }
+        mFrameCommitted = true;
+    }
+    mQueueCondition.notify_all();
+}
 
-        // Handle any pending fences for this buffer.
-        tracePendingFencesLocked(ctx, layerId, bufferID);
+void FrameTracer::flush() {
+    std::unique_lock<std::mutex> lock(mQueueMutex);
+    uint64_t target = mBatchesTaken;
+    if (!mQueue.empty()) {
+        ++target;
+        mFlushRequested = true;
+        mQueueCondition.notify_all();
+    }
+    mQueueCondition.wait(lock, [&] { return mBatchesTraced >= target; });
+}
 
-        // Complete current trace.
-        traceLocked(ctx, layerId, bufferID, frameNumber, timestamp, type, duration);
-    });
+void FrameTracer::threadMain() {
+    std::vector<QueuedEvent> batch;
+    std::unique_lock<std::mutex> lock(mQueueMutex);
+    while (true) {
+        mQueueCondition.wait(lock, [&] { return mStopped || !mQueue.empty(); });
+        // Give the rest of the frame a chance to be queued before emitting.
+        mQueueCondition.wait_for(lock, kMaxBatchDelay, [&] {
+            return mStopped || mFrameCommitted || mFlushRequested ||
+                    mQueue.size() >= kMaxBatchSize;
+        });
+        mFrameCommitted = false;
+        mFlushRequested = false;
+
+        const bool stopped = mStopped;
+        batch.swap(mQueue);
+        ++mBatchesTaken;
+        lock.unlock();
+
+        traceBatch(batch);
+        // Keep the capacity, so that the queue doesn't need to grow again once swapped back in.
+        batch.clear();
+
+        lock.lock();
+        ++mBatchesTraced;
+        mQueueCondition.notify_all();
+        if (stopped) {
+            break;
+        }
+    }
 }
 
-void FrameTracer::traceFence(int32_t layerId, uint64_t bufferID, uint64_t frameNumber,
-                             const std::shared_ptr<FenceTime>& fence,
-                             FrameEvent::BufferEventType type, nsecs_t startTime) {
-    FrameTracerDataSource::Trace([this, layerId, bufferID, frameNumber, &fence, type,
-                                  startTime](FrameTracerDataSource::TraceContext ctx) {
-        const nsecs_t signalTime = fence->getSignalTime();
-        if (signalTime != Fence::SIGNAL_TIME_INVALID) {
-            std::lock_guard<std::mutex> lock(mTraceMutex);
-            if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
-                return;
-            }
+void FrameTracer::traceBatch(const std::vector<QueuedEvent>& batch) {
+    if (batch.empty()) {
+        return;
+    }
+    ATRACE_NAME("FrameTracer::traceBatch");
+    std::lock_guard<std::mutex> lock(mTraceMutex);
+    bool traced = false;
+    FrameTracerDataSource::Trace([&](FrameTracerDataSource::TraceContext ctx) {
+        traced = true;
+        for (const auto& event : batch) {
+            traceEventLocked(ctx, event);
+        }
+    });
 
-            // Handle any pending fences for this buffer.
-            tracePendingFencesLocked(ctx, layerId, bufferID);
-
-            if (signalTime != Fence::SIGNAL_TIME_PENDING) {
-                traceSpanLocked(ctx, layerId, bufferID, frameNumber, type, startTime, signalTime);
-            } else {
-                mTraceTracker[layerId].pendingFences[bufferID].push_back(
-                        {.frameNumber = frameNumber,
-                         .type = type,
-                         .fence = fence,
-                         .startTime = startTime});
+    // Tracing stopped since the batch was queued, but destroyed layers still need their cleanup.
+    if (!traced) {
+        for (const auto& event : batch) {
+            if (std::holds_alternative<DestroyEvent>(event.event)) {
+                mTraceTracker.erase(event.layerId);
             }
         }
-    });
+    }
+}
+
+void FrameTracer::traceEventLocked(FrameTracerDataSource::TraceContext& ctx,
+                                   const QueuedEvent& queued) {
+    const int32_t layerId = queued.layerId;
+    if (const auto* event = std::get_if<NewLayerEvent>(&queued.event)) {
+        if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
+            mTraceTracker[layerId].layerName = event->layerName;
+        }
+        return;
+    }
+    if (std::holds_alternative<DestroyEvent>(queued.event)) {
+        mTraceTracker.erase(layerId);
+        return;
+    }
+    if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
+        return;
+    }
+
+    if (const auto* event = std::get_if<TimestampEvent>(&queued.event)) {
+        // Handle any pending fences for this buffer.
+        tracePendingFencesLocked(ctx, layerId, event->bufferID);
+
+        // Complete current trace.
+        traceLocked(ctx, layerId, event->bufferID, event->frameNumber, event->timestamp,
+                    event->type, event->duration);
+    } else if (const auto* event = std::get_if<FenceEvent>(&queued.event)) {
+        const nsecs_t signalTime = event->fence->getSignalTime();
+        if (signalTime == Fence::SIGNAL_TIME_INVALID) {
+            return;
+        }
+
+        // Handle any pending fences for this buffer.
+        tracePendingFencesLocked(ctx, layerId, event->bufferID);
+
+        if (signalTime == Fence::SIGNAL_TIME_PENDING) {
+            mTraceTracker[layerId].pendingFences[event->bufferID].push_back(
+                    {.frameNumber = event->frameNumber,
+                     .type = event->type,
+                     .fence = event->fence,
+                     .startTime = event->startTime});
+        } else if (systemTime() - signalTime < kFenceSignallingDeadline) {
+            // The fence may only have been queried well after it was queued, so the same
+            // deadline applies as to the pending ones.
+            traceSpanLocked(ctx, layerId, event->bufferID, event->frameNumber, event->type,
+                            event->startTime, signalTime);
+        }
+    }
 }
 
 void FrameTracer::tracePendingFencesLocked(FrameTracerDataSource::TraceContext& ctx,
@@ -168,12 +304,8 @@ void FrameTracer::traceSpanLocked(FrameTracerDataSource::TraceContext& ctx, int3
     traceLocked(ctx, layerId, bufferID, frameNumber, timestamp, type, duration);
 }
 
-void FrameTracer::onDestroy(int32_t layerId) {
-    std::lock_guard<std::mutex> traceLock(mTraceMutex);
-    mTraceTracker.erase(layerId);
-}
-
 std::string FrameTracer::miniDump() {
+    flush();
     std::string result = "FrameTracer miniDump:\n";
     std::lock_guard<std::mutex> lock(mTraceMutex);
     android::base::StringAppendF(&result, "Number of layers currently being traced is %zu\n",
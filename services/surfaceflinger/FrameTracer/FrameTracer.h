@@ -20,8 +20,15 @@
 #include <perfetto/tracing.h>
 #include <ui/FenceTime.h>
 
+#include <android-base/thread_annotations.h>
+
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <variant>
+#include <vector>
 
 namespace android {
 
@@ -37,7 +44,11 @@ public:
 
     using FrameEvent = perfetto::protos::pbzero::GraphicsFrameEvent;
 
-    ~FrameTracer() = default;
+    FrameTracer();
+    ~FrameTracer();
+
+    FrameTracer(const FrameTracer&) = delete;
+    FrameTracer& operator=(const FrameTracer&) = delete;
 
     // Sets up the perfetto tracing backend and data source.
     void initialize();
@@ -63,6 +74,13 @@ public:
     // Takes care of cleanup when a layer is destroyed.
     void onDestroy(int32_t layerId);
 
+    // The trace calls above only queue their events, which are emitted from the tracer's own
+    // thread. Called by SurfaceFlinger once a frame has been composited, so that the events of a
+    // frame are emitted together rather than as they trickle in.
+    void commitFrame() EXCLUDES(mQueueMutex);
+    // Blocks until every event queued so far has been emitted. Public for testing.
+    void flush() EXCLUDES(mQueueMutex);
+
     std::string miniDump();
 
     static constexpr char kFrameTracerDataSource[] = "android.surfaceflinger.frame";
@@ -86,6 +104,44 @@ private:
         std::unordered_map<BufferID, std::vector<PendingFence>> pendingFences;
     };
 
+    // The queued form of each trace call.
+    struct NewLayerEvent {
+        std::string layerName;
+    };
+    struct TimestampEvent {
+        uint64_t bufferID;
+        uint64_t frameNumber;
+        nsecs_t timestamp;
+        FrameEvent::BufferEventType type;
+        nsecs_t duration;
+    };
+    struct FenceEvent {
+        uint64_t bufferID;
+        uint64_t frameNumber;
+        std::shared_ptr<FenceTime> fence;
+        FrameEvent::BufferEventType type;
+        nsecs_t startTime;
+    };
+    struct DestroyEvent {};
+    struct QueuedEvent {
+        int32_t layerId;
+        std::variant<NewLayerEvent, TimestampEvent, FenceEvent, DestroyEvent> event;
+    };
+
+    // Wakes the tracer thread once this many events are queued even if the frame hasn't been
+    // committed, and bounds how long events queued outside of a frame (e.g. dequeues) wait.
+    static constexpr size_t kMaxBatchSize = 256;
+    static constexpr std::chrono::milliseconds kMaxBatchDelay{100};
+
+    // Whether any frame tracing session is running. Checked before queueing so that nothing is
+    // done on the calling thread while tracing is off.
+    static bool isTracing();
+    void queueEvent(QueuedEvent&& event) EXCLUDES(mQueueMutex);
+    void threadMain() EXCLUDES(mQueueMutex);
+    // Emits a batch of events as a single sequence of trace packets.
+    void traceBatch(const std::vector<QueuedEvent>& batch);
+    void traceEventLocked(FrameTracerDataSource::TraceContext& ctx, const QueuedEvent& event);
+
     // Checks if any pending fences for a layer and buffer have signalled and, if they have, creates
     // trace points for them.
     void tracePendingFencesLocked(FrameTracerDataSource::TraceContext& ctx, int32_t layerId,
@@ -100,9 +156,23 @@ private:
                      uint64_t frameNumber, nsecs_t timestamp, FrameEvent::BufferEventType type,
                      nsecs_t duration = 0);
 
+    // Only held by the tracer thread, and by miniDump().
     std::mutex mTraceMutex;
     std::unordered_map<int32_t, TraceRecord> mTraceTracker;
     std::once_flag mInitializationFlag;
+
+    // Callers only hold this long enough to append an event, the tracer thread swaps the whole
+    // queue out and emits it without holding the lock.
+    std::mutex mQueueMutex;
+    std::condition_variable mQueueCondition;
+    std::vector<QueuedEvent> mQueue GUARDED_BY(mQueueMutex);
+    bool mFrameCommitted GUARDED_BY(mQueueMutex) = false;
+    // Counts the batches taken off the queue and the batches fully emitted, for flush().
+    uint64_t mBatchesTaken GUARDED_BY(mQueueMutex) = 0;
+    uint64_t mBatchesTraced GUARDED_BY(mQueueMutex) = 0;
+    bool mFlushRequested GUARDED_BY(mQueueMutex) = false;
+    bool mStopped GUARDED_BY(mQueueMutex) = false;
+    std::thread mThread;
 };
 
 } // namespace android
@@ -331,6 +331,47 @@ FloatRect Layer::getBounds(const Region& activeTransparentRegion) const {
 
 void Layer::computeBounds(FloatRect parentBounds, ui::Transform parentTransform,
                           float parentShadowRadius) {
+    // Clones copy their state from the layer they mirror on every traversal.
+    const bool boundsDirty = mBoundsDirty || isClone();
+    const bool needsUpdate = boundsDirty || !(parentBounds == mBoundsParentBounds) ||
+            !(parentTransform == mBoundsParentTransform) ||
+            parentShadowRadius != mBoundsParentShadowRadius;
+    if (!needsUpdate && !mChildBoundsDirty) {
+        return;
+    }
+    if (needsUpdate) {
+        updateBounds(parentBounds, parentTransform, parentShadowRadius);
+    }
+
+    // Shadow radius is passed down to only one layer so if the layer can draw shadows,
+    // don't pass it to its children.
+    const float childShadowRadius = canDrawShadows() ? 0.f : mEffectiveShadowRadius;
+
+    for (const sp<Layer>& child : mDrawingChildren) {
+        // Children may depend on more of this layer's state than its bounds.
+        if (boundsDirty) {
+            child->mBoundsDirty = true;
+        }
+        child->computeBounds(mBounds, mEffectiveTransform, childShadowRadius);
+    }
+    mBoundsDirty = false;
+    mChildBoundsDirty = false;
+}
+
+void Layer::invalidateBounds() {
+    mBoundsDirty = true;
+    for (sp<Layer> parent = mDrawingParent.promote(); parent != nullptr;
+         parent = parent->mDrawingParent.promote()) {
+        parent->mChildBoundsDirty = true;
+    }
+}
+
+void Layer::updateBounds(FloatRect parentBounds, const ui::Transform& parentTransform,
+                         float parentShadowRadius) {
+    mBoundsParentBounds = parentBounds;
+    mBoundsParentTransform = parentTransform;
+    mBoundsParentShadowRadius = parentShadowRadius;
+
     const State& s(getDrawingState());
 
     // Calculate effective layer transform
@@ -360,14 +401,6 @@ void Layer::computeBounds(FloatRect parentBounds, ui::Transform parentTransform,
     } else {
         mEffectiveShadowRadius = parentShadowRadius;
     }
-
-    // Shadow radius is passed down to only one layer so if the layer can draw shadows,
-    // don't pass it to its children.
-    const float childShadowRadius = canDrawShadows() ? 0.f : mEffectiveShadowRadius;
-
-    for (const sp<Layer>& child : mDrawingChildren) {
-        child->computeBounds(mBounds, mEffectiveTransform, childShadowRadius);
-    }
 }
 
 Rect Layer::getCroppedBufferSize(const State& s) const {
@@ -712,6 +745,8 @@ bool Layer::isScreenshot() const {
 uint32_t Layer::doTransaction(uint32_t flags) {
     ATRACE_CALL();
 
+    invalidateBounds();
+
     // TODO: This is unfortunate.
     mDrawingStateModified = mDrawingState.modified;
     mDrawingState.modified = false;
@@ -1147,7 +1182,7 @@ StretchEffect Layer::getStretchEffect() const {
     return StretchEffect{};
 }
 
-bool Layer::propagateFrameRateForLayerTree(FrameRate parentFrameRate, bool* transactionNeeded) {
+void Layer::propagateFrameRateForLayerTree(FrameRate parentFrameRate, bool* transactionNeeded) {
     // The frame rate for layer tree is this layer's frame rate if present, or the parent frame rate
     const auto frameRate = [&] {
         if (mDrawingState.frameRate.rate.isValid() ||
@@ -1158,24 +1193,32 @@ bool Layer::propagateFrameRateForLayerTree(FrameRate parentFrameRate, bool* tran
         return parentFrameRate;
     }();
 
-    *transactionNeeded |= setFrameRateForLayerTree(frameRate);
-
-    // The frame rate is propagated to the children
-    bool childrenHaveFrameRate = false;
-    for (const sp<Layer>& child : mCurrentChildren) {
-        childrenHaveFrameRate |=
-                child->propagateFrameRateForLayerTree(frameRate, transactionNeeded);
+    // The frame rate is propagated to the children. Subtrees that already have it are up to date.
+    if (frameRate != mFrameRateForChildren) {
+        mFrameRateForChildren = frameRate;
+        for (const sp<Layer>& child : mCurrentChildren) {
+            child->propagateFrameRateForLayerTree(frameRate, transactionNeeded);
+        }
     }
 
+    updateFrameRateForLayerTree(transactionNeeded);
+}
+
+void Layer::updateFrameRateForLayerTree(bool* transactionNeeded) {
+    const auto& frameRate = mFrameRateForChildren;
+    const bool childrenHaveFrameRate = mChildrenWithFrameRateVote > 0;
+
     // If we don't have a valid frame rate, but the children do, we set this
     // layer as NoVote to allow the children to control the refresh rate
     if (!frameRate.rate.isValid() && frameRate.type != FrameRateCompatibility::NoVote &&
         childrenHaveFrameRate) {
         *transactionNeeded |=
                 setFrameRateForLayerTree(FrameRate(Fps(0.0f), FrameRateCompatibility::NoVote));
+    } else {
+        *transactionNeeded |= setFrameRateForLayerTree(frameRate);
     }
 
-    // We return whether this layer ot its children has a vote. We ignore ExactOrMultiple votes for
+    // Whether this layer or its children has a vote. We ignore ExactOrMultiple votes for
     // the same reason we are allowing touch boost for those layers. See
     // RefreshRateConfigs::getBestRefreshRate for more details.
     const auto layerVotedWithDefaultCompatibility =
@@ -1183,21 +1226,31 @@ bool Layer::propagateFrameRateForLayerTree(FrameRate parentFrameRate, bool* tran
     const auto layerVotedWithNoVote = frameRate.type == FrameRateCompatibility::NoVote;
     const auto layerVotedWithExactCompatibility =
             frameRate.rate.isValid() && frameRate.type == FrameRateCompatibility::Exact;
-    return layerVotedWithDefaultCompatibility || layerVotedWithNoVote ||
-            layerVotedWithExactCompatibility || childrenHaveFrameRate;
+    const bool treeHasFrameRateVote = layerVotedWithDefaultCompatibility ||
+            layerVotedWithNoVote || layerVotedWithExactCompatibility || childrenHaveFrameRate;
+    if (treeHasFrameRateVote == mTreeHasFrameRateVote) {
+        return;
+    }
+
+    // Only the ancestors' counts depend on this, so the change is propagated up to the first
+    // ancestor whose tree vote does not change.
+    mTreeHasFrameRateVote = treeHasFrameRateVote;
+    if (const auto parent = getParent()) {
+        if (treeHasFrameRateVote) {
+            parent->mChildrenWithFrameRateVote++;
+        } else {
+            parent->mChildrenWithFrameRateVote--;
+        }
+        parent->updateFrameRateForLayerTree(transactionNeeded);
+    }
 }
 
 void Layer::updateTreeHasFrameRateVote() {
-    const auto root = [&]() -> sp<Layer> {
-        sp<Layer> layer = this;
-        while (auto parent = layer->getParent()) {
-            layer = parent;
-        }
-        return layer;
-    }();
+    const auto parent = getParent();
+    const auto parentFrameRate = parent ? parent->mFrameRateForChildren : FrameRate();
 
     bool transactionNeeded = false;
-    root->propagateFrameRateForLayerTree({}, &transactionNeeded);
+    propagateFrameRateForLayerTree(parentFrameRate, &transactionNeeded);
 
     // TODO(b/195668952): we probably don't need eTraversalNeeded here
     if (transactionNeeded) {
@@ -1586,6 +1639,16 @@ void Layer::addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
     }
 }
 
+status_t Layer::getFrameTimestampRing(base::unique_fd* outFd) {
+    Mutex::Autolock lock(mFrameEventHistoryMutex);
+    std::shared_ptr<FrameTimestampRing> ring = mFrameEventHistory.getTimestampRing();
+    if (ring == nullptr) {
+        return NO_MEMORY;
+    }
+    *outFd = ring->getFd();
+    return outFd->ok() ? NO_ERROR : NO_MEMORY;
+}
+
 size_t Layer::getChildrenCount() const {
     size_t count = 0;
     for (const sp<Layer>& child : mCurrentChildren) {
@@ -1613,6 +1676,10 @@ void Layer::addChild(const sp<Layer>& layer) {
     mCurrentChildren.add(layer);
     layer->setParent(this);
     layer->setGameModeForTree(mGameMode);
+    if (layer->mTreeHasFrameRateVote) {
+        mChildrenWithFrameRateVote++;
+    }
+    layer->updateTreeHasFrameRateVote();
     updateTreeHasFrameRateVote();
 }
 
@@ -1622,6 +1689,9 @@ ssize_t Layer::removeChild(const sp<Layer>& layer) {
 
     layer->setParent(nullptr);
     const auto removeResult = mCurrentChildren.remove(layer);
+    if (removeResult >= 0 && layer->mTreeHasFrameRateVote) {
+        mChildrenWithFrameRateVote--;
+    }
 
     updateTreeHasFrameRateVote();
     layer->setGameModeForTree(0);
@@ -2043,14 +2113,38 @@ void Layer::setInputInfo(const InputWindowInfo& info) {
 LayerProto* Layer::writeToProto(LayersProto& layersProto, uint32_t traceFlags,
                                 const DisplayDevice* display) {
     LayerProto* layerProto = layersProto.add_layers();
-    writeToProtoDrawingState(layerProto, traceFlags, display);
-    writeToProtoCommonState(layerProto, LayerVector::StateSet::Drawing, traceFlags);
-
-    if (traceFlags & SurfaceTracing::TRACE_COMPOSITION) {
-        // Only populate for the primary display.
-        if (display) {
-            const Hwc2::IComposerClient::Composition compositionType = getCompositionType(*display);
-            layerProto->set_hwc_composition_type(static_cast<HwcCompositionType>(compositionType));
+
+    const bool writeCompositionType = (traceFlags & SurfaceTracing::TRACE_COMPOSITION) && display;
+    // Whatever the proto derives from the layer hierarchy and from composition, the geometry
+    // generation covers.
+    const ProtoCacheKey key{.traceFlags = traceFlags,
+                            .display = display,
+                            .geometryGeneration = mFlinger->mGeometryGeneration,
+                            .sequence = mDrawingState.sequence,
+                            .frameNumber = mCurrentFrameNumber,
+                            .queuedFrames = getQueuedFrameCount(),
+                            .contentDirty = contentDirty,
+                            .bufferLatched = isBufferLatched(),
+                            .compositionType = writeCompositionType
+                                    ? getCompositionType(*display)
+                                    : Hwc2::IComposerClient::Composition::INVALID};
+
+    {
+        std::lock_guard lock(mProtoCacheMutex);
+        if (mProtoCacheKey == key) {
+            *layerProto = mProtoCache;
+        } else {
+            writeToProtoDrawingState(layerProto, traceFlags, display);
+            writeToProtoCommonState(layerProto, LayerVector::StateSet::Drawing, traceFlags);
+
+            // Only populate for the primary display.
+            if (writeCompositionType) {
+                layerProto->set_hwc_composition_type(
+                        static_cast<HwcCompositionType>(key.compositionType));
+            }
+
+            mProtoCache = *layerProto;
+            mProtoCacheKey = key;
         }
     }
 
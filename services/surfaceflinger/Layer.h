@@ -41,6 +41,7 @@
 #include <chrono>
 #include <cstdint>
 #include <list>
+#include <mutex>
 #include <optional>
 #include <vector>
 
@@ -596,6 +597,10 @@ public:
         return {};
     }
 
+    // Dumps the state of the BufferQueue this layer consumes from, if any, including its
+    // occupancy and latency histograms.
+    virtual void dumpBufferQueue(std::string& /*result*/) const {}
+
     virtual bool getTransformToDisplayInverse() const { return false; }
 
     // Returns how rounded corners should be drawn for this layer.
@@ -649,9 +654,15 @@ public:
     FloatRect getBounds(const Region& activeTransparentRegion) const;
     FloatRect getBounds() const;
 
-    // Compute bounds for the layer and cache the results.
+    // Compute bounds for the layer and cache the results. Layers whose state
+    // and parent bounds haven't changed since the last call keep their bounds,
+    // and subtrees without any such change aren't visited.
     void computeBounds(FloatRect parentBounds, ui::Transform parentTransform, float shadowRadius);
 
+    // Makes the next computeBounds() recompute this layer and its children,
+    // after a change computeBounds() can't see in its arguments.
+    void invalidateBounds();
+
     int32_t getSequence() const override { return sequence; }
 
     // For tracing.
@@ -749,6 +760,7 @@ public:
     void onDisconnect();
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newEntry,
                                   FrameEventHistoryDelta* outDelta);
+    status_t getFrameTimestampRing(base::unique_fd* outFd);
 
     ui::Transform getTransform() const;
 
@@ -1042,6 +1054,10 @@ private:
 
     Hwc2::IComposerClient::Composition getCompositionType(const DisplayDevice&) const;
 
+    // Computes the bounds of this layer alone, see computeBounds().
+    void updateBounds(FloatRect parentBounds, const ui::Transform& parentTransform,
+                      float parentShadowRadius);
+
     /**
      * Returns an unsorted vector of all layers that are part of this tree.
      * That includes the current layer and all its descendants.
@@ -1057,7 +1073,8 @@ private:
                                           const std::vector<Layer*>& layersInTree);
 
     void updateTreeHasFrameRateVote();
-    bool propagateFrameRateForLayerTree(FrameRate parentFrameRate, bool* transactionNeeded);
+    void propagateFrameRateForLayerTree(FrameRate parentFrameRate, bool* transactionNeeded);
+    void updateFrameRateForLayerTree(bool* transactionNeeded);
     bool setFrameRateForLayerTree(FrameRate);
     void setZOrderRelativeOf(const wp<Layer>& relativeOf);
     bool isTrustedOverlay() const;
@@ -1093,6 +1110,15 @@ private:
     // Layer bounds in screen space.
     FloatRect mScreenBounds;
 
+    // Set by invalidateBounds() on the layer, and on its ancestors so that
+    // computeBounds() gets down to it.
+    bool mBoundsDirty = true;
+    bool mChildBoundsDirty = true;
+    // The arguments the bounds above were computed from.
+    FloatRect mBoundsParentBounds;
+    ui::Transform mBoundsParentTransform;
+    float mBoundsParentShadowRadius = 0.f;
+
     bool mGetHandleCalled = false;
 
     // Tracks the process and user id of the caller when creating this layer
@@ -1115,12 +1141,48 @@ private:
     // metrics(SurfaceFlingerStats).
     int32_t mGameMode = 0;
 
+    // The frame rate this layer passes to its children: its own vote, or the one it inherited.
+    FrameRate mFrameRateForChildren;
+    // The number of children whose tree has a frame rate vote, and whether this layer's tree has
+    // one. Kept up to date by updateFrameRateForLayerTree() so that a vote change only walks the
+    // layers it affects instead of the whole hierarchy.
+    size_t mChildrenWithFrameRateVote = 0;
+    bool mTreeHasFrameRateVote = false;
+
     mutable int32_t mPriority = Layer::PRIORITY_UNSET;
 
     // A list of regions on this layer that should have blurs.
     const std::vector<BlurRegion> getBlurRegions() const;
 
     bool mIsAtRoot = false;
+
+    // What writeToProto() wrote mProtoCache from. While none of it changes, the layer's proto is
+    // copied from the cache instead of being written anew.
+    struct ProtoCacheKey {
+        uint32_t traceFlags;
+        const DisplayDevice* display;
+        uint64_t geometryGeneration;
+        int32_t sequence;
+        uint64_t frameNumber;
+        int queuedFrames;
+        bool contentDirty;
+        bool bufferLatched;
+        Hwc2::IComposerClient::Composition compositionType;
+
+        bool operator==(const ProtoCacheKey& other) const {
+            return traceFlags == other.traceFlags && display == other.display &&
+                    geometryGeneration == other.geometryGeneration &&
+                    sequence == other.sequence && frameNumber == other.frameNumber &&
+                    queuedFrames == other.queuedFrames && contentDirty == other.contentDirty &&
+                    bufferLatched == other.bufferLatched &&
+                    compositionType == other.compositionType;
+        }
+    };
+
+    // Both the main thread and the tracing thread write protos.
+    std::mutex mProtoCacheMutex;
+    std::optional<ProtoCacheKey> mProtoCacheKey;
+    LayerProto mProtoCache;
 public:
     nsecs_t getPreviousGfxInfo();
 };
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LayerWorkerPool"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "LayerWorkerPool.h"
+
+#include <log/log.h>
+#include <utils/Trace.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+namespace android {
+
+LayerWorkerPool::LayerWorkerPool(size_t threadCount) {
+    const int policy = sched_getscheduler(0);
+    struct sched_param param = {0};
+    sched_getparam(0, &param);
+
+    mThreads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        mThreads.emplace_back(&LayerWorkerPool::threadMain, this, policy, param.sched_priority);
+        pthread_setname_np(mThreads.back().native_handle(), "LayerWorker");
+    }
+}
+
+LayerWorkerPool::~LayerWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+    }
+    mWorkCondition.notify_all();
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void LayerWorkerPool::run(size_t count, const std::function<void(size_t)>& work) {
+    ATRACE_CALL();
+    if (count <= 1 || mThreads.empty()) {
+        for (size_t i = 0; i < count; i++) {
+            work(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mNextIndex = 0;
+        mWork = &work;
+        mCount = count;
+        mBusyWorkers = mThreads.size();
+        mGeneration++;
+    }
+    mWorkCondition.notify_all();
+
+    runBatch(work, count);
+
+    waitForWorkers();
+}
+
+// NO_THREAD_SAFETY_ANALYSIS is because std::unique_lock presently lacks thread safety annotations.
+void LayerWorkerPool::waitForWorkers() NO_THREAD_SAFETY_ANALYSIS {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCondition.wait(lock, [this] { return mBusyWorkers == 0; });
+    mWork = nullptr;
+}
+
+void LayerWorkerPool::runBatch(const std::function<void(size_t)>& work, size_t count) {
+    for (size_t i = mNextIndex++; i < count; i = mNextIndex++) {
+        work(i);
+    }
+}
+
+// NO_THREAD_SAFETY_ANALYSIS is because std::unique_lock presently lacks thread safety annotations.
+void LayerWorkerPool::threadMain(int policy, int priority) NO_THREAD_SAFETY_ANALYSIS {
+    struct sched_param param = {0};
+    param.sched_priority = priority;
+    if (sched_setscheduler(0, policy, &param) != 0) {
+        ALOGW("Couldn't set the scheduling policy of a layer worker: %s", strerror(errno));
+    }
+
+    uint64_t generation = 0;
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mWorkCondition.wait(lock, [&] { return mStopped || mGeneration != generation; });
+        if (mStopped) {
+            return;
+        }
+        generation = mGeneration;
+        const auto* work = mWork;
+        const size_t count = mCount;
+        lock.unlock();
+
+        runBatch(*work, count);
+
+        lock.lock();
+        if (--mBusyWorkers == 0) {
+            mDoneCondition.notify_one();
+        }
+    }
+}
+
+} // namespace android
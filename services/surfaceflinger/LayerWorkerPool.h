@@ -0,0 +1,70 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+
+// A few threads the main thread can spread work on independent layer subtrees
+// across. The workers run with the scheduling policy of the thread that
+// created the pool, so that they don't hold up a SCHED_FIFO main thread.
+class LayerWorkerPool {
+public:
+    explicit LayerWorkerPool(size_t threadCount);
+    ~LayerWorkerPool();
+
+    LayerWorkerPool(const LayerWorkerPool&) = delete;
+    LayerWorkerPool& operator=(const LayerWorkerPool&) = delete;
+
+    // Calls work(i) for every i in [0, count) on the workers and the calling
+    // thread, and returns once all of the calls have returned. Which thread an
+    // index runs on is not specified, so work must only touch state owned by
+    // that index.
+    void run(size_t count, const std::function<void(size_t)>& work) EXCLUDES(mMutex);
+
+    size_t getThreadCount() const { return mThreads.size(); }
+
+private:
+    void threadMain(int policy, int priority) EXCLUDES(mMutex);
+    void waitForWorkers() EXCLUDES(mMutex);
+    // Runs indices of the current batch until there are none left.
+    void runBatch(const std::function<void(size_t)>& work, size_t count);
+
+    std::mutex mMutex;
+    std::condition_variable mWorkCondition;
+    std::condition_variable mDoneCondition;
+    bool mStopped GUARDED_BY(mMutex) = false;
+    // Incremented each time run() hands out a batch.
+    uint64_t mGeneration GUARDED_BY(mMutex) = 0;
+    const std::function<void(size_t)>* mWork GUARDED_BY(mMutex) = nullptr;
+    size_t mCount GUARDED_BY(mMutex) = 0;
+    // Workers still running the current batch.
+    size_t mBusyWorkers GUARDED_BY(mMutex) = 0;
+
+    std::atomic<size_t> mNextIndex = 0;
+    std::vector<std::thread> mThreads;
+};
+
+} // namespace android
@@ -149,6 +149,10 @@ void MonitoredProducer::getFrameTimestamps(FrameEventHistoryDelta* outDelta) {
     mProducer->getFrameTimestamps(outDelta);
 }
 
+status_t MonitoredProducer::getFrameTimestampRing(base::unique_fd* outFd) {
+    return mProducer->getFrameTimestampRing(outFd);
+}
+
 status_t MonitoredProducer::getUniqueId(uint64_t* outId) const {
     return mProducer->getUniqueId(outId);
 }
@@ -54,33 +54,32 @@ void RefreshRateOverlay::SevenSegmentDrawer::drawRect(const Rect& r, const half4
     }
 }
 
+Rect RefreshRateOverlay::SevenSegmentDrawer::getSegmentRect(Segment segment, int left) {
+    switch (segment) {
+        case Segment::Upper:
+            return Rect(left, 0, left + DIGIT_WIDTH, DIGIT_SPACE);
+        case Segment::UpperLeft:
+            return Rect(left, 0, left + DIGIT_SPACE, DIGIT_HEIGHT / 2);
+        case Segment::UpperRight:
+            return Rect(left + DIGIT_WIDTH - DIGIT_SPACE, 0, left + DIGIT_WIDTH, DIGIT_HEIGHT / 2);
+        case Segment::Middle:
+            return Rect(left, DIGIT_HEIGHT / 2 - DIGIT_SPACE / 2, left + DIGIT_WIDTH,
+                        DIGIT_HEIGHT / 2 + DIGIT_SPACE / 2);
+        case Segment::LowerLeft:
+            return Rect(left, DIGIT_HEIGHT / 2, left + DIGIT_SPACE, DIGIT_HEIGHT);
+        case Segment::LowerRight:
+            return Rect(left + DIGIT_WIDTH - DIGIT_SPACE, DIGIT_HEIGHT / 2, left + DIGIT_WIDTH,
+                        DIGIT_HEIGHT);
+        case Segment::Buttom:
+            return Rect(left, DIGIT_HEIGHT - DIGIT_SPACE, left + DIGIT_WIDTH, DIGIT_HEIGHT);
+    }
+}
+
 void RefreshRateOverlay::SevenSegmentDrawer::drawSegment(Segment segment, int left,
                                                          const half4& color,
                                                          const sp<GraphicBuffer>& buffer,
                                                          uint8_t* pixels) {
-    const Rect rect = [&]() {
-        switch (segment) {
-            case Segment::Upper:
-                return Rect(left, 0, left + DIGIT_WIDTH, DIGIT_SPACE);
-            case Segment::UpperLeft:
-                return Rect(left, 0, left + DIGIT_SPACE, DIGIT_HEIGHT / 2);
-            case Segment::UpperRight:
-                return Rect(left + DIGIT_WIDTH - DIGIT_SPACE, 0, left + DIGIT_WIDTH,
-                            DIGIT_HEIGHT / 2);
-            case Segment::Middle:
-                return Rect(left, DIGIT_HEIGHT / 2 - DIGIT_SPACE / 2, left + DIGIT_WIDTH,
-                            DIGIT_HEIGHT / 2 + DIGIT_SPACE / 2);
-            case Segment::LowerLeft:
-                return Rect(left, DIGIT_HEIGHT / 2, left + DIGIT_SPACE, DIGIT_HEIGHT);
-            case Segment::LowerRight:
-                return Rect(left + DIGIT_WIDTH - DIGIT_SPACE, DIGIT_HEIGHT / 2, left + DIGIT_WIDTH,
-                            DIGIT_HEIGHT);
-            case Segment::Buttom:
-                return Rect(left, DIGIT_HEIGHT - DIGIT_SPACE, left + DIGIT_WIDTH, DIGIT_HEIGHT);
-        }
-    }();
-
-    drawRect(rect, color, buffer, pixels);
+    drawRect(getSegmentRect(segment, left), color, buffer, pixels);
 }
 
 void RefreshRateOverlay::SevenSegmentDrawer::drawDigit(int digit, int left, const half4& color,
@@ -109,75 +108,66 @@ void RefreshRateOverlay::SevenSegmentDrawer::drawDigit(int digit, int left, cons
         drawSegment(Segment::Buttom, left, color, buffer, pixels);
 }
 
-std::vector<sp<GraphicBuffer>> RefreshRateOverlay::SevenSegmentDrawer::drawNumber(
-        int number, const half4& color, bool showSpinner) {
-    if (number < 0 || number > 1000) return {};
+sp<GraphicBuffer> RefreshRateOverlay::SevenSegmentDrawer::drawNumber(int number,
+                                                                    const half4& color) {
+    if (number < 0 || number > 1000) return nullptr;
 
     const auto hundreds = number / 100;
     const auto tens = (number / 10) % 10;
     const auto ones = number % 10;
 
-    std::vector<sp<GraphicBuffer>> buffers;
-    const auto loopCount = showSpinner ? 6 : 1;
-    for (int i = 0; i < loopCount; i++) {
-        sp<GraphicBuffer> buffer =
-                new GraphicBuffer(BUFFER_WIDTH, BUFFER_HEIGHT, HAL_PIXEL_FORMAT_RGBA_8888, 1,
-                                  GRALLOC_USAGE_SW_WRITE_RARELY | GRALLOC_USAGE_HW_COMPOSER |
-                                          GRALLOC_USAGE_HW_TEXTURE,
-                                  "RefreshRateOverlayBuffer");
-        const status_t bufferStatus = buffer->initCheck();
-        LOG_ALWAYS_FATAL_IF(bufferStatus != OK, "RefreshRateOverlay: Buffer failed to allocate: %d",
-                            bufferStatus);
-        uint8_t* pixels;
-        buffer->lock(GRALLOC_USAGE_SW_WRITE_RARELY, reinterpret_cast<void**>(&pixels));
-        // Clear buffer content
-        drawRect(Rect(BUFFER_WIDTH, BUFFER_HEIGHT), half4(0), buffer, pixels);
-        int left = 0;
-        if (hundreds != 0) {
-            drawDigit(hundreds, left, color, buffer, pixels);
-        }
-        left += DIGIT_WIDTH + DIGIT_SPACE;
+    sp<GraphicBuffer> buffer =
+            new GraphicBuffer(BUFFER_WIDTH, BUFFER_HEIGHT, HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                              GRALLOC_USAGE_SW_WRITE_RARELY | GRALLOC_USAGE_HW_COMPOSER |
+                                      GRALLOC_USAGE_HW_TEXTURE,
+                              "RefreshRateOverlayBuffer");
+    const status_t bufferStatus = buffer->initCheck();
+    LOG_ALWAYS_FATAL_IF(bufferStatus != OK, "RefreshRateOverlay: Buffer failed to allocate: %d",
+                        bufferStatus);
+    uint8_t* pixels;
+    buffer->lock(GRALLOC_USAGE_SW_WRITE_RARELY, reinterpret_cast<void**>(&pixels));
+    // Clear buffer content
+    drawRect(Rect(BUFFER_WIDTH, BUFFER_HEIGHT), half4(0), buffer, pixels);
+    int left = 0;
+    if (hundreds != 0) {
+        drawDigit(hundreds, left, color, buffer, pixels);
+    }
+    left += DIGIT_WIDTH + DIGIT_SPACE;
 
-        if (tens != 0) {
-            drawDigit(tens, left, color, buffer, pixels);
-        }
-        left += DIGIT_WIDTH + DIGIT_SPACE;
-
-        drawDigit(ones, left, color, buffer, pixels);
-        left += DIGIT_WIDTH + DIGIT_SPACE;
-
-        if (showSpinner) {
-            switch (i) {
-                case 0:
-                    drawSegment(Segment::Upper, left, color, buffer, pixels);
-                    break;
-                case 1:
-                    drawSegment(Segment::UpperRight, left, color, buffer, pixels);
-                    break;
-                case 2:
-                    drawSegment(Segment::LowerRight, left, color, buffer, pixels);
-                    break;
-                case 3:
-                    drawSegment(Segment::Buttom, left, color, buffer, pixels);
-                    break;
-                case 4:
-                    drawSegment(Segment::LowerLeft, left, color, buffer, pixels);
-                    break;
-                case 5:
-                    drawSegment(Segment::UpperLeft, left, color, buffer, pixels);
-                    break;
-            }
-        }
+    if (tens != 0) {
+        drawDigit(tens, left, color, buffer, pixels);
+    }
+    left += DIGIT_WIDTH + DIGIT_SPACE;
+
+    drawDigit(ones, left, color, buffer, pixels);
+
+    buffer->unlock();
+    return buffer;
+}
 
-        buffer->unlock();
-        buffers.emplace_back(buffer);
+Rect RefreshRateOverlay::SevenSegmentDrawer::getSpinnerRect(int frame) {
+    const int left = 3 * (DIGIT_WIDTH + DIGIT_SPACE);
+    switch (frame % SPINNER_FRAME_COUNT) {
+        case 0:
+            return getSegmentRect(Segment::Upper, left);
+        case 1:
+            return getSegmentRect(Segment::UpperRight, left);
+        case 2:
+            return getSegmentRect(Segment::LowerRight, left);
+        case 3:
+            return getSegmentRect(Segment::Buttom, left);
+        case 4:
+            return getSegmentRect(Segment::LowerLeft, left);
+        default:
+            return getSegmentRect(Segment::UpperLeft, left);
     }
-    return buffers;
 }
 
 RefreshRateOverlay::RefreshRateOverlay(SurfaceFlinger& flinger, bool showSpinner)
       : mFlinger(flinger), mClient(new Client(&mFlinger)), mShowSpinner(showSpinner) {
-    createLayer();
+    if (createLayer() && mShowSpinner) {
+        createSpinnerLayer();
+    }
     reset();
 }
 
@@ -209,32 +199,52 @@ bool RefreshRateOverlay::createLayer() {
     return true;
 }
 
-const std::vector<std::shared_ptr<renderengine::ExternalTexture>>&
-RefreshRateOverlay::getOrCreateBuffers(uint32_t fps) {
+bool RefreshRateOverlay::createSpinnerLayer() {
+    int32_t layerId;
+    sp<IGraphicBufferProducer> gbp;
+    const status_t ret =
+            mFlinger.createLayer(String8("RefreshRateOverlaySpinner"), mClient, 0, 0,
+                                 PIXEL_FORMAT_RGBA_8888, ISurfaceComposerClient::eFXSurfaceEffect,
+                                 LayerMetadata(), &mSpinnerIBinder, &gbp, mIBinder, &layerId);
+    if (ret) {
+        ALOGE("failed to create spinner effect layer");
+        return false;
+    }
+
+    Mutex::Autolock _l(mFlinger.mStateLock);
+    mSpinnerLayer = mClient->getLayerUser(mSpinnerIBinder);
+    mSpinnerLayer->setFrameRate(Layer::FrameRate(Fps(0.0f), Layer::FrameRateCompatibility::NoVote));
+    mSpinnerLayer->setCrop(SevenSegmentDrawer::getSpinnerRect(mFrame));
+
+    return true;
+}
+
+half4 RefreshRateOverlay::getColor(uint32_t fps) const {
+    // Ensure the range is > 0, so we don't divide by 0.
+    const auto rangeLength = std::max(1u, mHighFps - mLowFps);
+    // Clip values outside the range [mLowFps, mHighFps]. The current fps may be outside
+    // of this range if the display has changed its set of supported refresh rates.
+    fps = std::max(fps, mLowFps);
+    fps = std::min(fps, mHighFps);
+    const auto fpsScale = static_cast<float>(fps - mLowFps) / rangeLength;
+    half4 color;
+    color.r = HIGH_FPS_COLOR.r * fpsScale + LOW_FPS_COLOR.r * (1 - fpsScale);
+    color.g = HIGH_FPS_COLOR.g * fpsScale + LOW_FPS_COLOR.g * (1 - fpsScale);
+    color.b = HIGH_FPS_COLOR.b * fpsScale + LOW_FPS_COLOR.b * (1 - fpsScale);
+    color.a = ALPHA;
+    return color;
+}
+
+const std::shared_ptr<renderengine::ExternalTexture>& RefreshRateOverlay::getOrCreateBuffer(
+        uint32_t fps) {
     if (mBufferCache.find(fps) == mBufferCache.end()) {
-        // Ensure the range is > 0, so we don't divide by 0.
-        const auto rangeLength = std::max(1u, mHighFps - mLowFps);
-        // Clip values outside the range [mLowFps, mHighFps]. The current fps may be outside
-        // of this range if the display has changed its set of supported refresh rates.
-        fps = std::max(fps, mLowFps);
-        fps = std::min(fps, mHighFps);
-        const auto fpsScale = static_cast<float>(fps - mLowFps) / rangeLength;
-        half4 color;
-        color.r = HIGH_FPS_COLOR.r * fpsScale + LOW_FPS_COLOR.r * (1 - fpsScale);
-        color.g = HIGH_FPS_COLOR.g * fpsScale + LOW_FPS_COLOR.g * (1 - fpsScale);
-        color.b = HIGH_FPS_COLOR.b * fpsScale + LOW_FPS_COLOR.b * (1 - fpsScale);
-        color.a = ALPHA;
-        auto buffers = SevenSegmentDrawer::drawNumber(fps, color, mShowSpinner);
-        std::vector<std::shared_ptr<renderengine::ExternalTexture>> textures;
-        std::transform(buffers.begin(), buffers.end(), std::back_inserter(textures),
-                       [&](const auto& buffer) -> std::shared_ptr<renderengine::ExternalTexture> {
-                           return std::make_shared<
-                                   renderengine::ExternalTexture>(buffer,
-                                                                  mFlinger.getRenderEngine(),
-                                                                  renderengine::ExternalTexture::
-                                                                          Usage::READABLE);
-                       });
-        mBufferCache.emplace(fps, textures);
+        auto buffer = SevenSegmentDrawer::drawNumber(fps, getColor(fps));
+        mBufferCache.emplace(fps,
+                             std::make_shared<
+                                     renderengine::ExternalTexture>(buffer,
+                                                                    mFlinger.getRenderEngine(),
+                                                                    renderengine::ExternalTexture::
+                                                                            Usage::READABLE));
     }
 
     return mBufferCache[fps];
@@ -255,26 +265,29 @@ void RefreshRateOverlay::setViewport(ui::Size viewport) {
 }
 
 void RefreshRateOverlay::changeRefreshRate(const Fps& fps) {
+    // The buffer of an unchanged refresh rate is on screen already, unless reset() dropped it.
+    if (mCurrentFps == fps.getIntValue() && mBufferCache.count(*mCurrentFps)) return;
+
     mCurrentFps = fps.getIntValue();
-    auto buffer = getOrCreateBuffers(*mCurrentFps)[mFrame];
+    auto buffer = getOrCreateBuffer(*mCurrentFps);
     mLayer->setBuffer(buffer, Fence::NO_FENCE, 0, 0, true, {},
                       mLayer->getHeadFrameNumber(-1 /* expectedPresentTime */),
                       std::nullopt /* dequeueTime */, FrameTimelineInfo{},
                       nullptr /* releaseBufferListener */);
+    if (mSpinnerLayer) {
+        const half4 color = getColor(*mCurrentFps);
+        mSpinnerLayer->setColor(color.rgb);
+        mSpinnerLayer->setAlpha(color.a);
+    }
 
     mFlinger.mTransactionFlags.fetch_or(eTransactionMask);
 }
 
 void RefreshRateOverlay::onInvalidate() {
-    if (!mCurrentFps.has_value()) return;
+    if (!mCurrentFps.has_value() || !mSpinnerLayer) return;
 
-    const auto& buffers = getOrCreateBuffers(*mCurrentFps);
-    mFrame = (mFrame + 1) % buffers.size();
-    auto buffer = buffers[mFrame];
-    mLayer->setBuffer(buffer, Fence::NO_FENCE, 0, 0, true, {},
-                      mLayer->getHeadFrameNumber(-1 /* expectedPresentTime */),
-                      std::nullopt /* dequeueTime */, FrameTimelineInfo{},
-                      nullptr /* releaseBufferListener */);
+    mFrame = (mFrame + 1) % SevenSegmentDrawer::SPINNER_FRAME_COUNT;
+    mSpinnerLayer->setCrop(SevenSegmentDrawer::getSpinnerRect(mFrame));
 
     mFlinger.mTransactionFlags.fetch_or(eTransactionMask);
 }
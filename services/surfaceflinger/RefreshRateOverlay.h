@@ -47,14 +47,18 @@ public:
 private:
     class SevenSegmentDrawer {
     public:
-        static std::vector<sp<GraphicBuffer>> drawNumber(int number, const half4& color,
-                                                         bool showSpinner);
+        static sp<GraphicBuffer> drawNumber(int number, const half4& color);
         static uint32_t getHeight() { return BUFFER_HEIGHT; }
         static uint32_t getWidth() { return BUFFER_WIDTH; }
 
+        static constexpr int SPINNER_FRAME_COUNT = 6;
+        // The segment of the spinner lit in the given frame of its animation.
+        static Rect getSpinnerRect(int frame);
+
     private:
         enum class Segment { Upper, UpperLeft, UpperRight, Middle, LowerLeft, LowerRight, Buttom };
 
+        static Rect getSegmentRect(Segment segment, int left);
         static void drawRect(const Rect& r, const half4& color, const sp<GraphicBuffer>& buffer,
                              uint8_t* pixels);
         static void drawSegment(Segment segment, int left, const half4& color,
@@ -71,17 +75,21 @@ private:
     };
 
     bool createLayer();
-    const std::vector<std::shared_ptr<renderengine::ExternalTexture>>& getOrCreateBuffers(
-            uint32_t fps);
+    bool createSpinnerLayer();
+    half4 getColor(uint32_t fps) const;
+    const std::shared_ptr<renderengine::ExternalTexture>& getOrCreateBuffer(uint32_t fps);
 
     SurfaceFlinger& mFlinger;
     const sp<Client> mClient;
     sp<Layer> mLayer;
     sp<IBinder> mIBinder;
     sp<IGraphicBufferProducer> mGbp;
+    // Solid color child of mLayer drawing the lit segment of the spinner, so that animating it
+    // only moves a color layer instead of swapping the buffer of mLayer every frame.
+    sp<Layer> mSpinnerLayer;
+    sp<IBinder> mSpinnerIBinder;
 
-    std::unordered_map<int, std::vector<std::shared_ptr<renderengine::ExternalTexture>>>
-            mBufferCache;
+    std::unordered_map<int, std::shared_ptr<renderengine::ExternalTexture>> mBufferCache;
     std::optional<int> mCurrentFps;
     int mFrame = 0;
     static constexpr float ALPHA = 0.8f;
@@ -64,6 +64,9 @@ constexpr auto defaultRegionSamplingWorkDuration = 3ms;
 constexpr auto defaultRegionSamplingPeriod = 100ms;
 constexpr auto defaultRegionSamplingTimerTimeout = 100ms;
 constexpr auto maxRegionSamplingDelay = 100ms;
+// The sampled region is rendered this many times smaller in each dimension, so the GPU filters
+// it down while compositing and the CPU only averages 1/16th of the pixels.
+constexpr int32_t kSampleDownscale = 4;
 // TODO: (b/127403193) duration to string conversion could probably be constexpr
 template <typename Rep, typename Per>
 inline std::string toNsString(std::chrono::duration<Rep, Per> t) {
@@ -236,6 +239,17 @@ float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t st
     return accumulatedLuma / (255.0f * pixelCount);
 }
 
+Rect scaleSampleArea(const Rect& area, int32_t downscale) {
+    if (downscale <= 1 || !area.isValid()) return area;
+    // Round outwards, so that areas smaller than the downscale factor still cover a pixel.
+    const auto floorDiv = [downscale](int32_t v) {
+        return v >= 0 ? v / downscale : -((-v + downscale - 1) / downscale);
+    };
+    const auto ceilDiv = [&](int32_t v) { return -floorDiv(-v); };
+    return Rect(floorDiv(area.left), floorDiv(area.top), ceilDiv(area.right),
+                ceilDiv(area.bottom));
+}
+
 std::vector<float> RegionSamplingThread::sampleBuffer(
         const sp<GraphicBuffer>& buffer, const Point& leftTop,
         const std::vector<RegionSamplingThread::Descriptor>& descriptors, uint32_t orientation) {
@@ -252,7 +266,8 @@ std::vector<float> RegionSamplingThread::sampleBuffer(
     std::transform(descriptors.begin(), descriptors.end(), lumas.begin(),
                    [&](auto const& descriptor) {
                        return sampleArea(data.get(), width, height, stride, orientation,
-                                         descriptor.area - leftTop);
+                                         scaleSampleArea(descriptor.area - leftTop,
+                                                         kSampleDownscale));
                    });
     return lumas;
 }
@@ -288,10 +303,11 @@ void RegionSamplingThread::captureSample() {
     }
 
     const Rect sampledBounds = sampleRegion.bounds();
+    const Rect sampleSize = scaleSampleArea(Rect(sampledBounds.getSize()), kSampleDownscale);
     constexpr bool kUseIdentityTransform = false;
 
     SurfaceFlinger::RenderAreaFuture renderAreaFuture = ftl::defer([=] {
-        return DisplayRenderArea::create(displayWeak, sampledBounds, sampledBounds.getSize(),
+        return DisplayRenderArea::create(displayWeak, sampledBounds, sampleSize.getSize(),
                                          ui::Dataspace::V0_SRGB, kUseIdentityTransform);
     });
 
@@ -339,14 +355,14 @@ void RegionSamplingThread::captureSample() {
     };
 
     std::shared_ptr<renderengine::ExternalTexture> buffer = nullptr;
-    if (mCachedBuffer && mCachedBuffer->getBuffer()->getWidth() == sampledBounds.getWidth() &&
-        mCachedBuffer->getBuffer()->getHeight() == sampledBounds.getHeight()) {
+    if (mCachedBuffer && mCachedBuffer->getBuffer()->getWidth() == sampleSize.getWidth() &&
+        mCachedBuffer->getBuffer()->getHeight() == sampleSize.getHeight()) {
         buffer = mCachedBuffer;
     } else {
         const uint32_t usage =
                 GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE;
         sp<GraphicBuffer> graphicBuffer =
-                new GraphicBuffer(sampledBounds.getWidth(), sampledBounds.getHeight(),
+                new GraphicBuffer(sampleSize.getWidth(), sampleSize.getHeight(),
                                   PIXEL_FORMAT_RGBA_8888, 1, usage, "RegionSamplingThread");
         const status_t bufferStatus = graphicBuffer->initCheck();
         LOG_ALWAYS_FATAL_IF(bufferStatus != OK, "captureSample: Buffer failed to allocate: %d",
@@ -41,6 +41,8 @@ struct SamplingOffsetCallback;
 
 float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t stride,
                  uint32_t orientation, const Rect& area);
+// Maps an area to a buffer |downscale| times smaller in each dimension, rounding outwards.
+Rect scaleSampleArea(const Rect& area, int32_t downscale);
 
 class RegionSamplingThread : public IBinder::DeathRecipient {
 public:
@@ -28,6 +28,7 @@
 #include <cstdint>
 #include <optional>
 #include <type_traits>
+#include <unordered_map>
 
 #include <android-base/stringprintf.h>
 
@@ -186,6 +187,10 @@ void EventThreadConnection::requestNextVsync() {
     mEventThread->requestNextVsync(this);
 }
 
+status_t EventThreadConnection::getVsyncTimeline(base::unique_fd* outFd) {
+    return mEventThread->getVsyncTimeline(outFd);
+}
+
 status_t EventThreadConnection::postEvent(const DisplayEventReceiver::Event& event) {
     constexpr auto toStatus = [](ssize_t size) {
         return size < 0 ? status_t(size) : status_t(NO_ERROR);
@@ -224,7 +229,8 @@ EventThread::EventThread(std::unique_ptr<VSyncSource> vsyncSource,
         mInterceptVSyncsCallback(std::move(interceptVSyncsCallback)),
         mThrottleVsyncCallback(std::move(throttleVsyncCallback)),
         mGetVsyncPeriodFunction(std::move(getVsyncPeriodFunction)),
-        mThreadName(mVSyncSource->getName()) {
+        mThreadName(mVSyncSource->getName()),
+        mVsyncTimeline(VsyncTimeline::create()) {
 
     LOG_ALWAYS_FATAL_IF(getVsyncPeriodFunction == nullptr,
             "getVsyncPeriodFunction must not be null");
@@ -350,11 +356,25 @@ void EventThread::onScreenAcquired() {
     mCondition.notify_all();
 }
 
+status_t EventThread::getVsyncTimeline(base::unique_fd* outFd) const {
+    if (mVsyncTimeline == nullptr) {
+        return NO_INIT;
+    }
+    *outFd = mVsyncTimeline->getFd();
+    return outFd->ok() ? NO_ERROR : UNKNOWN_ERROR;
+}
+
 void EventThread::onVSyncEvent(nsecs_t timestamp, nsecs_t expectedVSyncTimestamp,
                                nsecs_t deadlineTimestamp) {
     std::lock_guard<std::mutex> lock(mMutex);
 
     LOG_FATAL_IF(!mVSyncState);
+    addVSyncEventLocked(timestamp, expectedVSyncTimestamp, deadlineTimestamp);
+    mCondition.notify_all();
+}
+
+void EventThread::addVSyncEventLocked(nsecs_t timestamp, nsecs_t expectedVSyncTimestamp,
+                                      nsecs_t deadlineTimestamp) {
     const int64_t vsyncId = [&] {
         if (mTokenManager != nullptr) {
             return mTokenManager->generateTokenForPredictions(
@@ -363,9 +383,16 @@ void EventThread::onVSyncEvent(nsecs_t timestamp, nsecs_t expectedVSyncTimestamp
         return FrameTimelineInfo::INVALID_VSYNC_ID;
     }();
 
-    mPendingEvents.push_back(makeVSync(mVSyncState->displayId, timestamp, ++mVSyncState->count,
+    const uint32_t count = ++mVSyncState->count;
+    if (mVsyncTimeline) {
+        mVsyncTimeline->publish({.count = count,
+                                 .timestamp = timestamp,
+                                 .expectedVSyncTimestamp = expectedVSyncTimestamp,
+                                 .deadlineTimestamp = deadlineTimestamp,
+                                 .vsyncId = vsyncId});
+    }
+    mPendingEvents.push_back(makeVSync(mVSyncState->displayId, timestamp, count,
                                        expectedVSyncTimestamp, deadlineTimestamp, vsyncId));
-    mCondition.notify_all();
 }
 
 void EventThread::onHotplugReceived(PhysicalDisplayId displayId, bool connected) {
@@ -500,16 +527,7 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
                 const auto now = systemTime(SYSTEM_TIME_MONOTONIC);
                 const auto deadlineTimestamp = now + timeout.count();
                 const auto expectedVSyncTime = deadlineTimestamp + timeout.count();
-                const int64_t vsyncId = [&] {
-                    if (mTokenManager != nullptr) {
-                        return mTokenManager->generateTokenForPredictions(
-                                {now, deadlineTimestamp, expectedVSyncTime});
-                    }
-                    return FrameTimelineInfo::INVALID_VSYNC_ID;
-                }();
-                mPendingEvents.push_back(makeVSync(mVSyncState->displayId, now,
-                                                   ++mVSyncState->count, expectedVSyncTime,
-                                                   deadlineTimestamp, vsyncId));
+                addVSyncEventLocked(now, expectedVSyncTime, deadlineTimestamp);
             }
         }
     }
@@ -571,10 +589,16 @@ bool EventThread::shouldConsumeEvent(const DisplayEventReceiver::Event& event,
 void EventThread::dispatchEvent(const DisplayEventReceiver::Event& event,
                                 const DisplayEventConsumers& consumers) {
     const uint8_t num_attempts = 3;
+    // Apps often have many connections, look up the frame interval of each uid only once.
+    std::unordered_map<uid_t, nsecs_t> frameIntervals;
     for (const auto& consumer : consumers) {
         DisplayEventReceiver::Event copy = event;
         if (event.header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
-            copy.vsync.frameInterval = mGetVsyncPeriodFunction(consumer->mOwnerUid);
+            const auto [it, inserted] = frameIntervals.try_emplace(consumer->mOwnerUid);
+            if (inserted) {
+                it->second = mGetVsyncPeriodFunction(consumer->mOwnerUid);
+            }
+            copy.vsync.frameInterval = it->second;
         }
         bool needs_retry = true;
         for (uint8_t attempt = 0; needs_retry && (attempt < num_attempts); attempt++) {
@@ -19,6 +19,7 @@
 #include <android-base/thread_annotations.h>
 #include <gui/DisplayEventReceiver.h>
 #include <gui/IDisplayEventConnection.h>
+#include <gui/VsyncTimeline.h>
 #include <private/gui/BitTube.h>
 #include <sys/types.h>
 #include <utils/Errors.h>
@@ -91,6 +92,7 @@ public:
     status_t stealReceiveChannel(gui::BitTube* outChannel) override;
     status_t setVsyncRate(uint32_t rate) override;
     void requestNextVsync() override; // asynchronous
+    status_t getVsyncTimeline(base::unique_fd* outFd) override;
 
     // Called in response to requestNextVsync.
     const ResyncCallback resyncCallback;
@@ -142,6 +144,9 @@ public:
     // Requests the next vsync. If resetIdleTimer is set to true, it resets the idle timer.
     virtual void requestNextVsync(const sp<EventThreadConnection>& connection) = 0;
 
+    // Returns the fd of the timeline on which every vsync of this EventThread is published.
+    virtual status_t getVsyncTimeline(base::unique_fd* outFd) const = 0;
+
     // Retrieves the number of event connections tracked by this EventThread.
     virtual size_t getEventThreadConnectionCount() = 0;
 };
@@ -165,6 +170,7 @@ public:
     status_t registerDisplayEventConnection(const sp<EventThreadConnection>& connection) override;
     void setVsyncRate(uint32_t rate, const sp<EventThreadConnection>& connection) override;
     void requestNextVsync(const sp<EventThreadConnection>& connection) override;
+    status_t getVsyncTimeline(base::unique_fd* outFd) const override;
 
     // called before the screen is turned off from main thread
     void onScreenReleased() override;
@@ -202,6 +208,9 @@ private:
     void removeDisplayEventConnectionLocked(const wp<EventThreadConnection>& connection)
             REQUIRES(mMutex);
 
+    void addVSyncEventLocked(nsecs_t timestamp, nsecs_t expectedVSyncTimestamp,
+                             nsecs_t deadlineTimestamp) REQUIRES(mMutex);
+
     // Implements VSyncSource::Callback
     void onVSyncEvent(nsecs_t timestamp, nsecs_t expectedVSyncTimestamp,
                       nsecs_t deadlineTimestamp) override;
@@ -214,6 +223,9 @@ private:
     const GetVsyncPeriodFunction mGetVsyncPeriodFunction;
     const char* const mThreadName;
 
+    // Every vsync is published here, so clients can read it without having to be woken up.
+    const std::shared_ptr<VsyncTimeline> mVsyncTimeline;
+
     std::thread mThread;
     mutable std::mutex mMutex;
     mutable std::condition_variable mCondition;
@@ -85,42 +85,41 @@ LayerHistory::~LayerHistory() = default;
 
 void LayerHistory::registerLayer(Layer* layer, LayerVoteType type) {
     std::lock_guard lock(mLock);
-    for (const auto& info : mLayerInfos) {
-        LOG_ALWAYS_FATAL_IF(info.first == layer, "%s already registered", layer->getName().c_str());
-    }
-    auto info = std::make_unique<LayerInfo>(layer->getName(), layer->getOwnerUid(), type);
-    mLayerInfos.emplace_back(layer, std::move(info));
+    LOG_ALWAYS_FATAL_IF(findLayer(layer), "%s already registered", layer->getName().c_str());
+    mLayers.push_back(layer);
+    mLayerInfos.push_back(
+            std::make_unique<LayerInfo>(layer->getName(), layer->getOwnerUid(), type));
 }
 
 void LayerHistory::deregisterLayer(Layer* layer) {
     std::lock_guard lock(mLock);
 
-    const auto it = std::find_if(mLayerInfos.begin(), mLayerInfos.end(),
-                                 [layer](const auto& pair) { return pair.first == layer; });
-    LOG_ALWAYS_FATAL_IF(it == mLayerInfos.end(), "%s: unknown layer %p", __FUNCTION__, layer);
+    const auto index = findLayer(layer);
+    LOG_ALWAYS_FATAL_IF(!index, "%s: unknown layer %p", __FUNCTION__, layer);
 
-    const size_t i = static_cast<size_t>(it - mLayerInfos.begin());
+    size_t i = *index;
     if (i < mActiveLayersEnd) {
-        mActiveLayersEnd--;
+        // Keep the partition by moving the last active layer into the hole first.
+        swapLayers(i, --mActiveLayersEnd);
+        i = mActiveLayersEnd;
     }
-    const size_t last = mLayerInfos.size() - 1;
-    std::swap(mLayerInfos[i], mLayerInfos[last]);
-    mLayerInfos.erase(mLayerInfos.begin() + static_cast<long>(last));
+    swapLayers(i, mLayers.size() - 1);
+    mLayers.pop_back();
+    mLayerInfos.pop_back();
 }
 
 void LayerHistory::record(Layer* layer, nsecs_t presentTime, nsecs_t now,
                           LayerUpdateType updateType) {
     std::lock_guard lock(mLock);
 
-    const auto it = std::find_if(mLayerInfos.begin(), mLayerInfos.end(),
-                                 [layer](const auto& pair) { return pair.first == layer; });
-    if (it == mLayerInfos.end()) {
+    const auto index = findLayer(layer);
+    if (!index) {
         // Offscreen layer
         ALOGV("LayerHistory::record: %s not registered", layer->getName().c_str());
         return;
     }
 
-    const auto& info = it->second;
+    const auto& info = mLayerInfos[*index];
     const auto layerProps = LayerInfo::LayerProps{
             .visible = layer->isVisible(),
             .bounds = layer->getBounds(),
@@ -132,9 +131,8 @@ void LayerHistory::record(Layer* layer, nsecs_t presentTime, nsecs_t now,
     info->setLastPresentTime(presentTime, now, updateType, mModeChangePending, layerProps);
 
     // Activate layer if inactive.
-    if (const auto end = activeLayers().end(); it >= end) {
-        std::iter_swap(it, end);
-        mActiveLayersEnd++;
+    if (*index >= mActiveLayersEnd) {
+        swapLayers(*index, mActiveLayersEnd++);
     }
 }
 
@@ -145,7 +143,7 @@ LayerHistory::Summary LayerHistory::summarize(nsecs_t now) {
 
     partitionLayers(now);
 
-    for (const auto& [layer, info] : activeLayers()) {
+    for (const auto& info : activeLayers()) {
         const auto frameRateSelectionPriority = info->getFrameRateSelectionPriority();
         const auto layerFocused = Layer::isLayerFocusedBasedOnPriority(frameRateSelectionPriority);
         ALOGV("%s has priority: %d %s focused", info->getName().c_str(), frameRateSelectionPriority,
@@ -181,13 +179,26 @@ LayerHistory::Summary LayerHistory::summarize(nsecs_t now) {
     return summary;
 }
 
+std::optional<size_t> LayerHistory::findLayer(const Layer* layer) const {
+    const auto it = std::find(mLayers.begin(), mLayers.end(), layer);
+    if (it == mLayers.end()) {
+        return std::nullopt;
+    }
+    return static_cast<size_t>(it - mLayers.begin());
+}
+
+void LayerHistory::swapLayers(size_t i, size_t j) {
+    std::swap(mLayers[i], mLayers[j]);
+    std::swap(mLayerInfos[i], mLayerInfos[j]);
+}
+
 void LayerHistory::partitionLayers(nsecs_t now) {
     const nsecs_t threshold = getActiveLayerThreshold(now);
 
-    // Collect expired and inactive layers after active layers.
+    // Collect inactive layers after active layers.
     size_t i = 0;
     while (i < mActiveLayersEnd) {
-        auto& [layerUnsafe, info] = mLayerInfos[i];
+        const auto& info = mLayerInfos[i];
         if (isLayerActive(*info, threshold)) {
             i++;
             // Set layer vote if set
@@ -219,14 +230,14 @@ void LayerHistory::partitionLayers(nsecs_t now) {
         }
 
         info->onLayerInactive(now);
-        std::swap(mLayerInfos[i], mLayerInfos[--mActiveLayersEnd]);
+        swapLayers(i, --mActiveLayersEnd);
     }
 }
 
 void LayerHistory::clear() {
     std::lock_guard lock(mLock);
 
-    for (const auto& [layer, info] : activeLayers()) {
+    for (const auto& info : activeLayers()) {
         info->clearHistory(systemTime());
     }
 }
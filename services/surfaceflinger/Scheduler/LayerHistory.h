@@ -22,6 +22,7 @@
 
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -79,8 +80,7 @@ private:
     friend LayerHistoryTest;
     friend TestableScheduler;
 
-    using LayerPair = std::pair<Layer*, std::unique_ptr<LayerInfo>>;
-    using LayerInfos = std::vector<LayerPair>;
+    using LayerInfos = std::vector<std::unique_ptr<LayerInfo>>;
 
     struct ActiveLayers {
         LayerInfos& infos;
@@ -92,15 +92,22 @@ private:
 
     ActiveLayers activeLayers() REQUIRES(mLock) { return {mLayerInfos, mActiveLayersEnd}; }
 
-    // Iterates over layers in a single pass, swapping pairs such that active layers precede
-    // inactive layers, and inactive layers precede expired layers. Removes expired layers by
-    // truncating after inactive layers.
+    // Returns the index of the layer in mLayers and mLayerInfos, if registered.
+    std::optional<size_t> findLayer(const Layer*) const REQUIRES(mLock);
+
+    // Swaps two layers in both mLayers and mLayerInfos.
+    void swapLayers(size_t i, size_t j) REQUIRES(mLock);
+
+    // Iterates over active layers in a single pass, swapping layers such that active layers
+    // precede inactive layers.
     void partitionLayers(nsecs_t now) REQUIRES(mLock);
 
     mutable std::mutex mLock;
 
-    // Partitioned such that active layers precede inactive layers. For fast lookup, the few active
-    // layers are at the front, and weak pointers are stored in contiguous memory to hit the cache.
+    // Parallel arrays of the registered layers and their history, partitioned such that active
+    // layers precede inactive layers. Lookups only scan mLayers, so they stay within contiguous
+    // pointers, and the few active layers summarized every frame are at the front.
+    std::vector<Layer*> mLayers GUARDED_BY(mLock);
     LayerInfos mLayerInfos GUARDED_BY(mLock);
     size_t mActiveLayersEnd GUARDED_BY(mLock) = 0;
 
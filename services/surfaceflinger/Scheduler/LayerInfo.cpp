@@ -24,6 +24,7 @@
 #include "LayerInfo.h"
 
 #include <algorithm>
+#include <limits>
 #include <utility>
 
 #include <cutils/compiler.h>
@@ -60,10 +61,8 @@ void LayerInfo::setLastPresentTime(nsecs_t lastPresentTime, nsecs_t now, LayerUp
             FrameTimeData frameTime = {.presentTime = lastPresentTime,
                                        .queueTime = mLastUpdatedTime,
                                        .pendingModeChange = pendingModeChange};
+            // Drops the oldest frame once HISTORY_SIZE frames are recorded.
             mFrameTimes.push_back(frameTime);
-            if (mFrameTimes.size() > HISTORY_SIZE) {
-                mFrameTimes.pop_front();
-            }
             break;
     }
 }
@@ -126,7 +125,7 @@ bool LayerInfo::hasEnoughDataForHeuristic() const {
     return true;
 }
 
-std::optional<nsecs_t> LayerInfo::calculateAverageFrameTime() const {
+std::optional<std::vector<nsecs_t>> LayerInfo::getHeuristicFrameTimes() const {
     // Ignore frames captured during a mode change
     const bool isDuringModeChange =
             std::any_of(mFrameTimes.begin(), mFrameTimes.end(),
@@ -155,20 +154,31 @@ std::optional<nsecs_t> LayerInfo::calculateAverageFrameTime() const {
     auto getFrameTime = isMissingPresentTime ? [](FrameTimeData data) { return data.queueTime; }
                                              : [](FrameTimeData data) { return data.presentTime; };
 
-    nsecs_t totalDeltas = 0;
-    int numDeltas = 0;
-    auto prevFrame = mFrameTimes.begin();
-    for (auto it = mFrameTimes.begin() + 1; it != mFrameTimes.end(); ++it) {
-        const auto currDelta = getFrameTime(*it) - getFrameTime(*prevFrame);
-        if (currDelta < kMinPeriodBetweenFrames) {
+    std::vector<nsecs_t> frameTimes;
+    frameTimes.reserve(mFrameTimes.size());
+    for (const auto& frame : mFrameTimes) {
+        const nsecs_t frameTime = getFrameTime(frame);
+        if (!frameTimes.empty() && frameTime - frameTimes.back() < kMinPeriodBetweenFrames) {
             // Skip this frame, but count the delta into the next frame
             continue;
         }
+        frameTimes.push_back(frameTime);
+    }
+    return frameTimes;
+}
 
-        prevFrame = it;
+std::optional<nsecs_t> LayerInfo::calculateAverageFrameTime() const {
+    const auto frameTimes = getHeuristicFrameTimes();
+    if (!frameTimes) {
+        return std::nullopt;
+    }
 
+    nsecs_t totalDeltas = 0;
+    int numDeltas = 0;
+    for (size_t i = 1; i < frameTimes->size(); i++) {
+        const auto currDelta = (*frameTimes)[i] - (*frameTimes)[i - 1];
         if (currDelta > kMaxPeriodBetweenFrames) {
-            // Skip this frame and the current delta.
+            // Skip the current delta.
             continue;
         }
 
@@ -184,6 +194,64 @@ std::optional<nsecs_t> LayerInfo::calculateAverageFrameTime() const {
     return static_cast<nsecs_t>(averageFrameTime);
 }
 
+std::optional<Fps> LayerInfo::detectCadence() const {
+    const auto frameTimes = getHeuristicFrameTimes();
+    if (!frameTimes || frameTimes->size() < kMinFramesForCadence) {
+        return std::nullopt;
+    }
+    for (size_t i = 1; i < frameTimes->size(); i++) {
+        if ((*frameTimes)[i] - (*frameTimes)[i - 1] > kMaxPeriodBetweenFrames) {
+            return std::nullopt;
+        }
+    }
+
+    // Fit the frames onto the grid of each candidate frame rate. Content at that rate lands
+    // within a fraction of a period of its slot, even when pulled down onto a display that isn't
+    // a multiple of it, while the error for any other rate keeps growing over the history.
+    std::optional<Fps> cadence;
+    nsecs_t bestSpread = std::numeric_limits<nsecs_t>::max();
+    for (const Fps frameRate : kCadenceFrameRates) {
+        const nsecs_t period = frameRate.getPeriodNsecs();
+        const nsecs_t start = frameTimes->front();
+        nsecs_t lastSlot = 0;
+        nsecs_t droppedFrames = 0;
+        nsecs_t minError = 0;
+        nsecs_t maxError = 0;
+        bool fits = true;
+        for (size_t i = 1; i < frameTimes->size(); i++) {
+            const nsecs_t elapsed = (*frameTimes)[i] - start;
+            const nsecs_t slot = (elapsed + period / 2) / period;
+            if (slot <= lastSlot) {
+                // Two frames in the same slot, the content is faster than this rate.
+                fits = false;
+                break;
+            }
+            droppedFrames += slot - lastSlot - 1;
+            lastSlot = slot;
+
+            const nsecs_t error = elapsed - slot * period;
+            minError = std::min(minError, error);
+            maxError = std::max(maxError, error);
+        }
+
+        const nsecs_t spread = maxError - minError;
+        if (!fits || spread > period / kCadenceMaxSpreadDivisor ||
+            droppedFrames * kCadenceMaxDroppedFramesDivisor > lastSlot) {
+            continue;
+        }
+
+        if (spread < bestSpread) {
+            bestSpread = spread;
+            cadence = frameRate;
+        }
+    }
+
+    if (cadence) {
+        ALOGV("%s has a cadence of %s", mName.c_str(), to_string(*cadence).c_str());
+    }
+    return cadence;
+}
+
 std::optional<Fps> LayerInfo::calculateRefreshRateIfPossible(nsecs_t now) {
     static constexpr float MARGIN = 1.0f; // 1Hz
     if (!hasEnoughDataForHeuristic()) {
@@ -191,7 +259,10 @@ std::optional<Fps> LayerInfo::calculateRefreshRateIfPossible(nsecs_t now) {
         return std::nullopt;
     }
 
-    const auto averageFrameTime = calculateAverageFrameTime();
+    // A cadence at a known content rate holds through pulldown and jitter that skew the average.
+    const auto cadence = detectCadence();
+    const auto averageFrameTime =
+            cadence ? std::make_optional(cadence->getPeriodNsecs()) : calculateAverageFrameTime();
     if (averageFrameTime.has_value()) {
         const auto refreshRate = Fps::fromPeriodNsecs(*averageFrameTime);
         const bool refreshRateConsistent = mRefreshRateHistory.add(refreshRate, now);
@@ -19,11 +19,13 @@
 #include <ui/Transform.h>
 #include <utils/Timers.h>
 
+#include <array>
 #include <chrono>
-#include <deque>
+#include <vector>
 
 #include "LayerHistory.h"
 #include "RefreshRateConfigs.h"
+#include "RingBuffer.h"
 #include "Scheduler/Seamlessness.h"
 #include "SchedulerUtils.h"
 
@@ -256,7 +258,7 @@ private:
 
         const std::string mName;
         mutable std::optional<HeuristicTraceTagData> mHeuristicTraceTagData;
-        std::deque<RefreshRateData> mRefreshRates;
+        RingBuffer<RefreshRateData, HISTORY_SIZE> mRefreshRates;
         static constexpr float MARGIN_CONSISTENT_FPS = 1.0;
     };
 
@@ -264,7 +266,11 @@ private:
     bool isAnimating(nsecs_t now) const;
     bool hasEnoughDataForHeuristic() const;
     std::optional<Fps> calculateRefreshRateIfPossible(nsecs_t now);
+    std::optional<std::vector<nsecs_t>> getHeuristicFrameTimes() const;
     std::optional<nsecs_t> calculateAverageFrameTime() const;
+    // Returns the content frame rate if the frames follow the cadence of a common video or game
+    // frame rate.
+    std::optional<Fps> detectCadence() const;
     bool isFrameTimeValid(const FrameTimeData&) const;
 
     const std::string mName;
@@ -277,6 +283,17 @@ private:
     // this period apart from each other, the interval between them won't be
     // taken into account when calculating average frame rate.
     static constexpr nsecs_t kMaxPeriodBetweenFrames = kMinFpsForFrequentLayer.getPeriodNsecs();
+    // Content frame rates recognized by their cadence.
+    static constexpr std::array kCadenceFrameRates = {Fps(24.0f), Fps(25.0f), Fps(30.0f),
+                                                      Fps(48.0f), Fps(50.0f), Fps(60.0f),
+                                                      Fps(90.0f), Fps(120.0f)};
+    // Frames needed to tell apart cadences that are close to each other, such as 24 and 25 fps.
+    static constexpr size_t kMinFramesForCadence = 10;
+    // The frames of a cadence are all within a fraction of a period of their slots. This allows for
+    // a 25fps video pulled down onto 60Hz, which is off by up to a third of a period.
+    static constexpr nsecs_t kCadenceMaxSpreadDivisor = 2;
+    // At most one in this many slots of a cadence may be missing a frame.
+    static constexpr nsecs_t kCadenceMaxDroppedFramesDivisor = 10;
     LayerHistory::LayerVoteType mDefaultVote;
 
     LayerVote mLayerVote;
@@ -287,10 +304,10 @@ private:
 
     RefreshRateHeuristicData mLastRefreshRate;
 
-    std::deque<FrameTimeData> mFrameTimes;
+    static constexpr size_t HISTORY_SIZE = RefreshRateHistory::HISTORY_SIZE;
+    RingBuffer<FrameTimeData, HISTORY_SIZE> mFrameTimes;
     std::chrono::time_point<std::chrono::steady_clock> mFrameTimeValidSince =
             std::chrono::steady_clock::now();
-    static constexpr size_t HISTORY_SIZE = RefreshRateHistory::HISTORY_SIZE;
     static constexpr std::chrono::nanoseconds HISTORY_DURATION = 1s;
 
     LayerProps mLayerProps;
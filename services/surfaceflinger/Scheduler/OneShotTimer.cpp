@@ -17,6 +17,7 @@
 #include "OneShotTimer.h"
 #include <utils/Log.h>
 #include <utils/Timers.h>
+#include <algorithm>
 #include <chrono>
 #include <sstream>
 #include <thread>
@@ -114,13 +115,16 @@ void OneShotTimer::loop() {
             break;
         }
 
+        mWaiting = true;
         auto triggerTime = mClock->now() + mInterval;
         state = TimerState::WAITING;
         while (state == TimerState::WAITING) {
             constexpr auto zero = std::chrono::steady_clock::duration::zero();
-            // Wait for mInterval time for semaphore signal.
+            // Wait until the trigger time for semaphore signal.
             struct timespec ts;
-            calculateTimeoutTime(std::chrono::nanoseconds(mInterval), &ts);
+            calculateTimeoutTime(std::max(std::chrono::nanoseconds(triggerTime - mClock->now()),
+                                          std::chrono::nanoseconds::zero()),
+                                 &ts);
             int result = sem_clockwait(&mSemaphore, CLOCK_MONOTONIC, &ts);
             if (result && errno != ETIMEDOUT && errno != EINTR) {
                 std::stringstream ss;
@@ -129,14 +133,25 @@ void OneShotTimer::loop() {
             }
 
             state = checkForResetAndStop(state);
+            if (state == TimerState::WAITING && (triggerTime - mClock->now()) <= zero) {
+                // A reset that saw the thread waiting did not wake it up, so look for one again
+                // after no longer waiting. Either the thread sees the reset here, or the reset
+                // sees the thread isn't waiting and wakes it up.
+                mWaiting = false;
+                state = checkForResetAndStop(state);
+                if (state == TimerState::WAITING) {
+                    triggerTimeout = true;
+                    state = TimerState::IDLE;
+                } else if (state == TimerState::RESET) {
+                    mWaiting = true;
+                }
+            }
             if (state == TimerState::RESET) {
-                triggerTime = mClock->now() + mInterval;
+                triggerTime = mLastResetTime.load() + mInterval;
                 state = TimerState::WAITING;
-            } else if (state == TimerState::WAITING && (triggerTime - mClock->now()) <= zero) {
-                triggerTimeout = true;
-                state = TimerState::IDLE;
             }
         }
+        mWaiting = false;
 
         if (triggerTimeout && mTimeoutCallback) {
             mTimeoutCallback();
@@ -158,7 +173,11 @@ OneShotTimer::TimerState OneShotTimer::checkForResetAndStop(TimerState state) {
 }
 
 void OneShotTimer::reset() {
+    mLastResetTime = mClock->now();
     mResetTriggered = true;
+    if (mWaiting) {
+        return;
+    }
     int result = sem_post(&mSemaphore);
     LOG_ALWAYS_FATAL_IF(result, "sem_post failed");
 }
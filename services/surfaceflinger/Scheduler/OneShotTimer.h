@@ -46,7 +46,8 @@ public:
     void start();
     // Stops the idle timer and any held resources.
     void stop();
-    // Resets the wakeup time and fires the reset callback.
+    // Resets the wakeup time and fires the reset callback. This is called for every input event,
+    // so it only wakes up the timer thread if the timer had expired.
     void reset();
 
     std::string dump() const;
@@ -103,6 +104,13 @@ private:
     // check in the main loop if they were.
     std::atomic<bool> mResetTriggered = false;
     std::atomic<bool> mStopTriggered = false;
+
+    // Time of the last reset, from which the timer thread computes its deadline.
+    std::atomic<std::chrono::steady_clock::time_point> mLastResetTime;
+
+    // Whether the timer thread is waiting for the interval to expire, in which case it picks up
+    // resets when its current wait ends rather than being woken up for each of them.
+    std::atomic<bool> mWaiting = false;
 };
 
 } // namespace scheduler
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+namespace android::scheduler {
+
+// Fixed-capacity FIFO stored inline. Pushing to a full buffer replaces the oldest element, so the
+// buffer never allocates and always holds the N most recent elements.
+template <typename T, size_t N>
+class RingBuffer {
+    static_assert(N > 0);
+
+    template <bool Const>
+    class Iterator {
+        using Buffer = std::conditional_t<Const, const RingBuffer, RingBuffer>;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const T*, T*>;
+        using reference = std::conditional_t<Const, const T&, T&>;
+
+        Iterator() = default;
+        Iterator(Buffer* buffer, size_t index) : mBuffer(buffer), mIndex(index) {}
+
+        reference operator*() const { return (*mBuffer)[mIndex]; }
+        pointer operator->() const { return &(*mBuffer)[mIndex]; }
+
+        Iterator& operator++() {
+            mIndex++;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator it = *this;
+            mIndex++;
+            return it;
+        }
+
+        bool operator==(const Iterator& other) const { return mIndex == other.mIndex; }
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+    private:
+        Buffer* mBuffer = nullptr;
+        size_t mIndex = 0;
+    };
+
+public:
+    using value_type = T;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    static constexpr size_t capacity() { return N; }
+
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+    bool full() const { return mSize == N; }
+
+    // Indexed from the oldest element.
+    T& operator[](size_t i) { return mElements[(mBegin + i) % N]; }
+    const T& operator[](size_t i) const { return mElements[(mBegin + i) % N]; }
+
+    T& front() { return (*this)[0]; }
+    const T& front() const { return (*this)[0]; }
+    T& back() { return (*this)[mSize - 1]; }
+    const T& back() const { return (*this)[mSize - 1]; }
+
+    void push_back(const T& element) {
+        if (full()) {
+            mElements[mBegin] = element;
+            mBegin = (mBegin + 1) % N;
+        } else {
+            (*this)[mSize++] = element;
+        }
+    }
+
+    void pop_front() {
+        mBegin = (mBegin + 1) % N;
+        mSize--;
+    }
+
+    void clear() {
+        mBegin = 0;
+        mSize = 0;
+    }
+
+    iterator begin() { return {this, 0}; }
+    iterator end() { return {this, mSize}; }
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, mSize}; }
+
+private:
+    std::array<T, N> mElements;
+    size_t mBegin = 0;
+    size_t mSize = 0;
+};
+
+} // namespace android::scheduler
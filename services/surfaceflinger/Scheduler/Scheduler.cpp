@@ -84,9 +84,11 @@ std::unique_ptr<scheduler::VSyncDispatch> createVSyncDispatch(scheduler::VSyncTr
     // TODO(b/144707443): Tune constants.
     constexpr std::chrono::nanoseconds vsyncMoveThreshold = 3ms;
     constexpr std::chrono::nanoseconds timerSlack = 500us;
+    constexpr std::chrono::nanoseconds coalescingWindow = 1ms;
     return std::make_unique<
             scheduler::VSyncDispatchTimerQueue>(std::make_unique<scheduler::Timer>(), tracker,
-                                                timerSlack.count(), vsyncMoveThreshold.count());
+                                                timerSlack.count(), vsyncMoveThreshold.count(),
+                                                coalescingWindow.count());
 }
 
 const char* toContentDetectionString(bool useContentDetection) {
@@ -195,11 +195,13 @@ void VSyncDispatchTimerQueueEntry::dump(std::string& result) const {
 
 VSyncDispatchTimerQueue::VSyncDispatchTimerQueue(std::unique_ptr<TimeKeeper> tk,
                                                  VSyncTracker& tracker, nsecs_t timerSlack,
-                                                 nsecs_t minVsyncDistance)
+                                                 nsecs_t minVsyncDistance,
+                                                 nsecs_t coalescingWindow)
       : mTimeKeeper(std::move(tk)),
         mTracker(tracker),
         mTimerSlack(timerSlack),
-        mMinVsyncDistance(minVsyncDistance) {}
+        mMinVsyncDistance(minVsyncDistance),
+        mCoalescingWindow(coalescingWindow) {}
 
 VSyncDispatchTimerQueue::~VSyncDispatchTimerQueue() {
     std::lock_guard lock(mMutex);
@@ -277,6 +279,26 @@ void VSyncDispatchTimerQueue::timerCallback() {
         std::lock_guard lock(mMutex);
         auto const now = mTimeKeeper->now();
         mLastTimerCallback = now;
+        traceWakeup(now);
+
+        auto const lagAllowance = std::max(now - mIntendedWakeupTime, static_cast<nsecs_t>(0));
+        auto const dueBefore = mIntendedWakeupTime + mTimerSlack + lagAllowance;
+
+        // The callbacks that are due keep the CPU busy until they are ready, so the callbacks
+        // that would wake up while that work is still in progress are run along with them instead
+        // of getting a wakeup of their own a moment later.
+        auto runBefore = dueBefore;
+        if (mCoalescingWindow > 0) {
+            for (auto const& [_, callback] : mCallbacks) {
+                auto const wakeupTime = callback->wakeupTime();
+                if (wakeupTime && *wakeupTime < dueBefore) {
+                    runBefore = std::max(runBefore,
+                                         std::min(*callback->readyTime(),
+                                                  mIntendedWakeupTime + mCoalescingWindow));
+                }
+            }
+        }
+
         for (auto it = mCallbacks.begin(); it != mCallbacks.end(); it++) {
             auto& callback = it->second;
             auto const wakeupTime = callback->wakeupTime();
@@ -286,8 +308,7 @@ void VSyncDispatchTimerQueue::timerCallback() {
 
             auto const readyTime = callback->readyTime();
 
-            auto const lagAllowance = std::max(now - mIntendedWakeupTime, static_cast<nsecs_t>(0));
-            if (*wakeupTime < mIntendedWakeupTime + mTimerSlack + lagAllowance) {
+            if (*wakeupTime < runBefore) {
                 callback->executing();
                 invocations.emplace_back(Invocation{callback, *callback->lastExecutedVsyncTarget(),
                                                     *wakeupTime, *readyTime});
@@ -304,6 +325,19 @@ void VSyncDispatchTimerQueue::timerCallback() {
     }
 }
 
+void VSyncDispatchTimerQueue::traceWakeup(nsecs_t now) {
+    if (!ATRACE_ENABLED()) {
+        return;
+    }
+
+    auto const vsync = mTracker.nextAnticipatedVSyncTimeFrom(now);
+    if (vsync != mTracedWakeupsVsync) {
+        mTracedWakeupsVsync = vsync;
+        mTracedWakeups = 0;
+    }
+    ATRACE_INT("VSD-wakeupsPerVsync", ++mTracedWakeups);
+}
+
 VSyncDispatchTimerQueue::CallbackToken VSyncDispatchTimerQueue::registerCallback(
         Callback const& callbackFn, std::string callbackName) {
     std::lock_guard lock(mMutex);
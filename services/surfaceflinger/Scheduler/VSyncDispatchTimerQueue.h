@@ -117,8 +117,11 @@ public:
     //                                  should be grouped into one wakeup.
     // \param[in] minVsyncDistance      The minimum distance between two vsync estimates before the
     //                                  vsyncs are considered the same vsync event.
+    // \param[in] coalescingWindow      How far ahead of their wakeup time callbacks may be run, to
+    //                                  share the wakeup of callbacks whose work they overlap.
     explicit VSyncDispatchTimerQueue(std::unique_ptr<TimeKeeper> tk, VSyncTracker& tracker,
-                                     nsecs_t timerSlack, nsecs_t minVsyncDistance);
+                                     nsecs_t timerSlack, nsecs_t minVsyncDistance,
+                                     nsecs_t coalescingWindow = 0);
     ~VSyncDispatchTimerQueue();
 
     CallbackToken registerCallback(Callback const& callbackFn, std::string callbackName) final;
@@ -140,12 +143,14 @@ private:
     void rearmTimerSkippingUpdateFor(nsecs_t now, CallbackMap::iterator const& skipUpdate)
             REQUIRES(mMutex);
     void cancelTimer() REQUIRES(mMutex);
+    void traceWakeup(nsecs_t now) REQUIRES(mMutex);
 
     static constexpr nsecs_t kInvalidTime = std::numeric_limits<int64_t>::max();
     std::unique_ptr<TimeKeeper> const mTimeKeeper;
     VSyncTracker& mTracker;
     nsecs_t const mTimerSlack;
     nsecs_t const mMinVsyncDistance;
+    nsecs_t const mCoalescingWindow;
 
     std::mutex mutable mMutex;
     size_t mCallbackToken GUARDED_BY(mMutex) = 0;
@@ -164,6 +169,10 @@ private:
         void note(std::string_view name, nsecs_t in, nsecs_t vs);
     } mTraceBuffer GUARDED_BY(mMutex);
 
+    // The vsync that the timer wakeups are being counted for, and how many there were so far.
+    nsecs_t mTracedWakeupsVsync GUARDED_BY(mMutex) = kInvalidTime;
+    int32_t mTracedWakeups GUARDED_BY(mMutex) = 0;
+
     // For debugging purposes
     nsecs_t mLastTimerCallback GUARDED_BY(mMutex) = kInvalidTime;
     nsecs_t mLastTimerSchedule GUARDED_BY(mMutex) = kInvalidTime;
@@ -40,6 +40,11 @@ using base::StringAppendF;
 
 static auto constexpr kMaxPercent = 100u;
 
+// Number of timestamps needed to line up with the calibrated model of a period seen before.
+static size_t constexpr kRelockSamples = 3;
+// How far those timestamps may be off the calibrated model, in percent of the period.
+static nsecs_t constexpr kRelockTolerancePercent = 1;
+
 VSyncPredictor::~VSyncPredictor() = default;
 
 VSyncPredictor::VSyncPredictor(nsecs_t idealPeriod, size_t historySize,
@@ -122,7 +127,9 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     }
 
     if (mTimestamps.size() < kMinimumSamplesForPrediction) {
-        mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
+        if (!relockToCalibratedPeriod()) {
+            mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
+        }
         return true;
     }
 
@@ -177,6 +184,7 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
 
     if (CC_UNLIKELY(bottom == 0)) {
         it->second = {mIdealPeriod, 0};
+        mCalibratedPeriods.erase(mIdealPeriod);
         clearTimestamps();
         return false;
     }
@@ -187,6 +195,7 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     auto const percent = std::abs(anticipatedPeriod - mIdealPeriod) * kMaxPercent / mIdealPeriod;
     if (percent >= kOutlierTolerancePercent) {
         it->second = {mIdealPeriod, 0};
+        mCalibratedPeriods.erase(mIdealPeriod);
         clearTimestamps();
         return false;
     }
@@ -195,12 +204,45 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     traceInt64If("VSP-intercept", intercept);
 
     it->second = {anticipatedPeriod, intercept};
+    mCalibratedPeriods[mIdealPeriod] = anticipatedPeriod;
 
     ALOGV("model update ts: %" PRId64 " slope: %" PRId64 " intercept: %" PRId64, timestamp,
           anticipatedPeriod, intercept);
     return true;
 }
 
+// After a switch back to a period that was calibrated before, the period itself is still known and
+// only the phase has to be found again. That takes a few timestamps instead of a full history, so
+// HW vsync can be turned off sooner.
+bool VSyncPredictor::relockToCalibratedPeriod() {
+    mRelocked = false;
+    auto const calibrated = mCalibratedPeriods.find(mIdealPeriod);
+    if (mTimestamps.size() < kRelockSamples || calibrated == mCalibratedPeriods.end()) {
+        return false;
+    }
+
+    auto const period = calibrated->second;
+    auto const oldest = *std::min_element(mTimestamps.begin(), mTimestamps.end());
+    std::vector<nsecs_t> errors(mTimestamps.size());
+    for (size_t i = 0; i < mTimestamps.size(); i++) {
+        auto const elapsed = mTimestamps[i] - oldest;
+        auto const ordinal = (elapsed + (period / 2)) / period;
+        errors[i] = elapsed - ordinal * period;
+    }
+
+    auto const [minError, maxError] = std::minmax_element(errors.begin(), errors.end());
+    if ((*maxError - *minError) * kMaxPercent / period >= kRelockTolerancePercent) {
+        // The period changed since it was calibrated, wait for a full history to fit it again.
+        return false;
+    }
+
+    auto const intercept = scheduler::calculate_mean(errors);
+    traceInt64If("VSP-intercept", intercept);
+    mRateMap[mIdealPeriod] = {period, intercept};
+    mRelocked = true;
+    return true;
+}
+
 nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFromLocked(nsecs_t timePoint) const {
     auto const [slope, intercept] = getVSyncPredictionModelLocked();
 
@@ -314,6 +356,7 @@ void VSyncPredictor::setPeriod(nsecs_t period) {
     std::lock_guard lock(mMutex);
     static constexpr size_t kSizeLimit = 30;
     if (CC_UNLIKELY(mRateMap.size() == kSizeLimit)) {
+        mCalibratedPeriods.erase(mRateMap.begin()->first);
         mRateMap.erase(mRateMap.begin());
     }
 
@@ -337,16 +380,18 @@ void VSyncPredictor::clearTimestamps() {
         mTimestamps.clear();
         mLastTimestampIndex = 0;
     }
+    mRelocked = false;
 }
 
 bool VSyncPredictor::needsMoreSamples() const {
     std::lock_guard lock(mMutex);
-    return mTimestamps.size() < kMinimumSamplesForPrediction;
+    return mTimestamps.size() < kMinimumSamplesForPrediction && !mRelocked;
 }
 
 void VSyncPredictor::resetModel() {
     std::lock_guard lock(mMutex);
     mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
+    mCalibratedPeriods.erase(mIdealPeriod);
     clearTimestamps();
 }
 
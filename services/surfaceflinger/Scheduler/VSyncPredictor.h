@@ -72,6 +72,7 @@ private:
     VSyncPredictor(VSyncPredictor const&) = delete;
     VSyncPredictor& operator=(VSyncPredictor const&) = delete;
     void clearTimestamps() REQUIRES(mMutex);
+    bool relockToCalibratedPeriod() REQUIRES(mMutex);
 
     inline void traceInt64If(const char* name, int64_t value) const;
     bool const mTraceOn;
@@ -94,6 +95,12 @@ private:
     // Map between ideal vsync period and the calculated model
     std::unordered_map<nsecs_t, Model> mutable mRateMap GUARDED_BY(mMutex);
 
+    // Map between ideal vsync period and the last period fitted from timestamps
+    std::unordered_map<nsecs_t, nsecs_t> mCalibratedPeriods GUARDED_BY(mMutex);
+    // Whether the timestamps collected so far matched the calibrated model of the period well
+    // enough to predict before there are kMinimumSamplesForPrediction of them.
+    bool mRelocked GUARDED_BY(mMutex) = false;
+
     // Map between the divided vsync period and the last known vsync timestamp
     std::unordered_map<nsecs_t, nsecs_t> mutable mRateDividerKnownTimestampMap GUARDED_BY(mMutex);
 
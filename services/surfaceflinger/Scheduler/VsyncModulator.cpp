@@ -25,6 +25,7 @@
 #include <log/log.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cinttypes>
 #include <mutex>
@@ -34,6 +35,8 @@ using namespace std::chrono_literals;
 namespace android::scheduler {
 
 const std::chrono::nanoseconds VsyncModulator::MIN_EARLY_TRANSACTION_TIME = 1ms;
+const std::chrono::nanoseconds VsyncModulator::DYNAMIC_SF_WORK_DURATION_MARGIN = 2ms;
+const std::chrono::nanoseconds VsyncModulator::DYNAMIC_SF_WORK_DURATION_STEP = 500us;
 
 VsyncModulator::VsyncModulator(const VsyncConfigSet& config, Now now)
       : mVsyncConfigSet(config),
@@ -43,6 +46,9 @@ VsyncModulator::VsyncModulator(const VsyncConfigSet& config, Now now)
 VsyncModulator::VsyncConfig VsyncModulator::setVsyncConfigSet(const VsyncConfigSet& config) {
     std::lock_guard<std::mutex> lock(mMutex);
     mVsyncConfigSet = config;
+    // The frame durations were measured against the previous refresh rate.
+    mDynamicLate.reset();
+    resetFrameDurationsLocked();
     return updateVsyncConfigLocked();
 }
 
@@ -129,6 +135,61 @@ VsyncModulator::VsyncConfigOpt VsyncModulator::onDisplayRefresh(bool usedGpuComp
     return updateVsyncConfig();
 }
 
+VsyncModulator::VsyncConfigOpt VsyncModulator::onFrameDuration(
+        std::chrono::nanoseconds duration) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mMissedFrameBackoffFrames > 0) {
+        mMissedFrameBackoffFrames--;
+        return std::nullopt;
+    }
+
+    mFrameDurations[mFrameDurationCount++ % mFrameDurations.size()] = duration;
+    if (mFrameDurationCount < mFrameDurations.size()) {
+        return std::nullopt;
+    }
+
+    const VsyncConfig& late = mVsyncConfigSet.late;
+    const auto longest = *std::max_element(mFrameDurations.begin(), mFrameDurations.end());
+    const auto workDuration = std::min(longest + DYNAMIC_SF_WORK_DURATION_MARGIN,
+                                       late.sfWorkDuration);
+    const auto currentWorkDuration =
+            mDynamicLate ? mDynamicLate->sfWorkDuration : late.sfWorkDuration;
+
+    // Wake up earlier as soon as frames get longer, but later only in steps.
+    if (workDuration <= currentWorkDuration &&
+        currentWorkDuration - workDuration < DYNAMIC_SF_WORK_DURATION_STEP) {
+        return std::nullopt;
+    }
+
+    if (workDuration == late.sfWorkDuration) {
+        mDynamicLate.reset();
+    } else {
+        mDynamicLate = late;
+        mDynamicLate->sfWorkDuration = workDuration;
+    }
+
+    if (mTraceDetailedInfo) {
+        ATRACE_INT64("Vsync-DynamicSfWorkDuration", workDuration.count());
+    }
+    return updateVsyncConfigIfChangedLocked();
+}
+
+VsyncModulator::VsyncConfigOpt VsyncModulator::onFrameMissed() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mMissedFrameBackoffFrames = MISSED_FRAME_BACKOFF_FRAMES;
+    resetFrameDurationsLocked();
+    if (!mDynamicLate) {
+        return std::nullopt;
+    }
+
+    mDynamicLate.reset();
+    return updateVsyncConfigIfChangedLocked();
+}
+
+void VsyncModulator::resetFrameDurationsLocked() {
+    mFrameDurationCount = 0;
+}
+
 VsyncModulator::VsyncConfig VsyncModulator::getVsyncConfig() const {
     std::lock_guard<std::mutex> lock(mMutex);
     return mVsyncConfig;
@@ -142,6 +203,8 @@ const VsyncModulator::VsyncConfig& VsyncModulator::getNextVsyncConfig() const {
         return mVsyncConfigSet.early;
     } else if (mEarlyGpuFrames > 0) {
         return mVsyncConfigSet.earlyGpu;
+    } else if (mDynamicLate) {
+        return *mDynamicLate;
     } else {
         return mVsyncConfigSet.late;
     }
@@ -159,7 +222,8 @@ VsyncModulator::VsyncConfig VsyncModulator::updateVsyncConfigLocked() {
     if (mTraceDetailedInfo) {
         const bool isEarly = &offsets == &mVsyncConfigSet.early;
         const bool isEarlyGpu = &offsets == &mVsyncConfigSet.earlyGpu;
-        const bool isLate = &offsets == &mVsyncConfigSet.late;
+        const bool isLate = &offsets == &mVsyncConfigSet.late ||
+                (mDynamicLate && &offsets == &*mDynamicLate);
 
         ATRACE_INT("Vsync-EarlyOffsetsOn", isEarly);
         ATRACE_INT("Vsync-EarlyGpuOffsetsOn", isEarlyGpu);
@@ -169,6 +233,15 @@ VsyncModulator::VsyncConfig VsyncModulator::updateVsyncConfigLocked() {
     return offsets;
 }
 
+VsyncModulator::VsyncConfigOpt VsyncModulator::updateVsyncConfigIfChangedLocked() {
+    const VsyncConfig previous = mVsyncConfig;
+    const VsyncConfig next = updateVsyncConfigLocked();
+    if (next == previous) {
+        return std::nullopt;
+    }
+    return next;
+}
+
 void VsyncModulator::binderDied(const wp<IBinder>& who) {
     std::lock_guard<std::mutex> lock(mMutex);
     mEarlyWakeupRequests.erase(who);
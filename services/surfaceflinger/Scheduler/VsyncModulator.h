@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <array>
 #include <chrono>
 #include <mutex>
 #include <optional>
@@ -49,6 +50,19 @@ public:
     // This may keep early offsets for an extra frame, but avoids a race with transaction commit.
     static const std::chrono::nanoseconds MIN_EARLY_TRANSACTION_TIME;
 
+    // Number of frames whose duration is considered to shorten the late SF work duration.
+    static constexpr size_t DYNAMIC_SF_WORK_DURATION_FRAMES = 30;
+
+    // Number of frames to keep the configured late SF work duration after a missed frame.
+    static constexpr int MISSED_FRAME_BACKOFF_FRAMES = 60;
+
+    // Headroom kept on top of the longest recent frame when shortening the late SF work duration.
+    static const std::chrono::nanoseconds DYNAMIC_SF_WORK_DURATION_MARGIN;
+
+    // Minimum amount by which the late SF work duration is shortened at a time, so that the
+    // callbacks aren't rescheduled for every small change in frame duration.
+    static const std::chrono::nanoseconds DYNAMIC_SF_WORK_DURATION_STEP;
+
     // Phase offsets and work durations for SF and app deadlines from VSYNC.
     struct VsyncConfig {
         nsecs_t sfOffset;
@@ -107,6 +121,15 @@ public:
 
     [[nodiscard]] VsyncConfigOpt onDisplayRefresh(bool usedGpuComposition);
 
+    // Called with the time SF took from waking up to presenting a frame. Once the recent frames
+    // are known to need less than the late SF work duration, SF wakes up later for late frames,
+    // shortening the latency from latch to present.
+    [[nodiscard]] VsyncConfigOpt onFrameDuration(std::chrono::nanoseconds);
+
+    // Called when a frame missed its present time, to go back to the configured late SF work
+    // duration for a while.
+    [[nodiscard]] VsyncConfigOpt onFrameMissed();
+
 protected:
     // Called from unit tests as well
     void binderDied(const wp<IBinder>&) override EXCLUDES(mMutex);
@@ -115,12 +138,22 @@ private:
     const VsyncConfig& getNextVsyncConfig() const REQUIRES(mMutex);
     [[nodiscard]] VsyncConfig updateVsyncConfig() EXCLUDES(mMutex);
     [[nodiscard]] VsyncConfig updateVsyncConfigLocked() REQUIRES(mMutex);
+    [[nodiscard]] VsyncConfigOpt updateVsyncConfigIfChangedLocked() REQUIRES(mMutex);
+    void resetFrameDurationsLocked() REQUIRES(mMutex);
 
     mutable std::mutex mMutex;
     VsyncConfigSet mVsyncConfigSet GUARDED_BY(mMutex);
 
     VsyncConfig mVsyncConfig GUARDED_BY(mMutex){mVsyncConfigSet.late};
 
+    // The late config with the work duration SF actually needs, if shorter than configured.
+    std::optional<VsyncConfig> mDynamicLate GUARDED_BY(mMutex);
+
+    std::array<std::chrono::nanoseconds, DYNAMIC_SF_WORK_DURATION_FRAMES> mFrameDurations
+            GUARDED_BY(mMutex);
+    size_t mFrameDurationCount GUARDED_BY(mMutex) = 0;
+    int mMissedFrameBackoffFrames GUARDED_BY(mMutex) = 0;
+
     using Schedule = TransactionSchedule;
     std::atomic<Schedule> mTransactionSchedule = Schedule::Late;
 
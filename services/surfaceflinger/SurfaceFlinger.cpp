@@ -82,6 +82,7 @@
 #include <ui/DisplayState.h>
 #include <ui/DynamicDisplayInfo.h>
 #include <ui/GraphicBufferAllocator.h>
+#include <ui/GraphicBufferMapper.h>
 #include <ui/PixelFormat.h>
 #include <ui/StaticDisplayInfo.h>
 #include <utils/StopWatch.h>
@@ -96,6 +97,7 @@
 #include <cmath>
 #include <cstdint>
 #include <functional>
+#include <future>
 #include <mutex>
 #include <optional>
 #include <type_traits>
@@ -124,6 +126,7 @@
 #include "Layer.h"
 #include "LayerRenderArea.h"
 #include "LayerVector.h"
+#include "LayerWorkerPool.h"
 #include "MonitoredProducer.h"
 #include "NativeWindowSurface.h"
 #include "RefreshRateOverlay.h"
@@ -139,6 +142,7 @@
 #include "SurfaceFlingerProperties.h"
 #include "SurfaceInterceptor.h"
 #include "TimeStats/TimeStats.h"
+#include "TransactionFenceListener.h"
 #include "TunnelModeEnabledReporter.h"
 #include "android-base/parseint.h"
 #include "android-base/stringprintf.h"
@@ -615,6 +619,12 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
         return base::GetBoolProperty(std::string("debug.sf.enable_layer_caching"), enable);
     }();
 
+    mPartialClientCompositionEnabled =
+            base::GetBoolProperty("debug.sf.enable_partial_client_composition"s, false);
+
+    mDynamicSfWorkDurationEnabled =
+            base::GetBoolProperty("debug.sf.enable_dynamic_sf_work_duration"s, false);
+
     useContextPriority = use_context_priority(true);
 
     using Values = SurfaceFlingerProperties::primary_display_orientation_values;
@@ -663,6 +673,16 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     ALOGI_IF(mPropagateBackpressureClientComposition,
              "Enabling backpressure propagation for Client Composition");
 
+    mPipelinedComposition = base::GetBoolProperty("debug.sf.pipelined_composition"s, false);
+    ALOGI_IF(mPipelinedComposition, "Enabling pipelined composition");
+
+    mEarlyBufferRelease = base::GetBoolProperty("debug.sf.early_buffer_release"s, false);
+    ALOGI_IF(mEarlyBufferRelease, "Enabling early buffer release");
+
+    if (base::GetBoolProperty("debug.sf.enable_transaction_tracing"s, true)) {
+        mTransactionTracing = std::make_unique<TransactionTracing>();
+    }
+
     property_get("ro.surface_flinger.supports_background_blur", value, "0");
     bool supportsBlurs = atoi(value);
     mSupportsBlur = supportsBlurs;
@@ -773,6 +793,8 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
 #endif
 
     enableLatchUnsignaled = base::GetBoolProperty("debug.sf.latch_unsignaled"s, false);
+
+    mLayerWorkerThreadCount = base::GetUintProperty<size_t>("debug.sf.layer_worker_threads"s, 0);
 }
 
 SurfaceFlinger::~SurfaceFlinger() {
@@ -793,7 +815,10 @@ void SurfaceFlinger::binderDied(const wp<IBinder>&) {
     mBootFinished = false;
 
     // Sever the link to inputflinger since its gone as well.
-    static_cast<void>(schedule([=] { mInputFlinger = nullptr; }));
+    static_cast<void>(schedule([=] {
+        mInputFlinger = nullptr;
+        mLastInputWindowInfos.clear();
+    }));
 
     // restore initial conditions (default device unblank, etc)
     initializeDisplays();
@@ -1019,6 +1044,7 @@ void SurfaceFlinger::bootFinished() {
             ALOGE("Failed to link to input service");
         } else {
             mInputFlinger = interface_cast<os::IInputFlinger>(input);
+            mLastInputWindowInfos.clear();
         }
 
         readPersistentProperties();
@@ -1088,22 +1114,33 @@ void SurfaceFlinger::init() {
     Mutex::Autolock _l(mStateLock);
 
     InitComposerExtn();
+
+    // Connecting to the composer HAL doesn't depend on RenderEngine, and both take a significant
+    // part of boot time, so connect on another thread while RenderEngine sets up its context.
+    auto hwComposerFuture = std::async(std::launch::async, [this] {
+        ATRACE_NAME("SurfaceFlinger::init createHWComposer");
+        return getFactory().createHWComposer(mHwcServiceName);
+    });
+
     // Get a RenderEngine for the given display / config (can't fail)
     // TODO(b/77156734): We need to stop casting and use HAL types when possible.
     // Sending maxFrameBufferAcquiredBuffers as the cache size is tightly tuned to single-display.
-    mCompositionEngine->setRenderEngine(renderengine::RenderEngine::create(
-            renderengine::RenderEngineCreationArgs::Builder()
-                    .setPixelFormat(static_cast<int32_t>(defaultCompositionPixelFormat))
-                    .setImageCacheSize(maxFrameBufferAcquiredBuffers)
-                    .setUseColorManagerment(useColorManagement)
-                    .setEnableProtectedContext(enable_protected_contents(false))
-                    .setPrecacheToneMapperShaderOnly(false)
-                    .setSupportsBackgroundBlur(mSupportsBlur)
-                    .setContextPriority(
-                            useContextPriority
-                                    ? renderengine::RenderEngine::ContextPriority::REALTIME
-                                    : renderengine::RenderEngine::ContextPriority::MEDIUM)
-                    .build()));
+    {
+        ATRACE_NAME("SurfaceFlinger::init createRenderEngine");
+        mCompositionEngine->setRenderEngine(renderengine::RenderEngine::create(
+                renderengine::RenderEngineCreationArgs::Builder()
+                        .setPixelFormat(static_cast<int32_t>(defaultCompositionPixelFormat))
+                        .setImageCacheSize(maxFrameBufferAcquiredBuffers)
+                        .setUseColorManagerment(useColorManagement)
+                        .setEnableProtectedContext(enable_protected_contents(false))
+                        .setPrecacheToneMapperShaderOnly(false)
+                        .setSupportsBackgroundBlur(mSupportsBlur)
+                        .setContextPriority(
+                                useContextPriority
+                                        ? renderengine::RenderEngine::ContextPriority::REALTIME
+                                        : renderengine::RenderEngine::ContextPriority::MEDIUM)
+                        .build()));
+    }
 
     // Set SF main policy after initializing RenderEngine which has its own policy.
     if (!SetTaskProfiles(0, {"SFMainPolicy"})) {
@@ -1111,7 +1148,10 @@ void SurfaceFlinger::init() {
     }
 
     mCompositionEngine->setTimeStats(mTimeStats);
-    mCompositionEngine->setHwComposer(getFactory().createHWComposer(mHwcServiceName));
+    {
+        ATRACE_NAME("SurfaceFlinger::init waitForHWComposer");
+        mCompositionEngine->setHwComposer(hwComposerFuture.get());
+    }
     mCompositionEngine->getHwComposer().setCallback(this);
     ClientCache::getInstance().setRenderEngine(&getRenderEngine());
 
@@ -1120,7 +1160,10 @@ void SurfaceFlinger::init() {
     }
 
     // Process any initial hotplug and resulting display changes.
-    processDisplayHotplugEventsLocked();
+    {
+        ATRACE_NAME("SurfaceFlinger::init processDisplayHotplugEvents");
+        processDisplayHotplugEventsLocked();
+    }
     const auto display = getDefaultDisplayDeviceLocked();
     LOG_ALWAYS_FATAL_IF(!display, "Missing internal display after registering composer callback.");
     const auto displayId = display->getPhysicalId();
@@ -1140,7 +1183,10 @@ void SurfaceFlinger::init() {
     mDrawingState = mCurrentState;
 
     // set initial conditions (e.g. unblank default device)
-    initializeDisplays();
+    {
+        ATRACE_NAME("SurfaceFlinger::init initializeDisplays");
+        initializeDisplays();
+    }
 
     mPowerAdvisor.init();
 
@@ -1220,6 +1266,12 @@ void SurfaceFlinger::init() {
     mRETid = getRenderEngine().getRETid();
     mSFTid = gettid();
 
+    std::vector<int32_t> powerHintSessionThreadIds = {mSFTid};
+    if (mRETid > 0 && mRETid != mSFTid) {
+        powerHintSessionThreadIds.push_back(mRETid);
+    }
+    mPowerAdvisor.setPowerHintSessionThreadIds(powerHintSessionThreadIds);
+
     ALOGV("Done initializing");
 }
 
@@ -2039,12 +2091,28 @@ status_t SurfaceFlinger::injectVSync(nsecs_t when) {
 }
 
 status_t SurfaceFlinger::getLayerDebugInfo(std::vector<LayerDebugInfo>* outLayers) {
+    std::shared_ptr<const LayerDebugInfoSnapshot> snapshot;
+    {
+        std::lock_guard lock(mLayerDebugInfoSnapshotMutex);
+        snapshot = mLayerDebugInfoSnapshot;
+    }
+    if (snapshot && snapshot->generation == mDrawingStateGeneration) {
+        *outLayers = snapshot->layers;
+        return NO_ERROR;
+    }
+
     outLayers->clear();
     schedule([=] {
+        auto newSnapshot = std::make_shared<LayerDebugInfoSnapshot>();
+        newSnapshot->generation = mDrawingStateGeneration;
         const auto display = ON_MAIN_THREAD(getDefaultDisplayDeviceLocked());
         mDrawingState.traverseInZOrder([&](Layer* layer) {
-            outLayers->push_back(layer->getLayerDebugInfo(display.get()));
+            newSnapshot->layers.push_back(layer->getLayerDebugInfo(display.get()));
         });
+        *outLayers = newSnapshot->layers;
+
+        std::lock_guard lock(mLayerDebugInfoSnapshotMutex);
+        mLayerDebugInfoSnapshot = std::move(newSnapshot);
     }).wait();
     return NO_ERROR;
 }
@@ -2419,10 +2487,7 @@ SurfaceFlinger::FenceWithFenceTime SurfaceFlinger::previousFrameFence() {
                                                            : mPreviousPresentFences[1];
 }
 
-bool SurfaceFlinger::previousFramePending(int graceTimeMs) {
-    ATRACE_CALL();
-    const std::shared_ptr<FenceTime>& fence = previousFrameFence().fenceTime;
-
+static bool isFencePending(const std::shared_ptr<FenceTime>& fence, int graceTimeMs) {
     if (fence == FenceTime::NO_FENCE) {
         return false;
     }
@@ -2433,6 +2498,22 @@ bool SurfaceFlinger::previousFramePending(int graceTimeMs) {
     return status == -ETIME;
 }
 
+bool SurfaceFlinger::previousFramePending(int graceTimeMs) {
+    ATRACE_CALL();
+    return isFencePending(previousFrameFence().fenceTime, graceTimeMs);
+}
+
+bool SurfaceFlinger::pipelineFull(int graceTimeMs) {
+    if (!mPipelinedComposition) {
+        return previousFramePending(graceTimeMs);
+    }
+    ATRACE_CALL();
+    // mPreviousPresentFences[1] is the frame before the previous one, which is already what
+    // previousFrameFence() waits on for negative offsets. No older fence is kept, so those
+    // don't get an extra frame in flight.
+    return isFencePending(mPreviousPresentFences[1].fenceTime, graceTimeMs);
+}
+
 nsecs_t SurfaceFlinger::previousFramePresentTime() {
     const std::shared_ptr<FenceTime>& fence = previousFrameFence().fenceTime;
 
@@ -2546,9 +2627,19 @@ void SurfaceFlinger::onMessageInvalidate(int64_t vsyncId, nsecs_t expectedVSyncT
             ? 1
             : 0;
 
-    // Pending frames may trigger backpressure propagation.
+    // Pending frames may trigger backpressure propagation. With pipelined composition the
+    // previous frame is allowed to still be pending, so only wait for the grace period on the
+    // frame that can actually hold this one back.
     const TracedOrdinal<bool> framePending = {"PrevFramePending",
-                                              previousFramePending(graceTimeForPresentFenceMs)};
+                                              previousFramePending(
+                                                      mPipelinedComposition
+                                                              ? 0
+                                                              : graceTimeForPresentFenceMs)};
+    const TracedOrdinal<bool> framePipelineFull = {"PipelineFull",
+                                                   mPipelinedComposition
+                                                           ? pipelineFull(
+                                                                     graceTimeForPresentFenceMs)
+                                                           : framePending};
 
     // Frame missed counts for metrics tracking.
     // A frame is missed if the prior frame is still pending. If no longer pending,
@@ -2575,6 +2666,9 @@ void SurfaceFlinger::onMessageInvalidate(int64_t vsyncId, nsecs_t expectedVSyncT
     if (frameMissed) {
         mFrameMissedCount++;
         mTimeStats->incrementMissedFrames();
+        if (mDynamicSfWorkDurationEnabled) {
+            modulateVsync(&VsyncModulator::onFrameMissed);
+        }
     }
 
     if (hwcFrameMissed) {
@@ -2599,7 +2693,7 @@ void SurfaceFlinger::onMessageInvalidate(int64_t vsyncId, nsecs_t expectedVSyncT
         ON_MAIN_THREAD(setActiveModeInternal());
     }
 
-    if (framePending && mPropagateBackpressure) {
+    if (framePipelineFull && mPropagateBackpressure) {
         if ((hwcFrameMissed && !gpuFrameMissed) || mPropagateBackpressureClientComposition) {
             signalLayerUpdate();
             return;
@@ -2629,6 +2723,9 @@ void SurfaceFlinger::onMessageInvalidate(int64_t vsyncId, nsecs_t expectedVSyncT
 
         refreshNeeded = handleMessageTransaction();
         refreshNeeded |= handleMessageInvalidate();
+        if (refreshNeeded) {
+            mDrawingStateGeneration++;
+        }
         if (tracePreComposition) {
             if (mVisibleRegionsDirty) {
                 mTracing.notifyLocked("visibleRegionsDirty");
@@ -2709,10 +2806,10 @@ void SurfaceFlinger::onMessageRefresh() {
     for (const auto& [_, display] : displays) {
         refreshArgs.outputs.push_back(display->getCompositionDisplay());
     }
-    mDrawingState.traverseInZOrder([&refreshArgs](Layer* layer) {
+    for (const auto& layer : getDrawingLayersInZOrder()) {
         if (auto layerFE = layer->getCompositionEngineLayerFE())
             refreshArgs.layers.push_back(layerFE);
-    });
+    }
     refreshArgs.layersWithQueuedFrames.reserve(mLayersWithQueuedFrames.size());
     for (auto layer : mLayersWithQueuedFrames) {
         if (auto layerFE = layer->getCompositionEngineLayerFE())
@@ -2749,6 +2846,16 @@ void SurfaceFlinger::onMessageRefresh() {
     refreshArgs.previousPresentFence = mPreviousPresentFences[0].fenceTime;
     refreshArgs.nextInvalidateTime = mEventQueue->nextExpectedInvalidate();
 
+    if (mLayerWorkerThreadCount > 0 && refreshArgs.outputs.size() > 1) {
+        if (!mLayerWorkerPool) {
+            mLayerWorkerPool = std::make_unique<LayerWorkerPool>(mLayerWorkerThreadCount);
+        }
+        refreshArgs.runConcurrently = [this](size_t count,
+                                             const std::function<void(size_t)>& work) {
+            mLayerWorkerPool->run(count, work);
+        };
+    }
+
     mGeometryInvalid = false;
 
     // Store the present time just before calling to the composition engine so we could notify
@@ -2762,7 +2869,12 @@ void SurfaceFlinger::onMessageRefresh() {
       }
     }
     mCompositionEngine->present(refreshArgs);
-    mTimeStats->recordFrameDuration(mFrameStartTime, systemTime());
+    const nsecs_t frameEndTime = systemTime();
+    mTimeStats->recordFrameDuration(mFrameStartTime, frameEndTime);
+    if (mDynamicSfWorkDurationEnabled && mFrameStartTime > 0) {
+        modulateVsync(&VsyncModulator::onFrameDuration,
+                      std::chrono::nanoseconds(frameEndTime - mFrameStartTime));
+    }
     // Reset the frame start time now that we've recorded this frame.
     mFrameStartTime = 0;
     mScheduler->onDisplayRefreshed(presentTime);
@@ -2795,6 +2907,10 @@ void SurfaceFlinger::onMessageRefresh() {
     modulateVsync(&VsyncModulator::onDisplayRefresh, usedGpuComposition);
 
     mLayersWithQueuedFrames.clear();
+    if (mVisibleRegionsDirty) {
+        // Composition recomputed the visible regions.
+        mGeometryGeneration++;
+    }
     if (mTracingEnabled && mTracePostComposition) {
         // This may block if SurfaceTracing is running in sync mode.
         if (mVisibleRegionsDirty) {
@@ -2807,6 +2923,9 @@ void SurfaceFlinger::onMessageRefresh() {
     mVisibleRegionsWereDirtyThisFrame = mVisibleRegionsDirty; // Cache value for use in post-comp
     mVisibleRegionsDirty = false;
 
+    // Composition updates what the layers report about themselves, such as their visible regions.
+    mDrawingStateGeneration++;
+
     if (mCompositionEngine->needsAnotherUpdate()) {
         signalLayerUpdate();
     }
@@ -2821,6 +2940,7 @@ bool SurfaceFlinger::handleMessageInvalidate() {
 
     if (mVisibleRegionsDirty) {
         computeLayerBounds();
+        mGeometryGeneration++;
     }
 
     for (auto& layer : mLayersPendingRefresh) {
@@ -2990,6 +3110,14 @@ void SurfaceFlinger::postComposition() {
     mFrameTimeline->setSfPresent(/* sfPresentTime */ now, mPreviousPresentFences[0].fenceTime,
                                  glCompositionDoneFenceTime);
 
+    // The predicted timeline of the frame spans the work duration SurfaceFlinger was scheduled for,
+    // from its wake-up until the frame had to be sent to the display.
+    if (const auto timelines = mFrameTimeline->getLastSfTimelines()) {
+        const auto& [predictions, actuals] = *timelines;
+        mPowerAdvisor.reportWorkDuration(predictions.endTime - predictions.startTime,
+                                         actuals.endTime - actuals.startTime, actuals.endTime);
+    }
+
     const DisplayStatInfo stats = mScheduler->getDisplayStatInfo(now);
 
     // We use the CompositionEngine::getLastFrameRefreshTimestamp() which might
@@ -3012,6 +3140,7 @@ void SurfaceFlinger::postComposition() {
             recordBufferingStats(layer->getName(), layer->getOccupancyHistory(false));
         }
     }
+    mFrameTracer->commitFrame();
 
     std::vector<std::pair<std::shared_ptr<compositionengine::Display>, sp<HdrLayerInfoReporter>>>
             hdrInfoListeners;
@@ -3221,18 +3350,52 @@ FloatRect SurfaceFlinger::getLayerClipBoundsForDisplay(const DisplayDevice& disp
 }
 
 void SurfaceFlinger::computeLayerBounds() {
+    // Only worth waking up the workers when there are many layers.
+    static constexpr size_t kMinLayersForWorkers = 64;
+    const bool useWorkers = mLayerWorkerThreadCount > 0 && mNumLayers >= kMinLayersForWorkers;
+    if (useWorkers && !mLayerWorkerPool) {
+        // Created here rather than in the constructor so that the workers
+        // inherit the main thread's SCHED_FIFO policy.
+        mLayerWorkerPool = std::make_unique<LayerWorkerPool>(mLayerWorkerThreadCount);
+    }
+
+    if (mLayerBoundsNeedFullUpdate) {
+        // The hierarchy or the displays changed, which computeBounds() can't
+        // tell from the layers it visits.
+        for (const auto& layer : mDrawingState.layersSortedByZ) {
+            layer->invalidateBounds();
+        }
+        mLayerBoundsNeedFullUpdate = false;
+    }
+
+    std::vector<Layer*> roots;
     for (const auto& pair : ON_MAIN_THREAD(mDisplays)) {
         const auto& displayDevice = pair.second;
         const auto display = displayDevice->getCompositionDisplay();
+        const FloatRect clipBounds = getLayerClipBoundsForDisplay(*displayDevice);
+        roots.clear();
         for (const auto& layer : mDrawingState.layersSortedByZ) {
             // only consider the layers on the given layer stack
             if (!display->belongsInOutput(layer->getLayerStack(), layer->getPrimaryDisplayOnly())) {
                 continue;
             }
 
-            layer->computeBounds(getLayerClipBoundsForDisplay(*displayDevice), ui::Transform(),
-                                 0.f /* shadowRadius */);
+            if (!useWorkers) {
+                layer->computeBounds(clipBounds, ui::Transform(), 0.f /* shadowRadius */);
+                continue;
+            }
+            roots.push_back(layer.get());
+        }
+
+        // Bounds only flow from parent to child, so each root's subtree can be
+        // computed on its own. Displays are still computed one after another,
+        // so the last display a layer is on wins like it does above.
+        if (!useWorkers) {
+            continue;
         }
+        mLayerWorkerPool->run(roots.size(), [&](size_t i) {
+            roots[i]->computeBounds(clipBounds, ui::Transform(), 0.f /* shadowRadius */);
+        });
     }
 }
 
@@ -3638,6 +3801,7 @@ void SurfaceFlinger::processDisplayAdded(const wp<IBinder>& displayToken,
     builder.setDisplayExtnIntf(mDisplayExtnIntf);
     auto compositionDisplay = getCompositionEngine().createDisplay(builder.build());
     compositionDisplay->setLayerCachingEnabled(mLayerCachingEnabled);
+    compositionDisplay->setPartialClientCompositionEnabled(mPartialClientCompositionEnabled);
 
     sp<compositionengine::DisplaySurface> displaySurface;
     sp<IGraphicBufferProducer> producer;
@@ -3925,9 +4089,13 @@ void SurfaceFlinger::handleTransactionLocked(uint32_t transactionFlags) {
     }
     mForceTraversal = false;
     mForceTransactionDisplayChange = displayTransactionNeeded;
+    if (displayTransactionNeeded) {
+        mLayerBoundsNeedFullUpdate = true;
+    }
 
     if (mSomeChildrenChanged) {
         mVisibleRegionsDirty = true;
+        mLayerBoundsNeedFullUpdate = true;
         mSomeChildrenChanged = false;
     }
 
@@ -4008,6 +4176,7 @@ void SurfaceFlinger::handleTransactionLocked(uint32_t transactionFlags) {
         mLayersAdded = false;
         // Layers have been added.
         mVisibleRegionsDirty = true;
+        mLayerBoundsNeedFullUpdate = true;
     }
 
     // some layers might have been removed, so
@@ -4015,6 +4184,7 @@ void SurfaceFlinger::handleTransactionLocked(uint32_t transactionFlags) {
     if (mLayersRemoved) {
         mLayersRemoved = false;
         mVisibleRegionsDirty = true;
+        mLayerBoundsNeedFullUpdate = true;
         mDrawingState.traverseInZOrder([&](Layer* layer) {
             if (mLayersPendingRemoval.indexOf(layer) >= 0) {
                 // this layer is not visible anymore
@@ -4058,8 +4228,10 @@ bool enablePerWindowInputRotation() {
 void SurfaceFlinger::updateInputWindowInfo() {
     std::vector<InputWindowInfo> inputInfos;
 
-    mDrawingState.traverseInReverseZOrder([&](Layer* layer) {
-        if (!layer->needsInputInfo()) return;
+    const auto& layersInZOrder = getDrawingLayersInZOrder();
+    for (auto it = layersInZOrder.rbegin(); it != layersInZOrder.rend(); ++it) {
+        Layer* layer = it->get();
+        if (!layer->needsInputInfo()) continue;
         sp<DisplayDevice> display;
         if (enablePerWindowInputRotation()) {
             for (const auto& pair : ON_MAIN_THREAD(mDisplays)) {
@@ -4075,11 +4247,21 @@ void SurfaceFlinger::updateInputWindowInfo() {
         // When calculating the screen bounds we ignore the transparent region since it may
         // result in an unwanted offset.
         inputInfos.push_back(layer->fillInputInfo(display));
-    });
+    }
+
+    // Geometry changes rebuild the list even if none of them affect input, for example when a
+    // layer without input info animates. Skip sending and processing the same list again.
+    if (inputInfos == mLastInputWindowInfos) {
+        if (mInputWindowCommands.syncInputWindows) {
+            setInputWindowsFinished();
+        }
+        return;
+    }
 
     mInputFlinger->setInputWindows(inputInfos,
                                mInputWindowCommands.syncInputWindows ? mSetInputWindowsListener
                                                                      : nullptr);
+    mLastInputWindowInfos = std::move(inputInfos);
 }
 
 void SurfaceFlinger::updateCursorAsync() {
@@ -4238,6 +4420,22 @@ void SurfaceFlinger::commitTransactionLocked() {
     if (mNumClones > 0) {
         mDrawingState.traverse([&](Layer* layer) { layer->updateMirrorInfo(); });
     }
+    invalidateDrawingLayersInZOrder();
+}
+
+const std::vector<sp<Layer>>& SurfaceFlinger::getDrawingLayersInZOrder() {
+    if (!mDrawingLayersInZOrderValid) {
+        mDrawingState.traverseInZOrder(
+                [&](Layer* layer) { mDrawingLayersInZOrder.push_back(layer); });
+        mDrawingLayersInZOrderValid = true;
+    }
+    return mDrawingLayersInZOrder;
+}
+
+void SurfaceFlinger::invalidateDrawingLayersInZOrder() {
+    // clear() keeps the capacity, so the list is rebuilt without allocating in steady state.
+    mDrawingLayersInZOrder.clear();
+    mDrawingLayersInZOrderValid = false;
 }
 
 void SurfaceFlinger::commitOffscreenLayers() {
@@ -4457,14 +4655,25 @@ void SurfaceFlinger::flushTransactionQueues() {
             while (it != mPendingTransactionQueues.end()) {
                 auto& [applyToken, transactionQueue] = *it;
 
+                // Nothing changed for this queue since its fence was last found unsignaled.
+                if (mPendingTransactionsWaitingOnFence.count(applyToken) != 0) {
+                    it = std::next(it, 1);
+                    continue;
+                }
+
                 while (!transactionQueue.empty()) {
                     auto& transaction = transactionQueue.front();
+                    sp<Fence> unsignaledFence;
                     if (!transactionIsReadyToBeApplied(transaction.frameTimelineInfo,
                                                        transaction.isAutoTimestamp,
                                                        transaction.desiredPresentTime,
                                                        transaction.originUid, transaction.states,
-                                                       bufferLayersReadyToPresent)) {
-                        setTransactionFlags(eTransactionFlushNeeded);
+                                                       bufferLayersReadyToPresent,
+                                                       &unsignaledFence)) {
+                        if (!unsignaledFence ||
+                            !waitForUnsignaledFence(applyToken, unsignaledFence)) {
+                            setTransactionFlags(eTransactionFlushNeeded);
+                        }
                         break;
                     }
                     transaction.traverseStatesWithBuffers([&](const layer_state_t& state) {
@@ -4490,12 +4699,16 @@ void SurfaceFlinger::flushTransactionQueues() {
                 auto& transaction = mTransactionQueue.front();
                 bool pendingTransactions = mPendingTransactionQueues.find(transaction.applyToken) !=
                         mPendingTransactionQueues.end();
+                sp<Fence> unsignaledFence;
                 if (pendingTransactions ||
                     !transactionIsReadyToBeApplied(transaction.frameTimelineInfo,
                                                    transaction.isAutoTimestamp,
                                                    transaction.desiredPresentTime,
                                                    transaction.originUid, transaction.states,
-                                                   bufferLayersReadyToPresent)) {
+                                                   bufferLayersReadyToPresent, &unsignaledFence)) {
+                    if (unsignaledFence) {
+                        waitForUnsignaledFence(transaction.applyToken, unsignaledFence);
+                    }
                     mPendingTransactionQueues[transaction.applyToken].push(std::move(transaction));
                 } else {
                     transaction.traverseStatesWithBuffers([&](const layer_state_t& state) {
@@ -4527,7 +4740,31 @@ void SurfaceFlinger::flushTransactionQueues() {
 
 bool SurfaceFlinger::transactionFlushNeeded() {
     Mutex::Autolock _l(mQueueLock);
-    return !mPendingTransactionQueues.empty() || !mTransactionQueue.empty();
+    // Only pending queues that aren't waiting on a fence need to be checked on the next frame.
+    // The ones that are get flushed from the fence listener once it signals.
+    return mPendingTransactionQueues.size() > mPendingTransactionsWaitingOnFence.size() ||
+            !mTransactionQueue.empty();
+}
+
+bool SurfaceFlinger::waitForUnsignaledFence(const sp<IBinder>& applyToken,
+                                            const sp<Fence>& fence) {
+    if (!mTransactionFenceListener) {
+        mTransactionFenceListener =
+                std::make_unique<TransactionFenceListener>([this](const sp<IBinder>& token) {
+                    {
+                        Mutex::Autolock _l(mQueueLock);
+                        mPendingTransactionsWaitingOnFence.erase(token);
+                    }
+                    setTransactionFlags(eTransactionFlushNeeded);
+                });
+    }
+
+    // The callback can't run before the token is in the index, since it needs mQueueLock.
+    if (!mTransactionFenceListener->listen(fence, applyToken)) {
+        return false;
+    }
+    mPendingTransactionsWaitingOnFence.insert(applyToken);
+    return true;
 }
 
 bool SurfaceFlinger::frameIsEarly(nsecs_t expectedPresentTime, int64_t vsyncId) const {
@@ -4556,7 +4793,8 @@ bool SurfaceFlinger::transactionIsReadyToBeApplied(
         const FrameTimelineInfo& info, bool isAutoTimestamp, int64_t desiredPresentTime,
         uid_t originUid, const Vector<ComposerState>& states,
         const std::unordered_set<sp<IBinder>, ISurfaceComposer::SpHash<IBinder>>&
-                bufferLayersReadyToPresent) const {
+                bufferLayersReadyToPresent,
+        sp<Fence>* outUnsignaledFence) const {
     ATRACE_CALL();
     const nsecs_t expectedPresentTime = mExpectedPresentTime.load();
     // Do not present if the desiredPresentTime has not passed unless it is more than one second
@@ -4585,6 +4823,9 @@ bool SurfaceFlinger::transactionIsReadyToBeApplied(
         if (acquireFenceChanged && s.acquireFence && !enableLatchUnsignaled &&
             s.acquireFence->getStatus() == Fence::Status::Unsignaled) {
             ATRACE_NAME("fence unsignaled");
+            if (outUnsignaledFence) {
+                *outUnsignaledFence = s.acquireFence;
+            }
             return false;
         }
 
@@ -4714,6 +4955,9 @@ status_t SurfaceFlinger::setTransactionState(
     IPCThreadState* ipc = IPCThreadState::self();
     const int originPid = ipc->getCallingPid();
     const int originUid = ipc->getCallingUid();
+    if (mTransactionTracing) {
+        mTransactionTracing->addTransaction(states, flags, originPid, originUid, transactionId);
+    }
     TransactionState state{frameTimelineInfo,  states,
                            displays,           flags,
                            applyToken,         inputWindowCommands,
@@ -4735,6 +4979,14 @@ status_t SurfaceFlinger::setTransactionState(
         }
         mBufferCountTracker.increment(state.surface->localBinder());
     });
+
+    for (const ComposerState& composerState : state.states) {
+        const layer_state_t& s = composerState.state;
+        if ((s.what & layer_state_t::eBufferChanged) && s.buffer != nullptr) {
+            state.importedBuffers.push_back(std::make_shared<renderengine::ExternalTexture>(
+                    s.buffer, getRenderEngine(), renderengine::ExternalTexture::Usage::READABLE));
+        }
+    }
     queueTransaction(state);
 
     // Check the pending state to make sure the transaction is synchronous.
@@ -4776,6 +5028,9 @@ void SurfaceFlinger::applyTransactionState(const FrameTimelineInfo& frameTimelin
                                            bool hasListenerCallbacks,
                                            const std::vector<ListenerCallbacks>& listenerCallbacks,
                                            int originPid, int originUid, uint64_t transactionId) {
+    // Layer setters edit the drawing state directly, including Z order and relative parents.
+    invalidateDrawingLayersInZOrder();
+
     uint32_t transactionFlags = 0;
     for (const DisplayState& display : displays) {
         transactionFlags |= setDisplayStateLocked(display);
@@ -5281,8 +5536,7 @@ uint32_t SurfaceFlinger::setClientStateLocked(
     bool cacheIdChanged = what & layer_state_t::eCachedBufferChanged;
     std::shared_ptr<renderengine::ExternalTexture> buffer;
     if (bufferChanged && cacheIdChanged && s.buffer != nullptr) {
-        ClientCache::getInstance().add(s.cachedBuffer, s.buffer);
-        buffer = ClientCache::getInstance().get(s.cachedBuffer);
+        buffer = ClientCache::getInstance().add(s.cachedBuffer, s.buffer);
     } else if (cacheIdChanged) {
         buffer = ClientCache::getInstance().get(s.cachedBuffer);
     } else if (bufferChanged && s.buffer != nullptr) {
@@ -5817,6 +6071,7 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args, bool asProto) {
                       pid, uid);
     } else {
         static const std::unordered_map<std::string, Dumper> dumpers = {
+                {"--buffer-queues"s, dumper(&SurfaceFlinger::dumpBufferQueuesLocked)},
                 {"--display-id"s, dumper(&SurfaceFlinger::dumpDisplayIdentificationData)},
                 {"--dispsync"s, dumper([this](std::string& s) { mScheduler->dumpVsync(s); })},
                 {"--edid"s, argsDumper(&SurfaceFlinger::dumpRawDisplayIdentificationData)},
@@ -5827,6 +6082,7 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args, bool asProto) {
                 {"--planner"s, argsDumper(&SurfaceFlinger::dumpPlannerInfo)},
                 {"--static-screen"s, dumper(&SurfaceFlinger::dumpStaticScreenStats)},
                 {"--timestats"s, protoDumper(&SurfaceFlinger::dumpTimeStats)},
+                {"--transactions"s, dumper(&SurfaceFlinger::dumpTransactionTrace)},
                 {"--vsync"s, dumper(&SurfaceFlinger::dumpVSync)},
                 {"--wide-color"s, dumper(&SurfaceFlinger::dumpWideColorInfo)},
                 {"--frametimeline"s, argsDumper(&SurfaceFlinger::dumpFrameTimeline)},
@@ -6045,6 +6301,16 @@ void SurfaceFlinger::dumpFrameTimeline(const DumpArgs& args, std::string& result
     mFrameTimeline->parseArgs(args, result);
 }
 
+void SurfaceFlinger::dumpTransactionTrace(std::string& result) const {
+    if (!mTransactionTracing) {
+        result.append("Transaction tracing is disabled\n");
+        return;
+    }
+    const status_t status = mTransactionTracing->writeToFile();
+    StringAppendF(&result, "Wrote transaction trace to %s: %s (%d)\n",
+                  TransactionTracing::DEFAULT_FILE_NAME, strerror(-status), status);
+}
+
 // This should only be called from the main thread.  Otherwise it would need
 // the lock and should use mCurrentState rather than mDrawingState.
 void SurfaceFlinger::logFrameStats() {
@@ -6135,6 +6401,11 @@ void SurfaceFlinger::dumpFrameEventsLocked(std::string& result) {
         [&] (Layer* layer) { layer->dumpFrameEvents(result); });
 }
 
+void SurfaceFlinger::dumpBufferQueuesLocked(std::string& result) const {
+    result.append("Layer buffer queues:\n");
+    mCurrentState.traverseInZOrder([&](Layer* layer) { layer->dumpBufferQueue(result); });
+}
+
 void SurfaceFlinger::dumpBufferingStats(std::string& result) const {
     result.append("Buffering stats:\n");
     result.append("  [Layer name] <Active time> <Two buffer> "
@@ -6469,6 +6740,9 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
      * Tracing state
      */
     mTracing.dump(result);
+    if (mTransactionTracing) {
+        mTransactionTracing->dump(result);
+    }
     result.append("\n");
 
     /*
@@ -6510,6 +6784,7 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
      */
     const GraphicBufferAllocator& alloc(GraphicBufferAllocator::get());
     alloc.dump(result);
+    GraphicBufferMapper::get().dumpImportStats(result);
 
     result.append(mTimeStats->miniDump());
     result.append("\n");
@@ -7780,11 +8055,13 @@ status_t SurfaceFlinger::captureScreenCommon(
         renderArea->render([&] {
             result = renderScreenImplLocked(*renderArea, traverseLayers, buffer,
                                             canCaptureBlackoutContent, regionSampling, grayscale,
-                                            captureResults);
+                                            captureResults, captureListener);
         });
 
-        captureResults.result = result;
-        captureListener->onScreenCaptureCompleted(captureResults);
+        if (result != NO_ERROR) {
+            captureResults.result = result;
+            captureListener->onScreenCaptureCompleted(captureResults);
+        }
     }));
 
     return NO_ERROR;
@@ -7794,7 +8071,7 @@ status_t SurfaceFlinger::renderScreenImplLocked(
         const RenderArea& renderArea, TraverseLayersFunction traverseLayers,
         const std::shared_ptr<renderengine::ExternalTexture>& buffer,
         bool canCaptureBlackoutContent, bool regionSampling, bool grayscale,
-        ScreenCaptureResults& captureResults) {
+        ScreenCaptureResults& captureResults, const sp<IScreenCaptureListener>& captureListener) {
     ATRACE_CALL();
 
     traverseLayers([&](Layer* layer) {
@@ -7848,7 +8125,7 @@ status_t SurfaceFlinger::renderScreenImplLocked(
     clientCompositionLayers.push_back(fillLayer);
 
     const auto display = renderArea.getDisplayDevice();
-    std::vector<Layer*> renderedLayers;
+    std::vector<wp<Layer>> renderedLayers;
     Region clearRegion = Region::INVALID_REGION;
     bool disableBlurs = false;
     traverseLayers([&](Layer* layer) {
@@ -7896,33 +8173,40 @@ status_t SurfaceFlinger::renderScreenImplLocked(
 
     });
 
-    std::vector<const renderengine::LayerSettings*> clientCompositionLayerPointers(
-            clientCompositionLayers.size());
-    std::transform(clientCompositionLayers.begin(), clientCompositionLayers.end(),
-                   clientCompositionLayerPointers.begin(),
-                   std::pointer_traits<renderengine::LayerSettings*>::pointer_to);
+    // The layer settings are a snapshot of the layers, so drawing them is left to RenderEngine
+    // while the main thread moves on. RenderEngine runs the draw once it has no frame to draw.
+    std::vector<renderengine::LayerSettings> layerSettings(
+            std::make_move_iterator(clientCompositionLayers.begin()),
+            std::make_move_iterator(clientCompositionLayers.end()));
 
     clientCompositionDisplay.clearRegion = clearRegion;
     // Use an empty fence for the buffer fence, since we just created the buffer so
     // there is no need for synchronization with the GPU.
     base::unique_fd bufferFence;
-    base::unique_fd drawFence;
-    getRenderEngine().useProtectedContext(useProtected);
-
-    const constexpr bool kUseFramebufferCache = false;
-    getRenderEngine().drawLayers(clientCompositionDisplay, clientCompositionLayerPointers, buffer,
-                                 kUseFramebufferCache, std::move(bufferFence), &drawFence);
-
-    if (drawFence >= 0) {
-        sp<Fence> releaseFence = new Fence(dup(drawFence));
-        for (auto* layer : renderedLayers) {
-            layer->onLayerDisplayed(releaseFence);
-        }
-    }
+    getRenderEngine().drawLayersAsync(
+            clientCompositionDisplay, std::move(layerSettings), buffer, useProtected,
+            std::move(bufferFence),
+            [this, renderedLayers = std::move(renderedLayers), captureResults,
+             captureListener](status_t status, base::unique_fd&& drawFence) {
+                const sp<Fence> fence = new Fence(drawFence.release());
+                // This may run on the RenderEngine thread, so go back to the main thread to hand
+                // out the release fence and the results.
+                static_cast<void>(schedule([=]() mutable {
+                    if (fence->isValid()) {
+                        for (const auto& weakLayer : renderedLayers) {
+                            if (const auto layer = weakLayer.promote()) {
+                                layer->onLayerDisplayed(fence);
+                            }
+                        }
+                    }
 
-    captureResults.fence = new Fence(drawFence.release());
-    // Always switch back to unprotected context.
-    getRenderEngine().useProtectedContext(false);
+                    if (captureListener) {
+                        captureResults.result = status;
+                        captureResults.fence = fence;
+                        captureListener->onScreenCaptureCompleted(captureResults);
+                    }
+                }));
+            });
 
     return NO_ERROR;
 }
@@ -31,6 +31,7 @@
 #include <gui/ISurfaceComposer.h>
 #include <gui/ISurfaceComposerClient.h>
 #include <gui/ITransactionCompletedListener.h>
+#include <gui/LayerDebugInfo.h>
 #include <gui/LayerState.h>
 #include <gui/OccupancyTracker.h>
 #include <layerproto/LayerProtoHeader.h>
@@ -63,6 +64,7 @@
 #include "Scheduler/VsyncModulator.h"
 #include "SurfaceFlingerFactory.h"
 #include "SurfaceTracing.h"
+#include "TransactionTracing.h"
 #include "TracedOrdinal.h"
 #include "TransactionCallbackInvoker.h"
 
@@ -116,6 +118,8 @@ class HWComposer;
 struct SetInputWindowsListener;
 class IGraphicBufferProducer;
 class Layer;
+class LayerWorkerPool;
+class TransactionFenceListener;
 class MessageBase;
 class RefreshRateOverlay;
 class RegionSamplingThread;
@@ -415,6 +419,8 @@ public:
         return mTransactionCallbackInvoker;
     }
 
+    bool isEarlyBufferReleaseEnabled() const { return mEarlyBufferRelease; }
+
     // Converts from a binder handle to a Layer
     // Returns nullptr if the handle does not point to an existing layer.
     // Otherwise, returns a weak reference so that callers off the main-thread
@@ -673,6 +679,10 @@ private:
         int originUid;
         uint64_t id;
         std::shared_ptr<CountDownLatch> transactionCommittedSignal;
+        // Textures for the new buffers in states, created when the transaction is queued so that
+        // RenderEngine starts importing the buffers right away. They only keep the imports alive
+        // until the transaction is applied and the layers hold their own references.
+        std::vector<std::shared_ptr<renderengine::ExternalTexture>> importedBuffers;
     };
 
     template <typename F, std::enable_if_t<!std::is_member_function_pointer_v<F>>* = nullptr>
@@ -932,6 +942,9 @@ private:
 
     void updateInputFlinger();
     void updateInputWindowInfo();
+    // Returns mDrawingLayersInZOrder, collecting it first if needed. Main thread only.
+    const std::vector<sp<Layer>>& getDrawingLayersInZOrder();
+    void invalidateDrawingLayersInZOrder() REQUIRES(mStateLock);
     void commitInputWindowCommands() REQUIRES(mStateLock);
     void updateCursorAsync();
     void updateFrameScheduler();
@@ -980,7 +993,13 @@ private:
             const FrameTimelineInfo& info, bool isAutoTimestamp, int64_t desiredPresentTime,
             uid_t originUid, const Vector<ComposerState>& states,
             const std::unordered_set<sp<IBinder>, ISurfaceComposer::SpHash<IBinder>>&
-                    bufferLayersReadyToPresent) const REQUIRES(mStateLock);
+                    bufferLayersReadyToPresent,
+            sp<Fence>* outUnsignaledFence = nullptr) const REQUIRES(mStateLock);
+    // Skips the pending transaction queue of applyToken in flushTransactionQueues until fence
+    // signals. Returns false if the fence can't be waited on, and the queue has to be checked
+    // again on the next frame instead.
+    bool waitForUnsignaledFence(const sp<IBinder>& applyToken, const sp<Fence>& fence)
+            REQUIRES(mQueueLock);
     uint32_t setDisplayStateLocked(const DisplayState& s) REQUIRES(mStateLock);
     void checkVirtualDisplayHint(const Vector<DisplayState>& displays);
     uint32_t addInputWindowCommands(const InputWindowCommands& inputWindowCommands)
@@ -1043,10 +1062,14 @@ private:
                                  const std::shared_ptr<renderengine::ExternalTexture>&,
                                  bool regionSampling, bool grayscale,
                                  const sp<IScreenCaptureListener>&);
+    // Snapshots the layers to capture and hands them to RenderEngine without waiting for them to be
+    // drawn. On success, the results are sent to the listener, if any, once the draw has been
+    // submitted; on error, nothing is sent and the caller reports the error.
     status_t renderScreenImplLocked(const RenderArea&, TraverseLayersFunction,
                                     const std::shared_ptr<renderengine::ExternalTexture>&,
                                     bool canCaptureBlackoutContent, bool regionSampling,
-                                    bool grayscale, ScreenCaptureResults&);
+                                    bool grayscale, ScreenCaptureResults&,
+                                    const sp<IScreenCaptureListener>&);
 
 
     bool canAllocateHwcDisplayIdForVDS(uint64_t usage);
@@ -1200,6 +1223,13 @@ private:
     // Must be called on the main thread.
     bool previousFramePending(int graceTimeMs = 0);
 
+    // Whether starting a new frame would put more frames in flight than the composition
+    // pipeline allows. Without pipelined composition this is the same as
+    // previousFramePending(). With it, the previous frame may still be outstanding, and only
+    // the frame before it applies backpressure.
+    // Must be called on the main thread.
+    bool pipelineFull(int graceTimeMs = 0);
+
     // Returns the previous time that the frame was presented. If the frame has
     // not been presented yet, then returns Fence::SIGNAL_TIME_PENDING. If there
     // is no pending frame, then returns Fence::SIGNAL_TIME_INVALID.
@@ -1261,12 +1291,14 @@ private:
     void clearStatsLocked(const DumpArgs& args, std::string& result);
     void dumpTimeStats(const DumpArgs& args, bool asProto, std::string& result) const;
     void dumpFrameTimeline(const DumpArgs& args, std::string& result) const;
+    void dumpTransactionTrace(std::string& result) const;
     void logFrameStats();
 
     void dumpVSync(std::string& result) const REQUIRES(mStateLock);
     void dumpStaticScreenStats(std::string& result) const;
     // Not const because each Layer needs to query Fences and cache timestamps.
     void dumpFrameEventsLocked(std::string& result);
+    void dumpBufferQueuesLocked(std::string& result) const;
 
     void recordBufferingStats(const std::string& layerName,
                               std::vector<OccupancyTracker::Segment>&& history);
@@ -1411,6 +1443,9 @@ private:
     // protected by mStateLock (but we could use another lock)
     bool mLayersRemoved = false;
     bool mLayersAdded = false;
+    // Set when the layer hierarchy or the displays change, so that every
+    // layer's bounds get computed again.
+    bool mLayerBoundsNeedFullUpdate = true;
 
     std::atomic<bool> mRepaintEverything = false;
 
@@ -1424,6 +1459,30 @@ private:
     State mDrawingState{LayerVector::StateSet::Drawing};
     bool mVisibleRegionsDirty = false;
 
+    // Bumped by the main thread whenever the drawing state, or what was composited from it, may
+    // have changed.
+    std::atomic<uint64_t> mDrawingStateGeneration = 0;
+    // Bumped by the main thread once the layer geometry, hierarchy or visible regions were
+    // recomputed. Layer::writeToProto() keys its cache on it.
+    std::atomic<uint64_t> mGeometryGeneration = 0;
+
+    // The layers of mDrawingState flattened in Z order. They are collected on first use and reused
+    // by the Z-order traversals that composition and input make every frame. The hierarchy and Z
+    // order of the drawing state only change when transactions are applied or committed, which
+    // invalidates this. Cleared with mStateLock held, as it may drop the last reference to a layer.
+    std::vector<sp<Layer>> mDrawingLayersInZOrder;
+    bool mDrawingLayersInZOrderValid = false;
+
+    // Layer debug info as of a drawing state generation. While that generation is current the
+    // snapshot can be handed out from any thread, without going through the main thread.
+    struct LayerDebugInfoSnapshot {
+        uint64_t generation;
+        std::vector<LayerDebugInfo> layers;
+    };
+    std::mutex mLayerDebugInfoSnapshotMutex;
+    std::shared_ptr<const LayerDebugInfoSnapshot> mLayerDebugInfoSnapshot
+            GUARDED_BY(mLayerDebugInfoSnapshotMutex);
+
     // VisibleRegions dirty is already cleared by postComp, but we need to track it to prevent
     // extra work in the HDR layer info listener.
     bool mVisibleRegionsWereDirtyThisFrame = false;
@@ -1435,6 +1494,8 @@ private:
     // for a layer has changed.
     // TODO: Also move visibleRegions over to a boolean system.
     bool mInputInfoChanged = false;
+    // The input window infos that were last sent to InputFlinger.
+    std::vector<InputWindowInfo> mLastInputWindowInfos;
     bool mSomeChildrenChanged;
     bool mSomeDataspaceChanged = false;
     bool mForceTransactionDisplayChange = false;
@@ -1483,13 +1544,23 @@ private:
     bool mDebugDisableHWC = false;
     bool mDebugDisableTransformHint = false;
     bool mLayerCachingEnabled = false;
+    bool mPartialClientCompositionEnabled = false;
+    bool mDynamicSfWorkDurationEnabled = false;
     volatile nsecs_t mDebugInTransaction = 0;
     bool mForceFullDamage = false;
     bool mPropagateBackpressure = true;
     bool mPropagateBackpressureClientComposition = false;
+    // Lets the next frame latch and commit while the previous frame is still being composited
+    // or presented.
+    bool mPipelinedComposition = false;
+    // Releases a replaced BufferStateLayer buffer as soon as the frame that replaced it is
+    // presented, instead of piggybacking on that frame's transaction callback.
+    bool mEarlyBufferRelease = false;
     sp<SurfaceInterceptor> mInterceptor;
 
     SurfaceTracing mTracing{*this};
+    // Records every transaction, unless debug.sf.enable_transaction_tracing is false.
+    std::unique_ptr<TransactionTracing> mTransactionTracing;
     std::mutex mTracingLock;
     bool mTracingEnabled = false;
     bool mTracePostComposition = false;
@@ -1536,6 +1607,14 @@ private:
     std::unordered_map<sp<IBinder>, std::queue<TransactionState>, IListenerHash>
             mPendingTransactionQueues GUARDED_BY(mQueueLock);
     std::queue<TransactionState> mTransactionQueue GUARDED_BY(mQueueLock);
+    // Apply tokens of the pending transaction queues whose head is waiting on an unsignaled
+    // acquire fence. flushTransactionQueues skips them until mTransactionFenceListener reports
+    // the fence signaled, and they don't keep SurfaceFlinger waking up for the next frame.
+    std::unordered_set<sp<IBinder>, IListenerHash> mPendingTransactionsWaitingOnFence
+            GUARDED_BY(mQueueLock);
+    // Created the first time a transaction waits on a fence. Its callback takes mQueueLock, so it
+    // is declared after it to be destroyed first.
+    std::unique_ptr<TransactionFenceListener> mTransactionFenceListener GUARDED_BY(mQueueLock);
     /*
      * Feature prototyping
      */
@@ -1544,6 +1623,12 @@ private:
     bool mHasPoweredOff = false;
 
     std::atomic<size_t> mNumLayers = 0;
+
+    // Workers computeLayerBounds() splits the layer tree across, and that the outputs generate
+    // their client composition requests on, see debug.sf.layer_worker_threads. Disabled when the
+    // count is 0.
+    size_t mLayerWorkerThreadCount = 0;
+    std::unique_ptr<LayerWorkerPool> mLayerWorkerPool;
     // Vsync Source
     sp<DisplayDevice> mActiveVsyncSource = NULL;
     sp<DisplayDevice> mNextVsyncSource = NULL;
@@ -23,10 +23,15 @@
 
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <log/log.h>
 #include <utils/SystemClock.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
+#include <unordered_set>
+
 namespace android {
 
 SurfaceTracing::SurfaceTracing(SurfaceFlinger& flinger) : mFlinger(flinger) {}
@@ -92,34 +97,164 @@ void SurfaceTracing::dump(std::string& result) const {
     }
 }
 
+namespace {
+
+// Layers with a metadata map may otherwise serialize differently for the same state.
+std::string serializeDeterministic(const LayerProto& layer) {
+    std::string bytes;
+    {
+        google::protobuf::io::StringOutputStream stream(&bytes);
+        google::protobuf::io::CodedOutputStream output(&stream);
+        output.SetSerializationDeterministic(true);
+        layer.SerializeToCodedStream(&output);
+    }
+    return bytes;
+}
+
+} // namespace
+
 void SurfaceTracing::LayersTraceBuffer::reset(size_t newSize) {
     // use the swap trick to make sure memory is released
-    std::queue<LayersTraceProto>().swap(mStorage);
+    std::deque<Entry>().swap(mStorage);
+    std::unordered_map<int32_t, std::string>().swap(mKeyframeLayers);
     mSizeInBytes = newSize;
     mUsedInBytes = 0U;
+    mKeyframeCount = 0;
+    mDeltasSinceKeyframe = 0;
 }
 
 void SurfaceTracing::LayersTraceBuffer::emplace(LayersTraceProto&& proto) {
-    size_t protoSize = static_cast<size_t>(proto.ByteSize());
-    while (mUsedInBytes + protoSize > mSizeInBytes) {
-        if (mStorage.empty()) {
+    ATRACE_CALL();
+
+    if (mKeyframeCount > 0 && mDeltasSinceKeyframe < KEYFRAME_INTERVAL) {
+        Entry entry;
+        encodeDelta(proto, &entry);
+        if (makeRoom(entry.size, /*keepKeyframe=*/true)) {
+            mUsedInBytes += entry.size;
+            mStorage.push_back(std::move(entry));
+            mDeltasSinceKeyframe++;
             return;
         }
-        mUsedInBytes -= static_cast<size_t>(mStorage.front().ByteSize());
-        mStorage.pop();
+    }
+
+    mKeyframeLayers.clear();
+    for (const LayerProto& layer : proto.layers().layers()) {
+        mKeyframeLayers.emplace(layer.id(), serializeDeterministic(layer));
+    }
+    mDeltasSinceKeyframe = 0;
+
+    const size_t protoSize = proto.ByteSizeLong();
+    if (!makeRoom(protoSize, /*keepKeyframe=*/false)) {
+        return;
     }
     mUsedInBytes += protoSize;
-    mStorage.emplace();
-    mStorage.back().Swap(&proto);
+    mStorage.emplace_back();
+    Entry& entry = mStorage.back();
+    entry.proto.Swap(&proto);
+    entry.size = protoSize;
+    entry.isKeyframe = true;
+    mKeyframeCount++;
+}
+
+void SurfaceTracing::LayersTraceBuffer::encodeDelta(const LayersTraceProto& proto,
+                                                    Entry* outEntry) const {
+    LayersTraceProto& delta = outEntry->proto;
+    delta.set_elapsed_realtime_nanos(proto.elapsed_realtime_nanos());
+    delta.set_where(proto.where());
+    if (proto.has_hwc_blob()) {
+        delta.set_hwc_blob(proto.hwc_blob());
+    }
+    if (proto.has_excludes_composition_state()) {
+        delta.set_excludes_composition_state(proto.excludes_composition_state());
+    }
+    delta.set_missed_entries(proto.missed_entries());
+
+    std::unordered_set<int32_t> layerIds;
+    LayersProto* layers = delta.mutable_layers();
+    for (const LayerProto& layer : proto.layers().layers()) {
+        layerIds.insert(layer.id());
+        const auto it = mKeyframeLayers.find(layer.id());
+        if (it == mKeyframeLayers.end() || it->second != serializeDeterministic(layer)) {
+            layers->add_layers()->CopyFrom(layer);
+        }
+    }
+
+    for (const auto& [id, bytes] : mKeyframeLayers) {
+        if (layerIds.count(id) == 0) {
+            outEntry->removedLayerIds.push_back(id);
+        }
+    }
+    std::sort(outEntry->removedLayerIds.begin(), outEntry->removedLayerIds.end());
+
+    outEntry->size = delta.ByteSizeLong() + outEntry->removedLayerIds.size() * sizeof(int32_t);
+    outEntry->isKeyframe = false;
+}
+
+bool SurfaceTracing::LayersTraceBuffer::makeRoom(size_t size, bool keepKeyframe) {
+    while (mUsedInBytes + size > mSizeInBytes) {
+        if (mStorage.empty() || (keepKeyframe && mKeyframeCount == 1)) {
+            return false;
+        }
+
+        // The oldest entry is always a keyframe, and its deltas go with it.
+        do {
+            mUsedInBytes -= mStorage.front().size;
+            mStorage.pop_front();
+        } while (!mStorage.empty() && !mStorage.front().isKeyframe);
+        mKeyframeCount--;
+    }
+    return true;
 }
 
 void SurfaceTracing::LayersTraceBuffer::flush(LayersTraceFileProto* fileProto) {
     fileProto->mutable_entry()->Reserve(static_cast<int>(mStorage.size()));
 
+    const LayersProto* keyframeLayers = nullptr;
     while (!mStorage.empty()) {
+        Entry& stored = mStorage.front();
         auto entry = fileProto->add_entry();
-        entry->Swap(&mStorage.front());
-        mStorage.pop();
+        entry->Swap(&stored.proto);
+        if (stored.isKeyframe) {
+            keyframeLayers = &entry->layers();
+        } else {
+            expandDelta(*keyframeLayers, stored.removedLayerIds, entry);
+        }
+        mStorage.pop_front();
+    }
+}
+
+void SurfaceTracing::LayersTraceBuffer::expandDelta(const LayersProto& keyframeLayers,
+                                                    const std::vector<int32_t>& removedLayerIds,
+                                                    LayersTraceProto* proto) {
+    LayersProto changedLayers;
+    changedLayers.Swap(proto->mutable_layers());
+
+    std::unordered_map<int32_t, LayerProto*> changedLayersById;
+    for (LayerProto& layer : *changedLayers.mutable_layers()) {
+        changedLayersById.emplace(layer.id(), &layer);
+    }
+
+    auto* layers = proto->mutable_layers()->mutable_layers();
+    layers->Reserve(keyframeLayers.layers_size() + changedLayers.layers_size());
+    for (const LayerProto& layer : keyframeLayers.layers()) {
+        if (std::binary_search(removedLayerIds.begin(), removedLayerIds.end(), layer.id())) {
+            continue;
+        }
+        const auto it = changedLayersById.find(layer.id());
+        if (it == changedLayersById.end()) {
+            layers->Add()->CopyFrom(layer);
+        } else {
+            layers->Add()->Swap(it->second);
+            changedLayersById.erase(it);
+        }
+    }
+
+    // The layers added since the keyframe.
+    for (LayerProto& layer : *changedLayers.mutable_layers()) {
+        const auto it = changedLayersById.find(layer.id());
+        if (it != changedLayersById.end() && it->second == &layer) {
+            layers->Add()->Swap(&layer);
+        }
     }
 }
 
@@ -128,8 +263,73 @@ SurfaceTracing::Runner::Runner(SurfaceFlinger& flinger, SurfaceTracing::Config&
     mBuffer.setSize(mConfig.bufferSize);
 }
 
+SurfaceTracing::Runner::~Runner() {
+    {
+        std::scoped_lock lock(mPendingLock);
+        mStopEncoding = true;
+    }
+    mPendingCondition.notify_all();
+    if (mEncodeThread.joinable()) {
+        mEncodeThread.join();
+    }
+}
+
 void SurfaceTracing::Runner::notify(const char* where) {
+    {
+        std::scoped_lock lock(mPendingLock);
+        if (mPending.size() >= MAX_PENDING_ENTRIES) {
+            mMissedTraceEntries++;
+            return;
+        }
+    }
+
     LayersTraceProto entry = traceLayers(where);
+    mMissedTraceEntries = 0;
+
+    {
+        std::scoped_lock lock(mPendingLock);
+        mPending.emplace_back();
+        mPending.back().Swap(&entry);
+    }
+    if (!mEncodeThread.joinable()) {
+        mEncodeThread = std::thread(&Runner::encodeLoop, this);
+    }
+    mPendingCondition.notify_all();
+}
+
+void SurfaceTracing::Runner::encodeLoop() {
+    std::unique_lock<std::mutex> lock(mPendingLock);
+    while (true) {
+        mPendingCondition.wait(lock, [this]() REQUIRES(mPendingLock) {
+            return mStopEncoding || !mPending.empty();
+        });
+        if (mPending.empty()) {
+            return;
+        }
+
+        LayersTraceProto entry;
+        entry.Swap(&mPending.front());
+        mPending.pop_front();
+        mEncoding = true;
+
+        lock.unlock();
+        addEntry(std::move(entry));
+        lock.lock();
+
+        mEncoding = false;
+        mPendingCondition.notify_all();
+    }
+}
+
+void SurfaceTracing::Runner::waitForPendingEntries() {
+    std::unique_lock<std::mutex> lock(mPendingLock);
+    mPendingCondition.wait(lock, [this]() REQUIRES(mPendingLock) {
+        return mPending.empty() && !mEncoding;
+    });
+}
+
+void SurfaceTracing::Runner::addEntry(LayersTraceProto&& entry) {
+    std::scoped_lock lock(mBufferLock);
     mBuffer.emplace(std::move(entry));
 }
 
@@ -145,8 +345,12 @@ status_t SurfaceTracing::Runner::writeToFile() {
 
     fileProto.set_magic_number(uint64_t(LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_H) << 32 |
                                LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_L);
-    mBuffer.flush(&fileProto);
-    mBuffer.reset(mConfig.bufferSize);
+    waitForPendingEntries();
+    {
+        std::scoped_lock lock(mBufferLock);
+        mBuffer.flush(&fileProto);
+        mBuffer.reset(mConfig.bufferSize);
+    }
 
     if (!fileProto.SerializeToString(&output)) {
         ALOGE("Could not save the proto file! Permission denied");
@@ -191,6 +395,7 @@ LayersTraceProto SurfaceTracing::Runner::traceLayers(const char* where) {
 }
 
 void SurfaceTracing::Runner::dump(std::string& result) const {
+    std::scoped_lock lock(mBufferLock);
     base::StringAppendF(&result, "  number of entries: %zu (%.2fMB / %.2fMB)\n",
                         mBuffer.frameCount(), float(mBuffer.used()) / float(1_MB),
                         float(mBuffer.size()) / float(1_MB));
@@ -208,7 +413,7 @@ void SurfaceTracing::AsyncRunner::loop() {
         LayersTraceProto entry;
         bool entryAdded = traceWhenNotified(&entry);
         if (entryAdded) {
-            mBuffer.emplace(std::move(entry));
+            addEntry(std::move(entry));
         }
         if (mWriteToFile) {
             Runner::writeToFile();
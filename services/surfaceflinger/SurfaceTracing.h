@@ -22,10 +22,13 @@
 #include <utils/StrongPointer.h>
 
 #include <condition_variable>
+#include <deque>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 using namespace android::surfaceflinger;
 
@@ -90,7 +93,9 @@ private:
     } mConfig;
 
     /*
-     * ring buffer.
+     * ring buffer of delta encoded entries. An entry is either a keyframe with every layer, or a
+     * delta with only the layers that differ from the last keyframe. Entries are dropped a
+     * keyframe at a time, together with its deltas, and written out as full entries.
      */
     class LayersTraceBuffer {
     public:
@@ -104,19 +109,41 @@ private:
         void flush(LayersTraceFileProto* fileProto);
 
     private:
+        static constexpr size_t KEYFRAME_INTERVAL = 64;
+
+        struct Entry {
+            LayersTraceProto proto;
+            size_t size;
+            bool isKeyframe;
+            // Sorted ids of the layers of the keyframe that are gone, if this is a delta.
+            std::vector<int32_t> removedLayerIds;
+        };
+
+        void encodeDelta(const LayersTraceProto& proto, Entry* outEntry) const;
+        static void expandDelta(const LayersProto& keyframeLayers,
+                                const std::vector<int32_t>& removedLayerIds,
+                                LayersTraceProto* proto);
+        // Drops the oldest keyframes until size bytes fit, but not the last one if keepKeyframe.
+        bool makeRoom(size_t size, bool keepKeyframe);
+
         size_t mUsedInBytes = 0U;
         size_t mSizeInBytes = DEFAULT_BUFFER_SIZE;
-        std::queue<LayersTraceProto> mStorage;
+        std::deque<Entry> mStorage;
+        size_t mKeyframeCount = 0;
+        size_t mDeltasSinceKeyframe = 0;
+        // Layers of the last keyframe, serialized to compare against.
+        std::unordered_map<int32_t, std::string> mKeyframeLayers;
     };
 
     /*
      * Implements a synchronous way of adding trace entries. This must be called
-     * from the drawing thread.
+     * from the drawing thread. Entries are encoded and stored on a separate thread,
+     * so that the drawing thread only captures the layer states.
      */
     class Runner {
     public:
         Runner(SurfaceFlinger& flinger, SurfaceTracing::Config& config);
-        virtual ~Runner() = default;
+        virtual ~Runner();
         virtual status_t stop();
         virtual status_t writeToFile();
         virtual void notify(const char* where);
@@ -128,9 +155,26 @@ private:
         bool flagIsSet(uint32_t flags) { return (mConfig.flags & flags) == flags; }
         SurfaceFlinger& mFlinger;
         SurfaceTracing::Config mConfig;
-        SurfaceTracing::LayersTraceBuffer mBuffer;
         uint32_t mMissedTraceEntries = 0;
         LayersTraceProto traceLayers(const char* where);
+        void addEntry(LayersTraceProto&& entry);
+
+    private:
+        // Entries captured but not yet encoded, beyond which new ones are missed.
+        static constexpr size_t MAX_PENDING_ENTRIES = 8;
+
+        void encodeLoop();
+        void waitForPendingEntries();
+
+        mutable std::mutex mBufferLock;
+        SurfaceTracing::LayersTraceBuffer mBuffer GUARDED_BY(mBufferLock);
+
+        std::mutex mPendingLock;
+        std::condition_variable mPendingCondition;
+        std::deque<LayersTraceProto> mPending GUARDED_BY(mPendingLock);
+        bool mEncoding GUARDED_BY(mPendingLock) = false;
+        bool mStopEncoding GUARDED_BY(mPendingLock) = false;
+        std::thread mEncodeThread;
     };
 
     /*
@@ -26,6 +26,8 @@
 #include <utils/Timers.h>
 #include <utils/Trace.h>
 
+#include <pthread.h>
+
 #include <algorithm>
 #include <chrono>
 
@@ -141,6 +143,7 @@ bool TimeStats::populateGlobalAtom(std::string* pulledData) {
 
 bool TimeStats::populateLayerAtom(std::string* pulledData) {
     std::lock_guard<std::mutex> lock(mMutex);
+    flushPendingLayersLocked();
 
     std::vector<TimeStatsHelper::TimeStatsLayer*> dumpStats;
     uint32_t numLayers = 0;
@@ -241,6 +244,35 @@ TimeStats::TimeStats(std::optional<size_t> maxPulledLayers,
     if (maxPulledHistogramBuckets) {
         mMaxPulledHistogramBuckets = *maxPulledHistogramBuckets;
     }
+
+    mPendingLayers.reserve(AGGREGATION_BATCH_SIZE);
+    mAggregationThread = std::thread(&TimeStats::aggregationLoop, this);
+}
+
+TimeStats::~TimeStats() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopAggregation = true;
+    }
+    mAggregationCondition.notify_one();
+    mAggregationThread.join();
+}
+
+void TimeStats::aggregationLoop() {
+    if (pthread_setname_np(pthread_self(), "TimeStats")) {
+        ALOGW("Failed to set thread name on aggregation thread");
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mAggregationCondition.wait(lock, [this] {
+            return mStopAggregation || mPendingLayers.size() >= AGGREGATION_BATCH_SIZE;
+        });
+        if (mStopAggregation) {
+            return;
+        }
+        flushPendingLayersLocked();
+    }
 }
 
 bool TimeStats::onPullAtom(const int atomId, std::string* pulledData) {
@@ -451,27 +483,56 @@ static int32_t clampToNearestBucket(Fps fps, size_t bucketWidth) {
     return std::round(fps.getValue() / bucketWidth) * bucketWidth;
 }
 
-void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId, Fps displayRefreshRate,
-                                                   std::optional<Fps> renderRate,
-                                                   SetFrameRateVote frameRateVote,
-                                                   int32_t gameMode) {
+void TimeStats::setRecordReadyLocked(int32_t layerId, TimeRecord* timeRecord,
+                                     Fps displayRefreshRate, std::optional<Fps> renderRate,
+                                     SetFrameRateVote frameRateVote, int32_t gameMode) {
+    timeRecord->ready = true;
+    timeRecord->displayRefreshRate = displayRefreshRate;
+    timeRecord->renderRate = renderRate;
+    timeRecord->frameRateVote = frameRateVote;
+    timeRecord->gameMode = gameMode;
+
+    mPendingLayers.push_back(layerId);
+    if (mPendingLayers.size() == AGGREGATION_BATCH_SIZE) {
+        mAggregationCondition.notify_one();
+    }
+}
+
+void TimeStats::flushPendingLayersLocked() {
+    if (mPendingLayers.empty()) return;
+
+    ATRACE_CALL();
+    for (const int32_t layerId : mPendingLayers) {
+        // The layer may have been destroyed since.
+        if (mTimeStatsTracker.count(layerId)) {
+            flushAvailableRecordsToStatsLocked(layerId);
+        }
+    }
+    mPendingLayers.clear();
+}
+
+void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId) {
     ATRACE_CALL();
     ALOGV("[%d]-flushAvailableRecordsToStatsLocked", layerId);
 
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     TimeRecord& prevTimeRecord = layerRecord.prevTimeRecord;
     std::deque<TimeRecord>& timeRecords = layerRecord.timeRecords;
-    const int32_t refreshRateBucket =
-            clampToNearestBucket(displayRefreshRate, REFRESH_RATE_BUCKET_WIDTH);
-    const int32_t renderRateBucket =
-            clampToNearestBucket(renderRate ? *renderRate : displayRefreshRate,
-                                 RENDER_RATE_BUCKET_WIDTH);
     while (!timeRecords.empty()) {
         if (!recordReadyLocked(layerId, &timeRecords[0])) break;
         ALOGV("[%d]-[%" PRIu64 "]-presentFenceTime[%" PRId64 "]", layerId,
               timeRecords[0].frameTime.frameNumber, timeRecords[0].frameTime.presentTime);
 
         if (prevTimeRecord.ready) {
+            const Fps displayRefreshRate = timeRecords[0].displayRefreshRate;
+            const std::optional<Fps> renderRate = timeRecords[0].renderRate;
+            const SetFrameRateVote frameRateVote = timeRecords[0].frameRateVote;
+            const int32_t gameMode = timeRecords[0].gameMode;
+            const int32_t refreshRateBucket =
+                    clampToNearestBucket(displayRefreshRate, REFRESH_RATE_BUCKET_WIDTH);
+            const int32_t renderRateBucket =
+                    clampToNearestBucket(renderRate ? *renderRate : displayRefreshRate,
+                                         RENDER_RATE_BUCKET_WIDTH);
             uid_t uid = layerRecord.uid;
             const std::string& layerName = layerRecord.layerName;
             TimeStatsHelper::TimelineStatsKey timelineKey = {refreshRateBucket, renderRateBucket};
@@ -587,6 +648,10 @@ void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::st
     }
     if (!mTimeStatsTracker.count(layerId)) return;
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    if (layerRecord.timeRecords.size() == MAX_NUM_TIME_RECORDS) {
+        // Some of the records may only be waiting for aggregation.
+        flushPendingLayersLocked();
+    }
     if (layerRecord.timeRecords.size() == MAX_NUM_TIME_RECORDS) {
         ALOGE("[%d]-[%s]-timeRecords is at its maximum size[%zu]. Ignore this when unittesting.",
               layerId, layerRecord.layerName.c_str(), MAX_NUM_TIME_RECORDS);
@@ -733,12 +798,10 @@ void TimeStats::setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t pr
     TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
     if (timeRecord.frameTime.frameNumber == frameNumber) {
         timeRecord.frameTime.presentTime = presentTime;
-        timeRecord.ready = true;
+        setRecordReadyLocked(layerId, &timeRecord, displayRefreshRate, renderRate, frameRateVote,
+                             gameMode);
         layerRecord.waitData++;
     }
-
-    flushAvailableRecordsToStatsLocked(layerId, displayRefreshRate, renderRate, frameRateVote,
-                                       gameMode);
 }
 
 void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
@@ -760,12 +823,10 @@ void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
     TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
     if (timeRecord.frameTime.frameNumber == frameNumber) {
         timeRecord.presentFence = presentFence;
-        timeRecord.ready = true;
+        setRecordReadyLocked(layerId, &timeRecord, displayRefreshRate, renderRate, frameRateVote,
+                             gameMode);
         layerRecord.waitData++;
     }
-
-    flushAvailableRecordsToStatsLocked(layerId, displayRefreshRate, renderRate, frameRateVote,
-                                       gameMode);
 }
 
 static const constexpr int32_t kValidJankyReason = JankType::DisplayHAL |
@@ -878,6 +939,8 @@ void TimeStats::removeTimeRecord(int32_t layerId, uint64_t frameNumber) {
 
     std::lock_guard<std::mutex> lock(mMutex);
     if (!mTimeStatsTracker.count(layerId)) return;
+    // Presented frames must not be counted as dropped just because they weren't aggregated yet.
+    flushPendingLayersLocked();
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     size_t removeAt = 0;
     for (const TimeRecord& record : layerRecord.timeRecords) {
@@ -1083,6 +1146,7 @@ void TimeStats::clearLayersLocked() {
     ATRACE_CALL();
 
     mTimeStatsTracker.clear();
+    mPendingLayers.clear();
 
     for (auto& globalRecord : mTimeStats.stats) {
         globalRecord.second.stats.clear();
@@ -1105,6 +1169,7 @@ void TimeStats::dump(bool asProto, std::optional<uint32_t> maxLayers, std::strin
     mTimeStats.statsEndLegacy = static_cast<int64_t>(std::time(0));
 
     flushPowerTimeLocked();
+    flushPendingLayersLocked();
 
     if (asProto) {
         ALOGD("Dumping TimeStats as proto");
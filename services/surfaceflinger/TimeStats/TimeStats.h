@@ -27,11 +27,14 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <condition_variable>
 #include <deque>
 #include <mutex>
 #include <optional>
+#include <thread>
 #include <unordered_map>
 #include <variant>
+#include <vector>
 
 using namespace android::surfaceflinger;
 
@@ -187,6 +190,12 @@ class TimeStats : public android::TimeStats {
         FrameTime frameTime;
         std::shared_ptr<FenceTime> acquireFence;
         std::shared_ptr<FenceTime> presentFence;
+        // The display state when the frame was presented, which the aggregated stats are keyed
+        // by. Only set once the record is ready.
+        Fps displayRefreshRate;
+        std::optional<Fps> renderRate;
+        SetFrameRateVote frameRateVote;
+        int32_t gameMode = 0;
     };
 
     struct LayerRecord {
@@ -225,6 +234,7 @@ public:
     // For testing only for injecting custom dependencies.
     TimeStats(std::optional<size_t> maxPulledLayers,
               std::optional<size_t> maxPulledHistogramBuckets);
+    ~TimeStats() override;
 
     bool onPullAtom(const int atomId, std::string* pulledData) override;
     void parseArgs(bool asProto, const Vector<String16>& args, std::string& result) override;
@@ -279,9 +289,15 @@ private:
     bool populateGlobalAtom(std::string* pulledData);
     bool populateLayerAtom(std::string* pulledData);
     bool recordReadyLocked(int32_t layerId, TimeRecord* timeRecord);
-    void flushAvailableRecordsToStatsLocked(int32_t layerId, Fps displayRefreshRate,
-                                            std::optional<Fps> renderRate,
-                                            SetFrameRateVote frameRateVote, int32_t gameMode);
+    // Marks the record as ready to be aggregated, and queues its layer for aggregation.
+    void setRecordReadyLocked(int32_t layerId, TimeRecord* timeRecord, Fps displayRefreshRate,
+                              std::optional<Fps> renderRate, SetFrameRateVote frameRateVote,
+                              int32_t gameMode);
+    void flushAvailableRecordsToStatsLocked(int32_t layerId);
+    // Aggregates the ready records of all queued layers. Called on the aggregation thread, and
+    // before anything reads the aggregated stats or depends on ready records being flushed.
+    void flushPendingLayersLocked();
+    void aggregationLoop();
     void flushPowerTimeLocked();
     void flushAvailableGlobalRecordsToStatsLocked();
     bool canAddNewAggregatedStats(uid_t uid, const std::string& layerName, int32_t gameMode);
@@ -309,6 +325,15 @@ private:
     static const size_t MAX_NUM_PULLED_LAYERS = MAX_NUM_LAYER_STATS;
     size_t mMaxPulledLayers = MAX_NUM_PULLED_LAYERS;
     size_t mMaxPulledHistogramBuckets = 6;
+
+    // Layers with ready records, in the order they became ready. Aggregating the records into
+    // mTimeStats is left to mAggregationThread, so that presenting a frame only queues them.
+    std::vector<int32_t> mPendingLayers;
+    // Number of queued layers at which mAggregationThread is woken up.
+    static const size_t AGGREGATION_BATCH_SIZE = 32;
+    std::condition_variable mAggregationCondition;
+    bool mStopAggregation = false;
+    std::thread mAggregationThread;
 };
 
 } // namespace impl
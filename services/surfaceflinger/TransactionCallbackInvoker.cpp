@@ -243,6 +243,13 @@ status_t TransactionCallbackInvoker::addCallbackHandle(const sp<CallbackHandle>&
     return NO_ERROR;
 }
 
+void TransactionCallbackInvoker::addReleaseBufferCallback(
+        const sp<ITransactionCompletedListener>& listener, ReleaseBufferStats releaseBufferStats) {
+    std::lock_guard lock(mMutex);
+    mPendingReleaseBuffers[IInterface::asBinder(listener)].push_back(
+            std::move(releaseBufferStats));
+}
+
 void TransactionCallbackInvoker::addPresentFence(const sp<Fence>& presentFence) {
     std::lock_guard<std::mutex> lock(mMutex);
     mPresentFence = presentFence;
@@ -291,8 +298,15 @@ void TransactionCallbackInvoker::sendCallbacks() {
             listenerStats.transactionStats.push_back(std::move(transactionStats));
             transactionStatsItr = transactionStatsDeque.erase(transactionStatsItr);
         }
-        // If the listener has completed transactions
-        if (!listenerStats.transactionStats.empty()) {
+        if (auto releases = mPendingReleaseBuffers.find(listener);
+            releases != mPendingReleaseBuffers.end()) {
+            listenerStats.releaseBufferStats = std::move(releases->second);
+            mPendingReleaseBuffers.erase(releases);
+        }
+
+        // If the listener has completed transactions or released buffers
+        if (!listenerStats.transactionStats.empty() ||
+            !listenerStats.releaseBufferStats.empty()) {
             // If the listener is still alive
             if (listener->isBinderAlive()) {
                 // Send callback.  The listener stored in listenerStats
@@ -319,6 +333,16 @@ void TransactionCallbackInvoker::sendCallbacks() {
         }
     }
 
+    // Listeners that only have buffers to release
+    for (auto& [listener, releaseBufferStats] : mPendingReleaseBuffers) {
+        ListenerStats listenerStats;
+        listenerStats.listener = listener;
+        listenerStats.releaseBufferStats = std::move(releaseBufferStats);
+        interface_cast<ITransactionCompletedListener>(listener)->onTransactionCompleted(
+                listenerStats);
+    }
+    mPendingReleaseBuffers.clear();
+
     if (mPresentFence) {
         mPresentFence.clear();
     }
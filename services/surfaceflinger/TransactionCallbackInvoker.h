@@ -82,6 +82,11 @@ public:
     // presented this frame.
     status_t registerUnpresentedCallbackHandle(const sp<CallbackHandle>& handle);
 
+    // Queues the release of a buffer that was dropped before being presented. It is sent with the
+    // next callbacks, in the same binder call as the other callbacks to that listener.
+    void addReleaseBufferCallback(const sp<ITransactionCompletedListener>& listener,
+                                  ReleaseBufferStats releaseBufferStats);
+
     void addPresentFence(const sp<Fence>& presentFence);
 
     void sendCallbacks();
@@ -128,6 +133,9 @@ private:
     std::unordered_map<sp<IBinder>, std::deque<TransactionStats>, IListenerHash>
             mCompletedTransactions GUARDED_BY(mMutex);
 
+    std::unordered_map<sp<IBinder>, std::vector<ReleaseBufferStats>, IListenerHash>
+            mPendingReleaseBuffers GUARDED_BY(mMutex);
+
     sp<Fence> mPresentFence GUARDED_BY(mMutex);
 };
 
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "TransactionFenceListener"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "TransactionFenceListener.h"
+
+#include <log/log.h>
+#include <utils/Trace.h>
+
+#include <pthread.h>
+
+namespace android {
+
+TransactionFenceListener::TransactionFenceListener(Callback callback)
+      : mCallback(std::move(callback)), mLooper(new Looper(/* allowNonCallbacks */ false)) {
+    mThread = std::thread(&TransactionFenceListener::threadMain, this);
+    pthread_setname_np(mThread.native_handle(), "TxnFenceListen");
+}
+
+TransactionFenceListener::~TransactionFenceListener() {
+    mStopped = true;
+    mLooper->wake();
+    mThread.join();
+}
+
+bool TransactionFenceListener::listen(const sp<Fence>& fence, const sp<IBinder>& applyToken) {
+    ATRACE_CALL();
+    base::unique_fd fd(fence->isValid() ? fence->dup() : -1);
+    if (!fd.ok()) {
+        return false;
+    }
+
+    const int rawFd = fd.get();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mListeners.emplace(rawFd, Listener{std::move(fd), applyToken});
+    }
+    // A sync fence polls readable once it has signaled, including if it already had.
+    if (mLooper->addFd(rawFd, 0, Looper::EVENT_INPUT, &TransactionFenceListener::handleFenceEvent,
+                       this) != 1) {
+        ALOGW("Couldn't wait on a transaction fence");
+        std::lock_guard<std::mutex> lock(mMutex);
+        mListeners.erase(rawFd);
+        return false;
+    }
+    return true;
+}
+
+int TransactionFenceListener::handleFenceEvent(int fd, int /* events */, void* data) {
+    // Errors and hangups are reported the same way, there is nothing left to wait for either way.
+    reinterpret_cast<TransactionFenceListener*>(data)->onFenceSignaled(fd);
+    return 0; // Unregister, the fd has already been closed.
+}
+
+void TransactionFenceListener::onFenceSignaled(int fd) {
+    Listener listener;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const auto it = mListeners.find(fd);
+        if (it == mListeners.end()) {
+            return;
+        }
+        listener = std::move(it->second);
+        mListeners.erase(it);
+    }
+    mLooper->removeFd(fd);
+    listener.fd.reset();
+    mCallback(listener.applyToken);
+}
+
+void TransactionFenceListener::threadMain() {
+    while (!mStopped) {
+        mLooper->pollOnce(-1);
+    }
+}
+
+} // namespace android
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
+#include <binder/IBinder.h>
+#include <ui/Fence.h>
+#include <utils/Looper.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace android {
+
+// Waits on the acquire fences that pending transactions are blocked on, so that the transaction
+// queues don't need to be polled on every frame until they signal. The callback is called on the
+// listener's own thread, once per successful listen() call, with the apply token that was passed to it.
+class TransactionFenceListener {
+public:
+    using Callback = std::function<void(const sp<IBinder>& applyToken)>;
+
+    explicit TransactionFenceListener(Callback callback);
+    ~TransactionFenceListener();
+
+    TransactionFenceListener(const TransactionFenceListener&) = delete;
+    TransactionFenceListener& operator=(const TransactionFenceListener&) = delete;
+
+    // Calls the callback once the fence has signaled, which may be right away if it already has.
+    // Returns false, without ever calling the callback, if the fence can't be waited on.
+    bool listen(const sp<Fence>& fence, const sp<IBinder>& applyToken) EXCLUDES(mMutex);
+
+private:
+    static int handleFenceEvent(int fd, int events, void* data);
+    void onFenceSignaled(int fd) EXCLUDES(mMutex);
+    void threadMain();
+
+    const Callback mCallback;
+    const sp<Looper> mLooper;
+
+    std::mutex mMutex;
+    struct Listener {
+        base::unique_fd fd;
+        sp<IBinder> applyToken;
+    };
+    // Keyed by the listener's own duplicate of the fence fd.
+    std::unordered_map<int, Listener> mListeners GUARDED_BY(mMutex);
+
+    std::atomic<bool> mStopped = false;
+    std::thread mThread;
+};
+
+} // namespace android
@@ -0,0 +1,518 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "TransactionTracing"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "TransactionTracing.h"
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
+#include <gui/ISurfaceComposer.h>
+#include <gui/SurfaceControl.h>
+#include <log/log.h>
+#include <utils/SystemClock.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace android {
+
+using base::StringAppendF;
+using namespace surfaceflinger;
+
+namespace {
+
+// The changes that SurfaceInterceptor can represent. Other changes are not recorded.
+constexpr uint64_t TRACED_CHANGES = layer_state_t::ePositionChanged |
+        layer_state_t::eLayerChanged | layer_state_t::eSizeChanged | layer_state_t::eAlphaChanged |
+        layer_state_t::eMatrixChanged | layer_state_t::eTransparentRegionChanged |
+        layer_state_t::eFlagsChanged | layer_state_t::eLayerStackChanged |
+        layer_state_t::eCropChanged | layer_state_t::eCornerRadiusChanged |
+        layer_state_t::eBackgroundBlurRadiusChanged | layer_state_t::eBlurRegionsChanged |
+        layer_state_t::eReparent | layer_state_t::eRelativeLayerChanged |
+        layer_state_t::eShadowRadiusChanged | layer_state_t::eTrustedOverlayChanged;
+
+constexpr int32_t NO_LAYER_ID = -1;
+
+struct RecordHeader {
+    int64_t timestamp;
+    uint64_t transactionId;
+    int32_t originPid;
+    int32_t originUid;
+    uint32_t flags;
+    uint32_t stateCount;
+};
+
+struct RecordRect {
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+};
+
+class RecordWriter {
+public:
+    explicit RecordWriter(std::vector<uint8_t>& record) : mRecord(record) {}
+
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const size_t offset = mRecord.size();
+        mRecord.resize(offset + sizeof(T));
+        memcpy(mRecord.data() + offset, &value, sizeof(T));
+    }
+
+    void write(const Rect& rect) {
+        write(RecordRect{rect.left, rect.top, rect.right, rect.bottom});
+    }
+
+    template <typename T>
+    void overwrite(size_t offset, const T& value) {
+        memcpy(mRecord.data() + offset, &value, sizeof(T));
+    }
+
+    size_t size() const { return mRecord.size(); }
+
+private:
+    std::vector<uint8_t>& mRecord;
+};
+
+class RecordReader {
+public:
+    explicit RecordReader(const std::vector<uint8_t>& record)
+          : mPos(record.data()), mEnd(record.data() + record.size()) {}
+
+    template <typename T>
+    bool read(T* outValue) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (static_cast<size_t>(mEnd - mPos) < sizeof(T)) {
+            return false;
+        }
+        memcpy(outValue, mPos, sizeof(T));
+        mPos += sizeof(T);
+        return true;
+    }
+
+    bool read(Rectangle* outRect) {
+        RecordRect rect;
+        if (!read(&rect)) {
+            return false;
+        }
+        outRect->set_left(rect.left);
+        outRect->set_top(rect.top);
+        outRect->set_right(rect.right);
+        outRect->set_bottom(rect.bottom);
+        return true;
+    }
+
+private:
+    const uint8_t* mPos;
+    const uint8_t* const mEnd;
+};
+
+int32_t layerIdOf(const sp<SurfaceControl>& surfaceControl) {
+    return surfaceControl ? surfaceControl->getLayerId() : NO_LAYER_ID;
+}
+
+// Appends the traced changes of the state. Returns false if it has none.
+bool writeState(RecordWriter& writer, const layer_state_t& state) {
+    const uint64_t what = state.what & TRACED_CHANGES;
+    if (!what) {
+        return false;
+    }
+
+    writer.write(state.layerId);
+    writer.write(what);
+    if (what & layer_state_t::ePositionChanged) {
+        writer.write(state.x);
+        writer.write(state.y);
+    }
+    if (what & (layer_state_t::eLayerChanged | layer_state_t::eRelativeLayerChanged)) {
+        writer.write(state.z);
+    }
+    if (what & layer_state_t::eSizeChanged) {
+        writer.write(state.w);
+        writer.write(state.h);
+    }
+    if (what & layer_state_t::eAlphaChanged) {
+        writer.write(state.alpha);
+    }
+    if (what & layer_state_t::eMatrixChanged) {
+        writer.write(state.matrix);
+    }
+    if (what & layer_state_t::eTransparentRegionChanged) {
+        size_t count;
+        const Rect* rects = state.transparentRegion.getArray(&count);
+        writer.write(static_cast<uint32_t>(count));
+        for (size_t i = 0; i < count; i++) {
+            writer.write(rects[i]);
+        }
+    }
+    if (what & layer_state_t::eFlagsChanged) {
+        writer.write(state.flags);
+        writer.write(state.mask);
+    }
+    if (what & layer_state_t::eLayerStackChanged) {
+        writer.write(state.layerStack);
+    }
+    if (what & layer_state_t::eCropChanged) {
+        writer.write(state.crop);
+    }
+    if (what & layer_state_t::eCornerRadiusChanged) {
+        writer.write(state.cornerRadius);
+    }
+    if (what & layer_state_t::eBackgroundBlurRadiusChanged) {
+        writer.write(state.backgroundBlurRadius);
+    }
+    if (what & layer_state_t::eBlurRegionsChanged) {
+        writer.write(static_cast<uint32_t>(state.blurRegions.size()));
+        for (const auto& blurRegion : state.blurRegions) {
+            writer.write(blurRegion);
+        }
+    }
+    if (what & layer_state_t::eReparent) {
+        writer.write(layerIdOf(state.parentSurfaceControlForChild));
+    }
+    if (what & layer_state_t::eRelativeLayerChanged) {
+        writer.write(layerIdOf(state.relativeLayerSurfaceControl));
+    }
+    if (what & layer_state_t::eShadowRadiusChanged) {
+        writer.write(state.shadowRadius);
+    }
+    if (what & layer_state_t::eTrustedOverlayChanged) {
+        writer.write(static_cast<uint8_t>(state.isTrustedOverlay));
+    }
+    return true;
+}
+
+// Mirrors SurfaceInterceptor, which adds one SurfaceChange per changed field.
+bool readState(RecordReader& reader, Transaction* transaction) {
+    int32_t layerId;
+    uint64_t what;
+    if (!reader.read(&layerId) || !reader.read(&what)) {
+        return false;
+    }
+
+    const auto addChange = [&] {
+        SurfaceChange* change = transaction->add_surface_change();
+        change->set_id(layerId);
+        return change;
+    };
+
+    if (what & layer_state_t::ePositionChanged) {
+        float x, y;
+        if (!reader.read(&x) || !reader.read(&y)) return false;
+        PositionChange* position = addChange()->mutable_position();
+        position->set_x(x);
+        position->set_y(y);
+    }
+    int32_t z = 0;
+    if (what & (layer_state_t::eLayerChanged | layer_state_t::eRelativeLayerChanged)) {
+        if (!reader.read(&z)) return false;
+        if (what & layer_state_t::eLayerChanged) {
+            addChange()->mutable_layer()->set_layer(z);
+        }
+    }
+    if (what & layer_state_t::eSizeChanged) {
+        uint32_t w, h;
+        if (!reader.read(&w) || !reader.read(&h)) return false;
+        SizeChange* size = addChange()->mutable_size();
+        size->set_w(w);
+        size->set_h(h);
+    }
+    if (what & layer_state_t::eAlphaChanged) {
+        float alpha;
+        if (!reader.read(&alpha)) return false;
+        addChange()->mutable_alpha()->set_alpha(alpha);
+    }
+    if (what & layer_state_t::eMatrixChanged) {
+        layer_state_t::matrix22_t matrix;
+        if (!reader.read(&matrix)) return false;
+        MatrixChange* matrixChange = addChange()->mutable_matrix();
+        matrixChange->set_dsdx(matrix.dsdx);
+        matrixChange->set_dtdx(matrix.dtdx);
+        matrixChange->set_dsdy(matrix.dsdy);
+        matrixChange->set_dtdy(matrix.dtdy);
+    }
+    if (what & layer_state_t::eTransparentRegionChanged) {
+        uint32_t count;
+        if (!reader.read(&count)) return false;
+        TransparentRegionHintChange* region = addChange()->mutable_transparent_region_hint();
+        for (uint32_t i = 0; i < count; i++) {
+            if (!reader.read(region->add_region())) return false;
+        }
+    }
+    if (what & layer_state_t::eFlagsChanged) {
+        uint32_t flags, mask;
+        if (!reader.read(&flags) || !reader.read(&mask)) return false;
+        if (mask & layer_state_t::eLayerHidden) {
+            addChange()->mutable_hidden_flag()->set_hidden_flag(flags & layer_state_t::eLayerHidden);
+        }
+        if (mask & layer_state_t::eLayerOpaque) {
+            addChange()->mutable_opaque_flag()->set_opaque_flag(flags & layer_state_t::eLayerOpaque);
+        }
+        if (mask & layer_state_t::eLayerSecure) {
+            addChange()->mutable_secure_flag()->set_secure_flag(flags & layer_state_t::eLayerSecure);
+        }
+    }
+    if (what & layer_state_t::eLayerStackChanged) {
+        uint32_t layerStack;
+        if (!reader.read(&layerStack)) return false;
+        addChange()->mutable_layer_stack()->set_layer_stack(layerStack);
+    }
+    if (what & layer_state_t::eCropChanged) {
+        if (!reader.read(addChange()->mutable_crop()->mutable_rectangle())) return false;
+    }
+    if (what & layer_state_t::eCornerRadiusChanged) {
+        float cornerRadius;
+        if (!reader.read(&cornerRadius)) return false;
+        addChange()->mutable_corner_radius()->set_corner_radius(cornerRadius);
+    }
+    if (what & layer_state_t::eBackgroundBlurRadiusChanged) {
+        uint32_t radius;
+        if (!reader.read(&radius)) return false;
+        addChange()->mutable_background_blur_radius()->set_background_blur_radius(radius);
+    }
+    if (what & layer_state_t::eBlurRegionsChanged) {
+        uint32_t count;
+        if (!reader.read(&count)) return false;
+        BlurRegionsChange* blurRegions = addChange()->mutable_blur_regions();
+        for (uint32_t i = 0; i < count; i++) {
+            BlurRegion blurRegion;
+            if (!reader.read(&blurRegion)) return false;
+            BlurRegionChange* blurRegionChange = blurRegions->add_blur_regions();
+            blurRegionChange->set_blur_radius(blurRegion.blurRadius);
+            blurRegionChange->set_corner_radius_tl(blurRegion.cornerRadiusTL);
+            blurRegionChange->set_corner_radius_tr(blurRegion.cornerRadiusTR);
+            blurRegionChange->set_corner_radius_bl(blurRegion.cornerRadiusBL);
+            blurRegionChange->set_corner_radius_br(blurRegion.cornerRadiusBR);
+            blurRegionChange->set_alpha(blurRegion.alpha);
+            blurRegionChange->set_left(blurRegion.left);
+            blurRegionChange->set_top(blurRegion.top);
+            blurRegionChange->set_right(blurRegion.right);
+            blurRegionChange->set_bottom(blurRegion.bottom);
+        }
+    }
+    if (what & layer_state_t::eReparent) {
+        int32_t parentId;
+        if (!reader.read(&parentId)) return false;
+        addChange()->mutable_reparent()->set_parent_id(parentId);
+    }
+    if (what & layer_state_t::eRelativeLayerChanged) {
+        int32_t relativeId;
+        if (!reader.read(&relativeId)) return false;
+        RelativeParentChange* relativeParent = addChange()->mutable_relative_parent();
+        relativeParent->set_relative_parent_id(relativeId);
+        relativeParent->set_z(z);
+    }
+    if (what & layer_state_t::eShadowRadiusChanged) {
+        float shadowRadius;
+        if (!reader.read(&shadowRadius)) return false;
+        addChange()->mutable_shadow_radius()->set_radius(shadowRadius);
+    }
+    if (what & layer_state_t::eTrustedOverlayChanged) {
+        uint8_t isTrustedOverlay;
+        if (!reader.read(&isTrustedOverlay)) return false;
+        addChange()->mutable_trusted_overlay()->set_is_trusted_overlay(isTrustedOverlay);
+    }
+    return true;
+}
+
+bool readRecordToIncrement(const std::vector<uint8_t>& record, Increment* increment) {
+    RecordReader reader(record);
+    RecordHeader header;
+    if (!reader.read(&header)) {
+        return false;
+    }
+
+    increment->set_time_stamp(header.timestamp);
+    Transaction* transaction = increment->mutable_transaction();
+    transaction->set_synchronous(header.flags & ISurfaceComposer::eSynchronous);
+    transaction->set_animation(header.flags & ISurfaceComposer::eAnimation);
+    transaction->mutable_origin()->set_pid(header.originPid);
+    transaction->mutable_origin()->set_uid(header.originUid);
+    transaction->set_id(header.transactionId);
+    for (uint32_t i = 0; i < header.stateCount; i++) {
+        if (!readState(reader, transaction)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr uint64_t completeTag(uint64_t slot) {
+    return slot * 2 + 2;
+}
+
+constexpr uint64_t packSlotHeader(size_t recordSize, size_t slotIndex, size_t slotCount) {
+    return static_cast<uint64_t>(recordSize) << 32 | static_cast<uint64_t>(slotIndex) << 16 |
+            slotCount;
+}
+
+} // namespace
+
+TransactionTracing::TransactionTracing(size_t bufferSize)
+      : mSlotCount(std::max<size_t>(bufferSize / sizeof(Slot), 16)),
+        mSlots(new Slot[mSlotCount]) {}
+
+void TransactionTracing::addTransaction(const Vector<ComposerState>& states, uint32_t flags,
+                                        int originPid, int originUid, uint64_t transactionId) {
+    ATRACE_CALL();
+
+    // Reused across transactions, so that recording does not allocate once warmed up.
+    thread_local std::vector<uint8_t> tRecord;
+    tRecord.clear();
+
+    RecordWriter writer(tRecord);
+    writer.write(RecordHeader{elapsedRealtimeNano(), transactionId, originPid, originUid, flags,
+                              0});
+    uint32_t stateCount = 0;
+    for (const auto& composerState : states) {
+        if (writeState(writer, composerState.state)) {
+            stateCount++;
+        }
+    }
+    writer.overwrite(offsetof(RecordHeader, stateCount), stateCount);
+
+    const size_t recordSize = writer.size();
+    const size_t slotCount = (recordSize + SLOT_PAYLOAD_SIZE - 1) / SLOT_PAYLOAD_SIZE;
+    if (slotCount > std::min<size_t>(mSlotCount / 4, UINT16_MAX)) {
+        mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint64_t first = mNextSlot.fetch_add(slotCount, std::memory_order_relaxed);
+    for (size_t i = 0; i < slotCount; i++) {
+        Slot& slot = mSlots[(first + i) % mSlotCount];
+        slot.tag.store(completeTag(first + i) - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.words[0].store(packSlotHeader(recordSize, i, slotCount), std::memory_order_relaxed);
+        const size_t offset = i * SLOT_PAYLOAD_SIZE;
+        const size_t size = std::min(SLOT_PAYLOAD_SIZE, recordSize - offset);
+        for (size_t w = 0; w * sizeof(uint64_t) < size; w++) {
+            uint64_t word = 0;
+            memcpy(&word, tRecord.data() + offset + w * sizeof(uint64_t),
+                   std::min(sizeof(uint64_t), size - w * sizeof(uint64_t)));
+            slot.words[w + 1].store(word, std::memory_order_relaxed);
+        }
+
+        slot.tag.store(completeTag(first + i), std::memory_order_release);
+    }
+    mTransactionCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool TransactionTracing::readRecord(uint64_t first, uint64_t end, std::vector<uint8_t>* outRecord,
+                                    uint64_t* outSlotCount) const {
+    const Slot& head = mSlots[first % mSlotCount];
+    if (head.tag.load(std::memory_order_acquire) != completeTag(first)) {
+        return false;
+    }
+    const uint64_t header = head.words[0].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (head.tag.load(std::memory_order_relaxed) != completeTag(first)) {
+        return false;
+    }
+
+    // Slots that continue a record are skipped until the start of the next record.
+    const size_t recordSize = header >> 32;
+    const size_t slotIndex = (header >> 16) & 0xffff;
+    const size_t slotCount = header & 0xffff;
+    if (slotIndex != 0 || slotCount == 0 || first + slotCount > end ||
+        recordSize > slotCount * SLOT_PAYLOAD_SIZE) {
+        return false;
+    }
+
+    outRecord->resize(slotCount * SLOT_PAYLOAD_SIZE);
+    for (size_t i = 0; i < slotCount; i++) {
+        const Slot& slot = mSlots[(first + i) % mSlotCount];
+        const uint64_t tag = completeTag(first + i);
+        if (slot.tag.load(std::memory_order_acquire) != tag) {
+            return false;
+        }
+        const size_t offset = i * SLOT_PAYLOAD_SIZE;
+        const size_t size = std::min(SLOT_PAYLOAD_SIZE, recordSize - std::min(recordSize, offset));
+        for (size_t w = 0; w * sizeof(uint64_t) < size; w++) {
+            const uint64_t word = slot.words[w + 1].load(std::memory_order_relaxed);
+            memcpy(outRecord->data() + offset + w * sizeof(uint64_t), &word, sizeof(uint64_t));
+        }
+        // The slot may have been reused while it was copied.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.tag.load(std::memory_order_relaxed) != tag) {
+            return false;
+        }
+    }
+    outRecord->resize(recordSize);
+    *outSlotCount = slotCount;
+    return true;
+}
+
+void TransactionTracing::writeToProto(Trace* outTrace) const {
+    ATRACE_CALL();
+
+    const uint64_t end = mNextSlot.load(std::memory_order_acquire);
+    uint64_t slot = end > mSlotCount ? end - mSlotCount : 0;
+
+    std::vector<uint8_t> record;
+    while (slot < end) {
+        uint64_t slotCount;
+        if (!readRecord(slot, end, &record, &slotCount)) {
+            slot++;
+            continue;
+        }
+        slot += slotCount;
+
+        Increment* increment = outTrace->add_increment();
+        if (!readRecordToIncrement(record, increment)) {
+            ALOGW("Skipping malformed transaction record");
+            outTrace->mutable_increment()->RemoveLast();
+        }
+    }
+}
+
+status_t TransactionTracing::writeToFile(const char* fileName) const {
+    Trace trace;
+    writeToProto(&trace);
+
+    std::string output;
+    if (!trace.SerializeToString(&output)) {
+        ALOGE("Could not serialize transaction trace");
+        return PERMISSION_DENIED;
+    }
+    if (!base::WriteStringToFile(output, fileName, true)) {
+        ALOGE("Could not save transaction trace to %s", fileName);
+        return PERMISSION_DENIED;
+    }
+    return NO_ERROR;
+}
+
+void TransactionTracing::dump(std::string& result) const {
+    result.append("TransactionTracing:\n");
+    StringAppendF(&result, "  buffer: %zu KB, %" PRIu64 " transactions recorded, %" PRIu64
+                  " too large to record\n",
+                  mSlotCount * sizeof(Slot) / 1024,
+                  mTransactionCount.load(std::memory_order_relaxed),
+                  mDroppedCount.load(std::memory_order_relaxed));
+}
+
+} // namespace android
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gui/LayerState.h>
+#include <utils/Errors.h>
+#include <utils/Vector.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace android {
+
+namespace surfaceflinger {
+class Trace;
+} // namespace surfaceflinger
+
+/*
+ * TransactionTracing records the layer changes of every transaction into a fixed size ring buffer,
+ * cheaply enough to be left on. Transactions are written as compact binary records of the
+ * layer_state_t fields, with layer ids in place of binders, from any number of binder threads at
+ * once and without taking a lock. The records are only converted to the SurfaceInterceptor proto
+ * when the trace is dumped, so that the last few seconds of transactions can be replayed after
+ * jank is seen.
+ */
+class TransactionTracing {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 2 * 1024 * 1024;
+    static constexpr auto DEFAULT_FILE_NAME = "/data/misc/wmtrace/transactions_trace.pb";
+
+    explicit TransactionTracing(size_t bufferSize = DEFAULT_BUFFER_SIZE);
+
+    TransactionTracing(const TransactionTracing&) = delete;
+    TransactionTracing& operator=(const TransactionTracing&) = delete;
+
+    // Thread safe and lock-free. Transactions too large for a quarter of the buffer are dropped.
+    void addTransaction(const Vector<ComposerState>& states, uint32_t flags, int originPid,
+                        int originUid, uint64_t transactionId);
+
+    // Converts the transactions in the buffer, oldest first. Transactions that are overwritten
+    // while they are read are skipped.
+    void writeToProto(surfaceflinger::Trace* outTrace) const;
+    status_t writeToFile(const char* fileName = DEFAULT_FILE_NAME) const;
+
+    void dump(std::string& result) const;
+
+private:
+    // A record is split across consecutive slots. The first word of each slot packs the size of
+    // the record, the index of the slot within the record and the number of slots of the record.
+    static constexpr size_t SLOT_WORDS = 16;
+    static constexpr size_t SLOT_PAYLOAD_SIZE = (SLOT_WORDS - 1) * sizeof(uint64_t);
+
+    struct Slot {
+        // Sequence lock: 2 * n + 1 while the n-th slot since tracing started is written into this
+        // slot, and 2 * n + 2 once it is complete.
+        std::atomic<uint64_t> tag{0};
+        std::atomic<uint64_t> words[SLOT_WORDS];
+    };
+
+    bool readRecord(uint64_t first, uint64_t end, std::vector<uint8_t>* outRecord,
+                    uint64_t* outSlotCount) const;
+
+    const size_t mSlotCount;
+    const std::unique_ptr<Slot[]> mSlots;
+
+    // Index of the next slot to write, counted since tracing started.
+    std::atomic<uint64_t> mNextSlot{0};
+    std::atomic<uint64_t> mTransactionCount{0};
+    std::atomic<uint64_t> mDroppedCount{0};
+};
+
+} // namespace android
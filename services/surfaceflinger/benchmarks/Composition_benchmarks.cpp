@@ -0,0 +1,291 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconversion"
+#pragma clang diagnostic ignored "-Wextra"
+
+#include <benchmark/benchmark.h>
+#include <compositionengine/Display.h>
+#include <compositionengine/mock/DisplaySurface.h>
+#include <gmock/gmock.h>
+#include <gui/LayerMetadata.h>
+#include <renderengine/mock/RenderEngine.h>
+#include <system/window.h>
+
+#include <chrono>
+
+#include "EffectLayer.h"
+#include "Layer.h"
+#include "TestableSurfaceFlinger.h"
+#include "mock/DisplayHardware/MockComposer.h"
+#include "mock/DisplayHardware/MockPowerAdvisor.h"
+#include "mock/MockEventThread.h"
+#include "mock/MockMessageQueue.h"
+#include "mock/MockTimeStats.h"
+#include "mock/MockVSyncTracker.h"
+#include "mock/MockVsyncController.h"
+#include "mock/system/window/MockNativeWindow.h"
+
+namespace android {
+namespace {
+
+using hal::Error;
+
+using testing::_;
+using testing::DoAll;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::ReturnRef;
+using testing::SetArgPointee;
+
+using FakeHwcDisplayInjector = TestableSurfaceFlinger::FakeHwcDisplayInjector;
+using FakeDisplayDeviceInjector = TestableSurfaceFlinger::FakeDisplayDeviceInjector;
+
+constexpr hal::HWDisplayId kHwcDisplayId = FakeHwcDisplayInjector::DEFAULT_HWC_DISPLAY_ID;
+constexpr PhysicalDisplayId kDisplayId(42);
+constexpr int kDisplayWidth = 1920;
+constexpr int kDisplayHeight = 1080;
+constexpr uint32_t kLayerStack = 7000;
+
+constexpr int kLayerWidth = 400;
+constexpr int kLayerHeight = 300;
+
+// Drives SurfaceFlinger's main thread through whole frames, with the composer HAL and
+// RenderEngine replaced by mocks so that only the cost of SurfaceFlinger and CompositionEngine is
+// measured. The mocks answer every call, as if the HAL accepted whatever was asked of it.
+class CompositionBenchmark {
+public:
+    CompositionBenchmark() {
+        mFlinger.mutableEventQueue().reset(mMessageQueue);
+        setupScheduler();
+
+        ON_CALL(*mNativeWindow, query(NATIVE_WINDOW_WIDTH, _))
+                .WillByDefault(DoAll(SetArgPointee<1>(kDisplayWidth), Return(0)));
+        ON_CALL(*mNativeWindow, query(NATIVE_WINDOW_HEIGHT, _))
+                .WillByDefault(DoAll(SetArgPointee<1>(kDisplayHeight), Return(0)));
+        ON_CALL(*mNativeWindow, dequeueBuffer(_, _))
+                .WillByDefault(DoAll(SetArgPointee<0>(mNativeWindowBuffer), SetArgPointee<1>(-1),
+                                     Return(0)));
+        ON_CALL(*mDisplaySurface, getClientTargetAcquireFence())
+                .WillByDefault(ReturnRef(mClientTargetAcquireFence));
+        ON_CALL(*mRenderEngine, getMaxTextureSize()).WillByDefault(Return(16384));
+        ON_CALL(*mRenderEngine, getMaxViewportDims()).WillByDefault(Return(16384));
+
+        mFlinger.setupRenderEngine(std::unique_ptr<renderengine::RenderEngine>(mRenderEngine));
+        mFlinger.setupTimeStats(std::shared_ptr<TimeStats>(mTimeStats));
+
+        ON_CALL(*mComposer, createLayer(kHwcDisplayId, _))
+                .WillByDefault(Invoke([this](Hwc2::Display, Hwc2::Layer* outLayer) {
+                    *outLayer = mNextHwcLayerId++;
+                    return Error::NONE;
+                }));
+        mFlinger.setupComposer(std::unique_ptr<Hwc2::Composer>(mComposer));
+
+        setupDisplay();
+    }
+
+    // Creates layerCount overlapping layers spread over the display. Every fourth layer is plain,
+    // the others round their corners, cast shadows or blur what is behind them, so that both HWC
+    // and client composition are exercised.
+    void createLayers(size_t layerCount) {
+        for (size_t i = 0; i < layerCount; i++) {
+            sp<Layer> layer = new EffectLayer(
+                    LayerCreationArgs(mFlinger.flinger(), sp<Client>(),
+                                      "benchmark-layer-" + std::to_string(i), kLayerWidth,
+                                      kLayerHeight, 0, LayerMetadata()));
+
+            const int left = static_cast<int>(i * 37 % (kDisplayWidth - kLayerWidth));
+            const int top = static_cast<int>(i * 53 % (kDisplayHeight - kLayerHeight));
+
+            auto& state = TestableSurfaceFlinger::mutableLayerDrawingState(layer);
+            state.layerStack = kLayerStack;
+            state.z = static_cast<int32_t>(i);
+            state.crop = Rect(left, top, left + kLayerWidth, top + kLayerHeight);
+            state.color = half4(0.2f, 0.4f, 0.6f, 1.0f);
+            switch (i % 4) {
+                case 1:
+                    state.cornerRadius = 16.0f;
+                    break;
+                case 2:
+                    state.shadowRadius = 24.0f;
+                    break;
+                case 3:
+                    state.color.a = 0.5f;
+                    state.backgroundBlurRadius = 40;
+                    break;
+                default:
+                    break;
+            }
+
+            mFlinger.mutableCurrentState().layersSortedByZ.add(layer);
+            mFlinger.mutableDrawingState().layersSortedByZ.add(layer);
+            mLayers.push_back(layer);
+        }
+    }
+
+    // Forces the next frame to recompute visible regions and resend the layers' geometry to
+    // HWC, as happens whenever a layer moves or the layer stack changes.
+    void invalidateGeometry() {
+        mFlinger.mutableVisibleRegionsDirty() = true;
+        mFlinger.mutableGeometryInvalid() = true;
+    }
+
+    // The main thread's handling of a vsync: commit applies transactions and latches state,
+    // composite runs CompositionEngine::present.
+    void commit() { mFlinger.onMessageReceived(MessageQueue::INVALIDATE); }
+    void composite() { mFlinger.onMessageReceived(MessageQueue::REFRESH); }
+
+private:
+    void setupScheduler() {
+        auto eventThread = std::make_unique<NiceMock<mock::EventThread>>();
+        auto sfEventThread = std::make_unique<NiceMock<mock::EventThread>>();
+
+        ON_CALL(*eventThread, createEventConnection(_, _))
+                .WillByDefault(Return(new EventThreadConnection(eventThread.get(),
+                                                                /*callingUid=*/0,
+                                                                ResyncCallback())));
+        ON_CALL(*sfEventThread, createEventConnection(_, _))
+                .WillByDefault(Return(new EventThreadConnection(sfEventThread.get(),
+                                                                /*callingUid=*/0,
+                                                                ResyncCallback())));
+
+        auto vsyncController = std::make_unique<NiceMock<mock::VsyncController>>();
+        auto vsyncTracker = std::make_unique<NiceMock<mock::VSyncTracker>>();
+
+        ON_CALL(*vsyncTracker, nextAnticipatedVSyncTimeFrom(_)).WillByDefault(Return(0));
+        ON_CALL(*vsyncTracker, currentPeriod())
+                .WillByDefault(Return(FakeHwcDisplayInjector::DEFAULT_VSYNC_PERIOD));
+
+        constexpr ISchedulerCallback* kCallback = nullptr;
+        constexpr bool kHasMultipleConfigs = true;
+        mFlinger.setupScheduler(std::move(vsyncController), std::move(vsyncTracker),
+                                std::move(eventThread), std::move(sfEventThread), kCallback,
+                                kHasMultipleConfigs);
+    }
+
+    void setupDisplay() {
+        FakeHwcDisplayInjector(kDisplayId, hal::DisplayType::PHYSICAL, true /* isPrimary */)
+                .setPowerMode(hal::PowerMode::ON)
+                .inject(&mFlinger, mComposer);
+
+        auto ceDisplayArgs = compositionengine::DisplayCreationArgsBuilder()
+                                     .setId(kDisplayId)
+                                     .setConnectionType(ui::DisplayConnectionType::Internal)
+                                     .setPixels({kDisplayWidth, kDisplayHeight})
+                                     .setIsSecure(true)
+                                     .setLayerStackId(kLayerStack)
+                                     .setPowerAdvisor(&mPowerAdvisor)
+                                     .setName("Injected display for benchmark")
+                                     .build();
+
+        auto compositionDisplay =
+                compositionengine::impl::createDisplay(mFlinger.getCompositionEngine(),
+                                                       ceDisplayArgs);
+
+        mDisplay = FakeDisplayDeviceInjector(mFlinger, compositionDisplay,
+                                             ui::DisplayConnectionType::Internal, kHwcDisplayId,
+                                             true /* isPrimary */)
+                           .setDisplaySurface(mDisplaySurface)
+                           .setNativeWindow(mNativeWindow)
+                           .setSecure(true)
+                           .setPowerMode(hal::PowerMode::ON)
+                           .inject();
+        mDisplay->setLayerStack(kLayerStack);
+    }
+
+    TestableSurfaceFlinger mFlinger;
+    sp<DisplayDevice> mDisplay;
+    std::vector<sp<Layer>> mLayers;
+
+    sp<compositionengine::mock::DisplaySurface> mDisplaySurface =
+            new NiceMock<compositionengine::mock::DisplaySurface>();
+    mock::NativeWindow* mNativeWindow = new NiceMock<mock::NativeWindow>();
+    sp<GraphicBuffer> mBuffer = new GraphicBuffer();
+    ANativeWindowBuffer* mNativeWindowBuffer = mBuffer->getNativeBuffer();
+    sp<Fence> mClientTargetAcquireFence = Fence::NO_FENCE;
+
+    Hwc2::mock::Composer* mComposer = new NiceMock<Hwc2::mock::Composer>();
+    renderengine::mock::RenderEngine* mRenderEngine =
+            new NiceMock<renderengine::mock::RenderEngine>();
+    mock::TimeStats* mTimeStats = new NiceMock<mock::TimeStats>();
+    mock::MessageQueue* mMessageQueue = new NiceMock<mock::MessageQueue>();
+    NiceMock<Hwc2::mock::PowerAdvisor> mPowerAdvisor;
+
+    hal::HWLayerId mNextHwcLayerId = 5000;
+};
+
+double elapsedMicros(std::chrono::steady_clock::time_point start,
+                     std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// Measures the main thread's time per frame against the number of layers, split into the commit
+// and composite phases. The second argument selects whether every frame invalidates the
+// geometry, which is the expensive case of a layer moving, or only the content changes.
+void BM_frame(benchmark::State& state) {
+    const auto layerCount = static_cast<size_t>(state.range(0));
+    const bool geometryDirty = state.range(1) != 0;
+
+    CompositionBenchmark frames;
+    frames.createLayers(layerCount);
+
+    // The first frame computes the visible regions and creates the HWC layers.
+    frames.invalidateGeometry();
+    frames.commit();
+    frames.composite();
+
+    double commitMicros = 0;
+    double compositeMicros = 0;
+    for (auto _ : state) {
+        if (geometryDirty) {
+            frames.invalidateGeometry();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        frames.commit();
+        const auto committed = std::chrono::steady_clock::now();
+        frames.composite();
+        const auto end = std::chrono::steady_clock::now();
+
+        commitMicros += elapsedMicros(start, committed);
+        compositeMicros += elapsedMicros(committed, end);
+    }
+
+    state.counters["commit_us"] =
+            benchmark::Counter(commitMicros, benchmark::Counter::kAvgIterations);
+    state.counters["composite_us"] =
+            benchmark::Counter(compositeMicros, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_frame)
+        ->Args({1, 0})
+        ->Args({8, 0})
+        ->Args({32, 0})
+        ->Args({128, 0})
+        ->Args({1, 1})
+        ->Args({8, 1})
+        ->Args({32, 1})
+        ->Args({128, 1});
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
+
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic pop // ignored "-Wconversion -Wextra"
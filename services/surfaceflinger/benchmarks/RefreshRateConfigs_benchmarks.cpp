@@ -0,0 +1,98 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "Scheduler/RefreshRateConfigs.h"
+
+namespace android::scheduler {
+namespace {
+
+namespace hal = hardware::graphics::composer::hal;
+
+using LayerRequirement = RefreshRateConfigs::LayerRequirement;
+using LayerVoteType = RefreshRateConfigs::LayerVoteType;
+
+// The refresh rates of a panel with many modes, as a worst case for scoring.
+constexpr float kRefreshRates[] = {24.0f, 25.0f, 30.0f, 48.0f,  50.0f,  60.0f,
+                                   72.0f, 90.0f, 96.0f, 100.0f, 120.0f, 144.0f};
+
+constexpr LayerVoteType kVotes[] = {LayerVoteType::Heuristic, LayerVoteType::ExplicitDefault,
+                                    LayerVoteType::ExplicitExactOrMultiple, LayerVoteType::Min,
+                                    LayerVoteType::Max};
+
+constexpr float kDesiredRefreshRates[] = {24.0f, 30.0f, 60.0f, 90.0f, 120.0f};
+
+DisplayModes createDisplayModes() {
+    DisplayModes modes;
+    for (size_t i = 0; i < std::size(kRefreshRates); i++) {
+        const auto modeId = static_cast<hal::HWConfigId>(i);
+        modes.push_back(DisplayMode::Builder(modeId)
+                                .setId(DisplayModeId(static_cast<int>(i)))
+                                .setVsyncPeriod(
+                                        static_cast<int32_t>(Fps(kRefreshRates[i]).getPeriodNsecs()))
+                                .setGroup(0)
+                                .build());
+    }
+    return modes;
+}
+
+// Creates a set of layers voting for a mix of refresh rates. The offset shifts the desired
+// refresh rates around so that consecutive sets differ.
+std::vector<LayerRequirement> createLayers(size_t count, size_t offset) {
+    std::vector<LayerRequirement> layers;
+    for (size_t i = 0; i < count; i++) {
+        layers.push_back(LayerRequirement{
+                .name = "Layer" + std::to_string(i),
+                .vote = kVotes[i % std::size(kVotes)],
+                .desiredRefreshRate =
+                        Fps(kDesiredRefreshRates[(i + offset) % std::size(kDesiredRefreshRates)]),
+                .weight = 1.0f,
+                .focused = i == 0,
+        });
+    }
+    return layers;
+}
+
+// Measures the scoring of modes, by alternating between two sets of layers so that every call
+// misses the cache of the last result.
+void BM_getBestRefreshRate(benchmark::State& state) {
+    const auto layerCount = static_cast<size_t>(state.range(0));
+    RefreshRateConfigs configs(createDisplayModes(), DisplayModeId(0));
+    const std::vector<LayerRequirement> layers[] = {createLayers(layerCount, 0),
+                                                    createLayers(layerCount, 1)};
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(configs.getBestRefreshRate(layers[i++ % 2], {}));
+    }
+}
+BENCHMARK(BM_getBestRefreshRate)->Arg(1)->Arg(8)->Arg(32);
+
+// Measures the calls made while nothing changes, which are answered from the cache.
+void BM_getBestRefreshRate_unchanged(benchmark::State& state) {
+    const auto layerCount = static_cast<size_t>(state.range(0));
+    RefreshRateConfigs configs(createDisplayModes(), DisplayModeId(0));
+    const auto layers = createLayers(layerCount, 0);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(configs.getBestRefreshRate(layers, {}));
+    }
+}
+BENCHMARK(BM_getBestRefreshRate_unchanged)->Arg(1)->Arg(8)->Arg(32);
+
+} // namespace
+} // namespace android::scheduler
+
+BENCHMARK_MAIN();
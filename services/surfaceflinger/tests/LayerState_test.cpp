@@ -114,5 +114,69 @@ TEST(LayerStateTest, ParcellingScreenCaptureResults) {
     ASSERT_EQ(results.result, results2.result);
 }
 
+TEST(LayerStateTest, ParcellingPositionAndAlphaOnlyLayerState) {
+    layer_state_t state;
+    state.surface = new BBinder();
+    state.layerId = 7;
+    state.what = layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged;
+    state.x = 10.5f;
+    state.y = 20.5f;
+    state.alpha = 0.5f;
+    // not selected by 'what', so not sent
+    state.z = 3;
+    state.crop = Rect(0, 0, 10, 10);
+
+    Parcel p;
+    ASSERT_EQ(NO_ERROR, state.write(p));
+    p.setDataPosition(0);
+
+    layer_state_t state2;
+    ASSERT_EQ(NO_ERROR, state2.read(p));
+    ASSERT_EQ(p.dataSize(), p.dataPosition());
+
+    ASSERT_EQ(state.surface, state2.surface);
+    ASSERT_EQ(state.layerId, state2.layerId);
+    ASSERT_EQ(state.what, state2.what);
+    ASSERT_EQ(state.x, state2.x);
+    ASSERT_EQ(state.y, state2.y);
+    ASSERT_EQ(state.alpha, state2.alpha);
+    ASSERT_EQ(0, state2.z);
+    ASSERT_EQ(Rect::INVALID_RECT, state2.crop);
+}
+
+TEST(LayerStateTest, ParcellingLayerStateOnlySendsSelectedFields) {
+    layer_state_t state;
+    state.what = layer_state_t::eLayerChanged | layer_state_t::eCropChanged |
+            layer_state_t::eFrameNumberChanged | layer_state_t::eFrameRateChanged;
+    state.z = 5;
+    state.crop = Rect(1, 2, 3, 4);
+    state.frameNumber = 42;
+    state.frameRate = 60.0f;
+    state.frameRateCompatibility = ANATIVEWINDOW_FRAME_RATE_COMPATIBILITY_FIXED_SOURCE;
+    // not selected by 'what', so not sent
+    state.x = 10;
+    state.cornerRadius = 8.0f;
+    state.bufferCrop = Rect(0, 0, 5, 5);
+
+    Parcel p;
+    ASSERT_EQ(NO_ERROR, state.write(p));
+    p.setDataPosition(0);
+
+    layer_state_t state2;
+    ASSERT_EQ(NO_ERROR, state2.read(p));
+    ASSERT_EQ(p.dataSize(), p.dataPosition());
+
+    ASSERT_EQ(state.what, state2.what);
+    ASSERT_EQ(state.z, state2.z);
+    ASSERT_EQ(state.crop, state2.crop);
+    ASSERT_EQ(state.frameNumber, state2.frameNumber);
+    ASSERT_EQ(nullptr, state2.buffer);
+    ASSERT_EQ(state.frameRate, state2.frameRate);
+    ASSERT_EQ(state.frameRateCompatibility, state2.frameRateCompatibility);
+    ASSERT_EQ(0, state2.x);
+    ASSERT_EQ(0.0f, state2.cornerRadius);
+    ASSERT_EQ(Rect::INVALID_RECT, state2.bufferCrop);
+}
+
 } // namespace test
 } // namespace android
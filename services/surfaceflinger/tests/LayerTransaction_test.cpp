@@ -63,6 +63,40 @@ TEST_F(LayerTransactionTest, ReparentToSelf) {
     }
 }
 
+TEST_F(LayerTransactionTest, CoalescedTransactionsAppliedOnFlush) {
+    sp<SurfaceControl> layer;
+    ASSERT_NO_FATAL_FAILURE(layer = createLayer("test", 32, 32));
+    ASSERT_NO_FATAL_FAILURE(fillBufferQueueLayerColor(layer, Color::RED, 32, 32));
+
+    Transaction::setCoalescingEnabled(true);
+    Transaction().setPosition(layer, 10, 10).apply();
+    Transaction().setPosition(layer, 20, 20).apply();
+    ASSERT_EQ(NO_ERROR, Transaction::flushCoalesced());
+    Transaction::setCoalescingEnabled(false);
+
+    const Rect rect(20, 20, 52, 52);
+    auto shot = screenshot();
+    shot->expectColor(rect, Color::RED);
+    shot->expectBorder(rect, Color::BLACK);
+}
+
+TEST_F(LayerTransactionTest, SynchronousTransactionFlushesCoalesced) {
+    sp<SurfaceControl> layer;
+    ASSERT_NO_FATAL_FAILURE(layer = createLayer("test", 32, 32));
+    ASSERT_NO_FATAL_FAILURE(fillBufferQueueLayerColor(layer, Color::RED, 32, 32));
+
+    Transaction::setCoalescingEnabled(true);
+    Transaction().setPosition(layer, 10, 10).apply();
+    // Sent straight away, after the pending transaction
+    Transaction().setLayer(layer, INT32_MAX - 1).apply(true /* synchronous */);
+    Transaction::setCoalescingEnabled(false);
+
+    const Rect rect(10, 10, 42, 42);
+    auto shot = screenshot();
+    shot->expectColor(rect, Color::RED);
+    shot->expectBorder(rect, Color::BLACK);
+}
+
 // This test ensures that when we drop an app buffer in SurfaceFlinger, we merge
 // the dropped buffer's damage region into the next buffer's damage region. If
 // we don't do this, we'll report an incorrect damage region to hardware
@@ -370,6 +370,32 @@ TEST_F(EventThreadTest, setVsyncRateZeroPostsNoVSyncEventsToThatConnection) {
                                          1u);
 }
 
+TEST_F(EventThreadTest, vsyncIsPublishedToTimelineForConnectionsNotRequestingIt) {
+    ConnectionEventRecorder passiveConnectionEventRecorder{0};
+    sp<MockEventThreadConnection> passiveConnection =
+            createConnection(passiveConnectionEventRecorder);
+    mThread->setVsyncRate(0, passiveConnection);
+
+    mThread->setVsyncRate(1, mConnection);
+    expectVSyncSetEnabledCallReceived(true);
+
+    mCallback->onVSyncEvent(123, 456, 789);
+    expectVsyncEventReceivedByConnection(123, 1u);
+    EXPECT_FALSE(passiveConnectionEventRecorder.waitForUnexpectedCall().has_value());
+
+    base::unique_fd fd;
+    ASSERT_EQ(NO_ERROR, passiveConnection->getVsyncTimeline(&fd));
+    const auto timeline = VsyncTimeline::createFromFd(std::move(fd));
+    ASSERT_NE(nullptr, timeline);
+
+    VsyncTimelineEntry vsync;
+    ASSERT_EQ(NO_ERROR, timeline->getLatestVsync(&vsync));
+    EXPECT_EQ(1u, vsync.count);
+    EXPECT_EQ(123, vsync.timestamp);
+    EXPECT_EQ(456, vsync.expectedVSyncTimestamp);
+    EXPECT_EQ(789, vsync.deadlineTimestamp);
+}
+
 TEST_F(EventThreadTest, setVsyncRateOnePostsAllEventsToThatConnection) {
     mThread->setVsyncRate(1, mConnection);
 
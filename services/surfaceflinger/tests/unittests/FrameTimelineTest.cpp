@@ -28,6 +28,7 @@
 
 using namespace std::chrono_literals;
 using testing::_;
+using testing::AnyNumber;
 using testing::AtLeast;
 using testing::Contains;
 using FrameTimelineEvent = perfetto::protos::FrameTimelineEvent;
@@ -361,6 +362,35 @@ TEST_F(FrameTimelineTest, displayFramesSlidingWindowMovesAfterLimit) {
     EXPECT_EQ(compareTimelineItems(displayFrame0->getActuals(), TimelineItem(52, 57, 62)), true);
 }
 
+TEST_F(FrameTimelineTest, displayFramesSlidingWindowRecyclesOldestFrame) {
+    *maxDisplayFrames = 2;
+    EXPECT_CALL(*mTimeStats, incrementJankyFrames(_)).Times(AnyNumber());
+
+    int64_t sfToken = mTokenManager->generateTokenForPredictions({22, 26, 30});
+    mFrameTimeline->setSfWakeUp(sfToken, 22, Fps::fromPeriodNsecs(11));
+    auto surfaceFrame =
+            mFrameTimeline->createSurfaceFrameForToken({}, sPidOne, sUidOne, sLayerIdOne,
+                                                       sLayerNameOne, sLayerNameOne,
+                                                       /*isBuffer*/ true, sGameMode);
+    mFrameTimeline->addSurfaceFrame(surfaceFrame);
+    auto presentFence = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+    presentFence->signalForTest(32);
+    mFrameTimeline->setSfPresent(27, presentFence);
+    const impl::FrameTimeline::DisplayFrame* oldestDisplayFrame = getDisplayFrame(0).get();
+
+    addEmptyDisplayFrame();
+    addEmptyDisplayFrame();
+
+    // The oldest frame slid out of the window and became the current frame, without any of its
+    // previous data.
+    std::lock_guard<std::mutex> lock(mFrameTimeline->mMutex);
+    EXPECT_EQ(oldestDisplayFrame, mFrameTimeline->mCurrentDisplayFrame.get());
+    EXPECT_TRUE(mFrameTimeline->mCurrentDisplayFrame->getSurfaceFrames().empty());
+    EXPECT_TRUE(compareTimelineItems(mFrameTimeline->mCurrentDisplayFrame->getActuals(),
+                                     TimelineItem()));
+    EXPECT_EQ(JankType::None, mFrameTimeline->mCurrentDisplayFrame->getJankType());
+}
+
 TEST_F(FrameTimelineTest, surfaceFrameEndTimeAcquireFenceAfterQueue) {
     auto surfaceFrame = mFrameTimeline->createSurfaceFrameForToken({}, sPidOne, 0, sLayerIdOne,
                                                                    "acquireFenceAfterQueue",
@@ -461,6 +491,56 @@ TEST_F(FrameTimelineTest, presentFenceSignaled_invalidSignalTime) {
     EXPECT_EQ(surfaceFrame1->getJankType(), JankType::Unknown);
 }
 
+TEST_F(FrameTimelineTest, sfWakeUp_countsFramesInFlight) {
+    Fps refreshRate = Fps::fromPeriodNsecs(11);
+    auto presentFence1 = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+    auto presentFence2 = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+    auto presentFence3 = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+    int64_t sfToken1 = mTokenManager->generateTokenForPredictions({22, 26, 33});
+    int64_t sfToken2 = mTokenManager->generateTokenForPredictions({33, 37, 44});
+    int64_t sfToken3 = mTokenManager->generateTokenForPredictions({44, 48, 55});
+
+    mFrameTimeline->setSfWakeUp(sfToken1, 22, refreshRate);
+    mFrameTimeline->setSfPresent(26, presentFence1);
+
+    // The first frame hasn't been presented when the second one starts.
+    mFrameTimeline->setSfWakeUp(sfToken2, 33, refreshRate);
+    mFrameTimeline->setSfPresent(37, presentFence2);
+
+    // Only the second frame is still outstanding when the third one starts.
+    presentFence1->signalForTest(40);
+    mFrameTimeline->setSfWakeUp(sfToken3, 44, refreshRate);
+    mFrameTimeline->setSfPresent(48, presentFence3);
+
+    EXPECT_EQ(getDisplayFrame(0)->getFramesInFlight(), 0u);
+    EXPECT_EQ(getDisplayFrame(1)->getFramesInFlight(), 1u);
+    EXPECT_EQ(getDisplayFrame(2)->getFramesInFlight(), 1u);
+}
+
+TEST_F(FrameTimelineTest, sfPresent_keepsLastSfTimelines) {
+    Fps refreshRate = Fps::fromPeriodNsecs(11);
+    auto presentFence1 = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+    auto presentFence2 = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+    int64_t sfToken1 = mTokenManager->generateTokenForPredictions({22, 26, 33});
+    EXPECT_FALSE(mFrameTimeline->getLastSfTimelines().has_value());
+
+    mFrameTimeline->setSfWakeUp(sfToken1, 23, refreshRate);
+    mFrameTimeline->setSfPresent(28, presentFence1);
+
+    auto timelines = mFrameTimeline->getLastSfTimelines();
+    ASSERT_TRUE(timelines.has_value());
+    const auto& [predictions, actuals] = *timelines;
+    EXPECT_EQ(predictions.startTime, 22);
+    EXPECT_EQ(predictions.endTime, 26);
+    EXPECT_EQ(actuals.startTime, 23);
+    EXPECT_EQ(actuals.endTime, 28);
+
+    // Frames without predictions have no target to compare against.
+    mFrameTimeline->setSfWakeUp(FrameTimelineInfo::INVALID_VSYNC_ID, 33, refreshRate);
+    mFrameTimeline->setSfPresent(37, presentFence2);
+    EXPECT_FALSE(mFrameTimeline->getLastSfTimelines().has_value());
+}
+
 // Tests related to TimeStats
 TEST_F(FrameTimelineTest, presentFenceSignaled_doesNotReportForInvalidTokens) {
     Fps refreshRate = Fps::fromPeriodNsecs(11);
@@ -179,5 +179,36 @@ TEST_F(HWComposerLayerGenericMetadataTest, forwardsSupportedMetadata) {
     EXPECT_EQ(hal::Error::UNSUPPORTED, result);
 }
 
+struct HWComposerLayerStateTest : public HWComposerLayerTest {
+    HWComposerLayerStateTest() : HWComposerLayerTest({}) {}
+};
+
+TEST_F(HWComposerLayerStateTest, onlyForwardsChangedState) {
+    const Rect frame(1, 2, 3, 4);
+    const Rect otherFrame(5, 6, 7, 8);
+
+    EXPECT_CALL(*mHal, setLayerZOrder(kDisplayId, kLayerId, 1u))
+            .WillOnce(Return(hardware::graphics::composer::V2_4::Error::NONE));
+    EXPECT_CALL(*mHal, setLayerDisplayFrame(kDisplayId, kLayerId, _))
+            .Times(2)
+            .WillRepeatedly(Return(hardware::graphics::composer::V2_4::Error::NONE));
+
+    EXPECT_EQ(hal::Error::NONE, mLayer.setZOrder(1u));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setZOrder(1u));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setDisplayFrame(frame));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setDisplayFrame(frame));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setDisplayFrame(otherFrame));
+}
+
+TEST_F(HWComposerLayerStateTest, forwardsStateAgainAfterAnError) {
+    EXPECT_CALL(*mHal, setLayerPlaneAlpha(kDisplayId, kLayerId, 0.5f))
+            .WillOnce(Return(hardware::graphics::composer::V2_4::Error::BAD_LAYER))
+            .WillOnce(Return(hardware::graphics::composer::V2_4::Error::NONE));
+
+    EXPECT_EQ(hal::Error::BAD_LAYER, mLayer.setPlaneAlpha(0.5f));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setPlaneAlpha(0.5f));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setPlaneAlpha(0.5f));
+}
+
 } // namespace
 } // namespace android
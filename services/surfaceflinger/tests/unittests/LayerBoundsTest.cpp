@@ -0,0 +1,143 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <gui/LayerMetadata.h>
+
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconversion"
+#include "EffectLayer.h"
+#include "Layer.h"
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic pop // ignored "-Wconversion"
+#include "TestableSurfaceFlinger.h"
+#include "mock/DisplayHardware/MockComposer.h"
+#include "mock/MockEventThread.h"
+#include "mock/MockMessageQueue.h"
+#include "mock/MockVsyncController.h"
+
+namespace android {
+
+using testing::_;
+using testing::Return;
+
+using FakeHwcDisplayInjector = TestableSurfaceFlinger::FakeHwcDisplayInjector;
+
+/**
+ * This class tests that Layer::computeBounds only skips layers whose bounds
+ * can't have changed.
+ */
+class LayerBoundsTest : public testing::Test {
+protected:
+    LayerBoundsTest();
+
+    void setupScheduler();
+
+    sp<Layer> createLayer(const char* name, const Rect& crop) {
+        sp<Client> client;
+        LayerCreationArgs args(mFlinger.flinger(), client, name, 0, 0, 0, LayerMetadata());
+        sp<Layer> layer = new EffectLayer(args);
+        layer->setCrop(crop);
+        return layer;
+    }
+
+    // What SurfaceFlinger does to layers before computing their bounds.
+    void commit(const std::vector<sp<Layer>>& layers) {
+        for (const auto& layer : layers) {
+            layer->doTransaction(0);
+            layer->commitChildList();
+        }
+    }
+
+    void computeBounds(const sp<Layer>& root) {
+        root->computeBounds(FloatRect(0, 0, 1000, 1000), ui::Transform(), 0.f /* shadowRadius */);
+    }
+
+    TestableSurfaceFlinger mFlinger;
+    mock::MessageQueue* mMessageQueue = new mock::MessageQueue();
+};
+
+LayerBoundsTest::LayerBoundsTest() {
+    setupScheduler();
+    mFlinger.setupComposer(std::make_unique<Hwc2::mock::Composer>());
+    mFlinger.mutableEventQueue().reset(mMessageQueue);
+}
+
+void LayerBoundsTest::setupScheduler() {
+    auto eventThread = std::make_unique<mock::EventThread>();
+    auto sfEventThread = std::make_unique<mock::EventThread>();
+
+    EXPECT_CALL(*eventThread, registerDisplayEventConnection(_));
+    EXPECT_CALL(*eventThread, createEventConnection(_, _))
+            .WillOnce(Return(new EventThreadConnection(eventThread.get(), /*callingUid=*/0,
+                                                       ResyncCallback())));
+
+    EXPECT_CALL(*sfEventThread, registerDisplayEventConnection(_));
+    EXPECT_CALL(*sfEventThread, createEventConnection(_, _))
+            .WillOnce(Return(new EventThreadConnection(sfEventThread.get(), /*callingUid=*/0,
+                                                       ResyncCallback())));
+
+    auto vsyncController = std::make_unique<mock::VsyncController>();
+    auto vsyncTracker = std::make_unique<mock::VSyncTracker>();
+
+    EXPECT_CALL(*vsyncTracker, nextAnticipatedVSyncTimeFrom(_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*vsyncTracker, currentPeriod())
+            .WillRepeatedly(Return(FakeHwcDisplayInjector::DEFAULT_VSYNC_PERIOD));
+    mFlinger.setupScheduler(std::move(vsyncController), std::move(vsyncTracker),
+                            std::move(eventThread), std::move(sfEventThread));
+}
+
+namespace {
+
+TEST_F(LayerBoundsTest, updatesOnlyChangedLayers) {
+    sp<Layer> parent = createLayer("parent", Rect(0, 0, 100, 100));
+    sp<Layer> left = createLayer("left", Rect(0, 0, 10, 10));
+    sp<Layer> right = createLayer("right", Rect(0, 0, 20, 20));
+    parent->addChild(left);
+    parent->addChild(right);
+    commit({parent, left, right});
+    computeBounds(parent);
+    EXPECT_EQ(Rect(0, 0, 10, 10), left->getScreenBounds());
+    EXPECT_EQ(Rect(0, 0, 20, 20), right->getScreenBounds());
+
+    // Only a leaf changes
+    left->setPosition(5, 5);
+    commit({left});
+    computeBounds(parent);
+    EXPECT_EQ(Rect(5, 5, 15, 15), left->getScreenBounds());
+    EXPECT_EQ(Rect(0, 0, 20, 20), right->getScreenBounds());
+
+    // The parent changes, so its children move with it
+    parent->setPosition(100, 0);
+    commit({parent});
+    computeBounds(parent);
+    EXPECT_EQ(Rect(100, 0, 200, 100), parent->getScreenBounds());
+    EXPECT_EQ(Rect(105, 5, 115, 15), left->getScreenBounds());
+    EXPECT_EQ(Rect(100, 0, 120, 20), right->getScreenBounds());
+
+    // The same layers are computed against other parent bounds
+    parent->computeBounds(FloatRect(0, 0, 110, 10), ui::Transform(), 0.f /* shadowRadius */);
+    EXPECT_EQ(Rect(105, 5, 110, 10), left->getScreenBounds());
+    EXPECT_EQ(Rect(100, 0, 110, 10), right->getScreenBounds());
+}
+
+} // namespace
+} // namespace android
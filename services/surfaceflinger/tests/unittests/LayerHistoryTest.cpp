@@ -69,23 +69,20 @@ protected:
         const auto& infos = history().mLayerInfos;
         return std::count_if(infos.begin(),
                              infos.begin() + static_cast<long>(history().mActiveLayersEnd),
-                             [now](const auto& pair) { return pair.second->isFrequent(now); });
+                             [now](const auto& info) { return info->isFrequent(now); });
     }
 
     auto animatingLayerCount(nsecs_t now) const NO_THREAD_SAFETY_ANALYSIS {
         const auto& infos = history().mLayerInfos;
         return std::count_if(infos.begin(),
                              infos.begin() + static_cast<long>(history().mActiveLayersEnd),
-                             [now](const auto& pair) { return pair.second->isAnimating(now); });
+                             [now](const auto& info) { return info->isAnimating(now); });
     }
 
     void setDefaultLayerVote(Layer* layer,
                              LayerHistory::LayerVoteType vote) NO_THREAD_SAFETY_ANALYSIS {
-        for (auto& [layerUnsafe, info] : history().mLayerInfos) {
-            if (layerUnsafe == layer) {
-                info->setDefaultLayerVote(vote);
-                return;
-            }
+        if (const auto index = history().findLayer(layer)) {
+            history().mLayerInfos[*index]->setDefaultLayerVote(vote);
         }
     }
 
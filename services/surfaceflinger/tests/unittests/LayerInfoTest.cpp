@@ -19,6 +19,8 @@
 
 #include <gtest/gtest.h>
 
+#include <deque>
+
 #include "Fps.h"
 #include "Scheduler/LayerHistory.h"
 #include "Scheduler/LayerInfo.h"
@@ -30,7 +32,10 @@ protected:
     using FrameTimeData = LayerInfo::FrameTimeData;
 
     void setFrameTimes(const std::deque<FrameTimeData>& frameTimes) {
-        layerInfo.mFrameTimes = frameTimes;
+        layerInfo.mFrameTimes.clear();
+        for (const auto& frameTime : frameTimes) {
+            layerInfo.mFrameTimes.push_back(frameTime);
+        }
     }
 
     void setLastRefreshRate(Fps fps) {
@@ -40,6 +45,8 @@ protected:
 
     auto calculateAverageFrameTime() { return layerInfo.calculateAverageFrameTime(); }
 
+    auto detectCadence() { return layerInfo.detectCadence(); }
+
     LayerInfo layerInfo{"TestLayerInfo", 0, LayerHistory::LayerVoteType::Heuristic};
 };
 
@@ -177,5 +184,58 @@ TEST_F(LayerInfoTest, ignoresLargePeriods) {
             << "Expected " << averageFps << " to be equal to " << kExpectedFps;
 }
 
+
+TEST_F(LayerInfoTest, detectsPulldownCadence) {
+    std::deque<FrameTimeData> frameTimes;
+    constexpr auto kExpectedFps = Fps(24.0f);
+    constexpr nsecs_t kVsyncPeriod = Fps(60.0f).getPeriodNsecs();
+    constexpr int kNumFrames = 30;
+    // 3:2 pulldown of 24fps content onto 60Hz.
+    nsecs_t time = kVsyncPeriod;
+    for (int i = 0; i < kNumFrames; i++) {
+        frameTimes.push_back(
+                FrameTimeData{.presentTime = time, .queueTime = 0, .pendingModeChange = false});
+        time += kVsyncPeriod * (i % 2 == 0 ? 3 : 2);
+    }
+    setFrameTimes(frameTimes);
+    const auto cadence = detectCadence();
+    ASSERT_TRUE(cadence.has_value());
+    ASSERT_TRUE(kExpectedFps.equalsWithMargin(*cadence))
+            << "Expected " << *cadence << " to be equal to " << kExpectedFps;
+}
+
+TEST_F(LayerInfoTest, detectsJitteryCadence) {
+    std::deque<FrameTimeData> frameTimes;
+    constexpr auto kExpectedFps = Fps(30.0f);
+    constexpr auto kPeriod = kExpectedFps.getPeriodNsecs();
+    constexpr nsecs_t kJitter[] = {2'000'000, -1'500'000, 0};
+    constexpr int kNumFrames = 30;
+    for (int i = 1; i <= kNumFrames; i++) {
+        frameTimes.push_back(FrameTimeData{.presentTime = kPeriod * i + kJitter[i % 3],
+                                           .queueTime = 0,
+                                           .pendingModeChange = false});
+    }
+    setFrameTimes(frameTimes);
+    const auto cadence = detectCadence();
+    ASSERT_TRUE(cadence.has_value());
+    ASSERT_TRUE(kExpectedFps.equalsWithMargin(*cadence))
+            << "Expected " << *cadence << " to be equal to " << kExpectedFps;
+}
+
+TEST_F(LayerInfoTest, ignoresIrregularCadence) {
+    std::deque<FrameTimeData> frameTimes;
+    constexpr nsecs_t kDeltas[] = {11'000'000, 37'000'000, 23'000'000, 29'000'000};
+    constexpr int kNumFrames = 30;
+    nsecs_t time = 0;
+    for (int i = 0; i < kNumFrames; i++) {
+        time += kDeltas[i % 4];
+        frameTimes.push_back(
+                FrameTimeData{.presentTime = time, .queueTime = 0, .pendingModeChange = false});
+    }
+    setFrameTimes(frameTimes);
+    ASSERT_FALSE(detectCadence().has_value());
+    ASSERT_TRUE(calculateAverageFrameTime().has_value());
+}
+
 } // namespace
 } // namespace android::scheduler
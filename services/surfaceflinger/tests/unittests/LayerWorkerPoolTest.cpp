@@ -0,0 +1,78 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LayerWorkerPoolTest"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "LayerWorkerPool.h"
+
+namespace android {
+namespace {
+
+TEST(LayerWorkerPoolTest, runsEveryIndexOnce) {
+    LayerWorkerPool pool(3);
+    ASSERT_EQ(3u, pool.getThreadCount());
+
+    for (size_t count : {0u, 1u, 2u, 100u}) {
+        std::vector<std::atomic<int>> calls(count);
+        pool.run(count, [&](size_t i) { calls[i]++; });
+        for (size_t i = 0; i < count; i++) {
+            EXPECT_EQ(1, calls[i]) << "index " << i << " of " << count;
+        }
+    }
+}
+
+TEST(LayerWorkerPoolTest, runsOnWorkers) {
+    LayerWorkerPool pool(2);
+
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    std::atomic<int> waiting = 0;
+    // Every index blocks until all three threads have picked one up.
+    pool.run(3, [&](size_t) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.insert(std::this_thread::get_id());
+        }
+        waiting++;
+        while (waiting < 3) {
+            std::this_thread::yield();
+        }
+    });
+    EXPECT_EQ(3u, threads.size());
+}
+
+TEST(LayerWorkerPoolTest, runsInlineWithoutWorkers) {
+    LayerWorkerPool pool(0);
+
+    const auto caller = std::this_thread::get_id();
+    size_t calls = 0;
+    pool.run(5, [&](size_t) {
+        EXPECT_EQ(caller, std::this_thread::get_id());
+        calls++;
+    });
+    EXPECT_EQ(5u, calls);
+}
+
+} // namespace
+} // namespace android
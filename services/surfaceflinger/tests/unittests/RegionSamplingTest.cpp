@@ -140,6 +140,28 @@ TEST_F(RegionSamplingTest, orientation_90) {
                 testing::Eq(1.0));
 }
 
+TEST_F(RegionSamplingTest, scale_sample_area) {
+    EXPECT_EQ(Rect(0, 0, 25, 8), scaleSampleArea(whole_area, 4));
+    EXPECT_EQ(Rect(2, 1, 5, 3), scaleSampleArea(Rect{8, 4, 20, 12}, 4));
+    EXPECT_EQ(whole_area, scaleSampleArea(whole_area, 1));
+
+    // Areas smaller than the downscale factor still cover a whole pixel.
+    EXPECT_EQ(Rect(1, 0, 2, 1), scaleSampleArea(Rect{5, 1, 6, 2}, 4));
+    EXPECT_EQ(Rect(-1, -1, 0, 0), scaleSampleArea(Rect{-3, -3, -1, -1}, 4));
+
+    // Invalid areas are left for sampleArea to reject.
+    Rect const invalid_region{3, 0, 2, 0};
+    EXPECT_EQ(invalid_region, scaleSampleArea(invalid_region, 4));
+}
+
+TEST_F(RegionSamplingTest, calculate_mean_downscaled) {
+    std::generate(buffer.begin(), buffer.end(),
+                  [n = 0]() mutable { return (n++ % kStride < kWidth / 2) ? kWhite : kBlack; });
+    EXPECT_THAT(sampleArea(buffer.data(), kWidth, kHeight, kStride, kOrientation,
+                           scaleSampleArea(Rect{0, 0, kWidth * 2, kHeight * 2}, 2)),
+                testing::FloatEq(0.5f));
+}
+
 } // namespace android
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Scheduler/RingBuffer.h"
+
+using testing::ElementsAre;
+
+namespace android::scheduler {
+
+TEST(RingBufferTest, pushesUntilFull) {
+    RingBuffer<int, 3> buffer;
+    EXPECT_TRUE(buffer.empty());
+
+    buffer.push_back(1);
+    buffer.push_back(2);
+    EXPECT_EQ(2u, buffer.size());
+    EXPECT_FALSE(buffer.full());
+    EXPECT_EQ(1, buffer.front());
+    EXPECT_EQ(2, buffer.back());
+
+    buffer.push_back(3);
+    EXPECT_TRUE(buffer.full());
+    EXPECT_THAT(std::vector<int>(buffer.begin(), buffer.end()), ElementsAre(1, 2, 3));
+}
+
+TEST(RingBufferTest, replacesOldestWhenFull) {
+    RingBuffer<int, 3> buffer;
+    for (int i = 1; i <= 5; i++) {
+        buffer.push_back(i);
+    }
+
+    EXPECT_EQ(3u, buffer.size());
+    EXPECT_EQ(3, buffer.front());
+    EXPECT_EQ(5, buffer.back());
+    EXPECT_THAT(std::vector<int>(buffer.begin(), buffer.end()), ElementsAre(3, 4, 5));
+    EXPECT_EQ(5, *std::max_element(buffer.begin(), buffer.end()));
+}
+
+TEST(RingBufferTest, popsAndClears) {
+    RingBuffer<int, 3> buffer;
+    for (int i = 1; i <= 4; i++) {
+        buffer.push_back(i);
+    }
+
+    buffer.pop_front();
+    EXPECT_THAT(std::vector<int>(buffer.begin(), buffer.end()), ElementsAre(3, 4));
+
+    buffer.push_back(5);
+    buffer.push_back(6);
+    EXPECT_THAT(std::vector<int>(buffer.begin(), buffer.end()), ElementsAre(4, 5, 6));
+
+    buffer.clear();
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(buffer.begin(), buffer.end());
+}
+
+} // namespace android::scheduler
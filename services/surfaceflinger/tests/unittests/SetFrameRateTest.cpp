@@ -520,5 +520,68 @@ TEST_P(SetFrameRateTest, addChildForParentWithTreeVote) {
     EXPECT_EQ(FRAME_RATE_NO_VOTE, child2->getFrameRateForLayerTree());
 }
 
+TEST_P(SetFrameRateTest, SetAndGetDeepHierarchy) {
+    EXPECT_CALL(*mMessageQueue, invalidate()).Times(1);
+
+    const auto& layerFactory = GetParam();
+
+    // Deep trees such as app -> ViewRootImpl -> SurfaceView, where votes are only propagated
+    // through the layers that they affect.
+    constexpr size_t kDepth = 8;
+    std::vector<sp<Layer>> layers;
+    for (size_t i = 0; i < kDepth; i++) {
+        layers.push_back(mLayers.emplace_back(layerFactory->createLayer(mFlinger)));
+        if (i > 0) {
+            addChild(layers[i - 1], layers[i]);
+        }
+    }
+    const auto& leaf = layers.back();
+    const auto& middle = layers[kDepth / 2];
+    const auto& middleChild = layers[kDepth / 2 + 1];
+
+    leaf->setFrameRate(FRAME_RATE_VOTE1);
+    commitTransaction();
+    for (size_t i = 0; i < kDepth - 1; i++) {
+        EXPECT_EQ(FRAME_RATE_TREE, layers[i]->getFrameRateForLayerTree()) << i;
+    }
+    EXPECT_EQ(FRAME_RATE_VOTE1, leaf->getFrameRateForLayerTree());
+
+    middle->setFrameRate(FRAME_RATE_VOTE2);
+    commitTransaction();
+    for (size_t i = 0; i < kDepth / 2; i++) {
+        EXPECT_EQ(FRAME_RATE_TREE, layers[i]->getFrameRateForLayerTree()) << i;
+    }
+    for (size_t i = kDepth / 2; i < kDepth - 1; i++) {
+        EXPECT_EQ(FRAME_RATE_VOTE2, layers[i]->getFrameRateForLayerTree()) << i;
+    }
+    EXPECT_EQ(FRAME_RATE_VOTE1, leaf->getFrameRateForLayerTree());
+
+    leaf->setFrameRate(FRAME_RATE_NO_VOTE);
+    commitTransaction();
+    for (size_t i = 0; i < kDepth / 2; i++) {
+        EXPECT_EQ(FRAME_RATE_NO_VOTE, layers[i]->getFrameRateForLayerTree()) << i;
+    }
+    for (size_t i = kDepth / 2; i < kDepth; i++) {
+        EXPECT_EQ(FRAME_RATE_VOTE2, layers[i]->getFrameRateForLayerTree()) << i;
+    }
+
+    removeChild(middle, middleChild);
+    commitTransaction();
+    for (size_t i = kDepth / 2 + 1; i < kDepth; i++) {
+        EXPECT_EQ(FRAME_RATE_NO_VOTE, layers[i]->getFrameRateForLayerTree()) << i;
+    }
+
+    leaf->setFrameRate(FRAME_RATE_VOTE1);
+    addChild(middle, middleChild);
+    commitTransaction();
+    for (size_t i = 0; i < kDepth / 2; i++) {
+        EXPECT_EQ(FRAME_RATE_TREE, layers[i]->getFrameRateForLayerTree()) << i;
+    }
+    for (size_t i = kDepth / 2; i < kDepth - 1; i++) {
+        EXPECT_EQ(FRAME_RATE_VOTE2, layers[i]->getFrameRateForLayerTree()) << i;
+    }
+    EXPECT_EQ(FRAME_RATE_VOTE1, leaf->getFrameRateForLayerTree());
+}
+
 } // namespace
 } // namespace android
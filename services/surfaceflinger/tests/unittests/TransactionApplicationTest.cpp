@@ -18,14 +18,20 @@
 #undef LOG_TAG
 #define LOG_TAG "CompositionTest"
 
+#include <android-base/unique_fd.h>
 #include <compositionengine/Display.h>
 #include <compositionengine/mock/DisplaySurface.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <gui/SurfaceComposerClient.h>
 #include <log/log.h>
+#include <ui/Fence.h>
+#include <unistd.h>
 #include <utils/String8.h>
 
+#include <chrono>
+#include <thread>
+
 #include "TestableScheduler.h"
 #include "TestableSurfaceFlinger.h"
 #include "mock/MockEventThread.h"
@@ -34,6 +40,7 @@
 
 namespace android {
 
+using namespace std::chrono_literals;
 using testing::_;
 using testing::Return;
 
@@ -289,6 +296,47 @@ TEST_F(TransactionApplicationTest, Flush_RemovesFromQueue) {
     EXPECT_EQ(0u, transactionQueue.size());
 }
 
+TEST_F(TransactionApplicationTest, Flush_WaitsForUnsignaledFence) {
+    ASSERT_EQ(0u, mFlinger.getTransactionQueue().size());
+    // called in SurfaceFlinger::signalTransaction
+    EXPECT_CALL(*mMessageQueue, invalidate()).Times(testing::AnyNumber());
+
+    // The read end of a pipe polls like a sync fence, and signals once the pipe is written to.
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    base::unique_fd writeFd(fds[1]);
+    sp<Fence> fence = new Fence(fds[0]);
+
+    TransactionInfo transaction;
+    setupSingle(transaction, /*flags*/ 0, /*syncInputWindows*/ false,
+                /*desiredPresentTime*/ systemTime(), /*isAutoTimestamp*/ true,
+                FrameTimelineInfo{});
+    ComposerState state;
+    state.state.what = layer_state_t::eAcquireFenceChanged;
+    state.state.acquireFence = fence;
+    transaction.states.add(state);
+    mFlinger.setTransactionState(transaction.frameTimelineInfo, transaction.states,
+                                 transaction.displays, transaction.flags, transaction.applyToken,
+                                 transaction.inputWindowCommands, transaction.desiredPresentTime,
+                                 transaction.isAutoTimestamp, transaction.uncacheBuffer,
+                                 mHasListenerCallbacks, mCallbacks, transaction.id);
+
+    // The transaction waits on its fence, without needing another flush until it signals.
+    mFlinger.flushTransactionQueues();
+    EXPECT_EQ(1u, mFlinger.getPendingTransactionQueue().size());
+    EXPECT_FALSE(mFlinger.transactionFlushNeeded());
+
+    ASSERT_EQ(1, write(writeFd.get(), "", 1));
+    const nsecs_t deadline = systemTime() + s2ns(1);
+    while (!mFlinger.transactionFlushNeeded() && systemTime() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_TRUE(mFlinger.transactionFlushNeeded());
+
+    mFlinger.flushTransactionQueues();
+    EXPECT_EQ(0u, mFlinger.getPendingTransactionQueue().size());
+}
+
 TEST_F(TransactionApplicationTest, NotPlacedOnTransactionQueue_Synchronous) {
     NotPlacedOnTransactionQueue(ISurfaceComposer::eSynchronous, /*syncInputWindows*/ false);
 }
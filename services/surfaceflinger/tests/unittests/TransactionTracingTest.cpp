@@ -0,0 +1,154 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
+#include <gtest/gtest.h>
+#include <gui/ISurfaceComposer.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "TransactionTracing.h"
+
+namespace android {
+namespace {
+
+using surfaceflinger::Increment;
+using surfaceflinger::SurfaceChange;
+using surfaceflinger::Trace;
+
+Vector<ComposerState> makeStates(int32_t layerId, float x) {
+    ComposerState composerState;
+    layer_state_t& state = composerState.state;
+    state.layerId = layerId;
+    state.what = layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged |
+            layer_state_t::eFlagsChanged;
+    state.x = x;
+    state.y = -x;
+    state.alpha = 0.5f;
+    state.flags = layer_state_t::eLayerHidden;
+    state.mask = layer_state_t::eLayerHidden | layer_state_t::eLayerOpaque;
+
+    Vector<ComposerState> states;
+    states.add(composerState);
+    return states;
+}
+
+TEST(TransactionTracingTest, recordsLayerChanges) {
+    TransactionTracing tracing;
+    tracing.addTransaction(makeStates(7, 12.f), ISurfaceComposer::eSynchronous, 100, 1000, 42);
+
+    Trace trace;
+    tracing.writeToProto(&trace);
+    ASSERT_EQ(1, trace.increment_size());
+
+    const Increment& increment = trace.increment(0);
+    ASSERT_TRUE(increment.has_transaction());
+    const auto& transaction = increment.transaction();
+    EXPECT_EQ(42u, transaction.id());
+    EXPECT_TRUE(transaction.synchronous());
+    EXPECT_FALSE(transaction.animation());
+    EXPECT_EQ(100, transaction.origin().pid());
+    EXPECT_EQ(1000, transaction.origin().uid());
+
+    // One change per field, and one per flag in the mask, as SurfaceInterceptor records them.
+    ASSERT_EQ(4, transaction.surface_change_size());
+    for (const SurfaceChange& change : transaction.surface_change()) {
+        EXPECT_EQ(7, change.id());
+    }
+    EXPECT_EQ(12.f, transaction.surface_change(0).position().x());
+    EXPECT_EQ(-12.f, transaction.surface_change(0).position().y());
+    EXPECT_EQ(0.5f, transaction.surface_change(1).alpha().alpha());
+    EXPECT_TRUE(transaction.surface_change(2).hidden_flag().hidden_flag());
+    EXPECT_FALSE(transaction.surface_change(3).opaque_flag().opaque_flag());
+}
+
+TEST(TransactionTracingTest, skipsUntracedChanges) {
+    TransactionTracing tracing;
+    Vector<ComposerState> states = makeStates(7, 0.f);
+    states.editItemAt(0).state.what = layer_state_t::eBufferChanged;
+    tracing.addTransaction(states, 0, 100, 1000, 1);
+
+    Trace trace;
+    tracing.writeToProto(&trace);
+    ASSERT_EQ(1, trace.increment_size());
+    EXPECT_EQ(0, trace.increment(0).transaction().surface_change_size());
+}
+
+TEST(TransactionTracingTest, keepsMostRecentTransactions) {
+    TransactionTracing tracing(4096);
+    for (uint64_t id = 0; id < 1000; id++) {
+        tracing.addTransaction(makeStates(1, static_cast<float>(id)), 0, 100, 1000, id);
+    }
+
+    Trace trace;
+    tracing.writeToProto(&trace);
+    ASSERT_GT(trace.increment_size(), 0);
+    ASSERT_LT(trace.increment_size(), 1000);
+
+    // The oldest transactions were overwritten, and the rest are in order.
+    const int count = trace.increment_size();
+    EXPECT_EQ(999u, trace.increment(count - 1).transaction().id());
+    for (int i = 1; i < count; i++) {
+        EXPECT_EQ(trace.increment(i - 1).transaction().id() + 1,
+                  trace.increment(i).transaction().id());
+    }
+}
+
+TEST(TransactionTracingTest, readsConsistentTransactionsWhileWriting) {
+    TransactionTracing tracing(8192);
+    constexpr int kWriterCount = 4;
+    constexpr uint64_t kTransactionCount = 5000;
+
+    std::atomic<bool> done = false;
+    std::thread reader([&] {
+        while (!done) {
+            Trace trace;
+            tracing.writeToProto(&trace);
+            for (const Increment& increment : trace.increment()) {
+                // Each writer encodes its id in the layer and position of its transactions.
+                const auto& transaction = increment.transaction();
+                ASSERT_EQ(4, transaction.surface_change_size());
+                const SurfaceChange& change = transaction.surface_change(0);
+                EXPECT_EQ(transaction.origin().pid(), change.id());
+                EXPECT_EQ(static_cast<float>(transaction.id()), change.position().x());
+            }
+        }
+    });
+
+    std::vector<std::thread> writers;
+    for (int writer = 0; writer < kWriterCount; writer++) {
+        writers.emplace_back([&tracing, writer] {
+            for (uint64_t id = 0; id < kTransactionCount; id++) {
+                tracing.addTransaction(makeStates(writer, static_cast<float>(id)), 0, writer,
+                                       1000, id);
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    done = true;
+    reader.join();
+
+    Trace trace;
+    tracing.writeToProto(&trace);
+    EXPECT_GT(trace.increment_size(), 0);
+}
+
+} // namespace
+} // namespace android
@@ -475,6 +475,35 @@ TEST_F(VSyncDispatchTimerQueueTest, modifyIntoGroup) {
     EXPECT_THAT(cb0.mCalls[1], Eq(2000));
 }
 
+TEST_F(VSyncDispatchTimerQueueTest, coalescesCallbacksWithOverlappingWork) {
+    nsecs_t constexpr kCoalescingWindow = 200;
+    VSyncDispatchTimerQueue dispatch{createTimeKeeper(), mStubTracker, mDispatchGroupThreshold,
+                                     mVsyncMoveThreshold, kCoalescingWindow};
+
+    Sequence seq;
+    EXPECT_CALL(mMockClock, alarmAt(_, 600)).InSequence(seq);
+    EXPECT_CALL(mMockClock, alarmAt(_, 850)).InSequence(seq);
+
+    CountingCallback cb0(dispatch);
+    CountingCallback cb1(dispatch);
+    CountingCallback cb2(dispatch);
+
+    dispatch.schedule(cb0, {.workDuration = 400, .readyDuration = 0, .earliestVsync = 1000});
+    dispatch.schedule(cb1, {.workDuration = 350, .readyDuration = 0, .earliestVsync = 1000});
+    dispatch.schedule(cb2, {.workDuration = 150, .readyDuration = 0, .earliestVsync = 1000});
+
+    advanceToNextCallback();
+    ASSERT_THAT(cb0.mCalls.size(), Eq(1));
+    ASSERT_THAT(cb1.mCalls.size(), Eq(1));
+    EXPECT_THAT(cb1.mCalls[0], Eq(mPeriod));
+    EXPECT_THAT(cb1.mWakeupTime[0], Eq(650));
+    EXPECT_THAT(cb2.mCalls.size(), Eq(0));
+
+    advanceToNextCallback();
+    ASSERT_THAT(cb2.mCalls.size(), Eq(1));
+    EXPECT_THAT(cb2.mCalls[0], Eq(mPeriod));
+}
+
 TEST_F(VSyncDispatchTimerQueueTest, rearmsWhenEndingAndDoesntCancel) {
     Sequence seq;
     EXPECT_CALL(mMockClock, alarmAt(_, 900)).InSequence(seq);
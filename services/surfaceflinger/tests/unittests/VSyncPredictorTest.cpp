@@ -97,6 +97,57 @@ TEST_F(VSyncPredictorTest, reportsSamplesNeededAfterExplicitRateChange) {
     EXPECT_FALSE(tracker.needsMoreSamples());
 }
 
+TEST_F(VSyncPredictorTest, relocksQuicklyToCalibratedPeriod) {
+    auto const realPeriod = 1010;
+    for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
+        tracker.addVsyncTimestamp(mNow += realPeriod);
+    }
+    EXPECT_FALSE(tracker.needsMoreSamples());
+
+    auto const changedPeriod = mPeriod * 2;
+    tracker.setPeriod(changedPeriod);
+    for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
+        tracker.addVsyncTimestamp(mNow += changedPeriod);
+    }
+
+    // Switching back only needs the phase to be found again.
+    tracker.setPeriod(mPeriod);
+    auto const phaseShift = 300;
+    mNow += phaseShift;
+    tracker.addVsyncTimestamp(mNow += realPeriod);
+    EXPECT_TRUE(tracker.needsMoreSamples());
+    tracker.addVsyncTimestamp(mNow += realPeriod);
+    EXPECT_TRUE(tracker.needsMoreSamples());
+    tracker.addVsyncTimestamp(mNow += realPeriod);
+    EXPECT_FALSE(tracker.needsMoreSamples());
+
+    EXPECT_THAT(tracker.getVSyncPredictionModel().slope, Eq(realPeriod));
+    EXPECT_THAT(tracker.nextAnticipatedVSyncTimeFrom(mNow + 100),
+                IsCloseTo(mNow + realPeriod, mMaxRoundingError));
+}
+
+TEST_F(VSyncPredictorTest, doesNotRelockWhenCalibratedPeriodChanged) {
+    for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
+        tracker.addVsyncTimestamp(mNow += mPeriod);
+    }
+
+    auto const changedPeriod = mPeriod * 2;
+    tracker.setPeriod(changedPeriod);
+    for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
+        tracker.addVsyncTimestamp(mNow += changedPeriod);
+    }
+
+    tracker.setPeriod(mPeriod);
+    auto const driftedPeriod = mPeriod + 50;
+    for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
+        EXPECT_TRUE(tracker.needsMoreSamples());
+        tracker.addVsyncTimestamp(mNow += driftedPeriod);
+    }
+    EXPECT_FALSE(tracker.needsMoreSamples());
+    EXPECT_THAT(tracker.getVSyncPredictionModel().slope,
+                IsCloseTo(driftedPeriod, mMaxRoundingError));
+}
+
 TEST_F(VSyncPredictorTest, transitionsToModelledPointsAfterSynthetic) {
     auto last = mNow;
     auto const bias = 10;
@@ -212,4 +212,66 @@ TEST_F(VsyncModulatorTest, EarlyStartWithBinderDeath) {
     CHECK_COMMIT(std::nullopt, kLate);
 }
 
+TEST_F(VsyncModulatorTest, ShortensLateSfWorkDurationToFrameDuration) {
+    using namespace std::chrono_literals;
+    constexpr auto kFrames = VsyncModulator::DYNAMIC_SF_WORK_DURATION_FRAMES;
+
+    const VsyncModulator::VsyncConfig late{SF_OFFSET_LATE, APP_OFFSET_LATE, 16ms, 16ms};
+    const VsyncModulator::VsyncConfigSet offsets = {kEarly, kEarlyGpu, late,
+                                                    nanos(HWC_MIN_WORK_DURATION)};
+    EXPECT_EQ(late, mVsyncModulator->setVsyncConfigSet(offsets));
+
+    for (size_t i = 0; i < kFrames - 1; i++) {
+        EXPECT_EQ(std::nullopt, mVsyncModulator->onFrameDuration(4ms));
+    }
+
+    auto dynamicLate = late;
+    dynamicLate.sfWorkDuration = 4ms + VsyncModulator::DYNAMIC_SF_WORK_DURATION_MARGIN;
+    EXPECT_EQ(dynamicLate, mVsyncModulator->onFrameDuration(4ms));
+    EXPECT_EQ(dynamicLate, mVsyncModulator->getVsyncConfig());
+
+    // Slightly shorter frames don't reschedule.
+    for (size_t i = 0; i < kFrames; i++) {
+        EXPECT_EQ(std::nullopt, mVsyncModulator->onFrameDuration(3900us));
+    }
+
+    // A longer frame takes effect immediately.
+    dynamicLate.sfWorkDuration = 5ms + VsyncModulator::DYNAMIC_SF_WORK_DURATION_MARGIN;
+    EXPECT_EQ(dynamicLate, mVsyncModulator->onFrameDuration(5ms));
+
+    // Early offsets still take precedence.
+    const auto token = sp<BBinder>::make();
+    EXPECT_EQ(kEarly, mVsyncModulator->setTransactionSchedule(Schedule::EarlyEnd, token));
+    CHECK_COMMIT(kEarly, kEarly);
+    CHECK_REFRESH(MIN_EARLY_TRANSACTION_FRAMES - 1, kEarly, kEarly);
+    CHECK_REFRESH(1, dynamicLate, dynamicLate);
+}
+
+TEST_F(VsyncModulatorTest, BacksOffAfterMissedFrame) {
+    using namespace std::chrono_literals;
+    constexpr auto kFrames = VsyncModulator::DYNAMIC_SF_WORK_DURATION_FRAMES;
+
+    const VsyncModulator::VsyncConfig late{SF_OFFSET_LATE, APP_OFFSET_LATE, 16ms, 16ms};
+    const VsyncModulator::VsyncConfigSet offsets = {kEarly, kEarlyGpu, late,
+                                                    nanos(HWC_MIN_WORK_DURATION)};
+    EXPECT_EQ(late, mVsyncModulator->setVsyncConfigSet(offsets));
+
+    for (size_t i = 0; i < kFrames - 1; i++) {
+        EXPECT_EQ(std::nullopt, mVsyncModulator->onFrameDuration(4ms));
+    }
+    EXPECT_NE(std::nullopt, mVsyncModulator->onFrameDuration(4ms));
+
+    EXPECT_EQ(late, mVsyncModulator->onFrameMissed());
+    EXPECT_EQ(late, mVsyncModulator->getVsyncConfig());
+
+    // Frames are ignored while backing off, and the history starts over after.
+    for (int i = 0; i < VsyncModulator::MISSED_FRAME_BACKOFF_FRAMES; i++) {
+        EXPECT_EQ(std::nullopt, mVsyncModulator->onFrameDuration(4ms));
+    }
+    for (size_t i = 0; i < kFrames - 1; i++) {
+        EXPECT_EQ(std::nullopt, mVsyncModulator->onFrameDuration(4ms));
+    }
+    EXPECT_NE(std::nullopt, mVsyncModulator->onFrameDuration(4ms));
+}
+
 } // namespace android::scheduler
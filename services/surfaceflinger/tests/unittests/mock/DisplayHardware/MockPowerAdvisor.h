@@ -33,6 +33,9 @@ public:
     MOCK_METHOD0(isUsingExpensiveRendering, bool());
     MOCK_METHOD0(notifyDisplayUpdateImminent, void());
     MOCK_METHOD0(canNotifyDisplayUpdateImminent, bool());
+    MOCK_METHOD1(setPowerHintSessionThreadIds, void(const std::vector<int32_t>& threadIds));
+    MOCK_METHOD3(reportWorkDuration,
+                 void(nsecs_t targetDuration, nsecs_t actualDuration, nsecs_t timestamp));
 };
 
 } // namespace android::Hwc2::mock
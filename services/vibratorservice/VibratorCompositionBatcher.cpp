@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "VibratorCompositionBatcher"
+
+#include <android/hardware/vibrator/IVibrator.h>
+#include <utils/Log.h>
+
+#include <vibratorservice/VibratorCompositionBatcher.h>
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+
+using android::hardware::vibrator::CompositeEffect;
+
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace android {
+
+namespace vibrator {
+
+// -------------------------------------------------------------------------------------------------
+
+bool CompositionBatcher::prewarm() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return loadLimitsLocked();
+}
+
+bool CompositionBatcher::enqueue(const CompositeEffect& primitive,
+                                 const std::function<void()>& completionCallback) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!loadLimitsLocked()) {
+            ALOGV("Skipped enqueue because Vibrator HAL doesn't support composed effects");
+            return false;
+        }
+        mPendingPrimitives.push_back(primitive);
+        mPendingCallbacks.push_back(completionCallback);
+    }
+    performPending();
+    return true;
+}
+
+bool CompositionBatcher::loadLimitsLocked() {
+    if (mLimitsLoaded) {
+        return mSupportsComposition;
+    }
+
+    Info info = mController->getInfo();
+    if (info.capabilities.isFailed()) {
+        // Try loading again on the next call.
+        return false;
+    }
+
+    mSupportsComposition = info.capabilities.isOk() &&
+            static_cast<int32_t>(info.capabilities.value() & Capabilities::COMPOSE_EFFECTS);
+    mPrimitiveDurations = info.primitiveDurations.valueOr({});
+    int32_t compositionSizeMax = info.compositionSizeMax.valueOr(0);
+    mCompositionSizeMax = compositionSizeMax > 0 ? static_cast<size_t>(compositionSizeMax) : 0;
+    mLimitsLoaded = true;
+    return mSupportsComposition;
+}
+
+milliseconds CompositionBatcher::getDurationLocked(const std::vector<CompositeEffect>& primitives) {
+    // Same estimate as the one returned by performComposedEffect.
+    milliseconds duration(0);
+    for (const auto& effect : primitives) {
+        auto primitiveIdx = static_cast<size_t>(effect.primitive);
+        if (primitiveIdx < mPrimitiveDurations.size()) {
+            duration += mPrimitiveDurations[primitiveIdx];
+        } else {
+            duration += milliseconds(1);
+        }
+        duration += milliseconds(effect.delayMs);
+    }
+    return duration;
+}
+
+void CompositionBatcher::performPending() {
+    std::vector<CompositeEffect> primitives;
+    std::vector<std::function<void()>> callbacks;
+    std::optional<milliseconds> flushDelay;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mFlushScheduled || mPendingPrimitives.empty()) {
+            return;
+        }
+
+        const steady_clock::time_point now = steady_clock::now();
+        if (now < mBusyUntil) {
+            // Starting a composition now would cut the one playing, so wait for it to end.
+            mFlushScheduled = true;
+            flushDelay = std::chrono::ceil<milliseconds>(mBusyUntil - now);
+        } else {
+            size_t count = mPendingPrimitives.size();
+            if (mCompositionSizeMax > 0) {
+                count = std::min(count, mCompositionSizeMax);
+            }
+            primitives.assign(std::make_move_iterator(mPendingPrimitives.begin()),
+                              std::make_move_iterator(mPendingPrimitives.begin() + count));
+            mPendingPrimitives.erase(mPendingPrimitives.begin(), mPendingPrimitives.begin() + count);
+            callbacks.assign(std::make_move_iterator(mPendingCallbacks.begin()),
+                             std::make_move_iterator(mPendingCallbacks.begin() + count));
+            mPendingCallbacks.erase(mPendingCallbacks.begin(), mPendingCallbacks.begin() + count);
+
+            const milliseconds duration = getDurationLocked(primitives);
+            mBusyUntil = now + duration;
+            if (!mPendingPrimitives.empty()) {
+                mFlushScheduled = true;
+                flushDelay = duration;
+            }
+        }
+    }
+
+    if (!primitives.empty()) {
+        ALOGV("Performing %zu primitives in one composition", primitives.size());
+        auto completionCallback = [callbacks = std::move(callbacks)]() {
+            for (const auto& callback : callbacks) {
+                callback();
+            }
+        };
+        auto performFn = [&](HalWrapper* hal) {
+            return hal->performComposedEffect(primitives, completionCallback);
+        };
+        auto result = mController->doWithRetry<milliseconds>(performFn, "performComposedEffect");
+        if (!result.isOk()) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mBusyUntil = steady_clock::now();
+        }
+    }
+
+    if (flushDelay) {
+        scheduleFlush(*flushDelay);
+    }
+}
+
+void CompositionBatcher::scheduleFlush(milliseconds delay) {
+    std::weak_ptr<CompositionBatcher> weakThis = weak_from_this();
+    mCallbackScheduler->schedule(
+            [weakThis]() {
+                if (auto batcher = weakThis.lock()) {
+                    {
+                        std::lock_guard<std::mutex> lock(batcher->mMutex);
+                        batcher->mFlushScheduled = false;
+                    }
+                    batcher->performPending();
+                }
+            },
+            delay);
+}
+
+// -------------------------------------------------------------------------------------------------
+
+}; // namespace vibrator
+
+}; // namespace android
@@ -17,8 +17,12 @@
 #define LOG_TAG "PowerHalControllerBenchmarks"
 
 #include <benchmark/benchmark.h>
+#include <vibratorservice/VibratorCompositionBatcher.h>
 #include <vibratorservice/VibratorHalController.h>
 
+#include <atomic>
+#include <thread>
+
 using ::android::enum_range;
 using ::android::hardware::vibrator::CompositeEffect;
 using ::android::hardware::vibrator::CompositePrimitive;
@@ -468,4 +472,48 @@ BENCHMARK_WRAPPER(VibratorPrimitivesBench, performComposedEffect, {
     }
 });
 
+BENCHMARK_WRAPPER(VibratorPrimitivesBench, enqueueBurst, {
+    if (!hasCapabilities(vibrator::Capabilities::COMPOSE_EFFECTS, state)) {
+        return;
+    }
+    if (!hasArgs(state)) {
+        return;
+    }
+
+    // A burst of primitives, as produced by fast typing or scrolling.
+    static constexpr int32_t BURST_SIZE = 8;
+
+    CompositeEffect effect;
+    effect.primitive = getPrimitive(state);
+    effect.scale = 1.0f;
+    effect.delayMs = static_cast<int32_t>(0);
+
+    auto callbackScheduler = std::make_shared<vibrator::CallbackScheduler>();
+    auto controller = std::make_shared<vibrator::HalController>();
+    auto batcher = std::make_shared<vibrator::CompositionBatcher>(controller, callbackScheduler);
+    if (!batcher->prewarm()) {
+        state.SkipWithError("Failed to load composition limits");
+        return;
+    }
+
+    std::atomic<int32_t> completed = 0;
+    auto callback = [&completed]() { completed++; };
+
+    for (auto _ : state) {
+        state.ResumeTiming();
+        for (int32_t i = 0; i < BURST_SIZE; i++) {
+            batcher->enqueue(effect, callback);
+        }
+        state.PauseTiming();
+
+        // Wait for the held primitives to be composed, so that bursts don't overlap.
+        auto deadline = std::chrono::steady_clock::now() + 1s;
+        while (completed < BURST_SIZE && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(1ms);
+        }
+        completed = 0;
+        turnVibratorOff(state);
+    }
+});
+
 BENCHMARK_MAIN();
\ No newline at end of file
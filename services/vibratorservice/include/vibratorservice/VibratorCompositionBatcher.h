@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_OS_VIBRATOR_COMPOSITION_BATCHER_H
+#define ANDROID_OS_VIBRATOR_COMPOSITION_BATCHER_H
+
+#include <android-base/thread_annotations.h>
+#include <android/hardware/vibrator/IVibrator.h>
+
+#include <vibratorservice/VibratorCallbackScheduler.h>
+#include <vibratorservice/VibratorHalController.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace android {
+
+namespace vibrator {
+
+// Composes bursts of short primitives, e.g. keyboard or scroll feedback, into as few HAL calls as
+// possible. A primitive queued while the vibrator is idle is performed right away, so that touch
+// feedback isn't delayed. Primitives queued while a composition plays are held until it ends, and
+// then performed together with a single compose() call, within the composition size limit.
+//
+// Must be owned by a std::shared_ptr, as compositions are performed from the callback scheduler.
+class CompositionBatcher : public std::enable_shared_from_this<CompositionBatcher> {
+public:
+    CompositionBatcher(std::shared_ptr<HalController> controller,
+                       std::shared_ptr<CallbackScheduler> callbackScheduler)
+          : mController(std::move(controller)), mCallbackScheduler(std::move(callbackScheduler)) {}
+    virtual ~CompositionBatcher() = default;
+
+    /* Connects to the HAL and loads its composition limits and primitive durations, so that the
+     * first primitive queued later on doesn't wait for them. Returns true if the HAL supports
+     * composed effects, false otherwise.
+     */
+    bool prewarm();
+
+    /* Queues a primitive, whose completion callback is called once the composition it was
+     * performed in completes. Returns false, and never calls the callback, if the HAL doesn't
+     * support composed effects. Callbacks of primitives the HAL fails to perform are not called.
+     */
+    bool enqueue(const hardware::vibrator::CompositeEffect& primitive,
+                 const std::function<void()>& completionCallback);
+
+private:
+    const std::shared_ptr<HalController> mController;
+    const std::shared_ptr<CallbackScheduler> mCallbackScheduler;
+
+    std::mutex mMutex;
+    bool mLimitsLoaded GUARDED_BY(mMutex) = false;
+    bool mSupportsComposition GUARDED_BY(mMutex) = false;
+    std::vector<std::chrono::milliseconds> mPrimitiveDurations GUARDED_BY(mMutex);
+    size_t mCompositionSizeMax GUARDED_BY(mMutex) = 0;
+
+    std::vector<hardware::vibrator::CompositeEffect> mPendingPrimitives GUARDED_BY(mMutex);
+    std::vector<std::function<void()>> mPendingCallbacks GUARDED_BY(mMutex);
+    // Expected end of the composition last performed.
+    std::chrono::steady_clock::time_point mBusyUntil GUARDED_BY(mMutex);
+    bool mFlushScheduled GUARDED_BY(mMutex) = false;
+
+    bool loadLimitsLocked() REQUIRES(mMutex);
+    std::chrono::milliseconds getDurationLocked(
+            const std::vector<hardware::vibrator::CompositeEffect>& primitives) REQUIRES(mMutex);
+    void performPending();
+    void scheduleFlush(std::chrono::milliseconds delay);
+};
+
+}; // namespace vibrator
+
+}; // namespace android
+
+#endif // ANDROID_OS_VIBRATOR_COMPOSITION_BATCHER_H
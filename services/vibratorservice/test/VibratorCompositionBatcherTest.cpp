@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "VibratorCompositionBatcherTest"
+
+#include <android/hardware/vibrator/IVibrator.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <utils/Log.h>
+#include <thread>
+
+#include <vibratorservice/VibratorCallbackScheduler.h>
+#include <vibratorservice/VibratorCompositionBatcher.h>
+#include <vibratorservice/VibratorHalController.h>
+#include <vibratorservice/VibratorHalWrapper.h>
+
+#include "test_utils.h"
+
+using android::hardware::vibrator::CompositeEffect;
+using android::hardware::vibrator::CompositePrimitive;
+using android::hardware::vibrator::Effect;
+using android::hardware::vibrator::EffectStrength;
+
+using std::chrono::milliseconds;
+
+using namespace android;
+using namespace std::chrono_literals;
+using namespace testing;
+
+static const milliseconds PRIMITIVE_DURATION = 20ms;
+
+// -------------------------------------------------------------------------------------------------
+
+class MockHalWrapper : public vibrator::HalWrapper {
+public:
+    MockHalWrapper(std::shared_ptr<vibrator::CallbackScheduler> scheduler)
+          : HalWrapper(scheduler) {}
+    virtual ~MockHalWrapper() = default;
+
+    MOCK_METHOD(vibrator::HalResult<void>, ping, (), (override));
+    MOCK_METHOD(void, tryReconnect, (), (override));
+    MOCK_METHOD(vibrator::HalResult<void>, on,
+                (milliseconds timeout, const std::function<void()>& completionCallback),
+                (override));
+    MOCK_METHOD(vibrator::HalResult<void>, off, (), (override));
+    MOCK_METHOD(vibrator::HalResult<void>, setAmplitude, (float amplitude), (override));
+    MOCK_METHOD(vibrator::HalResult<void>, setExternalControl, (bool enabled), (override));
+    MOCK_METHOD(vibrator::HalResult<void>, alwaysOnEnable,
+                (int32_t id, Effect effect, EffectStrength strength), (override));
+    MOCK_METHOD(vibrator::HalResult<void>, alwaysOnDisable, (int32_t id), (override));
+    MOCK_METHOD(vibrator::HalResult<milliseconds>, performEffect,
+                (Effect effect, EffectStrength strength,
+                 const std::function<void()>& completionCallback),
+                (override));
+    MOCK_METHOD(vibrator::HalResult<milliseconds>, performComposedEffect,
+                (const std::vector<CompositeEffect>& primitives,
+                 const std::function<void()>& completionCallback),
+                (override));
+    MOCK_METHOD(vibrator::HalResult<vibrator::Capabilities>, getCapabilitiesInternal, (),
+                (override));
+
+    vibrator::HalResult<std::vector<CompositePrimitive>> getSupportedPrimitivesInternal()
+            override {
+        return vibrator::HalResult<std::vector<CompositePrimitive>>::ok(
+                {CompositePrimitive::NOOP, CompositePrimitive::CLICK});
+    }
+
+    vibrator::HalResult<std::vector<milliseconds>> getPrimitiveDurationsInternal(
+            const std::vector<CompositePrimitive>&) override {
+        return vibrator::HalResult<std::vector<milliseconds>>::ok({0ms, PRIMITIVE_DURATION});
+    }
+
+    vibrator::HalResult<int32_t> getCompositionSizeMaxInternal() override {
+        return vibrator::HalResult<int32_t>::ok(mCompositionSizeMax);
+    }
+
+    int32_t mCompositionSizeMax = 10;
+};
+
+// -------------------------------------------------------------------------------------------------
+
+class VibratorCompositionBatcherTest : public Test {
+public:
+    void SetUp() override {
+        mMockScheduler = std::make_shared<StrictMock<vibrator::MockCallbackScheduler>>();
+        mMockHal = std::make_shared<StrictMock<MockHalWrapper>>(mMockScheduler);
+        auto controller = std::make_shared<
+                vibrator::HalController>(mMockScheduler,
+                                         [&](std::shared_ptr<vibrator::CallbackScheduler>) {
+                                             return this->mMockHal;
+                                         });
+        mBatcher = std::make_shared<vibrator::CompositionBatcher>(std::move(controller),
+                                                                  mMockScheduler);
+    }
+
+protected:
+    std::shared_ptr<StrictMock<vibrator::MockCallbackScheduler>> mMockScheduler;
+    std::shared_ptr<StrictMock<MockHalWrapper>> mMockHal;
+    std::shared_ptr<vibrator::CompositionBatcher> mBatcher;
+
+    void expectCompositionSupported() {
+        EXPECT_CALL(*mMockHal.get(), getCapabilitiesInternal())
+                .Times(Exactly(1))
+                .WillRepeatedly(Return(vibrator::HalResult<vibrator::Capabilities>::ok(
+                        vibrator::Capabilities::COMPOSE_EFFECTS)));
+    }
+};
+
+// -------------------------------------------------------------------------------------------------
+
+ACTION(TriggerCompletionCallback) {
+    arg1();
+}
+
+static CompositeEffect createClick() {
+    return vibrator::TestFactory::createCompositeEffect(CompositePrimitive::CLICK, 0ms, 0.5f);
+}
+
+TEST_F(VibratorCompositionBatcherTest, TestPrewarmLoadsLimitsOnce) {
+    expectCompositionSupported();
+
+    ASSERT_TRUE(mBatcher->prewarm());
+    ASSERT_TRUE(mBatcher->prewarm());
+}
+
+TEST_F(VibratorCompositionBatcherTest, TestEnqueueUnsupported) {
+    EXPECT_CALL(*mMockHal.get(), getCapabilitiesInternal())
+            .Times(Exactly(1))
+            .WillRepeatedly(Return(
+                    vibrator::HalResult<vibrator::Capabilities>::ok(vibrator::Capabilities::NONE)));
+
+    int32_t callbackCounter = 0;
+    auto callback = vibrator::TestFactory::createCountingCallback(&callbackCounter);
+    ASSERT_FALSE(mBatcher->enqueue(createClick(), callback));
+    ASSERT_FALSE(mBatcher->enqueue(createClick(), callback));
+    ASSERT_EQ(0, callbackCounter);
+}
+
+TEST_F(VibratorCompositionBatcherTest, TestFirstPrimitivePerformedRightAway) {
+    expectCompositionSupported();
+    EXPECT_CALL(*mMockHal.get(), performComposedEffect(SizeIs(1), _))
+            .Times(Exactly(1))
+            .WillRepeatedly(DoAll(TriggerCompletionCallback(),
+                                  Return(vibrator::HalResult<milliseconds>::ok(
+                                          PRIMITIVE_DURATION))));
+
+    int32_t callbackCounter = 0;
+    auto callback = vibrator::TestFactory::createCountingCallback(&callbackCounter);
+    ASSERT_TRUE(mBatcher->enqueue(createClick(), callback));
+    ASSERT_EQ(1, callbackCounter);
+}
+
+TEST_F(VibratorCompositionBatcherTest, TestPrimitivesQueuedWhilePlayingComposedTogether) {
+    std::function<void()> flush;
+    expectCompositionSupported();
+    {
+        InSequence seq;
+        EXPECT_CALL(*mMockHal.get(), performComposedEffect(SizeIs(1), _))
+                .Times(Exactly(1))
+                .WillRepeatedly(Return(vibrator::HalResult<milliseconds>::ok(PRIMITIVE_DURATION)));
+        EXPECT_CALL(*mMockScheduler.get(), schedule(_, Le(PRIMITIVE_DURATION)))
+                .Times(Exactly(1))
+                .WillRepeatedly(SaveArg<0>(&flush));
+        EXPECT_CALL(*mMockHal.get(), performComposedEffect(SizeIs(3), _))
+                .Times(Exactly(1))
+                .WillRepeatedly(DoAll(TriggerCompletionCallback(),
+                                      Return(vibrator::HalResult<milliseconds>::ok(
+                                              PRIMITIVE_DURATION * 3))));
+    }
+
+    int32_t callbackCounter = 0;
+    auto callback = vibrator::TestFactory::createCountingCallback(&callbackCounter);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(mBatcher->enqueue(createClick(), callback));
+    }
+    ASSERT_EQ(0, callbackCounter);
+
+    // The held primitives are composed once the first one is done playing.
+    std::this_thread::sleep_for(PRIMITIVE_DURATION);
+    ASSERT_TRUE(flush);
+    flush();
+    ASSERT_EQ(3, callbackCounter);
+}
+
+TEST_F(VibratorCompositionBatcherTest, TestCompositionSizeMaxSplitsBatch) {
+    mMockHal->mCompositionSizeMax = 2;
+    std::vector<std::function<void()>> flushes;
+    expectCompositionSupported();
+    {
+        InSequence seq;
+        EXPECT_CALL(*mMockHal.get(), performComposedEffect(SizeIs(1), _))
+                .Times(Exactly(1))
+                .WillRepeatedly(Return(vibrator::HalResult<milliseconds>::ok(PRIMITIVE_DURATION)));
+        EXPECT_CALL(*mMockScheduler.get(), schedule(_, Le(PRIMITIVE_DURATION)))
+                .Times(Exactly(1))
+                .WillRepeatedly([&](std::function<void()> callback, milliseconds) {
+                    flushes.push_back(callback);
+                });
+        EXPECT_CALL(*mMockHal.get(), performComposedEffect(SizeIs(2), _))
+                .Times(Exactly(1))
+                .WillRepeatedly(
+                        Return(vibrator::HalResult<milliseconds>::ok(PRIMITIVE_DURATION * 2)));
+        EXPECT_CALL(*mMockScheduler.get(), schedule(_, Eq(PRIMITIVE_DURATION * 2)))
+                .Times(Exactly(1))
+                .WillRepeatedly([&](std::function<void()> callback, milliseconds) {
+                    flushes.push_back(callback);
+                });
+        EXPECT_CALL(*mMockHal.get(), performComposedEffect(SizeIs(1), _))
+                .Times(Exactly(1))
+                .WillRepeatedly(Return(vibrator::HalResult<milliseconds>::ok(PRIMITIVE_DURATION)));
+    }
+
+    auto callback = []() {};
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(mBatcher->enqueue(createClick(), callback));
+    }
+
+    std::this_thread::sleep_for(PRIMITIVE_DURATION);
+    ASSERT_EQ(1u, flushes.size());
+    flushes[0]();
+
+    std::this_thread::sleep_for(PRIMITIVE_DURATION * 2);
+    ASSERT_EQ(2u, flushes.size());
+    flushes[1]();
+}
+
+TEST_F(VibratorCompositionBatcherTest, TestFailedCompositionDoesNotHoldNextPrimitive) {
+    expectCompositionSupported();
+    EXPECT_CALL(*mMockHal.get(), tryReconnect()).Times(Exactly(1));
+    EXPECT_CALL(*mMockHal.get(), performComposedEffect(SizeIs(1), _))
+            .Times(Exactly(3))
+            .WillOnce(Return(vibrator::HalResult<milliseconds>::failed("message")))
+            .WillOnce(Return(vibrator::HalResult<milliseconds>::failed("message")))
+            .WillRepeatedly(Return(vibrator::HalResult<milliseconds>::ok(PRIMITIVE_DURATION)));
+
+    auto callback = []() {};
+    // Both attempts fail, so the vibrator is considered idle for the next primitive.
+    ASSERT_TRUE(mBatcher->enqueue(createClick(), callback));
+    ASSERT_TRUE(mBatcher->enqueue(createClick(), callback));
+}
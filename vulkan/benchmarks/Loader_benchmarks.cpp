@@ -0,0 +1,245 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Per-call overhead of the libvulkan loader on the per-frame entry points. With the null driver
+ * (vulkan.default) as the HAL, the driver does no work and the numbers are the cost of the loader
+ * trampolines and the swapchain implementation.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gui/BufferItemConsumer.h>
+#include <gui/BufferQueue.h>
+#include <gui/Surface.h>
+#include <log/log.h>
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace android {
+namespace {
+
+constexpr uint32_t kWidth = 64;
+constexpr uint32_t kHeight = 64;
+
+// Releases every buffer as soon as it is queued, so that presents never wait for the consumer.
+class ReleaseListener : public BufferItemConsumer::FrameAvailableListener {
+public:
+    explicit ReleaseListener(const sp<BufferItemConsumer>& consumer) : mConsumer(consumer) {}
+
+    void onFrameAvailable(const BufferItem&) override {
+        sp<BufferItemConsumer> consumer = mConsumer.promote();
+        BufferItem item;
+        if (consumer && consumer->acquireBuffer(&item, 0) == NO_ERROR) {
+            consumer->releaseBuffer(item);
+        }
+    }
+
+private:
+    wp<BufferItemConsumer> mConsumer;
+};
+
+// An instance, a device with one queue, and a swapchain presenting to a local BufferQueue.
+class VulkanContext {
+public:
+    VulkanContext() {
+        const char* instanceExtensions[] = {VK_KHR_SURFACE_EXTENSION_NAME,
+                                            VK_KHR_ANDROID_SURFACE_EXTENSION_NAME};
+        const VkApplicationInfo appInfo = {
+                .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+                .pApplicationName = "libvulkan_benchmarks",
+                .apiVersion = VK_API_VERSION_1_0,
+        };
+        const VkInstanceCreateInfo instanceInfo = {
+                .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+                .pApplicationInfo = &appInfo,
+                .enabledExtensionCount = 2,
+                .ppEnabledExtensionNames = instanceExtensions,
+        };
+        if (vkCreateInstance(&instanceInfo, nullptr, &mInstance) != VK_SUCCESS) {
+            ALOGE("vkCreateInstance failed");
+            return;
+        }
+
+        uint32_t count = 1;
+        VkPhysicalDevice physicalDevice;
+        VkResult result = vkEnumeratePhysicalDevices(mInstance, &count, &physicalDevice);
+        if ((result != VK_SUCCESS && result != VK_INCOMPLETE) || count == 0) {
+            ALOGE("vkEnumeratePhysicalDevices failed");
+            return;
+        }
+
+        const float priority = 1.0f;
+        const VkDeviceQueueCreateInfo queueInfo = {
+                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .queueFamilyIndex = 0,
+                .queueCount = 1,
+                .pQueuePriorities = &priority,
+        };
+        const char* deviceExtensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+                                          VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME};
+        const VkDeviceCreateInfo deviceInfo = {
+                .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+                .queueCreateInfoCount = 1,
+                .pQueueCreateInfos = &queueInfo,
+                .enabledExtensionCount = 2,
+                .ppEnabledExtensionNames = deviceExtensions,
+        };
+        if (vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &mDevice) != VK_SUCCESS) {
+            ALOGE("vkCreateDevice failed");
+            return;
+        }
+        vkGetDeviceQueue(mDevice, 0, 0, &mQueue);
+
+        sp<IGraphicBufferProducer> producer;
+        sp<IGraphicBufferConsumer> consumer;
+        BufferQueue::createBufferQueue(&producer, &consumer);
+        mConsumer = new BufferItemConsumer(consumer, GRALLOC_USAGE_HW_COMPOSER);
+        mListener = new ReleaseListener(mConsumer);
+        mConsumer->setFrameAvailableListener(mListener);
+        mWindow = new Surface(producer);
+
+        const VkAndroidSurfaceCreateInfoKHR surfaceInfo = {
+                .sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR,
+                .window = mWindow.get(),
+        };
+        if (vkCreateAndroidSurfaceKHR(mInstance, &surfaceInfo, nullptr, &mSurface) !=
+            VK_SUCCESS) {
+            ALOGE("vkCreateAndroidSurfaceKHR failed");
+            return;
+        }
+
+        VkSurfaceCapabilitiesKHR capabilities;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, mSurface, &capabilities);
+        const VkSwapchainCreateInfoKHR swapchainInfo = {
+                .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+                .surface = mSurface,
+                .minImageCount = capabilities.minImageCount,
+                .imageFormat = VK_FORMAT_R8G8B8A8_UNORM,
+                .imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+                .imageExtent = {kWidth, kHeight},
+                .imageArrayLayers = 1,
+                .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+                .compositeAlpha = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
+                .presentMode = VK_PRESENT_MODE_FIFO_KHR,
+        };
+        if (vkCreateSwapchainKHR(mDevice, &swapchainInfo, nullptr, &mSwapchain) != VK_SUCCESS) {
+            ALOGE("vkCreateSwapchainKHR failed");
+            return;
+        }
+    }
+
+    ~VulkanContext() {
+        if (mDevice) {
+            vkDeviceWaitIdle(mDevice);
+            vkDestroySwapchainKHR(mDevice, mSwapchain, nullptr);
+            vkDestroyDevice(mDevice, nullptr);
+        }
+        if (mInstance) {
+            vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
+            vkDestroyInstance(mInstance, nullptr);
+        }
+    }
+
+    bool isValid() const { return mSwapchain != VK_NULL_HANDLE; }
+
+    VkDevice device() const { return mDevice; }
+    VkQueue queue() const { return mQueue; }
+    VkSwapchainKHR swapchain() const { return mSwapchain; }
+
+private:
+    VkInstance mInstance = VK_NULL_HANDLE;
+    VkDevice mDevice = VK_NULL_HANDLE;
+    VkQueue mQueue = VK_NULL_HANDLE;
+    VkSurfaceKHR mSurface = VK_NULL_HANDLE;
+    VkSwapchainKHR mSwapchain = VK_NULL_HANDLE;
+
+    sp<BufferItemConsumer> mConsumer;
+    sp<ReleaseListener> mListener;
+    sp<Surface> mWindow;
+};
+
+/**
+ * An empty vkQueueSubmit: the api and driver trampolines down to the HAL.
+ */
+static void benchmarkQueueSubmit(benchmark::State& state) {
+    VulkanContext context;
+    if (!context.isValid()) {
+        state.SkipWithError("Failed to set up Vulkan");
+        return;
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(vkQueueSubmit(context.queue(), 0, nullptr, VK_NULL_HANDLE));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(benchmarkQueueSubmit);
+
+/**
+ * A frame: vkAcquireNextImageKHR followed by vkQueuePresentKHR, with damage of state.range(0)
+ * rectangles passed through VK_KHR_incremental_present.
+ */
+static void benchmarkAcquirePresent(benchmark::State& state) {
+    VulkanContext context;
+    if (!context.isValid()) {
+        state.SkipWithError("Failed to set up Vulkan");
+        return;
+    }
+
+    std::vector<VkRectLayerKHR> rectangles(state.range(0),
+                                           VkRectLayerKHR{{0, 0}, {kWidth, kHeight}, 0});
+    const VkPresentRegionKHR region = {
+            .rectangleCount = static_cast<uint32_t>(rectangles.size()),
+            .pRectangles = rectangles.data(),
+    };
+    const VkPresentRegionsKHR regions = {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR,
+            .swapchainCount = 1,
+            .pRegions = &region,
+    };
+    const VkSwapchainKHR swapchain = context.swapchain();
+
+    for (auto _ : state) {
+        uint32_t index;
+        if (vkAcquireNextImageKHR(context.device(), swapchain, UINT64_MAX, VK_NULL_HANDLE,
+                                  VK_NULL_HANDLE, &index) != VK_SUCCESS) {
+            state.SkipWithError("vkAcquireNextImageKHR failed");
+            break;
+        }
+        const VkPresentInfoKHR presentInfo = {
+                .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+                .pNext = rectangles.empty() ? nullptr : &regions,
+                .swapchainCount = 1,
+                .pSwapchains = &swapchain,
+                .pImageIndices = &index,
+        };
+        if (vkQueuePresentKHR(context.queue(), &presentInfo) != VK_SUCCESS) {
+            state.SkipWithError("vkQueuePresentKHR failed");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(benchmarkAcquirePresent)->Arg(0)->Arg(4)->Arg(64);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -23,12 +23,17 @@
 #include <dlfcn.h>
 #include <string.h>
 #include <sys/prctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <android/dlext.h>
+#include <android-base/file.h>
+#include <android-base/properties.h>
 #include <android-base/strings.h>
 #include <cutils/properties.h>
 #include <graphicsenv/GraphicsEnv.h>
@@ -321,14 +326,282 @@ void* LayerLibrary::GetGPA(const Layer& layer, const std::string_view gpa_name)
 
 // ----------------------------------------------------------------------------
 
+// Identifies a version of a layer library file. Libraries inside an APK use the
+// stamp of the APK.
+struct LibraryStamp {
+    int64_t mtime_ns;
+    int64_t size;
+
+    bool operator==(const LibraryStamp& other) const {
+        return mtime_ns == other.mtime_ns && size == other.size;
+    }
+};
+
+bool GetLibraryStamp(const std::string& path, LibraryStamp& stamp) {
+    size_t zip_pos = path.find("!/");
+    struct stat st;
+    if (stat(path.substr(0, zip_pos).c_str(), &st) != 0)
+        return false;
+    stamp.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                     st.st_mtim.tv_nsec;
+    stamp.size = st.st_size;
+    return true;
+}
+
+const char kLayerCacheMagic[] = "VkLayerCache";
+const uint32_t kLayerCacheVersion = 1;
+
+// LayerCache persists the layers found in each layer library, keyed by the
+// library path and stamp, so that the libraries don't have to be loaded to
+// enumerate their layers until they change. The whole cache is dropped when
+// the build changes.
+class LayerCache {
+   public:
+    void Load(const std::string& filename);
+    void Save();
+
+    // Appends the cached layers of the library to instance_layers. Returns
+    // false if the library isn't cached or has changed.
+    bool Lookup(const std::string& path,
+                const LibraryStamp& stamp,
+                size_t library_idx,
+                std::vector<Layer>& instance_layers);
+    void Store(const std::string& path,
+               const LibraryStamp& stamp,
+               const Layer* layers,
+               size_t count);
+
+   private:
+    struct Entry {
+        LibraryStamp stamp;
+        std::vector<Layer> layers;
+        // whether the library was found by this discovery
+        bool found;
+    };
+
+    std::string GetBuildKey() const;
+
+    std::string filename_;
+    std::unordered_map<std::string, Entry> entries_;
+    bool dirty_ = false;
+};
+
+template <typename T>
+void AppendValue(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendString(std::string& out, const std::string& value) {
+    AppendValue(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+}
+
+template <typename T>
+void AppendVector(std::string& out, const std::vector<T>& values) {
+    AppendValue(out, static_cast<uint32_t>(values.size()));
+    out.append(reinterpret_cast<const char*>(values.data()),
+               values.size() * sizeof(T));
+}
+
+// Reads the values appended by the functions above, failing once the data is
+// exhausted.
+class CacheReader {
+   public:
+    explicit CacheReader(const std::string& data) : data_(data), pos_(0) {}
+
+    template <typename T>
+    bool ReadValue(T& value) {
+        if (data_.size() - pos_ < sizeof(value))
+            return false;
+        memcpy(&value, data_.data() + pos_, sizeof(value));
+        pos_ += sizeof(value);
+        return true;
+    }
+
+    bool ReadString(std::string& value) {
+        uint32_t size;
+        if (!ReadValue(size) || data_.size() - pos_ < size)
+            return false;
+        value.assign(data_, pos_, size);
+        pos_ += size;
+        return true;
+    }
+
+    template <typename T>
+    bool ReadVector(std::vector<T>& values) {
+        uint32_t count;
+        if (!ReadValue(count) || (data_.size() - pos_) / sizeof(T) < count)
+            return false;
+        values.resize(count);
+        memcpy(values.data(), data_.data() + pos_, count * sizeof(T));
+        pos_ += count * sizeof(T);
+        return true;
+    }
+
+    bool AtEnd() const { return pos_ == data_.size(); }
+
+   private:
+    const std::string& data_;
+    size_t pos_;
+};
+
+std::string LayerCache::GetBuildKey() const {
+    return android::base::GetProperty("ro.build.fingerprint", "") + "/" +
+           std::to_string(VK_HEADER_VERSION);
+}
+
+void LayerCache::Load(const std::string& filename) {
+    ATRACE_CALL();
+
+    filename_ = filename;
+    std::string data;
+    if (!android::base::ReadFileToString(filename_, &data))
+        return;
+
+    CacheReader reader(data);
+    std::string magic;
+    uint32_t version;
+    std::string build_key;
+    uint32_t num_entries;
+    if (!reader.ReadString(magic) || magic != kLayerCacheMagic ||
+        !reader.ReadValue(version) || version != kLayerCacheVersion ||
+        !reader.ReadString(build_key) || build_key != GetBuildKey() ||
+        !reader.ReadValue(num_entries)) {
+        ALOGV("ignoring stale layer cache '%s'", filename_.c_str());
+        dirty_ = true;
+        return;
+    }
+
+    for (uint32_t i = 0; i < num_entries; i++) {
+        std::string path;
+        Entry entry;
+        uint32_t num_layers;
+        if (!reader.ReadString(path) || !reader.ReadValue(entry.stamp) ||
+            !reader.ReadValue(num_layers)) {
+            break;
+        }
+        entry.layers.resize(num_layers);
+        bool valid = true;
+        for (Layer& layer : entry.layers) {
+            uint8_t is_global;
+            valid = reader.ReadValue(layer.properties) &&
+                    reader.ReadValue(is_global) &&
+                    reader.ReadVector(layer.instance_extensions) &&
+                    reader.ReadVector(layer.device_extensions);
+            if (!valid)
+                break;
+            layer.is_global = is_global != 0;
+        }
+        if (!valid)
+            break;
+        entry.found = false;
+        entries_.emplace(std::move(path), std::move(entry));
+    }
+    if (!reader.AtEnd()) {
+        ALOGE("layer cache '%s' is corrupt, ignoring it", filename_.c_str());
+        entries_.clear();
+        dirty_ = true;
+    }
+}
+
+void LayerCache::Save() {
+    if (filename_.empty())
+        return;
+
+    // Forget the libraries which are gone.
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (!it->second.found) {
+            it = entries_.erase(it);
+            dirty_ = true;
+        } else {
+            ++it;
+        }
+    }
+    if (!dirty_)
+        return;
+
+    ATRACE_CALL();
+
+    std::string data;
+    AppendString(data, kLayerCacheMagic);
+    AppendValue(data, kLayerCacheVersion);
+    AppendString(data, GetBuildKey());
+    AppendValue(data, static_cast<uint32_t>(entries_.size()));
+    for (const auto& [path, entry] : entries_) {
+        AppendString(data, path);
+        AppendValue(data, entry.stamp);
+        AppendValue(data, static_cast<uint32_t>(entry.layers.size()));
+        for (const Layer& layer : entry.layers) {
+            AppendValue(data, layer.properties);
+            AppendValue(data, static_cast<uint8_t>(layer.is_global));
+            AppendVector(data, layer.instance_extensions);
+            AppendVector(data, layer.device_extensions);
+        }
+    }
+
+    // Replace the file atomically, as other processes may be reading it.
+    std::string tmp_filename = filename_ + ".tmp" + std::to_string(getpid());
+    if (!android::base::WriteStringToFile(data, tmp_filename) ||
+        rename(tmp_filename.c_str(), filename_.c_str()) != 0) {
+        ALOGW("failed to write layer cache '%s': %s", filename_.c_str(),
+              strerror(errno));
+        unlink(tmp_filename.c_str());
+        return;
+    }
+    dirty_ = false;
+}
+
+bool LayerCache::Lookup(const std::string& path,
+                        const LibraryStamp& stamp,
+                        size_t library_idx,
+                        std::vector<Layer>& instance_layers) {
+    auto it = entries_.find(path);
+    if (it == entries_.end() || !(it->second.stamp == stamp))
+        return false;
+
+    it->second.found = true;
+    for (const Layer& layer : it->second.layers) {
+        instance_layers.push_back(layer);
+        instance_layers.back().library_idx = library_idx;
+        ALOGD("added cached %s layer '%s' from library '%s'",
+              (layer.is_global) ? "global" : "instance",
+              layer.properties.layerName, path.c_str());
+    }
+    return true;
+}
+
+void LayerCache::Store(const std::string& path,
+                       const LibraryStamp& stamp,
+                       const Layer* layers,
+                       size_t count) {
+    Entry& entry = entries_[path];
+    entry.stamp = stamp;
+    entry.layers.assign(layers, layers + count);
+    entry.found = true;
+    dirty_ = true;
+}
+
 std::vector<LayerLibrary> g_layer_libraries;
 std::vector<Layer> g_instance_layers;
+LayerCache g_layer_cache;
 
 void AddLayerLibrary(const std::string& path, const std::string& filename) {
-    LayerLibrary library(path + "/" + filename, filename);
+    const std::string library_path = path + "/" + filename;
+    LayerLibrary library(library_path, filename);
+
+    LibraryStamp stamp;
+    bool has_stamp = GetLibraryStamp(library_path, stamp);
+    if (has_stamp &&
+        g_layer_cache.Lookup(library_path, stamp, g_layer_libraries.size(),
+                             g_instance_layers)) {
+        g_layer_libraries.emplace_back(std::move(library));
+        return;
+    }
+
     if (!library.Open())
         return;
 
+    size_t prev_num_instance_layers = g_instance_layers.size();
     if (!library.EnumerateLayers(g_layer_libraries.size(), g_instance_layers)) {
         library.Close();
         return;
@@ -336,6 +609,12 @@ void AddLayerLibrary(const std::string& path, const std::string& filename) {
 
     library.Close();
 
+    if (has_stamp) {
+        g_layer_cache.Store(library_path, stamp,
+                            &g_instance_layers[prev_num_instance_layers],
+                            g_instance_layers.size() - prev_num_instance_layers);
+    }
+
     g_layer_libraries.emplace_back(std::move(library));
 }
 
@@ -461,11 +740,18 @@ void* GetLayerGetProcAddr(const Layer& layer,
 void DiscoverLayers() {
     ATRACE_CALL();
 
+    const std::string& cache_path =
+        android::GraphicsEnv::getInstance().getLayerCachePath();
+    if (!cache_path.empty())
+        g_layer_cache.Load(cache_path);
+
     if (android::GraphicsEnv::getInstance().isDebuggable()) {
         DiscoverLayersInPathList(kSystemLayerLibraryDir);
     }
     if (!android::GraphicsEnv::getInstance().getLayerPaths().empty())
         DiscoverLayersInPathList(android::GraphicsEnv::getInstance().getLayerPaths());
+
+    g_layer_cache.Save();
 }
 
 uint32_t GetLayerCount() {
@@ -16,6 +16,7 @@
 
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <android-base/properties.h>
 #include <android/hardware/graphics/common/1.0/types.h>
 #include <grallocusage/GrallocUsageConversion.h>
 #include <graphicsenv/GraphicsEnv.h>
@@ -28,6 +29,7 @@
 #include <utils/Trace.h>
 
 #include <algorithm>
+#include <deque>
 #include <unordered_set>
 #include <vector>
 
@@ -218,6 +220,11 @@ enum { MAX_TIMING_INFOS = 10 };
 // Minimum number of frames to look for in the past (so we don't cause
 // syncronous requests to Surface Flinger):
 enum { MIN_NUM_FRAMES_AGO = 5 };
+// Number of consecutive on-time frames after which frame pacing goes back to
+// a single frame in flight:
+enum { PACING_FRAMES_ON_TIME = 60 };
+// Number of damage rectangles vkQueuePresentKHR handles without allocating:
+enum { MAX_STACK_DAMAGE_RECTS = 16 };
 
 struct Swapchain {
     Swapchain(Surface& surface_,
@@ -230,6 +237,10 @@ struct Swapchain {
           pre_transform(pre_transform_),
           frame_timestamps_enabled(false),
           acquire_next_image_timeout(-1),
+          frame_pacing(false),
+          max_frames_in_flight(1),
+          frames_on_time(0),
+          last_pacing_present_time(0),
           shared(present_mode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR ||
                  present_mode ==
                      VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR) {
@@ -255,6 +266,14 @@ struct Swapchain {
     bool frame_timestamps_enabled;
     int64_t refresh_duration;
     nsecs_t acquire_next_image_timeout;
+    // When frame pacing is enabled, vkAcquireNextImageKHR waits until fewer
+    // than max_frames_in_flight presented frames are still being rendered.
+    // The limit is raised to two while the display misses frames, and goes
+    // back to one once frames are presented on time again.
+    bool frame_pacing;
+    uint32_t max_frames_in_flight;
+    uint32_t frames_on_time;
+    int64_t last_pacing_present_time;
     bool shared;
 
     struct Image {
@@ -278,6 +297,17 @@ struct Swapchain {
     } images[android::BufferQueueDefs::NUM_BUFFER_SLOTS];
 
     std::vector<TimingInfo> timing;
+
+    struct PacingFrame {
+        uint64_t native_frame_id;
+        // The VK_GOOGLE_display_timing desiredPresentTime, or 0.
+        int64_t desired_present_time;
+    };
+    // Release fences of the presented frames which may still be rendering,
+    // oldest first. We own these fds.
+    std::deque<int> in_flight_fences;
+    // Presented frames whose timestamps haven't been looked at yet.
+    std::deque<PacingFrame> pacing_frames;
 };
 
 VkSwapchainKHR HandleFromSwapchain(Swapchain* swapchain) {
@@ -358,6 +388,100 @@ void ReleaseSwapchainImage(VkDevice device,
     image.buffer.clear();
 }
 
+void ClearFramePacing(Swapchain& swapchain) {
+    for (int fd : swapchain.in_flight_fences) {
+        close(fd);
+    }
+    swapchain.in_flight_fences.clear();
+    swapchain.pacing_frames.clear();
+    swapchain.last_pacing_present_time = 0;
+}
+
+// Waits until fewer than max_frames_in_flight presented frames are still
+// rendering, for at most timeout nanoseconds (-1 waits forever).
+bool WaitForFramePacing(Swapchain& swapchain, nsecs_t timeout) {
+    ATRACE_CALL();
+
+    auto& fences = swapchain.in_flight_fences;
+    while (!fences.empty() && !IsFencePending(fences.front())) {
+        close(fences.front());
+        fences.pop_front();
+    }
+    while (fences.size() >= swapchain.max_frames_in_flight) {
+        const int timeout_ms =
+            timeout < 0
+                ? -1
+                : static_cast<int>(std::min<nsecs_t>(
+                      (timeout + 999999) / 1000000,
+                      std::numeric_limits<int>::max()));
+        if (sync_wait(fences.front(), timeout_ms) == -1 && errno == ETIME) {
+            return false;
+        }
+        close(fences.front());
+        fences.pop_front();
+    }
+    return true;
+}
+
+// Looks at the timestamps of frames presented at least MIN_NUM_FRAMES_AGO
+// frames ago, and adjusts the number of frames in flight: a missed frame
+// allows a second frame in flight, PACING_FRAMES_ON_TIME on-time frames go
+// back to a single one.
+void UpdateFramePacing(Swapchain& swapchain) {
+    auto& frames = swapchain.pacing_frames;
+    while (frames.size() > MIN_NUM_FRAMES_AGO) {
+        const Swapchain::PacingFrame frame = frames.front();
+        int64_t actual_present_time = 0;
+        int err = native_window_get_frame_timestamps(
+            swapchain.surface.window.get(), frame.native_frame_id,
+            nullptr,  //&desired_present_time,
+            nullptr,  //&render_complete_time,
+            nullptr,  //&composition_latch_time,
+            nullptr,  //&first_composition_start_time,
+            nullptr,  //&last_composition_start_time,
+            nullptr,  //&composition_finish_time,
+            &actual_present_time,
+            nullptr,  //&dequeue_ready_time,
+            nullptr /*&reads_done_time*/);
+        if (err == android::OK &&
+            actual_present_time == NATIVE_WINDOW_TIMESTAMP_PENDING &&
+            frames.size() <= MAX_TIMING_INFOS) {
+            break;
+        }
+        frames.pop_front();
+
+        if (err != android::OK || actual_present_time <= 0) {
+            swapchain.last_pacing_present_time = 0;
+            continue;
+        }
+
+        const int64_t refresh_duration = swapchain.refresh_duration;
+        bool missed = false;
+        if (frame.desired_present_time > 0) {
+            // The app paces itself; check it got the time it asked for.
+            missed = actual_present_time >
+                     frame.desired_present_time + refresh_duration / 2;
+        } else if (swapchain.last_pacing_present_time > 0) {
+            missed = actual_present_time - swapchain.last_pacing_present_time >
+                     refresh_duration * 3 / 2;
+        }
+        swapchain.last_pacing_present_time = actual_present_time;
+
+        if (missed) {
+            if (swapchain.max_frames_in_flight == 1) {
+                ALOGV("frame pacing: missed a frame, allowing two in flight");
+            }
+            swapchain.max_frames_in_flight = 2;
+            swapchain.frames_on_time = 0;
+        } else if (swapchain.max_frames_in_flight > 1 &&
+                   ++swapchain.frames_on_time >= PACING_FRAMES_ON_TIME) {
+            ALOGV("frame pacing: back to one frame in flight");
+            swapchain.max_frames_in_flight = 1;
+            swapchain.frames_on_time = 0;
+        }
+    }
+}
+
 void OrphanSwapchain(VkDevice device, Swapchain* swapchain) {
     if (swapchain->surface.swapchain_handle != HandleFromSwapchain(swapchain))
         return;
@@ -368,6 +492,7 @@ void OrphanSwapchain(VkDevice device, Swapchain* swapchain) {
     }
     swapchain->surface.swapchain_handle = VK_NULL_HANDLE;
     swapchain->timing.clear();
+    ClearFramePacing(*swapchain);
 }
 
 uint32_t get_num_ready_timings(Swapchain& swapchain) {
@@ -1011,6 +1136,7 @@ static void DestroySwapchainInternal(VkDevice device,
     for (uint32_t i = 0; i < swapchain->num_images; i++) {
         ReleaseSwapchainImage(device, window, -1, swapchain->images[i], false);
     }
+    ClearFramePacing(*swapchain);
 
     if (active) {
         swapchain->surface.swapchain_handle = VK_NULL_HANDLE;
@@ -1323,22 +1449,48 @@ VkResult CreateSwapchainKHR(VkDevice device,
         .pQueueFamilyIndices = create_info->pQueueFamilyIndices,
     };
 
+    // Dequeue the whole swapchain with a single call where the window
+    // supports it, rather than crossing into the consumer once per image.
+    // Batched operations aren't available in shared buffer mode.
+    ANativeWindowBuffer*
+        batch_buffers[android::BufferQueueDefs::NUM_BUFFER_SLOTS];
+    int batch_fences[android::BufferQueueDefs::NUM_BUFFER_SLOTS];
+    bool batched = false;
+    if (!swapchain->shared) {
+        ATRACE_BEGIN("native_window_dequeue_buffers");
+        err = native_window_dequeue_buffers(window, batch_buffers, batch_fences,
+                                            num_images);
+        ATRACE_END();
+        batched = err == android::OK;
+        if (!batched) {
+            ALOGV("native_window_dequeue_buffers failed: %s (%d), "
+                  "dequeueing one buffer at a time",
+                  strerror(-err), err);
+        }
+    }
+
     for (uint32_t i = 0; i < num_images; i++) {
         Swapchain::Image& img = swapchain->images[i];
 
         ANativeWindowBuffer* buffer;
-        err = window->dequeueBuffer(window, &buffer, &img.dequeue_fence);
-        if (err != android::OK) {
-            ALOGE("dequeueBuffer[%u] failed: %s (%d)", i, strerror(-err), err);
-            switch (-err) {
-                case ENOMEM:
-                    result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
-                    break;
-                default:
-                    result = VK_ERROR_SURFACE_LOST_KHR;
-                    break;
+        if (batched) {
+            buffer = batch_buffers[i];
+            img.dequeue_fence = batch_fences[i];
+        } else {
+            err = window->dequeueBuffer(window, &buffer, &img.dequeue_fence);
+            if (err != android::OK) {
+                ALOGE("dequeueBuffer[%u] failed: %s (%d)", i, strerror(-err),
+                      err);
+                switch (-err) {
+                    case ENOMEM:
+                        result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+                        break;
+                    default:
+                        result = VK_ERROR_SURFACE_LOST_KHR;
+                        break;
+                }
+                break;
             }
-            break;
         }
         img.buffer = buffer;
         img.dequeued = true;
@@ -1368,16 +1520,35 @@ VkResult CreateSwapchainKHR(VkDevice device,
     // -- Cancel all buffers, returning them to the queue --
     // If an error occurred before, also destroy the VkImage and release the
     // buffer reference. Otherwise, we retain a strong reference to the buffer.
-    for (uint32_t i = 0; i < num_images; i++) {
-        Swapchain::Image& img = swapchain->images[i];
-        if (img.dequeued) {
-            if (!swapchain->shared) {
-                window->cancelBuffer(window, img.buffer.get(),
-                                     img.dequeue_fence);
+    if (batched) {
+        // Every buffer was dequeued, including those past a vkCreateImage
+        // failure, which still only have their fence in batch_fences.
+        for (uint32_t i = 0; i < num_images; i++) {
+            Swapchain::Image& img = swapchain->images[i];
+            if (img.dequeued) {
+                batch_fences[i] = img.dequeue_fence;
                 img.dequeue_fence = -1;
                 img.dequeued = false;
             }
         }
+        err = native_window_cancel_buffers(window, batch_buffers, batch_fences,
+                                           num_images);
+        if (err != android::OK) {
+            ALOGE("native_window_cancel_buffers failed: %s (%d)",
+                  strerror(-err), err);
+        }
+    } else {
+        for (uint32_t i = 0; i < num_images; i++) {
+            Swapchain::Image& img = swapchain->images[i];
+            if (img.dequeued) {
+                if (!swapchain->shared) {
+                    window->cancelBuffer(window, img.buffer.get(),
+                                         img.dequeue_fence);
+                    img.dequeue_fence = -1;
+                    img.dequeued = false;
+                }
+            }
+        }
     }
 
     if (result != VK_SUCCESS) {
@@ -1392,6 +1563,14 @@ VkResult CreateSwapchainKHR(VkDevice device,
             android::GpuStatsInfo::Stats::FALSE_PREROTATION);
     }
 
+    // Frame pacing relies on frame timestamps to notice missed frames.
+    if (!swapchain->shared &&
+        android::base::GetBoolProperty("debug.vulkan.frame_pacing", false)) {
+        native_window_enable_frame_timestamps(window, true);
+        swapchain->frame_timestamps_enabled = true;
+        swapchain->frame_pacing = true;
+    }
+
     surface.swapchain_handle = HandleFromSwapchain(swapchain);
     *swapchain_handle = surface.swapchain_handle;
     return VK_SUCCESS;
@@ -1475,6 +1654,11 @@ VkResult AcquireNextImageKHR(VkDevice device,
         swapchain.acquire_next_image_timeout = acquire_next_image_timeout;
     }
 
+    if (swapchain.frame_pacing &&
+        !WaitForFramePacing(swapchain, acquire_next_image_timeout)) {
+        return timeout ? VK_TIMEOUT : VK_NOT_READY;
+    }
+
     ANativeWindowBuffer* buffer;
     int fence_fd;
     err = window->dequeueBuffer(window, &buffer, &fence_fd);
@@ -1607,8 +1791,12 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
     const VkPresentTimeGOOGLE* times =
         (present_times) ? present_times->pTimes : nullptr;
     const VkAllocationCallbacks* allocator = &GetData(device).allocator;
-    android_native_rect_t* rects = nullptr;
-    uint32_t nrects = 0;
+    // The damage of most presents fits in stack_rects; only presents with
+    // more rectangles take an allocation.
+    android_native_rect_t stack_rects[MAX_STACK_DAMAGE_RECTS];
+    android_native_rect_t* heap_rects = nullptr;
+    android_native_rect_t* rects = stack_rects;
+    uint32_t nrects = MAX_STACK_DAMAGE_RECTS;
 
     for (uint32_t sc = 0; sc < present_info->swapchainCount; sc++) {
         Swapchain& swapchain =
@@ -1645,11 +1833,12 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
                         android_native_rect_t* new_rects =
                             static_cast<android_native_rect_t*>(
                                 allocator->pfnReallocation(
-                                    allocator->pUserData, rects,
+                                    allocator->pUserData, heap_rects,
                                     sizeof(android_native_rect_t) * rcount,
                                     alignof(android_native_rect_t),
                                     VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
                         if (new_rects) {
+                            heap_rects = new_rects;
                             rects = new_rects;
                             nrects = rcount;
                         } else {
@@ -1713,6 +1902,22 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
                     }
                 }
 
+                if (swapchain.frame_pacing) {
+                    uint64_t nativeFrameId = 0;
+                    if (native_window_get_next_frame_id(
+                            window, &nativeFrameId) == android::OK) {
+                        swapchain.pacing_frames.push_back(
+                            {nativeFrameId,
+                             time ? static_cast<int64_t>(
+                                        time->desiredPresentTime)
+                                  : 0});
+                    }
+                    int pacing_fence = fence < 0 ? -1 : dup(fence);
+                    if (pacing_fence >= 0) {
+                        swapchain.in_flight_fences.push_back(pacing_fence);
+                    }
+                }
+
                 err = window->queueBuffer(window, img.buffer.get(), fence);
                 // queueBuffer always closes fence, even on error
                 if (err != android::OK) {
@@ -1726,6 +1931,9 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
                     }
                     img.dequeued = false;
                 }
+                if (swapchain.frame_pacing) {
+                    UpdateFramePacing(swapchain);
+                }
 
                 // If the swapchain is in shared mode, immediately dequeue the
                 // buffer so it can be presented again without an intervening
@@ -1776,8 +1984,8 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
         if (swapchain_result != final_result)
             final_result = WorstPresentResult(final_result, swapchain_result);
     }
-    if (rects) {
-        allocator->pfnFree(allocator->pUserData, rects);
+    if (heap_rects) {
+        allocator->pfnFree(allocator->pUserData, heap_rects);
     }
 
     return final_result;